@@ -27,20 +27,45 @@ mkdir -p gen/bin
 
 # ----
 
-echo "Building gen/bin/iconvg-to-png-with-cairo"
+echo "Building gen/bin/iconvg-bench-with-cairo"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
     -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND \
+    example/iconvg-bench/iconvg-bench.c \
+    -lcairo -lm \
+    -o gen/bin/iconvg-bench-with-cairo
+
+# ----
+
+echo "Building gen/bin/iconvg-to-png-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 -pthread \
+    -DICONVG_CONFIG__ENABLE_PTHREADS \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND \
     example/iconvg-to-png/iconvg-to-png.c \
     -lcairo -lm -lpng \
     -o gen/bin/iconvg-to-png-with-cairo
 
 # ----
 
-echo "Building gen/bin/iconvg-viewer-with-cairo"
+echo "Building gen/bin/iconvg-atlas-with-cairo"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
     -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND \
+    example/iconvg-atlas/iconvg-atlas.c \
+    -lcairo -lm -lpng \
+    -o gen/bin/iconvg-atlas-with-cairo
+
+# ----
+
+echo "Building gen/bin/iconvg-viewer-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 -pthread \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND \
     example/iconvg-viewer/iconvg-viewer.c \
     -lcairo -lm -lxcb -lxcb-image \
     -o gen/bin/iconvg-viewer-with-cairo
@@ -36,10 +36,27 @@ mkdir -p gen/bin
 
 # ----
 
-echo "Building gen/bin/iconvg-to-png-with-skia"
+echo "Building gen/bin/iconvg-bench-with-skia"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
     -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-bench/iconvg-bench.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -lm \
+    -o gen/bin/iconvg-bench-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
+echo "Building gen/bin/iconvg-to-png-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 -pthread \
+    -DICONVG_CONFIG__ENABLE_PTHREADS \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND \
     -I $SKIA_LIB_DIR/../.. \
     example/iconvg-to-png/iconvg-to-png.c \
     $SKIA_LIB_DIR/libskia.* \
@@ -50,10 +67,26 @@ ${CC:-gcc} -O3 -Wall -std=c99 \
 
 # ----
 
-echo "Building gen/bin/iconvg-viewer-with-skia"
+echo "Building gen/bin/iconvg-atlas-with-skia"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
     -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-atlas/iconvg-atlas.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -lm -lpng \
+    -o gen/bin/iconvg-atlas-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
+echo "Building gen/bin/iconvg-viewer-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 -pthread \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -DICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND \
     -I $SKIA_LIB_DIR/../.. \
     example/iconvg-viewer/iconvg-viewer.c \
     $SKIA_LIB_DIR/libskia.* \
@@ -0,0 +1,136 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-optimize re-encodes IconVG byte-code so that it is smaller and faster
+// to decode. See lowlevel.Optimize for what it changes.
+//
+// Usage: iconvg-optimize [flags] in.ivg > out.ivg
+//     in.ivg may be omitted, in which case stdin is read.
+//
+// Flags:
+//     -merge-paths       merge consecutive paths filled with the same paint.
+//                        This is not always lossless.
+//     -verify=RENDERER   run RENDERER (a program that, like iconvg-to-png,
+//                        reads IconVG from stdin and writes PNG to stdout) on
+//                        both the input and output and fail if the pixels
+//                        differ, e.g. -verify=gen/bin/iconvg-to-png-with-cairo
+package main
+
+import (
+	"bytes"
+	"flag"
+	"fmt"
+	"image"
+	"image/png"
+	"io"
+	"os"
+	"os/exec"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	mergePathsFlag = flag.Bool("merge-paths", false, "merge consecutive paths filled with the same paint")
+	verifyFlag     = flag.String("verify", "", "render with this program and fail if the pixels differ")
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s [flags] in.ivg > out.ivg\n"+
+			"    in.ivg may be omitted, in which case stdin is read.\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+
+	in := os.Stdin
+	if flag.NArg() > 1 {
+		flag.Usage()
+		os.Exit(2)
+	} else if flag.NArg() == 1 {
+		if f, err := os.Open(flag.Arg(0)); err != nil {
+			return err
+		} else {
+			defer f.Close()
+			in = f
+		}
+	}
+	src, err := io.ReadAll(in)
+	if err != nil {
+		return err
+	}
+
+	dst, err := lowlevel.Optimize(nil, src, &lowlevel.OptimizeOptions{
+		MergePaths: *mergePathsFlag,
+	})
+	if err != nil {
+		return err
+	}
+
+	if *verifyFlag != "" {
+		if err := verify(*verifyFlag, src, dst); err != nil {
+			return err
+		}
+	}
+	_, err = os.Stdout.Write(dst)
+	return err
+}
+
+// verify renders the original and optimized graphics and compares them,
+// pixel for pixel.
+func verify(renderer string, src []byte, dst []byte) error {
+	want, err := render(renderer, src)
+	if err != nil {
+		return fmt.Errorf("verify: rendering the input: %v", err)
+	}
+	got, err := render(renderer, dst)
+	if err != nil {
+		return fmt.Errorf("verify: rendering the output: %v", err)
+	}
+
+	if got.Bounds() != want.Bounds() {
+		return fmt.Errorf("verify: bounds differ: got %v, want %v", got.Bounds(), want.Bounds())
+	}
+	b := want.Bounds()
+	for y := b.Min.Y; y < b.Max.Y; y++ {
+		for x := b.Min.X; x < b.Max.X; x++ {
+			r0, g0, b0, a0 := got.At(x, y).RGBA()
+			r1, g1, b1, a1 := want.At(x, y).RGBA()
+			if r0 != r1 || g0 != g1 || b0 != b1 || a0 != a1 {
+				return fmt.Errorf("verify: pixels differ at (%d, %d)", x, y)
+			}
+		}
+	}
+	return nil
+}
+
+func render(renderer string, src []byte) (image.Image, error) {
+	stdout, stderr := &bytes.Buffer{}, &bytes.Buffer{}
+	cmd := exec.Command(renderer)
+	cmd.Stdin = bytes.NewReader(src)
+	cmd.Stdout = stdout
+	cmd.Stderr = stderr
+	if err := cmd.Run(); err != nil {
+		return nil, fmt.Errorf("%v\n%s", err, stderr.Bytes())
+	}
+	return png.Decode(stdout)
+}
@@ -0,0 +1,70 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-pack writes an icon pack (see src/go/iconpack) holding the given
+// IconVG files, named by their base names minus any ".ivg" suffix.
+//
+// Usage: iconvg-pack out.ivgpack in0.ivg in1.ivg etc
+package main
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+
+	"github.com/google/iconvg/src/go/iconpack"
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	cmd := "iconvg-pack"
+	if len(os.Args) > 0 {
+		cmd = os.Args[0]
+	}
+
+	if len(os.Args) < 2 {
+		return fmt.Errorf("Usage: %s out.ivgpack in0.ivg in1.ivg etc", cmd)
+	}
+
+	w := &iconpack.Writer{}
+	for _, filename := range os.Args[2:] {
+		src, err := os.ReadFile(filename)
+		if err != nil {
+			return err
+		}
+		name := strings.TrimSuffix(filepath.Base(filename), ".ivg")
+		if err := w.Add(name, src, nil); err != nil {
+			return fmt.Errorf("%s: %v", filename, err)
+		}
+	}
+
+	f, err := os.Create(os.Args[1])
+	if err != nil {
+		return err
+	}
+	if _, err := w.WriteTo(f); err != nil {
+		f.Close()
+		return err
+	}
+	return f.Close()
+}
@@ -0,0 +1,754 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-atlas renders many IconVG files, each at one or more sizes, into a
+// single texture atlas (or sprite sheet) PNG, alongside a JSON manifest of
+// where each sprite is.
+//
+// Usage: iconvg-atlas [flags] output.png input0.ivg input1.ivg etc
+//
+// Flags:
+//   -sizes S0,S1,etc   the sizes, in pixels, of each sprite's larger side
+//                      (default: 16,32,64)
+//   -padding N         the minimum gap, in pixels, between sprites (default:
+//                      1)
+//   -max N             the maximum atlas width and height (default: 4096)
+//
+// The manifest is written to output.json (output.png with its ".png" suffix,
+// if any, replaced). It lists, for each input and size, the sprite's pixel
+// rectangle and its texture coordinates (UVs, from 0.0 to 1.0):
+//
+//   {"width":W,"height":H,"sprites":[
+//     {"file":"a.ivg","size":16,"x":0,"y":0,"w":16,"h":16,
+//      "u0":0,"v0":0,"u1":0.25,"v1":0.5},
+//     etc
+//   ]}
+//
+// Every sprite is decoded into its own dst_rect of one shared canvas (and one
+// pixel buffer), packed by iconvg_atlas_pack, so there is a single surface
+// allocation and a single PNG encode per atlas.
+
+#include <errno.h>
+#include <inttypes.h>
+#include <png.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+// SRC_BUFFER_ARRAY_SIZE is the largest size (in bytes) for .ivg files
+// supported by this program.
+//
+// This is 1 MiB (1024 * 1024 = 1048576 bytes) by default, but can be
+// configured by compiling with -DSRC_BUFFER_ARRAY_SIZE=etc.
+#ifndef SRC_BUFFER_ARRAY_SIZE
+#define SRC_BUFFER_ARRAY_SIZE 1048576
+#endif
+
+uint8_t g_src_buffer_array[SRC_BUFFER_ARRAY_SIZE];
+
+typedef struct {
+  uint8_t* data;
+  uint32_t width;
+  uint32_t height;
+  iconvg_canvas canvas;
+  void* extra0;
+  void* extra1;
+} pixel_buffer;
+
+// ----
+
+#if defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+
+#include <cairo/cairo.h>
+
+const char*  //
+initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+  cairo_surface_t* cs =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)width, (int)height);
+  cairo_t* cr = cairo_create(cs);
+
+  *pb = ((pixel_buffer){0});
+  pb->canvas = iconvg_canvas__make_cairo(cr);
+  pb->extra0 = cs;
+  pb->extra1 = cr;
+  return NULL;
+}
+
+const char*  //
+flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  cairo_surface_t* cs = (cairo_surface_t*)(pb->extra0);
+  if (!cs) {
+    return "main: NULL cairo_surface_t";
+  }
+  cairo_surface_flush(cs);
+  pb->data = cairo_image_surface_get_data(cs);
+  pb->width = width;
+  pb->height = height;
+  return NULL;
+}
+
+const char*  //
+finalize_pixel_buffer(pixel_buffer* pb) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  if (pb->extra1) {
+    cairo_destroy((cairo_t*)(pb->extra1));
+    pb->extra1 = NULL;
+  }
+  if (pb->extra0) {
+    cairo_surface_destroy((cairo_surface_t*)(pb->extra0));
+    pb->extra0 = NULL;
+  }
+  return NULL;
+}
+
+#elif defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+
+#include "include/c/sk_imageinfo.h"
+#include "include/c/sk_surface.h"
+
+const char*  //
+initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+
+  // Use calloc, not malloc, as the atlas' unused areas stay untouched.
+  uint8_t* data = (uint8_t*)(calloc(4 * width * height, 1));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+
+  sk_imageinfo_t* si =
+      sk_imageinfo_new((int)width, (int)height, BGRA_8888_SK_COLORTYPE,
+                       PREMUL_SK_ALPHATYPE, NULL);
+  if (!si) {
+    free(data);
+    return "main: could not create sk_imageinfo_t";
+  }
+  sk_surface_t* ss = sk_surface_new_raster_direct(si, data, 4 * width, NULL);
+  sk_imageinfo_delete(si);
+  if (!ss) {
+    free(data);
+    return "main: could not create sk_surface_t";
+  }
+  sk_canvas_t* sc = sk_surface_get_canvas(ss);
+  if (!sc) {
+    sk_surface_unref(ss);
+    free(data);
+    return "main: could not create sk_canvas_t";
+  }
+
+  *pb = ((pixel_buffer){0});
+  pb->data = data;
+  pb->width = width;
+  pb->height = height;
+  pb->canvas = iconvg_canvas__make_skia(sc);
+  pb->extra0 = ss;
+  return NULL;
+}
+
+const char*  //
+flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  return NULL;
+}
+
+const char*  //
+finalize_pixel_buffer(pixel_buffer* pb) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  if (pb->extra0) {
+    sk_surface_unref((sk_surface_t*)(pb->extra0));
+    pb->extra0 = NULL;
+  }
+  if (pb->data) {
+    free(pb->data);
+    pb->data = NULL;
+  }
+  return NULL;
+}
+
+#else  //  ICONVG_CONFIG__ETC
+
+// Without a third party graphics library, use IconVG's built-in rasterizer.
+
+const char*  //
+initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+
+  uint8_t* data = (uint8_t*)(calloc(4 * width * height, 1));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  size_t scratch_len = iconvg_rasterizer_scratch_len(width, height);
+  float* scratch = (float*)(malloc(scratch_len * sizeof(float)));
+  if (!scratch) {
+    free(data);
+    return "main: could not allocate rasterizer scratch memory";
+  }
+
+  *pb = ((pixel_buffer){0});
+  pb->data = data;
+  pb->width = width;
+  pb->height = height;
+  pb->canvas = iconvg_canvas__make_rasterizer(data, 4 * width, width, height,
+                                              scratch, scratch_len);
+  pb->extra0 = scratch;
+  return NULL;
+}
+
+const char*  //
+flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  // The rasterizer writes RGBA but write_png_to_file expects BGRA, like
+  // CAIRO_FORMAT_ARGB32 (on little-endian systems) and BGRA_8888_SK_COLORTYPE.
+  size_t n = 4 * ((size_t)(pb->width)) * ((size_t)(pb->height));
+  for (size_t i = 0; i < n; i += 4) {
+    uint8_t r = pb->data[i + 0];
+    pb->data[i + 0] = pb->data[i + 2];
+    pb->data[i + 2] = r;
+  }
+  return NULL;
+}
+
+const char*  //
+finalize_pixel_buffer(pixel_buffer* pb) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  if (pb->extra0) {
+    free(pb->extra0);
+    pb->extra0 = NULL;
+  }
+  if (pb->data) {
+    free(pb->data);
+    pb->data = NULL;
+  }
+  return NULL;
+}
+
+#endif  //  ICONVG_CONFIG__ETC
+
+// ----
+
+bool  //
+read_file(size_t* dst_num_bytes_read,
+          uint8_t* dst_buffer_ptr,
+          size_t dst_buffer_len,
+          FILE* src_file,
+          const char* src_filename) {
+  if (!dst_num_bytes_read || !src_file || !src_filename) {
+    return false;
+  }
+  *dst_num_bytes_read = 0;
+  uint8_t placeholder[1];
+  uint8_t* ptr = dst_buffer_ptr;
+  size_t len = dst_buffer_len;
+  while (true) {
+    if (!len) {
+      // We have read all that dst can hold. Check that we have read the full
+      // file by trying to read one more byte, which should fail with EOF.
+      ptr = placeholder;
+      len = 1;
+    }
+    size_t n = fread(ptr, 1, len, src_file);
+    if (ptr != placeholder) {
+      ptr += n;
+      len -= n;
+      *dst_num_bytes_read += n;
+    } else if (n) {
+      fprintf(stderr, "main: %s file size (in bytes) is too large\n",
+              src_filename);
+      return false;
+    }
+    if (feof(src_file)) {
+      break;
+    }
+    int err = ferror(src_file);
+    if (!err) {
+      continue;
+    } else if (err == EINTR) {
+      clearerr(src_file);
+      continue;
+    }
+    fprintf(stderr, "main: could not read %s: %s\n", src_filename,
+            strerror(err));
+    return false;
+  }
+  return true;
+}
+
+// ----
+
+// convert_to_nonpremul converts from premultiplied alpha to non-premultiplied
+// alpha. CAIRO_FORMAT_ARGB32 uses the former, as does Skia with
+// PREMUL_SK_ALPHATYPE and IconVG's built-in rasterizer. libpng uses the
+// latter.
+void  //
+convert_to_nonpremul(pixel_buffer* pb) {
+  for (uint32_t y = 0; y < pb->height; y++) {
+    const size_t bytes_per_pixel = 4;
+    uint8_t* row = pb->data + (y * bytes_per_pixel * pb->width);
+    for (uint32_t x = 0; x < pb->width; x++) {
+      uint8_t* rgba = row + (x * bytes_per_pixel);
+      if ((rgba[3] != 0x00) && (rgba[3] != 0xFF)) {
+        uint32_t a = rgba[3];
+        rgba[0] = (uint8_t)((rgba[0] * ((uint32_t)0xFF)) / a);
+        rgba[1] = (uint8_t)((rgba[1] * ((uint32_t)0xFF)) / a);
+        rgba[2] = (uint8_t)((rgba[2] * ((uint32_t)0xFF)) / a);
+      }
+    }
+  }
+}
+
+const char*  //
+write_png_to_file(pixel_buffer* pb, FILE* f) {
+  if (!pb || !f || (pb->width > 0x7FFF) || (pb->height > 0x7FFF)) {
+    return "main: invalid write_png_to_file argument";
+  }
+
+  const char* ret = NULL;
+  png_structp png = NULL;
+  png_infop info = NULL;
+  png_byte** rows = NULL;
+
+  {
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png) {
+      ret = "main: png_create_write_struct failed";
+      goto exit;
+    } else if (setjmp(png_jmpbuf(png))) {
+      ret = "main: libpng failed";
+      goto exit;
+    }
+
+    info = png_create_info_struct(png);
+    if (!info) {
+      ret = "main: png_create_info_struct failed";
+      goto exit;
+    }
+
+    rows = malloc(pb->height * sizeof(png_byte*));
+    for (uint32_t i = 0; i < pb->height; i++) {
+      const size_t bytes_per_pixel = 4;
+      rows[i] = pb->data + (i * bytes_per_pixel * pb->width);
+    }
+    png_init_io(png, f);
+    png_set_IHDR(png, info, pb->width, pb->height, 8, PNG_COLOR_TYPE_RGBA,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_set_rows(png, info, rows);
+    png_write_png(png, info, PNG_TRANSFORM_BGR, NULL);
+  }
+
+exit:
+  if (rows) {
+    free(rows);
+  }
+  if (png) {
+    png_destroy_write_struct(&png, &info);
+  }
+  return ret;
+}
+
+// ----
+
+// MAX_NUM_SIZES is the maximum number of -sizes values.
+#define MAX_NUM_SIZES 16
+
+typedef struct {
+  const char* input_filename;
+  uint8_t* src_ptr;
+  size_t src_len;
+} input_file;
+
+// sprite_info gives, for each atlas entry, which input and size it is.
+typedef struct {
+  uint32_t input_index;
+  uint32_t size;
+} sprite_info;
+
+// parse_u32 parses a decimal number, returning false if s is empty, not
+// a number or out of range.
+bool  //
+parse_u32(uint32_t* dst, const char* s, const char** end) {
+  uint64_t n = 0;
+  const char* p = s;
+  for (; (*p >= '0') && (*p <= '9'); p++) {
+    n = (10 * n) + ((uint64_t)(*p - '0'));
+    if (n > 0x7FFF) {
+      return false;
+    }
+  }
+  if (p == s) {
+    return false;
+  }
+  *dst = (uint32_t)n;
+  if (end) {
+    *end = p;
+  } else if (*p) {
+    return false;
+  }
+  return true;
+}
+
+// parse_sizes parses a comma-separated list of up to MAX_NUM_SIZES positive
+// numbers.
+bool  //
+parse_sizes(uint32_t* dst_sizes, uint32_t* dst_num_sizes, const char* s) {
+  for (uint32_t n = 0; n < MAX_NUM_SIZES;) {
+    if (!parse_u32(&dst_sizes[n], s, &s) || (dst_sizes[n] == 0)) {
+      return false;
+    }
+    n++;
+    if (*s == '\0') {
+      *dst_num_sizes = n;
+      return true;
+    } else if (*s != ',') {
+      return false;
+    }
+    s++;
+  }
+  return false;
+}
+
+// manifest_filename_for returns the output filename with its ".png" suffix
+// (if any) replaced by ".json". The caller is responsible for free'ing the
+// result.
+char*  //
+manifest_filename_for(const char* output_filename) {
+  size_t n = strlen(output_filename);
+  if ((n >= 4) && !strcmp(output_filename + n - 4, ".png")) {
+    n -= 4;
+  }
+  char* ret = (char*)(malloc(n + 6));
+  if (ret) {
+    memcpy(ret, output_filename, n);
+    memcpy(ret + n, ".json", 6);
+  }
+  return ret;
+}
+
+// write_json_string writes s as a double-quoted JSON string.
+void  //
+write_json_string(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    uint8_t c = (uint8_t)(*s);
+    if ((c == '"') || (c == '\\')) {
+      fprintf(f, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(f, "\\u%04X", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+const char*  //
+write_manifest_to_file(FILE* f,
+                       uint32_t atlas_width,
+                       uint32_t atlas_height,
+                       const input_file* inputs,
+                       const iconvg_atlas_entry* entries,
+                       const sprite_info* infos,
+                       size_t num_entries) {
+  fprintf(f, "{\"width\":%" PRIu32 ",\"height\":%" PRIu32 ",\"sprites\":[",
+          atlas_width, atlas_height);
+  for (size_t i = 0; i < num_entries; i++) {
+    const iconvg_atlas_entry* e = &entries[i];
+    fprintf(f, "%s\n  {\"file\":", i ? "," : "");
+    write_json_string(f, inputs[infos[i].input_index].input_filename);
+    fprintf(f,
+            ",\"size\":%" PRIu32 ",\"x\":%" PRIu32 ",\"y\":%" PRIu32
+            ",\"w\":%" PRIu32 ",\"h\":%" PRIu32
+            ",\"u0\":%.9g,\"v0\":%.9g,\"u1\":%.9g,\"v1\":%.9g}",
+            infos[i].size, e->x, e->y, e->width, e->height,
+            ((double)e->x) / atlas_width, ((double)e->y) / atlas_height,
+            ((double)e->x + e->width) / atlas_width,
+            ((double)e->y + e->height) / atlas_height);
+  }
+  fprintf(f, "\n]}\n");
+  return ferror(f) ? "main: could not write the manifest" : NULL;
+}
+
+// ----
+
+// render_atlas implements main, after parsing the flags. It returns whether
+// it succeeded.
+bool  //
+render_atlas(const char* output_filename,
+             const uint32_t* sizes,
+             uint32_t num_sizes,
+             uint32_t padding,
+             uint32_t max_side,
+             input_file* inputs,
+             uint32_t num_inputs) {
+  size_t num_entries = ((size_t)num_inputs) * num_sizes;
+  iconvg_atlas_entry* entries =
+      (iconvg_atlas_entry*)(calloc(num_entries, sizeof(iconvg_atlas_entry)));
+  sprite_info* infos = (sprite_info*)(calloc(num_entries, sizeof(sprite_info)));
+  size_t scratch_len = iconvg_atlas_scratch_len(num_entries);
+  uint32_t* scratch = (uint32_t*)(malloc(scratch_len * sizeof(uint32_t)));
+  if (!entries || !infos || !scratch || !scratch_len) {
+    fprintf(stderr, "main: could not allocate the atlas entries\n");
+    return false;
+  }
+
+  // Read each input's viewbox, for its aspect ratio.
+  for (uint32_t i = 0; i < num_inputs; i++) {
+    iconvg_rectangle_f32 viewbox = {0};
+    const char* err_msg =
+        iconvg_decode_viewbox(&viewbox, inputs[i].src_ptr, inputs[i].src_len);
+    if (err_msg) {
+      fprintf(stderr, "main: could not decode %s\n%s\n",
+              inputs[i].input_filename, err_msg);
+      return false;
+    }
+    for (uint32_t j = 0; j < num_sizes; j++) {
+      size_t k = (((size_t)i) * num_sizes) + j;
+      entries[k] = iconvg_atlas_entry__make(&viewbox, sizes[j]);
+      infos[k].input_index = i;
+      infos[k].size = sizes[j];
+    }
+  }
+
+  // Pack the sprites. Packing into the full max_side by max_side square
+  // tends to give a wide, short strip. Instead, start with a power-of-2 width
+  // close to the square root of the total area, doubling it until the sprites
+  // fit, for a squarer atlas.
+  uint32_t atlas_width = 0;
+  uint32_t atlas_height = 0;
+  {
+    uint64_t area = 0;
+    for (size_t k = 0; k < num_entries; k++) {
+      area += ((uint64_t)(entries[k].width + padding)) *
+              ((uint64_t)(entries[k].height + padding));
+    }
+    uint32_t max_width = 1;
+    while ((max_width < max_side) &&
+           ((((uint64_t)max_width) * max_width) < area)) {
+      max_width *= 2;
+    }
+    const char* err_msg = NULL;
+    while (true) {
+      max_width = (max_width < max_side) ? max_width : max_side;
+      err_msg = iconvg_atlas_pack(entries, num_entries, max_width, max_side,
+                                  padding, scratch, scratch_len, &atlas_width,
+                                  &atlas_height);
+      if ((err_msg != iconvg_error_system_failure_atlas_too_small) ||
+          (max_width == max_side)) {
+        break;
+      }
+      max_width *= 2;
+    }
+    if (err_msg) {
+      fprintf(stderr, "main: could not pack the atlas\n%s\n", err_msg);
+      return false;
+    } else if ((atlas_width == 0) || (atlas_height == 0)) {
+      fprintf(stderr, "main: cannot write an empty-sized PNG image");
+      return false;
+    }
+  }
+
+  // Render every sprite into the one pixel buffer.
+  pixel_buffer pb = {0};
+  {
+    const char* err_msg =
+        initialize_pixel_buffer(&pb, atlas_width, atlas_height);
+    if (err_msg) {
+      fprintf(stderr, "main: could not initialize the pixel buffer\n%s\n",
+              err_msg);
+      return false;
+    }
+  }
+  for (size_t k = 0; k < num_entries; k++) {
+    if ((entries[k].width == 0) || (entries[k].height == 0)) {
+      continue;
+    }
+    const input_file* in = &inputs[infos[k].input_index];
+    const char* err_msg =
+        iconvg_decode(&pb.canvas, iconvg_atlas_entry__dst_rect(&entries[k]),
+                      in->src_ptr, in->src_len, NULL);
+    if (err_msg) {
+      fprintf(stderr, "main: could not decode %s\n%s\n", in->input_filename,
+              err_msg);
+      return false;
+    }
+  }
+  {
+    const char* err_msg = flush_pixel_buffer(&pb, atlas_width, atlas_height);
+    if (err_msg) {
+      fprintf(stderr, "main: could not flush the pixel buffer\n%s\n", err_msg);
+      return false;
+    }
+  }
+  convert_to_nonpremul(&pb);
+
+  // Write the PNG and the manifest.
+  {
+    FILE* out = fopen(output_filename, "w");
+    if (!out) {
+      fprintf(stderr, "main: could not open %s: %s\n", output_filename,
+              strerror(errno));
+      return false;
+    }
+    const char* err_msg = write_png_to_file(&pb, out);
+    if (fclose(out) && !err_msg) {
+      err_msg = "main: could not close output file";
+    }
+    if (err_msg) {
+      fprintf(stderr, "main: could not write %s\n%s\n", output_filename,
+              err_msg);
+      return false;
+    }
+  }
+  {
+    char* manifest_filename = manifest_filename_for(output_filename);
+    FILE* out = manifest_filename ? fopen(manifest_filename, "w") : NULL;
+    if (!out) {
+      fprintf(stderr, "main: could not open the manifest for %s\n",
+              output_filename);
+      return false;
+    }
+    const char* err_msg =
+        write_manifest_to_file(out, atlas_width, atlas_height, inputs,
+                               entries, infos, num_entries);
+    if (fclose(out) && !err_msg) {
+      err_msg = "main: could not close output file";
+    }
+    if (err_msg) {
+      fprintf(stderr, "main: could not write %s\n%s\n", manifest_filename,
+              err_msg);
+      return false;
+    }
+    free(manifest_filename);
+  }
+
+  // No need to free entries, infos or scratch. The program is about to exit.
+  const char* err_msg = finalize_pixel_buffer(&pb);
+  if (err_msg) {
+    fprintf(stderr, "main: could not finalize the pixel buffer\n%s\n",
+            err_msg);
+    return false;
+  }
+  return true;
+}
+
+int  //
+main(int argc, char** argv) {
+  uint32_t sizes[MAX_NUM_SIZES] = {16, 32, 64};
+  uint32_t num_sizes = 3;
+  uint32_t padding = 1;
+  uint32_t max_side = 4096;
+
+  // Parse the flags.
+  int i = 1;
+  for (; (i + 1) < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* val = argv[i + 1];
+    bool ok = false;
+    if (!strcmp(arg, "-sizes")) {
+      ok = parse_sizes(&sizes[0], &num_sizes, val);
+    } else if (!strcmp(arg, "-padding")) {
+      ok = parse_u32(&padding, val, NULL);
+    } else if (!strcmp(arg, "-max")) {
+      ok = parse_u32(&max_side, val, NULL) && (max_side > 0);
+    } else {
+      break;
+    }
+    if (!ok) {
+      fprintf(stderr, "main: invalid %s value: %s\n", arg, val);
+      return 1;
+    }
+  }
+  if ((argc - i) < 2) {
+    fprintf(stderr,
+            "Usage: %s [flags] output.png input0.ivg input1.ivg etc\n"
+            "Flags:\n"
+            "    -sizes S0,S1,etc  sprite sizes (default: 16,32,64)\n"
+            "    -padding N        gap between sprites (default: 1)\n"
+            "    -max N            maximum atlas side (default: 4096)\n",
+            argv[0]);
+    return 1;
+  }
+  const char* output_filename = argv[i];
+  int num_inputs = argc - i - 1;
+  char** filenames = argv + i + 1;
+
+  // Read the input bytes.
+  input_file* inputs = (input_file*)(calloc(num_inputs, sizeof(input_file)));
+  if (!inputs) {
+    fprintf(stderr, "main: could not allocate the inputs\n");
+    return 1;
+  }
+  for (int j = 0; j < num_inputs; j++) {
+    input_file* in = &inputs[j];
+    in->input_filename = filenames[j];
+    FILE* f = fopen(in->input_filename, "r");
+    if (!f) {
+      fprintf(stderr, "main: could not open %s: %s\n", in->input_filename,
+              strerror(errno));
+      return 1;
+    }
+    bool ok = read_file(&in->src_len, &g_src_buffer_array[0],
+                        SRC_BUFFER_ARRAY_SIZE, f, in->input_filename);
+    fclose(f);
+    in->src_ptr = ok ? (uint8_t*)(malloc(in->src_len + 1)) : NULL;
+    if (!in->src_ptr) {
+      return 1;
+    }
+    memcpy(in->src_ptr, &g_src_buffer_array[0], in->src_len);
+  }
+
+  return render_atlas(output_filename, sizes, num_sizes, padding, max_side,
+                      inputs, (uint32_t)num_inputs)
+             ? 0
+             : 1;
+}
@@ -0,0 +1,609 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-bench measures how long it takes to decode and render IconVG files.
+//
+// See the top-level build-example-etc.sh scripts for build parameters.
+//
+// Usage: iconvg-bench [-t millis] input0.ivg input1.ivg etc
+//     e.g. gen/bin/iconvg-bench-with-cairo test/data/*.ivg
+//
+// For each input file, it runs these benchmarks:
+//   - DecodeBroken:    decode into a no-op iconvg_canvas__make_broken(NULL).
+//   - DecodeDebug:     decode into an iconvg_canvas__make_debug that logs to
+//                      /dev/null, wrapping that no-op canvas.
+//   - DecodeStats:     decode into an iconvg_canvas__make_stats that counts
+//                      and times calls, wrapping that no-op canvas.
+//   - DecodeStatsSampled: like DecodeStats but only timing 1 in every
+//                      STATS_SAMPLE_INTERVAL calls of each method.
+//   - RenderEtcN:      decode into the compile-time configured backend (Cairo,
+//                      Skia or IconVG's built-in rasterizer) at N×N pixels,
+//                      for N in 64, 256 and 1024.
+//   - PlayEtcN:        play an animation (see NUM_FRAMES) of the iconvg_compile
+//                      compiled form, with an iconvg_player, into that backend
+//                      at N×N pixels. Each frame has a new transform and alpha.
+//   - PlayTintEtcN:    like PlayEtcN but only the alpha animates. With the
+//                      built-in rasterizer, the player then composites cached
+//                      coverage masks instead of rasterizing each frame.
+//   - PlayTintUncachedEtcN:
+//                      like PlayTintEtcN but without coverage masks, so that
+//                      every frame is rasterized. PlayEtcN frames are mostly
+//                      smaller than full size, so this is the fair baseline
+//                      for PlayTintEtcN.
+//
+// Each benchmark runs for at least the -t duration (default: 250
+// milliseconds). Output lines follow the format of Go's "go test -bench"
+// (with the file name as the sub-benchmark name), so that tools like
+// benchstat can compare two runs. Each line reports nanoseconds, source
+// (IconVG) bytes and paths per iteration, as well as bytes and paths per
+// second.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+// SRC_BUFFER_ARRAY_SIZE is the largest size (in bytes) for .ivg files
+// supported by this program.
+//
+// This is 1 MiB (1024 * 1024 = 1048576 bytes) by default, but can be
+// configured by compiling with -DSRC_BUFFER_ARRAY_SIZE=etc.
+#ifndef SRC_BUFFER_ARRAY_SIZE
+#define SRC_BUFFER_ARRAY_SIZE 1048576
+#endif
+uint8_t g_src_buffer_array[SRC_BUFFER_ARRAY_SIZE];
+
+// MAX_ITERATIONS caps the number of iterations of any one benchmark.
+#define MAX_ITERATIONS 1000000000
+
+// NUM_FRAMES is the length, in frames, of the Play benchmarks' animation
+// loop: one second at 60 frames per second.
+#define NUM_FRAMES 60
+
+// STATS_SAMPLE_INTERVAL is the DecodeStatsSampled benchmark's
+// iconvg_canvas_stats sample_interval.
+#define STATS_SAMPLE_INTERVAL 64
+
+typedef struct {
+  iconvg_canvas canvas;
+  uint32_t width;
+  uint32_t height;
+  void* extra0;
+  void* extra1;
+} render_target;
+
+// ----
+
+#if defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+
+#include <cairo/cairo.h>
+
+#define BACKEND_NAME "Cairo"
+
+const char*  //
+initialize_render_target(render_target* rt, uint32_t width, uint32_t height) {
+  if (!rt) {
+    return "main: NULL render_target";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+  cairo_surface_t* cs =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)width, (int)height);
+  cairo_t* cr = cairo_create(cs);
+
+  *rt = ((render_target){0});
+  rt->width = width;
+  rt->height = height;
+  rt->canvas = iconvg_canvas__make_cairo(cr);
+  rt->extra0 = cs;
+  rt->extra1 = cr;
+  return NULL;
+}
+
+void  //
+finalize_render_target(render_target* rt) {
+  if (rt->extra1) {
+    cairo_destroy((cairo_t*)(rt->extra1));
+    rt->extra1 = NULL;
+  }
+  if (rt->extra0) {
+    cairo_surface_destroy((cairo_surface_t*)(rt->extra0));
+    rt->extra0 = NULL;
+  }
+}
+
+#elif defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+
+#include "include/c/sk_imageinfo.h"
+#include "include/c/sk_surface.h"
+
+#define BACKEND_NAME "Skia"
+
+const char*  //
+initialize_render_target(render_target* rt, uint32_t width, uint32_t height) {
+  if (!rt) {
+    return "main: NULL render_target";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+
+  uint8_t* data = (uint8_t*)(malloc(4 * width * height));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+
+  sk_imageinfo_t* si =
+      sk_imageinfo_new((int)width, (int)height, BGRA_8888_SK_COLORTYPE,
+                       PREMUL_SK_ALPHATYPE, NULL);
+  if (!si) {
+    free(data);
+    return "main: could not create sk_imageinfo_t";
+  }
+  sk_surface_t* ss = sk_surface_new_raster_direct(si, data, 4 * width, NULL);
+  sk_imageinfo_delete(si);
+  if (!ss) {
+    free(data);
+    return "main: could not create sk_surface_t";
+  }
+  sk_canvas_t* sc = sk_surface_get_canvas(ss);
+  if (!sc) {
+    sk_surface_unref(ss);
+    free(data);
+    return "main: could not create sk_canvas_t";
+  }
+
+  *rt = ((render_target){0});
+  rt->width = width;
+  rt->height = height;
+  rt->canvas = iconvg_canvas__make_skia(sc);
+  rt->extra0 = ss;
+  rt->extra1 = data;
+  return NULL;
+}
+
+void  //
+finalize_render_target(render_target* rt) {
+  if (rt->extra0) {
+    sk_surface_unref((sk_surface_t*)(rt->extra0));
+    rt->extra0 = NULL;
+  }
+  if (rt->extra1) {
+    free(rt->extra1);
+    rt->extra1 = NULL;
+  }
+}
+
+#else  //  ICONVG_CONFIG__ETC
+
+// Without a third party graphics library, use IconVG's built-in rasterizer.
+
+#define BACKEND_NAME "Rasterizer"
+
+const char*  //
+initialize_render_target(render_target* rt, uint32_t width, uint32_t height) {
+  if (!rt) {
+    return "main: NULL render_target";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+
+  uint8_t* data = (uint8_t*)(calloc(4 * width * height, 1));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  size_t scratch_len = iconvg_rasterizer_scratch_len(width, height);
+  float* scratch = (float*)(malloc(scratch_len * sizeof(float)));
+  if (!scratch) {
+    free(data);
+    return "main: could not allocate rasterizer scratch memory";
+  }
+
+  *rt = ((render_target){0});
+  rt->width = width;
+  rt->height = height;
+  rt->canvas = iconvg_canvas__make_rasterizer(data, 4 * width, width, height,
+                                              scratch, scratch_len);
+  rt->extra0 = data;
+  rt->extra1 = scratch;
+  return NULL;
+}
+
+void  //
+finalize_render_target(render_target* rt) {
+  if (rt->extra1) {
+    free(rt->extra1);
+    rt->extra1 = NULL;
+  }
+  if (rt->extra0) {
+    free(rt->extra0);
+    rt->extra0 = NULL;
+  }
+}
+
+#endif  //  ICONVG_CONFIG__ETC
+
+// render_target__play renders one frame of p to rt.
+const char*  //
+render_target__play(render_target* rt,
+                    iconvg_player* p,
+                    const iconvg_player_frame* frame) {
+  iconvg_rectangle_f32 r =
+      iconvg_rectangle_f32__make(0, 0, (float)(rt->width), (float)(rt->height));
+#if defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND) || \
+    defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+  return iconvg_player__render(p, &rt->canvas, r, frame);
+#else
+  size_t scratch_len = iconvg_rasterizer_scratch_len(rt->width, rt->height);
+  return iconvg_player__render_pixels(
+      p, (uint8_t*)(rt->extra0), 4 * rt->width, rt->width, rt->height,
+      (float*)(rt->extra1), scratch_len, r, frame);
+#endif
+}
+
+// ----
+
+// count_paths returns the number of paths that decoding src creates, or
+// SIZE_MAX if src is not valid IconVG. It measures each input's "paths per
+// iteration".
+size_t  //
+count_paths(const uint8_t* src_ptr, size_t src_len) {
+  iconvg_canvas_stats stats = {0};
+  iconvg_canvas c = iconvg_canvas__make_stats(&stats, NULL);
+  iconvg_rectangle_f32 r = iconvg_rectangle_f32__make(0, 0, 256, 256);
+  if (iconvg_decode(&c, r, src_ptr, src_len, NULL)) {
+    return SIZE_MAX;
+  }
+  return (size_t)(stats.num_paths);
+}
+
+// ----
+
+int64_t  //
+now_nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((int64_t)(ts.tv_sec)) * 1000000000) + ((int64_t)(ts.tv_nsec));
+}
+
+// stats_clock is an iconvg_canvas_stats clock_func.
+uint64_t  //
+stats_clock(void* clock_context) {
+  return (uint64_t)(now_nanos());
+}
+
+// bench_func runs the i'th iteration of a benchmark.
+typedef const char* (*bench_func)(void* context, int64_t i);
+
+// decode_context is the bench_func context for decode_func.
+typedef struct {
+  iconvg_canvas* canvas;
+  iconvg_rectangle_f32 dst_rect;
+  const uint8_t* src_ptr;
+  size_t src_len;
+} decode_context;
+
+// decode_func is a bench_func that decodes the source to the canvas.
+const char*  //
+decode_func(void* context, int64_t i) {
+  decode_context* d = (decode_context*)context;
+  return iconvg_decode(d->canvas, d->dst_rect, d->src_ptr, d->src_len, NULL);
+}
+
+// play_context is the bench_func context for play_func.
+typedef struct {
+  render_target* rt;
+  iconvg_player* player;
+  const iconvg_player_frame* frames;
+} play_context;
+
+// play_func is a bench_func that renders the (i % NUM_FRAMES)'th frame.
+const char*  //
+play_func(void* context, int64_t i) {
+  play_context* p = (play_context*)context;
+  return render_target__play(p->rt, p->player, &p->frames[i % NUM_FRAMES]);
+}
+
+// run_benchmark calls f repeatedly, growing the iteration count (like Go's
+// testing package) until one round of iterations lasts at least min_nanos,
+// and prints the final round's results.
+const char*  //
+run_benchmark(const char* bench_name,
+              const char* file_name,
+              bench_func f,
+              void* context,
+              size_t src_len,
+              size_t num_paths,
+              int64_t min_nanos) {
+  int64_t n = 1;
+  while (true) {
+    int64_t t0 = now_nanos();
+    for (int64_t i = 0; i < n; i++) {
+      const char* err_msg = (*f)(context, i);
+      if (err_msg) {
+        return err_msg;
+      }
+    }
+    int64_t elapsed = now_nanos() - t0;
+
+    if ((elapsed >= min_nanos) || (n >= MAX_ITERATIONS)) {
+      double ns_per_op = ((double)elapsed) / ((double)n);
+      double seconds = ((double)(elapsed > 0 ? elapsed : 1)) / 1e9;
+      printf("Benchmark%s/%s\t%10" PRIi64 "\t%14.0f ns/op\t%10.2f MB/s"
+             "\t%8zu src_bytes/op\t%6zu paths/op\t%14.0f paths/s\n",
+             bench_name, file_name, n, ns_per_op,
+             ((double)src_len) * ((double)n) / (seconds * 1e6), src_len,
+             num_paths, ((double)num_paths) * ((double)n) / seconds);
+      fflush(stdout);
+      return NULL;
+    }
+
+    // Predict the iteration count for min_nanos, overshooting by 20% and
+    // growing by at least 2x and at most 100x per round.
+    int64_t prev = n;
+    n = (int64_t)(1.2 * ((double)min_nanos) * ((double)prev) /
+                  ((double)(elapsed > 0 ? elapsed : 1)));
+    if (n < (2 * prev)) {
+      n = 2 * prev;
+    } else if (n > (100 * prev)) {
+      n = 100 * prev;
+    }
+    if (n > MAX_ITERATIONS) {
+      n = MAX_ITERATIONS;
+    }
+  }
+}
+
+// base_name returns the part of filename after its last '/'.
+const char*  //
+base_name(const char* filename) {
+  const char* slash = strrchr(filename, '/');
+  return slash ? (slash + 1) : filename;
+}
+
+// make_frames sets the Play benchmarks' animation frames for a size×size
+// render target. Each frame's alpha pulses down to 0.25 and back up. If
+// animate_transform, the graphic also scales in, about its center, from half
+// to full size.
+void  //
+make_frames(iconvg_player_frame* frames,
+            uint32_t size,
+            bool animate_transform) {
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    double t = ((double)i) / ((double)NUM_FRAMES);
+    frames[i] = iconvg_player_frame__make();
+    double pulse = (t < 0.5) ? (0.5 - t) : (t - 0.5);
+    frames[i].alpha = (float)(0.25 + (1.5 * pulse));
+    if (animate_transform) {
+      double scale = 0.5 + (0.5 * t);
+      double bias = (1.0 - scale) * 0.5 * ((double)size);
+      frames[i].transform =
+          iconvg_matrix_2x3_f64__make(scale, 0, bias, 0, scale, bias);
+    }
+  }
+}
+
+// bench_play runs the Play benchmarks for one input file.
+const char*  //
+bench_play(const char* name,
+           const uint8_t* src_ptr,
+           size_t src_len,
+           size_t num_paths,
+           int64_t min_nanos) {
+  size_t compiled_len = 0;
+  const char* err_msg =
+      iconvg_compile(NULL, 0, &compiled_len, src_ptr, src_len);
+  if (err_msg != iconvg_error_system_failure_dst_buffer_too_short) {
+    return err_msg ? err_msg : "main: could not size the compiled form";
+  }
+  uint8_t* compiled_ptr = (uint8_t*)(malloc(compiled_len));
+  if (!compiled_ptr) {
+    return "main: could not allocate the compiled form";
+  }
+  err_msg = iconvg_compile(compiled_ptr, compiled_len, &compiled_len, src_ptr,
+                           src_len);
+
+  static const uint32_t sizes[3] = {64, 256, 1024};
+  for (int i = 0; !err_msg && (i < 3); i++) {
+    uint32_t size = sizes[i];
+    render_target rt;
+    err_msg = initialize_render_target(&rt, size, size);
+    if (err_msg) {
+      break;
+    }
+
+    // The coverage masks take at most a byte per covered pixel, plus small
+    // per drawing and per row headers. A full size (untransformed) frame
+    // covers the most, so record one to find out how much buffer every frame
+    // needs.
+    iconvg_coverage_masks masks;
+    uint8_t empty_masks_buf[1];
+    iconvg_coverage_masks__initialize(&masks, &empty_masks_buf[0], 0);
+    uint8_t* masks_buf = NULL;
+    iconvg_player_frame frames[NUM_FRAMES];
+    iconvg_player player;
+    play_context p = {0};
+    p.rt = &rt;
+    p.player = &player;
+    p.frames = frames;
+
+    static const char* variants[3] = {"", "Tint", "TintUncached"};
+    for (int j = 0; !err_msg && (j < 3); j++) {
+      bool tint = j >= 1;
+      make_frames(frames, size, !tint);
+      err_msg = iconvg_player__initialize(&player, compiled_ptr, compiled_len,
+                                          NULL, (j == 2) ? NULL : &masks);
+      if (!err_msg && !masks_buf) {
+        err_msg = render_target__play(&rt, &player, NULL);
+        size_t n = iconvg_coverage_masks__required_len(&masks);
+        masks_buf = (uint8_t*)(malloc(n ? n : 1));
+        if (!masks_buf) {
+          err_msg = "main: could not allocate coverage masks";
+          break;
+        }
+        iconvg_coverage_masks__initialize(&masks, masks_buf, n);
+      }
+      char bench_name[64];
+      snprintf(bench_name, sizeof(bench_name), "Play%s%s%u", variants[j],
+               BACKEND_NAME, (unsigned int)size);
+      if (!err_msg) {
+        err_msg = run_benchmark(bench_name, name, &play_func, &p, src_len,
+                                num_paths, min_nanos);
+      }
+    }
+    free(masks_buf);
+    finalize_render_target(&rt);
+  }
+  free(compiled_ptr);
+  return err_msg;
+}
+
+// bench_file runs all of the benchmarks for one input file.
+const char*  //
+bench_file(const char* filename, FILE* devnull, int64_t min_nanos) {
+  FILE* f = fopen(filename, "rb");
+  if (!f) {
+    return strerror(errno);
+  }
+  size_t src_len =
+      fread(g_src_buffer_array, 1, sizeof(g_src_buffer_array), f);
+  bool too_large = (src_len == sizeof(g_src_buffer_array)) && !feof(f);
+  bool failed = ferror(f);
+  fclose(f);
+  if (too_large) {
+    return "main: file size (in bytes) is too large";
+  } else if (failed) {
+    return "main: could not read file";
+  }
+  const uint8_t* src_ptr = g_src_buffer_array;
+
+  size_t num_paths = count_paths(src_ptr, src_len);
+  if (num_paths == SIZE_MAX) {
+    return "main: could not decode file";
+  }
+  const char* name = base_name(filename);
+  const char* err_msg = NULL;
+
+  decode_context d = {0};
+  d.dst_rect = iconvg_rectangle_f32__make(0, 0, 256, 256);
+  d.src_ptr = src_ptr;
+  d.src_len = src_len;
+
+  iconvg_canvas broken = iconvg_canvas__make_broken(NULL);
+  d.canvas = &broken;
+  err_msg = run_benchmark("DecodeBroken", name, &decode_func, &d, src_len,
+                          num_paths, min_nanos);
+  if (err_msg) {
+    return err_msg;
+  }
+
+  if (devnull) {
+    iconvg_canvas debug = iconvg_canvas__make_debug(devnull, "", &broken);
+    d.canvas = &debug;
+    err_msg = run_benchmark("DecodeDebug", name, &decode_func, &d, src_len,
+                            num_paths, min_nanos);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+
+  iconvg_canvas_stats stats = {0};
+  stats.clock_func = &stats_clock;
+  iconvg_canvas stats_canvas = iconvg_canvas__make_stats(&stats, &broken);
+  d.canvas = &stats_canvas;
+  err_msg = run_benchmark("DecodeStats", name, &decode_func, &d, src_len,
+                          num_paths, min_nanos);
+  if (err_msg) {
+    return err_msg;
+  }
+  stats.sample_interval = STATS_SAMPLE_INTERVAL;
+  err_msg = run_benchmark("DecodeStatsSampled", name, &decode_func, &d,
+                          src_len, num_paths, min_nanos);
+  if (err_msg) {
+    return err_msg;
+  }
+
+  static const uint32_t sizes[3] = {64, 256, 1024};
+  for (int i = 0; i < 3; i++) {
+    uint32_t size = sizes[i];
+    render_target rt;
+    err_msg = initialize_render_target(&rt, size, size);
+    if (err_msg) {
+      return err_msg;
+    }
+    char bench_name[64];
+    snprintf(bench_name, sizeof(bench_name), "Render%s%u", BACKEND_NAME,
+             (unsigned int)size);
+    d.canvas = &rt.canvas;
+    d.dst_rect = iconvg_rectangle_f32__make(0, 0, (float)size, (float)size);
+    err_msg = run_benchmark(bench_name, name, &decode_func, &d, src_len,
+                            num_paths, min_nanos);
+    finalize_render_target(&rt);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+
+  return bench_play(name, src_ptr, src_len, num_paths, min_nanos);
+}
+
+int  //
+main(int argc, char** argv) {
+  int64_t min_nanos = 250 * 1000000;
+  int i = 1;
+  if ((i + 1 < argc) && !strcmp(argv[i], "-t")) {
+    long millis = strtol(argv[i + 1], NULL, 10);
+    if (millis <= 0) {
+      fprintf(stderr, "main: invalid -t argument\n");
+      return 1;
+    }
+    min_nanos = ((int64_t)millis) * 1000000;
+    i += 2;
+  }
+  if (i >= argc) {
+    fprintf(stderr, "usage: %s [-t millis] input0.ivg input1.ivg etc\n",
+            argv[0]);
+    return 1;
+  }
+
+  FILE* devnull = fopen("/dev/null", "w");
+  int num_failures = 0;
+  for (; i < argc; i++) {
+    const char* err_msg = bench_file(argv[i], devnull, min_nanos);
+    if (err_msg) {
+      fprintf(stderr, "main: %s: %s\n", argv[i], err_msg);
+      num_failures++;
+    }
+  }
+  if (devnull) {
+    fclose(devnull);
+  }
+  return num_failures ? 1 : 0;
+}
@@ -18,14 +18,30 @@
 //
 // Usage: iconvg-to-png input.ivg > output.png
 //     If input.ivg is omitted, it reads from stdin.
+//
+// Usage: iconvg-to-png -j N input0.ivg input1.ivg etc
+//     This batch mode writes each inputI.png alongside its inputI.ivg,
+//     decoding up to N files in parallel (if the IconVG library was built with
+//     ICONVG_CONFIG__ENABLE_PTHREADS).
+//
+// Usage: iconvg-to-png -pack input.ivgpack name > output.png
+//     This reads the named graphic from an icon pack (see cmd/iconvg-pack),
+//     memory-mapping the pack instead of reading it.
+
+// mmap and friends are POSIX, not C99.
+#define _POSIX_C_SOURCE 200809L
 
 #include <errno.h>
+#include <fcntl.h>
 #include <png.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // IconVG ships as a "single file C library" or "header file library" as per
 // https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
@@ -185,24 +201,67 @@ finalize_pixel_buffer(pixel_buffer* pb) {
 
 #else  //  ICONVG_CONFIG__ETC
 
+// Without a third party graphics library, use IconVG's built-in rasterizer.
+
 const char*  //
 initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
   if (!pb) {
     return "main: NULL pixel_buffer";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+
+  uint8_t* data = (uint8_t*)(calloc(4 * width * height, 1));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  size_t scratch_len = iconvg_rasterizer_scratch_len(width, height);
+  float* scratch = (float*)(malloc(scratch_len * sizeof(float)));
+  if (!scratch) {
+    free(data);
+    return "main: could not allocate rasterizer scratch memory";
   }
+
   *pb = ((pixel_buffer){0});
-  pb->canvas = iconvg_canvas__make_broken("main: no IconVG backend configured");
+  pb->data = data;
+  pb->width = width;
+  pb->height = height;
+  pb->canvas = iconvg_canvas__make_rasterizer(data, 4 * width, width, height,
+                                              scratch, scratch_len);
+  pb->extra0 = scratch;
   return NULL;
 }
 
 const char*  //
 flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
-  return "main: no IconVG backend configured";
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  // The rasterizer writes RGBA but write_png_to_file expects BGRA, like
+  // CAIRO_FORMAT_ARGB32 (on little-endian systems) and BGRA_8888_SK_COLORTYPE.
+  size_t n = 4 * ((size_t)(pb->width)) * ((size_t)(pb->height));
+  for (size_t i = 0; i < n; i += 4) {
+    uint8_t r = pb->data[i + 0];
+    pb->data[i + 0] = pb->data[i + 2];
+    pb->data[i + 2] = r;
+  }
+  return NULL;
 }
 
 const char*  //
 finalize_pixel_buffer(pixel_buffer* pb) {
-  return "main: no IconVG backend configured";
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  if (pb->extra0) {
+    free(pb->extra0);
+    pb->extra0 = NULL;
+  }
+  if (pb->data) {
+    free(pb->data);
+    pb->data = NULL;
+  }
+  return NULL;
 }
 
 #endif  //  ICONVG_CONFIG__ETC
@@ -256,12 +315,86 @@ read_file(size_t* dst_num_bytes_read,
   return true;
 }
 
+// map_icon_pack memory-maps (read-only) the pack_filename icon pack and looks
+// up the named graphic, pointing *dst_src_ptr and *dst_src_len into the
+// mapping. There is no need to explicitly unmap it later. The program exits
+// (and releases all mappings) when main returns.
+bool  //
+map_icon_pack(const uint8_t** dst_src_ptr,
+              size_t* dst_src_len,
+              const char* pack_filename,
+              const char* name) {
+  int fd = open(pack_filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "main: could not open %s: %s\n", pack_filename,
+            strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "main: could not stat %s: %s\n", pack_filename,
+            strerror(errno));
+    close(fd);
+    return false;
+  } else if ((st.st_size <= 0) || ((uint64_t)st.st_size > SIZE_MAX)) {
+    fprintf(stderr, "main: %s has an unsupported file size\n", pack_filename);
+    close(fd);
+    return false;
+  }
+  size_t len = (size_t)st.st_size;
+  void* ptr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "main: could not mmap %s: %s\n", pack_filename,
+            strerror(errno));
+    return false;
+  }
+
+  iconvg_icon_pack pack;
+  const char* err_msg =
+      iconvg_icon_pack__initialize(&pack, (const uint8_t*)ptr, len);
+  if (err_msg) {
+    fprintf(stderr, "main: could not read %s\n%s\n", pack_filename, err_msg);
+    return false;
+  }
+  iconvg_icon_pack_entry entry;
+  if (!iconvg_icon_pack__lookup(&pack, &entry, name, strlen(name))) {
+    fprintf(stderr, "main: %s has no graphic named %s\n", pack_filename,
+            name);
+    return false;
+  }
+  *dst_src_ptr = entry.src_ptr;
+  *dst_src_len = entry.src_len;
+  return true;
+}
+
 // ----
 
+// convert_to_nonpremul converts from premultiplied alpha to non-premultiplied
+// alpha. CAIRO_FORMAT_ARGB32 uses the former, as does Skia with
+// PREMUL_SK_ALPHATYPE and IconVG's built-in rasterizer. libpng uses the
+// latter.
+void  //
+convert_to_nonpremul(pixel_buffer* pb) {
+  for (uint32_t y = 0; y < pb->height; y++) {
+    const size_t bytes_per_pixel = 4;
+    uint8_t* row = pb->data + (y * bytes_per_pixel * pb->width);
+    for (uint32_t x = 0; x < pb->width; x++) {
+      uint8_t* rgba = row + (x * bytes_per_pixel);
+      if ((rgba[3] != 0x00) && (rgba[3] != 0xFF)) {
+        uint32_t a = rgba[3];
+        rgba[0] = (uint8_t)((rgba[0] * ((uint32_t)0xFF)) / a);
+        rgba[1] = (uint8_t)((rgba[1] * ((uint32_t)0xFF)) / a);
+        rgba[2] = (uint8_t)((rgba[2] * ((uint32_t)0xFF)) / a);
+      }
+    }
+  }
+}
+
 const char*  //
-write_png_to_stdout(pixel_buffer* pb) {
-  if (!pb || (pb->width > 0x7FFF) || (pb->height > 0x7FFF)) {
-    return "main: invalid write_png_to_stdout argument";
+write_png_to_file(pixel_buffer* pb, FILE* f) {
+  if (!pb || !f || (pb->width > 0x7FFF) || (pb->height > 0x7FFF)) {
+    return "main: invalid write_png_to_file argument";
   }
 
   const char* ret = NULL;
@@ -290,7 +423,7 @@ write_png_to_stdout(pixel_buffer* pb) {
       const size_t bytes_per_pixel = 4;
       rows[i] = pb->data + (i * bytes_per_pixel * pb->width);
     }
-    png_init_io(png, stdout);
+    png_init_io(png, f);
     png_set_IHDR(png, info, pb->width, pb->height, 8, PNG_COLOR_TYPE_RGBA,
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
                  PNG_FILTER_TYPE_DEFAULT);
@@ -310,13 +443,163 @@ exit:
 
 // ----
 
+// BATCH_SIZE is the maximum number of files that batch mode holds in memory
+// (and passes to one iconvg_decode_batch call) at a time.
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 256
+#endif
+
+typedef struct {
+  const char* input_filename;
+  uint8_t* src_ptr;
+  size_t src_len;
+  pixel_buffer pb;
+} batch_item;
+
+// output_filename_for returns the input filename with its ".ivg" suffix (if
+// any) replaced by ".png". The caller is responsible for free'ing the result.
+char*  //
+output_filename_for(const char* input_filename) {
+  size_t n = strlen(input_filename);
+  if ((n >= 4) && !strcmp(input_filename + n - 4, ".ivg")) {
+    n -= 4;
+  }
+  char* ret = (char*)(malloc(n + 5));
+  if (ret) {
+    memcpy(ret, input_filename, n);
+    memcpy(ret + n, ".png", 5);
+  }
+  return ret;
+}
+
+// main_batch implements "iconvg-to-png -j N etc". It returns the number of
+// files that it failed to convert.
+int  //
+main_batch(uint32_t num_threads, int num_files, char** filenames) {
+  // pixel_width and pixel_height match main's single file mode.
+  const uint32_t pixel_width = 256;
+  const uint32_t pixel_height = 256;
+
+  int num_failures = 0;
+  batch_item items[BATCH_SIZE];
+  iconvg_decode_job jobs[BATCH_SIZE];
+  while (num_files > 0) {
+    int n = (num_files < BATCH_SIZE) ? num_files : BATCH_SIZE;
+    int num_jobs = 0;
+
+    // Read the input bytes and initialize the pixel buffers.
+    for (int i = 0; i < n; i++) {
+      batch_item* item = &items[num_jobs];
+      *item = ((batch_item){0});
+      item->input_filename = filenames[i];
+      FILE* in = fopen(item->input_filename, "r");
+      if (!in) {
+        fprintf(stderr, "main: could not open %s: %s\n", item->input_filename,
+                strerror(errno));
+        num_failures++;
+        continue;
+      }
+      bool ok = read_file(&item->src_len, &g_src_buffer_array[0],
+                          SRC_BUFFER_ARRAY_SIZE, in, item->input_filename);
+      fclose(in);
+      item->src_ptr = ok ? (uint8_t*)(malloc(item->src_len + 1)) : NULL;
+      if (!item->src_ptr) {
+        num_failures++;
+        continue;
+      }
+      memcpy(item->src_ptr, &g_src_buffer_array[0], item->src_len);
+
+      const char* err_msg =
+          initialize_pixel_buffer(&item->pb, pixel_width, pixel_height);
+      if (err_msg) {
+        fprintf(stderr, "main: could not initialize the pixel buffer\n%s\n",
+                err_msg);
+        free(item->src_ptr);
+        num_failures++;
+        continue;
+      }
+
+      iconvg_decode_job* job = &jobs[num_jobs];
+      *job = ((iconvg_decode_job){0});
+      job->dst_canvas = &item->pb.canvas;
+      job->dst_rect =
+          iconvg_rectangle_f32__make(0, 0, pixel_width, pixel_height);
+      job->src_ptr = item->src_ptr;
+      job->src_len = item->src_len;
+      num_jobs++;
+    }
+
+    // Decode the IconVG files, in parallel.
+    iconvg_decode_batch(&jobs[0], (size_t)num_jobs, num_threads);
+
+    // Write the PNGs and clean up.
+    for (int i = 0; i < num_jobs; i++) {
+      batch_item* item = &items[i];
+      const char* err_msg = jobs[i].err_msg;
+      if (err_msg) {
+        fprintf(stderr, "main: could not decode %s\n%s\n",
+                item->input_filename, err_msg);
+      } else {
+        err_msg = flush_pixel_buffer(&item->pb, pixel_width, pixel_height);
+        if (err_msg) {
+          fprintf(stderr, "main: could not flush the pixel buffer\n%s\n",
+                  err_msg);
+        }
+      }
+      if (!err_msg) {
+        convert_to_nonpremul(&item->pb);
+        char* output_filename = output_filename_for(item->input_filename);
+        FILE* out = output_filename ? fopen(output_filename, "w") : NULL;
+        if (!out) {
+          err_msg = "main: could not open output file";
+          fprintf(stderr, "main: could not open %s\n",
+                  output_filename ? output_filename : item->input_filename);
+        } else {
+          err_msg = write_png_to_file(&item->pb, out);
+          if (fclose(out) && !err_msg) {
+            err_msg = "main: could not close output file";
+          }
+          if (err_msg) {
+            fprintf(stderr, "main: could not write %s\n%s\n", output_filename,
+                    err_msg);
+          }
+        }
+        free(output_filename);
+      }
+      if (err_msg) {
+        num_failures++;
+      }
+      finalize_pixel_buffer(&item->pb);
+      free(item->src_ptr);
+    }
+
+    filenames += n;
+    num_files -= n;
+  }
+  return num_failures;
+}
+
 int  //
 main(int argc, char** argv) {
+  if ((argc >= 2) && !strcmp(argv[1], "-j")) {
+    int num_threads = (argc >= 3) ? atoi(argv[2]) : 0;
+    if (num_threads <= 0) {
+      fprintf(stderr, "main: -j needs a positive number of threads\n");
+      return 1;
+    }
+    return main_batch((uint32_t)num_threads, argc - 3, argv + 3) ? 1 : 0;
+  }
+
   // Read the input bytes.
   const char* input_filename = NULL;
-  uint8_t* src_ptr = &g_src_buffer_array[0];
+  const uint8_t* src_ptr = &g_src_buffer_array[0];
   size_t src_len = 0;
-  {
+  if ((argc == 4) && !strcmp(argv[1], "-pack")) {
+    input_filename = argv[3];
+    if (!map_icon_pack(&src_ptr, &src_len, argv[2], argv[3])) {
+      return 1;
+    }
+  } else {
     FILE* in = NULL;
     switch (argc) {
       case 1:
@@ -337,8 +620,12 @@ main(int argc, char** argv) {
       default:
         fprintf(stderr,
                 "Usage: %s input.ivg > output.png\n"
-                "    If input.ivg is omitted, it reads from stdin.\n",
-                argv[0]);
+                "    If input.ivg is omitted, it reads from stdin.\n"
+                "Usage: %s -j N input0.ivg input1.ivg etc\n"
+                "    This writes inputI.png files, decoding N in parallel.\n"
+                "Usage: %s -pack input.ivgpack name > output.png\n"
+                "    This reads the named graphic from an icon pack.\n",
+                argv[0], argv[0], argv[0]);
         return 1;
     }
     if (!read_file(&src_len, &g_src_buffer_array[0], SRC_BUFFER_ARRAY_SIZE, in,
@@ -414,27 +701,11 @@ main(int argc, char** argv) {
   }
 
   // Convert from premultiplied alpha to non-premultiplied alpha.
-  // CAIRO_FORMAT_ARGB32 uses the former, as does Skia with
-  // PREMUL_SK_ALPHATYPE. libpng uses the latter.
-  {
-    for (uint32_t y = 0; y < pb.height; y++) {
-      const size_t bytes_per_pixel = 4;
-      uint8_t* row = pb.data + (y * bytes_per_pixel * pb.width);
-      for (uint32_t x = 0; x < pb.width; x++) {
-        uint8_t* rgba = row + (x * bytes_per_pixel);
-        if ((rgba[3] != 0x00) && (rgba[3] != 0xFF)) {
-          uint32_t a = rgba[3];
-          rgba[0] = (uint8_t)((rgba[0] * ((uint32_t)0xFF)) / a);
-          rgba[1] = (uint8_t)((rgba[1] * ((uint32_t)0xFF)) / a);
-          rgba[2] = (uint8_t)((rgba[2] * ((uint32_t)0xFF)) / a);
-        }
-      }
-    }
-  }
+  convert_to_nonpremul(&pb);
 
   // Write the PNG to stdout.
   {
-    const char* err_msg = write_png_to_stdout(&pb);
+    const char* err_msg = write_png_to_file(&pb, stdout);
     if (err_msg) {
       fprintf(stderr, "main: could not write the PNG to stdout\n%s\n", err_msg);
       return 1;
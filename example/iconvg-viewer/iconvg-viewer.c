@@ -30,8 +30,14 @@
 // The , and . keys cycle through background checkerboard colors.
 //
 // The Escape key quits.
+//
+// Files are read, decoded and rasterized on a background thread, so that the
+// window stays responsive. Paging to another file, or resizing the window,
+// cancels any stale render. Each render first shows a quick, low resolution
+// preview, then the full resolution image in its place.
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -55,6 +61,8 @@
 #ifndef SRC_BUFFER_ARRAY_SIZE
 #define SRC_BUFFER_ARRAY_SIZE 1048576
 #endif
+//
+// g_src_buffer_array and g_src_len are only used by the render thread.
 uint8_t g_src_buffer_array[SRC_BUFFER_ARRAY_SIZE];
 size_t g_src_len = 0;
 
@@ -66,7 +74,10 @@ const double g_background_colors[NUM_BACKGROUND_COLORS][6] = {
     {0.75, 0.75, 0.75, 0.80, 0.80, 0.80},
     {0.80, 0.25, 0.70, 0.70, 0.25, 0.80},
 };
-uint32_t g_background_color_index = 0;
+
+// CHECKER_SIZE is the width and height, in pixels, of each checkerboard
+// square. It must be a power of 2.
+#define CHECKER_SIZE 64
 
 typedef struct {
   uint8_t* data;
@@ -83,8 +94,14 @@ typedef struct {
 
 #include <cairo/cairo.h>
 
+// initialize_pixel_buffer's background_colors are the 6 elements of a
+// g_background_colors entry. checker_size must be a power of 2.
 const char*  //
-initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+initialize_pixel_buffer(pixel_buffer* pb,
+                        uint32_t width,
+                        uint32_t height,
+                        const double* background_colors,
+                        uint32_t checker_size) {
   if (!pb) {
     return "main: NULL pixel_buffer";
   } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
@@ -106,16 +123,15 @@ initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
   }
 
   // Draw the checkerboard background.
-  for (uint32_t y = 0; y < height; y += 64) {
-    for (uint32_t x = 0; x < width; x += 64) {
-      uint32_t xor = ((x ^ y) >> 6) & 1;
+  for (uint32_t y = 0; y < height; y += checker_size) {
+    for (uint32_t x = 0; x < width; x += checker_size) {
+      uint32_t xor = ((x ^ y) / checker_size) & 1;
       uint32_t base = 3 * xor;
-      cairo_set_source_rgb(
-          cr,  //
-          g_background_colors[g_background_color_index][base + 0],
-          g_background_colors[g_background_color_index][base + 1],
-          g_background_colors[g_background_color_index][base + 2]);
-      cairo_rectangle(cr, x, y, 64, 64);
+      cairo_set_source_rgb(cr,  //
+                           background_colors[base + 0],
+                           background_colors[base + 1],
+                           background_colors[base + 2]);
+      cairo_rectangle(cr, x, y, checker_size, checker_size);
       cairo_fill(cr);
     }
   }
@@ -165,7 +181,11 @@ finalize_pixel_buffer(pixel_buffer* pb) {
 #include "include/c/sk_surface.h"
 
 const char*  //
-initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+initialize_pixel_buffer(pixel_buffer* pb,
+                        uint32_t width,
+                        uint32_t height,
+                        const double* background_colors,
+                        uint32_t checker_size) {
   if (!pb) {
     return "main: NULL pixel_buffer";
   } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
@@ -198,28 +218,26 @@ initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
   }
 
   // Draw the checkerboard background.
-  sk_color_t background_colors[2];
-  background_colors[0] = sk_color_set_argb(
-      0xFF,
-      ((uint8_t)(0xFF * g_background_colors[g_background_color_index][0])),
-      ((uint8_t)(0xFF * g_background_colors[g_background_color_index][1])),
-      ((uint8_t)(0xFF * g_background_colors[g_background_color_index][2])));
-  background_colors[1] = sk_color_set_argb(
-      0xFF,
-      ((uint8_t)(0xFF * g_background_colors[g_background_color_index][3])),
-      ((uint8_t)(0xFF * g_background_colors[g_background_color_index][4])),
-      ((uint8_t)(0xFF * g_background_colors[g_background_color_index][5])));
+  sk_color_t sk_background_colors[2];
+  sk_background_colors[0] =
+      sk_color_set_argb(0xFF, ((uint8_t)(0xFF * background_colors[0])),
+                        ((uint8_t)(0xFF * background_colors[1])),
+                        ((uint8_t)(0xFF * background_colors[2])));
+  sk_background_colors[1] =
+      sk_color_set_argb(0xFF, ((uint8_t)(0xFF * background_colors[3])),
+                        ((uint8_t)(0xFF * background_colors[4])),
+                        ((uint8_t)(0xFF * background_colors[5])));
   sk_paint_t* sp = sk_paint_new();
   sk_paint_set_xfermode_mode(sp, SRC_SK_XFERMODE_MODE);
-  for (uint32_t y = 0; y < height; y += 64) {
-    for (uint32_t x = 0; x < width; x += 64) {
-      uint32_t xor = ((x ^ y) >> 6) & 1;
+  for (uint32_t y = 0; y < height; y += checker_size) {
+    for (uint32_t x = 0; x < width; x += checker_size) {
+      uint32_t xor = ((x ^ y) / checker_size) & 1;
       sk_rect_t rect;
       rect.left = x;
       rect.top = y;
-      rect.right = x + 64;
-      rect.bottom = y + 64;
-      sk_paint_set_color(sp, background_colors[xor]);
+      rect.right = x + checker_size;
+      rect.bottom = y + checker_size;
+      sk_paint_set_color(sp, sk_background_colors[xor]);
       sk_canvas_draw_rect(sc, &rect, sp);
     }
   }
@@ -260,24 +278,84 @@ finalize_pixel_buffer(pixel_buffer* pb) {
 
 #else  //  ICONVG_CONFIG__ETC
 
+// Without a third party graphics library, use IconVG's built-in rasterizer.
+
 const char*  //
-initialize_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
+initialize_pixel_buffer(pixel_buffer* pb,
+                        uint32_t width,
+                        uint32_t height,
+                        const double* background_colors,
+                        uint32_t checker_size) {
   if (!pb) {
     return "main: NULL pixel_buffer";
+  } else if ((width > 0x7FFF) || (height > 0x7FFF)) {
+    return "main: dimensions are too large";
+  }
+
+  uint8_t* data = (uint8_t*)(malloc(4 * width * height));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  size_t scratch_len = iconvg_rasterizer_scratch_len(width, height);
+  float* scratch = (float*)(malloc(scratch_len * sizeof(float)));
+  if (!scratch) {
+    free(data);
+    return "main: could not allocate rasterizer scratch memory";
+  }
+
+  // Draw the checkerboard background.
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = data + (4 * width * y);
+    for (uint32_t x = 0; x < width; x++) {
+      uint32_t xor = ((x ^ y) / checker_size) & 1;
+      const double* bg = background_colors;
+      row[(4 * x) + 0] = (uint8_t)(0xFF * bg[(3 * xor) + 0]);
+      row[(4 * x) + 1] = (uint8_t)(0xFF * bg[(3 * xor) + 1]);
+      row[(4 * x) + 2] = (uint8_t)(0xFF * bg[(3 * xor) + 2]);
+      row[(4 * x) + 3] = 0xFF;
+    }
   }
+
   *pb = ((pixel_buffer){0});
-  pb->canvas = iconvg_canvas__make_broken("main: no IconVG backend configured");
+  pb->data = data;
+  pb->width = width;
+  pb->height = height;
+  pb->canvas = iconvg_canvas__make_rasterizer(data, 4 * width, width, height,
+                                              scratch, scratch_len);
+  pb->extra0 = scratch;
   return NULL;
 }
 
 const char*  //
 flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
-  return "main: no IconVG backend configured";
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  // The rasterizer writes RGBA but upload_pixel_buffer expects BGRA, like
+  // CAIRO_FORMAT_ARGB32 (on little-endian systems) and BGRA_8888_SK_COLORTYPE.
+  size_t n = 4 * ((size_t)(pb->width)) * ((size_t)(pb->height));
+  for (size_t i = 0; i < n; i += 4) {
+    uint8_t r = pb->data[i + 0];
+    pb->data[i + 0] = pb->data[i + 2];
+    pb->data[i + 2] = r;
+  }
+  return NULL;
 }
 
 const char*  //
 finalize_pixel_buffer(pixel_buffer* pb) {
-  return "main: no IconVG backend configured";
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  if (pb->extra0) {
+    free(pb->extra0);
+    pb->extra0 = NULL;
+  }
+  if (pb->data) {
+    free(pb->data);
+    pb->data = NULL;
+  }
+  return NULL;
 }
 
 #endif  //  ICONVG_CONFIG__ETC
@@ -348,42 +426,119 @@ load(const char* filename) {
 
 // ----
 
+// frame is a rendered image, as BGRA pixels (4 bytes per pixel, with no row
+// padding) ready for upload_frame. A zero width or height means a blank
+// window, e.g. because the file could not be decoded.
+typedef struct {
+  uint8_t* data;
+  uint32_t width;
+  uint32_t height;
+} frame;
+
+// render_request is what the UI thread asks the render thread to draw. The
+// filename is one of argv's elements, so it outlives every request.
+typedef struct {
+  const char* filename;
+  uint32_t window_width;
+  uint32_t window_height;
+  uint32_t background_color_index;
+} render_request;
+
+// PREVIEW_SCALE_DOWN is how many times smaller (in each dimension) the
+// preview frame is rendered than the full resolution frame. It must be a
+// power of 2 that divides CHECKER_SIZE.
+#define PREVIEW_SCALE_DOWN 4
+
+// progressive_renderer renders on a background thread, so that reading,
+// decoding and rasterizing never block the UI thread. It is independent of
+// the windowing system.
+//
+// Each request supersedes any earlier one. An in-progress render of a stale
+// request is cancelled (via iconvg_decode_options' cancel callback) and its
+// frames are never published. Each request publishes a preview frame and
+// then the full resolution frame. Only the latest published frame is kept,
+// so a UI thread that is slow to call progressive_renderer__take_frame skips
+// straight to the newest one.
+//
+// on_frame_ready is called, on the render thread, whenever
+// progressive_renderer__take_frame has a new frame. It should wake the UI
+// thread.
+typedef struct {
+  pthread_t thread;
+  void (*on_frame_ready)(void* ctx);
+  void* on_frame_ready_ctx;
+
+  // The fields below are guarded by mutex. generation counts requests.
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint64_t generation;
+  render_request request;
+  bool has_request;
+  bool quit;
+  frame ready_frame;
+  bool has_ready_frame;
+} progressive_renderer;
+
+// render_job is the cancel_context for one request's iconvg_decode calls.
+typedef struct {
+  progressive_renderer* renderer;
+  uint64_t generation;
+} render_job;
+
 bool  //
-render(void* ctx,
-       uint32_t window_width,
-       uint32_t window_height,
-       const char* filename,
-       const char* (*upload_pixel_buffer)(void* ctx, pixel_buffer* pb)) {
-  if (!filename) {
-    return false;
-  }
+render_job__is_stale(void* job_as_void_star) {
+  render_job* job = (render_job*)job_as_void_star;
+  progressive_renderer* r = job->renderer;
+  pthread_mutex_lock(&r->mutex);
+  bool ret = r->quit || (r->generation != job->generation);
+  pthread_mutex_unlock(&r->mutex);
+  return ret;
+}
+
+// render_frame renders req's file (already loaded into g_src_buffer_array)
+// into dst, at 1/scale_down of the window's width and height and then
+// upscaled to the window's size. It returns iconvg_note_cancelled if the job
+// became stale.
+//
+// When scale_down is greater than 1, the graphic is decoded at the Level of
+// Detail for that smaller size, which can also omit fine-detail drawings.
+const char*  //
+render_frame(frame* dst,
+             render_job* job,
+             const render_request* req,
+             uint32_t scale_down) {
+  *dst = ((frame){0});
   uint8_t const* src_ptr = &g_src_buffer_array[0];
   const size_t src_len = g_src_len;
+  uint32_t width = req->window_width / scale_down;
+  uint32_t height = req->window_height / scale_down;
+  width = (width > 0) ? width : 1;
+  height = (height > 0) ? height : 1;
 
   // Decode the IconVG viewbox.
   double vw = 0.0;
   double vh = 0.0;
+  int32_t dr_height = 0;
   iconvg_rectangle_f32 dst_rect = {0};
   {
     iconvg_rectangle_f32 viewbox = {0};
     const char* err_msg = iconvg_decode_viewbox(&viewbox, src_ptr, src_len);
     if (err_msg) {
-      printf("%s: iconvg_decode_viewbox: %s\n", filename, err_msg);
-      return false;
+      printf("%s: iconvg_decode_viewbox: %s\n", req->filename, err_msg);
+      return err_msg;
     }
     int32_t dr_width = 0;
-    int32_t dr_height = 0;
     vw = iconvg_rectangle_f32__width_f64(&viewbox);
     vh = iconvg_rectangle_f32__height_f64(&viewbox);
     if ((vw <= 0) || (vh <= 0)) {
       dr_width = 1;
       dr_height = 1;
-    } else if ((vw * window_height) < (vh * window_width)) {
-      dr_width = (int32_t)(window_height * vw / vh);
-      dr_height = window_height;
+    } else if ((vw * height) < (vh * width)) {
+      dr_width = (int32_t)(height * vw / vh);
+      dr_height = height;
     } else {
-      dr_width = window_width;
-      dr_height = (int32_t)(window_width * vh / vw);
+      dr_width = width;
+      dr_height = (int32_t)(width * vh / vw);
     }
 
     // An 0x3FFF = 16383 pixel width or height upper bound is somewhat
@@ -396,8 +551,8 @@ render(void* ctx,
       dr_height = 0x3FFF;
     }
 
-    int32_t min_x = (window_width - dr_width) / 2;
-    int32_t min_y = (window_height - dr_height) / 2;
+    int32_t min_x = (width - dr_width) / 2;
+    int32_t min_y = (height - dr_height) / 2;
     dst_rect = iconvg_rectangle_f32__make(min_x,               //
                                           min_y,               //
                                           min_x + dr_width,    //
@@ -407,39 +562,68 @@ render(void* ctx,
   // Initialize the pixel buffer.
   pixel_buffer pb = {0};
   {
-    const char* err_msg =
-        initialize_pixel_buffer(&pb, window_width, window_height);
+    const char* err_msg = initialize_pixel_buffer(
+        &pb, width, height,
+        &g_background_colors[req->background_color_index][0],
+        CHECKER_SIZE / scale_down);
     if (err_msg) {
-      printf("%s: initialize_pixel_buffer: %s\n", filename, err_msg);
-      return false;
+      printf("%s: initialize_pixel_buffer: %s\n", req->filename, err_msg);
+      return err_msg;
     }
   }
 
   // Decode the IconVG.
   if ((vw > 0.0) && (vh > 0.0)) {
+    iconvg_decode_options opts = {0};
+    opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+    if (scale_down > 1) {
+      opts.height_in_pixels = iconvg_optional_i64__make_some(dr_height);
+    }
+    opts.cancel = &render_job__is_stale;
+    opts.cancel_context = job;
     const char* err_msg =
-        iconvg_decode(&pb.canvas, dst_rect, src_ptr, src_len, NULL);
+        iconvg_decode(&pb.canvas, dst_rect, src_ptr, src_len, &opts);
     if (err_msg) {
-      printf("%s: iconvg_decode: %s\n", filename, err_msg);
-      goto clean_up_and_fail;
+      if (err_msg != iconvg_note_cancelled) {
+        printf("%s: iconvg_decode: %s\n", req->filename, err_msg);
+      }
+      finalize_pixel_buffer(&pb);
+      return err_msg;
     }
   }
 
   // Flush the backend-specific drawing ops to the pixel buffer.
   {
-    const char* err_msg = flush_pixel_buffer(&pb, window_width, window_height);
+    const char* err_msg = flush_pixel_buffer(&pb, width, height);
     if (err_msg) {
-      printf("%s: flush_pixel_buffer: %s\n", filename, err_msg);
-      goto clean_up_and_fail;
+      printf("%s: flush_pixel_buffer: %s\n", req->filename, err_msg);
+      finalize_pixel_buffer(&pb);
+      return err_msg;
     }
   }
 
-  // Upload the pixel buffer to the screen, in an OS-specific way.
-  {
-    const char* err_msg = (*upload_pixel_buffer)(ctx, &pb);
-    if (err_msg) {
-      printf("%s: upload_pixel_buffer: %s\n", filename, err_msg);
-      goto clean_up_and_fail;
+  // Copy (and upscale) the pixel buffer to the frame.
+  dst->width = req->window_width;
+  dst->height = req->window_height;
+  dst->data = (uint8_t*)(malloc(4 * ((size_t)(dst->width)) * dst->height));
+  if (!dst->data) {
+    finalize_pixel_buffer(&pb);
+    *dst = ((frame){0});
+    return "main: could not allocate frame data";
+  }
+  for (uint32_t y = 0; y < dst->height; y++) {
+    uint32_t sy = y / scale_down;
+    sy = (sy < height) ? sy : (height - 1);
+    const uint8_t* src_row = pb.data + (4 * ((size_t)width) * sy);
+    uint8_t* dst_row = dst->data + (4 * ((size_t)(dst->width)) * y);
+    if (scale_down == 1) {
+      memcpy(dst_row, src_row, 4 * ((size_t)width));
+      continue;
+    }
+    for (uint32_t x = 0; x < dst->width; x++) {
+      uint32_t sx = x / scale_down;
+      sx = (sx < width) ? sx : (width - 1);
+      memcpy(dst_row + (4 * x), src_row + (4 * sx), 4);
     }
   }
 
@@ -447,16 +631,145 @@ render(void* ctx,
   {
     const char* err_msg = finalize_pixel_buffer(&pb);
     if (err_msg) {
-      printf("%s: finalize_pixel_buffer: %s\n", filename, err_msg);
-      return false;
+      printf("%s: finalize_pixel_buffer: %s\n", req->filename, err_msg);
+      free(dst->data);
+      *dst = ((frame){0});
+      return err_msg;
     }
   }
 
-  printf("%s: ok (%g x %g)\n", filename, vw, vh);
-  return true;
-clean_up_and_fail:
-  finalize_pixel_buffer(&pb);
-  return false;
+  if (scale_down == 1) {
+    printf("%s: ok (%g x %g)\n", req->filename, vw, vh);
+  }
+  return NULL;
+}
+
+// progressive_renderer__publish makes f the frame that
+// progressive_renderer__take_frame returns, unless job is stale. It takes
+// ownership of f's data.
+void  //
+progressive_renderer__publish(progressive_renderer* r,
+                              render_job* job,
+                              frame f) {
+  pthread_mutex_lock(&r->mutex);
+  bool stale = r->quit || (r->generation != job->generation);
+  if (!stale) {
+    free(r->ready_frame.data);
+    r->ready_frame = f;
+    r->has_ready_frame = true;
+  }
+  pthread_mutex_unlock(&r->mutex);
+  if (stale) {
+    free(f.data);
+  } else {
+    (*r->on_frame_ready)(r->on_frame_ready_ctx);
+  }
+}
+
+void*  //
+progressive_renderer__run(void* r_as_void_star) {
+  progressive_renderer* r = (progressive_renderer*)r_as_void_star;
+  const char* loaded_filename = NULL;
+  bool loaded = false;
+  while (true) {
+    pthread_mutex_lock(&r->mutex);
+    while (!r->has_request && !r->quit) {
+      pthread_cond_wait(&r->cond, &r->mutex);
+    }
+    if (r->quit) {
+      pthread_mutex_unlock(&r->mutex);
+      return NULL;
+    }
+    render_request req = r->request;
+    render_job job = {0};
+    job.renderer = r;
+    job.generation = r->generation;
+    r->has_request = false;
+    pthread_mutex_unlock(&r->mutex);
+
+    if (loaded_filename != req.filename) {
+      loaded_filename = req.filename;
+      loaded = load(req.filename);
+    }
+    if (!loaded) {
+      progressive_renderer__publish(r, &job, ((frame){0}));
+      continue;
+    }
+
+    static const uint32_t scale_downs[2] = {PREVIEW_SCALE_DOWN, 1};
+    for (int i = 0; i < 2; i++) {
+      frame f = {0};
+      const char* err_msg = render_frame(&f, &job, &req, scale_downs[i]);
+      if (err_msg == iconvg_note_cancelled) {
+        break;
+      }
+      progressive_renderer__publish(r, &job, f);
+      if (err_msg || render_job__is_stale(&job)) {
+        break;
+      }
+    }
+  }
+}
+
+const char*  //
+progressive_renderer__initialize(progressive_renderer* r,
+                                 void (*on_frame_ready)(void* ctx),
+                                 void* on_frame_ready_ctx) {
+  *r = ((progressive_renderer){0});
+  r->on_frame_ready = on_frame_ready;
+  r->on_frame_ready_ctx = on_frame_ready_ctx;
+  if (pthread_mutex_init(&r->mutex, NULL) != 0) {
+    return "main: could not initialize the render mutex";
+  } else if (pthread_cond_init(&r->cond, NULL) != 0) {
+    pthread_mutex_destroy(&r->mutex);
+    return "main: could not initialize the render condition variable";
+  } else if (pthread_create(&r->thread, NULL, &progressive_renderer__run,
+                            r) != 0) {
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->mutex);
+    return "main: could not create the render thread";
+  }
+  return NULL;
+}
+
+void  //
+progressive_renderer__finalize(progressive_renderer* r) {
+  pthread_mutex_lock(&r->mutex);
+  r->quit = true;
+  pthread_cond_signal(&r->cond);
+  pthread_mutex_unlock(&r->mutex);
+  pthread_join(r->thread, NULL);
+  free(r->ready_frame.data);
+  pthread_cond_destroy(&r->cond);
+  pthread_mutex_destroy(&r->mutex);
+}
+
+// progressive_renderer__request replaces any pending or in-progress request,
+// cancelling the latter, with req.
+void  //
+progressive_renderer__request(progressive_renderer* r,
+                              const render_request* req) {
+  pthread_mutex_lock(&r->mutex);
+  r->generation++;
+  r->request = *req;
+  r->has_request = true;
+  pthread_cond_signal(&r->cond);
+  pthread_mutex_unlock(&r->mutex);
+}
+
+// progressive_renderer__take_frame moves the latest published frame (if any)
+// to dst, returning whether there was one. The caller owns dst's data.
+bool  //
+progressive_renderer__take_frame(progressive_renderer* r, frame* dst) {
+  pthread_mutex_lock(&r->mutex);
+  bool ret = r->has_ready_frame;
+  if (ret) {
+    *dst = r->ready_frame;
+    r->ready_frame = ((frame){0});
+    r->has_ready_frame = false;
+  }
+  pthread_mutex_unlock(&r->mutex);
+  return ret;
 }
 
 // --------
@@ -475,12 +788,18 @@ xcb_atom_t g_atom_net_wm_name = XCB_NONE;
 xcb_atom_t g_atom_utf8_string = XCB_NONE;
 xcb_atom_t g_atom_wm_protocols = XCB_NONE;
 xcb_atom_t g_atom_wm_delete_window = XCB_NONE;
-xcb_pixmap_t g_pixmap = XCB_NONE;
-uint32_t g_pixmap_width = 0;
-uint32_t g_pixmap_height = 0;
+xcb_atom_t g_atom_iconvg_frame_ready = XCB_NONE;
 xcb_keysym_t* g_keysyms = NULL;
 xcb_get_keyboard_mapping_reply_t* g_keyboard_mapping = NULL;
 
+// The window's contents are double-buffered: upload_frame fills the back
+// pixmap, g_pixmaps[1 - g_front_pixmap], and then makes it the front one. A
+// zero width or height means that that pixmap has not been created.
+xcb_pixmap_t g_pixmaps[2] = {XCB_NONE, XCB_NONE};
+uint32_t g_pixmap_widths[2] = {0, 0};
+uint32_t g_pixmap_heights[2] = {0, 0};
+int g_front_pixmap = 0;
+
 void  //
 init_keymap(xcb_connection_t* c, const xcb_setup_t* z) {
   xcb_get_keyboard_mapping_cookie_t cookie = xcb_get_keyboard_mapping(
@@ -515,23 +834,57 @@ typedef struct {
   xcb_gcontext_t g;
 } my_context;
 
-const char*  //
-upload_pixel_buffer(void* ctx_as_void_star, pixel_buffer* pb) {
+
+// wake_ui_thread is the progressive_renderer's on_frame_ready callback. It
+// sends the window an ICONVG_FRAME_READY client message, which the UI
+// thread's xcb_wait_for_event call then returns. XCB connections are safe to
+// use from multiple threads.
+void  //
+wake_ui_thread(void* ctx_as_void_star) {
   my_context* ctx = (my_context*)ctx_as_void_star;
-  if ((g_pixmap_width > 0) && (g_pixmap_height > 0)) {
-    xcb_free_pixmap(ctx->c, g_pixmap);
-    g_pixmap_width = 0;
-    g_pixmap_height = 0;
+  xcb_client_message_event_t e;
+  memset(&e, 0, sizeof(e));
+  e.response_type = XCB_CLIENT_MESSAGE;
+  e.format = 32;
+  e.window = ctx->w;
+  e.type = g_atom_iconvg_frame_ready;
+  xcb_send_event(ctx->c, 0, ctx->w, XCB_EVENT_MASK_NO_EVENT, (const char*)&e);
+  xcb_flush(ctx->c);
+}
+
+// show_front_pixmap copies the front pixmap (if any) to the window.
+void  //
+show_front_pixmap(my_context* ctx) {
+  int i = g_front_pixmap;
+  if ((g_pixmap_widths[i] > 0) && (g_pixmap_heights[i] > 0)) {
+    xcb_copy_area(ctx->c, g_pixmaps[i], ctx->w, ctx->g, 0, 0, 0, 0,
+                  g_pixmap_widths[i], g_pixmap_heights[i]);
+  } else {
+    xcb_clear_area(ctx->c, 0, ctx->w, 0, 0, 0xFFFF, 0xFFFF);
+  }
+  xcb_flush(ctx->c);
+}
+
+const char*  //
+upload_frame(my_context* ctx, const frame* f) {
+  int i = 1 - g_front_pixmap;
+  if ((g_pixmap_widths[i] != f->width) || (g_pixmap_heights[i] != f->height)) {
+    if ((g_pixmap_widths[i] > 0) && (g_pixmap_heights[i] > 0)) {
+      xcb_free_pixmap(ctx->c, g_pixmaps[i]);
+      g_pixmap_widths[i] = 0;
+      g_pixmap_heights[i] = 0;
+    }
   }
-  if ((pb->width == 0) || (pb->height == 0)) {
+  if ((f->width == 0) || (f->height == 0)) {
+    g_front_pixmap = i;
     return NULL;
-  } else if ((pb->width > 0x3FFF) || (pb->height > 0x3FFF)) {
-    return "main: pixel buffer is too large";
+  } else if ((f->width > 0x3FFF) || (f->height > 0x3FFF)) {
+    return "main: frame is too large";
   }
 
   // Calculate max_h, the largest number of rows we can issue in a single
   // xcb_image_put call without exceeding the XCB request length limit. This
-  // number depends on pb->width, the width of the pixel buffer.
+  // number depends on f->width, the width of the frame.
   //
   // The xcb_get_maximum_request_length documentation says that "this length
   // is measured in four-byte units". Coincidentally, our RGBA pixels are
@@ -543,34 +896,37 @@ upload_pixel_buffer(void* ctx_as_void_star, pixel_buffer* pb) {
   if (mrl < header_length) {
     return "main: XCB request length is too short";
   }
-  uint32_t max_h = (mrl - header_length) / pb->width;
+  uint32_t max_h = (mrl - header_length) / f->width;
   if (max_h == 0) {
     return "main: XCB request length is too short";
   }
 
-  g_pixmap_width = pb->width;
-  g_pixmap_height = pb->height;
-  xcb_create_pixmap(ctx->c, ctx->s->root_depth, g_pixmap, ctx->w,
-                    g_pixmap_width, g_pixmap_height);
+  if ((g_pixmap_widths[i] == 0) || (g_pixmap_heights[i] == 0)) {
+    g_pixmap_widths[i] = f->width;
+    g_pixmap_heights[i] = f->height;
+    xcb_create_pixmap(ctx->c, ctx->s->root_depth, g_pixmaps[i], ctx->w,
+                      g_pixmap_widths[i], g_pixmap_heights[i]);
+  }
   xcb_image_t* image = xcb_image_create_native(
-      ctx->c, pb->width, pb->height, XCB_IMAGE_FORMAT_Z_PIXMAP,
-      ctx->s->root_depth, NULL, pb->width * pb->height * 4, pb->data);
-  if (pb->height <= max_h) {
-    xcb_image_put(ctx->c, g_pixmap, ctx->g, image, 0, 0, 0);
+      ctx->c, f->width, f->height, XCB_IMAGE_FORMAT_Z_PIXMAP,
+      ctx->s->root_depth, NULL, f->width * f->height * 4, f->data);
+  if (f->height <= max_h) {
+    xcb_image_put(ctx->c, g_pixmaps[i], ctx->g, image, 0, 0, 0);
   } else {
     int y = 0;
-    while (y < pb->height) {
-      uint32_t h = pb->height - y;
+    while (y < f->height) {
+      uint32_t h = f->height - y;
       if (h > max_h) {
         h = max_h;
       }
-      xcb_image_t* sub = xcb_image_subimage(image, 0, y, pb->width, h, 0, 0, 0);
-      xcb_image_put(ctx->c, g_pixmap, ctx->g, sub, 0, y, 0);
+      xcb_image_t* sub = xcb_image_subimage(image, 0, y, f->width, h, 0, 0, 0);
+      xcb_image_put(ctx->c, g_pixmaps[i], ctx->g, sub, 0, y, 0);
       xcb_image_destroy(sub);
       y += h;
     }
   }
   xcb_image_destroy(image);
+  g_front_pixmap = i;
   return NULL;
 }
 
@@ -593,18 +949,23 @@ main(int argc, char** argv) {
         xcb_intern_atom(c, 1, 12, "WM_PROTOCOLS");
     xcb_intern_atom_cookie_t cookie3 =
         xcb_intern_atom(c, 1, 16, "WM_DELETE_WINDOW");
+    xcb_intern_atom_cookie_t cookie4 =
+        xcb_intern_atom(c, 0, 18, "ICONVG_FRAME_READY");
     xcb_intern_atom_reply_t* reply0 = xcb_intern_atom_reply(c, cookie0, NULL);
     xcb_intern_atom_reply_t* reply1 = xcb_intern_atom_reply(c, cookie1, NULL);
     xcb_intern_atom_reply_t* reply2 = xcb_intern_atom_reply(c, cookie2, NULL);
     xcb_intern_atom_reply_t* reply3 = xcb_intern_atom_reply(c, cookie3, NULL);
+    xcb_intern_atom_reply_t* reply4 = xcb_intern_atom_reply(c, cookie4, NULL);
     g_atom_net_wm_name = reply0->atom;
     g_atom_utf8_string = reply1->atom;
     g_atom_wm_protocols = reply2->atom;
     g_atom_wm_delete_window = reply3->atom;
+    g_atom_iconvg_frame_ready = reply4->atom;
     free(reply0);
     free(reply1);
     free(reply2);
     free(reply3);
+    free(reply4);
   }
 
   xcb_window_t w = make_window(c, s);
@@ -612,115 +973,144 @@ main(int argc, char** argv) {
   xcb_create_gc(c, g, w, 0, NULL);
   init_keymap(c, z);
   xcb_flush(c);
-  g_pixmap = xcb_generate_id(c);
+  g_pixmaps[0] = xcb_generate_id(c);
+  g_pixmaps[1] = xcb_generate_id(c);
+
+  my_context ctx;
+  ctx.c = c;
+  ctx.s = s;
+  ctx.w = w;
+  ctx.g = g;
+
+  progressive_renderer renderer;
+  {
+    const char* err_msg =
+        progressive_renderer__initialize(&renderer, &wake_ui_thread, &ctx);
+    if (err_msg) {
+      printf("%s\n", err_msg);
+      return 1;
+    }
+  }
 
   uint32_t window_width = 0;
   uint32_t window_height = 0;
+  uint32_t background_color_index = 0;
 
   int arg = 1;
-  bool loaded = load(argv[arg]);
-  bool rendered = false;
+  int exit_code = 0;
+  bool running = true;
 
-  while (true) {
-    bool reload = false;
+  while (running) {
     bool rerender = false;
+    bool frame_ready = false;
 
+    // Handle every queued event before acting on them, so that e.g. a burst
+    // of resizes or key repeats makes only one render request.
     xcb_generic_event_t* event = xcb_wait_for_event(c);
-    if (!event) {
-      if (xcb_connection_has_error(c) == XCB_CONN_CLOSED_REQ_LEN_EXCEED) {
-        printf("main: XCB connection error (request length exceeded)\n");
-        return 1;
-      }
-      printf("main: XCB connection error\n");
-      return 1;
-    }
-    switch (event->response_type & 0x7F) {
-      case XCB_EXPOSE: {
-        xcb_expose_event_t* e = (xcb_expose_event_t*)event;
-        if (rendered && (e->count == 0) && (g_pixmap_width > 0) &&
-            (g_pixmap_height > 0)) {
-          xcb_copy_area(c, g_pixmap, w, g, 0, 0, 0, 0, g_pixmap_width,
-                        g_pixmap_height);
-          xcb_flush(c);
+    for (; event; event = xcb_poll_for_event(c)) {
+      switch (event->response_type & 0x7F) {
+        case XCB_EXPOSE: {
+          xcb_expose_event_t* e = (xcb_expose_event_t*)event;
+          if (e->count == 0) {
+            show_front_pixmap(&ctx);
+          }
+          break;
         }
-        break;
-      }
 
-      case XCB_KEY_PRESS: {
-        xcb_key_press_event_t* e = (xcb_key_press_event_t*)event;
-        uint32_t i = e->detail;
-        if ((z->min_keycode <= i) && (i <= z->max_keycode)) {
-          i = g_keysyms[(i - z->min_keycode) *
-                        g_keyboard_mapping->keysyms_per_keycode];
-          switch (i) {
-            case XK_Escape:
-              return 0;
-
-            case ' ':
-            case XK_BackSpace:
-            case XK_Return:
-              if (argc <= 2) {
+        case XCB_KEY_PRESS: {
+          xcb_key_press_event_t* e = (xcb_key_press_event_t*)event;
+          uint32_t i = e->detail;
+          if ((z->min_keycode <= i) && (i <= z->max_keycode)) {
+            i = g_keysyms[(i - z->min_keycode) *
+                          g_keyboard_mapping->keysyms_per_keycode];
+            switch (i) {
+              case XK_Escape:
+                running = false;
                 break;
-              }
-              arg += (i != XK_BackSpace) ? +1 : -1;
-              if (arg == 0) {
-                arg = argc - 1;
-              } else if (arg == argc) {
-                arg = 1;
-              }
-              reload = true;
-              rerender = true;
-              break;
-
-            case ',':
-            case '.':
-              g_background_color_index +=
-                  (i == ',') ? (NUM_BACKGROUND_COLORS - 1) : 1;
-              g_background_color_index %= NUM_BACKGROUND_COLORS;
-              rerender = true;
-              break;
+
+              case ' ':
+              case XK_BackSpace:
+              case XK_Return:
+                if (argc <= 2) {
+                  break;
+                }
+                arg += (i != XK_BackSpace) ? +1 : -1;
+                if (arg == 0) {
+                  arg = argc - 1;
+                } else if (arg == argc) {
+                  arg = 1;
+                }
+                rerender = true;
+                break;
+
+              case ',':
+              case '.':
+                background_color_index +=
+                    (i == ',') ? (NUM_BACKGROUND_COLORS - 1) : 1;
+                background_color_index %= NUM_BACKGROUND_COLORS;
+                rerender = true;
+                break;
+            }
           }
+          break;
         }
-        break;
-      }
 
-      case XCB_CONFIGURE_NOTIFY: {
-        xcb_configure_notify_event_t* e = (xcb_configure_notify_event_t*)event;
-        if ((window_width != e->width) || (window_height != e->height)) {
-          window_width = e->width;
-          window_height = e->height;
-          rerender = true;
+        case XCB_CONFIGURE_NOTIFY: {
+          xcb_configure_notify_event_t* e =
+              (xcb_configure_notify_event_t*)event;
+          if ((window_width != e->width) || (window_height != e->height)) {
+            window_width = e->width;
+            window_height = e->height;
+            rerender = true;
+          }
+          break;
         }
-        break;
-      }
 
-      case XCB_CLIENT_MESSAGE: {
-        xcb_client_message_event_t* e = (xcb_client_message_event_t*)event;
-        if (e->data.data32[0] == g_atom_wm_delete_window) {
-          return 0;
+        case XCB_CLIENT_MESSAGE: {
+          xcb_client_message_event_t* e = (xcb_client_message_event_t*)event;
+          if (e->type == g_atom_iconvg_frame_ready) {
+            frame_ready = true;
+          } else if (e->data.data32[0] == g_atom_wm_delete_window) {
+            running = false;
+          }
+          break;
         }
-        break;
       }
+      free(event);
     }
-    free(event);
 
-    const char* filename = argv[arg];
-    if (reload) {
-      loaded = load(filename);
+    if (xcb_connection_has_error(c) == XCB_CONN_CLOSED_REQ_LEN_EXCEED) {
+      printf("main: XCB connection error (request length exceeded)\n");
+      exit_code = 1;
+      break;
+    } else if (xcb_connection_has_error(c)) {
+      printf("main: XCB connection error\n");
+      exit_code = 1;
+      break;
     }
-    if (loaded && rerender && (window_width > 0) && (window_height > 0)) {
-      my_context ctx;
-      ctx.c = c;
-      ctx.s = s;
-      ctx.w = w;
-      ctx.g = g;
-      rendered = render(&ctx, window_width, window_height, filename,
-                        &upload_pixel_buffer);
-      xcb_clear_area(c, 1, w, 0, 0, 0xFFFF, 0xFFFF);
-      xcb_flush(c);
+
+    if (running && rerender && (window_width > 0) && (window_height > 0)) {
+      render_request req = {0};
+      req.filename = argv[arg];
+      req.window_width = window_width;
+      req.window_height = window_height;
+      req.background_color_index = background_color_index;
+      progressive_renderer__request(&renderer, &req);
+    }
+
+    frame f = {0};
+    if (frame_ready && progressive_renderer__take_frame(&renderer, &f)) {
+      const char* err_msg = upload_frame(&ctx, &f);
+      free(f.data);
+      if (err_msg) {
+        printf("main: upload_frame: %s\n", err_msg);
+      }
+      show_front_pixmap(&ctx);
     }
   }
-  return 0;
+
+  progressive_renderer__finalize(&renderer);
+  return exit_code;
 }
 
 #endif  // defined(__linux__)
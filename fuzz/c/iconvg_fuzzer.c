@@ -0,0 +1,340 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// ----------------
+
+// iconvg_fuzzer is a libFuzzer (https://llvm.org/docs/LibFuzzer.html) target
+// for the IconVG C library. For each input, it checks that iconvg_validate,
+// iconvg_decode, iconvg_compile and iconvg_decode_compiled agree on whether
+// (and how) the input is malformed, and that the two decode paths make the
+// same canvas calls, with the same arguments. Building with sanitizers also
+// checks that none of them read or write out of bounds.
+//
+// To build and run it, passing test/data as the seed corpus directory:
+//   mkdir -p gen/bin
+//   CFLAGS="-g -O1 -fsanitize=fuzzer,address,undefined"
+//   clang $CFLAGS fuzz/c/iconvg_fuzzer.c -lm -o gen/bin/iconvg-fuzzer
+//   gen/bin/iconvg-fuzzer test/data
+//
+// Without libFuzzer, compiling with -DICONVG_FUZZER_MAIN gives a program that
+// runs the same checks over the files named by its arguments:
+//   CFLAGS="-g -O1 -fsanitize=address,undefined -DICONVG_FUZZER_MAIN"
+//   gcc $CFLAGS fuzz/c/iconvg_fuzzer.c -lm -o gen/bin/iconvg-fuzzer
+//   gen/bin/iconvg-fuzzer test/data/*.ivg
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+// MAX_SRC_LEN bounds the inputs that are checked. Larger ones are ignored, so
+// that the compiled form always fits in g_compiled_array: each source byte
+// expands to at most 200 compiled bytes (an arc's 6 one-byte numbers become 4
+// float64 cubic Bézier segments).
+#define MAX_SRC_LEN 65536
+uint8_t g_compiled_array[4096 + (200 * MAX_SRC_LEN)];
+
+static void  //
+fail(const char* what, const char* err_msg0, const char* err_msg1) {
+  fprintf(stderr, "iconvg_fuzzer: %s: \"%s\" vs \"%s\"\n", what,
+          err_msg0 ? err_msg0 : "NULL", err_msg1 ? err_msg1 : "NULL");
+  abort();
+}
+
+// The hash canvas folds each call, and its arguments, into a running FNV-1a
+// hash. Two sequences of calls with the same hash are almost certainly the
+// same. Its context.nonconst_ptr1 points to the uint64_t hash.
+//
+// A path_segments call hashes the same as the equivalent path_line_to,
+// path_quad_to and path_cube_to calls, as the two decode paths can batch
+// segments differently.
+
+static void  //
+hash_bytes(iconvg_canvas* c, const void* ptr, size_t len) {
+  uint64_t* h = (uint64_t*)(c->context.nonconst_ptr1);
+  const uint8_t* p = (const uint8_t*)ptr;
+  for (size_t i = 0; i < len; i++) {
+    *h = (*h ^ p[i]) * 0x100000001B3ull;
+  }
+}
+
+static void  //
+hash_call(iconvg_canvas* c, uint8_t method, const float* args, size_t n) {
+  hash_bytes(c, &method, 1);
+  hash_bytes(c, args, n * sizeof(float));
+}
+
+static const char*  //
+hash_canvas__begin_decode(iconvg_canvas* c, iconvg_rectangle_f32 dst_rect) {
+  hash_call(c, 0, &dst_rect.min_x, 1);
+  hash_call(c, 0, &dst_rect.min_y, 1);
+  hash_call(c, 0, &dst_rect.max_x, 1);
+  hash_call(c, 0, &dst_rect.max_y, 1);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__end_decode(iconvg_canvas* c,
+                        const char* err_msg,
+                        size_t num_bytes_consumed,
+                        size_t num_bytes_remaining) {
+  hash_call(c, 1, NULL, 0);
+  return err_msg;
+}
+
+static const char*  //
+hash_canvas__begin_drawing(iconvg_canvas* c) {
+  hash_call(c, 2, NULL, 0);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__end_drawing(iconvg_canvas* c, const iconvg_paint* p) {
+  iconvg_paint_type t = iconvg_paint__type(p);
+  uint8_t b = (uint8_t)t;
+  hash_call(c, 3, NULL, 0);
+  hash_bytes(c, &b, 1);
+  if (t == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+    hash_bytes(c, &k.rgba[0], 4);
+  } else if ((t == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) ||
+             (t == ICONVG_PAINT_TYPE__RADIAL_GRADIENT)) {
+    b = (uint8_t)iconvg_paint__gradient_spread(p);
+    hash_bytes(c, &b, 1);
+    uint32_t n = iconvg_paint__gradient_number_of_stops(p);
+    for (uint32_t i = 0; i < n; i++) {
+      iconvg_premul_color k =
+          iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+      float offset = iconvg_paint__gradient_stop_offset(p, i);
+      hash_bytes(c, &k.rgba[0], 4);
+      hash_bytes(c, &offset, sizeof(offset));
+    }
+    iconvg_matrix_2x3_f64 m = iconvg_paint__gradient_transformation_matrix(p);
+    hash_bytes(c, &m.elems[0][0], sizeof(m.elems));
+  }
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  float args[2] = {x0, y0};
+  hash_call(c, 4, args, 2);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__end_path(iconvg_canvas* c) {
+  hash_call(c, 5, NULL, 0);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
+  float args[2] = {x1, y1};
+  hash_call(c, 6, args, 2);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__path_quad_to(iconvg_canvas* c,
+                          float x1,
+                          float y1,
+                          float x2,
+                          float y2) {
+  float args[4] = {x1, y1, x2, y2};
+  hash_call(c, 7, args, 4);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__path_cube_to(iconvg_canvas* c,
+                          float x1,
+                          float y1,
+                          float x2,
+                          float y2,
+                          float x3,
+                          float y3) {
+  float args[6] = {x1, y1, x2, y2, x3, y3};
+  hash_call(c, 8, args, 6);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                 iconvg_rectangle_f32 viewbox) {
+  float args[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x,
+                   viewbox.max_y};
+  hash_call(c, 9, args, 4);
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  hash_call(c, 10, NULL, 0);
+  hash_bytes(c, suggested_palette, sizeof(*suggested_palette));
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__path_segments(iconvg_canvas* c,
+                           const uint8_t* verbs,
+                           size_t num_verbs,
+                           const float* points) {
+  for (size_t i = 0; i < num_verbs; i++) {
+    // Each verb's value is its number of (x, y) points, and its method
+    // number is 5 more than that.
+    size_t n = 2 * (size_t)(verbs[i]);
+    hash_call(c, (uint8_t)(5 + verbs[i]), points, n);
+    points += n;
+  }
+  return NULL;
+}
+
+static const char*  //
+hash_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  hash_call(c, 12, NULL, 0);
+  return NULL;
+}
+
+static const iconvg_canvas_vtable hash_canvas_vtable = {
+    sizeof(iconvg_canvas_vtable),
+    &hash_canvas__begin_decode,
+    &hash_canvas__end_decode,
+    &hash_canvas__begin_drawing,
+    &hash_canvas__end_drawing,
+    &hash_canvas__begin_path,
+    &hash_canvas__end_path,
+    &hash_canvas__path_line_to,
+    &hash_canvas__path_quad_to,
+    &hash_canvas__path_cube_to,
+    &hash_canvas__on_metadata_viewbox,
+    &hash_canvas__on_metadata_suggested_palette,
+    &hash_canvas__path_segments,
+    &hash_canvas__on_skipped_drawing,
+};
+
+static iconvg_canvas  //
+make_hash_canvas(uint64_t* hash) {
+  *hash = 0xCBF29CE484222325ull;
+  iconvg_canvas c;
+  c.vtable = &hash_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = hash;
+  return c;
+}
+
+// check_decode_paths checks that iconvg_decode and iconvg_decode_compiled (of
+// the already compiled data) agree, with the given options, on the error and
+// canvas calls. It returns iconvg_decode's error.
+static const char*  //
+check_decode_paths(const uint8_t* data,
+                   size_t size,
+                   size_t compiled_len,
+                   iconvg_rectangle_f32 r,
+                   const iconvg_decode_options* options) {
+  uint64_t decode_hash = 0;
+  iconvg_canvas c = make_hash_canvas(&decode_hash);
+  const char* decode_err_msg = iconvg_decode(&c, r, data, size, options);
+
+  uint64_t replay_hash = 0;
+  c = make_hash_canvas(&replay_hash);
+  const char* replay_err_msg =
+      iconvg_decode_compiled(&c, r, g_compiled_array, compiled_len, options);
+  if (replay_err_msg != decode_err_msg) {
+    fail("iconvg_decode_compiled vs iconvg_decode", replay_err_msg,
+         decode_err_msg);
+  } else if (!decode_err_msg && (replay_hash != decode_hash)) {
+    fail("iconvg_decode_compiled vs iconvg_decode canvas calls", NULL, NULL);
+  }
+  return decode_err_msg;
+}
+
+int  //
+LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size > MAX_SRC_LEN) {
+    return 0;
+  }
+  iconvg_rectangle_f32 r = iconvg_rectangle_f32__make(0, 0, 256, 256);
+
+  const char* validate_err_msg = iconvg_validate(data, size);
+
+  // Compiling does not resolve paints, so it fails exactly when validating
+  // does.
+  size_t compiled_len = 0;
+  const char* compile_err_msg =
+      iconvg_compile(g_compiled_array, sizeof(g_compiled_array), &compiled_len,
+                     data, size);
+  if (compile_err_msg != validate_err_msg) {
+    fail("iconvg_compile vs iconvg_validate", compile_err_msg,
+         validate_err_msg);
+  }
+
+  // Check the default options, where neither decode path culls offscreen
+  // drawings, and a clip_rect (one quadrant of dst_rect), where both do.
+  iconvg_rectangle_f32 quadrant = iconvg_rectangle_f32__make(0, 0, 128, 128);
+  iconvg_decode_options options = {0};
+  options.sizeof__iconvg_decode_options = sizeof(options);
+  for (int i = 0; i < 2; i++) {
+    options.clip_rect = (i == 0) ? NULL : &quadrant;
+    const char* decode_err_msg = NULL;
+    if (compile_err_msg) {
+      iconvg_canvas broken = iconvg_canvas__make_broken(NULL);
+      decode_err_msg = iconvg_decode(&broken, r, data, size, &options);
+    } else {
+      decode_err_msg =
+          check_decode_paths(data, size, compiled_len, r, &options);
+    }
+    if ((decode_err_msg != validate_err_msg) &&
+        (decode_err_msg != iconvg_error_invalid_paint_type)) {
+      fail("iconvg_decode vs iconvg_validate", decode_err_msg,
+           validate_err_msg);
+    }
+  }
+  return 0;
+}
+
+#if defined(ICONVG_FUZZER_MAIN)
+
+uint8_t g_src_array[MAX_SRC_LEN];
+
+int  //
+main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    FILE* f = fopen(argv[i], "rb");
+    if (!f) {
+      fprintf(stderr, "main: could not open %s\n", argv[i]);
+      return 1;
+    }
+    size_t n = fread(g_src_array, 1, sizeof(g_src_array), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(g_src_array, n);
+  }
+  printf("iconvg_fuzzer: checked %d files\n", argc - 1);
+  return 0;
+}
+
+#endif  // defined(ICONVG_FUZZER_MAIN)
@@ -68,20 +68,70 @@
 // Public API Index.
 //
 // Functions (-):
+//   - iconvg_atlas_pack
+//   - iconvg_atlas_scratch_len
+//   - iconvg_bitmap_cache_workbuf_len
+//   - iconvg_compile
+//   - iconvg_compiled_palette_dependencies
 //   - iconvg_decode
+//   - iconvg_decode_batch
+//   - iconvg_decode_compiled
 //   - iconvg_decode_viewbox
 //   - iconvg_error_is_file_format_error
+//   - iconvg_gradient_cache_entries_len
+//   - iconvg_probe
+//   - iconvg_rasterizer_scratch_len
+//   - iconvg_stream_decoder_workbuf_len
+//   - iconvg_validate
 //
 // Data structures (-), their constructors (*) and their methods (+):
+//   - iconvg_arena
+//       + iconvg_arena__alloc
+//       + iconvg_arena__high_water_mark
+//       + iconvg_arena__initialize
+//       + iconvg_arena__reset
+//   - iconvg_atlas_entry
+//           * iconvg_atlas_entry__make
+//       + iconvg_atlas_entry__dst_rect
+//   - iconvg_bitmap_cache
+//       + iconvg_bitmap_cache__finalize
+//       + iconvg_bitmap_cache__initialize
+//       + iconvg_bitmap_cache__insert
+//       + iconvg_bitmap_cache__lookup
+//   - iconvg_bitmap_cache_key
+//           * iconvg_bitmap_cache_key__make
+//           * iconvg_bitmap_cache_key__make_compiled
 //   - iconvg_canvas
 //           * iconvg::canvas__make_skia
 //           * iconvg_canvas__make_broken
 //           * iconvg_canvas__make_cairo
+//           * iconvg_canvas__make_cairo_with_gradient_cache
 //           * iconvg_canvas__make_debug
+//           * iconvg_canvas__make_rasterizer
+//           * iconvg_canvas__make_rasterizer_with_coverage_masks
 //           * iconvg_canvas__make_skia
+//           * iconvg_canvas__make_skia_with_arena
+//           * iconvg_canvas__make_skia_with_gradient_cache
+//           * iconvg_canvas__make_stats
+//           * iconvg_canvas__make_tessellator
 //       + iconvg_canvas__does_nothing
+//   - iconvg_canvas_stats
 //   - iconvg_canvas_vtable
+//   - iconvg_coverage_masks
+//       + iconvg_coverage_masks__composite
+//       + iconvg_coverage_masks__initialize
+//       + iconvg_coverage_masks__required_len
+//   - iconvg_decode_job
 //   - iconvg_decode_options
+//   - iconvg_gradient_cache
+//       + iconvg_gradient_cache__initialize
+//       + iconvg_gradient_cache__invalidate
+//   - iconvg_icon_pack
+//       + iconvg_icon_pack__entry
+//       + iconvg_icon_pack__initialize
+//       + iconvg_icon_pack__lookup
+//       + iconvg_icon_pack__number_of_entries
+//   - iconvg_icon_pack_entry
 //   - iconvg_matrix_2x3_f64
 //           * iconvg_matrix_2x3_f64__make
 //       + iconvg_matrix_2x3_f64__determinant
@@ -102,14 +152,44 @@
 //       + iconvg_paint__gradient_transformation_matrix
 //       + iconvg_paint__type
 //   - iconvg_palette
+//   - iconvg_player
+//       + iconvg_player__initialize
+//       + iconvg_player__render
+//       + iconvg_player__render_pixels
+//   - iconvg_player_frame
+//           * iconvg_player_frame__make
 //   - iconvg_premul_color
+//   - iconvg_probe_results
 //   - iconvg_rectangle_f32
 //           * iconvg_rectangle_f32__make
 //       + iconvg_rectangle_f32__height_f64
 //       + iconvg_rectangle_f32__is_finite_and_not_empty
 //       + iconvg_rectangle_f32__width_f64
+//   - iconvg_stream_decoder
+//       + iconvg_stream_decoder__close
+//       + iconvg_stream_decoder__initialize
+//       + iconvg_stream_decoder__write
+//   - iconvg_tessellation
+//       + iconvg_tessellation__is_complete
+//   - iconvg_tessellation_draw
+//   - iconvg_tessellation_stop
+//   - iconvg_tessellation_vertex
 //
 // Enumerations (-), their constructors (*) and their values (=):
+//   - iconvg_canvas_method
+//       = ICONVG_CANVAS_METHOD__BEGIN_DECODE
+//       = ICONVG_CANVAS_METHOD__BEGIN_DRAWING
+//       = ICONVG_CANVAS_METHOD__BEGIN_PATH
+//       = ICONVG_CANVAS_METHOD__END_DECODE
+//       = ICONVG_CANVAS_METHOD__END_DRAWING
+//       = ICONVG_CANVAS_METHOD__END_PATH
+//       = ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE
+//       = ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX
+//       = ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING
+//       = ICONVG_CANVAS_METHOD__PATH_CUBE_TO
+//       = ICONVG_CANVAS_METHOD__PATH_LINE_TO
+//       = ICONVG_CANVAS_METHOD__PATH_QUAD_TO
+//       = ICONVG_CANVAS_METHOD__PATH_SEGMENTS
 //   - iconvg_gradient_spread
 //       = ICONVG_GRADIENT_SPREAD__NONE
 //       = ICONVG_GRADIENT_SPREAD__PAD
@@ -120,11 +200,20 @@
 //       = ICONVG_PAINT_TYPE__INVALID
 //       = ICONVG_PAINT_TYPE__LINEAR_GRADIENT
 //       = ICONVG_PAINT_TYPE__RADIAL_GRADIENT
+//   - iconvg_path_verb
+//       = ICONVG_PATH_VERB__CUBE_TO
+//       = ICONVG_PATH_VERB__LINE_TO
+//       = ICONVG_PATH_VERB__QUAD_TO
+//   - iconvg_tessellation_mode
+//       = ICONVG_TESSELLATION_MODE__CURVES
+//       = ICONVG_TESSELLATION_MODE__STENCIL_FANS
 //
 // Other globals (-):
 //   - iconvg_error_bad_color
+//   - iconvg_error_bad_compiled_form
 //   - iconvg_error_bad_coordinate
 //   - iconvg_error_bad_drawing_opcode
+//   - iconvg_error_bad_icon_pack
 //   - iconvg_error_bad_magic_identifier
 //   - iconvg_error_bad_metadata
 //   - iconvg_error_bad_metadata_id_order
@@ -135,9 +224,15 @@
 //   - iconvg_error_bad_styling_opcode
 //   - iconvg_error_invalid_backend_not_enabled
 //   - iconvg_error_invalid_constructor_argument
+//   - iconvg_error_invalid_coverage_masks
 //   - iconvg_error_invalid_paint_type
+//   - iconvg_error_invalid_path_verb
+//   - iconvg_error_system_failure_atlas_too_small
+//   - iconvg_error_system_failure_dst_buffer_too_short
 //   - iconvg_error_system_failure_out_of_memory
 //   - iconvg_error_unsupported_vtable
+//   - iconvg_note_cancelled
+//   - iconvg_note_need_more_input
 
 // ----
 
@@ -168,8 +263,10 @@
 // instead of file format errors.
 
 extern const char iconvg_error_bad_color[];                       // ¶0.1
+extern const char iconvg_error_bad_compiled_form[];               // ¶0.2
 extern const char iconvg_error_bad_coordinate[];                  // ¶0.1
 extern const char iconvg_error_bad_drawing_opcode[];              // ¶0.1
+extern const char iconvg_error_bad_icon_pack[];                   // ¶0.2
 extern const char iconvg_error_bad_magic_identifier[];            // ¶0.1
 extern const char iconvg_error_bad_metadata[];                    // ¶0.1
 extern const char iconvg_error_bad_metadata_id_order[];           // ¶0.1
@@ -179,13 +276,23 @@ extern const char iconvg_error_bad_number[];                      // ¶0.1
 extern const char iconvg_error_bad_path_unfinished[];             // ¶0.1
 extern const char iconvg_error_bad_styling_opcode[];              // ¶0.1
 
-extern const char iconvg_error_system_failure_out_of_memory[];  // ¶0.1
+extern const char iconvg_error_system_failure_atlas_too_small[];      // ¶0.2
+extern const char iconvg_error_system_failure_dst_buffer_too_short[];  // ¶0.2
+extern const char iconvg_error_system_failure_out_of_memory[];         // ¶0.1
 
 extern const char iconvg_error_invalid_backend_not_enabled[];   // ¶0.1
 extern const char iconvg_error_invalid_constructor_argument[];  // ¶0.1
+extern const char iconvg_error_invalid_coverage_masks[];        // ¶0.2
 extern const char iconvg_error_invalid_paint_type[];            // ¶0.1
+extern const char iconvg_error_invalid_path_verb[];             // ¶0.2
 extern const char iconvg_error_unsupported_vtable[];            // ¶0.1
 
+// iconvg_note_etc constants are non-NULL but are not errors. They are status
+// messages, such as iconvg_stream_decoder__write asking for more source bytes.
+
+extern const char iconvg_note_cancelled[];        // ¶0.2
+extern const char iconvg_note_need_more_input[];  // ¶0.2
+
 // ----
 
 // iconvg_rectangle_f32 is an axis-aligned rectangle with float32 coordinates.
@@ -369,6 +476,52 @@ typedef struct iconvg_decode_options_struct {
   iconvg_palette* palette;
 
   // The fields above are ¶0.1
+
+  // transform, if non-NULL, maps dst coordinates (as placed by the dst_rect
+  // argument to iconvg_decode) to the canvas' coordinates, e.g. to rotate the
+  // graphic about dst_rect's center. It applies to every path point and to
+  // gradients. The canvas' begin_decode sees (and so, for clipping canvases,
+  // clips to) the bounding box of the transformed dst_rect.
+  //
+  // The transform should be invertible. If NULL, it is the identity. The
+  // matrix must remain valid while decoding.
+  const iconvg_matrix_2x3_f64* transform;
+
+  // clip_rect, if non-NULL, is a rectangle in dst coordinates (the same space
+  // as the dst_rect argument to iconvg_decode, before any transform) outside
+  // of which the caller does not need any output, e.g. one tile of a larger
+  // rendering. Drawings whose control points' bounding box lies entirely
+  // outside of clip_rect are not emitted to the canvas at all. Other drawings
+  // are emitted in full: clip_rect only culls, and the canvas should still do
+  // its own clipping.
+  //
+  // The bounds are of the drawing's path's points, including curves' off-path
+  // control points, so they are conservative but cheap to compute. The
+  // compiled form (see iconvg_compile) stores them, so replaying it computes
+  // nothing. An iconvg_stream_decoder only culls drawings whose bytes have all
+  // been written by the time they begin. The rectangle must remain valid
+  // while decoding.
+  //
+  // Canvases clip to dst_rect, so when clip_rect is non-NULL and there is no
+  // transform, drawings outside of dst_rect are culled too. With a NULL
+  // clip_rect, nothing is culled by its bounds, whether decoding or replaying
+  // a compiled form, so that both make the same canvas calls. Setting
+  // clip_rect to point to the dst_rect therefore culls everything offscreen.
+  const iconvg_rectangle_f32* clip_rect;
+
+  // cancel, if non-NULL, is called (with cancel_context as its argument)
+  // before each drawing. If it returns true then decoding stops early with
+  // iconvg_note_cancelled. The canvas still sees end_decode (with that note)
+  // and whatever it drew so far. This lets a background thread abandon a
+  // stale render, e.g. when a viewer moves on to the next file, without
+  // finishing the whole graphic.
+  //
+  // It is called on the decoding thread, about once per drawing, so it should
+  // be cheap, e.g. comparing a mutex-guarded generation counter.
+  bool (*cancel)(void* cancel_context);
+  void* cancel_context;
+
+  // The fields above are ¶0.2
 } iconvg_decode_options;  // ¶0.1
 
 // ----
@@ -384,6 +537,14 @@ typedef struct iconvg_decode_options_struct {
 // iconvg_canvas_vtable types. Only that iconvg_canvas__make_etc creates a
 // canvas and the iconvg_canvas__etc methods take a canvas as an argument.
 
+// iconvg_path_verb is the type of one segment in a path_segments call. Each
+// verb's numerical value is also the number of (x, y) points it consumes.
+typedef enum iconvg_path_verb_enum {
+  ICONVG_PATH_VERB__LINE_TO = 1,  // ¶0.2
+  ICONVG_PATH_VERB__QUAD_TO = 2,  // ¶0.2
+  ICONVG_PATH_VERB__CUBE_TO = 3,  // ¶0.2
+} iconvg_path_verb;               // ¶0.2
+
 struct iconvg_canvas_struct;
 
 typedef struct iconvg_canvas_vtable_struct {
@@ -421,6 +582,28 @@ typedef struct iconvg_canvas_vtable_struct {
       const iconvg_palette* suggested_palette);
 
   // The fields above are ¶0.1
+
+  // path_segments may be NULL. If non-NULL, it is equivalent to calling
+  // path_line_to, path_quad_to or path_cube_to once per element of verbs (an
+  // array of num_verbs iconvg_path_verb values), in order. The points array
+  // holds those calls' float arguments, concatenated.
+  //
+  // Decoders call it, when available, for runs of consecutive segments,
+  // instead of making one call per segment.
+  const char* (*path_segments)(struct iconvg_canvas_struct* c,
+                               const uint8_t* verbs,
+                               size_t num_verbs,
+                               const float* points);
+
+  // on_skipped_drawing may be NULL. If non-NULL, decoders call it in place of
+  // a whole begin_drawing .. end_drawing sequence for each drawing that they
+  // cull because it would not change any pixels: its paint is transparent
+  // (regardless of the palette) or its bounds lie outside of dst_rect or the
+  // iconvg_decode_options' clip_rect. Drawings outside the Level of Detail
+  // bounds are not part of the graphic at that height and are not reported.
+  const char* (*on_skipped_drawing)(struct iconvg_canvas_struct* c);
+
+  // The fields above are ¶0.2
 } iconvg_canvas_vtable;  // ¶0.1
 
 typedef struct iconvg_canvas_struct {
@@ -448,6 +631,479 @@ typedef struct iconvg_canvas_struct {
 
 // ----
 
+// iconvg_decode_job is one element of the jobs array passed to
+// iconvg_decode_batch. The first five fields are the arguments to an
+// iconvg_decode call and the last field is set to that call's result.
+typedef struct iconvg_decode_job_struct {
+  iconvg_canvas* dst_canvas;
+  iconvg_rectangle_f32 dst_rect;
+  const uint8_t* src_ptr;
+  size_t src_len;
+  const iconvg_decode_options* options;
+
+  const char* err_msg;
+} iconvg_decode_job;  // ¶0.2
+
+// ----
+
+// iconvg_gradient_cache is an opt-in, bounded, least recently used cache of
+// backend gradient objects (Cairo patterns or Skia shaders). Re-rendering the
+// same gradients, e.g. the same icon at many sizes, can then re-use those
+// objects instead of rebuilding their gradient stops on every drawing.
+//
+// Entries are keyed on the paint type, spread and stop colors and offsets.
+// The gradient transformation matrix, which depends on the dst_rect, is not
+// part of the key: the backend applies it to the cached object per drawing.
+// The cache does not depend on the IconVG source bytes or palette per se,
+// only on the resolved paint.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_gradient_cache__initialize. The cache holds references to
+// backend objects, so call iconvg_gradient_cache__invalidate before releasing
+// the entries memory or the backend's own state (e.g. a Skia GPU context).
+//
+// A cache is not safe for concurrent use, including by canvases in different
+// iconvg_decode_batch jobs.
+typedef struct iconvg_gradient_cache_struct {
+  struct {
+    void* entries_ptr;
+    size_t entries_cap;
+    size_t max_backend_bytes;
+    size_t total_backend_bytes;
+    uint64_t clock;
+  } private_impl;
+} iconvg_gradient_cache;  // ¶0.2
+
+// ----
+
+// iconvg_arena is a bump allocator over caller-provided memory. Allocations
+// are carved, in order, from the front of that memory and are all released
+// at once by iconvg_arena__reset. A server can then give each worker thread
+// one arena, reset per render, for the library's working memory (rasterizer
+// scratch, compiled forms, stream decoder workbufs and the Skia canvas'
+// per-decode state) with no malloc calls or lock contention.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_arena__initialize.
+//
+// An arena is not safe for concurrent use.
+typedef struct iconvg_arena_struct {
+  struct {
+    uint8_t* ptr;
+    size_t len;
+    size_t used;
+    size_t high_water_mark;
+  } private_impl;
+} iconvg_arena;  // ¶0.2
+
+// ----
+
+// iconvg_bitmap_cache_key identifies one rendering of an IconVG graphic: a
+// hash of its source bytes, the pixel dimensions and dst_rect, and the
+// effective height_in_pixels, palette, transform and clip_rect (as per
+// iconvg_decode_options). When the options' palette is NULL, the effective
+// palette is the source's suggested palette, which the source hash already
+// covers.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_bitmap_cache_key__make.
+typedef struct iconvg_bitmap_cache_key_struct {
+  struct {
+    uint64_t src_hash;
+    uint64_t src_len;
+    uint64_t palette_hash;
+    uint64_t transform_hash;
+    uint64_t clip_rect_hash;
+    int64_t height_in_pixels;
+    float dst_rect[4];
+    uint32_t pixels_width;
+    uint32_t pixels_height;
+    uint32_t has_palette;
+    uint32_t from_compiled;
+  } private_impl;
+} iconvg_bitmap_cache_key;  // ¶0.2
+
+// iconvg_bitmap_cache is an opt-in, bounded, least recently used cache of
+// rendered pixel buffers. Serving the same icon at the same handful of sizes
+// and palettes can then copy out previously rendered pixels, skipping both
+// decoding and rasterization.
+//
+// The cache stores 4 bytes per pixel, as given to iconvg_bitmap_cache__insert
+// (e.g. alpha-premultiplied BGRA from Cairo's CAIRO_FORMAT_ARGB32 or RGBA from
+// iconvg_canvas__make_rasterizer). It does not interpret them, so callers
+// should not mix pixel formats within one cache.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_bitmap_cache__initialize.
+//
+// If the library was built with the ICONVG_CONFIG__ENABLE_PTHREADS macro
+// defined then a cache is safe for concurrent use, e.g. by different
+// iconvg_decode_batch jobs' callers. Otherwise, it is not.
+typedef struct iconvg_bitmap_cache_struct {
+  struct {
+    void* workbuf_ptr;
+  } private_impl;
+} iconvg_bitmap_cache;  // ¶0.2
+
+// ----
+
+// iconvg_coverage_masks records, per drawing, the 8-bit coverage (alpha mask)
+// that a rasterizer canvas computed for that drawing's geometry. Re-coloring
+// an icon (a different palette) can then composite each mask with its new
+// paint, via iconvg_coverage_masks__composite, without re-rasterizing paths.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_coverage_masks__initialize.
+typedef struct iconvg_coverage_masks_struct {
+  struct {
+    uint8_t* buf_ptr;
+    size_t buf_len;
+    size_t buf_used;
+    size_t num_masks;
+    float dst_rect[4];
+    uint32_t pixels_width;
+    uint32_t pixels_height;
+    bool overflowed;
+  } private_impl;
+} iconvg_coverage_masks;  // ¶0.2
+
+// ----
+
+// iconvg_player_frame is one frame of an animation played by an
+// iconvg_player. Set it up with iconvg_player_frame__make and then change
+// whichever fields animate:
+//  - transform is applied (in dst space) after mapping the graphic's ViewBox
+//    to the dst_rect, like the iconvg_decode_options field of the same name.
+//    It should be invertible.
+//  - palette, if non-NULL, replaces the player's palette for this frame.
+//  - alpha, from 0 to 1, scales every (alpha-premultiplied) palette color, to
+//    fade or pulse the graphic's tint. Colors that the graphic does not take
+//    from the palette are unaffected.
+typedef struct iconvg_player_frame_struct {
+  iconvg_matrix_2x3_f64 transform;
+  const iconvg_palette* palette;
+  float alpha;
+} iconvg_player_frame;  // ¶0.2
+
+// iconvg_player renders the frames of an animation (e.g. a pulsing tint or a
+// scale-in transition) of one compiled graphic (see iconvg_compile). Each
+// frame replays the compiled form's pre-decoded paths, without re-parsing
+// IconVG bytecode. When rendering to a pixel buffer with coverage masks, a
+// frame that only changes color also skips rasterizing those paths.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_player__initialize. A player is not safe for concurrent use.
+typedef struct iconvg_player_struct {
+  struct {
+    const uint8_t* compiled_ptr;
+    size_t compiled_len;
+    uint64_t palette_mask;
+    iconvg_palette palette;
+    iconvg_coverage_masks* masks;
+    bool masks_are_valid;
+    uint32_t masks_pixels_width;
+    uint32_t masks_pixels_height;
+    iconvg_rectangle_f32 masks_dst_rect;
+    iconvg_matrix_2x3_f64 masks_transform;
+  } private_impl;
+} iconvg_player;  // ¶0.2
+
+// ----
+
+// iconvg_stream_decoder is like iconvg_decode but takes its source bytes
+// incrementally, in chunks of any size, e.g. as they arrive over the network.
+// Paths are emitted to the canvas as soon as all of their ops' bytes have been
+// written, without buffering the whole source.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_stream_decoder__initialize.
+typedef struct iconvg_stream_decoder_struct {
+  struct {
+    void* workbuf_ptr;
+  } private_impl;
+} iconvg_stream_decoder;  // ¶0.2
+
+// ----
+
+// ICONVG_PROBE_MAX_LOD_RANGES is the maximum number of distinct Level of
+// Detail ranges that an iconvg_probe_results records.
+#define ICONVG_PROBE_MAX_LOD_RANGES 8
+
+// iconvg_probe_results is what iconvg_probe finds out about an IconVG graphic
+// without rendering it, e.g. for a layout engine or render scheduler.
+typedef struct iconvg_probe_results_struct {
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+
+  // bytecode_offset is the length of the magic identifier and metadata
+  // chunks: the offset in the source bytes where the bytecode starts.
+  size_t bytecode_offset;
+
+  // The fields below are only set when iconvg_probe scans the bytecode.
+  // Otherwise, they are zero.
+
+  // num_drawings counts every drawing, whatever its Level of Detail range.
+  uint32_t num_drawings;
+
+  // num_gradient_drawings counts the drawings whose paint is a gradient.
+  // Paints that depend on the custom palette are always flat colors.
+  uint32_t num_gradient_drawings;
+
+  // num_path_segments counts line, quadratic and cubic segments. An arc
+  // counts as the (up to 4) cubic segments that it is drawn as.
+  uint64_t num_path_segments;
+
+  // lod_ranges[.. num_lod_ranges] are the distinct Level of Detail ranges
+  // that the drawings are in, in order of first use, each with its share of
+  // num_drawings and num_path_segments. The default range is 0 ..
+  // +infinity. If there are more than ICONVG_PROBE_MAX_LOD_RANGES ranges then
+  // lod_ranges_overflowed is set and the excess drawings are only counted in
+  // the totals above.
+  struct {
+    float lod0;
+    float lod1;
+    uint32_t num_drawings;
+    uint64_t num_path_segments;
+  } lod_ranges[ICONVG_PROBE_MAX_LOD_RANGES];
+  uint32_t num_lod_ranges;
+  bool lod_ranges_overflowed;
+} iconvg_probe_results;  // ¶0.2
+
+// ----
+
+// iconvg_icon_pack is a read-only view of an icon pack: many named IconVG
+// graphics (and optionally their compiled forms) in a single file, typically
+// memory-mapped. Looking up a name gives pointers into the pack's bytes, which
+// can be passed straight to iconvg_decode (or iconvg_decode_compiled), with no
+// per-icon file open or copy.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_icon_pack__initialize. A pack is safe for concurrent use, as
+// its methods do not modify it.
+typedef struct iconvg_icon_pack_struct {
+  struct {
+    const uint8_t* ptr;
+    size_t len;
+    const uint8_t* entries;
+    uint32_t num_entries;
+    uint32_t num_slots;
+  } private_impl;
+} iconvg_icon_pack;  // ¶0.2
+
+// iconvg_icon_pack_entry is one named graphic in an iconvg_icon_pack. Its
+// pointers point into the pack's bytes. compiled_ptr is NULL (and compiled_len
+// is zero) if the pack has no compiled form for the graphic.
+typedef struct iconvg_icon_pack_entry_struct {
+  const uint8_t* name_ptr;
+  size_t name_len;
+  const uint8_t* src_ptr;
+  size_t src_len;
+  const uint8_t* compiled_ptr;
+  size_t compiled_len;
+} iconvg_icon_pack_entry;  // ¶0.2
+
+// ----
+
+// ICONVG_ATLAS_MAX_NUM_ENTRIES is the maximum num_entries argument to
+// iconvg_atlas_pack.
+#define ICONVG_ATLAS_MAX_NUM_ENTRIES 0x3FFFFFFF
+
+// iconvg_atlas_entry is one sub-rectangle of a texture atlas (or sprite
+// sheet): many graphics, typically many icons at several sizes, rendered into
+// one shared surface. The caller sets width and height (e.g. with
+// iconvg_atlas_entry__make) and iconvg_atlas_pack sets x and y, the top-left
+// corner. All four are in pixels.
+//
+// An entry with a zero width or height is not packed and gets a zero x and y.
+typedef struct iconvg_atlas_entry_struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t x;
+  uint32_t y;
+} iconvg_atlas_entry;  // ¶0.2
+
+// ----
+
+// iconvg_canvas_method is one of the iconvg_canvas_vtable methods, numbered
+// in vtable order. It indexes iconvg_canvas_stats' method_ticks.
+typedef enum iconvg_canvas_method_enum {
+  ICONVG_CANVAS_METHOD__BEGIN_DECODE = 0,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__END_DECODE = 1,                      // ¶0.2
+  ICONVG_CANVAS_METHOD__BEGIN_DRAWING = 2,                   // ¶0.2
+  ICONVG_CANVAS_METHOD__END_DRAWING = 3,                     // ¶0.2
+  ICONVG_CANVAS_METHOD__BEGIN_PATH = 4,                      // ¶0.2
+  ICONVG_CANVAS_METHOD__END_PATH = 5,                        // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_LINE_TO = 6,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_QUAD_TO = 7,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_CUBE_TO = 8,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX = 9,             // ¶0.2
+  ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE = 10,  // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_SEGMENTS = 11,                  // ¶0.2
+  ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING = 12,             // ¶0.2
+} iconvg_canvas_method;                                      // ¶0.2
+
+// ICONVG_CANVAS_NUM_METHODS is the number of iconvg_canvas_method values.
+#define ICONVG_CANVAS_NUM_METHODS 13
+
+// iconvg_canvas_stats holds what a stats canvas (see
+// iconvg_canvas__make_stats) counts and times. The caller sets the clock
+// fields and sample_interval and zeroes the rest. The canvas only ever adds to
+// the counters, so they accumulate over multiple decodes until the caller
+// re-zeroes them.
+typedef struct iconvg_canvas_stats_struct {
+  // clock_func, if non-NULL, returns a monotonically increasing timestamp in
+  // any unit (e.g. nanoseconds from clock_gettime or cycles from a time stamp
+  // counter). It is passed clock_context. If clock_func is NULL then the
+  // ticks fields below stay zero and only the counters are updated.
+  uint64_t (*clock_func)(void* clock_context);
+  void* clock_context;
+
+  // sample_interval, if greater than 1, means that only 1 in every
+  // sample_interval calls of each method is timed, reading the clock twice,
+  // and that call's ticks count sample_interval times. This cuts the
+  // overhead, for cheap and frequent methods like path_line_to, at the cost
+  // of estimating method_ticks and backend_ticks instead of measuring them.
+  // Zero or 1 means that every call is timed.
+  uint32_t sample_interval;
+
+  uint64_t num_decodes;
+  uint64_t num_decode_errors;
+  uint64_t num_drawings;
+  // num_skipped_drawings counts on_skipped_drawing calls: drawings that the
+  // decoder culled instead of emitting.
+  uint64_t num_skipped_drawings;
+  uint64_t num_paths;
+  // num_path_segments_calls counts path_segments calls, each of which carries
+  // a batch of one or more segments.
+  uint64_t num_path_segments_calls;
+  // num_segments and num_paints are indexed by iconvg_path_verb and
+  // iconvg_paint_type. Segments are counted the same way whether they arrive
+  // one per call or batched in path_segments.
+  uint64_t num_segments[4];
+  uint64_t num_paints[4];
+
+  // decode_ticks is the total time spent between begin_decode and end_decode,
+  // inclusive. backend_ticks is how much of that was spent inside the wrapped
+  // canvas' methods. The difference is the decoder's (and this canvas' own)
+  // share. method_ticks, indexed by iconvg_canvas_method, breaks
+  // backend_ticks down per method. decode_ticks is always measured, but the
+  // others are estimates if sample_interval is greater than 1.
+  uint64_t decode_ticks;
+  uint64_t backend_ticks;
+  uint64_t method_ticks[ICONVG_CANVAS_NUM_METHODS];
+
+  struct {
+    // countdown, indexed by iconvg_canvas_method, is how many calls of that
+    // method to skip before timing the next one.
+    uint32_t countdown[ICONVG_CANVAS_NUM_METHODS];
+  } private_impl;
+} iconvg_canvas_stats;  // ¶0.2
+
+// ----
+
+typedef enum iconvg_tessellation_mode_enum {
+  ICONVG_TESSELLATION_MODE__STENCIL_FANS = 0,  // ¶0.2
+  ICONVG_TESSELLATION_MODE__CURVES = 1,        // ¶0.2
+} iconvg_tessellation_mode;                    // ¶0.2
+
+// iconvg_tessellation_vertex is a point, in dst coordinate space, and its
+// curve coordinates. A fragment shader should discard fragments whose
+// interpolated ((u * u) - v) is positive. u and v are 0 and 1 for the
+// vertices of triangles that are not curve triangles, so that no fragments
+// are discarded.
+typedef struct iconvg_tessellation_vertex_struct {
+  float x;
+  float y;
+  float u;
+  float v;
+} iconvg_tessellation_vertex;  // ¶0.2
+
+// iconvg_tessellation_stop is a gradient stop.
+typedef struct iconvg_tessellation_stop_struct {
+  float offset;
+  iconvg_premul_color color;
+} iconvg_tessellation_stop;  // ¶0.2
+
+// iconvg_tessellation_draw is one drawing (one GPU draw call): the triangles
+// at indices[first_index .. first_index + num_indices] and a paint record.
+//
+// To fill it, first draw the triangles into the stencil buffer (and not the
+// color buffer), incrementing for front faces and decrementing for back faces
+// (both wrapping), then draw a quad over cover_rect, where the stencil is
+// non-zero, with the paint, clearing the stencil.
+//
+// For a flat color, only flat_color is meaningful. For a gradient,
+// gradient_matrix transforms from dst coordinate space to pattern coordinate
+// space (see iconvg_paint__gradient_transformation_matrix), and the stops are
+// at stops[first_stop .. first_stop + num_stops].
+typedef struct iconvg_tessellation_draw_struct {
+  uint32_t first_index;
+  uint32_t num_indices;
+  iconvg_rectangle_f32 cover_rect;
+  iconvg_paint_type paint_type;
+  iconvg_gradient_spread gradient_spread;
+  iconvg_premul_color flat_color;
+  iconvg_matrix_2x3_f64 gradient_matrix;
+  uint32_t first_stop;
+  uint32_t num_stops;
+} iconvg_tessellation_draw;  // ¶0.2
+
+// iconvg_tessellation holds the output of a tessellator canvas (see
+// iconvg_canvas__make_tessellator): vertex and index buffers of triangles, for
+// a GPU to fill (with stencil-and-cover), plus the draw calls and their
+// paints. The caller sets the etc_ptr and etc_len buffer fields, as this
+// library never allocates memory itself, and the mode and tolerance fields.
+//
+// In ICONVG_TESSELLATION_MODE__STENCIL_FANS mode, each drawing is a fan of
+// triangles, with quadratic and cubic Bézier curves flattened to line
+// segments. In ICONVG_TESSELLATION_MODE__CURVES mode, each quadratic curve
+// is instead a fan triangle plus one curve triangle (Loop-Blinn style) that
+// the fragment shader trims to the curve, so that curves stay smooth at any
+// scale. Cubic curves are first approximated by quadratic curves.
+//
+// tolerance is the maximum distance, in dst coordinate space (e.g. pixels),
+// of flattened lines (or approximating quadratic curves) to the true curve.
+// Non-positive or NaN values mean a default of 0.1.
+//
+// The canvas resets and sets the num_etc fields at the start of and during
+// each decode. They count what the decode produced, even if it did not fit.
+// If any num_etc field ends up greater than its etc_len field then only a
+// prefix was written and the decode should be retried with longer buffers
+// (see iconvg_tessellation__is_complete).
+typedef struct iconvg_tessellation_struct {
+  iconvg_tessellation_vertex* vertices_ptr;
+  size_t vertices_len;
+  uint32_t* indices_ptr;
+  size_t indices_len;
+  iconvg_tessellation_draw* draws_ptr;
+  size_t draws_len;
+  iconvg_tessellation_stop* stops_ptr;
+  size_t stops_len;
+
+  iconvg_tessellation_mode mode;
+  float tolerance;
+
+  size_t num_vertices;
+  size_t num_indices;
+  size_t num_draws;
+  size_t num_stops;
+
+  struct {
+    iconvg_rectangle_f32 dst_rect;
+    float tolerance;
+    float bounds[4];
+    float prev_x;
+    float prev_y;
+    uint32_t anchor_vertex;
+    uint32_t contour_start_vertex;
+    uint32_t prev_vertex;
+    uint32_t first_index;
+    bool has_anchor;
+  } private_impl;
+} iconvg_tessellation;  // ¶0.2
+
+// ----
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -493,6 +1149,24 @@ iconvg_canvas__make_debug(  // ¶0.1
     const char* message_prefix,
     iconvg_canvas* wrapped);
 
+// iconvg_canvas__make_stats returns an iconvg_canvas that updates stats'
+// counters (and, if stats has a clock_func, its timings) before forwarding
+// each vtable call on to the wrapped iconvg_canvas. Unlike a debug canvas, it
+// does no formatting or I/O, so it is cheap enough for profiling hot paths.
+//
+// wrapped may be NULL, with the same meaning as for iconvg_canvas__make_debug.
+//
+// If stats is NULL then the returned value will be broken (with
+// iconvg_error_invalid_constructor_argument).
+//
+// The caller of this function is responsible for ensuring that the pointers
+// remain valid while the returned iconvg_canvas is in use. A stats canvas is
+// not safe for concurrent use, even by separate iconvg_decode calls.
+iconvg_canvas               //
+iconvg_canvas__make_stats(  // ¶0.2
+    iconvg_canvas_stats* stats,
+    iconvg_canvas* wrapped);
+
 // iconvg_canvas__does_nothing returns whether self is NULL or *self is
 // zero-valued or broken. Other canvas values are presumed to do something.
 // Zero-valued means the result of "iconvg_canvas c = {0}". Broken means the
@@ -528,6 +1202,17 @@ iconvg_canvas               //
 iconvg_canvas__make_cairo(  // ¶0.1
     cairo_t* cr);
 
+// iconvg_canvas__make_cairo_with_gradient_cache is like
+// iconvg_canvas__make_cairo but looks up and stores gradient patterns in gc,
+// which may be NULL (equivalent to iconvg_canvas__make_cairo).
+//
+// The caller is responsible for ensuring that gc remains valid while the
+// returned iconvg_canvas is in use.
+iconvg_canvas                                   //
+iconvg_canvas__make_cairo_with_gradient_cache(  // ¶0.2
+    cairo_t* cr,
+    iconvg_gradient_cache* gc);
+
 // ----
 
 typedef struct sk_canvas_t sk_canvas_t;
@@ -545,6 +1230,311 @@ iconvg_canvas              //
 iconvg_canvas__make_skia(  // ¶0.1
     sk_canvas_t* sc);
 
+// iconvg_canvas__make_skia_with_gradient_cache is like
+// iconvg_canvas__make_skia but looks up and stores gradient shaders in gc,
+// which may be NULL (equivalent to iconvg_canvas__make_skia).
+//
+// The caller is responsible for ensuring that gc remains valid while the
+// returned iconvg_canvas is in use.
+iconvg_canvas                                  //
+iconvg_canvas__make_skia_with_gradient_cache(  // ¶0.2
+    sk_canvas_t* sc,
+    iconvg_gradient_cache* gc);
+
+// iconvg_canvas__make_skia_with_arena is like
+// iconvg_canvas__make_skia_with_gradient_cache but carves its per-decode state
+// from arena instead of calling malloc. gc and arena may each be NULL. If the
+// arena is too full then decoding fails with
+// iconvg_error_system_failure_out_of_memory.
+//
+// Skia's own objects (its path builder, paint, paths and shaders) are still
+// allocated by Skia. A gradient cache avoids re-creating shaders.
+//
+// The caller is responsible for ensuring that gc and arena remain valid while
+// the returned iconvg_canvas is in use, and should only reset the arena
+// between (not during) decodes.
+iconvg_canvas                         //
+iconvg_canvas__make_skia_with_arena(  // ¶0.2
+    sk_canvas_t* sc,
+    iconvg_gradient_cache* gc,
+    iconvg_arena* arena);
+
+// ----
+
+// iconvg_arena__initialize sets up self to allocate from ptr[.. len], which
+// must be 8-byte aligned (as memory returned by malloc is). This library never
+// allocates memory itself.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or ptr is NULL
+// or if ptr is misaligned.
+const char*                //
+iconvg_arena__initialize(  // ¶0.2
+    iconvg_arena* self,
+    void* ptr,
+    size_t len);
+
+// iconvg_arena__alloc returns len bytes of self's memory, 8-byte aligned, or
+// NULL if self is NULL or does not have len bytes left. The memory is not
+// zeroed. It remains valid until the next iconvg_arena__reset or
+// iconvg_arena__initialize.
+void*                 //
+iconvg_arena__alloc(  // ¶0.2
+    iconvg_arena* self,
+    size_t len);
+
+// iconvg_arena__reset releases all of self's allocations. self may be NULL, in
+// which case this is a no-op.
+void                  //
+iconvg_arena__reset(  // ¶0.2
+    iconvg_arena* self);
+
+// iconvg_arena__high_water_mark returns the most bytes (including alignment
+// padding) that self has been asked to hold at once since it was initialized,
+// counting allocations that failed for lack of room. An arena initialized
+// with at least that many bytes would have satisfied every request.
+size_t                          //
+iconvg_arena__high_water_mark(  // ¶0.2
+    const iconvg_arena* self);
+
+// ----
+
+// iconvg_gradient_cache_entries_len returns the minimum entries_len argument
+// (a number of bytes) that iconvg_gradient_cache__initialize accepts for the
+// given number of entries. It returns zero if num_entries is zero or too
+// large.
+size_t                              //
+iconvg_gradient_cache_entries_len(  // ¶0.2
+    size_t num_entries);
+
+// iconvg_gradient_cache__initialize sets up self to hold as many entries as
+// fit in entries_ptr[.. entries_len], which must be 8-byte aligned (as memory
+// returned by malloc is). This library never allocates memory itself.
+//
+// max_backend_bytes, if non-zero, also bounds the estimated total size of the
+// cached backend objects. The least recently used entries are evicted when
+// either limit would otherwise be exceeded.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or entries_ptr
+// is NULL, if entries_ptr is misaligned or if entries_len is too short for
+// even one entry.
+const char*                         //
+iconvg_gradient_cache__initialize(  // ¶0.2
+    iconvg_gradient_cache* self,
+    void* entries_ptr,
+    size_t entries_len,
+    size_t max_backend_bytes);
+
+// iconvg_gradient_cache__invalidate releases every cached backend object,
+// leaving self empty but still usable. self may be NULL, in which case this
+// function does nothing.
+void                                //
+iconvg_gradient_cache__invalidate(  // ¶0.2
+    iconvg_gradient_cache* self);
+
+// ----
+
+// iconvg_bitmap_cache_key__make returns the key for rendering the src
+// IconVG-formatted data to a pixels_width × pixels_height buffer, like
+// iconvg_decode with the same dst_rect and options (which may be NULL). It
+// hashes, but does not validate, src.
+iconvg_bitmap_cache_key         //
+iconvg_bitmap_cache_key__make(  // ¶0.2
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// iconvg_bitmap_cache_key__make_compiled is like iconvg_bitmap_cache_key__make
+// but for rendering with iconvg_decode_compiled. Its palette component only
+// covers the palette entries that the compiled form depends on (see
+// iconvg_compiled_palette_dependencies), so that palettes which agree on those
+// entries, including the suggested palette, share one cache entry. It does
+// not validate the compiled form beyond its header.
+iconvg_bitmap_cache_key                  //
+iconvg_bitmap_cache_key__make_compiled(  // ¶0.2
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_decode_options* options);
+
+// iconvg_bitmap_cache_workbuf_len returns the minimum workbuf_len argument (a
+// number of bytes) that iconvg_bitmap_cache__initialize accepts for the given
+// number of entries and total size (in bytes) of the cached pixels. It returns
+// zero if num_entries is zero or more than 0x40000000, or if the result would
+// overflow.
+//
+// Besides the pixels, the workbuf holds a fixed-size record per entry and a
+// hash table (of at most 16 bytes per entry) that indexes them by key.
+// Lookups, inserts and evictions take O(1) expected time, not O(num_entries),
+// so num_entries can be large. They do hold the cache's mutex, though, which
+// lookups also hold while copying out the cached pixels.
+size_t                            //
+iconvg_bitmap_cache_workbuf_len(  // ¶0.2
+    size_t num_entries,
+    size_t max_pixel_bytes);
+
+// iconvg_bitmap_cache__initialize sets up self to hold up to num_entries
+// pixel buffers in workbuf_ptr[.. workbuf_len], which must be 8-byte aligned
+// (as memory returned by malloc is). This library never allocates memory
+// itself. Whatever is left of workbuf_len after the num_entries bookkeeping
+// (see iconvg_bitmap_cache_workbuf_len) is the byte budget for pixels. The
+// least recently used entries are evicted when either limit would otherwise
+// be exceeded.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or workbuf_ptr
+// is NULL, if workbuf_ptr is misaligned or if workbuf_len is too short. It
+// returns iconvg_error_system_failure_out_of_memory if it could not create a
+// mutex. Otherwise, it returns NULL and the caller should call
+// iconvg_bitmap_cache__finalize when done.
+const char*                       //
+iconvg_bitmap_cache__initialize(  // ¶0.2
+    iconvg_bitmap_cache* self,
+    void* workbuf_ptr,
+    size_t workbuf_len,
+    size_t num_entries);
+
+// iconvg_bitmap_cache__finalize releases any resources (other than the
+// workbuf memory, which the caller owns) held by self. self may be NULL, in
+// which case this function does nothing.
+void                            //
+iconvg_bitmap_cache__finalize(  // ¶0.2
+    iconvg_bitmap_cache* self);
+
+// iconvg_bitmap_cache__lookup returns whether self holds the pixels for key.
+// If so, it copies them to dst_ptr, whose consecutive rows start dst_stride
+// bytes apart, and marks the entry as most recently used.
+//
+// It returns false if self or key is NULL. dst_ptr may be NULL, in which case
+// this function merely checks for the key.
+bool                          //
+iconvg_bitmap_cache__lookup(  // ¶0.2
+    iconvg_bitmap_cache* self,
+    const iconvg_bitmap_cache_key* key,
+    uint8_t* dst_ptr,
+    size_t dst_stride);
+
+// iconvg_bitmap_cache__insert copies the pixels for key (with key's pixel
+// dimensions) from src_ptr, whose consecutive rows start src_stride bytes
+// apart, into self, evicting other entries as necessary.
+//
+// Pixel buffers larger than self's whole byte budget are not stored, but that
+// is not an error. Callers using Cairo should call cairo_surface_flush before
+// passing a surface's data.
+//
+// It returns iconvg_error_invalid_constructor_argument if self, key or src_ptr
+// is NULL or if src_stride is less than 4 times the key's pixel width.
+// Otherwise, it returns NULL.
+const char*                   //
+iconvg_bitmap_cache__insert(  // ¶0.2
+    iconvg_bitmap_cache* self,
+    const iconvg_bitmap_cache_key* key,
+    const uint8_t* src_ptr,
+    size_t src_stride);
+
+// ----
+
+// iconvg_rasterizer_scratch_len returns the minimum scratch_len argument (a
+// number of floats, not bytes) that iconvg_canvas__make_rasterizer accepts for
+// the given pixel dimensions. It returns zero if either dimension is zero or
+// larger than 0x100000.
+size_t                          //
+iconvg_rasterizer_scratch_len(  // ¶0.2
+    uint32_t pixels_width,
+    uint32_t pixels_height);
+
+// iconvg_canvas__make_rasterizer returns an iconvg_canvas that fills paths
+// directly into a pixel buffer, without using a third party graphics library.
+// It is always available, regardless of ICONVG_CONFIG__ENABLE_ETC macros.
+//
+// The pixel buffer has pixels_width × pixels_height pixels, 4 bytes each:
+// alpha-premultiplied R, G, B and A, in that order. Consecutive rows start
+// pixels_stride bytes apart. Each drawing is composited (with the SRC_OVER
+// Porter-Duff operator) onto the buffer's existing contents, so callers will
+// typically clear it to transparent black beforehand.
+//
+// scratch_ptr[.. scratch_len] is working memory, of at least
+// iconvg_rasterizer_scratch_len(pixels_width, pixels_height) floats. This
+// library never allocates memory itself. The scratch memory is initialized by
+// this function and is not safe to share between concurrently used canvases.
+//
+// If pixels_ptr or scratch_ptr is NULL, if pixels_stride is less than 4 *
+// pixels_width or if scratch_len is too short then the returned value will be
+// broken (with iconvg_error_invalid_constructor_argument).
+//
+// The caller is responsible for ensuring that both pointers remain valid while
+// the returned iconvg_canvas is in use.
+iconvg_canvas                    //
+iconvg_canvas__make_rasterizer(  // ¶0.2
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len);
+
+// iconvg_coverage_masks__initialize sets up self to record into buf_ptr[..
+// buf_len]. This library never allocates memory itself. Each drawing needs 16
+// bytes plus, for each row that the drawing touches, 8 bytes and one byte per
+// pixel from that row's first to last pixel of non-zero coverage. That is at
+// most one byte per pixel of dst_rect (clipped to the pixel buffer).
+//
+// It returns iconvg_error_invalid_constructor_argument if self or buf_ptr is
+// NULL.
+const char*                         //
+iconvg_coverage_masks__initialize(  // ¶0.2
+    iconvg_coverage_masks* self,
+    uint8_t* buf_ptr,
+    size_t buf_len);
+
+// iconvg_coverage_masks__required_len returns the number of buffer bytes that
+// the last recording needed, whether or not they fit. If they did not fit
+// then iconvg_coverage_masks__composite will fail until the masks are
+// re-recorded with a longer buffer.
+size_t                                //
+iconvg_coverage_masks__required_len(  // ¶0.2
+    const iconvg_coverage_masks* self);
+
+// iconvg_canvas__make_rasterizer_with_coverage_masks is like
+// iconvg_canvas__make_rasterizer but also records each drawing's coverage
+// into masks, which are reset at the start of each decode. The caller is
+// responsible for ensuring that masks remains valid while the returned
+// iconvg_canvas is in use.
+//
+// If masks is NULL then the returned value will be broken (with
+// iconvg_error_invalid_constructor_argument).
+iconvg_canvas                                        //
+iconvg_canvas__make_rasterizer_with_coverage_masks(  // ¶0.2
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len,
+    iconvg_coverage_masks* masks);
+
+// ----
+
+// iconvg_canvas__make_tessellator returns an iconvg_canvas that tessellates
+// paths into t's vertex, index, draw and stop buffers instead of rasterizing
+// them. It does not allocate memory. The caller is responsible for ensuring
+// that t remains valid while the returned iconvg_canvas is in use.
+//
+// If t is NULL then the returned value will be broken (with
+// iconvg_error_invalid_constructor_argument).
+iconvg_canvas                     //
+iconvg_canvas__make_tessellator(  // ¶0.2
+    iconvg_tessellation* t);
+
+// iconvg_tessellation__is_complete returns whether all of the last decode's
+// output fit in self's buffers.
+bool                               //
+iconvg_tessellation__is_complete(  // ¶0.2
+    const iconvg_tessellation* self);
+
 // ----
 
 // iconvg_decode decodes the src IconVG-formatted data, calling dst_canvas's
@@ -567,6 +1557,80 @@ iconvg_decode(  // ¶0.1
     size_t src_len,
     const iconvg_decode_options* options);
 
+// iconvg_decode_batch runs iconvg_decode once per element of jobs (an array of
+// num_jobs iconvg_decode_job values), setting each job's err_msg field to the
+// result of the corresponding iconvg_decode call.
+//
+// If the library was built with the ICONVG_CONFIG__ENABLE_PTHREADS macro
+// defined then the jobs are spread over up to num_threads threads (including
+// the calling thread), each thread repeatedly taking the next not-yet-started
+// job. Otherwise, or if num_threads <= 1, all jobs run on the calling thread.
+// Either way, all jobs are complete when this function returns.
+//
+// The jobs may run concurrently, so no two jobs should share a dst_canvas (or
+// anything else that is not safe to use from multiple threads at once, such
+// as a cairo_t). Sharing src bytes or options is fine.
+//
+// It returns NULL if every job succeeded, or else the err_msg of the first (in
+// array order, not in time order) job that failed.
+const char*           //
+iconvg_decode_batch(  // ¶0.2
+    iconvg_decode_job* jobs,
+    size_t num_jobs,
+    uint32_t num_threads);
+
+// iconvg_stream_decoder_workbuf_len returns the minimum workbuf_len argument
+// (a number of bytes) that iconvg_stream_decoder__initialize accepts.
+size_t                              //
+iconvg_stream_decoder_workbuf_len(  // ¶0.2
+    void);
+
+// iconvg_stream_decoder__initialize sets up self to decode to dst_canvas, like
+// iconvg_decode with the same dst_canvas, dst_rect and options arguments.
+//
+// workbuf_ptr[.. workbuf_len] is working memory, of at least
+// iconvg_stream_decoder_workbuf_len() bytes and 8-byte aligned (as memory
+// returned by malloc is). This library never allocates memory itself. The
+// caller is responsible for ensuring that workbuf_ptr, dst_canvas and options
+// remain valid until iconvg_stream_decoder__close returns.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or workbuf_ptr
+// is NULL or if workbuf_ptr is misaligned or too short. It returns
+// iconvg_error_unsupported_vtable if dst_canvas' vtable is unsupported. Either
+// way, no canvas methods are called and self should not be used further.
+// Otherwise, it returns NULL and the caller should call
+// iconvg_stream_decoder__close exactly once when done.
+const char*                         //
+iconvg_stream_decoder__initialize(  // ¶0.2
+    iconvg_stream_decoder* self,
+    void* workbuf_ptr,
+    size_t workbuf_len,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_decode_options* options);
+
+// iconvg_stream_decoder__write passes the next src_len source bytes to the
+// decoder, which executes every complete op so far. Any trailing partial op
+// is kept (in the workbuf) until the next write or close.
+//
+// It returns iconvg_note_need_more_input if there were no errors (IconVG data
+// has no end marker, so only close can tell that the source is complete).
+// Otherwise, it returns the same error that iconvg_decode would and any
+// subsequent writes return it too. The canvas' begin_decode method is called
+// during the first write (or close).
+const char*                    //
+iconvg_stream_decoder__write(  // ¶0.2
+    iconvg_stream_decoder* self,
+    const uint8_t* src_ptr,
+    size_t src_len);
+
+// iconvg_stream_decoder__close marks the end of the source bytes, executes any
+// remaining ops and calls the canvas' end_decode method. It returns
+// whatever end_decode returns, just like iconvg_decode does.
+const char*                    //
+iconvg_stream_decoder__close(  // ¶0.2
+    iconvg_stream_decoder* self);
+
 // iconvg_decode_viewbox sets *dst_viewbox to the ViewBox Metadata from the src
 // IconVG-formatted data.
 //
@@ -581,6 +1645,283 @@ iconvg_decode_viewbox(  // ¶0.1
     const uint8_t* src_ptr,
     size_t src_len);
 
+// iconvg_validate returns whether the src IconVG-formatted data is well
+// formed: NULL if it is, otherwise the same iconvg_error_bad_etc error that
+// iconvg_decode would return. It is a single linear pass that checks the
+// magic identifier, the metadata and that every bytecode op is valid and
+// complete, but skips over numbers without decoding their values, so it is
+// cheaper than decoding (even to a no-op canvas) or than iconvg_probe.
+//
+// It is meant for checking untrusted data once, e.g. when it is uploaded,
+// instead of finding out at render time. Even when it returns NULL,
+// iconvg_decode can still fail with iconvg_error_invalid_paint_type, as
+// whether a color register holds a valid paint can depend on the
+// iconvg_decode_options palette, or with an error from the canvas.
+const char*       //
+iconvg_validate(  // ¶0.2
+    const uint8_t* src_ptr,
+    size_t src_len);
+
+// iconvg_probe sets *dst to the src IconVG-formatted data's ViewBox,
+// suggested palette and bytecode offset, without executing the bytecode. If
+// scan_bytecode is true, it also walks the bytecode once, without making any
+// canvas calls, to count the drawings, gradients and path segments that a
+// render would involve.
+//
+// On error, the fields that were probed before the error was found (e.g. the
+// metadata, for a bytecode error) are still set.
+const char*    //
+iconvg_probe(  // ¶0.2
+    iconvg_probe_results* dst,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    bool scan_bytecode);
+
+// iconvg_compile decodes the src IconVG-formatted data once, writing a
+// compiled form to dst that iconvg_decode_compiled can replay more cheaply
+// than iconvg_decode can decode src. The compiled form holds absolute
+// ViewBox-space paths and pre-decoded registers, but does not depend on the
+// dst_rect, palette or height_in_pixels later passed to iconvg_decode_compiled.
+//
+// On success or on iconvg_error_system_failure_dst_buffer_too_short,
+// *dst_compiled_len is set to the compiled form's length in bytes. Passing a
+// NULL dst_ptr and zero dst_len therefore queries the required dst_len. On
+// other errors, *dst_compiled_len is set to zero. dst_compiled_len may be
+// NULL.
+//
+// The compiled form is not a stable file format. It should only be replayed
+// by the same library version that produced it. It has no alignment
+// requirements.
+const char*      //
+iconvg_compile(  // ¶0.2
+    uint8_t* dst_ptr,
+    size_t dst_len,
+    size_t* dst_compiled_len,
+    const uint8_t* src_ptr,
+    size_t src_len);
+
+// iconvg_decode_compiled is like iconvg_decode except that its source is the
+// compiled form produced by iconvg_compile instead of IconVG-formatted data.
+// The callbacks to dst_canvas are the same as what iconvg_decode would make.
+//
+// File format errors are reported by iconvg_compile, not by this function.
+// The exception is iconvg_error_invalid_paint_type, since whether a paint is
+// valid can depend on the options' palette.
+//
+// The num_bytes_consumed and num_bytes_remaining arguments to end_decode count
+// bytes of the compiled form.
+const char*              //
+iconvg_decode_compiled(  // ¶0.2
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_decode_options* options);
+
+// iconvg_compiled_palette_dependencies sets *dst_mask to the set of custom
+// palette entries that the compiled form's drawings depend on: bit i is set
+// if changing the i'th color of the iconvg_decode_options palette could change
+// the rendering. A zero mask means that the rendering does not depend on the
+// palette at all, so one rendering can be reused for every palette.
+//
+// The mask assumes that the palette's colors are valid premultiplied colors
+// (as required by the IconVG specification). It is also conservative: it can
+// include entries that, e.g. due to Level of Detail, make no visible
+// difference.
+//
+// dst_mask may be NULL, in which case the function merely validates the
+// compiled form's header.
+const char*                            //
+iconvg_compiled_palette_dependencies(  // ¶0.2
+    uint64_t* dst_mask,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len);
+
+// iconvg_coverage_masks__composite is like iconvg_decode_compiled to a
+// rasterizer canvas, with the same pixel buffer arguments, except that each
+// drawing's coverage comes from masks instead of from rasterizing its paths.
+// Only the paints (which can depend on the options' palette) are evaluated.
+//
+// The masks must have been recorded by iconvg_decode_compiled, with the same
+// compiled form, pixel dimensions, dst_rect and options' height_in_pixels,
+// transform and clip_rect, to a canvas made by
+// iconvg_canvas__make_rasterizer_with_coverage_masks. The options' palette
+// may differ. The result is then the same as decoding
+// directly. Mismatches that can be detected, including masks that did not
+// fit their buffer, return iconvg_error_invalid_coverage_masks.
+const char*                        //
+iconvg_coverage_masks__composite(  // ¶0.2
+    const iconvg_coverage_masks* self,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_decode_options* options);
+
+// ----
+
+// iconvg_player_frame__make returns a frame with the identity transform, a
+// NULL palette and an alpha of 1: the graphic as iconvg_decode_compiled would
+// render it.
+iconvg_player_frame         //
+iconvg_player_frame__make(  // ¶0.2
+    void);
+
+// iconvg_player__initialize sets up self to play the compiled form in
+// compiled_ptr[.. compiled_len], which must outlive self. A NULL palette means
+// the graphic's suggested palette. Otherwise, *palette is copied.
+//
+// masks, if non-NULL, must outlive self and is then owned by the player,
+// which records into and composites from it in iconvg_player__render_pixels.
+//
+// It returns iconvg_error_invalid_constructor_argument if self is NULL, or an
+// error if the compiled form's header is invalid.
+const char*                 //
+iconvg_player__initialize(  // ¶0.2
+    iconvg_player* self,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_palette* palette,
+    iconvg_coverage_masks* masks);
+
+// iconvg_player__render draws one frame to dst_canvas. A NULL frame is
+// equivalent to iconvg_player_frame__make().
+//
+// Level of Detail uses the height of dst_rect, before the frame's transform,
+// so that a scaling animation does not switch between detail levels midway.
+//
+// For a Cairo canvas, the frame's transform is applied to the cairo_t's
+// current transformation matrix (and restored afterwards), so that Cairo
+// transforms the points. Other canvases get already transformed points. Cairo
+// also clips to the transformed dst_rect itself, instead of to its bounding
+// box, which only differs for rotations and skews.
+const char*             //
+iconvg_player__render(  // ¶0.2
+    iconvg_player* self,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_player_frame* frame);
+
+// iconvg_player__render_pixels is like iconvg_player__render to a canvas made
+// by iconvg_canvas__make_rasterizer (with the same arguments), drawing over
+// the pixel buffer's existing contents.
+//
+// If the player has coverage masks, recorded by an earlier call with the same
+// pixel dimensions, dst_rect and frame transform, then only the frame's
+// palette or alpha can have changed. The masks are then composited (see
+// iconvg_coverage_masks__composite) instead of rasterizing the paths again,
+// and scratch_ptr may be NULL. Otherwise, the frame is rasterized and, if they
+// fit, the masks are re-recorded.
+const char*                    //
+iconvg_player__render_pixels(  // ¶0.2
+    iconvg_player* self,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_player_frame* frame);
+
+// ----
+
+// iconvg_icon_pack__initialize sets up self to read the icon pack in
+// ptr[.. len], which must outlive self. It validates the pack's header and
+// index (but not the IconVG data) up front, so that later lookups are O(1)
+// and do not touch the data pages.
+//
+// It returns iconvg_error_invalid_constructor_argument if self is NULL,
+// iconvg_error_bad_magic_identifier if ptr[.. len] does not start with an
+// icon pack header and iconvg_error_bad_icon_pack if the index is malformed.
+const char*                    //
+iconvg_icon_pack__initialize(  // ¶0.2
+    iconvg_icon_pack* self,
+    const uint8_t* ptr,
+    size_t len);
+
+// iconvg_icon_pack__number_of_entries returns the number of graphics in self.
+uint32_t                              //
+iconvg_icon_pack__number_of_entries(  // ¶0.2
+    const iconvg_icon_pack* self);
+
+// iconvg_icon_pack__entry sets *dst to the index'th graphic in self, in
+// ascending name order. It returns false, leaving *dst unchanged, if index is
+// out of range.
+bool                      //
+iconvg_icon_pack__entry(  // ¶0.2
+    const iconvg_icon_pack* self,
+    iconvg_icon_pack_entry* dst,
+    uint32_t index);
+
+// iconvg_icon_pack__lookup sets *dst to the graphic with the given name (a
+// byte string, not necessarily NUL-terminated), using the pack's hash index.
+// It returns false, leaving *dst unchanged, if there is no such graphic.
+bool                       //
+iconvg_icon_pack__lookup(  // ¶0.2
+    const iconvg_icon_pack* self,
+    iconvg_icon_pack_entry* dst,
+    const char* name_ptr,
+    size_t name_len);
+
+// ----
+
+// iconvg_atlas_entry__make returns an entry whose larger side is max_side
+// pixels and whose aspect ratio matches viewbox (e.g. from
+// iconvg_decode_viewbox), with a zero x and y. Its width and height are zero
+// if the viewbox is empty.
+iconvg_atlas_entry         //
+iconvg_atlas_entry__make(  // ¶0.2
+    const iconvg_rectangle_f32* viewbox,
+    uint32_t max_side);
+
+// iconvg_atlas_entry__dst_rect returns the dst_rect argument for decoding a
+// graphic into self's sub-rectangle of the atlas' canvas. Every backend clips
+// to the dst_rect, so neighboring entries do not bleed into each other.
+iconvg_rectangle_f32           //
+iconvg_atlas_entry__dst_rect(  // ¶0.2
+    const iconvg_atlas_entry* self);
+
+// iconvg_atlas_scratch_len returns the minimum scratch_len argument (a number
+// of uint32_t elements, not bytes) that iconvg_atlas_pack accepts for
+// num_entries entries. It returns zero if num_entries exceeds
+// ICONVG_ATLAS_MAX_NUM_ENTRIES.
+size_t                     //
+iconvg_atlas_scratch_len(  // ¶0.2
+    size_t num_entries);
+
+// iconvg_atlas_pack packs the entries into an atlas no larger than max_width
+// by max_height pixels, setting each entry's x and y. There are at least
+// padding pixels between any two entries (but not around the atlas' edges),
+// so that texture filtering does not sample a neighbor.
+//
+// It uses a skyline (bottom-left) packer, placing taller entries first. The
+// packing is deterministic: it depends only on the entries' sizes, their
+// order and the other arguments.
+//
+// On success, it sets *dst_width and *dst_height (if non-NULL) to the size
+// of the bounding box of the packed entries, which is often smaller than the
+// maximum. It returns iconvg_error_system_failure_atlas_too_small if the
+// entries do not fit, in which case the entries' x and y are unspecified.
+//
+// scratch_ptr[.. scratch_len] is working memory, whose contents do not need
+// to be preserved between calls. See iconvg_atlas_scratch_len. The function
+// does not allocate memory.
+const char*         //
+iconvg_atlas_pack(  // ¶0.2
+    iconvg_atlas_entry* entries,
+    size_t num_entries,
+    uint32_t max_width,
+    uint32_t max_height,
+    uint32_t padding,
+    uint32_t* scratch_ptr,
+    size_t scratch_len,
+    uint32_t* dst_width,
+    uint32_t* dst_height);
+
 // ----
 
 // iconvg_paint__type returns what type of paint self is.
@@ -743,6 +2084,24 @@ canvas__make_skia(           // ¶0.1
     }                                                 \
   } while (false)
 
+// ICONVG_PRIVATE_ALWAYS_INLINE marks a function that must be inlined into its
+// callers for the compiler to specialize it, such as an opcode loop that is
+// instantiated once per value of a bool argument.
+#if defined(__GNUC__) || defined(__clang__)
+#define ICONVG_PRIVATE_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define ICONVG_PRIVATE_ALWAYS_INLINE inline
+#endif
+
+// ICONVG_PRIVATE_NOINLINE marks a function that should stay out of line, so
+// that its code does not add to the register pressure and size of a hot loop
+// that only sometimes calls it.
+#if defined(__GNUC__) || defined(__clang__)
+#define ICONVG_PRIVATE_NOINLINE __attribute__((noinline))
+#else
+#define ICONVG_PRIVATE_NOINLINE
+#endif
+
 // ----
 
 extern const char iconvg_private_internal_error_unreachable[];
@@ -777,6 +2136,33 @@ iconvg_private_reinterpret_from_u32_to_f32(uint32_t u) {
   return f;
 }
 
+static inline uint32_t  //
+iconvg_private_reinterpret_from_f32_to_u32(float f) {
+  uint32_t u = 0;
+  if (sizeof(uint32_t) == sizeof(float)) {
+    memcpy(&u, &f, sizeof(uint32_t));
+  }
+  return u;
+}
+
+static inline double  //
+iconvg_private_reinterpret_from_u64_to_f64(uint64_t u) {
+  double f = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&f, &u, sizeof(uint64_t));
+  }
+  return f;
+}
+
+static inline uint64_t  //
+iconvg_private_reinterpret_from_f64_to_u64(double f) {
+  uint64_t u = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&u, &f, sizeof(uint64_t));
+  }
+  return u;
+}
+
 // ----
 
 static inline size_t  //
@@ -787,31 +2173,603 @@ iconvg_private_canvas_sizeof_vtable(iconvg_canvas* c) {
   return 0;
 }
 
-// ----
-
-static inline iconvg_rectangle_f32  //
-iconvg_private_default_viewbox() {
-  iconvg_rectangle_f32 r;
-  r.min_x = -32.0f;
-  r.min_y = -32.0f;
-  r.max_x = +32.0f;
-  r.max_y = +32.0f;
-  return r;
+// ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1 is the sizeof a ¶0.1
+// iconvg_canvas_vtable, before the path_segments field was appended.
+#define ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1 \
+  offsetof(iconvg_canvas_vtable, path_segments)
+
+// iconvg_private_canvas_vtable_is_supported returns whether iconvg_decode and
+// similar functions can call c's methods. Older (smaller) vtables are
+// supported, since fields are only ever appended and the fields appended after
+// ¶0.1 are all optional. If we want to support newer library versions (with
+// dynamic linking), we could also accept larger vtables here.
+static inline bool  //
+iconvg_private_canvas_vtable_is_supported(iconvg_canvas* c) {
+  size_t n = iconvg_private_canvas_sizeof_vtable(c);
+  return (ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1 <= n) &&
+         (n <= sizeof(iconvg_canvas_vtable));
 }
 
-// ----
+static inline bool  //
+iconvg_private_canvas_has_path_segments(iconvg_canvas* c) {
+  return (iconvg_private_canvas_sizeof_vtable(c) >=
+          (offsetof(iconvg_canvas_vtable, path_segments) +
+           sizeof(c->vtable->path_segments))) &&
+         c->vtable->path_segments;
+}
 
-typedef struct iconvg_private_decoder_struct {
-  const uint8_t* ptr;
-  size_t len;
-} iconvg_private_decoder;
+// iconvg_private_canvas__on_skipped_drawing calls c's on_skipped_drawing
+// method, if it has one.
+static inline const char*  //
+iconvg_private_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  if ((iconvg_private_canvas_sizeof_vtable(c) >=
+       (offsetof(iconvg_canvas_vtable, on_skipped_drawing) +
+        sizeof(c->vtable->on_skipped_drawing))) &&
+      c->vtable->on_skipped_drawing) {
+    return (*c->vtable->on_skipped_drawing)(c);
+  }
+  return NULL;
+}
 
 // ----
 
-extern const uint8_t iconvg_private_one_byte_colors[512];
-extern const iconvg_palette iconvg_private_default_palette;
+// Single-backend builds can define one of these macros, so that the opcode
+// loops (of iconvg_decode, iconvg_decode_compiled and the stream decoder) call
+// that backend's canvas methods directly instead of through the vtable:
+//  - ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND
+//  - ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND
+//  - ICONVG_CONFIG__SPECIALIZE_RASTERIZER_BACKEND
+// The Cairo and Skia ones also need the matching ICONVG_CONFIG__ENABLE_ETC
+// macro. This only works with the single file (amalgamated) library, where the
+// backend's static functions are visible to the decoders.
+//
+// Each loop is then instantiated twice. The specialized copy is used when the
+// canvas is one of that backend's, not wrapped (e.g. by a transform), and lets
+// the compiler inline the backend's begin_drawing, begin_path etc methods and,
+// for backends without a path_segments method, its per-segment methods. Every
+// other canvas takes the generic (vtable) copy, as usual.
+//
+// ICONVG_PRIVATE_SPECIALIZED(method) names the chosen backend's function for
+// a canvas method.
+#if defined(ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND) +   \
+        defined(ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND) + \
+        defined(ICONVG_CONFIG__SPECIALIZE_RASTERIZER_BACKEND) > \
+    1
+#error "at most one ICONVG_CONFIG__SPECIALIZE_ETC macro can be defined"
+#elif defined(ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND)
+#if !defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+#error "ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND needs ..._ENABLE_CAIRO_BACKEND"
+#endif
+#define ICONVG_PRIVATE_SPECIALIZED(method) iconvg_private_cairo_canvas__##method
+#elif defined(ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND)
+#if !defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+#error "ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND needs ..._ENABLE_SKIA_BACKEND"
+#endif
+#define ICONVG_PRIVATE_SPECIALIZED(method) iconvg_private_skia_canvas__##method
+#elif defined(ICONVG_CONFIG__SPECIALIZE_RASTERIZER_BACKEND)
+#define ICONVG_PRIVATE_SPECIALIZED(method) \
+  iconvg_private_rasterizer_canvas__##method
+#endif
 
-static inline void  //
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+
+// These are defined (as static functions) later in the single file library.
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(begin_drawing)(iconvg_canvas* c);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(end_drawing)(iconvg_canvas* c,
+                                        const iconvg_paint* p);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(begin_path)(iconvg_canvas* c, float x0, float y0);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(end_path)(iconvg_canvas* c);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(path_line_to)(iconvg_canvas* c, float x1, float y1);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(path_quad_to)(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(path_cube_to)(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2,
+                                         float x3,
+                                         float y3);
+
+#define ICONVG_PRIVATE_IF_SPECIALIZED(specialized, method, ...) \
+  if (specialized) {                                            \
+    return ICONVG_PRIVATE_SPECIALIZED(method)(__VA_ARGS__);     \
+  }
+
+#else
+#define ICONVG_PRIVATE_IF_SPECIALIZED(specialized, method, ...)
+#endif  // defined(ICONVG_PRIVATE_SPECIALIZED)
+
+// iconvg_private_canvas_is_specialized returns whether c is a canvas of the
+// ICONVG_CONFIG__SPECIALIZE_ETC backend. All of a backend's canvases share
+// one vtable, so it suffices to check one of the vtable's methods.
+static inline bool  //
+iconvg_private_canvas_is_specialized(iconvg_canvas* c) {
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+  return c && c->vtable &&
+         (c->vtable->begin_path == &ICONVG_PRIVATE_SPECIALIZED(begin_path));
+#else
+  return false;
+#endif
+}
+
+// iconvg_private_canvas__begin_drawing etc call c's method, either directly
+// (if specialized, a compile time constant) or through c's vtable.
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__begin_drawing(iconvg_canvas* c, bool specialized) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, begin_drawing, c);
+  return (*c->vtable->begin_drawing)(c);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__end_drawing(iconvg_canvas* c,
+                                   bool specialized,
+                                   const iconvg_paint* p) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, end_drawing, c, p);
+  return (*c->vtable->end_drawing)(c, p);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__begin_path(iconvg_canvas* c,
+                                  bool specialized,
+                                  float x0,
+                                  float y0) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, begin_path, c, x0, y0);
+  return (*c->vtable->begin_path)(c, x0, y0);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__end_path(iconvg_canvas* c, bool specialized) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, end_path, c);
+  return (*c->vtable->end_path)(c);
+}
+
+// ----
+
+#define ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS 32
+
+// iconvg_private_path_batch accumulates consecutive path segments for a
+// canvas' path_segments method. If the canvas doesn't have that method then
+// enabled is false and segments are passed straight through to the canvas'
+// per-segment methods (directly, not through the vtable, for a specialized
+// canvas; see ICONVG_PRIVATE_SPECIALIZED).
+typedef struct iconvg_private_path_batch_struct {
+  bool enabled;
+  size_t num_verbs;
+  size_t num_points;
+  uint8_t verbs[ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS];
+  float points[6 * ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS];
+} iconvg_private_path_batch;
+
+static inline void  //
+iconvg_private_path_batch__initialize(iconvg_private_path_batch* self,
+                                      iconvg_canvas* c) {
+  self->enabled = iconvg_private_canvas_has_path_segments(c);
+  self->num_verbs = 0;
+  self->num_points = 0;
+}
+
+// iconvg_private_path_batch__flush passes any accumulated segments to c. It
+// must be called before any other (non-segment) canvas method is called.
+static inline const char*  //
+iconvg_private_path_batch__flush(iconvg_private_path_batch* self,
+                                 iconvg_canvas* c) {
+  size_t n = self->num_verbs;
+  if (n == 0) {
+    return NULL;
+  }
+  self->num_verbs = 0;
+  self->num_points = 0;
+  return (*c->vtable->path_segments)(c, &self->verbs[0], n, &self->points[0]);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_path_batch__line_to(iconvg_private_path_batch* self,
+                                   iconvg_canvas* c,
+                                   bool specialized,
+                                   float x1,
+                                   float y1) {
+  if (!self->enabled) {
+    ICONVG_PRIVATE_IF_SPECIALIZED(specialized, path_line_to, c, x1, y1);
+    return (*c->vtable->path_line_to)(c, x1, y1);
+  } else if (self->num_verbs == ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(self, c));
+  }
+  float* p = &self->points[self->num_points];
+  p[0] = x1;
+  p[1] = y1;
+  self->num_points += 2;
+  self->verbs[self->num_verbs++] = ICONVG_PATH_VERB__LINE_TO;
+  return NULL;
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_path_batch__quad_to(iconvg_private_path_batch* self,
+                                   iconvg_canvas* c,
+                                   bool specialized,
+                                   float x1,
+                                   float y1,
+                                   float x2,
+                                   float y2) {
+  if (!self->enabled) {
+    ICONVG_PRIVATE_IF_SPECIALIZED(specialized, path_quad_to, c, x1, y1, x2, y2);
+    return (*c->vtable->path_quad_to)(c, x1, y1, x2, y2);
+  } else if (self->num_verbs == ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(self, c));
+  }
+  float* p = &self->points[self->num_points];
+  p[0] = x1;
+  p[1] = y1;
+  p[2] = x2;
+  p[3] = y2;
+  self->num_points += 4;
+  self->verbs[self->num_verbs++] = ICONVG_PATH_VERB__QUAD_TO;
+  return NULL;
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_path_batch__cube_to(iconvg_private_path_batch* self,
+                                   iconvg_canvas* c,
+                                   bool specialized,
+                                   float x1,
+                                   float y1,
+                                   float x2,
+                                   float y2,
+                                   float x3,
+                                   float y3) {
+  if (!self->enabled) {
+    ICONVG_PRIVATE_IF_SPECIALIZED(specialized, path_cube_to, c, x1, y1, x2, y2,
+                                  x3, y3);
+    return (*c->vtable->path_cube_to)(c, x1, y1, x2, y2, x3, y3);
+  } else if (self->num_verbs == ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(self, c));
+  }
+  float* p = &self->points[self->num_points];
+  p[0] = x1;
+  p[1] = y1;
+  p[2] = x2;
+  p[3] = y2;
+  p[4] = x3;
+  p[5] = y3;
+  self->num_points += 6;
+  self->verbs[self->num_verbs++] = ICONVG_PATH_VERB__CUBE_TO;
+  return NULL;
+}
+
+// iconvg_private_canvas__path_segments calls c's path_segments method, if it
+// has one, or otherwise calls its per-segment methods.
+static inline const char*  //
+iconvg_private_canvas__path_segments(iconvg_canvas* c,
+                                     const uint8_t* verbs,
+                                     size_t num_verbs,
+                                     const float* points) {
+  if (iconvg_private_canvas_has_path_segments(c)) {
+    return (*c->vtable->path_segments)(c, verbs, num_verbs, points);
+  }
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(c, points[0], points[1]));
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to)(c, points[0], points[1],
+                                                      points[2], points[3]));
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
+            c, points[0], points[1], points[2], points[3], points[4],
+            points[5]));
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
+// ----
+
+static inline iconvg_rectangle_f32  //
+iconvg_private_default_viewbox() {
+  iconvg_rectangle_f32 r;
+  r.min_x = -32.0f;
+  r.min_y = -32.0f;
+  r.max_x = +32.0f;
+  r.max_y = +32.0f;
+  return r;
+}
+
+// ----
+
+typedef struct iconvg_private_decoder_struct {
+  const uint8_t* ptr;
+  size_t len;
+} iconvg_private_decoder;
+
+static inline bool  //
+iconvg_private_decoder__decode_coordinate_number(iconvg_private_decoder* self,
+                                                 float* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      int32_t i = (int32_t)(v >> 1);
+      *dst = ((float)(i - 64));
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
+        *dst = ((float)(i - (128 * 64))) / 64.0f;
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        // TODO: reject NaNs?
+        *dst = iconvg_private_reinterpret_from_u32_to_f32(
+            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// iconvg_private_decoder__decode_coordinate_numbers_in_bulk is the fast path
+// of iconvg_private_decoder__decode_coordinate_numbers, for when self holds at
+// least 4 * n bytes. Each number is 1, 2 or 4 bytes long, so the bounds are
+// checked once, up front, instead of once per number. Each number is then
+// read with one 4 byte load. It always decodes all n numbers.
+//
+// It is kept out of line so that the opcode loop's code for short ops, the
+// common case, stays as compact as when it decoded one number at a time.
+static ICONVG_PRIVATE_NOINLINE void  //
+iconvg_private_decoder__decode_coordinate_numbers_in_bulk(
+    iconvg_private_decoder* self,
+    float* dst,
+    size_t n) {
+  const uint8_t* p = self->ptr;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t u = iconvg_private_peek_u32le(p);
+    if ((u & 0x01) == 0) {  // 1-byte encoding.
+      dst[i] = ((float)(((int32_t)(0xFF & u) >> 1) - 64));
+      p += 1;
+    } else if ((u & 0x02) == 0) {  // 2-byte encoding.
+      dst[i] = ((float)(((int32_t)(0xFFFF & u) >> 2) - (128 * 64))) / 64.0f;
+      p += 2;
+    } else {  // 4-byte encoding.
+      dst[i] = iconvg_private_reinterpret_from_u32_to_f32(0xFFFFFFFCu & u);
+      p += 4;
+    }
+  }
+  self->len -= (size_t)(p - self->ptr);
+  self->ptr = p;
+}
+
+// ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN is the smallest n for which
+// iconvg_private_decoder__decode_coordinate_numbers takes the bulk path.
+// Shorter runs, such as a single line_to's 2 numbers, are cheaper to decode
+// inline, one at a time, than to call out of line for.
+#define ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN 8
+
+// iconvg_private_decoder__decode_coordinate_numbers decodes up to n
+// coordinate numbers into dst[.. n], stopping at the first one that is
+// truncated. It returns how many were decoded.
+//
+// Long runs, when self holds at least 4 * n bytes, take the out of line bulk
+// path. Short runs, and those near the end of the data, are decoded one
+// number at a time. Either way, the results are the same.
+static inline size_t  //
+iconvg_private_decoder__decode_coordinate_numbers(iconvg_private_decoder* self,
+                                                  float* dst,
+                                                  size_t n) {
+  if ((n >= ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN) &&
+      ((self->len / 4) >= n)) {
+    iconvg_private_decoder__decode_coordinate_numbers_in_bulk(self, dst, n);
+    return n;
+  }
+  size_t i = 0;
+  for (; i < n; i++) {
+    if (!iconvg_private_decoder__decode_coordinate_number(self, &dst[i])) {
+      break;
+    }
+  }
+  return i;
+}
+
+// iconvg_private_decoder__bulk_decode_coordinate_numbers decodes all n
+// coordinate numbers into dst[.. n] and returns dst, if n is at least
+// ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN and self holds at least 4 * n
+// bytes. Otherwise, it decodes nothing and returns NULL, and the caller should
+// decode one number at a time, as it would without a bulk path.
+static inline const float*  //
+iconvg_private_decoder__bulk_decode_coordinate_numbers(
+    iconvg_private_decoder* self,
+    float* dst,
+    size_t n) {
+  if ((n >= ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN) &&
+      ((self->len / 4) >= n)) {
+    iconvg_private_decoder__decode_coordinate_numbers_in_bulk(self, dst, n);
+    return dst;
+  }
+  return NULL;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
+                                              uint32_t* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      *dst = v >> 1;
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_real_number(iconvg_private_decoder* self,
+                                           float* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      *dst = (float)(v >> 1);
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        *dst = (float)(iconvg_private_peek_u16le(self->ptr) >> 2);
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        // TODO: reject NaNs?
+        *dst = iconvg_private_reinterpret_from_u32_to_f32(
+            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_zero_to_one_number(iconvg_private_decoder* self,
+                                                  float* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      *dst = (float)(((double)(v >> 1)) / 120.0);
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        *dst = (float)(((double)(iconvg_private_peek_u16le(self->ptr) >> 2)) /
+                       15120.0);
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        // TODO: reject NaNs?
+        *dst = iconvg_private_reinterpret_from_u32_to_f32(
+            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// iconvg_private_decoder__decode_metadata decodes the magic identifier and
+// metadata chunks, leaving self positioned at the start of the bytecode.
+//
+// If dst_suggested_palette is NULL then only the ViewBox is decoded (and
+// validated). Other chunks, including ones with unknown metadata IDs, are
+// skipped over, as iconvg_decode_viewbox has always done.
+const char*  //
+iconvg_private_decoder__decode_metadata(iconvg_private_decoder* self,
+                                        iconvg_rectangle_f32* dst_viewbox,
+                                        iconvg_palette* dst_suggested_palette);
+
+// iconvg_private_decoder__drawing_bounds sets dst[.. 4] to the bounding box
+// (min_x, min_y, max_x, max_y), in src coordinates, of a drawing's points:
+// its initial point (x0, y0) and every point, on or off the path, of the
+// drawing mode ops that follow at self's position, up to and including the
+// next 'z' (close_path) op. Arcs contribute the control points of their cubic
+// Bézier approximation.
+//
+// It does not advance self. It returns false if those ops are invalid or
+// incomplete, in which case the caller should decode the drawing as usual,
+// which will report any error.
+bool  //
+iconvg_private_decoder__drawing_bounds(const iconvg_private_decoder* self,
+                                       float* dst,
+                                       float x0,
+                                       float y0);
+
+// ICONVG_PRIVATE_BYTECODE_MODE__ETC are iconvg_private_execute_bytecode's
+// modes. SKIPPING means skipping a drawing that is outside the Level of Detail
+// bounds or the clip rectangle.
+#define ICONVG_PRIVATE_BYTECODE_MODE__STYLING 0
+#define ICONVG_PRIVATE_BYTECODE_MODE__DRAWING 1
+#define ICONVG_PRIVATE_BYTECODE_MODE__SKIPPING 2
+
+// iconvg_private_bytecode_registers holds the iconvg_private_execute_bytecode
+// state, other than the CREG and NREG registers (held in an iconvg_paint),
+// that carries over from one op to the next. It lets decoding suspend and
+// resume at op boundaries.
+typedef struct iconvg_private_bytecode_registers_struct {
+  uint32_t mode;
+  uint32_t sel[2];
+  double lod[2];
+  float curr_x;
+  float curr_y;
+  float x1;
+  float y1;
+} iconvg_private_bytecode_registers;
+
+void  //
+iconvg_private_bytecode_registers__initialize(
+    iconvg_private_bytecode_registers* self);
+
+// ----
+
+extern const uint8_t iconvg_private_one_byte_colors[512];
+extern const iconvg_palette iconvg_private_default_palette;
+
+static inline void  //
 iconvg_private_set_one_byte_color(uint8_t* dst,
                                   const iconvg_palette* custom_palette,
                                   const iconvg_palette* creg,
@@ -853,6 +2811,10 @@ struct iconvg_paint_struct {
   iconvg_palette custom_palette;
   iconvg_palette creg;
   float nreg[64];
+  // creg_palette_deps' i'th bit is whether CREG[i] derives from the custom
+  // palette. Paints that don't can be culled, when transparent, without
+  // changing what re-coloring coverage masks (with another palette) gives.
+  uint64_t creg_palette_deps;
 
   // Scale and bias convert between dst coordinates (what this library calls
   // user or canvas coordinate space) and src coordinates (what this library
@@ -878,12 +2840,248 @@ struct iconvg_paint_struct {
   double d2s_bias_x;
   double d2s_scale_y;
   double d2s_bias_y;
+
+  // When the iconvg_decode_options has a transform, has_transform is true
+  // and d2s_matrix is its inverse followed by the d2s scale and bias above,
+  // converting from canvas coordinates to src coordinates.
+  bool has_transform;
+  iconvg_matrix_2x3_f64 d2s_matrix;
+
+  // src_clip is the rectangle (min_x, min_y, max_x, max_y), in src
+  // coordinates, outside of which drawings are culled, so that their bounds
+  // can be tested without converting them to dst coordinates. It is the
+  // iconvg_decode_options' clip_rect (if any) intersected with dst_rect (if
+  // there is no transform), or infinite if neither applies. has_clip is
+  // whether there is a clip_rect, which is when decoding IconVG-formatted
+  // data (instead of a compiled form) computes drawings' bounds.
+  bool has_clip;
+  double src_clip[4];
+
+  // cancel and cancel_context are the iconvg_decode_options' fields of the
+  // same name, or NULL.
+  bool (*cancel)(void* cancel_context);
+  void* cancel_context;
 };
 
-// ----
+// iconvg_private_decode_options__transform returns options' transform, or
+// NULL if options is NULL, predates that field or has it NULL.
+static inline const iconvg_matrix_2x3_f64*  //
+iconvg_private_decode_options__transform(const iconvg_decode_options* options) {
+  if (!options || (options->sizeof__iconvg_decode_options <
+                   (offsetof(iconvg_decode_options, transform) +
+                    sizeof(options->transform)))) {
+    return NULL;
+  }
+  return options->transform;
+}
 
+// iconvg_private_decode_options__clip_rect returns options' clip_rect, or
+// NULL if options is NULL, predates that field or has it NULL.
+static inline const iconvg_rectangle_f32*  //
+iconvg_private_decode_options__clip_rect(const iconvg_decode_options* options) {
+  if (!options || (options->sizeof__iconvg_decode_options <
+                   (offsetof(iconvg_decode_options, clip_rect) +
+                    sizeof(options->clip_rect)))) {
+    return NULL;
+  }
+  return options->clip_rect;
+}
+
+// iconvg_private_paint__is_cancelled returns whether the iconvg_decode_options'
+// cancel callback (if any) asks to stop decoding before the next drawing.
+static inline bool  //
+iconvg_private_paint__is_cancelled(const iconvg_paint* self) {
+  return self->cancel && (*self->cancel)(self->cancel_context);
+}
+
+// iconvg_private_paint__culls returns whether a drawing whose src coordinate
+// bounds (min_x, min_y, max_x, max_y) are b lies entirely outside of self's
+// src_clip rectangle, and so need not be emitted.
+static inline bool  //
+iconvg_private_paint__culls(const iconvg_paint* self, const float* b) {
+  return (((double)b[2]) < self->src_clip[0]) ||
+         (((double)b[3]) < self->src_clip[1]) ||
+         (((double)b[0]) > self->src_clip[2]) ||
+         (((double)b[1]) > self->src_clip[3]);
+}
+
+// iconvg_private_paint__is_transparent returns whether self's (valid)
+// paint_rgba, with CREG as its gradient stops, is a flat color with zero alpha
+// or a gradient whose stops all have zero alpha. Drawing with it changes no
+// pixels.
+bool  //
+iconvg_private_paint__is_transparent(const iconvg_paint* self);
+
+// iconvg_private_canvas__make_transform returns a canvas that applies m to
+// every point, and to the dst_rect passed to begin_decode, before forwarding
+// each call to wrapped. iconvg_decode and similar functions wrap their canvas
+// in one when the options have a transform.
+iconvg_canvas  //
+iconvg_private_canvas__make_transform(iconvg_canvas* wrapped,
+                                      const iconvg_matrix_2x3_f64* m);
+
+// iconvg_private_matrix_2x3_f64__transform_bounds returns the bounding box of
+// r's m-transformed corners: the dst_rect that a transform canvas passes on to
+// the canvas that it wraps.
+iconvg_rectangle_f32  //
+iconvg_private_matrix_2x3_f64__transform_bounds(const iconvg_matrix_2x3_f64* m,
+                                                iconvg_rectangle_f32 r);
+
+// iconvg_private_cairo_canvas__push_transform, if c is a Cairo canvas (not
+// wrapped by another one), saves its cairo_t's state and then pre-multiplies
+// the cairo_t's current transformation matrix by m, returning true. Decoding
+// to c without an iconvg_decode_options transform is then equivalent to
+// decoding with one, but Cairo transforms the points instead of IconVG. The
+// caller should then call iconvg_private_cairo_canvas__pop_transform.
+//
+// It returns false, doing nothing, for any other canvas, for a non-invertible
+// m or if the Cairo backend is not enabled.
+bool  //
+iconvg_private_cairo_canvas__push_transform(iconvg_canvas* c,
+                                            const iconvg_matrix_2x3_f64* m);
+
+// iconvg_private_cairo_canvas__pop_transform undoes a successful
+// iconvg_private_cairo_canvas__push_transform.
+void  //
+iconvg_private_cairo_canvas__pop_transform(iconvg_canvas* c);
+
+// iconvg_private_paint__initialize sets self's fields, other than the viewbox
+// and custom_palette (which the caller should already have set to the
+// suggested palette), to their initial values for decoding to dst_rect.
+void  //
+iconvg_private_paint__initialize(iconvg_paint* self,
+                                 iconvg_rectangle_f32 dst_rect,
+                                 const iconvg_decode_options* options);
+
+// ----
+
+// iconvg_private_decode_compiled_header validates the header of a compiled
+// form (as produced by iconvg_compile) and sets *dst_suggested_palette and
+// *dst_palette_mask from it. Either pointer may be NULL.
+const char*  //
+iconvg_private_decode_compiled_header(iconvg_palette* dst_suggested_palette,
+                                      uint64_t* dst_palette_mask,
+                                      const uint8_t* compiled_ptr,
+                                      size_t compiled_len);
+
+// ----
+
+// iconvg_private_coverage_compositor is the state for
+// iconvg_coverage_masks__composite: the masks, the read offset of the next
+// drawing's record and the destination pixel buffer.
+typedef struct iconvg_private_coverage_compositor_struct {
+  const iconvg_coverage_masks* masks;
+  size_t offset;
+  uint8_t* pixels_ptr;
+  size_t pixels_stride;
+  int32_t kernels;
+  uint8_t gradient_lut[256 * 4];
+} iconvg_private_coverage_compositor;
+
+// iconvg_private_coverage_compositor__initialize sets up self to read masks
+// (which it validates) from the start.
+const char*  //
+iconvg_private_coverage_compositor__initialize(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_coverage_masks* masks,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect);
+
+// iconvg_private_coverage_compositor__composite composites the next drawing's
+// mask, with the paint p, onto the pixel buffer. If p is NULL then the mask is
+// skipped over instead, for a drawing that replay culled.
+const char*  //
+iconvg_private_coverage_compositor__composite(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_paint* p);
+
+// iconvg_private_coverage_compositor__finish checks that every mask was used.
+const char*  //
+iconvg_private_coverage_compositor__finish(
+    const iconvg_private_coverage_compositor* self);
+
+// ----
+
+// iconvg_private_gradient_key holds everything that determines a backend
+// gradient object, in pattern space. It excludes the gradient transformation
+// matrix, which depends on the dst_rect (and transform), so that one object
+// serves every size and position. Backends apply the matrix per drawing.
+//
+// Keys are zero-initialized (including any padding and unused stops) by
+// iconvg_private_gradient_key__initialize so that they can be compared with
+// memcmp.
+typedef struct iconvg_private_gradient_key_struct {
+  uint32_t paint_type;
+  uint32_t spread;
+  uint32_t num_stops;
+  float offsets[64];
+  iconvg_premul_color colors[64];
+} iconvg_private_gradient_key;
+
+// iconvg_private_gradient_key__initialize sets self from a gradient paint p.
+void  //
+iconvg_private_gradient_key__initialize(iconvg_private_gradient_key* self,
+                                        const iconvg_paint* p);
+
+// iconvg_private_gradient_cache_release_func releases a backend object, e.g.
+// by calling cairo_pattern_destroy or sk_shader_unref. Each backend has its
+// own function, which also distinguishes the backends' cache entries.
+typedef void (*iconvg_private_gradient_cache_release_func)(void* obj);
+
+// iconvg_private_gradient_cache__lookup returns the backend object (borrowed,
+// not an additional reference) for key and release_func, or NULL if absent.
+void*  //
+iconvg_private_gradient_cache__lookup(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func);
+
+// iconvg_private_gradient_cache__insert adds obj, taking over one of the
+// caller's references to it, and returns true. It returns false, leaving the
+// reference with the caller, if obj would not fit even in an empty cache.
+bool  //
+iconvg_private_gradient_cache__insert(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func,
+    void* obj,
+    size_t backend_bytes);
+
+// ----
+
+// ICONVG_PRIVATE_ARC_MAX_CUBICS is the maximum number of cubic Bézier
+// segments that an elliptical arc is approximated by: one per quarter turn.
+#define ICONVG_PRIVATE_ARC_MAX_CUBICS 4
+
+// iconvg_private_arc_to_cubics approximates an elliptical arc by cubic Bézier
+// segments, in the same coordinate space as its arguments. It writes 6
+// elements (x1, y1, x2, y2, x3, y3) per segment to dst, which must have room
+// for (6 * ICONVG_PRIVATE_ARC_MAX_CUBICS) elements, and returns the number of
+// segments. That number can be zero, e.g. when the arc's two end points
+// coincide, in which case nothing should be drawn. If the arc has a zero
+// radius, it also returns zero but sets *dst_is_line, meaning that the arc
+// should be drawn as a straight line to the final point.
+size_t  //
+iconvg_private_arc_to_cubics(double* dst,
+                             bool* dst_is_line,
+                             float initial_x,
+                             float initial_y,
+                             float radius_x,
+                             float radius_y,
+                             float x_axis_rotation,
+                             bool large_arc,
+                             bool sweep,
+                             float final_x,
+                             float final_y);
+
+// iconvg_private_path_arc_to converts an elliptical arc (in ViewBox space) to
+// cubic Bézier segments and adds them, in dst space, to the batch.
 const char*  //
-iconvg_private_path_arc_to(iconvg_canvas* c,
+iconvg_private_path_arc_to(iconvg_private_path_batch* batch,
+                           iconvg_canvas* c,
                            double scale_x,
                            double bias_x,
                            double scale_y,
@@ -923,66 +3121,18 @@ iconvg_private_angle(double ux, double uy, double vx, double vy) {
   return +ret;
 }
 
-static inline const char*  //
-iconvg_private_path_arc_segment_to(iconvg_canvas* c,
-                                   double scale_x,
-                                   double bias_x,
-                                   double scale_y,
-                                   double bias_y,
-                                   double cx,
-                                   double cy,
-                                   double theta1,
-                                   double theta2,
-                                   double rx,
-                                   double ry,
-                                   double cos_phi,
-                                   double sin_phi) {
-  double half_delta_theta = (theta2 - theta1) * 0.5;
-  double q = sin(half_delta_theta * 0.5);
-  double t = (8 * q * q) / (3 * sin(half_delta_theta));
-  double cos1 = cos(theta1);
-  double sin1 = sin(theta1);
-  double cos2 = cos(theta2);
-  double sin2 = sin(theta2);
-
-  double ix1 = rx * (+cos1 - (t * sin1));
-  double iy1 = ry * (+sin1 + (t * cos1));
-  double ix2 = rx * (+cos2 + (t * sin2));
-  double iy2 = ry * (+sin2 - (t * cos2));
-  double ix3 = rx * (+cos2);
-  double iy3 = ry * (+sin2);
-
-  double jx1 = cx + (cos_phi * ix1) - (sin_phi * iy1);
-  double jy1 = cy + (sin_phi * ix1) + (cos_phi * iy1);
-  double jx2 = cx + (cos_phi * ix2) - (sin_phi * iy2);
-  double jy2 = cy + (sin_phi * ix2) + (cos_phi * iy2);
-  double jx3 = cx + (cos_phi * ix3) - (sin_phi * iy3);
-  double jy3 = cy + (sin_phi * ix3) + (cos_phi * iy3);
-
-  return (*c->vtable->path_cube_to)(c,                         //
-                                    (jx1 * scale_x) + bias_x,  //
-                                    (jy1 * scale_y) + bias_y,  //
-                                    (jx2 * scale_x) + bias_x,  //
-                                    (jy2 * scale_y) + bias_y,  //
-                                    (jx3 * scale_x) + bias_x,  //
-                                    (jy3 * scale_y) + bias_y);
-}
-
-const char*  //
-iconvg_private_path_arc_to(iconvg_canvas* c,
-                           double scale_x,
-                           double bias_x,
-                           double scale_y,
-                           double bias_y,
-                           float initial_x,
-                           float initial_y,
-                           float radius_x,
-                           float radius_y,
-                           float x_axis_rotation,
-                           bool large_arc,
-                           bool sweep,
-                           float final_x,
-                           float final_y) {
+size_t  //
+iconvg_private_arc_to_cubics(double* dst,
+                             bool* dst_is_line,
+                             float initial_x,
+                             float initial_y,
+                             float radius_x,
+                             float radius_y,
+                             float x_axis_rotation,
+                             bool large_arc,
+                             bool sweep,
+                             float final_x,
+                             float final_y) {
   const double pi = 3.1415926535897932384626433832795028841972;   // π = τ/2
   const double tau = 6.2831853071795864769252867665590057683943;  // τ = 2*π
 
@@ -1005,10 +3155,9 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
   // non-zero (and non-NaN).
   double rx = fabs((double)radius_x);
   double ry = fabs((double)radius_y);
-  if (!(rx > 0) || !(ry > 0)) {
-    return (*c->vtable->path_line_to)(c,                             //
-                                      (final_x * scale_x) + bias_x,  //
-                                      (final_y * scale_y) + bias_y);
+  *dst_is_line = !(rx > 0) || !(ry > 0);
+  if (*dst_is_line) {
+    return 0;
   }
 
   double x1 = (double)initial_x;
@@ -1060,13 +3209,13 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
   double cx = +(cos_phi * cx_prime) - (sin_phi * cy_prime) + ((x1 + x2) / 2);
   double cy = +(sin_phi * cx_prime) + (cos_phi * cy_prime) + ((y1 + y2) / 2);
 
-  // Step 4: Compute θ1 and Δθ
+  // Step 4: Compute θ1 and Δθ. Only Δθ is needed as an angle. θ1 is the
+  // direction of (ax, ay), used as a unit vector below.
 
   double ax = (+x1_prime - cx_prime) / rx;
   double ay = (+y1_prime - cy_prime) / ry;
   double bx = (-x1_prime - cx_prime) / rx;
   double by = (-y1_prime - cy_prime) / ry;
-  double theta1 = iconvg_private_angle(1.0, 0.0, ax, ay);
   double delta_theta = iconvg_private_angle(ax, ay, bx, by);
   if (sweep) {
     if (delta_theta < 0.0) {
@@ -1082,2683 +3231,9275 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
   // https://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
   // algorithm. What follows below is specific to this implementation.
 
-  // We approximate an arc by one or more cubic Bézier curves.
-  int n = (int)(ceil(fabs(delta_theta) / ((pi / 2) + 0.001)));
-  double inv_n = 1.0 / ((double)n);
-  for (int i = 0; i < n; i++) {
-    ICONVG_PRIVATE_TRY(iconvg_private_path_arc_segment_to(
-        c, scale_x, bias_x, scale_y, bias_y, cx, cy,         //
-        theta1 + (delta_theta * ((double)(i + 0)) * inv_n),  //
-        theta1 + (delta_theta * ((double)(i + 1)) * inv_n),  //
-        rx, ry, cos_phi, sin_phi));
+  // We approximate an arc by one or more cubic Bézier curves, each spanning
+  // an equal step (at most a quarter turn) of the angle θ. Rather than
+  // calling cos and sin for every segment's end points, (cos θ, sin θ) starts
+  // at the unit vector (ax, ay) and is rotated by a fixed step each segment.
+  // With at most 4 steps, the accumulated error is a few ulps of a float64,
+  // many orders of magnitude below the float32 precision of the canvas
+  // method arguments.
+  double num_segments = ceil(fabs(delta_theta) / ((pi / 2) + 0.001));
+  if (!(num_segments >= 1) ||
+      !(num_segments <= ICONVG_PRIVATE_ARC_MAX_CUBICS)) {
+    // This includes coincident end points, where delta_theta is NaN. Per the
+    // SVG spec, such an arc is omitted entirely.
+    return 0;
+  }
+  size_t n = (size_t)num_segments;
+  double step = delta_theta / num_segments;
+  double half_step = step * 0.5;
+  double q = sin(half_step * 0.5);
+  double t = (8 * q * q) / (3 * sin(half_step));
+  double cos_step = cos(step);
+  double sin_step = sin(step);
+  double a_norm = sqrt((ax * ax) + (ay * ay));
+  double cos1 = ax / a_norm;
+  double sin1 = ay / a_norm;
+
+  for (size_t i = 0; i < n; i++) {
+    double cos2 = (cos1 * cos_step) - (sin1 * sin_step);
+    double sin2 = (sin1 * cos_step) + (cos1 * sin_step);
+
+    double ix1 = rx * (+cos1 - (t * sin1));
+    double iy1 = ry * (+sin1 + (t * cos1));
+    double ix2 = rx * (+cos2 + (t * sin2));
+    double iy2 = ry * (+sin2 - (t * cos2));
+    double ix3 = rx * (+cos2);
+    double iy3 = ry * (+sin2);
+
+    dst[0] = cx + (cos_phi * ix1) - (sin_phi * iy1);
+    dst[1] = cy + (sin_phi * ix1) + (cos_phi * iy1);
+    dst[2] = cx + (cos_phi * ix2) - (sin_phi * iy2);
+    dst[3] = cy + (sin_phi * ix2) + (cos_phi * iy2);
+    dst[4] = cx + (cos_phi * ix3) - (sin_phi * iy3);
+    dst[5] = cy + (sin_phi * ix3) + (cos_phi * iy3);
+    dst += 6;
+
+    cos1 = cos2;
+    sin1 = sin2;
+  }
+  return n;
+}
+
+const char*  //
+iconvg_private_path_arc_to(iconvg_private_path_batch* batch,
+                           iconvg_canvas* c,
+                           double scale_x,
+                           double bias_x,
+                           double scale_y,
+                           double bias_y,
+                           float initial_x,
+                           float initial_y,
+                           float radius_x,
+                           float radius_y,
+                           float x_axis_rotation,
+                           bool large_arc,
+                           bool sweep,
+                           float final_x,
+                           float final_y) {
+  double cubics[6 * ICONVG_PRIVATE_ARC_MAX_CUBICS];
+  bool is_line = false;
+  size_t n = iconvg_private_arc_to_cubics(
+      &cubics[0], &is_line, initial_x, initial_y, radius_x, radius_y,
+      x_axis_rotation, large_arc, sweep, final_x, final_y);
+  if (is_line) {
+    return iconvg_private_path_batch__line_to(
+        batch, c, false,               //
+        (final_x * scale_x) + bias_x,  //
+        (final_y * scale_y) + bias_y);
+  }
+  for (const double* p = &cubics[0]; n > 0; n--, p += 6) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+        batch, c, false,            //
+        (p[0] * scale_x) + bias_x,  //
+        (p[1] * scale_y) + bias_y,  //
+        (p[2] * scale_x) + bias_x,  //
+        (p[3] * scale_y) + bias_y,  //
+        (p[4] * scale_x) + bias_x,  //
+        (p[5] * scale_y) + bias_y));
   }
   return NULL;
 }
 
-// -------------------------------- #include "./broken.c"
+// -------------------------------- #include "./arena.c"
 
-static const char*  //
-iconvg_private_broken_canvas__begin_decode(iconvg_canvas* c,
-                                           iconvg_rectangle_f32 dst_rect) {
-  return ((const char*)(c->context.const_ptr3));
+const char*  //
+iconvg_arena__initialize(iconvg_arena* self, void* ptr, size_t len) {
+  if (!self || !ptr || (((uintptr_t)ptr) & 7)) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  self->private_impl.ptr = (uint8_t*)ptr;
+  self->private_impl.len = len;
+  self->private_impl.used = 0;
+  self->private_impl.high_water_mark = 0;
+  return NULL;
 }
 
-static const char*  //
-iconvg_private_broken_canvas__end_decode(iconvg_canvas* c,
-                                         const char* err_msg,
-                                         size_t num_bytes_consumed,
-                                         size_t num_bytes_remaining) {
-  return err_msg ? err_msg : ((const char*)(c->context.const_ptr3));
+void*  //
+iconvg_arena__alloc(iconvg_arena* self, size_t len) {
+  if (!self) {
+    return NULL;
+  }
+  // used is always a multiple of 8, so rounding len up keeps every
+  // allocation 8-byte aligned.
+  size_t n = (len <= (SIZE_MAX - 7)) ? ((len + 7) & ~((size_t)7)) : SIZE_MAX;
+  size_t used = self->private_impl.used;
+  size_t wanted = (n <= (SIZE_MAX - used)) ? (used + n) : SIZE_MAX;
+  if (self->private_impl.high_water_mark < wanted) {
+    self->private_impl.high_water_mark = wanted;
+  }
+  if (wanted > self->private_impl.len) {
+    return NULL;
+  }
+  self->private_impl.used = wanted;
+  return self->private_impl.ptr + used;
 }
 
-static const char*  //
-iconvg_private_broken_canvas__begin_drawing(iconvg_canvas* c) {
-  return ((const char*)(c->context.const_ptr3));
+void  //
+iconvg_arena__reset(iconvg_arena* self) {
+  if (self) {
+    self->private_impl.used = 0;
+  }
 }
 
-static const char*  //
-iconvg_private_broken_canvas__end_drawing(iconvg_canvas* c,
-                                          const iconvg_paint* p) {
-  return ((const char*)(c->context.const_ptr3));
+size_t  //
+iconvg_arena__high_water_mark(const iconvg_arena* self) {
+  return self ? self->private_impl.high_water_mark : 0;
 }
 
-static const char*  //
-iconvg_private_broken_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  return ((const char*)(c->context.const_ptr3));
-}
+// -------------------------------- #include "./atlas.c"
 
-static const char*  //
-iconvg_private_broken_canvas__end_path(iconvg_canvas* c) {
-  return ((const char*)(c->context.const_ptr3));
+// iconvg_atlas_pack is a skyline packer. The skyline is the top edge of the
+// packed boxes so far: a sequence of nodes, left to right, each a horizontal
+// segment from its x up to the next node's x (or the atlas' width) at height
+// y. Each box is placed, bottom-left style, where its top edge would be
+// lowest, breaking ties by the leftmost x. Boxes are placed tallest first,
+// which keeps the skyline flat.
+//
+// Placing a box replaces the nodes under it by one node (and shortens the
+// node that it partially covers, if any), so there are at most (1 + N) nodes
+// for N boxes. The scratch buffer holds the placement order (N words) and the
+// nodes' x and y (two words per node).
+
+// iconvg_private_atlas__less returns whether the a'th entry should be placed
+// before the b'th entry: taller first, then wider first, then in input order,
+// so that the packing does not depend on the sorting algorithm.
+static inline bool  //
+iconvg_private_atlas__less(const iconvg_atlas_entry* entries,
+                           uint32_t a,
+                           uint32_t b) {
+  if (entries[a].height != entries[b].height) {
+    return entries[a].height > entries[b].height;
+  } else if (entries[a].width != entries[b].width) {
+    return entries[a].width > entries[b].width;
+  }
+  return a < b;
 }
 
-static const char*  //
-iconvg_private_broken_canvas__path_line_to(iconvg_canvas* c,
-                                           float x1,
-                                           float y1) {
-  return ((const char*)(c->context.const_ptr3));
+static void  //
+iconvg_private_atlas__sift_down(const iconvg_atlas_entry* entries,
+                                uint32_t* order,
+                                size_t i,
+                                size_t n) {
+  while (true) {
+    size_t child = (2 * i) + 1;
+    if (child >= n) {
+      return;
+    } else if (((child + 1) < n) &&
+               iconvg_private_atlas__less(entries, order[child],
+                                          order[child + 1])) {
+      child++;
+    }
+    if (!iconvg_private_atlas__less(entries, order[i], order[child])) {
+      return;
+    }
+    uint32_t t = order[i];
+    order[i] = order[child];
+    order[child] = t;
+    i = child;
+  }
 }
 
-static const char*  //
-iconvg_private_broken_canvas__path_quad_to(iconvg_canvas* c,
-                                           float x1,
-                                           float y1,
-                                           float x2,
-                                           float y2) {
-  return ((const char*)(c->context.const_ptr3));
+// iconvg_private_atlas__sort heap-sorts order[.. n] so that, on return,
+// iconvg_private_atlas__less is ascending. It needs no memory other than
+// order itself.
+static void  //
+iconvg_private_atlas__sort(const iconvg_atlas_entry* entries,
+                           uint32_t* order,
+                           size_t n) {
+  for (size_t i = n / 2; i > 0; i--) {
+    iconvg_private_atlas__sift_down(entries, order, i - 1, n);
+  }
+  for (size_t i = n; i > 1; i--) {
+    uint32_t t = order[0];
+    order[0] = order[i - 1];
+    order[i - 1] = t;
+    iconvg_private_atlas__sift_down(entries, order, 0, i - 1);
+  }
 }
 
-static const char*  //
-iconvg_private_broken_canvas__path_cube_to(iconvg_canvas* c,
-                                           float x1,
-                                           float y1,
-                                           float x2,
-                                           float y2,
-                                           float x3,
-                                           float y3) {
-  return ((const char*)(c->context.const_ptr3));
+// ----
+
+iconvg_atlas_entry  //
+iconvg_atlas_entry__make(const iconvg_rectangle_f32* viewbox,
+                         uint32_t max_side) {
+  iconvg_atlas_entry e = {0};
+  double w = viewbox ? iconvg_rectangle_f32__width_f64(viewbox) : 0.0;
+  double h = viewbox ? iconvg_rectangle_f32__height_f64(viewbox) : 0.0;
+  if ((w <= 0) || (h <= 0) || (max_side == 0)) {
+    return e;
+  } else if (w >= h) {
+    e.width = max_side;
+    e.height = (uint32_t)(((max_side * h) / w) + 0.5);
+  } else {
+    e.width = (uint32_t)(((max_side * w) / h) + 0.5);
+    e.height = max_side;
+  }
+  // Keep a sliver of a graphic as at least one pixel, so that it is visible.
+  e.width = (e.width > 0) ? e.width : 1;
+  e.height = (e.height > 0) ? e.height : 1;
+  return e;
 }
 
-static const char*  //
-iconvg_private_broken_canvas__on_metadata_viewbox(
-    iconvg_canvas* c,
-    iconvg_rectangle_f32 viewbox) {
-  return ((const char*)(c->context.const_ptr3));
+iconvg_rectangle_f32  //
+iconvg_atlas_entry__dst_rect(const iconvg_atlas_entry* self) {
+  if (!self) {
+    return iconvg_rectangle_f32__make(0, 0, 0, 0);
+  }
+  return iconvg_rectangle_f32__make(
+      (float)self->x, (float)self->y,
+      (float)((uint64_t)self->x + (uint64_t)self->width),
+      (float)((uint64_t)self->y + (uint64_t)self->height));
 }
 
-static const char*  //
-iconvg_private_broken_canvas__on_metadata_suggested_palette(
-    iconvg_canvas* c,
-    const iconvg_palette* suggested_palette) {
-  return ((const char*)(c->context.const_ptr3));
+size_t  //
+iconvg_atlas_scratch_len(size_t num_entries) {
+  if (num_entries > ICONVG_ATLAS_MAX_NUM_ENTRIES) {
+    return 0;
+  }
+  return (3 * num_entries) + 2;
 }
 
-static const iconvg_canvas_vtable  //
-    iconvg_private_broken_canvas_vtable = {
-        sizeof(iconvg_canvas_vtable),
-        &iconvg_private_broken_canvas__begin_decode,
-        &iconvg_private_broken_canvas__end_decode,
-        &iconvg_private_broken_canvas__begin_drawing,
-        &iconvg_private_broken_canvas__end_drawing,
-        &iconvg_private_broken_canvas__begin_path,
-        &iconvg_private_broken_canvas__end_path,
-        &iconvg_private_broken_canvas__path_line_to,
-        &iconvg_private_broken_canvas__path_quad_to,
-        &iconvg_private_broken_canvas__path_cube_to,
-        &iconvg_private_broken_canvas__on_metadata_viewbox,
-        &iconvg_private_broken_canvas__on_metadata_suggested_palette,
-};
+const char*  //
+iconvg_atlas_pack(iconvg_atlas_entry* entries,
+                  size_t num_entries,
+                  uint32_t max_width,
+                  uint32_t max_height,
+                  uint32_t padding,
+                  uint32_t* scratch_ptr,
+                  size_t scratch_len,
+                  uint32_t* dst_width,
+                  uint32_t* dst_height) {
+  if ((!entries && (num_entries > 0)) ||
+      (num_entries > ICONVG_ATLAS_MAX_NUM_ENTRIES) || !scratch_ptr ||
+      (scratch_len < iconvg_atlas_scratch_len(num_entries))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
 
-iconvg_canvas  //
-iconvg_canvas__make_broken(const char* err_msg) {
-  iconvg_canvas c;
-  c.vtable = &iconvg_private_broken_canvas_vtable;
-  memset(&c.context, 0, sizeof(c.context));
-  c.context.const_ptr3 = err_msg;
-  return c;
-}
+  // Each entry occupies a box that is padding pixels wider and taller than
+  // it. The boxes are packed into an area that is padding pixels wider and
+  // taller than the atlas, so that boxes along the right and bottom edges
+  // have their (unnecessary) padding outside of the atlas.
+  uint64_t limit_x = (uint64_t)max_width + padding;
+  uint64_t limit_y = (uint64_t)max_height + padding;
+  if ((limit_x > UINT32_MAX) || (limit_y > UINT32_MAX)) {
+    return iconvg_error_invalid_constructor_argument;
+  }
 
-bool  //
-iconvg_canvas__does_nothing(const iconvg_canvas* self) {
-  return !self || (self->vtable == NULL) ||
-         (self->vtable == &iconvg_private_broken_canvas_vtable);
+  uint32_t* order = scratch_ptr;
+  size_t num_order = 0;
+  for (size_t i = 0; i < num_entries; i++) {
+    entries[i].x = 0;
+    entries[i].y = 0;
+    if ((entries[i].width > 0) && (entries[i].height > 0)) {
+      order[num_order++] = (uint32_t)i;
+    }
+  }
+  iconvg_private_atlas__sort(entries, order, num_order);
+
+  uint32_t* node_x = scratch_ptr + num_entries;
+  uint32_t* node_y = node_x + num_entries + 1;
+  size_t num_nodes = 1;
+  node_x[0] = 0;
+  node_y[0] = 0;
+  uint64_t used_w = 0;
+  uint64_t used_h = 0;
+
+  for (size_t k = 0; k < num_order; k++) {
+    iconvg_atlas_entry* e = &entries[order[k]];
+    uint64_t box_w = (uint64_t)e->width + padding;
+    uint64_t box_h = (uint64_t)e->height + padding;
+
+    // Find the best node i to start the box at.
+    size_t best_i = num_nodes;
+    uint64_t best_top = UINT64_MAX;
+    for (size_t i = 0; i < num_nodes; i++) {
+      uint64_t x0 = node_x[i];
+      uint64_t x1 = x0 + box_w;
+      if (x1 > limit_x) {
+        break;
+      }
+      uint64_t y = 0;
+      for (size_t j = i; (j < num_nodes) && (node_x[j] < x1); j++) {
+        y = (y > node_y[j]) ? y : node_y[j];
+      }
+      uint64_t top = y + box_h;
+      if ((top <= limit_y) && (top < best_top)) {
+        best_i = i;
+        best_top = top;
+      }
+    }
+    if (best_i == num_nodes) {
+      return iconvg_error_system_failure_atlas_too_small;
+    }
+
+    // Place the box and update the skyline. The nodes from best_i up to (but
+    // excluding) j end at or before x1, so the box fully covers them and they
+    // are replaced by one node. Node j, if it exists, ends after x1 and now
+    // starts at x1.
+    uint32_t x0 = node_x[best_i];
+    uint64_t x1 = x0 + box_w;
+    e->x = x0;
+    e->y = (uint32_t)(best_top - box_h);
+    size_t j = best_i;
+    for (; j < num_nodes; j++) {
+      uint64_t end = ((j + 1) < num_nodes) ? node_x[j + 1] : limit_x;
+      if (end > x1) {
+        break;
+      }
+    }
+    size_t num_removed = j - best_i;
+    if (j < num_nodes) {
+      node_x[j] = (uint32_t)x1;
+    }
+    if (num_removed == 0) {
+      // Insert a new node before best_i.
+      memmove(&node_x[best_i + 1], &node_x[best_i],
+              (num_nodes - best_i) * sizeof(uint32_t));
+      memmove(&node_y[best_i + 1], &node_y[best_i],
+              (num_nodes - best_i) * sizeof(uint32_t));
+      num_nodes++;
+    } else if (num_removed > 1) {
+      memmove(&node_x[best_i + 1], &node_x[j],
+              (num_nodes - j) * sizeof(uint32_t));
+      memmove(&node_y[best_i + 1], &node_y[j],
+              (num_nodes - j) * sizeof(uint32_t));
+      num_nodes -= num_removed - 1;
+    }
+    node_x[best_i] = x0;
+    node_y[best_i] = (uint32_t)best_top;
+
+    used_w = (used_w > (x0 + (uint64_t)e->width))
+                 ? used_w
+                 : (x0 + (uint64_t)e->width);
+    used_h = (used_h > (e->y + (uint64_t)e->height))
+                 ? used_h
+                 : (e->y + (uint64_t)e->height);
+  }
+
+  if (dst_width) {
+    *dst_width = (uint32_t)used_w;
+  }
+  if (dst_height) {
+    *dst_height = (uint32_t)used_h;
+  }
+  return NULL;
 }
 
-// -------------------------------- #include "./cairo.c"
+// -------------------------------- #include "./batch.c"
 
-#if !defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+#include <pthread.h>
+#endif
 
-iconvg_canvas  //
-iconvg_canvas__make_cairo(cairo_t* cr) {
-  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
-}
+// iconvg_private_batch is the state shared by all of an iconvg_decode_batch
+// call's worker threads. Each worker repeatedly claims the next unclaimed job,
+// so that a worker that finishes a cheap icon early moves on to the
+// remaining jobs instead of idling while others work through expensive ones.
+typedef struct iconvg_private_batch_struct {
+  iconvg_decode_job* jobs;
+  size_t num_jobs;
+  size_t next_job;
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  bool locking;
+  pthread_mutex_t mutex;
+#endif
+} iconvg_private_batch;
 
-#else  // ICONVG_CONFIG__ENABLE_CAIRO_BACKEND
+static void  //
+iconvg_private_batch__run(iconvg_private_batch* self) {
+  while (true) {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+    if (self->locking) {
+      pthread_mutex_lock(&self->mutex);
+    }
+#endif
+    size_t i = self->next_job;
+    if (i < self->num_jobs) {
+      self->next_job++;
+    }
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+    if (self->locking) {
+      pthread_mutex_unlock(&self->mutex);
+    }
+#endif
+    if (i >= self->num_jobs) {
+      return;
+    }
 
-#include <cairo/cairo.h>
+    iconvg_decode_job* j = &self->jobs[i];
+    j->err_msg = iconvg_decode(j->dst_canvas, j->dst_rect, j->src_ptr,
+                               j->src_len, j->options);
+  }
+}
 
-static const cairo_extend_t
-    iconvg_private_gradient_spread_as_cairo_extend_t[4] = {
-        CAIRO_EXTEND_NONE,     //
-        CAIRO_EXTEND_PAD,      //
-        CAIRO_EXTEND_REFLECT,  //
-        CAIRO_EXTEND_REPEAT    //
-};
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
 
-static inline cairo_matrix_t  //
-iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(iconvg_matrix_2x3_f64 i) {
-  cairo_matrix_t c;
-  c.xx = i.elems[0][0];
-  c.xy = i.elems[0][1];
-  c.x0 = i.elems[0][2];
-  c.yx = i.elems[1][0];
-  c.yy = i.elems[1][1];
-  c.y0 = i.elems[1][2];
-  return c;
+// ICONVG_PRIVATE_BATCH_MAX_THREADS bounds the number of threads (including
+// the calling thread) per iconvg_decode_batch call.
+#define ICONVG_PRIVATE_BATCH_MAX_THREADS 256
+
+static void*  //
+iconvg_private_batch__thread_main(void* arg) {
+  iconvg_private_batch__run((iconvg_private_batch*)arg);
+  return NULL;
 }
 
-// iconvg_private_cairo_set_gradient_stops sets the Cairo gradient stop colors
-// given the IconVG gradient stop colors.
+#endif  // defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+
+const char*  //
+iconvg_decode_batch(iconvg_decode_job* jobs,
+                    size_t num_jobs,
+                    uint32_t num_threads) {
+  if (!jobs || (num_jobs == 0)) {
+    return NULL;
+  }
+
+  iconvg_private_batch b;
+  b.jobs = jobs;
+  b.num_jobs = num_jobs;
+  b.next_job = 0;
+
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  b.locking = false;
+  if (num_threads > ICONVG_PRIVATE_BATCH_MAX_THREADS) {
+    num_threads = ICONVG_PRIVATE_BATCH_MAX_THREADS;
+  }
+  if (num_threads > num_jobs) {
+    num_threads = (uint32_t)num_jobs;
+  }
+  if ((num_threads > 1) && (pthread_mutex_init(&b.mutex, NULL) == 0)) {
+    b.locking = true;
+    // The calling thread is one of the workers. If creating a thread fails,
+    // we carry on with the threads that we have.
+    pthread_t threads[ICONVG_PRIVATE_BATCH_MAX_THREADS - 1];
+    uint32_t num_spawned = 0;
+    for (; (num_spawned + 1) < num_threads; num_spawned++) {
+      if (pthread_create(&threads[num_spawned], NULL,
+                         &iconvg_private_batch__thread_main, &b) != 0) {
+        break;
+      }
+    }
+    iconvg_private_batch__run(&b);
+    for (uint32_t i = 0; i < num_spawned; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&b.mutex);
+  } else {
+    // pthread_mutex_init can only fail (on some platforms) for lack of
+    // resources. The single-threaded path doesn't need the mutex.
+    iconvg_private_batch__run(&b);
+  }
+#else
+  iconvg_private_batch__run(&b);
+#endif
+
+  for (size_t i = 0; i < num_jobs; i++) {
+    if (jobs[i].err_msg) {
+      return jobs[i].err_msg;
+    }
+  }
+  return NULL;
+}
+
+// -------------------------------- #include "./bitmap_cache.c"
+
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+#include <pthread.h>
+#endif
+
+// ICONVG_PRIVATE_BITMAP_CACHE_NONE is a null entry index, ending a list.
+#define ICONVG_PRIVATE_BITMAP_CACHE_NONE 0xFFFFFFFFu
+
+// ICONVG_PRIVATE_BITMAP_CACHE_MAX_ENTRIES bounds num_entries, so that entry
+// indexes (plus one) and the hash table's size fit in a uint32_t.
+#define ICONVG_PRIVATE_BITMAP_CACHE_MAX_ENTRIES 0x40000000
+
+// iconvg_private_bitmap_cache_entry is one slot of an iconvg_bitmap_cache.
+// Its pixels are at pixels_ptr[offset .. offset + len] in the state's pixel
+// arena.
 //
-// Unlike SVG, IconVG works solely with premultiplied alpha. In contrast,
-// https://lists.freedesktop.org/archives/cairo/2006-June/007203.html says that
-// Cairo accepts "both pre- and non-premultiplied colors in different parts of
-// the API". Specifically, while CAIRO_FORMAT_ARGB32 is premultiplied, both
-// cairo_set_source_rgba and cairo_pattern_add_color_stop_rgba are
-// non-premultiplied.
+// Each live entry is on two doubly linked lists (of entry indexes): the LRU
+// list, from least to most recently used, and the arena list, in pixel arena
+// (offset) order. Free entries are on a singly linked free list, via
+// lru_next.
+typedef struct iconvg_private_bitmap_cache_entry_struct {
+  uint64_t key_hash;
+  size_t offset;
+  size_t len;
+  uint32_t lru_prev;
+  uint32_t lru_next;
+  uint32_t arena_prev;
+  uint32_t arena_next;
+  iconvg_bitmap_cache_key key;
+} iconvg_private_bitmap_cache_entry;
+
+// iconvg_private_bitmap_cache_state is at the start of an iconvg_bitmap_cache
+// workbuf, followed by entries_cap entries, then the hash table's slots and
+// then the pixel arena.
 //
-// For flat colors, we can simply convert IconVG colors to non-premultiplied
-// colors. Gradients are trickier (and hence this function is non-trivial)
-// because IconVG interpolation should also happen in premultiplied alpha space
-// (but Cairo interpolates in non-premultiplied alpha space). The mathematical
-// halfway color between opaque bright red = RGBA(1, 0, 0, 1) and transparent
-// black = RGBA(0, 0, 0, 0) is RGBA(½, 0, 0, ½). IconVG (premultiplied alpha)
-// semantics are that this is a 50% opaque bright red, not a 50% opaque dark
-// red. The halfway point still has 100% Saturation and 100% Value (in the HSV
-// Hue Saturation Value sense). It just has smaller alpha.
+// The hash table uses open addressing with linear probing. Each slot holds an
+// entry index plus one, or zero for an empty slot. It has at least twice as
+// many slots as entries, so that probe sequences stay short, and lookups,
+// inserts and evictions take O(1) expected time.
 //
-// Some more discussion is at
-// https://lists.freedesktop.org/archives/cairo/2021-May/029252.html
-static void  //
-iconvg_private_cairo_set_gradient_stops(cairo_pattern_t* cp,
-                                        const iconvg_paint* p) {
-  // foo0 and foo2 are the previous and current gradient stop. Sometimes we
-  // need to synthesize additional stops in between them, whose variables are
-  // named foo1.
-  double offset0 = 0.0;
-  double r0 = 0.0;
-  double g0 = 0.0;
-  double b0 = 0.0;
-  double a0 = 0.0;
+// The arena is a bump allocator: new pixels go at pixels_used, after every
+// live entry's, so the arena list is also the insertion order. When that runs
+// out but live_bytes (the sum of the live entries' len) leaves enough room,
+// the live entries are compacted towards the start of the arena.
+typedef struct iconvg_private_bitmap_cache_state_struct {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  pthread_mutex_t mutex;
+#endif
+  iconvg_private_bitmap_cache_entry* entries_ptr;
+  size_t entries_cap;
+  uint32_t* slots_ptr;
+  size_t slots_mask;
+  uint8_t* pixels_ptr;
+  size_t pixels_cap;
+  size_t pixels_used;
+  size_t live_bytes;
+  uint32_t lru_head;
+  uint32_t lru_tail;
+  uint32_t arena_head;
+  uint32_t arena_tail;
+  uint32_t free_head;
+} iconvg_private_bitmap_cache_state;
+
+// iconvg_private_hash_fnv1a64 returns the 64-bit FNV-1a hash of
+// ptr[.. len], continuing from h.
+static uint64_t  //
+iconvg_private_hash_fnv1a64(uint64_t h, const uint8_t* ptr, size_t len) {
+  for (; len > 0; ptr++, len--) {
+    h ^= *ptr;
+    h *= 0x00000100000001B3ull;
+  }
+  return h;
+}
 
-  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
-  for (uint32_t i = 0; i < num_stops; i++) {
-    // Calculate offset and color for the current stop.
-    double offset2 = iconvg_paint__gradient_stop_offset(p, i);
-    iconvg_premul_color k =
-        iconvg_paint__gradient_stop_color_as_premul_color(p, i);
-    double r2 = k.rgba[0] / 255.0;
-    double g2 = k.rgba[1] / 255.0;
-    double b2 = k.rgba[2] / 255.0;
-    double a2 = k.rgba[3] / 255.0;
+// iconvg_private_bitmap_cache__num_slots returns the hash table size for
+// num_entries: the smallest power of 2 that is at least 2 * num_entries.
+static size_t  //
+iconvg_private_bitmap_cache__num_slots(size_t num_entries) {
+  size_t n = 1;
+  while (n < (2 * num_entries)) {
+    n <<= 1;
+  }
+  return n;
+}
 
-    if ((i == 0) ||                      //
-        ((a0 == 1.0) && (a2 == 1.0)) ||  //
-        ((a0 == 0.0) && (a2 == 0.0))) {
-      // If it's the first stop, or if we're interpolating from 100% to 100%
-      // opaque or from 0% to 0% opaque, we don't have to worry about
-      // premultiplied versus non-premultiplied alpha.
-      cairo_pattern_add_color_stop_rgba(cp, offset2, r2, g2, b2, a2);
+// iconvg_private_bitmap_cache_key__hash mixes the key's 64-bit words, most of
+// which are already hashes. Keys are zeroed before their fields are set, so
+// they have no uninitialized padding.
+static uint64_t  //
+iconvg_private_bitmap_cache_key__hash(const iconvg_bitmap_cache_key* key) {
+  uint64_t words[sizeof(*key) / 8];
+  memcpy(&words[0], key, sizeof(words));
+  uint64_t h = 0;
+  for (size_t i = 0; i < (sizeof(words) / 8); i++) {
+    h = (h ^ words[i]) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+  }
+  return h;
+}
 
-    } else if (a0 == 0.0) {
-      // If we're blending e.g. from transparent black to (partially) opaque
-      // blue, insert "transparent blue" immediately after the previous
-      // "transparent black".
-      cairo_pattern_add_color_stop_rgba(cp, offset0, r2, g2, b2, 0.0);
-      cairo_pattern_add_color_stop_rgba(cp, offset2, r2, g2, b2, a2);
+static inline void  //
+iconvg_private_bitmap_cache_state__lock(
+    iconvg_private_bitmap_cache_state* self) {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  pthread_mutex_lock(&self->mutex);
+#endif
+}
 
-    } else if (a2 == 0.0) {
-      // If we're blending e.g. from (partially) opaque blue to transparent
-      // black, insert "transparent blue" immediately before the current
-      // "transparent black".
-      cairo_pattern_add_color_stop_rgba(cp, offset2, r0, g0, b0, 0.0);
-      cairo_pattern_add_color_stop_rgba(cp, offset2, r2, g2, b2, a2);
+static inline void  //
+iconvg_private_bitmap_cache_state__unlock(
+    iconvg_private_bitmap_cache_state* self) {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  pthread_mutex_unlock(&self->mutex);
+#endif
+}
 
-    } else {
-      // Otherwise, fake "interpolate with premultiplied alpha" by synthesizing
-      // n Cairo stops for this 1 IconVG stop. The n stops' colors are
-      // calculated explicitly here, in premultiplied alpha space. We then let
-      // Cairo do its thing in non-premultiplied alpha space. The difference
-      // between n stops (interpolating non-premultiplied) and 1 stop
-      // (interpolating premultiplied) will hopefully be imperceivable.
-      const int32_t n = 16;
-      for (int32_t i = (n - 1); i >= 0; i--) {
-        int32_t j = n - i;
-        double offset1 = ((i * offset0) + (j * offset2)) / n;
-        double r1 = ((i * r0) + (j * r2)) / n;
-        double g1 = ((i * g0) + (j * g2)) / n;
-        double b1 = ((i * b0) + (j * b2)) / n;
-        double a1 = ((i * a0) + (j * a2)) / n;
-        if (a1 == 0.0) {
-          cairo_pattern_add_color_stop_rgba(cp, offset1, 0, 0, 0, 0);
-        } else {
-          cairo_pattern_add_color_stop_rgba(cp, offset1,  //
-                                            r1 / a1, g1 / a1, b1 / a1, a1);
-        }
-      }
+static iconvg_private_bitmap_cache_entry*  //
+iconvg_private_bitmap_cache_state__find(
+    iconvg_private_bitmap_cache_state* self,
+    const iconvg_bitmap_cache_key* key,
+    uint64_t key_hash) {
+  for (size_t i = key_hash & self->slots_mask; self->slots_ptr[i] != 0;
+       i = (i + 1) & self->slots_mask) {
+    iconvg_private_bitmap_cache_entry* e =
+        &self->entries_ptr[self->slots_ptr[i] - 1];
+    if ((e->key_hash == key_hash) &&
+        (memcmp(&e->key, key, sizeof(*key)) == 0)) {
+      return e;
     }
+  }
+  return NULL;
+}
 
-    // Update offset and color for the previous stop.
-    offset0 = offset2;
-    r0 = r2;
-    g0 = g2;
-    b0 = b2;
-    a0 = a2;
+// iconvg_private_bitmap_cache_state__unindex removes the idx'th entry from
+// the hash table. Later slots in the same probe sequence are shifted back, so
+// that the table needs no tombstones.
+static void  //
+iconvg_private_bitmap_cache_state__unindex(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  size_t mask = self->slots_mask;
+  size_t i = self->entries_ptr[idx].key_hash & mask;
+  while (self->slots_ptr[i] != (idx + 1)) {
+    i = (i + 1) & mask;
+  }
+  self->slots_ptr[i] = 0;
+  for (size_t j = (i + 1) & mask; self->slots_ptr[j] != 0;
+       j = (j + 1) & mask) {
+    // The entry at j can move to i unless its home slot, k, is cyclically in
+    // (i, j], where a lookup for it would stop before reaching i.
+    size_t k = self->entries_ptr[self->slots_ptr[j] - 1].key_hash & mask;
+    if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+      continue;
+    }
+    self->slots_ptr[i] = self->slots_ptr[j];
+    self->slots_ptr[j] = 0;
+    i = j;
   }
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__begin_decode(iconvg_canvas* c,
-                                          iconvg_rectangle_f32 dst_rect) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_save(cr);
-  cairo_rectangle(cr, dst_rect.min_x, dst_rect.min_y,
-                  iconvg_rectangle_f32__width_f64(&dst_rect),
-                  iconvg_rectangle_f32__height_f64(&dst_rect));
-  cairo_clip(cr);
-  return NULL;
+static void  //
+iconvg_private_bitmap_cache_state__lru_unlink(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  if (e->lru_prev != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->lru_prev].lru_next = e->lru_next;
+  } else {
+    self->lru_head = e->lru_next;
+  }
+  if (e->lru_next != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->lru_next].lru_prev = e->lru_prev;
+  } else {
+    self->lru_tail = e->lru_prev;
+  }
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__end_decode(iconvg_canvas* c,
-                                        const char* err_msg,
-                                        size_t num_bytes_consumed,
-                                        size_t num_bytes_remaining) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_restore(cr);
-  return err_msg;
+// iconvg_private_bitmap_cache_state__lru_push makes the idx'th entry the most
+// recently used.
+static void  //
+iconvg_private_bitmap_cache_state__lru_push(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  e->lru_prev = self->lru_tail;
+  e->lru_next = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  if (self->lru_tail != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[self->lru_tail].lru_next = idx;
+  } else {
+    self->lru_head = idx;
+  }
+  self->lru_tail = idx;
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__begin_drawing(iconvg_canvas* c) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_new_path(cr);
-  return NULL;
+static void  //
+iconvg_private_bitmap_cache_state__arena_unlink(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  if (e->arena_prev != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->arena_prev].arena_next = e->arena_next;
+  } else {
+    self->arena_head = e->arena_next;
+  }
+  if (e->arena_next != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->arena_next].arena_prev = e->arena_prev;
+  } else {
+    self->arena_tail = e->arena_prev;
+  }
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__end_drawing(iconvg_canvas* c,
-                                         const iconvg_paint* p) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_pattern_t* cp = NULL;
-  cairo_matrix_t cm = {0};
+// iconvg_private_bitmap_cache_state__evict_oldest evicts the least recently
+// used entry, moving it to the free list. It returns false if there are no
+// live entries.
+static bool  //
+iconvg_private_bitmap_cache_state__evict_oldest(
+    iconvg_private_bitmap_cache_state* self) {
+  uint32_t idx = self->lru_head;
+  if (idx == ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    return false;
+  }
+  iconvg_private_bitmap_cache_state__unindex(self, idx);
+  iconvg_private_bitmap_cache_state__lru_unlink(self, idx);
+  iconvg_private_bitmap_cache_state__arena_unlink(self, idx);
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  self->live_bytes -= e->len;
+  e->lru_next = self->free_head;
+  self->free_head = idx;
+  return true;
+}
 
-  switch (iconvg_paint__type(p)) {
-    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
-      iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
-      cairo_set_source_rgba(cr, k.rgba[0] / 255.0, k.rgba[1] / 255.0,
-                            k.rgba[2] / 255.0, k.rgba[3] / 255.0);
-      cairo_fill(cr);
-      return NULL;
+// iconvg_private_bitmap_cache_state__compact moves the live entries' pixels,
+// in arena order, to be contiguous from the start of the arena.
+static void  //
+iconvg_private_bitmap_cache_state__compact(
+    iconvg_private_bitmap_cache_state* self) {
+  size_t cursor = 0;
+  for (uint32_t idx = self->arena_head; idx != ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+       idx = self->entries_ptr[idx].arena_next) {
+    iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+    if (e->offset != cursor) {
+      memmove(self->pixels_ptr + cursor, self->pixels_ptr + e->offset, e->len);
+      e->offset = cursor;
     }
+    cursor += e->len;
+  }
+  self->pixels_used = cursor;
+}
 
-    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT: {
-      iconvg_matrix_2x3_f64 gtm =
-          iconvg_paint__gradient_transformation_matrix(p);
-      iconvg_matrix_2x3_f64__override_second_row(&gtm);
-      cp = cairo_pattern_create_linear(0, 0, 1, 0);
-      cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(gtm);
-      break;
-    }
+// ----
 
-    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
-      iconvg_matrix_2x3_f64 gtm =
-          iconvg_paint__gradient_transformation_matrix(p);
-      cp = cairo_pattern_create_radial(0, 0, 0, 0, 0, 1);
-      cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(gtm);
-      break;
-    }
+// The FNV-1a 64-bit offset basis.
+#define ICONVG_PRIVATE_FNV1A64_BASIS 0xCBF29CE484222325ull
+
+// iconvg_private_bitmap_cache_key__make sets everything but the palette
+// fields, which the caller is responsible for.
+static iconvg_bitmap_cache_key  //
+iconvg_private_bitmap_cache_key__make(uint32_t pixels_width,
+                                      uint32_t pixels_height,
+                                      iconvg_rectangle_f32 dst_rect,
+                                      const uint8_t* src_ptr,
+                                      size_t src_len,
+                                      const iconvg_decode_options* options) {
+  iconvg_bitmap_cache_key k;
+  memset(&k, 0, sizeof(k));
+  k.private_impl.src_hash = iconvg_private_hash_fnv1a64(
+      ICONVG_PRIVATE_FNV1A64_BASIS, src_ptr, src_ptr ? src_len : 0);
+  k.private_impl.src_len = src_ptr ? src_len : 0;
+
+  // Key on the effective height_in_pixels, computed the same way as
+  // iconvg_private_paint__initialize does, so that an implicit and an
+  // equivalent explicit height share an entry.
+  if (options && options->height_in_pixels.has_value) {
+    k.private_impl.height_in_pixels = options->height_in_pixels.value;
+  } else {
+    double h = iconvg_rectangle_f32__height_f64(&dst_rect);
+    k.private_impl.height_in_pixels = (h <= 0x100000) ? (int64_t)h : 0x100000;
+  }
 
-    default:
-      return iconvg_error_invalid_paint_type;
+  // transform_hash is zero (and the hash of the matrix otherwise, which is
+  // zero with negligible probability) when there is no transform.
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    k.private_impl.transform_hash = iconvg_private_hash_fnv1a64(
+        ICONVG_PRIVATE_FNV1A64_BASIS,
+        (const uint8_t*)(&transform->elems[0][0]), sizeof(transform->elems));
+  }
+  // Likewise for clip_rect_hash, as a culled rendering differs from a full
+  // one.
+  const iconvg_rectangle_f32* clip_rect =
+      iconvg_private_decode_options__clip_rect(options);
+  if (clip_rect) {
+    k.private_impl.clip_rect_hash = iconvg_private_hash_fnv1a64(
+        ICONVG_PRIVATE_FNV1A64_BASIS, (const uint8_t*)(clip_rect),
+        sizeof(*clip_rect));
   }
 
-  cairo_pattern_set_matrix(cp, &cm);
-  cairo_pattern_set_extend(cp, iconvg_private_gradient_spread_as_cairo_extend_t
-                                   [iconvg_paint__gradient_spread(p)]);
-  iconvg_private_cairo_set_gradient_stops(cp, p);
-  if (cairo_pattern_status(cp) == CAIRO_STATUS_SUCCESS) {
-    cairo_set_source(cr, cp);
-  } else {
-    // Substitute in a 50% transparent grayish purple so that "something is
-    // wrong with the Cairo pattern" is hopefully visible without abandoning
-    // the graphic entirely.
-    cairo_set_source_rgba(cr, 0.75, 0.25, 0.75, 0.5);
+  k.private_impl.dst_rect[0] = dst_rect.min_x;
+  k.private_impl.dst_rect[1] = dst_rect.min_y;
+  k.private_impl.dst_rect[2] = dst_rect.max_x;
+  k.private_impl.dst_rect[3] = dst_rect.max_y;
+  k.private_impl.pixels_width = pixels_width;
+  k.private_impl.pixels_height = pixels_height;
+  return k;
+}
+
+iconvg_bitmap_cache_key  //
+iconvg_bitmap_cache_key__make(uint32_t pixels_width,
+                              uint32_t pixels_height,
+                              iconvg_rectangle_f32 dst_rect,
+                              const uint8_t* src_ptr,
+                              size_t src_len,
+                              const iconvg_decode_options* options) {
+  iconvg_bitmap_cache_key k = iconvg_private_bitmap_cache_key__make(
+      pixels_width, pixels_height, dst_rect, src_ptr, src_len, options);
+  if (options && options->palette) {
+    k.private_impl.has_palette = 1;
+    k.private_impl.palette_hash = iconvg_private_hash_fnv1a64(
+        ICONVG_PRIVATE_FNV1A64_BASIS, &options->palette->colors[0].rgba[0],
+        sizeof(options->palette->colors));
   }
+  return k;
+}
 
-  cairo_fill(cr);
-  cairo_pattern_destroy(cp);
-  return NULL;
+iconvg_bitmap_cache_key  //
+iconvg_bitmap_cache_key__make_compiled(uint32_t pixels_width,
+                                       uint32_t pixels_height,
+                                       iconvg_rectangle_f32 dst_rect,
+                                       const uint8_t* compiled_ptr,
+                                       size_t compiled_len,
+                                       const iconvg_decode_options* options) {
+  iconvg_bitmap_cache_key k = iconvg_private_bitmap_cache_key__make(
+      pixels_width, pixels_height, dst_rect, compiled_ptr, compiled_len,
+      options);
+  k.private_impl.from_compiled = 1;
+
+  iconvg_palette suggested;
+  uint64_t mask = 0;
+  if (iconvg_private_decode_compiled_header(&suggested, &mask, compiled_ptr,
+                                            compiled_len) ||
+      (mask == 0)) {
+    return k;
+  }
+  // Hash only the entries in mask, of the effective palette.
+  const iconvg_palette* palette =
+      (options && options->palette) ? options->palette : &suggested;
+  uint64_t h = ICONVG_PRIVATE_FNV1A64_BASIS;
+  for (int i = 0; i < 64; i++) {
+    if (mask & (((uint64_t)1) << i)) {
+      h = iconvg_private_hash_fnv1a64(h, &palette->colors[i].rgba[0], 4);
+    }
+  }
+  k.private_impl.has_palette = 1;
+  k.private_impl.palette_hash = h;
+  return k;
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_move_to(cr, x0, y0);
-  return NULL;
+size_t  //
+iconvg_bitmap_cache_workbuf_len(size_t num_entries, size_t max_pixel_bytes) {
+  const size_t entry_len = sizeof(iconvg_private_bitmap_cache_entry);
+  const size_t state_len = sizeof(iconvg_private_bitmap_cache_state);
+  if ((num_entries == 0) ||
+      (num_entries > ICONVG_PRIVATE_BITMAP_CACHE_MAX_ENTRIES) ||
+      (num_entries > ((SIZE_MAX - state_len) / (entry_len + 8)))) {
+    return 0;
+  }
+  // The hash table has fewer than 4 * num_entries slots of 4 bytes each.
+  size_t n = state_len + (num_entries * entry_len) +
+             (iconvg_private_bitmap_cache__num_slots(num_entries) *
+              sizeof(uint32_t));
+  if (max_pixel_bytes > (SIZE_MAX - n)) {
+    return 0;
+  }
+  return n + max_pixel_bytes;
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__end_path(iconvg_canvas* c) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_close_path(cr);
+const char*  //
+iconvg_bitmap_cache__initialize(iconvg_bitmap_cache* self,
+                                void* workbuf_ptr,
+                                size_t workbuf_len,
+                                size_t num_entries) {
+  size_t min_len = iconvg_bitmap_cache_workbuf_len(num_entries, 0);
+  if (!self || !workbuf_ptr || (((uintptr_t)workbuf_ptr) & 7) ||
+      (min_len == 0) || (workbuf_len < min_len)) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(workbuf_ptr);
+  memset(state, 0, min_len);
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  if (pthread_mutex_init(&state->mutex, NULL) != 0) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+#endif
+  uint8_t* p = (uint8_t*)(workbuf_ptr);
+  state->entries_ptr = (iconvg_private_bitmap_cache_entry*)(
+      p + sizeof(iconvg_private_bitmap_cache_state));
+  state->entries_cap = num_entries;
+  state->slots_ptr = (uint32_t*)(state->entries_ptr + num_entries);
+  state->slots_mask = iconvg_private_bitmap_cache__num_slots(num_entries) - 1;
+  state->pixels_ptr = p + min_len;
+  state->pixels_cap = workbuf_len - min_len;
+  state->lru_head = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->lru_tail = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->arena_head = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->arena_tail = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->free_head = 0;
+  for (size_t i = 0; i < num_entries; i++) {
+    state->entries_ptr[i].lru_next = ((i + 1) < num_entries)
+                                         ? ((uint32_t)(i + 1))
+                                         : ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  }
+  self->private_impl.workbuf_ptr = workbuf_ptr;
   return NULL;
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__path_line_to(iconvg_canvas* c,
-                                          float x1,
-                                          float y1) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_line_to(cr, x1, y1);
-  return NULL;
+void  //
+iconvg_bitmap_cache__finalize(iconvg_bitmap_cache* self) {
+  if (!self || !self->private_impl.workbuf_ptr) {
+    return;
+  }
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(self->private_impl.workbuf_ptr);
+  pthread_mutex_destroy(&state->mutex);
+#endif
+  self->private_impl.workbuf_ptr = NULL;
 }
 
-static const char*  //
-iconvg_private_cairo_canvas__path_quad_to(iconvg_canvas* c,
-                                          float x1,
-                                          float y1,
-                                          float x2,
-                                          float y2) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  // Cairo doesn't have explicit support for quadratic Bézier curves, only
-  // linear and cubic ones. However, a "Bézier curve of degree n can be
-  // converted into a Bézier curve of degree n + 1 with the same shape", per
-  // https://en.wikipedia.org/wiki/B%C3%A9zier_curve#Degree_elevation
-  //
-  // Here, we perform "degree elevation" from [x0, x1, x2] to [X0, X1, X2, X3]
-  // = [x0, ((⅓ * x0) + (⅔ * x1)), ((⅔ * x1) + (⅓ * x2)), c2] and likewise for
-  // the y dimension.
-  double X0;
-  double Y0;
-  cairo_get_current_point(cr, &X0, &Y0);
-  double twice_x1 = ((double)x1) * 2;
-  double twice_y1 = ((double)y1) * 2;
-  double X3 = ((double)x2);
-  double Y3 = ((double)y2);
-  double X1 = (X0 + twice_x1) / 3;
-  double Y1 = (Y0 + twice_y1) / 3;
-  double X2 = (X3 + twice_x1) / 3;
-  double Y2 = (Y3 + twice_y1) / 3;
-  cairo_curve_to(cr, X1, Y1, X2, Y2, X3, Y3);
+bool  //
+iconvg_bitmap_cache__lookup(iconvg_bitmap_cache* self,
+                            const iconvg_bitmap_cache_key* key,
+                            uint8_t* dst_ptr,
+                            size_t dst_stride) {
+  if (!self || !self->private_impl.workbuf_ptr || !key) {
+    return false;
+  }
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(self->private_impl.workbuf_ptr);
+  uint64_t key_hash = iconvg_private_bitmap_cache_key__hash(key);
+  iconvg_private_bitmap_cache_state__lock(state);
+
+  iconvg_private_bitmap_cache_entry* e =
+      iconvg_private_bitmap_cache_state__find(state, key, key_hash);
+  if (e) {
+    uint32_t idx = (uint32_t)(e - state->entries_ptr);
+    iconvg_private_bitmap_cache_state__lru_unlink(state, idx);
+    iconvg_private_bitmap_cache_state__lru_push(state, idx);
+    if (dst_ptr) {
+      size_t row_len = 4 * ((size_t)(key->private_impl.pixels_width));
+      const uint8_t* src = state->pixels_ptr + e->offset;
+      for (uint32_t y = 0; y < key->private_impl.pixels_height; y++) {
+        memcpy(dst_ptr, src, row_len);
+        dst_ptr += dst_stride;
+        src += row_len;
+      }
+    }
+  }
+
+  iconvg_private_bitmap_cache_state__unlock(state);
+  return e != NULL;
+}
+
+const char*  //
+iconvg_bitmap_cache__insert(iconvg_bitmap_cache* self,
+                            const iconvg_bitmap_cache_key* key,
+                            const uint8_t* src_ptr,
+                            size_t src_stride) {
+  if (!self || !self->private_impl.workbuf_ptr || !key || !src_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  size_t width = key->private_impl.pixels_width;
+  size_t height = key->private_impl.pixels_height;
+  if ((width > (SIZE_MAX / 4)) || (src_stride < (4 * width))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  size_t row_len = 4 * width;
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(self->private_impl.workbuf_ptr);
+  if ((row_len == 0) || (height == 0) ||
+      (height > (state->pixels_cap / row_len))) {
+    return NULL;
+  }
+  size_t len = row_len * height;
+  uint64_t key_hash = iconvg_private_bitmap_cache_key__hash(key);
+
+  iconvg_private_bitmap_cache_state__lock(state);
+
+  iconvg_private_bitmap_cache_entry* e =
+      iconvg_private_bitmap_cache_state__find(state, key, key_hash);
+  if (e) {
+    // Another caller (e.g. on another thread) got here first.
+    uint32_t idx = (uint32_t)(e - state->entries_ptr);
+    iconvg_private_bitmap_cache_state__lru_unlink(state, idx);
+    iconvg_private_bitmap_cache_state__lru_push(state, idx);
+    iconvg_private_bitmap_cache_state__unlock(state);
+    return NULL;
+  }
+
+  if (state->free_head == ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    iconvg_private_bitmap_cache_state__evict_oldest(state);
+  }
+  while (len > (state->pixels_cap - state->live_bytes)) {
+    iconvg_private_bitmap_cache_state__evict_oldest(state);
+  }
+  if (len > (state->pixels_cap - state->pixels_used)) {
+    iconvg_private_bitmap_cache_state__compact(state);
+  }
+
+  uint32_t idx = state->free_head;
+  e = &state->entries_ptr[idx];
+  state->free_head = e->lru_next;
+  e->key_hash = key_hash;
+  e->offset = state->pixels_used;
+  e->len = len;
+  e->key = *key;
+  state->pixels_used += len;
+  state->live_bytes += len;
+
+  size_t i = key_hash & state->slots_mask;
+  while (state->slots_ptr[i] != 0) {
+    i = (i + 1) & state->slots_mask;
+  }
+  state->slots_ptr[i] = idx + 1;
+  iconvg_private_bitmap_cache_state__lru_push(state, idx);
+  e->arena_prev = state->arena_tail;
+  e->arena_next = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  if (state->arena_tail != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    state->entries_ptr[state->arena_tail].arena_next = idx;
+  } else {
+    state->arena_head = idx;
+  }
+  state->arena_tail = idx;
+
+  uint8_t* dst = state->pixels_ptr + e->offset;
+  for (size_t y = 0; y < height; y++) {
+    memcpy(dst, src_ptr, row_len);
+    dst += row_len;
+    src_ptr += src_stride;
+  }
+
+  iconvg_private_bitmap_cache_state__unlock(state);
   return NULL;
 }
 
+// -------------------------------- #include "./broken.c"
+
 static const char*  //
-iconvg_private_cairo_canvas__path_cube_to(iconvg_canvas* c,
-                                          float x1,
-                                          float y1,
-                                          float x2,
-                                          float y2,
-                                          float x3,
-                                          float y3) {
-  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_curve_to(cr, x1, y1, x2, y2, x3, y3);
-  return NULL;
+iconvg_private_broken_canvas__begin_decode(iconvg_canvas* c,
+                                           iconvg_rectangle_f32 dst_rect) {
+  return ((const char*)(c->context.const_ptr3));
 }
 
 static const char*  //
-iconvg_private_cairo_canvas__on_metadata_viewbox(iconvg_canvas* c,
-                                                 iconvg_rectangle_f32 viewbox) {
-  return NULL;
+iconvg_private_broken_canvas__end_decode(iconvg_canvas* c,
+                                         const char* err_msg,
+                                         size_t num_bytes_consumed,
+                                         size_t num_bytes_remaining) {
+  return err_msg ? err_msg : ((const char*)(c->context.const_ptr3));
 }
 
 static const char*  //
-iconvg_private_cairo_canvas__on_metadata_suggested_palette(
+iconvg_private_broken_canvas__begin_drawing(iconvg_canvas* c) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__end_drawing(iconvg_canvas* c,
+                                          const iconvg_paint* p) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__end_path(iconvg_canvas* c) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__path_line_to(iconvg_canvas* c,
+                                           float x1,
+                                           float y1) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__path_quad_to(iconvg_canvas* c,
+                                           float x1,
+                                           float y1,
+                                           float x2,
+                                           float y2) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__path_cube_to(iconvg_canvas* c,
+                                           float x1,
+                                           float y1,
+                                           float x2,
+                                           float y2,
+                                           float x3,
+                                           float y3) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__on_metadata_suggested_palette(
     iconvg_canvas* c,
     const iconvg_palette* suggested_palette) {
-  return NULL;
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__path_segments(iconvg_canvas* c,
+                                            const uint8_t* verbs,
+                                            size_t num_verbs,
+                                            const float* points) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  return ((const char*)(c->context.const_ptr3));
 }
 
 static const iconvg_canvas_vtable  //
-    iconvg_private_cairo_canvas_vtable = {
+    iconvg_private_broken_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
-        &iconvg_private_cairo_canvas__begin_decode,
-        &iconvg_private_cairo_canvas__end_decode,
-        &iconvg_private_cairo_canvas__begin_drawing,
-        &iconvg_private_cairo_canvas__end_drawing,
-        &iconvg_private_cairo_canvas__begin_path,
-        &iconvg_private_cairo_canvas__end_path,
-        &iconvg_private_cairo_canvas__path_line_to,
-        &iconvg_private_cairo_canvas__path_quad_to,
-        &iconvg_private_cairo_canvas__path_cube_to,
-        &iconvg_private_cairo_canvas__on_metadata_viewbox,
-        &iconvg_private_cairo_canvas__on_metadata_suggested_palette,
+        &iconvg_private_broken_canvas__begin_decode,
+        &iconvg_private_broken_canvas__end_decode,
+        &iconvg_private_broken_canvas__begin_drawing,
+        &iconvg_private_broken_canvas__end_drawing,
+        &iconvg_private_broken_canvas__begin_path,
+        &iconvg_private_broken_canvas__end_path,
+        &iconvg_private_broken_canvas__path_line_to,
+        &iconvg_private_broken_canvas__path_quad_to,
+        &iconvg_private_broken_canvas__path_cube_to,
+        &iconvg_private_broken_canvas__on_metadata_viewbox,
+        &iconvg_private_broken_canvas__on_metadata_suggested_palette,
+        &iconvg_private_broken_canvas__path_segments,
+        &iconvg_private_broken_canvas__on_skipped_drawing,
 };
 
 iconvg_canvas  //
-iconvg_canvas__make_cairo(cairo_t* cr) {
-  if (!cr) {
-    return iconvg_canvas__make_broken(
-        iconvg_error_invalid_constructor_argument);
-  }
+iconvg_canvas__make_broken(const char* err_msg) {
   iconvg_canvas c;
-  c.vtable = &iconvg_private_cairo_canvas_vtable;
+  c.vtable = &iconvg_private_broken_canvas_vtable;
   memset(&c.context, 0, sizeof(c.context));
-  c.context.nonconst_ptr1 = cr;
+  c.context.const_ptr3 = err_msg;
   return c;
 }
 
-#endif  // ICONVG_CONFIG__ENABLE_CAIRO_BACKEND
+bool  //
+iconvg_canvas__does_nothing(const iconvg_canvas* self) {
+  return !self || (self->vtable == NULL) ||
+         (self->vtable == &iconvg_private_broken_canvas_vtable);
+}
 
-// -------------------------------- #include "./color.c"
+// -------------------------------- #include "./cairo.c"
 
-const uint8_t iconvg_private_one_byte_colors[512] = {
-    0x00, 0x00, 0x00, 0xFF,  //
-    0x00, 0x00, 0x40, 0xFF,  //
-    0x00, 0x00, 0x80, 0xFF,  //
-    0x00, 0x00, 0xC0, 0xFF,  //
-    0x00, 0x00, 0xFF, 0xFF,  //
-    0x00, 0x40, 0x00, 0xFF,  //
-    0x00, 0x40, 0x40, 0xFF,  //
-    0x00, 0x40, 0x80, 0xFF,  //
-    0x00, 0x40, 0xC0, 0xFF,  //
-    0x00, 0x40, 0xFF, 0xFF,  //
-    0x00, 0x80, 0x00, 0xFF,  //
-    0x00, 0x80, 0x40, 0xFF,  //
-    0x00, 0x80, 0x80, 0xFF,  //
-    0x00, 0x80, 0xC0, 0xFF,  //
-    0x00, 0x80, 0xFF, 0xFF,  //
-    0x00, 0xC0, 0x00, 0xFF,  //
-    0x00, 0xC0, 0x40, 0xFF,  //
-    0x00, 0xC0, 0x80, 0xFF,  //
-    0x00, 0xC0, 0xC0, 0xFF,  //
-    0x00, 0xC0, 0xFF, 0xFF,  //
-    0x00, 0xFF, 0x00, 0xFF,  //
-    0x00, 0xFF, 0x40, 0xFF,  //
-    0x00, 0xFF, 0x80, 0xFF,  //
-    0x00, 0xFF, 0xC0, 0xFF,  //
-    0x00, 0xFF, 0xFF, 0xFF,  //
-    0x40, 0x00, 0x00, 0xFF,  //
-    0x40, 0x00, 0x40, 0xFF,  //
-    0x40, 0x00, 0x80, 0xFF,  //
-    0x40, 0x00, 0xC0, 0xFF,  //
-    0x40, 0x00, 0xFF, 0xFF,  //
-    0x40, 0x40, 0x00, 0xFF,  //
-    0x40, 0x40, 0x40, 0xFF,  //
-    0x40, 0x40, 0x80, 0xFF,  //
-    0x40, 0x40, 0xC0, 0xFF,  //
-    0x40, 0x40, 0xFF, 0xFF,  //
-    0x40, 0x80, 0x00, 0xFF,  //
-    0x40, 0x80, 0x40, 0xFF,  //
-    0x40, 0x80, 0x80, 0xFF,  //
-    0x40, 0x80, 0xC0, 0xFF,  //
-    0x40, 0x80, 0xFF, 0xFF,  //
-    0x40, 0xC0, 0x00, 0xFF,  //
-    0x40, 0xC0, 0x40, 0xFF,  //
-    0x40, 0xC0, 0x80, 0xFF,  //
-    0x40, 0xC0, 0xC0, 0xFF,  //
-    0x40, 0xC0, 0xFF, 0xFF,  //
-    0x40, 0xFF, 0x00, 0xFF,  //
-    0x40, 0xFF, 0x40, 0xFF,  //
-    0x40, 0xFF, 0x80, 0xFF,  //
-    0x40, 0xFF, 0xC0, 0xFF,  //
-    0x40, 0xFF, 0xFF, 0xFF,  //
-    0x80, 0x00, 0x00, 0xFF,  //
-    0x80, 0x00, 0x40, 0xFF,  //
-    0x80, 0x00, 0x80, 0xFF,  //
-    0x80, 0x00, 0xC0, 0xFF,  //
-    0x80, 0x00, 0xFF, 0xFF,  //
-    0x80, 0x40, 0x00, 0xFF,  //
-    0x80, 0x40, 0x40, 0xFF,  //
-    0x80, 0x40, 0x80, 0xFF,  //
-    0x80, 0x40, 0xC0, 0xFF,  //
-    0x80, 0x40, 0xFF, 0xFF,  //
-    0x80, 0x80, 0x00, 0xFF,  //
-    0x80, 0x80, 0x40, 0xFF,  //
-    0x80, 0x80, 0x80, 0xFF,  //
-    0x80, 0x80, 0xC0, 0xFF,  //
-    0x80, 0x80, 0xFF, 0xFF,  //
-    0x80, 0xC0, 0x00, 0xFF,  //
-    0x80, 0xC0, 0x40, 0xFF,  //
-    0x80, 0xC0, 0x80, 0xFF,  //
-    0x80, 0xC0, 0xC0, 0xFF,  //
-    0x80, 0xC0, 0xFF, 0xFF,  //
-    0x80, 0xFF, 0x00, 0xFF,  //
-    0x80, 0xFF, 0x40, 0xFF,  //
-    0x80, 0xFF, 0x80, 0xFF,  //
-    0x80, 0xFF, 0xC0, 0xFF,  //
-    0x80, 0xFF, 0xFF, 0xFF,  //
-    0xC0, 0x00, 0x00, 0xFF,  //
-    0xC0, 0x00, 0x40, 0xFF,  //
-    0xC0, 0x00, 0x80, 0xFF,  //
-    0xC0, 0x00, 0xC0, 0xFF,  //
-    0xC0, 0x00, 0xFF, 0xFF,  //
-    0xC0, 0x40, 0x00, 0xFF,  //
-    0xC0, 0x40, 0x40, 0xFF,  //
-    0xC0, 0x40, 0x80, 0xFF,  //
-    0xC0, 0x40, 0xC0, 0xFF,  //
-    0xC0, 0x40, 0xFF, 0xFF,  //
-    0xC0, 0x80, 0x00, 0xFF,  //
-    0xC0, 0x80, 0x40, 0xFF,  //
-    0xC0, 0x80, 0x80, 0xFF,  //
-    0xC0, 0x80, 0xC0, 0xFF,  //
-    0xC0, 0x80, 0xFF, 0xFF,  //
-    0xC0, 0xC0, 0x00, 0xFF,  //
-    0xC0, 0xC0, 0x40, 0xFF,  //
-    0xC0, 0xC0, 0x80, 0xFF,  //
-    0xC0, 0xC0, 0xC0, 0xFF,  //
-    0xC0, 0xC0, 0xFF, 0xFF,  //
-    0xC0, 0xFF, 0x00, 0xFF,  //
-    0xC0, 0xFF, 0x40, 0xFF,  //
-    0xC0, 0xFF, 0x80, 0xFF,  //
-    0xC0, 0xFF, 0xC0, 0xFF,  //
-    0xC0, 0xFF, 0xFF, 0xFF,  //
-    0xFF, 0x00, 0x00, 0xFF,  //
-    0xFF, 0x00, 0x40, 0xFF,  //
-    0xFF, 0x00, 0x80, 0xFF,  //
-    0xFF, 0x00, 0xC0, 0xFF,  //
-    0xFF, 0x00, 0xFF, 0xFF,  //
-    0xFF, 0x40, 0x00, 0xFF,  //
-    0xFF, 0x40, 0x40, 0xFF,  //
-    0xFF, 0x40, 0x80, 0xFF,  //
-    0xFF, 0x40, 0xC0, 0xFF,  //
-    0xFF, 0x40, 0xFF, 0xFF,  //
-    0xFF, 0x80, 0x00, 0xFF,  //
-    0xFF, 0x80, 0x40, 0xFF,  //
-    0xFF, 0x80, 0x80, 0xFF,  //
-    0xFF, 0x80, 0xC0, 0xFF,  //
-    0xFF, 0x80, 0xFF, 0xFF,  //
-    0xFF, 0xC0, 0x00, 0xFF,  //
-    0xFF, 0xC0, 0x40, 0xFF,  //
-    0xFF, 0xC0, 0x80, 0xFF,  //
-    0xFF, 0xC0, 0xC0, 0xFF,  //
-    0xFF, 0xC0, 0xFF, 0xFF,  //
-    0xFF, 0xFF, 0x00, 0xFF,  //
-    0xFF, 0xFF, 0x40, 0xFF,  //
-    0xFF, 0xFF, 0x80, 0xFF,  //
-    0xFF, 0xFF, 0xC0, 0xFF,  //
-    0xFF, 0xFF, 0xFF, 0xFF,  //
-    0xC0, 0xC0, 0xC0, 0xC0,  //
-    0x80, 0x80, 0x80, 0x80,  //
-    0x00, 0x00, 0x00, 0x00,  //
+#if !defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+
+iconvg_canvas  //
+iconvg_canvas__make_cairo(cairo_t* cr) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_cairo_with_gradient_cache(cairo_t* cr,
+                                              iconvg_gradient_cache* gc) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
+
+bool  //
+iconvg_private_cairo_canvas__push_transform(iconvg_canvas* c,
+                                            const iconvg_matrix_2x3_f64* m) {
+  return false;
+}
+
+void  //
+iconvg_private_cairo_canvas__pop_transform(iconvg_canvas* c) {}
+
+#else  // ICONVG_CONFIG__ENABLE_CAIRO_BACKEND
+
+#include <cairo/cairo.h>
+
+static const cairo_extend_t
+    iconvg_private_gradient_spread_as_cairo_extend_t[4] = {
+        CAIRO_EXTEND_NONE,     //
+        CAIRO_EXTEND_PAD,      //
+        CAIRO_EXTEND_REFLECT,  //
+        CAIRO_EXTEND_REPEAT    //
 };
 
-const iconvg_palette iconvg_private_default_palette = {{
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-    {{0x00, 0x00, 0x00, 0xFF}},  //
-}};
+static inline cairo_matrix_t  //
+iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(iconvg_matrix_2x3_f64 i) {
+  cairo_matrix_t c;
+  c.xx = i.elems[0][0];
+  c.xy = i.elems[0][1];
+  c.x0 = i.elems[0][2];
+  c.yx = i.elems[1][0];
+  c.yy = i.elems[1][1];
+  c.y0 = i.elems[1][2];
+  return c;
+}
+
+static void  //
+iconvg_private_cairo_release_pattern(void* obj) {
+  cairo_pattern_destroy((cairo_pattern_t*)obj);
+}
+
+// iconvg_private_cairo_set_gradient_stops sets the Cairo gradient stop colors
+// given the IconVG gradient stop colors.
+//
+// Unlike SVG, IconVG works solely with premultiplied alpha. In contrast,
+// https://lists.freedesktop.org/archives/cairo/2006-June/007203.html says that
+// Cairo accepts "both pre- and non-premultiplied colors in different parts of
+// the API". Specifically, while CAIRO_FORMAT_ARGB32 is premultiplied, both
+// cairo_set_source_rgba and cairo_pattern_add_color_stop_rgba are
+// non-premultiplied.
+//
+// For flat colors, we can simply convert IconVG colors to non-premultiplied
+// colors. Gradients are trickier (and hence this function is non-trivial)
+// because IconVG interpolation should also happen in premultiplied alpha space
+// (but Cairo interpolates in non-premultiplied alpha space). The mathematical
+// halfway color between opaque bright red = RGBA(1, 0, 0, 1) and transparent
+// black = RGBA(0, 0, 0, 0) is RGBA(½, 0, 0, ½). IconVG (premultiplied alpha)
+// semantics are that this is a 50% opaque bright red, not a 50% opaque dark
+// red. The halfway point still has 100% Saturation and 100% Value (in the HSV
+// Hue Saturation Value sense). It just has smaller alpha.
+//
+// Some more discussion is at
+// https://lists.freedesktop.org/archives/cairo/2021-May/029252.html
+static void  //
+iconvg_private_cairo_set_gradient_stops(cairo_pattern_t* cp,
+                                        const iconvg_paint* p) {
+  // foo0 and foo2 are the previous and current gradient stop. Sometimes we
+  // need to synthesize additional stops in between them, whose variables are
+  // named foo1.
+  double offset0 = 0.0;
+  double r0 = 0.0;
+  double g0 = 0.0;
+  double b0 = 0.0;
+  double a0 = 0.0;
+
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    // Calculate offset and color for the current stop.
+    double offset2 = iconvg_paint__gradient_stop_offset(p, i);
+    iconvg_premul_color k =
+        iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+    double r2 = k.rgba[0] / 255.0;
+    double g2 = k.rgba[1] / 255.0;
+    double b2 = k.rgba[2] / 255.0;
+    double a2 = k.rgba[3] / 255.0;
+
+    if ((i == 0) ||                      //
+        ((a0 == 1.0) && (a2 == 1.0)) ||  //
+        ((a0 == 0.0) && (a2 == 0.0))) {
+      // If it's the first stop, or if we're interpolating from 100% to 100%
+      // opaque or from 0% to 0% opaque, we don't have to worry about
+      // premultiplied versus non-premultiplied alpha.
+      cairo_pattern_add_color_stop_rgba(cp, offset2, r2, g2, b2, a2);
+
+    } else if (a0 == 0.0) {
+      // If we're blending e.g. from transparent black to (partially) opaque
+      // blue, insert "transparent blue" immediately after the previous
+      // "transparent black".
+      cairo_pattern_add_color_stop_rgba(cp, offset0, r2, g2, b2, 0.0);
+      cairo_pattern_add_color_stop_rgba(cp, offset2, r2, g2, b2, a2);
+
+    } else if (a2 == 0.0) {
+      // If we're blending e.g. from (partially) opaque blue to transparent
+      // black, insert "transparent blue" immediately before the current
+      // "transparent black".
+      cairo_pattern_add_color_stop_rgba(cp, offset2, r0, g0, b0, 0.0);
+      cairo_pattern_add_color_stop_rgba(cp, offset2, r2, g2, b2, a2);
+
+    } else {
+      // Otherwise, fake "interpolate with premultiplied alpha" by synthesizing
+      // n Cairo stops for this 1 IconVG stop. The n stops' colors are
+      // calculated explicitly here, in premultiplied alpha space. We then let
+      // Cairo do its thing in non-premultiplied alpha space. The difference
+      // between n stops (interpolating non-premultiplied) and 1 stop
+      // (interpolating premultiplied) will hopefully be imperceivable.
+      const int32_t n = 16;
+      for (int32_t i = (n - 1); i >= 0; i--) {
+        int32_t j = n - i;
+        double offset1 = ((i * offset0) + (j * offset2)) / n;
+        double r1 = ((i * r0) + (j * r2)) / n;
+        double g1 = ((i * g0) + (j * g2)) / n;
+        double b1 = ((i * b0) + (j * b2)) / n;
+        double a1 = ((i * a0) + (j * a2)) / n;
+        if (a1 == 0.0) {
+          cairo_pattern_add_color_stop_rgba(cp, offset1, 0, 0, 0, 0);
+        } else {
+          cairo_pattern_add_color_stop_rgba(cp, offset1,  //
+                                            r1 / a1, g1 / a1, b1 / a1, a1);
+        }
+      }
+    }
+
+    // Update offset and color for the previous stop.
+    offset0 = offset2;
+    r0 = r2;
+    g0 = g2;
+    b0 = b2;
+    a0 = a2;
+  }
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_save(cr);
+  cairo_rectangle(cr, dst_rect.min_x, dst_rect.min_y,
+                  iconvg_rectangle_f32__width_f64(&dst_rect),
+                  iconvg_rectangle_f32__height_f64(&dst_rect));
+  cairo_clip(cr);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_restore(cr);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__begin_drawing(iconvg_canvas* c) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_new_path(cr);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  iconvg_gradient_cache* gc =
+      (iconvg_gradient_cache*)(c->context.nonconst_ptr2);
+  iconvg_paint_type paint_type = iconvg_paint__type(p);
+  iconvg_matrix_2x3_f64 gtm;
+
+  switch (paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
+      cairo_set_source_rgba(cr, k.rgba[0] / 255.0, k.rgba[1] / 255.0,
+                            k.rgba[2] / 255.0, k.rgba[3] / 255.0);
+      cairo_fill(cr);
+      return NULL;
+    }
+
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+      gtm = iconvg_paint__gradient_transformation_matrix(p);
+      iconvg_matrix_2x3_f64__override_second_row(&gtm);
+      break;
+
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      gtm = iconvg_paint__gradient_transformation_matrix(p);
+      break;
+
+    default:
+      return iconvg_error_invalid_paint_type;
+  }
+
+  // Re-use a cached pattern, if there is one. The cache key excludes the
+  // matrix, which depends on the dst_rect, so set this drawing's matrix
+  // before filling. cairo_fill is done with the pattern once it returns.
+  cairo_matrix_t cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(gtm);
+  iconvg_private_gradient_key key;
+  if (gc) {
+    iconvg_private_gradient_key__initialize(&key, p);
+    cairo_pattern_t* cached =
+        (cairo_pattern_t*)(iconvg_private_gradient_cache__lookup(
+            gc, &key, &iconvg_private_cairo_release_pattern));
+    if (cached) {
+      cairo_pattern_set_matrix(cached, &cm);
+      cairo_set_source(cr, cached);
+      cairo_fill(cr);
+      return NULL;
+    }
+  }
+
+  cairo_pattern_t* cp =
+      (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT)
+          ? cairo_pattern_create_linear(0, 0, 1, 0)
+          : cairo_pattern_create_radial(0, 0, 0, 0, 0, 1);
+  cairo_pattern_set_matrix(cp, &cm);
+  cairo_pattern_set_extend(cp, iconvg_private_gradient_spread_as_cairo_extend_t
+                                   [iconvg_paint__gradient_spread(p)]);
+  iconvg_private_cairo_set_gradient_stops(cp, p);
+  bool ok = cairo_pattern_status(cp) == CAIRO_STATUS_SUCCESS;
+  if (ok) {
+    cairo_set_source(cr, cp);
+  } else {
+    // Substitute in a 50% transparent grayish purple so that "something is
+    // wrong with the Cairo pattern" is hopefully visible without abandoning
+    // the graphic entirely.
+    cairo_set_source_rgba(cr, 0.75, 0.25, 0.75, 0.5);
+  }
+
+  cairo_fill(cr);
+
+  // Hand our reference over to the cache (the cairo_t holds its own), or drop
+  // it. Cairo keeps each stop as a five-double color and offset plus four
+  // uint16_t color components.
+  int num_cairo_stops = 0;
+  cairo_pattern_get_color_stop_count(cp, &num_cairo_stops);
+  size_t backend_bytes = 256 + (((size_t)num_cairo_stops) * 48);
+  if (!ok || !gc ||
+      !iconvg_private_gradient_cache__insert(
+          gc, &key, &iconvg_private_cairo_release_pattern, cp, backend_bytes)) {
+    cairo_pattern_destroy(cp);
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_move_to(cr, x0, y0);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__end_path(iconvg_canvas* c) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_close_path(cr);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_line_to(cr, x1, y1);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  // Cairo doesn't have explicit support for quadratic Bézier curves, only
+  // linear and cubic ones. However, a "Bézier curve of degree n can be
+  // converted into a Bézier curve of degree n + 1 with the same shape", per
+  // https://en.wikipedia.org/wiki/B%C3%A9zier_curve#Degree_elevation
+  //
+  // Here, we perform "degree elevation" from [x0, x1, x2] to [X0, X1, X2, X3]
+  // = [x0, ((⅓ * x0) + (⅔ * x1)), ((⅔ * x1) + (⅓ * x2)), c2] and likewise for
+  // the y dimension.
+  double X0;
+  double Y0;
+  cairo_get_current_point(cr, &X0, &Y0);
+  double twice_x1 = ((double)x1) * 2;
+  double twice_y1 = ((double)y1) * 2;
+  double X3 = ((double)x2);
+  double Y3 = ((double)y2);
+  double X1 = (X0 + twice_x1) / 3;
+  double Y1 = (Y0 + twice_y1) / 3;
+  double X2 = (X3 + twice_x1) / 3;
+  double Y2 = (Y3 + twice_y1) / 3;
+  cairo_curve_to(cr, X1, Y1, X2, Y2, X3, Y3);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_curve_to(cr, x1, y1, x2, y2, x3, y3);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_cairo_canvas__path_segments(iconvg_canvas* c,
+                                           const uint8_t* verbs,
+                                           size_t num_verbs,
+                                           const float* points) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        cairo_line_to(cr, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        iconvg_private_cairo_canvas__path_quad_to(c, points[0], points[1],
+                                                  points[2], points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        cairo_curve_to(cr, points[0], points[1], points[2], points[3],
+                       points[4], points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_cairo_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_cairo_canvas__begin_decode,
+        &iconvg_private_cairo_canvas__end_decode,
+        &iconvg_private_cairo_canvas__begin_drawing,
+        &iconvg_private_cairo_canvas__end_drawing,
+        &iconvg_private_cairo_canvas__begin_path,
+        &iconvg_private_cairo_canvas__end_path,
+        &iconvg_private_cairo_canvas__path_line_to,
+        &iconvg_private_cairo_canvas__path_quad_to,
+        &iconvg_private_cairo_canvas__path_cube_to,
+        &iconvg_private_cairo_canvas__on_metadata_viewbox,
+        &iconvg_private_cairo_canvas__on_metadata_suggested_palette,
+        &iconvg_private_cairo_canvas__path_segments,
+        NULL,
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_cairo(cairo_t* cr) {
+  return iconvg_canvas__make_cairo_with_gradient_cache(cr, NULL);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_cairo_with_gradient_cache(cairo_t* cr,
+                                              iconvg_gradient_cache* gc) {
+  if (!cr) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_cairo_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = cr;
+  c.context.nonconst_ptr2 = gc;
+  return c;
+}
+
+bool  //
+iconvg_private_cairo_canvas__push_transform(iconvg_canvas* c,
+                                            const iconvg_matrix_2x3_f64* m) {
+  if (!c || (c->vtable != &iconvg_private_cairo_canvas_vtable)) {
+    return false;
+  }
+  // A non-invertible matrix would put the cairo_t into an error state, so
+  // leave those to the transform canvas.
+  cairo_matrix_t cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(*m);
+  cairo_matrix_t inverse = cm;
+  if (cairo_matrix_invert(&inverse) != CAIRO_STATUS_SUCCESS) {
+    return false;
+  }
+  // cairo_transform, unlike cairo_set_matrix, keeps whatever matrix (e.g. a
+  // HiDPI device scale) the caller already set on the cairo_t.
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_save(cr);
+  cairo_transform(cr, &cm);
+  return true;
+}
+
+void  //
+iconvg_private_cairo_canvas__pop_transform(iconvg_canvas* c) {
+  cairo_restore((cairo_t*)(c->context.nonconst_ptr1));
+}
+
+#endif  // ICONVG_CONFIG__ENABLE_CAIRO_BACKEND
+
+// -------------------------------- #include "./color.c"
+
+const uint8_t iconvg_private_one_byte_colors[512] = {
+    0x00, 0x00, 0x00, 0xFF,  //
+    0x00, 0x00, 0x40, 0xFF,  //
+    0x00, 0x00, 0x80, 0xFF,  //
+    0x00, 0x00, 0xC0, 0xFF,  //
+    0x00, 0x00, 0xFF, 0xFF,  //
+    0x00, 0x40, 0x00, 0xFF,  //
+    0x00, 0x40, 0x40, 0xFF,  //
+    0x00, 0x40, 0x80, 0xFF,  //
+    0x00, 0x40, 0xC0, 0xFF,  //
+    0x00, 0x40, 0xFF, 0xFF,  //
+    0x00, 0x80, 0x00, 0xFF,  //
+    0x00, 0x80, 0x40, 0xFF,  //
+    0x00, 0x80, 0x80, 0xFF,  //
+    0x00, 0x80, 0xC0, 0xFF,  //
+    0x00, 0x80, 0xFF, 0xFF,  //
+    0x00, 0xC0, 0x00, 0xFF,  //
+    0x00, 0xC0, 0x40, 0xFF,  //
+    0x00, 0xC0, 0x80, 0xFF,  //
+    0x00, 0xC0, 0xC0, 0xFF,  //
+    0x00, 0xC0, 0xFF, 0xFF,  //
+    0x00, 0xFF, 0x00, 0xFF,  //
+    0x00, 0xFF, 0x40, 0xFF,  //
+    0x00, 0xFF, 0x80, 0xFF,  //
+    0x00, 0xFF, 0xC0, 0xFF,  //
+    0x00, 0xFF, 0xFF, 0xFF,  //
+    0x40, 0x00, 0x00, 0xFF,  //
+    0x40, 0x00, 0x40, 0xFF,  //
+    0x40, 0x00, 0x80, 0xFF,  //
+    0x40, 0x00, 0xC0, 0xFF,  //
+    0x40, 0x00, 0xFF, 0xFF,  //
+    0x40, 0x40, 0x00, 0xFF,  //
+    0x40, 0x40, 0x40, 0xFF,  //
+    0x40, 0x40, 0x80, 0xFF,  //
+    0x40, 0x40, 0xC0, 0xFF,  //
+    0x40, 0x40, 0xFF, 0xFF,  //
+    0x40, 0x80, 0x00, 0xFF,  //
+    0x40, 0x80, 0x40, 0xFF,  //
+    0x40, 0x80, 0x80, 0xFF,  //
+    0x40, 0x80, 0xC0, 0xFF,  //
+    0x40, 0x80, 0xFF, 0xFF,  //
+    0x40, 0xC0, 0x00, 0xFF,  //
+    0x40, 0xC0, 0x40, 0xFF,  //
+    0x40, 0xC0, 0x80, 0xFF,  //
+    0x40, 0xC0, 0xC0, 0xFF,  //
+    0x40, 0xC0, 0xFF, 0xFF,  //
+    0x40, 0xFF, 0x00, 0xFF,  //
+    0x40, 0xFF, 0x40, 0xFF,  //
+    0x40, 0xFF, 0x80, 0xFF,  //
+    0x40, 0xFF, 0xC0, 0xFF,  //
+    0x40, 0xFF, 0xFF, 0xFF,  //
+    0x80, 0x00, 0x00, 0xFF,  //
+    0x80, 0x00, 0x40, 0xFF,  //
+    0x80, 0x00, 0x80, 0xFF,  //
+    0x80, 0x00, 0xC0, 0xFF,  //
+    0x80, 0x00, 0xFF, 0xFF,  //
+    0x80, 0x40, 0x00, 0xFF,  //
+    0x80, 0x40, 0x40, 0xFF,  //
+    0x80, 0x40, 0x80, 0xFF,  //
+    0x80, 0x40, 0xC0, 0xFF,  //
+    0x80, 0x40, 0xFF, 0xFF,  //
+    0x80, 0x80, 0x00, 0xFF,  //
+    0x80, 0x80, 0x40, 0xFF,  //
+    0x80, 0x80, 0x80, 0xFF,  //
+    0x80, 0x80, 0xC0, 0xFF,  //
+    0x80, 0x80, 0xFF, 0xFF,  //
+    0x80, 0xC0, 0x00, 0xFF,  //
+    0x80, 0xC0, 0x40, 0xFF,  //
+    0x80, 0xC0, 0x80, 0xFF,  //
+    0x80, 0xC0, 0xC0, 0xFF,  //
+    0x80, 0xC0, 0xFF, 0xFF,  //
+    0x80, 0xFF, 0x00, 0xFF,  //
+    0x80, 0xFF, 0x40, 0xFF,  //
+    0x80, 0xFF, 0x80, 0xFF,  //
+    0x80, 0xFF, 0xC0, 0xFF,  //
+    0x80, 0xFF, 0xFF, 0xFF,  //
+    0xC0, 0x00, 0x00, 0xFF,  //
+    0xC0, 0x00, 0x40, 0xFF,  //
+    0xC0, 0x00, 0x80, 0xFF,  //
+    0xC0, 0x00, 0xC0, 0xFF,  //
+    0xC0, 0x00, 0xFF, 0xFF,  //
+    0xC0, 0x40, 0x00, 0xFF,  //
+    0xC0, 0x40, 0x40, 0xFF,  //
+    0xC0, 0x40, 0x80, 0xFF,  //
+    0xC0, 0x40, 0xC0, 0xFF,  //
+    0xC0, 0x40, 0xFF, 0xFF,  //
+    0xC0, 0x80, 0x00, 0xFF,  //
+    0xC0, 0x80, 0x40, 0xFF,  //
+    0xC0, 0x80, 0x80, 0xFF,  //
+    0xC0, 0x80, 0xC0, 0xFF,  //
+    0xC0, 0x80, 0xFF, 0xFF,  //
+    0xC0, 0xC0, 0x00, 0xFF,  //
+    0xC0, 0xC0, 0x40, 0xFF,  //
+    0xC0, 0xC0, 0x80, 0xFF,  //
+    0xC0, 0xC0, 0xC0, 0xFF,  //
+    0xC0, 0xC0, 0xFF, 0xFF,  //
+    0xC0, 0xFF, 0x00, 0xFF,  //
+    0xC0, 0xFF, 0x40, 0xFF,  //
+    0xC0, 0xFF, 0x80, 0xFF,  //
+    0xC0, 0xFF, 0xC0, 0xFF,  //
+    0xC0, 0xFF, 0xFF, 0xFF,  //
+    0xFF, 0x00, 0x00, 0xFF,  //
+    0xFF, 0x00, 0x40, 0xFF,  //
+    0xFF, 0x00, 0x80, 0xFF,  //
+    0xFF, 0x00, 0xC0, 0xFF,  //
+    0xFF, 0x00, 0xFF, 0xFF,  //
+    0xFF, 0x40, 0x00, 0xFF,  //
+    0xFF, 0x40, 0x40, 0xFF,  //
+    0xFF, 0x40, 0x80, 0xFF,  //
+    0xFF, 0x40, 0xC0, 0xFF,  //
+    0xFF, 0x40, 0xFF, 0xFF,  //
+    0xFF, 0x80, 0x00, 0xFF,  //
+    0xFF, 0x80, 0x40, 0xFF,  //
+    0xFF, 0x80, 0x80, 0xFF,  //
+    0xFF, 0x80, 0xC0, 0xFF,  //
+    0xFF, 0x80, 0xFF, 0xFF,  //
+    0xFF, 0xC0, 0x00, 0xFF,  //
+    0xFF, 0xC0, 0x40, 0xFF,  //
+    0xFF, 0xC0, 0x80, 0xFF,  //
+    0xFF, 0xC0, 0xC0, 0xFF,  //
+    0xFF, 0xC0, 0xFF, 0xFF,  //
+    0xFF, 0xFF, 0x00, 0xFF,  //
+    0xFF, 0xFF, 0x40, 0xFF,  //
+    0xFF, 0xFF, 0x80, 0xFF,  //
+    0xFF, 0xFF, 0xC0, 0xFF,  //
+    0xFF, 0xFF, 0xFF, 0xFF,  //
+    0xC0, 0xC0, 0xC0, 0xC0,  //
+    0x80, 0x80, 0x80, 0x80,  //
+    0x00, 0x00, 0x00, 0x00,  //
+};
+
+const iconvg_palette iconvg_private_default_palette = {{
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+    {{0x00, 0x00, 0x00, 0xFF}},  //
+}};
+
+// -------------------------------- #include "./compiled.c"
+
+// The compiled form is a sequence of little-endian uint32_t words. It starts
+// with a header:
+//  - 1 word: the magic identifier "\x89IVC".
+//  - 4 words: the ViewBox (min_x, min_y, max_x, max_y) as float32 bits.
+//  - 64 words: the suggested palette, as premultiplied RGBA.
+//  - 2 words: the palette mask (low word first). Bit i is set if any drawing
+//    depends on the i'th custom palette entry.
+//
+// The header is followed by zero or more ops. Each op is one word (whose low
+// byte is the opcode and whose upper three bytes are the a, b and c
+// arguments) followed by zero or more argument words. Coordinates are always
+// absolute and in ViewBox space, so that replaying an op only needs to apply
+// the same s2d (src to dst) transform that iconvg_private_execute_bytecode
+// applies, producing exactly the same canvas method arguments.
+//
+// Color register values that depend on the custom palette are not resolved
+// until replay time, since each iconvg_decode_compiled call can pass its own
+// iconvg_decode_options palette. The compiler tracks which palette entries
+// each CREG value derives from, so that it can mark the drawings (and the
+// palette mask) whose paint depends on them.
+//
+// The compiled form is not a stable file format. It should only be replayed
+// by the same library version that produced it.
+
+#define ICONVG_PRIVATE_COMPILED_MAGIC 0x43564989u
+#define ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS 71
+
+// SET_CREG_RGBA sets CREG[a] to the next word's RGBA.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA 0x01
+// SET_CREG_ONE_BYTE sets CREG[a] to the one byte color b, which refers to the
+// custom palette or to CREG.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_ONE_BYTE 0x02
+// SET_CREG_BLEND sets CREG[a] to blending the one byte colors b and c, with
+// the next word holding the blend weight of c.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND 0x03
+// SET_NREG sets NREG[a] to the next word's float32.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG 0x04
+// SET_LOD sets the Level of Detail bounds to the next two float32 words.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD 0x05
+// BEGIN_DRAWING sets the paint to CREG[a] and begins a drawing and path. b is
+// 1 if the paint (including any gradient stops) depends on the custom palette
+// and 0 otherwise. It is followed by 7 words: a skip count, the path's initial
+// x and y and the drawing's bounds (min_x, min_y, max_x, max_y, as per
+// iconvg_private_decoder__drawing_bounds), all but the first as float32. The
+// skip count is the number of words, after those 7, up to and including the
+// matching END_DRAWING op. Replay can use it to jump over a drawing that is
+// outside the Level of Detail bounds or the clip rectangle, or that has a
+// palette-independent transparent paint, or whose coverage comes from an
+// iconvg_coverage_masks.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING 0x06
+// MOVE_TO ends the path and begins a new one at the next two float32 words.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO 0x07
+// LINE_TO, QUAD_TO and CUBE_TO are followed by a segments, each of 2, 4 or 6
+// float32 words.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO 0x08
+#define ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO 0x09
+#define ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO 0x0A
+// CUBE_TO_F64 is like CUBE_TO except that each of its 6 coordinates is a
+// float64 (low word first), 12 words per segment. The compiler converts arcs
+// to these, so that replay does no trigonometry. Keeping the conversion's
+// float64 precision (instead of rounding to float32 before the s2d transform)
+// means that replay still produces exactly the same canvas method arguments.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64 0x0B
+// END_DRAWING ends the path and the drawing.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING 0x0C
+
+typedef struct iconvg_private_compiler_struct {
+  uint8_t* ptr;
+  size_t len;
+  // n is the number of bytes emitted so far, which can exceed len when the
+  // dst buffer is too short.
+  size_t n;
+  // skip_count_n is the value of n just after the current drawing's
+  // BEGIN_DRAWING skip count was emitted.
+  size_t skip_count_n;
+  // creg_deps[i] is the set (a bitmask) of custom palette entries that
+  // CREG[i] derives from. When it is zero, creg_values[i] is CREG[i]'s value,
+  // independent of the palette.
+  uint64_t creg_deps[64];
+  iconvg_palette creg_values;
+  // palette_mask is the union of every drawing's palette dependencies.
+  uint64_t palette_mask;
+  // lod is the Level of Detail range set by the most recent SET_LOD.
+  float lod[2];
+  // probe, if non-NULL, gathers iconvg_probe's bytecode statistics.
+  // probe_lod_segments is where the current drawing's segments are counted,
+  // other than in the total, or NULL if its LOD range overflowed.
+  iconvg_probe_results* probe;
+  uint64_t* probe_lod_segments;
+} iconvg_private_compiler;
+
+static inline void  //
+iconvg_private_compiler__emit_u32(iconvg_private_compiler* self, uint32_t u) {
+  if ((self->n <= self->len) && ((self->len - self->n) >= 4)) {
+    iconvg_private_poke_u32le(self->ptr + self->n, u);
+  }
+  self->n += 4;
+}
+
+static inline void  //
+iconvg_private_compiler__patch_u32(iconvg_private_compiler* self,
+                                   size_t offset,
+                                   uint32_t u) {
+  if ((offset <= self->len) && ((self->len - offset) >= 4)) {
+    iconvg_private_poke_u32le(self->ptr + offset, u);
+  }
+}
+
+static inline void  //
+iconvg_private_compiler__emit_f32(iconvg_private_compiler* self, float f) {
+  iconvg_private_compiler__emit_u32(
+      self, iconvg_private_reinterpret_from_f32_to_u32(f));
+}
+
+static inline void  //
+iconvg_private_compiler__emit_f64(iconvg_private_compiler* self, double f) {
+  uint64_t u = iconvg_private_reinterpret_from_f64_to_u64(f);
+  iconvg_private_compiler__emit_u32(self, (uint32_t)(u >> 0));
+  iconvg_private_compiler__emit_u32(self, (uint32_t)(u >> 32));
+}
+
+static void  //
+iconvg_private_compiler__probe_op(iconvg_private_compiler* self,
+                                  uint32_t opcode,
+                                  uint32_t a);
+
+static inline void  //
+iconvg_private_compiler__emit_op(iconvg_private_compiler* self,
+                                 uint32_t opcode,
+                                 uint32_t a,
+                                 uint32_t b,
+                                 uint32_t c) {
+  iconvg_private_compiler__emit_u32(
+      self, opcode | ((a & 0xFF) << 8) | ((b & 0xFF) << 16) | (c << 24));
+  if (self->probe) {
+    iconvg_private_compiler__probe_op(self, opcode, a);
+  }
+}
+
+static inline void  //
+iconvg_private_compiler__emit_set_creg_rgba(iconvg_private_compiler* self,
+                                            uint32_t creg_index,
+                                            const uint8_t* rgba) {
+  iconvg_private_compiler__emit_op(
+      self, ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA, creg_index, 0, 0);
+  iconvg_private_compiler__emit_u32(self, iconvg_private_peek_u32le(rgba));
+  self->creg_deps[creg_index] = 0;
+  memcpy(&self->creg_values.colors[creg_index].rgba[0], rgba, 4);
+}
+
+// iconvg_private_compiler__one_byte_color sets *dst_rgba to the one byte
+// color u (meaningful only if the result is zero) and returns the set of
+// custom palette entries that it derives from.
+static inline uint64_t  //
+iconvg_private_compiler__one_byte_color(iconvg_private_compiler* self,
+                                        uint8_t* dst_rgba,
+                                        uint8_t u) {
+  static const iconvg_palette placeholder_palette = {{{{0}}}};
+  iconvg_private_set_one_byte_color(dst_rgba, &placeholder_palette,
+                                    &self->creg_values, u);
+  if (u < 0x80) {
+    return 0;
+  } else if (u < 0xC0) {
+    return ((uint64_t)1) << (u & 0x3F);
+  }
+  return self->creg_deps[u & 0x3F];
+}
+
+// iconvg_private_compiler__paint_deps returns the set of custom palette
+// entries that a drawing with CREG[creg_index] as its paint depends on.
+static uint64_t  //
+iconvg_private_compiler__paint_deps(iconvg_private_compiler* self,
+                                    uint32_t creg_index) {
+  uint64_t deps = self->creg_deps[creg_index];
+  if (deps != 0) {
+    // Custom palette entries are valid premultiplied colors, and so is any
+    // blend of them. A palette-dependent paint is therefore a flat color.
+    return deps;
+  }
+  iconvg_paint p;
+  memcpy(&p.paint_rgba[0], &self->creg_values.colors[creg_index].rgba[0], 4);
+  if (iconvg_paint__type(&p) == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    return 0;
+  }
+  uint32_t cbase = p.paint_rgba[1];
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(&p);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    deps |= self->creg_deps[0x3F & (cbase + i)];
+  }
+  return deps;
+}
+
+// iconvg_private_compiler__probe_op updates self->probe's statistics for an
+// op that is being emitted. For BEGIN_DRAWING, a is the CREG index.
+static void  //
+iconvg_private_compiler__probe_op(iconvg_private_compiler* self,
+                                  uint32_t opcode,
+                                  uint32_t a) {
+  iconvg_probe_results* probe = self->probe;
+  switch (opcode) {
+    case ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING: {
+      probe->num_drawings++;
+      if (self->creg_deps[a] == 0) {
+        iconvg_paint p;
+        memcpy(&p.paint_rgba[0], &self->creg_values.colors[a].rgba[0], 4);
+        iconvg_paint_type t = iconvg_paint__type(&p);
+        if ((t == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) ||
+            (t == ICONVG_PAINT_TYPE__RADIAL_GRADIENT)) {
+          probe->num_gradient_drawings++;
+        }
+      }
+
+      uint32_t i = 0;
+      for (; i < probe->num_lod_ranges; i++) {
+        if ((probe->lod_ranges[i].lod0 == self->lod[0]) &&
+            (probe->lod_ranges[i].lod1 == self->lod[1])) {
+          break;
+        }
+      }
+      if (i == probe->num_lod_ranges) {
+        if (i == ICONVG_PROBE_MAX_LOD_RANGES) {
+          probe->lod_ranges_overflowed = true;
+          self->probe_lod_segments = NULL;
+          return;
+        }
+        probe->lod_ranges[i].lod0 = self->lod[0];
+        probe->lod_ranges[i].lod1 = self->lod[1];
+        probe->num_lod_ranges++;
+      }
+      probe->lod_ranges[i].num_drawings++;
+      self->probe_lod_segments = &probe->lod_ranges[i].num_path_segments;
+      return;
+    }
+
+    case ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO:
+    case ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO:
+    case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO:
+    case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64:
+      probe->num_path_segments += a;
+      if (self->probe_lod_segments) {
+        *self->probe_lod_segments += a;
+      }
+      return;
+  }
+}
+
+// ----
+
+// iconvg_private_compile_bytecode is like iconvg_private_execute_bytecode
+// except that it emits compiled ops instead of calling canvas methods. The two
+// functions should be kept in sync.
+static const char*  //
+iconvg_private_compile_bytecode(iconvg_private_compiler* e,
+                                iconvg_private_decoder* d) {
+  // adjustments are the ADJ values from the IconVG spec.
+  static const uint32_t adjustments[8] = {0, 1, 2, 3, 4, 5, 6, 0};
+
+  float curr_x = +0.0f;
+  float curr_y = +0.0f;
+  float x1 = +0.0f;
+  float y1 = +0.0f;
+  float x2 = +0.0f;
+  float y2 = +0.0f;
+  float x3 = +0.0f;
+  float y3 = +0.0f;
+  uint32_t flags = 0;
+
+  // sel[0] and sel[1] are the CSEL and NSEL registers.
+  uint32_t sel[2] = {0};
+
+styling_mode:
+  while (true) {
+    if (d->len == 0) {
+      return NULL;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    if (opcode < 0x80) {
+      sel[opcode >> 6] = opcode & 0x3F;
+      continue;
+
+    } else if (opcode < 0x88) {  // Set CREG[etc]; 1 byte color.
+      if (d->len < 1) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t u = d->ptr[0];
+      if (u < 0x80) {
+        iconvg_private_compiler__emit_set_creg_rgba(
+            e, creg_index, &iconvg_private_one_byte_colors[4 * ((size_t)u)]);
+      } else {
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_ONE_BYTE, creg_index,
+            u, 0);
+        uint8_t rgba[4];
+        e->creg_deps[creg_index] =
+            iconvg_private_compiler__one_byte_color(e, &rgba[0], u);
+        memcpy(&e->creg_values.colors[creg_index].rgba[0], &rgba[0], 4);
+      }
+      d->ptr += 1;
+      d->len -= 1;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0x90) {  // Set CREG[etc]; 2 byte color.
+      if (d->len < 2) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t rgba[4];
+      rgba[0] = 0x11 * (d->ptr[0] >> 4);
+      rgba[1] = 0x11 * (d->ptr[0] & 0x0F);
+      rgba[2] = 0x11 * (d->ptr[1] >> 4);
+      rgba[3] = 0x11 * (d->ptr[1] & 0x0F);
+      iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, &rgba[0]);
+      d->ptr += 2;
+      d->len -= 2;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0x98) {  // Set CREG[etc]; 3 byte (direct) color.
+      if (d->len < 3) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t rgba[4];
+      rgba[0] = d->ptr[0];
+      rgba[1] = d->ptr[1];
+      rgba[2] = d->ptr[2];
+      rgba[3] = 0xFF;
+      iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, &rgba[0]);
+      d->ptr += 3;
+      d->len -= 3;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xA0) {  // Set CREG[etc]; 4 byte color.
+      if (d->len < 4) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, d->ptr);
+      d->ptr += 4;
+      d->len -= 4;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xA8) {  // Set CREG[etc]; 3 byte (indirect) color.
+      if (d->len < 3) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint32_t q_blend = d->ptr[0];
+      uint8_t p_u = d->ptr[1];
+      uint8_t q_u = d->ptr[2];
+      if ((p_u < 0x80) && (q_u < 0x80)) {
+        const uint8_t* p = &iconvg_private_one_byte_colors[4 * ((size_t)p_u)];
+        const uint8_t* q = &iconvg_private_one_byte_colors[4 * ((size_t)q_u)];
+        uint32_t p_blend = 255 - q_blend;
+        uint8_t rgba[4];
+        rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+        rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+        rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+        rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+        iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, &rgba[0]);
+      } else {
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND, creg_index, p_u,
+            q_u);
+        iconvg_private_compiler__emit_u32(e, q_blend);
+        uint8_t p[4];
+        uint8_t q[4];
+        uint64_t deps = iconvg_private_compiler__one_byte_color(e, &p[0], p_u) |
+                        iconvg_private_compiler__one_byte_color(e, &q[0], q_u);
+        uint32_t p_blend = 255 - q_blend;
+        uint8_t* rgba = &e->creg_values.colors[creg_index].rgba[0];
+        rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+        rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+        rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+        rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+        e->creg_deps[creg_index] = deps;
+      }
+      d->ptr += 3;
+      d->len -= 3;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xC0) {  // Set NREG[etc]; real, coordinate or 0-to-1.
+      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
+      float num;
+      if (opcode < 0xB0) {
+        if (!iconvg_private_decoder__decode_real_number(d, &num)) {
+          return iconvg_error_bad_number;
+        }
+      } else if (opcode < 0xB8) {
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &num)) {
+          return iconvg_error_bad_coordinate;
+        }
+      } else {
+        if (!iconvg_private_decoder__decode_zero_to_one_number(d, &num)) {
+          return iconvg_error_bad_number;
+        }
+      }
+      iconvg_private_compiler__emit_op(
+          e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG, nreg_index, 0, 0);
+      iconvg_private_compiler__emit_f32(e, num);
+      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xC7) {  // Switch to the drawing mode.
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+          !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+        return iconvg_error_bad_coordinate;
+      }
+      uint64_t deps = iconvg_private_compiler__paint_deps(e, creg_index);
+      e->palette_mask |= deps;
+      iconvg_private_compiler__emit_op(
+          e, ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING, creg_index,
+          (deps != 0) ? 1 : 0, 0);
+      iconvg_private_compiler__emit_u32(e, 0);  // Patched by END_DRAWING.
+      e->skip_count_n = e->n;
+      iconvg_private_compiler__emit_f32(e, curr_x);
+      iconvg_private_compiler__emit_f32(e, curr_y);
+      // If the bounds are unknown, the drawing is invalid and compiling it
+      // will fail further on.
+      float bounds[4] = {-INFINITY, -INFINITY, +INFINITY, +INFINITY};
+      iconvg_private_decoder__drawing_bounds(d, &bounds[0], curr_x, curr_y);
+      for (int i = 0; i < 4; i++) {
+        iconvg_private_compiler__emit_f32(e, bounds[i]);
+      }
+      x1 = curr_x;
+      y1 = curr_y;
+      goto drawing_mode;
+
+    } else if (opcode < 0xC8) {  // Set Level of Detail bounds.
+      float lod0;
+      float lod1;
+      if (!iconvg_private_decoder__decode_real_number(d, &lod0) ||
+          !iconvg_private_decoder__decode_real_number(d, &lod1)) {
+        return iconvg_error_bad_number;
+      }
+      iconvg_private_compiler__emit_op(
+          e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD, 0, 0, 0);
+      iconvg_private_compiler__emit_f32(e, lod0);
+      iconvg_private_compiler__emit_f32(e, lod1);
+      e->lod[0] = lod0;
+      e->lod[1] = lod1;
+      continue;
+    }
+
+    return iconvg_error_bad_styling_opcode;
+  }
+
+drawing_mode:
+  while (true) {
+    if (d->len == 0) {
+      return iconvg_error_bad_path_unfinished;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    switch (opcode >> 4) {
+      case 0x00:
+      case 0x01:    // 'L' mnemonic: absolute line_to.
+      case 0x02:
+      case 0x03: {  // 'l' mnemonic: relative line_to.
+        bool relative = opcode >= 0x20;
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO, (opcode & 0x1F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x1F; reps >= 0; reps--) {
+          if (relative) {
+            if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+                !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+              return iconvg_error_bad_coordinate;
+            }
+            curr_x += x1;
+            curr_y += y1;
+          } else if (!iconvg_private_decoder__decode_coordinate_number(
+                         d, &curr_x) ||
+                     !iconvg_private_decoder__decode_coordinate_number(
+                         d, &curr_y)) {
+            return iconvg_error_bad_coordinate;
+          }
+          iconvg_private_compiler__emit_f32(e, curr_x);
+          iconvg_private_compiler__emit_f32(e, curr_y);
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+
+      case 0x04:    // 'T' mnemonic: absolute smooth quad_to.
+      case 0x05: {  // 't' mnemonic: relative smooth quad_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0x50) {
+            x2 += curr_x;
+            y2 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x06:    // 'Q' mnemonic: absolute quad_to.
+      case 0x07: {  // 'q' mnemonic: relative quad_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0x70) {
+            x1 += curr_x;
+            y1 += curr_y;
+            x2 += curr_x;
+            y2 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x08:    // 'S' mnemonic: absolute smooth cube_to.
+      case 0x09: {  // 's' mnemonic: relative smooth cube_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0x90) {
+            x2 += curr_x;
+            y2 += curr_y;
+            x3 += curr_x;
+            y3 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          iconvg_private_compiler__emit_f32(e, x3);
+          iconvg_private_compiler__emit_f32(e, y3);
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0A:    // 'C' mnemonic: absolute cube_to.
+      case 0x0B: {  // 'c' mnemonic: relative cube_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0xB0) {
+            x1 += curr_x;
+            y1 += curr_y;
+            x2 += curr_x;
+            y2 += curr_y;
+            x3 += curr_x;
+            y3 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          iconvg_private_compiler__emit_f32(e, x3);
+          iconvg_private_compiler__emit_f32(e, y3);
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0C:    // 'A' mnemonic: absolute arc_to.
+      case 0x0D: {  // 'a' mnemonic: relative arc_to.
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          float x0 = curr_x;
+          float y0 = curr_y;
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_zero_to_one_number(d, &x2) ||
+              !iconvg_private_decoder__decode_natural_number(d, &flags) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0xD0) {
+            curr_x += x3;
+            curr_y += y3;
+          } else {
+            curr_x = x3;
+            curr_y = y3;
+          }
+          double cubics[6 * ICONVG_PRIVATE_ARC_MAX_CUBICS];
+          bool is_line = false;
+          size_t n = iconvg_private_arc_to_cubics(
+              &cubics[0], &is_line, x0, y0, x1, y1, x2, flags & 0x01,
+              flags & 0x02, curr_x, curr_y);
+          if (is_line) {
+            iconvg_private_compiler__emit_op(
+                e, ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO, 1, 0, 0);
+            iconvg_private_compiler__emit_f32(e, curr_x);
+            iconvg_private_compiler__emit_f32(e, curr_y);
+          } else if (n > 0) {
+            iconvg_private_compiler__emit_op(
+                e, ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64, (uint32_t)n,
+                0, 0);
+            for (size_t i = 0; i < (6 * n); i++) {
+              iconvg_private_compiler__emit_f64(e, cubics[i]);
+            }
+          }
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+    }
+
+    switch (opcode) {
+      case 0xE1: {  // 'z' mnemonic: close_path.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING, 0, 0, 0);
+        iconvg_private_compiler__patch_u32(
+            e, e->skip_count_n - 4,
+            (uint32_t)((e->n - e->skip_count_n) / 4) - 6);
+        goto styling_mode;
+      }
+
+      case 0xE2:    // 'z; M' mnemonics: close_path; absolute move_to.
+      case 0xE3: {  // 'z; m' mnemonics: close_path; relative move_to.
+        if (opcode == 0xE3) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+            return iconvg_error_bad_coordinate;
+          }
+          curr_x += x1;
+          curr_y += y1;
+        } else if (!iconvg_private_decoder__decode_coordinate_number(
+                       d, &curr_x) ||
+                   !iconvg_private_decoder__decode_coordinate_number(
+                       d, &curr_y)) {
+          return iconvg_error_bad_coordinate;
+        }
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO, 0, 0, 0);
+        iconvg_private_compiler__emit_f32(e, curr_x);
+        iconvg_private_compiler__emit_f32(e, curr_y);
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE6:    // 'H' mnemonic: absolute horizontal line_to.
+      case 0xE7:    // 'h' mnemonic: relative horizontal line_to.
+      case 0xE8:    // 'V' mnemonic: absolute vertical line_to.
+      case 0xE9: {  // 'v' mnemonic: relative vertical line_to.
+        float* dst = (opcode < 0xE8) ? &curr_x : &curr_y;
+        float* rel = (opcode < 0xE8) ? &x1 : &y1;
+        if (opcode & 0x01) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, rel)) {
+            return iconvg_error_bad_coordinate;
+          }
+          *dst += *rel;
+        } else if (!iconvg_private_decoder__decode_coordinate_number(d, dst)) {
+          return iconvg_error_bad_coordinate;
+        }
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO, 1, 0, 0);
+        iconvg_private_compiler__emit_f32(e, curr_x);
+        iconvg_private_compiler__emit_f32(e, curr_y);
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+    }
+
+    return iconvg_error_bad_drawing_opcode;
+  }
+  return iconvg_private_internal_error_unreachable;
+}
+
+// iconvg_private_compiler__initialize sets up self to emit to dst_ptr[..
+// dst_len], which may be empty (e.g. when probing).
+static void  //
+iconvg_private_compiler__initialize(iconvg_private_compiler* self,
+                                    uint8_t* dst_ptr,
+                                    size_t dst_len,
+                                    iconvg_probe_results* probe) {
+  self->ptr = dst_ptr;
+  self->len = dst_ptr ? dst_len : 0;
+  self->n = 0;
+  self->skip_count_n = 0;
+  // CREG starts as a copy of the custom palette.
+  for (int i = 0; i < 64; i++) {
+    self->creg_deps[i] = ((uint64_t)1) << i;
+  }
+  memset(&self->creg_values, 0, sizeof(self->creg_values));
+  self->palette_mask = 0;
+  self->lod[0] = 0.0f;
+  self->lod[1] = INFINITY;
+  self->probe = probe;
+  self->probe_lod_segments = NULL;
+}
+
+const char*  //
+iconvg_compile(uint8_t* dst_ptr,
+               size_t dst_len,
+               size_t* dst_compiled_len,
+               const uint8_t* src_ptr,
+               size_t src_len) {
+  if (dst_compiled_len) {
+    *dst_compiled_len = 0;
+  }
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      &d, &viewbox, &suggested_palette));
+
+  iconvg_private_compiler e;
+  iconvg_private_compiler__initialize(&e, dst_ptr, dst_len, NULL);
+  iconvg_private_compiler__emit_u32(&e, ICONVG_PRIVATE_COMPILED_MAGIC);
+  iconvg_private_compiler__emit_f32(&e, viewbox.min_x);
+  iconvg_private_compiler__emit_f32(&e, viewbox.min_y);
+  iconvg_private_compiler__emit_f32(&e, viewbox.max_x);
+  iconvg_private_compiler__emit_f32(&e, viewbox.max_y);
+  for (int i = 0; i < 64; i++) {
+    iconvg_private_compiler__emit_u32(
+        &e, iconvg_private_peek_u32le(&suggested_palette.colors[i].rgba[0]));
+  }
+  iconvg_private_compiler__emit_u32(&e, 0);  // Patched below.
+  iconvg_private_compiler__emit_u32(&e, 0);  // Patched below.
+  ICONVG_PRIVATE_TRY(iconvg_private_compile_bytecode(&e, &d));
+  iconvg_private_compiler__patch_u32(&e, 4 * 69, (uint32_t)(e.palette_mask));
+  iconvg_private_compiler__patch_u32(&e, 4 * 70,
+                                     (uint32_t)(e.palette_mask >> 32));
+
+  if (dst_compiled_len) {
+    *dst_compiled_len = e.n;
+  }
+  if (e.n > e.len) {
+    return iconvg_error_system_failure_dst_buffer_too_short;
+  }
+  return NULL;
+}
+
+// ----
+
+static inline float  //
+iconvg_private_compiled_f32(const uint8_t* p, size_t i) {
+  return iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(p + (4 * i)));
+}
+
+// iconvg_private_compiled_f64 returns the i'th float64 (two words, low word
+// first) starting at p.
+static inline double  //
+iconvg_private_compiled_f64(const uint8_t* p, size_t i) {
+  uint64_t lo = iconvg_private_peek_u32le(p + (8 * i) + 0);
+  uint64_t hi = iconvg_private_peek_u32le(p + (8 * i) + 4);
+  return iconvg_private_reinterpret_from_u64_to_f64(lo | (hi << 32));
+}
+
+// iconvg_private_skip_compiled_drawing advances d past the rest of the
+// drawing whose BEGIN_DRAWING op's arguments are args.
+static const char*  //
+iconvg_private_skip_compiled_drawing(iconvg_private_decoder* d,
+                                     const uint8_t* args) {
+  size_t skip_count = iconvg_private_peek_u32le(args);
+  if ((skip_count == 0) || (skip_count > (d->len / 4)) ||
+      (iconvg_private_peek_u32le(d->ptr + (4 * (skip_count - 1))) !=
+       ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING)) {
+    return iconvg_error_bad_compiled_form;
+  }
+  d->ptr += 4 * skip_count;
+  d->len -= 4 * skip_count;
+  return NULL;
+}
+
+// iconvg_private_execute_compiled_template replays the compiled form to c.
+// If compositor is non-NULL then each drawing's geometry is skipped and its
+// paint is instead composited with the compositor's next coverage mask.
+//
+// Like iconvg_private_execute_bytecode_template, it is inlined into its
+// dispatcher once per value of specialized (see ICONVG_PRIVATE_SPECIALIZED).
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_execute_compiled_template(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 r,
+    iconvg_private_decoder* d,
+    const iconvg_decode_options* options,
+    iconvg_private_path_batch* batch,
+    iconvg_private_coverage_compositor* compositor,
+    bool specialized) {
+  if ((d->len < (4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS)) ||
+      ((d->len & 3) != 0) ||
+      (iconvg_private_peek_u32le(d->ptr) != ICONVG_PRIVATE_COMPILED_MAGIC)) {
+    return iconvg_error_bad_compiled_form;
+  }
+
+  iconvg_paint state;
+  state.viewbox.min_x = iconvg_private_compiled_f32(d->ptr, 1);
+  state.viewbox.min_y = iconvg_private_compiled_f32(d->ptr, 2);
+  state.viewbox.max_x = iconvg_private_compiled_f32(d->ptr, 3);
+  state.viewbox.max_y = iconvg_private_compiled_f32(d->ptr, 4);
+  memcpy(&state.custom_palette, d->ptr + (4 * 5),
+         sizeof(state.custom_palette));
+  d->ptr += 4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS;
+  d->len -= 4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS;
+
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, state.viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, &state.custom_palette));
+  iconvg_private_paint__initialize(&state, r, options);
+
+  bool drawing = false;
+
+  double scale_x = state.s2d_scale_x;
+  double bias_x = state.s2d_bias_x;
+  double scale_y = state.s2d_scale_y;
+  double bias_y = state.s2d_bias_y;
+
+  double lod[2];
+  lod[0] = 0.0;
+  lod[1] = INFINITY;
+
+  while (d->len > 0) {
+    uint32_t op = iconvg_private_peek_u32le(d->ptr);
+    uint32_t a = 0xFF & (op >> 8);
+    uint32_t b = 0xFF & (op >> 16);
+    uint32_t c3 = 0xFF & (op >> 24);
+    const uint8_t* args = d->ptr + 4;
+    size_t num_words = (d->len / 4) - 1;
+
+    size_t n = 0;
+    switch (op & 0xFF) {
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA:
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND:
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG:
+        n = 1;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD:
+      case ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO:
+        n = 2;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING:
+        n = 7;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO:
+        n = 2 * a;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO:
+        n = 4 * a;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO:
+        n = 6 * a;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64:
+        n = 12 * a;
+        break;
+    }
+    if (num_words < n) {
+      return iconvg_error_bad_compiled_form;
+    }
+    d->ptr += 4 * (1 + n);
+    d->len -= 4 * (1 + n);
+
+    switch (op & 0xFF) {
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA: {
+        memcpy(&state.creg.colors[a & 0x3F].rgba[0], args, 4);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_ONE_BYTE: {
+        iconvg_private_set_one_byte_color(&state.creg.colors[a & 0x3F].rgba[0],
+                                          &state.custom_palette, &state.creg,
+                                          (uint8_t)b);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND: {
+        uint8_t* rgba = &state.creg.colors[a & 0x3F].rgba[0];
+        uint8_t p[4] = {0};
+        uint8_t q[4] = {0};
+        iconvg_private_set_one_byte_color(&p[0], &state.custom_palette,
+                                          &state.creg, (uint8_t)b);
+        iconvg_private_set_one_byte_color(&q[0], &state.custom_palette,
+                                          &state.creg, (uint8_t)c3);
+        uint32_t q_blend = 0xFF & iconvg_private_peek_u32le(args);
+        uint32_t p_blend = 255 - q_blend;
+        rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+        rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+        rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+        rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG: {
+        state.nreg[a & 0x3F] = iconvg_private_compiled_f32(args, 0);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD: {
+        lod[0] = (double)iconvg_private_compiled_f32(args, 0);
+        lod[1] = (double)iconvg_private_compiled_f32(args, 1);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING: {
+        if (drawing) {
+          break;
+        } else if (iconvg_private_paint__is_cancelled(&state)) {
+          return iconvg_note_cancelled;
+        }
+        memcpy(&state.paint_rgba, &state.creg.colors[a & 0x3F],
+               sizeof(state.paint_rgba));
+        if (iconvg_paint__type(&state) == ICONVG_PAINT_TYPE__INVALID) {
+          return iconvg_error_invalid_paint_type;
+        }
+        double h = (double)state.height_in_pixels;
+        if (!((lod[0] <= h) && (h < lod[1]))) {
+          // Skip this drawing, which is outside the Level of Detail bounds.
+          ICONVG_PRIVATE_TRY(iconvg_private_skip_compiled_drawing(d, args));
+          continue;
+        }
+
+        // Cull this drawing if it would not change any pixels: it is outside
+        // of the clip rectangle or its paint is transparent for every
+        // palette. Like iconvg_decode, only cull by bounds when the options
+        // have a clip_rect, so that both make the same canvas calls. A
+        // recording (mask producing) canvas sees on_skipped_drawing
+        // and a compositor skips the corresponding mask, so that either side
+        // can cull what the other did not.
+        float bounds[4];
+        for (int i = 0; i < 4; i++) {
+          bounds[i] = iconvg_private_compiled_f32(args, 3 + i);
+        }
+        bool culled =
+            (state.has_clip &&
+             iconvg_private_paint__culls(&state, &bounds[0])) ||
+            ((b == 0) && iconvg_private_paint__is_transparent(&state));
+        if (compositor) {
+          ICONVG_PRIVATE_TRY(iconvg_private_coverage_compositor__composite(
+              compositor, culled ? NULL : &state));
+          ICONVG_PRIVATE_TRY(iconvg_private_skip_compiled_drawing(d, args));
+          continue;
+        } else if (culled) {
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__on_skipped_drawing(c));
+          ICONVG_PRIVATE_TRY(iconvg_private_skip_compiled_drawing(d, args));
+          continue;
+        }
+        drawing = true;
+        float x0 = iconvg_private_compiled_f32(args, 1);
+        float y0 = iconvg_private_compiled_f32(args, 2);
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_canvas__begin_drawing(c, specialized));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,           //
+            (x0 * scale_x) + bias_x,  //
+            (y0 * scale_y) + bias_y));
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO: {
+        if (!drawing) {
+          break;
+        }
+        float x0 = iconvg_private_compiled_f32(args, 0);
+        float y0 = iconvg_private_compiled_f32(args, 1);
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,           //
+            (x0 * scale_x) + bias_x,  //
+            (y0 * scale_y) + bias_y));
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 4 * 2) {
+          float x1 = iconvg_private_compiled_f32(args, 0);
+          float y1 = iconvg_private_compiled_f32(args, 1);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 4 * 4) {
+          float x1 = iconvg_private_compiled_f32(args, 0);
+          float y1 = iconvg_private_compiled_f32(args, 1);
+          float x2 = iconvg_private_compiled_f32(args, 2);
+          float y2 = iconvg_private_compiled_f32(args, 3);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 4 * 6) {
+          float x1 = iconvg_private_compiled_f32(args, 0);
+          float y1 = iconvg_private_compiled_f32(args, 1);
+          float x2 = iconvg_private_compiled_f32(args, 2);
+          float y2 = iconvg_private_compiled_f32(args, 3);
+          float x3 = iconvg_private_compiled_f32(args, 4);
+          float y3 = iconvg_private_compiled_f32(args, 5);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 8 * 6) {
+          double x1 = iconvg_private_compiled_f64(args, 0);
+          double y1 = iconvg_private_compiled_f64(args, 1);
+          double x2 = iconvg_private_compiled_f64(args, 2);
+          double y2 = iconvg_private_compiled_f64(args, 3);
+          double x3 = iconvg_private_compiled_f64(args, 4);
+          double y3 = iconvg_private_compiled_f64(args, 5);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING: {
+        if (!drawing) {
+          break;
+        }
+        drawing = false;
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_canvas__end_drawing(c, specialized, &state));
+        continue;
+      }
+    }
+
+    return iconvg_error_bad_compiled_form;
+  }
+
+  return drawing ? iconvg_error_bad_compiled_form : NULL;
+}
+
+static const char*  //
+iconvg_private_execute_compiled(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 r,
+    iconvg_private_decoder* d,
+    const iconvg_decode_options* options,
+    iconvg_private_path_batch* batch,
+    iconvg_private_coverage_compositor* compositor) {
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+  if (!compositor && iconvg_private_canvas_is_specialized(c)) {
+    return iconvg_private_execute_compiled_template(c, r, d, options, batch,
+                                                    NULL, true);
+  }
+#endif
+  return iconvg_private_execute_compiled_template(c, r, d, options, batch,
+                                                  compositor, false);
+}
+
+const char*  //
+iconvg_probe(iconvg_probe_results* dst,
+             const uint8_t* src_ptr,
+             size_t src_len,
+             bool scan_bytecode) {
+  if (!dst) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(dst, 0, sizeof(*dst));
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      &d, &dst->viewbox, &dst->suggested_palette));
+  dst->bytecode_offset = src_len - d.len;
+  if (!scan_bytecode) {
+    return NULL;
+  }
+
+  // Compiling to an empty buffer emits nothing but still walks every op.
+  iconvg_private_compiler e;
+  iconvg_private_compiler__initialize(&e, NULL, 0, dst);
+  return iconvg_private_compile_bytecode(&e, &d);
+}
+
+const char*  //
+iconvg_decode_compiled(iconvg_canvas* dst_canvas,
+                       iconvg_rectangle_f32 dst_rect,
+                       const uint8_t* compiled_ptr,
+                       size_t compiled_len,
+                       const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+
+  if (!iconvg_private_canvas_vtable_is_supported(dst_canvas)) {
+    return iconvg_error_unsupported_vtable;
+  }
+  iconvg_canvas transform_canvas;
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    transform_canvas =
+        iconvg_private_canvas__make_transform(dst_canvas, transform);
+    dst_canvas = &transform_canvas;
+  }
+
+  iconvg_private_decoder d;
+  d.ptr = compiled_ptr;
+  d.len = compiled_len;
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    iconvg_private_path_batch batch;
+    iconvg_private_path_batch__initialize(&batch, dst_canvas);
+    err_msg = iconvg_private_execute_compiled(dst_canvas, dst_rect, &d,
+                                              options, &batch, NULL);
+    const char* flush_err_msg =
+        iconvg_private_path_batch__flush(&batch, dst_canvas);
+    if (flush_err_msg) {
+      err_msg = flush_err_msg;
+    }
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg,
+                                           compiled_len - d.len, d.len);
+}
+
+const char*  //
+iconvg_private_decode_compiled_header(iconvg_palette* dst_suggested_palette,
+                                      uint64_t* dst_palette_mask,
+                                      const uint8_t* compiled_ptr,
+                                      size_t compiled_len) {
+  if (!compiled_ptr ||
+      (compiled_len < (4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS)) ||
+      ((compiled_len & 3) != 0) ||
+      (iconvg_private_peek_u32le(compiled_ptr) !=
+       ICONVG_PRIVATE_COMPILED_MAGIC)) {
+    return iconvg_error_bad_compiled_form;
+  }
+  if (dst_suggested_palette) {
+    memcpy(dst_suggested_palette, compiled_ptr + (4 * 5),
+           sizeof(*dst_suggested_palette));
+  }
+  if (dst_palette_mask) {
+    uint64_t lo = iconvg_private_peek_u32le(compiled_ptr + (4 * 69));
+    uint64_t hi = iconvg_private_peek_u32le(compiled_ptr + (4 * 70));
+    *dst_palette_mask = lo | (hi << 32);
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_compiled_palette_dependencies(uint64_t* dst_mask,
+                                     const uint8_t* compiled_ptr,
+                                     size_t compiled_len) {
+  if (dst_mask) {
+    *dst_mask = 0;
+  }
+  return iconvg_private_decode_compiled_header(NULL, dst_mask, compiled_ptr,
+                                               compiled_len);
+}
+
+const char*  //
+iconvg_coverage_masks__composite(const iconvg_coverage_masks* self,
+                                 uint8_t* pixels_ptr,
+                                 size_t pixels_stride,
+                                 uint32_t pixels_width,
+                                 uint32_t pixels_height,
+                                 iconvg_rectangle_f32 dst_rect,
+                                 const uint8_t* compiled_ptr,
+                                 size_t compiled_len,
+                                 const iconvg_decode_options* options) {
+  // With a transform, the masks were recorded by a rasterizer canvas wrapped
+  // in a transform canvas, which saw the transformed dst_rect's bounds.
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  iconvg_private_coverage_compositor compositor;
+  ICONVG_PRIVATE_TRY(iconvg_private_coverage_compositor__initialize(
+      &compositor, self, pixels_ptr, pixels_stride, pixels_width,
+      pixels_height,
+      transform ? iconvg_private_matrix_2x3_f64__transform_bounds(transform,
+                                                                  dst_rect)
+                : dst_rect));
+
+  // No geometry reaches the canvas, so a broken (no-op) one will do.
+  iconvg_canvas c = iconvg_canvas__make_broken(NULL);
+  iconvg_private_decoder d;
+  d.ptr = compiled_ptr;
+  d.len = compiled_len;
+  iconvg_private_path_batch batch;
+  iconvg_private_path_batch__initialize(&batch, &c);
+  ICONVG_PRIVATE_TRY(iconvg_private_execute_compiled(
+      &c, dst_rect, &d, options, &batch, &compositor));
+  return iconvg_private_coverage_compositor__finish(&compositor);
+}
+
+// -------------------------------- #include "./debug.c"
+
+static const char*  //
+iconvg_private_debug_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%sbegin_decode({%g, %g, %g, %g})\n",
+            ((const char*)(c->context.const_ptr3)), dst_rect.min_x,
+            dst_rect.min_y, dst_rect.max_x, dst_rect.max_y);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    const char* quote = err_msg ? "\"" : "";
+    fprintf(f, "%send_decode(%s%s%s, %zu, %zu)\n",
+            ((const char*)(c->context.const_ptr3)), quote,
+            err_msg ? err_msg : "NULL", quote, num_bytes_consumed,
+            num_bytes_remaining);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return err_msg;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__begin_drawing(iconvg_canvas* c) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%sbegin_drawing()\n", ((const char*)(c->context.const_ptr3)));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  static const char* spread_names[4] = {"none", "pad", "reflect", "repeat"};
+
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    switch (iconvg_paint__type(p)) {
+      case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+        iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+        fprintf(f, "%send_drawing(flat_color{%02X:%02X:%02X:%02X})\n",
+                ((const char*)(c->context.const_ptr3)), ((int)(k.rgba[0])),
+                ((int)(k.rgba[1])), ((int)(k.rgba[2])), ((int)(k.rgba[3])));
+        break;
+      }
+
+      case ICONVG_PAINT_TYPE__LINEAR_GRADIENT: {
+        fprintf(f,
+                "%send_drawing(linear_gradient{nstops=%d, spread=%s, ...})\n",
+                ((const char*)(c->context.const_ptr3)),
+                ((int)(iconvg_paint__gradient_number_of_stops(p))),
+                spread_names[iconvg_paint__gradient_spread(p)]);
+        break;
+      }
+
+      case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
+        fprintf(f,
+                "%send_drawing(radial_gradient{nstops=%d, spread=%s, ...})\n",
+                ((const char*)(c->context.const_ptr3)),
+                ((int)(iconvg_paint__gradient_number_of_stops(p))),
+                spread_names[iconvg_paint__gradient_spread(p)]);
+        break;
+      }
+
+      case ICONVG_PAINT_TYPE__INVALID:
+      default: {
+        return iconvg_error_invalid_paint_type;
+      }
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->end_drawing)(wrapped, p);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%sbegin_path(%g, %g)\n", ((const char*)(c->context.const_ptr3)),
+            x0, y0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__end_path(iconvg_canvas* c) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%send_path()\n", ((const char*)(c->context.const_ptr3)));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->end_path)(wrapped);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%spath_line_to(%g, %g)\n",
+            ((const char*)(c->context.const_ptr3)), x1, y1);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%spath_quad_to(%g, %g, %g, %g)\n",
+            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%spath_cube_to(%g, %g, %g, %g, %g, %g)\n",
+            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2, x3, y3);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%son_metadata_viewbox({%g, %g, %g, %g})\n",
+            ((const char*)(c->context.const_ptr3)), viewbox.min_x,
+            viewbox.min_y, viewbox.max_x, viewbox.max_y);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    int j = iconvg_private_last_color_that_isnt_opaque_black(suggested_palette);
+    if (j < 0) {
+      fprintf(f, "%son_metadata_suggested_palette(...)\n",
+              ((const char*)(c->context.const_ptr3)));
+    } else {
+      fprintf(f, "%son_metadata_suggested_palette(",
+              ((const char*)(c->context.const_ptr3)));
+      for (int i = 0; i <= j; i++) {
+        fprintf(f, "%02X:%02X:%02X:%02X%s",
+                ((int)(suggested_palette->colors[i].rgba[0])),
+                ((int)(suggested_palette->colors[i].rgba[1])),
+                ((int)(suggested_palette->colors[i].rgba[2])),
+                ((int)(suggested_palette->colors[i].rgba[3])),
+                (i < 63) ? ", " : ")\n");
+      }
+      if (j < 63) {
+        fprintf(f, "...)\n");
+      } else {
+        fprintf(f, ")\n");
+      }
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_segments(iconvg_canvas* c,
+                                           const uint8_t* verbs,
+                                           size_t num_verbs,
+                                           const float* points) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    // Log each segment the same way as the per-segment methods do, so that
+    // the log doesn't depend on whether the decoder batched its calls.
+    const char* prefix = (const char*)(c->context.const_ptr3);
+    const float* p = points;
+    for (size_t i = 0; i < num_verbs; i++) {
+      switch (verbs[i]) {
+        case ICONVG_PATH_VERB__LINE_TO:
+          fprintf(f, "%spath_line_to(%g, %g)\n", prefix, p[0], p[1]);
+          p += 2;
+          break;
+        case ICONVG_PATH_VERB__QUAD_TO:
+          fprintf(f, "%spath_quad_to(%g, %g, %g, %g)\n", prefix, p[0], p[1],
+                  p[2], p[3]);
+          p += 4;
+          break;
+        case ICONVG_PATH_VERB__CUBE_TO:
+          fprintf(f, "%spath_cube_to(%g, %g, %g, %g, %g, %g)\n", prefix, p[0],
+                  p[1], p[2], p[3], p[4], p[5]);
+          p += 6;
+          break;
+        default:
+          return iconvg_error_invalid_path_verb;
+      }
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return iconvg_private_canvas__path_segments(wrapped, verbs, num_verbs,
+                                              points);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%son_skipped_drawing()\n",
+            ((const char*)(c->context.const_ptr3)));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return iconvg_private_canvas__on_skipped_drawing(wrapped);
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_debug_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_debug_canvas__begin_decode,
+        &iconvg_private_debug_canvas__end_decode,
+        &iconvg_private_debug_canvas__begin_drawing,
+        &iconvg_private_debug_canvas__end_drawing,
+        &iconvg_private_debug_canvas__begin_path,
+        &iconvg_private_debug_canvas__end_path,
+        &iconvg_private_debug_canvas__path_line_to,
+        &iconvg_private_debug_canvas__path_quad_to,
+        &iconvg_private_debug_canvas__path_cube_to,
+        &iconvg_private_debug_canvas__on_metadata_viewbox,
+        &iconvg_private_debug_canvas__on_metadata_suggested_palette,
+        &iconvg_private_debug_canvas__path_segments,
+        &iconvg_private_debug_canvas__on_skipped_drawing,
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_debug(FILE* f,
+                          const char* message_prefix,
+                          iconvg_canvas* wrapped) {
+  if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_debug_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = f;
+  c.context.const_ptr3 = message_prefix ? message_prefix : "";
+  return c;
+}
+
+// -------------------------------- #include "./decoder.c"
+
+static void  //
+iconvg_private_decoder__advance_to_ptr(iconvg_private_decoder* self,
+                                       const uint8_t* new_ptr) {
+  if (new_ptr >= self->ptr) {
+    size_t delta = ((size_t)(new_ptr - self->ptr));
+    if (delta <= self->len) {
+      self->ptr += delta;
+      self->len -= delta;
+      return;
+    }
+  }
+  self->ptr = NULL;
+  self->len = 0;
+}
+
+static iconvg_private_decoder  //
+iconvg_private_decoder__limit_u32(iconvg_private_decoder* self,
+                                  uint32_t limit) {
+  iconvg_private_decoder d;
+  d.ptr = self->ptr;
+  d.len = (limit < self->len) ? limit : self->len;
+  return d;
+}
+
+static void  //
+iconvg_private_decoder__skip_to_the_end(iconvg_private_decoder* self) {
+  self->ptr += self->len;
+  self->len = 0;
+}
+
+// ----
+
+static bool  //
+iconvg_private_decoder__decode_magic_identifier(iconvg_private_decoder* self) {
+  if ((self->len < 4) ||         //
+      (self->ptr[0] != 0x89) ||  //
+      (self->ptr[1] != 0x49) ||  //
+      (self->ptr[2] != 0x56) ||  //
+      (self->ptr[3] != 0x47)) {
+    return false;
+  }
+  self->ptr += 4;
+  self->len -= 4;
+  return true;
+}
+
+static bool  //
+iconvg_private_decoder__decode_metadata_viewbox(iconvg_private_decoder* self,
+                                                iconvg_rectangle_f32* dst) {
+  return iconvg_private_decoder__decode_coordinate_number(self, &dst->min_x) &&
+         iconvg_private_decoder__decode_coordinate_number(self, &dst->min_y) &&
+         iconvg_private_decoder__decode_coordinate_number(self, &dst->max_x) &&
+         iconvg_private_decoder__decode_coordinate_number(self, &dst->max_y) &&
+         (-INFINITY < dst->min_x) &&    //
+         (dst->min_x <= dst->max_x) &&  //
+         (dst->max_x < +INFINITY) &&    //
+         (-INFINITY < dst->min_y) &&    //
+         (dst->min_y <= dst->max_y) &&  //
+         (dst->max_y < +INFINITY);
+}
+
+static bool  //
+iconvg_private_decoder__decode_metadata_suggested_palette(
+    iconvg_private_decoder* self,
+    iconvg_palette* dst) {
+  if (self->len == 0) {
+    return false;
+  }
+  uint8_t spec = self->ptr[0];
+  self->ptr += 1;
+  self->len -= 1;
+
+  size_t n = 1 + (spec & 0x3F);
+  size_t bytes_per_elem = 1 + (spec >> 6);
+  if (self->len != (n * bytes_per_elem)) {
+    return false;
+  }
+  const uint8_t* p = self->ptr;
+  self->ptr += self->len;
+  self->len = 0;
+
+  iconvg_premul_color* c = &dst->colors[0];
+  switch (bytes_per_elem) {
+    case 1:
+      for (; n > 0; n--) {
+        uint8_t u = *p++;
+        uint32_t rgba =
+            (u < 0x80) ? iconvg_private_peek_u32le(
+                             &iconvg_private_one_byte_colors[4 * ((size_t)u)])
+                       : 0xFF000000u;
+        iconvg_private_poke_u32le(&c->rgba[0], rgba);
+        c++;
+      }
+      break;
+
+    case 2:
+      for (; n > 0; n--) {
+        uint8_t rg = *p++;
+        c->rgba[0] = 0x11 * (rg >> 4);
+        c->rgba[1] = 0x11 * (rg & 0x0F);
+        uint8_t ba = *p++;
+        c->rgba[2] = 0x11 * (ba >> 4);
+        c->rgba[3] = 0x11 * (ba & 0x0F);
+        c++;
+      }
+      break;
+
+    case 3:
+      for (; n > 0; n--) {
+        c->rgba[0] = *p++;
+        c->rgba[1] = *p++;
+        c->rgba[2] = *p++;
+        c->rgba[3] = 0xFF;
+        c++;
+      }
+      break;
+
+    case 4:
+      for (; n > 0; n--) {
+        c->rgba[0] = *p++;
+        c->rgba[1] = *p++;
+        c->rgba[2] = *p++;
+        c->rgba[3] = *p++;
+        c++;
+      }
+      break;
+  }
+  return true;
+}
+
+// ----
+
+// iconvg_private_decoder__skip_numbers skips over n numbers. All of the IconVG
+// number encodings (natural, real, coordinate and zero-to-one) use the low two
+// bits of the first byte to give the encoded length, so skipping does not
+// depend on what kind of number is skipped.
+//
+// Like iconvg_private_decoder__decode_coordinate_numbers, when self holds at
+// least 4 * n bytes the bounds are checked once, up front. Each length is then
+// computed without branches or a table load, as the loop is one long chain of
+// dependent loads: 1, 2, 1 or 4 bytes when the low 2 bits are 0, 1, 2 or 3.
+static inline bool  //
+iconvg_private_decoder__skip_numbers(iconvg_private_decoder* self, int n) {
+  if ((self->len / 4) >= (size_t)n) {
+    const uint8_t* p = self->ptr;
+    for (; n > 0; n--) {
+      uint8_t v = p[0];
+      if ((v & 0x01) == 0) {
+        p += 1;
+      } else if ((v & 0x02) == 0) {
+        p += 2;
+      } else {
+        p += 4;
+      }
+    }
+    self->len -= (size_t)(p - self->ptr);
+    self->ptr = p;
+    return true;
+  }
+
+  for (; n > 0; n--) {
+    if (self->len < 1) {
+      return false;
+    }
+    uint8_t v = self->ptr[0];
+    size_t num_bytes = ((v & 0x01) == 0) ? 1 : ((v & 0x02) == 0) ? 2 : 4;
+    if (self->len < num_bytes) {
+      return false;
+    }
+    self->ptr += num_bytes;
+    self->len -= num_bytes;
+  }
+  return true;
+}
+
+// iconvg_private_drawing_numbers_per_rep is the number of numbers per
+// repetition, indexed by the high nibble of a 0x00 ..= 0xDF drawing opcode.
+static const uint8_t iconvg_private_drawing_numbers_per_rep[14] = {
+    2, 2, 2, 2,  // 'L', 'l'.
+    2, 2,        // 'T', 't'.
+    4, 4,        // 'Q', 'q'.
+    4, 4,        // 'S', 's'.
+    6, 6,        // 'C', 'c'.
+    6, 6,        // 'A', 'a'.
+};
+
+// iconvg_private_decoder__skip_drawing skips over the drawing mode opcodes up
+// to and including the next 'z' (close_path) opcode, without decoding their
+// numbers' values. It returns the same errors (and leaves self at the same
+// position on error) as iconvg_private_execute_bytecode would for a drawing
+// that is painted to a no-op canvas.
+static const char*  //
+iconvg_private_decoder__skip_drawing(iconvg_private_decoder* self) {
+  while (true) {
+    if (self->len == 0) {
+      return iconvg_error_bad_path_unfinished;
+    }
+    uint8_t opcode = self->ptr[0];
+    self->ptr += 1;
+    self->len -= 1;
+
+    int n = 0;
+    if (opcode < 0x40) {
+      n = 2 * (1 + (opcode & 0x1F));
+    } else if (opcode < 0xE0) {
+      n = iconvg_private_drawing_numbers_per_rep[opcode >> 4] *
+          (1 + (opcode & 0x0F));
+    } else if (opcode == 0xE1) {
+      return NULL;
+    } else if ((opcode == 0xE2) || (opcode == 0xE3)) {
+      n = 2;
+    } else if ((0xE6 <= opcode) && (opcode <= 0xE9)) {
+      n = 1;
+    } else {
+      return iconvg_error_bad_drawing_opcode;
+    }
+
+    if (!iconvg_private_decoder__skip_numbers(self, n)) {
+      return iconvg_error_bad_coordinate;
+    }
+  }
+}
+
+static inline void  //
+iconvg_private_bounds__extend(float* b, float x, float y) {
+  b[0] = (b[0] < x) ? b[0] : x;
+  b[1] = (b[1] < y) ? b[1] : y;
+  b[2] = (b[2] > x) ? b[2] : x;
+  b[3] = (b[3] > y) ? b[3] : y;
+}
+
+bool  //
+iconvg_private_decoder__drawing_bounds(const iconvg_private_decoder* self,
+                                       float* dst,
+                                       float x0,
+                                       float y0) {
+  iconvg_private_decoder d = *self;
+  float b[4] = {x0, y0, x0, y0};
+  float curr_x = x0;
+  float curr_y = y0;
+  // (x1, y1) is the implicit control point of a subsequent smooth op, as
+  // tracked by iconvg_private_execute_bytecode.
+  float x1 = x0;
+  float y1 = y0;
+  float coords[96];
+
+  while (true) {
+    if (d.len == 0) {
+      return false;
+    }
+    uint8_t opcode = d.ptr[0];
+    d.ptr += 1;
+    d.len -= 1;
+
+    if (opcode < 0xC0) {  // 'L', 'l', 'T', 't', 'Q', 'q', 'S', 's', 'C', 'c'.
+      size_t num_reps = (opcode < 0x40) ? (1 + (size_t)(opcode & 0x1F))
+                                        : (1 + (size_t)(opcode & 0x0F));
+      size_t num_coords =
+          iconvg_private_drawing_numbers_per_rep[opcode >> 4] * num_reps;
+      size_t num_points = num_coords / num_reps / 2;
+      bool relative = (opcode < 0x40) ? (opcode & 0x20) : (opcode & 0x10);
+      bool smooth = ((opcode >> 5) == 2) || ((opcode >> 5) == 4);
+      if (iconvg_private_decoder__decode_coordinate_numbers(
+              &d, &coords[0], num_coords) < num_coords) {
+        return false;
+      }
+      float* p = &coords[0];
+      for (size_t i = 0; i < num_reps; i++, p += 2 * num_points) {
+        if (relative) {
+          for (size_t j = 0; j < num_points; j++) {
+            p[(2 * j) + 0] += curr_x;
+            p[(2 * j) + 1] += curr_y;
+          }
+        }
+        if (smooth) {
+          iconvg_private_bounds__extend(b, x1, y1);
+        }
+        for (size_t j = 0; j < num_points; j++) {
+          iconvg_private_bounds__extend(b, p[(2 * j) + 0], p[(2 * j) + 1]);
+        }
+        curr_x = p[(2 * num_points) - 2];
+        curr_y = p[(2 * num_points) - 1];
+        if (opcode < 0x40) {
+          x1 = curr_x;
+          y1 = curr_y;
+        } else if (num_points == 1) {
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        } else {
+          x1 = (2 * curr_x) - p[(2 * num_points) - 4];
+          y1 = (2 * curr_y) - p[(2 * num_points) - 3];
+        }
+      }
+      continue;
+
+    } else if (opcode < 0xE0) {  // 'A', 'a'.
+      for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+        float rx;
+        float ry;
+        float rotation;
+        uint32_t flags;
+        float x;
+        float y;
+        if (!iconvg_private_decoder__decode_coordinate_number(&d, &rx) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &ry) ||
+            !iconvg_private_decoder__decode_zero_to_one_number(&d, &rotation) ||
+            !iconvg_private_decoder__decode_natural_number(&d, &flags) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &x) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &y)) {
+          return false;
+        }
+        if (opcode >= 0xD0) {
+          x += curr_x;
+          y += curr_y;
+        }
+        double cubics[6 * ICONVG_PRIVATE_ARC_MAX_CUBICS];
+        bool is_line = false;
+        size_t n = iconvg_private_arc_to_cubics(&cubics[0], &is_line, curr_x,
+                                                curr_y, rx, ry, rotation,
+                                                flags & 0x01, flags & 0x02, x,
+                                                y);
+        for (size_t i = 0; i < (6 * n); i += 2) {
+          iconvg_private_bounds__extend(b, (float)cubics[i + 0],
+                                        (float)cubics[i + 1]);
+        }
+        iconvg_private_bounds__extend(b, x, y);
+        curr_x = x;
+        curr_y = y;
+        x1 = curr_x;
+        y1 = curr_y;
+      }
+      continue;
+    }
+
+    float* dst_coord = NULL;
+    bool relative = false;
+    switch (opcode) {
+      case 0xE1:  // 'z' mnemonic: close_path.
+        memcpy(dst, &b[0], sizeof(b));
+        return true;
+      case 0xE2:  // 'z; M' mnemonics: close_path; absolute move_to.
+      case 0xE3:  // 'z; m' mnemonics: close_path; relative move_to.
+        if (!iconvg_private_decoder__decode_coordinate_number(&d, &x1) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &y1)) {
+          return false;
+        }
+        curr_x = (opcode == 0xE3) ? (curr_x + x1) : x1;
+        curr_y = (opcode == 0xE3) ? (curr_y + y1) : y1;
+        iconvg_private_bounds__extend(b, curr_x, curr_y);
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      case 0xE6:  // 'H' mnemonic: absolute horizontal line_to.
+      case 0xE7:  // 'h' mnemonic: relative horizontal line_to.
+        dst_coord = &curr_x;
+        relative = opcode == 0xE7;
+        break;
+      case 0xE8:  // 'V' mnemonic: absolute vertical line_to.
+      case 0xE9:  // 'v' mnemonic: relative vertical line_to.
+        dst_coord = &curr_y;
+        relative = opcode == 0xE9;
+        break;
+      default:
+        return false;
+    }
+    float v;
+    if (!iconvg_private_decoder__decode_coordinate_number(&d, &v)) {
+      return false;
+    }
+    *dst_coord = relative ? (*dst_coord + v) : v;
+    iconvg_private_bounds__extend(b, curr_x, curr_y);
+    x1 = curr_x;
+    y1 = curr_y;
+  }
+}
+
+// iconvg_private_decoder__complete_ops_len returns the length of the longest
+// prefix of self's bytes that holds only complete ops (opcodes and all of
+// their arguments), starting in the drawing mode if drawing is true. Invalid
+// opcodes count as complete, one byte ops: executing them fails no matter
+// what bytes follow.
+static size_t  //
+iconvg_private_decoder__complete_ops_len(const iconvg_private_decoder* self,
+                                         bool drawing) {
+  // color_lens is the number of bytes after a 0x80 ..= 0xA7 styling opcode,
+  // indexed by ((opcode - 0x80) >> 3).
+  static const uint8_t color_lens[5] = {1, 2, 3, 4, 3};
+
+  iconvg_private_decoder d = *self;
+  const uint8_t* end_of_complete_ops = d.ptr;
+  while (d.len > 0) {
+    uint8_t opcode = d.ptr[0];
+    d.ptr += 1;
+    d.len -= 1;
+
+    size_t num_bytes = 0;
+    int num_numbers = 0;
+    if (!drawing) {
+      if (opcode < 0x80) {
+        // No-op.
+      } else if (opcode < 0xA8) {
+        num_bytes = color_lens[(opcode - 0x80) >> 3];
+      } else if (opcode < 0xC0) {
+        num_numbers = 1;
+      } else if (opcode < 0xC7) {
+        num_numbers = 2;
+        drawing = true;
+      } else if (opcode == 0xC7) {
+        num_numbers = 2;
+      }
+    } else if (opcode < 0x40) {
+      num_numbers = 2 * (1 + (opcode & 0x1F));
+    } else if (opcode < 0xE0) {
+      num_numbers = iconvg_private_drawing_numbers_per_rep[opcode >> 4] *
+                    (1 + (opcode & 0x0F));
+    } else if (opcode == 0xE1) {
+      drawing = false;
+    } else if ((opcode == 0xE2) || (opcode == 0xE3)) {
+      num_numbers = 2;
+    } else if ((0xE6 <= opcode) && (opcode <= 0xE9)) {
+      num_numbers = 1;
+    }
+
+    if (d.len < num_bytes) {
+      break;
+    }
+    d.ptr += num_bytes;
+    d.len -= num_bytes;
+    if (!iconvg_private_decoder__skip_numbers(&d, num_numbers)) {
+      break;
+    }
+    end_of_complete_ops = d.ptr;
+  }
+  return (size_t)(end_of_complete_ops - self->ptr);
+}
+
+// iconvg_private_decoder__complete_metadata_len returns the length of the
+// magic identifier and metadata at the start of self's bytes, or zero if they
+// are incomplete. If the available bytes are already invalid, it returns
+// self->len, so that decoding them reports the error.
+static size_t  //
+iconvg_private_decoder__complete_metadata_len(
+    const iconvg_private_decoder* self) {
+  static const uint8_t magic[4] = {0x89, 0x49, 0x56, 0x47};
+  size_t n = (self->len < 4) ? self->len : 4;
+  if (n == 0) {
+    return 0;
+  } else if (memcmp(self->ptr, magic, n) != 0) {
+    return self->len;
+  } else if (n < 4) {
+    return 0;
+  }
+
+  iconvg_private_decoder d = *self;
+  d.ptr += 4;
+  d.len -= 4;
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                     &num_metadata_chunks)) {
+    return 0;
+  }
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
+        (chunk_length > d.len)) {
+      return 0;
+    }
+    d.ptr += chunk_length;
+    d.len -= chunk_length;
+  }
+  return (size_t)(d.ptr - self->ptr);
+}
+
+// ----
+
+void  //
+iconvg_private_bytecode_registers__initialize(
+    iconvg_private_bytecode_registers* self) {
+  self->mode = ICONVG_PRIVATE_BYTECODE_MODE__STYLING;
+  self->sel[0] = 0;
+  self->sel[1] = 0;
+  self->lod[0] = 0.0;
+  self->lod[1] = INFINITY;
+  self->curr_x = +0.0f;
+  self->curr_y = +0.0f;
+  self->x1 = +0.0f;
+  self->y1 = +0.0f;
+}
+
+// iconvg_private_one_byte_color_palette_dep returns 1 if the one byte color u
+// derives from the custom palette and 0 otherwise.
+static inline uint64_t  //
+iconvg_private_one_byte_color_palette_dep(const iconvg_paint* state,
+                                          uint8_t u) {
+  if (u < 0x80) {
+    return 0;
+  } else if (u < 0xC0) {
+    return 1;
+  }
+  return 1 & (state->creg_palette_deps >> (u & 0x3F));
+}
+
+static inline void  //
+iconvg_private_paint__set_creg_palette_dep(iconvg_paint* self,
+                                           uint32_t creg_index,
+                                           uint64_t dep) {
+  self->creg_palette_deps =
+      (self->creg_palette_deps & ~(((uint64_t)1) << creg_index)) |
+      (dep << creg_index);
+}
+
+// iconvg_private_paint__is_always_transparent returns whether self's paint,
+// copied from CREG[creg_index], is transparent whatever the custom palette.
+static bool  //
+iconvg_private_paint__is_always_transparent(const iconvg_paint* self,
+                                            uint32_t creg_index) {
+  uint64_t deps = self->creg_palette_deps;
+  if ((self->paint_rgba[3] != 0x00) || (1 & (deps >> creg_index)) ||
+      !iconvg_private_paint__is_transparent(self)) {
+    return false;
+  } else if (iconvg_paint__type(self) == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    return true;
+  }
+  uint32_t cbase = self->paint_rgba[1];
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(self);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    if (1 & (deps >> (0x3F & (cbase + i)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// iconvg_private_execute_bytecode_template executes the ops in d, starting
+// from (and, when it returns NULL, updating) the regs state.
+//
+// If final is true then d holds the rest of the IconVG data, so running out
+// of ops in the middle of a drawing is an error. Otherwise, d must end at an
+// op boundary and running out of ops is a suspension (returning NULL), to be
+// resumed by another call with the same regs.
+//
+// It is inlined into iconvg_private_execute_bytecode, below, once per value
+// of specialized (see ICONVG_PRIVATE_SPECIALIZED).
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_execute_bytecode_template(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 r,
+    iconvg_private_decoder* d,
+    iconvg_paint* state,
+    iconvg_private_path_batch* batch,
+    iconvg_private_bytecode_registers* regs,
+    bool final,
+    bool specialized) {
+  // adjustments are the ADJ values from the IconVG spec.
+  static const uint32_t adjustments[8] = {0, 1, 2, 3, 4, 5, 6, 0};
+
+  // Drawing ops will typically set curr_x and curr_y. They also set x1 and y1
+  // in case the subsequent op is smooth and needs an implicit point.
+  //
+  // The registers are copied to and from regs only on entry and suspension,
+  // so that the compiler can keep them in local variables.
+  float curr_x = regs->curr_x;
+  float curr_y = regs->curr_y;
+  float x1 = regs->x1;
+  float y1 = regs->y1;
+  float x2 = +0.0f;
+  float y2 = +0.0f;
+  float x3 = +0.0f;
+  float y3 = +0.0f;
+  uint32_t flags = 0;
+  const char* skip_err_msg = NULL;
+
+  // coords holds one drawing op's coordinate numbers, decoded in bulk. The
+  // most that an op can have is 16 cube_to segments of 6 coordinates each.
+  float coords[96];
+
+  double scale_x = state->s2d_scale_x;
+  double bias_x = state->s2d_bias_x;
+  double scale_y = state->s2d_scale_y;
+  double bias_y = state->s2d_bias_y;
+
+  // sel[0] and sel[1] are the CSEL and NSEL registers.
+  uint32_t sel[2];
+  sel[0] = regs->sel[0];
+  sel[1] = regs->sel[1];
+  double lod[2];
+  lod[0] = regs->lod[0];
+  lod[1] = regs->lod[1];
+
+  if (regs->mode == ICONVG_PRIVATE_BYTECODE_MODE__DRAWING) {
+    goto drawing_mode;
+  } else if (regs->mode == ICONVG_PRIVATE_BYTECODE_MODE__SKIPPING) {
+    goto skipping_mode;
+  }
+
+styling_mode:
+  while (true) {
+    if (d->len == 0) {
+      regs->mode = ICONVG_PRIVATE_BYTECODE_MODE__STYLING;
+      goto suspend;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    if (opcode < 0x80) {
+      sel[opcode >> 6] = opcode & 0x3F;
+      continue;
+
+    } else if (opcode < 0x88) {  // Set CREG[etc]; 1 byte color.
+      if (d->len < 1) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
+      iconvg_private_set_one_byte_color(rgba, &state->custom_palette,
+                                        &state->creg, d->ptr[0]);
+      iconvg_private_paint__set_creg_palette_dep(
+          state, creg_index,
+          iconvg_private_one_byte_color_palette_dep(state, d->ptr[0]));
+      d->ptr += 1;
+      d->len -= 1;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0x90) {  // Set CREG[etc]; 2 byte color.
+      if (d->len < 2) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
+      rgba[0] = 0x11 * (d->ptr[0] >> 4);
+      rgba[1] = 0x11 * (d->ptr[0] & 0x0F);
+      rgba[2] = 0x11 * (d->ptr[1] >> 4);
+      rgba[3] = 0x11 * (d->ptr[1] & 0x0F);
+      iconvg_private_paint__set_creg_palette_dep(state, creg_index, 0);
+      d->ptr += 2;
+      d->len -= 2;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0x98) {  // Set CREG[etc]; 3 byte (direct) color.
+      if (d->len < 3) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
+      rgba[0] = d->ptr[0];
+      rgba[1] = d->ptr[1];
+      rgba[2] = d->ptr[2];
+      rgba[3] = 0xFF;
+      iconvg_private_paint__set_creg_palette_dep(state, creg_index, 0);
+      d->ptr += 3;
+      d->len -= 3;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xA0) {  // Set CREG[etc]; 4 byte color.
+      if (d->len < 4) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
+      rgba[0] = d->ptr[0];
+      rgba[1] = d->ptr[1];
+      rgba[2] = d->ptr[2];
+      rgba[3] = d->ptr[3];
+      iconvg_private_paint__set_creg_palette_dep(state, creg_index, 0);
+      d->ptr += 4;
+      d->len -= 4;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xA8) {  // Set CREG[etc]; 3 byte (indirect) color.
+      if (d->len < 3) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
+      uint8_t p[4] = {0};
+      uint8_t q[4] = {0};
+      iconvg_private_set_one_byte_color(&p[0], &state->custom_palette,
+                                        &state->creg, d->ptr[1]);
+      iconvg_private_set_one_byte_color(&q[0], &state->custom_palette,
+                                        &state->creg, d->ptr[2]);
+      uint32_t q_blend = d->ptr[0];
+      uint32_t p_blend = 255 - q_blend;
+      rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+      rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+      rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+      rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+      iconvg_private_paint__set_creg_palette_dep(
+          state, creg_index,
+          iconvg_private_one_byte_color_palette_dep(state, d->ptr[1]) |
+              iconvg_private_one_byte_color_palette_dep(state, d->ptr[2]));
+      d->ptr += 3;
+      d->len -= 3;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xB0) {  // Set NREG[etc]; real number.
+      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
+      float* num = &state->nreg[nreg_index];
+      if (!iconvg_private_decoder__decode_real_number(d, num)) {
+        return iconvg_error_bad_number;
+      }
+      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xB8) {  // Set NREG[etc]; coordinate number.
+      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
+      float* num = &state->nreg[nreg_index];
+      if (!iconvg_private_decoder__decode_coordinate_number(d, num)) {
+        return iconvg_error_bad_coordinate;
+      }
+      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xC0) {  // Set NREG[etc]; zero-to-one number.
+      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
+      float* num = &state->nreg[nreg_index];
+      if (!iconvg_private_decoder__decode_zero_to_one_number(d, num)) {
+        return iconvg_error_bad_number;
+      }
+      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xC7) {  // Switch to the drawing mode.
+      if (iconvg_private_paint__is_cancelled(state)) {
+        return iconvg_note_cancelled;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      memcpy(&state->paint_rgba, &state->creg.colors[creg_index],
+             sizeof(state->paint_rgba));
+      if (iconvg_paint__type(state) == ICONVG_PAINT_TYPE__INVALID) {
+        return iconvg_error_invalid_paint_type;
+      }
+      if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+          !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+        return iconvg_error_bad_coordinate;
+      }
+      double h = (double)state->height_in_pixels;
+      if (!((lod[0] <= h) && (h < lod[1]))) {
+        // Skip this drawing, which is outside the Level of Detail bounds.
+        goto skipping_mode;
+      } else if (iconvg_private_paint__is_always_transparent(state,
+                                                             creg_index)) {
+        // Skip this drawing, which would not change any pixels.
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__on_skipped_drawing(c));
+        goto skipping_mode;
+      } else if (state->has_clip) {
+        float bounds[4];
+        if (iconvg_private_decoder__drawing_bounds(d, &bounds[0], curr_x,
+                                                   curr_y) &&
+            iconvg_private_paint__culls(state, &bounds[0])) {
+          // Skip this drawing, which is outside the clip rectangle.
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__on_skipped_drawing(c));
+          goto skipping_mode;
+        }
+      }
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_drawing(c, specialized));
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+          c, specialized,               //
+          (curr_x * scale_x) + bias_x,  //
+          (curr_y * scale_y) + bias_y));
+      x1 = curr_x;
+      y1 = curr_y;
+      goto drawing_mode;
+
+    } else if (opcode < 0xC8) {  // Set Level of Detail bounds.
+      float lod0;
+      float lod1;
+      if (!iconvg_private_decoder__decode_real_number(d, &lod0) ||
+          !iconvg_private_decoder__decode_real_number(d, &lod1)) {
+        return iconvg_error_bad_number;
+      }
+      lod[0] = (double)lod0;
+      lod[1] = (double)lod1;
+      continue;
+    }
+
+    return iconvg_error_bad_styling_opcode;
+  }
+
+drawing_mode:
+  while (true) {
+    if (d->len == 0) {
+      if (final) {
+        return iconvg_error_bad_path_unfinished;
+      }
+      regs->mode = ICONVG_PRIVATE_BYTECODE_MODE__DRAWING;
+      goto suspend;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    switch (opcode >> 4) {
+      case 0x00:
+      case 0x01: {  // 'L' mnemonic: absolute line_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x1F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x1F; reps >= 0; reps--) {
+          if (q) {
+            curr_x = q[0];
+            curr_y = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+              batch, c, specialized,        //
+              (curr_x * scale_x) + bias_x,  //
+              (curr_y * scale_y) + bias_y));
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+
+      case 0x02:
+      case 0x03: {  // 'l' mnemonic: relative line_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x1F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x1F; reps >= 0; reps--) {
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+            return iconvg_error_bad_coordinate;
+          }
+          curr_x += x1;
+          curr_y += y1;
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+              batch, c, specialized,        //
+              (curr_x * scale_x) + bias_x,  //
+              (curr_y * scale_y) + bias_y));
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+
+      case 0x04: {  // 'T' mnemonic: absolute smooth quad_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x05: {  // 't' mnemonic: relative smooth quad_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          x2 += curr_x;
+          y2 += curr_y;
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x06: {  // 'Q' mnemonic: absolute quad_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x07: {  // 'q' mnemonic: relative quad_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          x1 += curr_x;
+          y1 += curr_y;
+          x2 += curr_x;
+          y2 += curr_y;
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x08: {  // 'S' mnemonic: absolute smooth cube_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            x3 = q[2];
+            y3 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x09: {  // 's' mnemonic: relative smooth cube_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            x3 = q[2];
+            y3 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          x2 += curr_x;
+          y2 += curr_y;
+          x3 += curr_x;
+          y3 += curr_y;
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0A: {  // 'C' mnemonic: absolute cube_to.
+        size_t num_coords = 6 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            x3 = q[4];
+            y3 = q[5];
+            q += 6;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0B: {  // 'c' mnemonic: relative cube_to.
+        size_t num_coords = 6 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            x3 = q[4];
+            y3 = q[5];
+            q += 6;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          x1 += curr_x;
+          y1 += curr_y;
+          x2 += curr_x;
+          y2 += curr_y;
+          x3 += curr_x;
+          y3 += curr_y;
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0C: {  // 'A' mnemonic: absolute arc_to.
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          float x0 = curr_x;
+          float y0 = curr_y;
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_zero_to_one_number(d, &x2) ||
+              !iconvg_private_decoder__decode_natural_number(d, &flags) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_path_arc_to(
+              batch, c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
+              flags & 0x01, flags & 0x02, curr_x, curr_y));
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+
+      case 0x0D: {  // 'a' mnemonic: relative arc_to.
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          float x0 = curr_x;
+          float y0 = curr_y;
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_zero_to_one_number(d, &x2) ||
+              !iconvg_private_decoder__decode_natural_number(d, &flags) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          curr_x += x3;
+          curr_y += y3;
+          ICONVG_PRIVATE_TRY(iconvg_private_path_arc_to(
+              batch, c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
+              flags & 0x01, flags & 0x02, curr_x, curr_y));
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+    }
+
+    switch (opcode) {
+      case 0xE1: {  // 'z' mnemonic: close_path.
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_canvas__end_drawing(c, specialized, state));
+        goto styling_mode;
+      }
+
+      case 0xE2: {  // 'z; M' mnemonics: close_path; absolute move_to.
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+            !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+          return iconvg_error_bad_coordinate;
+        }
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,               //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE3: {  // 'z; m' mnemonics: close_path; relative move_to.
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+            !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+          return iconvg_error_bad_coordinate;
+        }
+        curr_x += x1;
+        curr_y += y1;
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,               //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE6: {  // 'H' mnemonic: absolute horizontal line_to.
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x)) {
+          return iconvg_error_bad_coordinate;
+        }
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE7: {  // 'h' mnemonic: relative horizontal line_to.
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &x1)) {
+          return iconvg_error_bad_coordinate;
+        }
+        curr_x += x1;
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE8: {  // 'V' mnemonic: absolute vertical line_to.
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+          return iconvg_error_bad_coordinate;
+        }
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE9: {  // 'v' mnemonic: relative vertical line_to.
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+          return iconvg_error_bad_coordinate;
+        }
+        curr_y += y1;
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+    }
+
+    return iconvg_error_bad_drawing_opcode;
+  }
+  return iconvg_private_internal_error_unreachable;
+
+skipping_mode:
+  skip_err_msg = iconvg_private_decoder__skip_drawing(d);
+  if ((skip_err_msg == iconvg_error_bad_path_unfinished) && !final) {
+    regs->mode = ICONVG_PRIVATE_BYTECODE_MODE__SKIPPING;
+    goto suspend;
+  }
+  ICONVG_PRIVATE_TRY(skip_err_msg);
+  goto styling_mode;
+
+suspend:
+  regs->sel[0] = sel[0];
+  regs->sel[1] = sel[1];
+  regs->lod[0] = lod[0];
+  regs->lod[1] = lod[1];
+  regs->curr_x = curr_x;
+  regs->curr_y = curr_y;
+  regs->x1 = x1;
+  regs->y1 = y1;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_execute_bytecode(iconvg_canvas* c,
+                                iconvg_rectangle_f32 r,
+                                iconvg_private_decoder* d,
+                                iconvg_paint* state,
+                                iconvg_private_path_batch* batch,
+                                iconvg_private_bytecode_registers* regs,
+                                bool final) {
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+  if (iconvg_private_canvas_is_specialized(c)) {
+    return iconvg_private_execute_bytecode_template(c, r, d, state, batch,
+                                                    regs, final, true);
+  }
+#endif
+  return iconvg_private_execute_bytecode_template(c, r, d, state, batch, regs,
+                                                  final, false);
+}
+
+// ----
+
+const char*  //
+iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
+                      const uint8_t* src_ptr,
+                      size_t src_len) {
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  iconvg_rectangle_f32 viewbox;
+  ICONVG_PRIVATE_TRY(
+      iconvg_private_decoder__decode_metadata(&d, &viewbox, NULL));
+  if (dst_viewbox) {
+    *dst_viewbox = viewbox;
+  }
+  return NULL;
+}
+
+// iconvg_private_decoder__validate_bytecode walks the bytecode, skipping over
+// each op's numbers without decoding their values. It returns the same
+// errors as iconvg_private_execute_bytecode would (with final true) for a
+// no-op canvas, other than iconvg_error_invalid_paint_type.
+static const char*  //
+iconvg_private_decoder__validate_bytecode(iconvg_private_decoder* self) {
+  // color_lens is the number of bytes after a 0x80 ..= 0xA7 styling opcode,
+  // indexed by ((opcode - 0x80) >> 3).
+  static const uint8_t color_lens[5] = {1, 2, 3, 4, 3};
+
+  while (self->len > 0) {
+    uint8_t opcode = self->ptr[0];
+    self->ptr += 1;
+    self->len -= 1;
+
+    if (opcode < 0x80) {  // Set CSEL or NSEL.
+      continue;
+
+    } else if (opcode < 0xA8) {  // Set CREG[etc].
+      size_t n = color_lens[(opcode - 0x80) >> 3];
+      if (self->len < n) {
+        return iconvg_error_bad_color;
+      }
+      self->ptr += n;
+      self->len -= n;
+
+    } else if (opcode < 0xC0) {  // Set NREG[etc].
+      if (!iconvg_private_decoder__skip_numbers(self, 1)) {
+        return ((0xB0 <= opcode) && (opcode < 0xB8))
+                   ? iconvg_error_bad_coordinate
+                   : iconvg_error_bad_number;
+      }
+
+    } else if (opcode < 0xC7) {  // Switch to the drawing mode.
+      if (!iconvg_private_decoder__skip_numbers(self, 2)) {
+        return iconvg_error_bad_coordinate;
+      }
+      ICONVG_PRIVATE_TRY(iconvg_private_decoder__skip_drawing(self));
+
+    } else if (opcode < 0xC8) {  // Set Level of Detail bounds.
+      if (!iconvg_private_decoder__skip_numbers(self, 2)) {
+        return iconvg_error_bad_number;
+      }
+
+    } else {
+      return iconvg_error_bad_styling_opcode;
+    }
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_validate(const uint8_t* src_ptr, size_t src_len) {
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      &d, &viewbox, &suggested_palette));
+  return iconvg_private_decoder__validate_bytecode(&d);
+}
+
+const char*  //
+iconvg_private_decoder__decode_metadata(iconvg_private_decoder* self,
+                                        iconvg_rectangle_f32* dst_viewbox,
+                                        iconvg_palette* dst_suggested_palette) {
+  *dst_viewbox = iconvg_private_default_viewbox();
+  if (dst_suggested_palette) {
+    memcpy(dst_suggested_palette, &iconvg_private_default_palette,
+           sizeof(*dst_suggested_palette));
+  }
+
+  if (!iconvg_private_decoder__decode_magic_identifier(self)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(self,
+                                                     &num_metadata_chunks)) {
+    return iconvg_error_bad_metadata;
+  }
+
+  int32_t previous_metadata_id = -1;
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(self, &chunk_length) ||
+        (chunk_length > self->len)) {
+      return iconvg_error_bad_metadata;
+    }
+    iconvg_private_decoder chunk =
+        iconvg_private_decoder__limit_u32(self, chunk_length);
+    uint32_t metadata_id;
+    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
+      return iconvg_error_bad_metadata;
+    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
+      return iconvg_error_bad_metadata_id_order;
+    }
+
+    switch (metadata_id) {
+      case 0:  // MID 0 (ViewBox).
+        if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk,
+                                                             dst_viewbox) ||
+            (chunk.len != 0)) {
+          return iconvg_error_bad_metadata_viewbox;
+        }
+        break;
+
+      case 1:  // MID 1 (Suggested Palette).
+        if (!dst_suggested_palette) {
+          break;
+        } else if (!iconvg_private_decoder__decode_metadata_suggested_palette(
+                       &chunk, dst_suggested_palette) ||
+                   (chunk.len != 0)) {
+          return iconvg_error_bad_metadata_suggested_palette;
+        }
+        break;
+
+      default:
+        if (dst_suggested_palette) {
+          return iconvg_error_bad_metadata;
+        }
+        break;
+    }
+
+    iconvg_private_decoder__skip_to_the_end(&chunk);
+    iconvg_private_decoder__advance_to_ptr(self, chunk.ptr);
+    previous_metadata_id = ((int32_t)metadata_id);
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_decode(iconvg_canvas* c,
+                      iconvg_rectangle_f32 r,
+                      iconvg_private_decoder* d,
+                      const iconvg_decode_options* options) {
+  iconvg_paint state;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      d, &state.viewbox, &state.custom_palette));
+
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, state.viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, &state.custom_palette));
+
+  iconvg_private_paint__initialize(&state, r, options);
+
+  iconvg_private_path_batch batch;
+  iconvg_private_path_batch__initialize(&batch, c);
+  iconvg_private_bytecode_registers regs;
+  iconvg_private_bytecode_registers__initialize(&regs);
+  const char* err_msg =
+      iconvg_private_execute_bytecode(c, r, d, &state, &batch, &regs, true);
+  // On error, pass on any segments that were decoded before the error, as the
+  // per-segment canvas methods would have seen them.
+  const char* flush_err_msg = iconvg_private_path_batch__flush(&batch, c);
+  return flush_err_msg ? flush_err_msg : err_msg;
+}
+
+const char*  //
+iconvg_decode(iconvg_canvas* dst_canvas,
+              iconvg_rectangle_f32 dst_rect,
+              const uint8_t* src_ptr,
+              size_t src_len,
+              const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+
+  if (!iconvg_private_canvas_vtable_is_supported(dst_canvas)) {
+    return iconvg_error_unsupported_vtable;
+  }
+  iconvg_canvas transform_canvas;
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    transform_canvas =
+        iconvg_private_canvas__make_transform(dst_canvas, transform);
+    dst_canvas = &transform_canvas;
+  }
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_decode(dst_canvas, dst_rect, &d, options);
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg, src_len - d.len,
+                                           d.len);
+}
+
+// ----
+
+// ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN bounds the partial op (or partial
+// metadata) that an iconvg_stream_decoder holds between writes. The longest
+// op, a 16-repetition 'A' or 'C' with 4-byte numbers, is 385 bytes. The
+// longest valid metadata (ViewBox plus a 64-color Suggested Palette) is just
+// under 300 bytes.
+#define ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN 1024
+
+typedef struct iconvg_private_stream_decoder_state_struct {
+  iconvg_canvas* canvas;
+  iconvg_canvas fallback_canvas;
+  iconvg_canvas transform_canvas;
+  iconvg_rectangle_f32 dst_rect;
+  const iconvg_decode_options* options;
+  const char* err_msg;
+  bool began_decode;
+  bool decoded_metadata;
+  size_t num_bytes_written;
+  size_t num_bytes_consumed;
+  iconvg_paint paint;
+  iconvg_private_bytecode_registers regs;
+  iconvg_private_path_batch batch;
+  size_t buf_len;
+  uint8_t buf[ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN];
+} iconvg_private_stream_decoder_state;
+
+// iconvg_private_stream_decoder_state__process decodes as much of src_ptr[..
+// src_len] as possible, setting self->err_msg on failure. Unless final is
+// true, it stops before any trailing partial op. It returns the number of
+// bytes consumed.
+static size_t  //
+iconvg_private_stream_decoder_state__process(
+    iconvg_private_stream_decoder_state* self,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    bool final) {
+  iconvg_canvas* c = self->canvas;
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+
+  if (!self->decoded_metadata) {
+    size_t n = d.len;
+    if (!final) {
+      n = iconvg_private_decoder__complete_metadata_len(&d);
+      if (n == 0) {
+        return 0;
+      }
+    }
+    iconvg_private_decoder m;
+    m.ptr = d.ptr;
+    m.len = n;
+    self->err_msg = iconvg_private_decoder__decode_metadata(
+        &m, &self->paint.viewbox, &self->paint.custom_palette);
+    iconvg_private_decoder__advance_to_ptr(&d, m.ptr);
+    if (!self->err_msg) {
+      self->err_msg =
+          (*c->vtable->on_metadata_viewbox)(c, self->paint.viewbox);
+    }
+    if (!self->err_msg) {
+      self->err_msg = (*c->vtable->on_metadata_suggested_palette)(
+          c, &self->paint.custom_palette);
+    }
+    if (self->err_msg) {
+      return src_len - d.len;
+    }
+    iconvg_private_paint__initialize(&self->paint, self->dst_rect,
+                                     self->options);
+    iconvg_private_path_batch__initialize(&self->batch, c);
+    iconvg_private_bytecode_registers__initialize(&self->regs);
+    self->decoded_metadata = true;
+  }
+
+  const uint8_t* original_end = d.ptr + d.len;
+  if (!final) {
+    d.len = iconvg_private_decoder__complete_ops_len(
+        &d, self->regs.mode != ICONVG_PRIVATE_BYTECODE_MODE__STYLING);
+  }
+  const char* err_msg = iconvg_private_execute_bytecode(
+      c, self->dst_rect, &d, &self->paint, &self->batch, &self->regs, final);
+  // Flush even on suspension, so that the canvas sees every complete op.
+  const char* flush_err_msg = iconvg_private_path_batch__flush(&self->batch, c);
+  self->err_msg = flush_err_msg ? flush_err_msg : err_msg;
+  return src_len - ((size_t)(original_end - d.ptr));
+}
+
+static void  //
+iconvg_private_stream_decoder_state__begin(
+    iconvg_private_stream_decoder_state* self) {
+  if (!self->began_decode) {
+    self->began_decode = true;
+    self->err_msg =
+        (*self->canvas->vtable->begin_decode)(self->canvas, self->dst_rect);
+  }
+}
+
+size_t  //
+iconvg_stream_decoder_workbuf_len(void) {
+  return sizeof(iconvg_private_stream_decoder_state);
+}
+
+const char*  //
+iconvg_stream_decoder__initialize(iconvg_stream_decoder* self,
+                                  void* workbuf_ptr,
+                                  size_t workbuf_len,
+                                  iconvg_canvas* dst_canvas,
+                                  iconvg_rectangle_f32 dst_rect,
+                                  const iconvg_decode_options* options) {
+  if (!self || !workbuf_ptr || (((uintptr_t)workbuf_ptr) & 7) ||
+      (workbuf_len < sizeof(iconvg_private_stream_decoder_state))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_stream_decoder_state* st =
+      (iconvg_private_stream_decoder_state*)workbuf_ptr;
+  memset(st, 0, sizeof(*st));
+  st->fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &st->fallback_canvas;
+  }
+  if (!iconvg_private_canvas_vtable_is_supported(dst_canvas)) {
+    return iconvg_error_unsupported_vtable;
+  }
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    st->transform_canvas =
+        iconvg_private_canvas__make_transform(dst_canvas, transform);
+    dst_canvas = &st->transform_canvas;
+  }
+  st->canvas = dst_canvas;
+  st->dst_rect = dst_rect;
+  st->options = options;
+  self->private_impl.workbuf_ptr = st;
+  return NULL;
+}
+
+const char*  //
+iconvg_stream_decoder__write(iconvg_stream_decoder* self,
+                             const uint8_t* src_ptr,
+                             size_t src_len) {
+  if (!self || !self->private_impl.workbuf_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_stream_decoder_state* st =
+      (iconvg_private_stream_decoder_state*)(self->private_impl.workbuf_ptr);
+  iconvg_private_stream_decoder_state__begin(st);
+  if (st->err_msg) {
+    return st->err_msg;
+  }
+  st->num_bytes_written += src_len;
+
+  while (true) {
+    if (st->buf_len == 0) {
+      // Decode straight from src, keeping any trailing partial op.
+      size_t n = iconvg_private_stream_decoder_state__process(st, src_ptr,
+                                                              src_len, false);
+      st->num_bytes_consumed += n;
+      src_ptr += n;
+      src_len -= n;
+      if (st->err_msg) {
+        return st->err_msg;
+      } else if (src_len > ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN) {
+        // Only over-long metadata can get here.
+        st->err_msg = iconvg_error_bad_metadata;
+        return st->err_msg;
+      }
+      if (src_len > 0) {
+        memcpy(st->buf, src_ptr, src_len);
+      }
+      st->buf_len = src_len;
+      break;
+    }
+
+    // Top up the partial op held in buf and decode from there.
+    size_t old_buf_len = st->buf_len;
+    size_t n = ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN - old_buf_len;
+    if (n > src_len) {
+      n = src_len;
+    }
+    memcpy(st->buf + old_buf_len, src_ptr, n);
+    src_ptr += n;
+    src_len -= n;
+    st->buf_len += n;
+    size_t consumed = iconvg_private_stream_decoder_state__process(
+        st, st->buf, st->buf_len, false);
+    st->num_bytes_consumed += consumed;
+    if (st->err_msg) {
+      return st->err_msg;
+    } else if (consumed >= old_buf_len) {
+      // The partial op was completed. Whatever remains in buf came from src,
+      // so give it back and continue without buf.
+      size_t remaining = st->buf_len - consumed;
+      src_ptr -= remaining;
+      src_len += remaining;
+      st->buf_len = 0;
+      if (src_len == 0) {
+        break;
+      }
+      continue;
+    } else if (st->buf_len == ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN) {
+      st->err_msg = st->decoded_metadata
+                        ? iconvg_private_internal_error_unreachable
+                        : iconvg_error_bad_metadata;
+      return st->err_msg;
+    }
+    memmove(st->buf, st->buf + consumed, st->buf_len - consumed);
+    st->buf_len -= consumed;
+    if (src_len == 0) {
+      break;
+    }
+  }
+  return iconvg_note_need_more_input;
+}
+
+const char*  //
+iconvg_stream_decoder__close(iconvg_stream_decoder* self) {
+  if (!self || !self->private_impl.workbuf_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_stream_decoder_state* st =
+      (iconvg_private_stream_decoder_state*)(self->private_impl.workbuf_ptr);
+  self->private_impl.workbuf_ptr = NULL;
+  iconvg_private_stream_decoder_state__begin(st);
+  if (!st->err_msg) {
+    st->num_bytes_consumed += iconvg_private_stream_decoder_state__process(
+        st, st->buf, st->buf_len, true);
+  }
+  return (*st->canvas->vtable->end_decode)(
+      st->canvas, st->err_msg, st->num_bytes_consumed,
+      st->num_bytes_written - st->num_bytes_consumed);
+}
+
+// -------------------------------- #include "./error.c"
+
+const char iconvg_error_bad_color[] =  //
+    "iconvg: bad color";
+const char iconvg_error_bad_compiled_form[] =  //
+    "iconvg: bad compiled form";
+const char iconvg_error_bad_coordinate[] =  //
+    "iconvg: bad coordinate";
+const char iconvg_error_bad_drawing_opcode[] =  //
+    "iconvg: bad drawing opcode";
+const char iconvg_error_bad_icon_pack[] =  //
+    "iconvg: bad icon pack";
+const char iconvg_error_bad_magic_identifier[] =  //
+    "iconvg: bad magic identifier";
+const char iconvg_error_bad_metadata[] =  //
+    "iconvg: bad metadata";
+const char iconvg_error_bad_metadata_id_order[] =  //
+    "iconvg: bad metadata ID order";
+const char iconvg_error_bad_metadata_suggested_palette[] =  //
+    "iconvg: bad metadata (suggested palette)";
+const char iconvg_error_bad_metadata_viewbox[] =  //
+    "iconvg: bad metadata (viewbox)";
+const char iconvg_error_bad_number[] =  //
+    "iconvg: bad number";
+const char iconvg_error_bad_path_unfinished[] =  //
+    "iconvg: bad path (unfinished)";
+const char iconvg_error_bad_styling_opcode[] =  //
+    "iconvg: bad styling opcode";
+
+const char iconvg_error_system_failure_atlas_too_small[] =  //
+    "iconvg: system failure: atlas too small";
+const char iconvg_error_system_failure_dst_buffer_too_short[] =  //
+    "iconvg: system failure: dst buffer too short";
+const char iconvg_error_system_failure_out_of_memory[] =  //
+    "iconvg: system failure: out of memory";
+
+const char iconvg_error_invalid_backend_not_enabled[] =  //
+    "iconvg: invalid backend (not enabled)";
+const char iconvg_error_invalid_constructor_argument[] =  //
+    "iconvg: invalid constructor argument";
+const char iconvg_error_invalid_coverage_masks[] =  //
+    "iconvg: invalid coverage masks";
+const char iconvg_error_invalid_paint_type[] =  //
+    "iconvg: invalid paint type";
+const char iconvg_error_invalid_path_verb[] =  //
+    "iconvg: invalid path verb";
+const char iconvg_error_unsupported_vtable[] =  //
+    "iconvg: unsupported vtable";
+
+const char iconvg_note_cancelled[] =  //
+    "iconvg: note: cancelled";
+const char iconvg_note_need_more_input[] =  //
+    "iconvg: note: need more input";
+
+const char iconvg_private_internal_error_unreachable[] =  //
+    "iconvg: internal error: unreachable";
+
+// ----
+
+bool  //
+iconvg_error_is_file_format_error(const char* err_msg) {
+  return (err_msg == iconvg_error_bad_color) ||
+         (err_msg == iconvg_error_bad_compiled_form) ||
+         (err_msg == iconvg_error_bad_coordinate) ||
+         (err_msg == iconvg_error_bad_drawing_opcode) ||
+         (err_msg == iconvg_error_bad_icon_pack) ||
+         (err_msg == iconvg_error_bad_magic_identifier) ||
+         (err_msg == iconvg_error_bad_metadata) ||
+         (err_msg == iconvg_error_bad_metadata_id_order) ||
+         (err_msg == iconvg_error_bad_metadata_suggested_palette) ||
+         (err_msg == iconvg_error_bad_metadata_viewbox) ||
+         (err_msg == iconvg_error_bad_number) ||
+         (err_msg == iconvg_error_bad_path_unfinished) ||
+         (err_msg == iconvg_error_bad_styling_opcode);
+}
+
+// -------------------------------- #include "./gradient_cache.c"
+
+// iconvg_private_gradient_cache_entry is one slot of an iconvg_gradient_cache.
+// A zero last_used value marks an empty slot.
+typedef struct iconvg_private_gradient_cache_entry_struct {
+  uint64_t last_used;
+  iconvg_private_gradient_cache_release_func release_func;
+  void* backend_object;
+  size_t backend_bytes;
+  iconvg_private_gradient_key key;
+} iconvg_private_gradient_cache_entry;
+
+void  //
+iconvg_private_gradient_key__initialize(iconvg_private_gradient_key* self,
+                                        const iconvg_paint* p) {
+  memset(self, 0, sizeof(*self));
+  self->paint_type = (uint32_t)iconvg_paint__type(p);
+  self->spread = (uint32_t)iconvg_paint__gradient_spread(p);
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
+  if (num_stops > 64) {
+    num_stops = 64;
+  }
+  self->num_stops = num_stops;
+  for (uint32_t i = 0; i < num_stops; i++) {
+    self->offsets[i] = iconvg_paint__gradient_stop_offset(p, i);
+    self->colors[i] = iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+  }
+}
+
+static void  //
+iconvg_private_gradient_cache__evict(
+    iconvg_gradient_cache* self,
+    iconvg_private_gradient_cache_entry* entry) {
+  (*entry->release_func)(entry->backend_object);
+  self->private_impl.total_backend_bytes -= entry->backend_bytes;
+  memset(entry, 0, sizeof(*entry));
+}
+
+void*  //
+iconvg_private_gradient_cache__lookup(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func) {
+  iconvg_private_gradient_cache_entry* entries =
+      (iconvg_private_gradient_cache_entry*)(self->private_impl.entries_ptr);
+  size_t n = self->private_impl.entries_cap;
+  for (size_t i = 0; i < n; i++) {
+    iconvg_private_gradient_cache_entry* e = &entries[i];
+    if ((e->last_used != 0) && (e->release_func == release_func) &&
+        (memcmp(&e->key, key, sizeof(*key)) == 0)) {
+      e->last_used = ++self->private_impl.clock;
+      return e->backend_object;
+    }
+  }
+  return NULL;
+}
+
+bool  //
+iconvg_private_gradient_cache__insert(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func,
+    void* obj,
+    size_t backend_bytes) {
+  size_t max_bytes = self->private_impl.max_backend_bytes;
+  if ((max_bytes != 0) && (backend_bytes > max_bytes)) {
+    return false;
+  }
+  iconvg_private_gradient_cache_entry* entries =
+      (iconvg_private_gradient_cache_entry*)(self->private_impl.entries_ptr);
+  size_t n = self->private_impl.entries_cap;
+
+  // Evict least recently used entries until the byte limit is met and there
+  // is an empty slot.
+  while (true) {
+    iconvg_private_gradient_cache_entry* empty = NULL;
+    iconvg_private_gradient_cache_entry* oldest = NULL;
+    for (size_t i = 0; i < n; i++) {
+      iconvg_private_gradient_cache_entry* e = &entries[i];
+      if (e->last_used == 0) {
+        if (!empty) {
+          empty = e;
+        }
+      } else if (!oldest || (oldest->last_used > e->last_used)) {
+        oldest = e;
+      }
+    }
+
+    bool fits = (max_bytes == 0) ||
+                (backend_bytes <=
+                 (max_bytes - self->private_impl.total_backend_bytes));
+    if (empty && fits) {
+      empty->last_used = ++self->private_impl.clock;
+      empty->release_func = release_func;
+      empty->backend_object = obj;
+      empty->backend_bytes = backend_bytes;
+      empty->key = *key;
+      self->private_impl.total_backend_bytes += backend_bytes;
+      return true;
+    } else if (!oldest) {
+      return false;
+    }
+    iconvg_private_gradient_cache__evict(self, oldest);
+  }
+}
+
+// ----
+
+size_t  //
+iconvg_gradient_cache_entries_len(size_t num_entries) {
+  const size_t entry_len = sizeof(iconvg_private_gradient_cache_entry);
+  if ((num_entries == 0) || (num_entries > (SIZE_MAX / entry_len))) {
+    return 0;
+  }
+  return num_entries * entry_len;
+}
+
+const char*  //
+iconvg_gradient_cache__initialize(iconvg_gradient_cache* self,
+                                  void* entries_ptr,
+                                  size_t entries_len,
+                                  size_t max_backend_bytes) {
+  if (!self || !entries_ptr || (((uintptr_t)entries_ptr) & 7) ||
+      (entries_len < sizeof(iconvg_private_gradient_cache_entry))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(entries_ptr, 0, entries_len);
+  self->private_impl.entries_ptr = entries_ptr;
+  self->private_impl.entries_cap =
+      entries_len / sizeof(iconvg_private_gradient_cache_entry);
+  self->private_impl.max_backend_bytes = max_backend_bytes;
+  self->private_impl.total_backend_bytes = 0;
+  self->private_impl.clock = 0;
+  return NULL;
+}
+
+void  //
+iconvg_gradient_cache__invalidate(iconvg_gradient_cache* self) {
+  if (!self) {
+    return;
+  }
+  iconvg_private_gradient_cache_entry* entries =
+      (iconvg_private_gradient_cache_entry*)(self->private_impl.entries_ptr);
+  size_t n = self->private_impl.entries_cap;
+  for (size_t i = 0; i < n; i++) {
+    if (entries[i].last_used != 0) {
+      iconvg_private_gradient_cache__evict(self, &entries[i]);
+    }
+  }
+  self->private_impl.clock = 0;
+}
+
+// -------------------------------- #include "./icon_pack.c"
+
+// An icon pack holds many named IconVG graphics in one file, laid out so that
+// it can be memory-mapped (read-only) and used in place. All integers are
+// little-endian uint32 words. It consists of:
+//  - A 4 word header: the magic "\x89IVP", the number of entries N, the
+//    number of hash slots S (a power of 2 greater than N) and a zero word.
+//  - S words of hash slots. Each is zero (empty) or one plus an entry index.
+//    A name's probe sequence starts at its hash modulo S and is linear.
+//  - N entries of 7 words, sorted by name: the name's 32-bit FNV-1a hash,
+//    then the offset and length of the name, the IconVG-formatted data and
+//    the compiled form (both zero if absent). Offsets are from the start of
+//    the pack.
+//  - The names and data, each starting at a 4-byte aligned offset.
+//
+// The src/go/iconpack package writes icon packs. A compiled form (see
+// iconvg_compile) is not a stable format, so a pack should only hold compiled
+// forms produced by the same library version that reads the pack.
+
+#define ICONVG_PRIVATE_ICON_PACK_MAGIC 0x50564989u
+#define ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS 4
+#define ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS 7
+
+static inline uint32_t  //
+iconvg_private_icon_pack_hash(const uint8_t* p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (; n > 0; n--) {
+    h ^= *p++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// iconvg_private_icon_pack_range_is_valid returns whether the offset and
+// length words at p describe a range within a pack of the given length.
+static inline bool  //
+iconvg_private_icon_pack_range_is_valid(const uint8_t* p, size_t pack_len) {
+  size_t offset = iconvg_private_peek_u32le(p + 0);
+  size_t length = iconvg_private_peek_u32le(p + 4);
+  return (offset <= pack_len) && (length <= (pack_len - offset));
+}
+
+static void  //
+iconvg_private_icon_pack__make_entry(const iconvg_icon_pack* self,
+                                     iconvg_icon_pack_entry* dst,
+                                     const uint8_t* e) {
+  const uint8_t* ptr = self->private_impl.ptr;
+  dst->name_ptr = ptr + iconvg_private_peek_u32le(e + 4);
+  dst->name_len = iconvg_private_peek_u32le(e + 8);
+  dst->src_ptr = ptr + iconvg_private_peek_u32le(e + 12);
+  dst->src_len = iconvg_private_peek_u32le(e + 16);
+  dst->compiled_len = iconvg_private_peek_u32le(e + 24);
+  dst->compiled_ptr = dst->compiled_len
+                          ? (ptr + iconvg_private_peek_u32le(e + 20))
+                          : NULL;
+}
+
+// ----
+
+const char*  //
+iconvg_icon_pack__initialize(iconvg_icon_pack* self,
+                             const uint8_t* ptr,
+                             size_t len) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!ptr || (len < (4 * ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS)) ||
+      (iconvg_private_peek_u32le(ptr) != ICONVG_PRIVATE_ICON_PACK_MAGIC)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  size_t num_entries = iconvg_private_peek_u32le(ptr + 4);
+  size_t num_slots = iconvg_private_peek_u32le(ptr + 8);
+  if ((num_slots <= num_entries) || (num_slots & (num_slots - 1)) ||
+      (iconvg_private_peek_u32le(ptr + 12) != 0)) {
+    return iconvg_error_bad_icon_pack;
+  }
+
+  // The header and slot words come first, then the entries. Each count is
+  // less than 1<<32, so the byte counts below cannot overflow a uint64_t.
+  uint64_t entries_offset =
+      4 * ((uint64_t)ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS + num_slots);
+  uint64_t entries_end =
+      entries_offset +
+      (4 * (uint64_t)ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS * num_entries);
+  if (entries_end > len) {
+    return iconvg_error_bad_icon_pack;
+  }
+
+  // Validate every entry's ranges once, so that lookups need not. This reads
+  // the entry table but none of the (possibly paged out) names or data.
+  const uint8_t* e = ptr + entries_offset;
+  for (size_t i = 0; i < num_entries; i++) {
+    if (!iconvg_private_icon_pack_range_is_valid(e + 4, len) ||
+        !iconvg_private_icon_pack_range_is_valid(e + 12, len) ||
+        !iconvg_private_icon_pack_range_is_valid(e + 20, len)) {
+      return iconvg_error_bad_icon_pack;
+    }
+    e += 4 * ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS;
+  }
+
+  self->private_impl.ptr = ptr;
+  self->private_impl.len = len;
+  self->private_impl.entries = ptr + entries_offset;
+  self->private_impl.num_entries = (uint32_t)num_entries;
+  self->private_impl.num_slots = (uint32_t)num_slots;
+  return NULL;
+}
+
+uint32_t  //
+iconvg_icon_pack__number_of_entries(const iconvg_icon_pack* self) {
+  return self ? self->private_impl.num_entries : 0;
+}
+
+bool  //
+iconvg_icon_pack__entry(const iconvg_icon_pack* self,
+                        iconvg_icon_pack_entry* dst,
+                        uint32_t index) {
+  if (!self || !dst || (index >= self->private_impl.num_entries)) {
+    return false;
+  }
+  iconvg_private_icon_pack__make_entry(
+      self, dst,
+      self->private_impl.entries +
+          (4 * ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS * (size_t)index));
+  return true;
+}
+
+bool  //
+iconvg_icon_pack__lookup(const iconvg_icon_pack* self,
+                         iconvg_icon_pack_entry* dst,
+                         const char* name_ptr,
+                         size_t name_len) {
+  if (!self || !dst || (!name_ptr && (name_len > 0))) {
+    return false;
+  }
+  const uint8_t* name = (const uint8_t*)name_ptr;
+  const uint8_t* slots =
+      self->private_impl.ptr + (4 * ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS);
+  uint32_t num_entries = self->private_impl.num_entries;
+  uint32_t mask = self->private_impl.num_slots - 1;
+  uint32_t hash = iconvg_private_icon_pack_hash(name, name_len);
+
+  // There is always at least one empty slot, but a malformed pack might not
+  // have one, so bound the probe sequence.
+  uint32_t s = hash & mask;
+  for (uint32_t n = 0; n <= mask; n++, s = (s + 1) & mask) {
+    uint32_t slot = iconvg_private_peek_u32le(slots + (4 * (size_t)s));
+    if (slot == 0) {
+      break;
+    } else if (slot > num_entries) {
+      continue;
+    }
+    const uint8_t* e =
+        self->private_impl.entries +
+        (4 * ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS * (size_t)(slot - 1));
+    if ((iconvg_private_peek_u32le(e + 0) != hash) ||
+        (iconvg_private_peek_u32le(e + 8) != name_len)) {
+      continue;
+    }
+    const uint8_t* entry_name =
+        self->private_impl.ptr + iconvg_private_peek_u32le(e + 4);
+    if ((name_len == 0) || (memcmp(entry_name, name, name_len) == 0)) {
+      iconvg_private_icon_pack__make_entry(self, dst, e);
+      return true;
+    }
+  }
+  return false;
+}
+
+// -------------------------------- #include "./matrix.c"
+
+iconvg_matrix_2x3_f64  //
+iconvg_matrix_2x3_f64__inverse(iconvg_matrix_2x3_f64* self) {
+  double inv = 1.0 / iconvg_matrix_2x3_f64__determinant(self);
+  if (isinf(inv) || isnan(inv)) {
+    return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+  }
+
+  // https://ardoris.wordpress.com/2008/07/18/general-formula-for-the-inverse-of-a-3x3-matrix/
+  // recalling that self's implicit bottom row is [0, 0, 1].
+  double e02 = (self->elems[0][1] * self->elems[1][2]) -
+               (self->elems[0][2] * self->elems[1][1]);
+  double e12 = (self->elems[0][0] * self->elems[1][2]) -
+               (self->elems[0][2] * self->elems[1][0]);
+  return iconvg_matrix_2x3_f64__make(+inv * self->elems[1][1],  //
+                                     -inv * self->elems[0][1],  //
+                                     +inv * e02,                //
+                                     -inv * self->elems[1][0],  //
+                                     +inv * self->elems[0][0],  //
+                                     -inv * e12);               //
+}
+
+void  //
+iconvg_matrix_2x3_f64__override_second_row(iconvg_matrix_2x3_f64* self) {
+  if (!self) {
+    return;
+  }
+  if (self->elems[0][0] != 0.0) {
+    self->elems[1][0] = 0.0;
+    self->elems[1][1] = 1.0;
+  } else if (self->elems[0][1] != 0.0) {
+    self->elems[1][0] = 1.0;
+    self->elems[1][1] = 0.0;
+  } else {
+    // 1e-10 is arbitrary but very small and squaring it still gives
+    // something larger than FLT_MIN, approximately 1.175494e-38.
+    self->elems[0][0] = 1e-10;
+    self->elems[0][1] = 0.0;
+    self->elems[1][0] = 0.0;
+    self->elems[1][1] = 1e-10;
+  }
+}
+
+// -------------------------------- #include "./paint.c"
+
+void  //
+iconvg_private_paint__initialize(iconvg_paint* self,
+                                 iconvg_rectangle_f32 dst_rect,
+                                 const iconvg_decode_options* options) {
+  if (options && options->height_in_pixels.has_value) {
+    self->height_in_pixels = options->height_in_pixels.value;
+  } else {
+    double h = iconvg_rectangle_f32__height_f64(&dst_rect);
+    // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
+    // than MAX_INT32 and also ensures that conversion between integer and
+    // float or double is lossless.
+    if (h <= 0x100000) {
+      self->height_in_pixels = (int64_t)h;
+    } else {
+      self->height_in_pixels = 0x100000;
+    }
+  }
+  memset(&self->paint_rgba, 0, sizeof(self->paint_rgba));
+
+  if (options && options->palette) {
+    memcpy(&self->custom_palette, options->palette,
+           sizeof(self->custom_palette));
+  }
+  memcpy(&self->creg, &self->custom_palette, sizeof(self->creg));
+  self->creg_palette_deps = ~((uint64_t)0);
+  memset(&self->nreg[0], 0, sizeof(self->nreg));
+
+  double scale_x = +1.0;
+  double bias_x = +0.0;
+  double scale_y = +1.0;
+  double bias_y = +0.0;
+  {
+    double rw = iconvg_rectangle_f32__width_f64(&dst_rect);
+    double rh = iconvg_rectangle_f32__height_f64(&dst_rect);
+    double vw = iconvg_rectangle_f32__width_f64(&self->viewbox);
+    double vh = iconvg_rectangle_f32__height_f64(&self->viewbox);
+    if ((rw > 0) && (rh > 0) && (vw > 0) && (vh > 0)) {
+      scale_x = rw / vw;
+      scale_y = rh / vh;
+      bias_x = dst_rect.min_x - (self->viewbox.min_x * scale_x);
+      bias_y = dst_rect.min_y - (self->viewbox.min_y * scale_y);
+    }
+  }
+  self->s2d_scale_x = scale_x;
+  self->s2d_bias_x = bias_x;
+  self->s2d_scale_y = scale_y;
+  self->s2d_bias_y = bias_y;
+  self->d2s_scale_x = 1.0 / scale_x;
+  self->d2s_bias_x = -bias_x * self->d2s_scale_x;
+  self->d2s_scale_y = 1.0 / scale_y;
+  self->d2s_bias_y = -bias_y * self->d2s_scale_y;
+
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  self->has_transform = transform != NULL;
+  if (transform) {
+    iconvg_matrix_2x3_f64 m = *transform;
+    iconvg_matrix_2x3_f64 inv = iconvg_matrix_2x3_f64__inverse(&m);
+    self->d2s_matrix = iconvg_matrix_2x3_f64__make(
+        inv.elems[0][0] * self->d2s_scale_x,
+        inv.elems[0][1] * self->d2s_scale_x,
+        (inv.elems[0][2] * self->d2s_scale_x) + self->d2s_bias_x,
+        inv.elems[1][0] * self->d2s_scale_y,
+        inv.elems[1][1] * self->d2s_scale_y,
+        (inv.elems[1][2] * self->d2s_scale_y) + self->d2s_bias_y);
+  } else {
+    self->d2s_matrix = iconvg_matrix_2x3_f64__make(
+        self->d2s_scale_x, 0.0, self->d2s_bias_x,  //
+        0.0, self->d2s_scale_y, self->d2s_bias_y);
+  }
+
+  // The s2d scales are positive, so the d2s conversion keeps min below max.
+  // Canvases clip to dst_rect, whose src coordinates are therefore the
+  // default src_clip, but a transform can move other parts of the graphic
+  // into (the bounding box of) the transformed dst_rect.
+  self->src_clip[0] = -INFINITY;
+  self->src_clip[1] = -INFINITY;
+  self->src_clip[2] = +INFINITY;
+  self->src_clip[3] = +INFINITY;
+  if (!transform) {
+    self->src_clip[0] = (dst_rect.min_x * self->d2s_scale_x) + self->d2s_bias_x;
+    self->src_clip[1] = (dst_rect.min_y * self->d2s_scale_y) + self->d2s_bias_y;
+    self->src_clip[2] = (dst_rect.max_x * self->d2s_scale_x) + self->d2s_bias_x;
+    self->src_clip[3] = (dst_rect.max_y * self->d2s_scale_y) + self->d2s_bias_y;
+  }
+  const iconvg_rectangle_f32* clip_rect =
+      iconvg_private_decode_options__clip_rect(options);
+  self->has_clip = clip_rect != NULL;
+  if (clip_rect) {
+    double c[4];
+    c[0] = (clip_rect->min_x * self->d2s_scale_x) + self->d2s_bias_x;
+    c[1] = (clip_rect->min_y * self->d2s_scale_y) + self->d2s_bias_y;
+    c[2] = (clip_rect->max_x * self->d2s_scale_x) + self->d2s_bias_x;
+    c[3] = (clip_rect->max_y * self->d2s_scale_y) + self->d2s_bias_y;
+    self->src_clip[0] = (self->src_clip[0] > c[0]) ? self->src_clip[0] : c[0];
+    self->src_clip[1] = (self->src_clip[1] > c[1]) ? self->src_clip[1] : c[1];
+    self->src_clip[2] = (self->src_clip[2] < c[2]) ? self->src_clip[2] : c[2];
+    self->src_clip[3] = (self->src_clip[3] < c[3]) ? self->src_clip[3] : c[3];
+  }
+
+  self->cancel = NULL;
+  self->cancel_context = NULL;
+  if (options && (options->sizeof__iconvg_decode_options >=
+                  (offsetof(iconvg_decode_options, cancel_context) +
+                   sizeof(options->cancel_context)))) {
+    self->cancel = options->cancel;
+    self->cancel_context = options->cancel_context;
+  }
+}
+
+bool  //
+iconvg_private_paint__is_transparent(const iconvg_paint* self) {
+  // Flat colors are premultiplied, so zero alpha means all zero. Gradients
+  // always have zero paint_rgba[3].
+  if (self->paint_rgba[3] != 0x00) {
+    return false;
+  } else if (iconvg_paint__type(self) == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    return true;
+  }
+  uint32_t cbase = self->paint_rgba[1];
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(self);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    if (self->creg.colors[0x3F & (cbase + i)].rgba[3] != 0x00) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----
+
+iconvg_paint_type  //
+iconvg_paint__type(const iconvg_paint* self) {
+  if (self) {
+    const uint8_t* rgba = &self->paint_rgba[0];
+    if ((rgba[0] <= rgba[3]) &&  //
+        (rgba[1] <= rgba[3]) &&  //
+        (rgba[2] <= rgba[3])) {
+      return ICONVG_PAINT_TYPE__FLAT_COLOR;
+    } else if ((rgba[3] == 0x00) && (rgba[2] >= 0x80)) {
+      return (rgba[2] & 0x40) ? ICONVG_PAINT_TYPE__RADIAL_GRADIENT
+                              : ICONVG_PAINT_TYPE__LINEAR_GRADIENT;
+    }
+  }
+  return ICONVG_PAINT_TYPE__INVALID;
+}
+
+// ----
+
+static inline iconvg_nonpremul_color  //
+iconvg_private_flat_color_as_nonpremul_color(const uint8_t* rgba) {
+  iconvg_nonpremul_color k;
+  if (!rgba || (rgba[3] == 0x00)) {
+    memset(&k.rgba[0], 0, 4);
+  } else if (rgba[3] == 0xFF) {
+    memcpy(&k.rgba[0], rgba, 4);
+  } else {
+    uint32_t a = rgba[3];
+    k.rgba[0] = ((uint8_t)(((uint32_t)(rgba[0])) * 0xFF / a));
+    k.rgba[1] = ((uint8_t)(((uint32_t)(rgba[1])) * 0xFF / a));
+    k.rgba[2] = ((uint8_t)(((uint32_t)(rgba[2])) * 0xFF / a));
+    k.rgba[3] = ((uint8_t)a);
+  }
+  return k;
+}
+
+static inline iconvg_premul_color  //
+iconvg_private_flat_color_as_premul_color(const uint8_t* rgba) {
+  iconvg_premul_color k;
+  if (!rgba) {
+    memset(&k.rgba[0], 0, 4);
+  } else {
+    memcpy(&k.rgba[0], rgba, 4);
+  }
+  return k;
+}
+
+// ----
+
+iconvg_nonpremul_color  //
+iconvg_paint__flat_color_as_nonpremul_color(const iconvg_paint* self) {
+  return iconvg_private_flat_color_as_nonpremul_color(
+      self ? &self->paint_rgba[0] : NULL);
+}
 
-// -------------------------------- #include "./debug.c"
+iconvg_premul_color  //
+iconvg_paint__flat_color_as_premul_color(const iconvg_paint* self) {
+  return iconvg_private_flat_color_as_premul_color(self ? &self->paint_rgba[0]
+                                                        : NULL);
+}
 
-static const char*  //
-iconvg_private_debug_canvas__begin_decode(iconvg_canvas* c,
-                                          iconvg_rectangle_f32 dst_rect) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%sbegin_decode({%g, %g, %g, %g})\n",
-            ((const char*)(c->context.const_ptr3)), dst_rect.min_x,
-            dst_rect.min_y, dst_rect.max_x, dst_rect.max_y);
+// ----
+
+iconvg_gradient_spread  //
+iconvg_paint__gradient_spread(const iconvg_paint* self) {
+  if (!self) {
+    return ICONVG_GRADIENT_SPREAD__NONE;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  return (iconvg_gradient_spread)(self->paint_rgba[1] >> 6);
+}
+
+uint32_t  //
+iconvg_paint__gradient_number_of_stops(const iconvg_paint* self) {
+  if (!self) {
+    return 0;
   }
-  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+  return 0x3F & self->paint_rgba[0];
 }
 
-static const char*  //
-iconvg_private_debug_canvas__end_decode(iconvg_canvas* c,
-                                        const char* err_msg,
-                                        size_t num_bytes_consumed,
-                                        size_t num_bytes_remaining) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    const char* quote = err_msg ? "\"" : "";
-    fprintf(f, "%send_decode(%s%s%s, %zu, %zu)\n",
-            ((const char*)(c->context.const_ptr3)), quote,
-            err_msg ? err_msg : "NULL", quote, num_bytes_consumed,
-            num_bytes_remaining);
+iconvg_nonpremul_color  //
+iconvg_paint__gradient_stop_color_as_nonpremul_color(const iconvg_paint* self,
+                                                     uint32_t which_stop) {
+  const uint8_t* rgba = NULL;
+  if (self) {
+    uint32_t cbase = self->paint_rgba[1];
+    rgba = &self->creg.colors[0x3F & (cbase + which_stop)].rgba[0];
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return err_msg;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  return iconvg_private_flat_color_as_nonpremul_color(rgba);
+}
+
+iconvg_premul_color  //
+iconvg_paint__gradient_stop_color_as_premul_color(const iconvg_paint* self,
+                                                  uint32_t which_stop) {
+  const uint8_t* rgba = NULL;
+  if (self) {
+    uint32_t cbase = self->paint_rgba[1];
+    rgba = &self->creg.colors[0x3F & (cbase + which_stop)].rgba[0];
   }
-  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
-                                        num_bytes_remaining);
+  return iconvg_private_flat_color_as_premul_color(rgba);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__begin_drawing(iconvg_canvas* c) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%sbegin_drawing()\n", ((const char*)(c->context.const_ptr3)));
+float  //
+iconvg_paint__gradient_stop_offset(const iconvg_paint* self,
+                                   uint32_t which_stop) {
+  if (!self) {
+    return 0;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  uint32_t nbase = self->paint_rgba[2];
+  return self->nreg[0x3F & (nbase + which_stop)];
+}
+
+iconvg_matrix_2x3_f64  //
+iconvg_paint__gradient_transformation_matrix(const iconvg_paint* self) {
+  if (!self) {
+    return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
   }
-  return (*wrapped->vtable->begin_drawing)(wrapped);
+
+  uint32_t nbase = self->paint_rgba[2];
+  double s00 = self->nreg[0x3F & (nbase - 6)];
+  double s01 = self->nreg[0x3F & (nbase - 5)];
+  double s02 = self->nreg[0x3F & (nbase - 4)];
+  double s10 = self->nreg[0x3F & (nbase - 3)];
+  double s11 = self->nreg[0x3F & (nbase - 2)];
+  double s12 = self->nreg[0x3F & (nbase - 1)];
+
+  // The [s00, s01, s02; s10, s11, s12] matrix transforms from *src*
+  // coordinates to pattern coordinates.
+  //
+  //   pat_x = (src_x * s00) + (src_y * s01) + s02
+  //   pat_y = (src_x * s10) + (src_y * s11) + s12
+  //
+  // Pattern coordinate space (also known as paint or gradient coordinate
+  // space) is where linear gradients always range from x=0 to x=1 and radial
+  // gradients are always center=(0,0) and radius=1. We can't just return this
+  // matrix to the caller. We need to produce the equivalent [d00, d01, d02;
+  // d10, d11, d12] matrix that transforms from *dst* coordinates to pattern
+  // coordinates. Recall that:
+  //
+  //   src_x = (dst_x * d2s_scale_x) + d2s_bias_x
+  //   src_y = (dst_y * d2s_scale_y) + d2s_bias_y
+  //
+  // Combining the above, we can solve for d00, d01, etc such that:
+  //
+  //   pat_x = (dst_x * d00) + (dst_y * d01) + d02
+  //   pat_y = (dst_x * d10) + (dst_y * d11) + d12
+  //
+  // With an iconvg_decode_options transform, src_x and src_y are instead a
+  // full affine function (d2s_matrix) of dst_x and dst_y.
+  if (self->has_transform) {
+    const iconvg_matrix_2x3_f64* a = &self->d2s_matrix;
+    return iconvg_matrix_2x3_f64__make(
+        (s00 * a->elems[0][0]) + (s01 * a->elems[1][0]),
+        (s00 * a->elems[0][1]) + (s01 * a->elems[1][1]),
+        (s00 * a->elems[0][2]) + (s01 * a->elems[1][2]) + s02,
+        (s10 * a->elems[0][0]) + (s11 * a->elems[1][0]),
+        (s10 * a->elems[0][1]) + (s11 * a->elems[1][1]),
+        (s10 * a->elems[0][2]) + (s11 * a->elems[1][2]) + s12);
+  }
+  double d00 = s00 * self->d2s_scale_x;
+  double d01 = s01 * self->d2s_scale_y;
+  double d02 = (s00 * self->d2s_bias_x) + (s01 * self->d2s_bias_y) + s02;
+  double d10 = s10 * self->d2s_scale_x;
+  double d11 = s11 * self->d2s_scale_y;
+  double d12 = (s10 * self->d2s_bias_x) + (s11 * self->d2s_bias_y) + s12;
+
+  return iconvg_matrix_2x3_f64__make(d00, d01, d02, d10, d11, d12);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__end_drawing(iconvg_canvas* c,
-                                         const iconvg_paint* p) {
-  static const char* spread_names[4] = {"none", "pad", "reflect", "repeat"};
+// -------------------------------- #include "./player.c"
+
+// iconvg_private_player__is_identity returns whether m is exactly the
+// identity, in which case decoding needs no transform canvas at all.
+static inline bool  //
+iconvg_private_player__is_identity(const iconvg_matrix_2x3_f64* m) {
+  return (m->elems[0][0] == 1.0) && (m->elems[0][1] == 0.0) &&
+         (m->elems[0][2] == 0.0) && (m->elems[1][0] == 0.0) &&
+         (m->elems[1][1] == 1.0) && (m->elems[1][2] == 0.0);
+}
+
+// iconvg_private_player__palette returns the palette for decoding frame. It
+// is either a borrowed one or, when the frame's alpha applies, buf filled in
+// with a copy whose entries that the graphic uses are alpha-scaled.
+static const iconvg_palette*  //
+iconvg_private_player__palette(const iconvg_player* self,
+                               const iconvg_player_frame* frame,
+                               iconvg_palette* buf) {
+  const iconvg_palette* src =
+      frame->palette ? frame->palette : &self->private_impl.palette;
+  uint64_t mask = self->private_impl.palette_mask;
+  // "!(x < 1)" is also true for NaN.
+  if (!(frame->alpha < 1.0f) || !mask) {
+    return src;
+  }
+  float alpha = (frame->alpha > 0.0f) ? frame->alpha : 0.0f;
+  *buf = *src;
+  for (int i = 0; mask; i++, mask >>= 1) {
+    if (mask & 1) {
+      const uint8_t* s = &src->colors[i].rgba[0];
+      uint8_t* d = &buf->colors[i].rgba[0];
+      d[0] = (uint8_t)((((float)s[0]) * alpha) + 0.5f);
+      d[1] = (uint8_t)((((float)s[1]) * alpha) + 0.5f);
+      d[2] = (uint8_t)((((float)s[2]) * alpha) + 0.5f);
+      d[3] = (uint8_t)((((float)s[3]) * alpha) + 0.5f);
+    }
+  }
+  return buf;
+}
+
+// iconvg_private_player__options sets *options for decoding frame to
+// *dst_rect, with buf as per iconvg_private_player__palette. use_transform is
+// whether to set the options' transform: false if the caller applies it some
+// other way.
+static void  //
+iconvg_private_player__options(const iconvg_player* self,
+                               const iconvg_player_frame* frame,
+                               const iconvg_rectangle_f32* dst_rect,
+                               bool use_transform,
+                               iconvg_decode_options* options,
+                               iconvg_palette* buf) {
+  memset(options, 0, sizeof(*options));
+  options->sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+  // The decoders only read the options' palette, despite its non-const type.
+  options->palette =
+      (iconvg_palette*)(iconvg_private_player__palette(self, frame, buf));
+  if (iconvg_private_player__is_identity(&frame->transform)) {
+    // The compiled form stores each drawing's bounds, so culling those
+    // outside of dst_rect is free. With a transform (whether in the options
+    // or the cairo_t's matrix), dst_rect is not what the canvas clips to.
+    options->clip_rect = dst_rect;
+  } else if (use_transform) {
+    options->transform = &frame->transform;
+  }
+}
+
+// ----
+
+iconvg_player_frame  //
+iconvg_player_frame__make(void) {
+  iconvg_player_frame f;
+  f.transform = iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+  f.palette = NULL;
+  f.alpha = 1.0f;
+  return f;
+}
+
+const char*  //
+iconvg_player__initialize(iconvg_player* self,
+                          const uint8_t* compiled_ptr,
+                          size_t compiled_len,
+                          const iconvg_palette* palette,
+                          iconvg_coverage_masks* masks) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  ICONVG_PRIVATE_TRY(iconvg_private_decode_compiled_header(
+      &self->private_impl.palette, &self->private_impl.palette_mask,
+      compiled_ptr, compiled_len));
+  if (palette) {
+    self->private_impl.palette = *palette;
+  }
+  self->private_impl.compiled_ptr = compiled_ptr;
+  self->private_impl.compiled_len = compiled_len;
+  self->private_impl.masks = masks;
+  return NULL;
+}
+
+const char*  //
+iconvg_player__render(iconvg_player* self,
+                      iconvg_canvas* dst_canvas,
+                      iconvg_rectangle_f32 dst_rect,
+                      const iconvg_player_frame* frame) {
+  if (!self || !self->private_impl.compiled_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_player_frame default_frame;
+  if (!frame) {
+    default_frame = iconvg_player_frame__make();
+    frame = &default_frame;
+  }
+
+  bool pushed =
+      !iconvg_private_player__is_identity(&frame->transform) &&
+      iconvg_private_cairo_canvas__push_transform(dst_canvas,
+                                                  &frame->transform);
+  iconvg_decode_options options;
+  iconvg_palette buf;
+  iconvg_private_player__options(self, frame, &dst_rect, !pushed, &options,
+                                 &buf);
+  const char* err_msg = iconvg_decode_compiled(
+      dst_canvas, dst_rect, self->private_impl.compiled_ptr,
+      self->private_impl.compiled_len, &options);
+  if (pushed) {
+    iconvg_private_cairo_canvas__pop_transform(dst_canvas);
+  }
+  return err_msg;
+}
+
+const char*  //
+iconvg_player__render_pixels(iconvg_player* self,
+                             uint8_t* pixels_ptr,
+                             size_t pixels_stride,
+                             uint32_t pixels_width,
+                             uint32_t pixels_height,
+                             float* scratch_ptr,
+                             size_t scratch_len,
+                             iconvg_rectangle_f32 dst_rect,
+                             const iconvg_player_frame* frame) {
+  if (!self || !self->private_impl.compiled_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_player_frame default_frame;
+  if (!frame) {
+    default_frame = iconvg_player_frame__make();
+    frame = &default_frame;
+  }
+  iconvg_decode_options options;
+  iconvg_palette buf;
+  iconvg_private_player__options(self, frame, &dst_rect, true, &options,
+                                 &buf);
+
+  iconvg_coverage_masks* masks = self->private_impl.masks;
+  if (masks && self->private_impl.masks_are_valid &&
+      (self->private_impl.masks_pixels_width == pixels_width) &&
+      (self->private_impl.masks_pixels_height == pixels_height) &&
+      !memcmp(&self->private_impl.masks_dst_rect, &dst_rect,
+              sizeof(dst_rect)) &&
+      !memcmp(&self->private_impl.masks_transform, &frame->transform,
+              sizeof(frame->transform))) {
+    return iconvg_coverage_masks__composite(
+        masks, pixels_ptr, pixels_stride, pixels_width, pixels_height,
+        dst_rect, self->private_impl.compiled_ptr,
+        self->private_impl.compiled_len, &options);
+  }
+
+  // Re-record the masks (if any) while rasterizing. They are only valid again
+  // if the whole frame was recorded.
+  self->private_impl.masks_are_valid = false;
+  iconvg_canvas c =
+      masks ? iconvg_canvas__make_rasterizer_with_coverage_masks(
+                  pixels_ptr, pixels_stride, pixels_width, pixels_height,
+                  scratch_ptr, scratch_len, masks)
+            : iconvg_canvas__make_rasterizer(pixels_ptr, pixels_stride,
+                                             pixels_width, pixels_height,
+                                             scratch_ptr, scratch_len);
+  ICONVG_PRIVATE_TRY(iconvg_decode_compiled(
+      &c, dst_rect, self->private_impl.compiled_ptr,
+      self->private_impl.compiled_len, &options));
+  if (masks && !masks->private_impl.overflowed) {
+    self->private_impl.masks_are_valid = true;
+    self->private_impl.masks_pixels_width = pixels_width;
+    self->private_impl.masks_pixels_height = pixels_height;
+    self->private_impl.masks_dst_rect = dst_rect;
+    self->private_impl.masks_transform = frame->transform;
+  }
+  return NULL;
+}
+
+// -------------------------------- #include "./rasterizer.c"
+
+// The rasterizer canvas is a signed-area coverage accumulation rasterizer, in
+// the style of font-rs (https://github.com/raphlinus/font-rs) and libart.
+//
+// Each path segment (with curves flattened to lines) adds its signed area
+// contribution to an accumulation buffer, one float per pixel. At the end of
+// each drawing, a running (prefix) sum along each row gives that pixel's
+// winding-weighted coverage, which is clamped to 1 (a non-zero fill rule) and
+// used to composite the drawing's paint onto the pixel buffer.
+//
+// The iconvg_canvas' context fields hold:
+//  - nonconst_ptr1: the pixel buffer.
+//  - nonconst_ptr2: the scratch buffer, starting with an
+//    iconvg_private_rasterizer header followed by the accumulation buffer and
+//    then one row of 8-bit coverage values.
+//  - extra5: the pixel buffer's stride, in bytes.
+//  - extra6: the pixel buffer's width.
+//  - extra7: the pixel buffer's height.
+//  - const_ptr3: the iconvg_coverage_masks to record into, or NULL. It is
+//    only const because the context field is.
+
+// iconvg_private_rasterizer only holds fields with at most float's alignment,
+// as it lives at the start of a caller-supplied float array.
+typedef struct iconvg_private_rasterizer_struct {
+  // The clip rectangle and the accumulation buffer's dirty rectangle are
+  // half-open ranges: min inclusive, max exclusive. Every accumulation buffer
+  // element outside of the dirty rectangle is zero. It can extend past the
+  // pixel width, into the ICONVG_PRIVATE_RASTERIZER_ACC_SLACK columns.
+  int32_t clip_min_x;
+  int32_t clip_min_y;
+  int32_t clip_max_x;
+  int32_t clip_max_y;
+  int32_t dirty_min_x;
+  int32_t dirty_min_y;
+  int32_t dirty_max_x;
+  int32_t dirty_max_y;
+
+  // kernels is an ICONVG_PRIVATE_RASTERIZER_KERNELS__ETC value, chosen (based
+  // on the CPU's capabilities) when the canvas is made.
+  int32_t kernels;
+
+  // The current path's start point and current point.
+  float start_x;
+  float start_y;
+  float current_x;
+  float current_y;
+
+  // gradient_lut holds 256 premultiplied RGBA colors, for evenly spaced
+  // gradient offsets from 0.0 to 1.0 inclusive.
+  uint8_t gradient_lut[256 * 4];
+} iconvg_private_rasterizer;
+
+// ICONVG_PRIVATE_RASTERIZER_HEADER_LEN is the number of floats, at the start
+// of the scratch buffer, spanned by the iconvg_private_rasterizer.
+#define ICONVG_PRIVATE_RASTERIZER_HEADER_LEN \
+  ((sizeof(iconvg_private_rasterizer) + sizeof(float) - 1) / sizeof(float))
+
+// Each accumulation buffer row has 2 more floats than the pixel width. A line
+// segment touching the right edge can write up to 2 elements past the last
+// pixel and those elements are never summed into a pixel's coverage.
+#define ICONVG_PRIVATE_RASTERIZER_ACC_SLACK 2
+
+// ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN is the maximum number of line
+// segments that flatten one quadratic or cubic Bézier curve.
+#define ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN 256
+
+static inline iconvg_private_rasterizer*  //
+iconvg_private_rasterizer_canvas__state(iconvg_canvas* c) {
+  return (iconvg_private_rasterizer*)(c->context.nonconst_ptr2);
+}
+
+static inline float*  //
+iconvg_private_rasterizer_canvas__acc(iconvg_canvas* c) {
+  return ((float*)(c->context.nonconst_ptr2)) +
+         ICONVG_PRIVATE_RASTERIZER_HEADER_LEN;
+}
 
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    switch (iconvg_paint__type(p)) {
-      case ICONVG_PAINT_TYPE__FLAT_COLOR: {
-        iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
-        fprintf(f, "%send_drawing(flat_color{%02X:%02X:%02X:%02X})\n",
-                ((const char*)(c->context.const_ptr3)), ((int)(k.rgba[0])),
-                ((int)(k.rgba[1])), ((int)(k.rgba[2])), ((int)(k.rgba[3])));
-        break;
-      }
+static inline uint8_t*  //
+iconvg_private_rasterizer_canvas__coverage(iconvg_canvas* c) {
+  size_t acc_stride =
+      ((size_t)(c->context.extra6)) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  return (uint8_t*)(iconvg_private_rasterizer_canvas__acc(c) +
+                    (acc_stride * ((size_t)(c->context.extra7))));
+}
 
-      case ICONVG_PAINT_TYPE__LINEAR_GRADIENT: {
-        fprintf(f,
-                "%send_drawing(linear_gradient{nstops=%d, spread=%s, ...})\n",
-                ((const char*)(c->context.const_ptr3)),
-                ((int)(iconvg_paint__gradient_number_of_stops(p))),
-                spread_names[iconvg_paint__gradient_spread(p)]);
-        break;
-      }
+// iconvg_private_rasterizer__clamp clamps x to the range [0, max]. NaN maps
+// to 0.
+static inline float  //
+iconvg_private_rasterizer__clamp(float x, float max) {
+  if (!(x > 0.0f)) {
+    return 0.0f;
+  } else if (x > max) {
+    return max;
+  }
+  return x;
+}
 
-      case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
-        fprintf(f,
-                "%send_drawing(radial_gradient{nstops=%d, spread=%s, ...})\n",
-                ((const char*)(c->context.const_ptr3)),
-                ((int)(iconvg_paint__gradient_number_of_stops(p))),
-                spread_names[iconvg_paint__gradient_spread(p)]);
-        break;
-      }
+static inline uint32_t  //
+iconvg_private_rasterizer__mul_u8(uint32_t a, uint32_t b) {
+  return ((a * b) + 127) / 255;
+}
 
-      case ICONVG_PAINT_TYPE__INVALID:
-      default: {
-        return iconvg_error_invalid_paint_type;
+// iconvg_private_rasterizer_canvas__clear_dirty_rows zeroes the accumulation
+// buffer's dirty rectangle, the elements touched since the last clear.
+static void  //
+iconvg_private_rasterizer_canvas__clear_dirty_rows(iconvg_canvas* c) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  if ((r->dirty_min_y < r->dirty_max_y) && (r->dirty_min_x < r->dirty_max_x)) {
+    size_t acc_stride =
+        ((size_t)(c->context.extra6)) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+    size_t n = (size_t)(r->dirty_max_x - r->dirty_min_x);
+    float* row = iconvg_private_rasterizer_canvas__acc(c) +
+                 (((size_t)(r->dirty_min_y)) * acc_stride) +
+                 ((size_t)(r->dirty_min_x));
+    if (n == acc_stride) {
+      memset(row, 0,
+             ((size_t)(r->dirty_max_y - r->dirty_min_y)) * acc_stride *
+                 sizeof(float));
+    } else {
+      for (int32_t iy = r->dirty_min_y; iy < r->dirty_max_y;
+           iy++, row += acc_stride) {
+        memset(row, 0, n * sizeof(float));
       }
     }
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
-  }
-  return (*wrapped->vtable->end_drawing)(wrapped, p);
+  r->dirty_min_x = (int32_t)(c->context.extra6);
+  r->dirty_min_y = (int32_t)(c->context.extra7);
+  r->dirty_max_x = 0;
+  r->dirty_max_y = 0;
 }
 
-static const char*  //
-iconvg_private_debug_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%sbegin_path(%g, %g)\n", ((const char*)(c->context.const_ptr3)),
-            x0, y0);
+// iconvg_private_rasterizer_canvas__accumulate_line adds the signed area
+// contribution of the line segment from (x0, y0) to (x1, y1) to the
+// accumulation buffer. Parts of the line outside of the pixel buffer's rows
+// are dropped. Parts to the left or right of the pixel buffer are clamped to
+// its left or right edge, which preserves the coverage of every pixel inside.
+static void  //
+iconvg_private_rasterizer_canvas__accumulate_line(iconvg_canvas* c,
+                                                  float x0,
+                                                  float y0,
+                                                  float x1,
+                                                  float y1) {
+  float dir = +1.0f;
+  if (y0 > y1) {
+    float t = x0;
+    x0 = x1;
+    x1 = t;
+    t = y0;
+    y0 = y1;
+    y1 = t;
+    dir = -1.0f;
+  } else if (!(y0 < y1)) {
+    // Horizontal lines (and NaN coordinates) contribute no area.
+    return;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+
+  const int32_t width = (int32_t)(c->context.extra6);
+  const int32_t height = (int32_t)(c->context.extra7);
+  if ((y0 >= ((float)height)) || (y1 <= 0.0f)) {
+    return;
   }
-  return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
-}
 
-static const char*  //
-iconvg_private_debug_canvas__end_path(iconvg_canvas* c) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%send_path()\n", ((const char*)(c->context.const_ptr3)));
+  const float dxdy = (x1 - x0) / (y1 - y0);
+  float x = x0;
+  int32_t iy0 = 0;
+  if (y0 < 0.0f) {
+    x -= y0 * dxdy;
+    y0 = 0.0f;
+  } else {
+    iy0 = (int32_t)y0;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  int32_t iy1 = (y1 < ((float)height)) ? ((int32_t)(ceilf(y1))) : height;
+
+  // Within each row, the elements written are from floor(xa) to ceil(xb) + 1
+  // inclusive, for the row's clamped x range [xa, xb]. The whole line's
+  // clamped x range bounds every row's, give or take the rounding error of
+  // stepping x from row to row, so the dirty columns get a 1 element margin.
+  const float fwidth = (float)width;
+  float xlo = iconvg_private_rasterizer__clamp(x0, fwidth);
+  float xhi = iconvg_private_rasterizer__clamp(x1, fwidth);
+  if (xlo > xhi) {
+    float t = xlo;
+    xlo = xhi;
+    xhi = t;
+  }
+  int32_t ix0 = ((int32_t)floorf(xlo)) - 1;
+  ix0 = (ix0 > 0) ? ix0 : 0;
+  int32_t ix1 = ((int32_t)ceilf(xhi)) + 3;
+  ix1 = (ix1 < (width + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK))
+            ? ix1
+            : (width + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK);
+
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  if (r->dirty_min_x > ix0) {
+    r->dirty_min_x = ix0;
+  }
+  if (r->dirty_min_y > iy0) {
+    r->dirty_min_y = iy0;
+  }
+  if (r->dirty_max_x < ix1) {
+    r->dirty_max_x = ix1;
+  }
+  if (r->dirty_max_y < iy1) {
+    r->dirty_max_y = iy1;
+  }
+
+  const size_t acc_stride =
+      ((size_t)width) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  float* row = iconvg_private_rasterizer_canvas__acc(c) +
+               (((size_t)iy0) * acc_stride);
+  for (int32_t iy = iy0; iy < iy1; iy++, row += acc_stride) {
+    float fy = (float)iy;
+    float dy = (((fy + 1.0f) < y1) ? (fy + 1.0f) : y1) - ((fy > y0) ? fy : y0);
+    float x_next = x + (dxdy * dy);
+    float d = dy * dir;
+
+    float xa = iconvg_private_rasterizer__clamp(x, fwidth);
+    float xb = iconvg_private_rasterizer__clamp(x_next, fwidth);
+    x = x_next;
+    if (xa > xb) {
+      float t = xa;
+      xa = xb;
+      xb = t;
+    }
+
+    float xa_floor = floorf(xa);
+    int32_t ia = (int32_t)xa_floor;
+    float xb_ceil = ceilf(xb);
+    int32_t ib = (int32_t)xb_ceil;
+
+    if (ib <= (ia + 1)) {
+      // The line (within this row) touches only one pixel column.
+      float xm = (0.5f * (xa + xb)) - xa_floor;
+      row[ia] += d - (d * xm);
+      row[ia + 1] += d * xm;
+      continue;
+    }
+
+    // The line spans multiple pixel columns. Its area contribution is a
+    // triangle in the first column, a triangle in the last column and a
+    // linear ramp in between.
+    float s = 1.0f / (xb - xa);
+    float xa_frac = xa - xa_floor;
+    float a0 = 0.5f * s * (1.0f - xa_frac) * (1.0f - xa_frac);
+    float xb_frac = xb - xb_ceil + 1.0f;
+    float am = 0.5f * s * xb_frac * xb_frac;
+    row[ia] += d * a0;
+    if (ib == (ia + 2)) {
+      row[ia + 1] += d * (1.0f - a0 - am);
+    } else {
+      float a1 = s * (1.5f - xa_frac);
+      row[ia + 1] += d * (a1 - a0);
+      float ds = d * s;
+      for (int32_t ix = ia + 2; ix < (ib - 1); ix++) {
+        row[ix] += ds;
+      }
+      float a2 = a1 + (((float)(ib - ia - 3)) * s);
+      row[ib - 1] += d * (1.0f - a2 - am);
+    }
+    row[ib] += d * am;
   }
-  return (*wrapped->vtable->end_path)(wrapped);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__path_line_to(iconvg_canvas* c,
+static void  //
+iconvg_private_rasterizer_canvas__line_to(iconvg_canvas* c,
                                           float x1,
                                           float y1) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%spath_line_to(%g, %g)\n",
-            ((const char*)(c->context.const_ptr3)), x1, y1);
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  iconvg_private_rasterizer_canvas__accumulate_line(c, r->current_x,
+                                                    r->current_y, x1, y1);
+  r->current_x = x1;
+  r->current_y = y1;
+}
+
+// iconvg_private_rasterizer__flatten_count returns the number of line
+// segments that approximate a Bézier curve to within 0.1 pixels, given the
+// curve's maximum second difference dd. The second derivative is at most k *
+// dd, with k = 2 for quadratics and k = 6 for cubics, and a chord over a t
+// interval of length h deviates from the curve by at most (k * dd * h²) / 8.
+static inline int32_t  //
+iconvg_private_rasterizer__flatten_count(float k_times_dd) {
+  float n = sqrtf(k_times_dd * (10.0f / 8.0f));
+  if (n < (ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN - 1)) {
+    return 1 + (int32_t)n;
   }
-  return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  // This also catches NaN.
+  return ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN;
 }
 
-static const char*  //
-iconvg_private_debug_canvas__path_quad_to(iconvg_canvas* c,
+static void  //
+iconvg_private_rasterizer_canvas__quad_to(iconvg_canvas* c,
                                           float x1,
                                           float y1,
                                           float x2,
                                           float y2) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%spath_quad_to(%g, %g, %g, %g)\n",
-            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2);
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  float x0 = r->current_x;
+  float y0 = r->current_y;
+  float ddx = x0 - (2.0f * x1) + x2;
+  float ddy = y0 - (2.0f * y1) + y2;
+  int32_t n = iconvg_private_rasterizer__flatten_count(
+      2.0f * sqrtf((ddx * ddx) + (ddy * ddy)));
+  float inv_n = 1.0f / ((float)n);
+  for (int32_t i = 1; i < n; i++) {
+    float t = ((float)i) * inv_n;
+    float u = 1.0f - t;
+    float b0 = u * u;
+    float b1 = 2.0f * u * t;
+    float b2 = t * t;
+    iconvg_private_rasterizer_canvas__line_to(
+        c, (b0 * x0) + (b1 * x1) + (b2 * x2),  //
+        (b0 * y0) + (b1 * y1) + (b2 * y2));
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
-  }
-  return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  iconvg_private_rasterizer_canvas__line_to(c, x2, y2);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__path_cube_to(iconvg_canvas* c,
+static void  //
+iconvg_private_rasterizer_canvas__cube_to(iconvg_canvas* c,
                                           float x1,
                                           float y1,
                                           float x2,
                                           float y2,
                                           float x3,
                                           float y3) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%spath_cube_to(%g, %g, %g, %g, %g, %g)\n",
-            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2, x3, y3);
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  float x0 = r->current_x;
+  float y0 = r->current_y;
+  float ddx0 = x0 - (2.0f * x1) + x2;
+  float ddy0 = y0 - (2.0f * y1) + y2;
+  float ddx1 = x1 - (2.0f * x2) + x3;
+  float ddy1 = y1 - (2.0f * y2) + y3;
+  float dd0 = (ddx0 * ddx0) + (ddy0 * ddy0);
+  float dd1 = (ddx1 * ddx1) + (ddy1 * ddy1);
+  int32_t n = iconvg_private_rasterizer__flatten_count(
+      6.0f * sqrtf((dd0 > dd1) ? dd0 : dd1));
+  float inv_n = 1.0f / ((float)n);
+  for (int32_t i = 1; i < n; i++) {
+    float t = ((float)i) * inv_n;
+    float u = 1.0f - t;
+    float b0 = u * u * u;
+    float b1 = 3.0f * u * u * t;
+    float b2 = 3.0f * u * t * t;
+    float b3 = t * t * t;
+    iconvg_private_rasterizer_canvas__line_to(
+        c, (b0 * x0) + (b1 * x1) + (b2 * x2) + (b3 * x3),
+        (b0 * y0) + (b1 * y1) + (b2 * y2) + (b3 * y3));
   }
-  return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  iconvg_private_rasterizer_canvas__line_to(c, x3, y3);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__on_metadata_viewbox(iconvg_canvas* c,
-                                                 iconvg_rectangle_f32 viewbox) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%son_metadata_viewbox({%g, %g, %g, %g})\n",
-            ((const char*)(c->context.const_ptr3)), viewbox.min_x,
-            viewbox.min_y, viewbox.max_x, viewbox.max_y);
+// iconvg_private_rasterizer_canvas__fill_gradient_lut sets r->gradient_lut
+// from p's gradient stops, interpolating in premultiplied alpha space.
+static void  //
+iconvg_private_rasterizer__fill_gradient_lut(uint8_t* lut,
+                                             const iconvg_paint* p) {
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
+  if (num_stops == 0) {
+    memset(lut, 0, 256 * 4);
+    return;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+
+  uint32_t j = 0;
+  for (uint32_t i = 0; i < 256; i++) {
+    float t = ((float)i) / 255.0f;
+    while (((j + 1) < num_stops) &&
+           (iconvg_paint__gradient_stop_offset(p, j + 1) <= t)) {
+      j++;
+    }
+    uint8_t* dst = &lut[4 * i];
+
+    float offset0 = iconvg_paint__gradient_stop_offset(p, j);
+    iconvg_premul_color k0 =
+        iconvg_paint__gradient_stop_color_as_premul_color(p, j);
+    if ((t <= offset0) || ((j + 1) >= num_stops)) {
+      memcpy(dst, &k0.rgba[0], 4);
+      continue;
+    }
+
+    float offset1 = iconvg_paint__gradient_stop_offset(p, j + 1);
+    iconvg_premul_color k1 =
+        iconvg_paint__gradient_stop_color_as_premul_color(p, j + 1);
+    float w1 = (t - offset0) / (offset1 - offset0);
+    float w0 = 1.0f - w1;
+    for (int ch = 0; ch < 4; ch++) {
+      dst[ch] = (uint8_t)((w0 * k0.rgba[ch]) + (w1 * k1.rgba[ch]) + 0.5f);
+    }
   }
-  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__on_metadata_suggested_palette(
-    iconvg_canvas* c,
-    const iconvg_palette* suggested_palette) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    int j = iconvg_private_last_color_that_isnt_opaque_black(suggested_palette);
-    if (j < 0) {
-      fprintf(f, "%son_metadata_suggested_palette(...)\n",
-              ((const char*)(c->context.const_ptr3)));
-    } else {
-      fprintf(f, "%son_metadata_suggested_palette(",
-              ((const char*)(c->context.const_ptr3)));
-      for (int i = 0; i <= j; i++) {
-        fprintf(f, "%02X:%02X:%02X:%02X%s",
-                ((int)(suggested_palette->colors[i].rgba[0])),
-                ((int)(suggested_palette->colors[i].rgba[1])),
-                ((int)(suggested_palette->colors[i].rgba[2])),
-                ((int)(suggested_palette->colors[i].rgba[3])),
-                (i < 63) ? ", " : ")\n");
+// iconvg_private_rasterizer__gradient_lut_index applies the spread to a
+// gradient offset t and returns the gradient_lut index, or -1 for transparent
+// (which only happens with ICONVG_GRADIENT_SPREAD__NONE).
+static inline int32_t  //
+iconvg_private_rasterizer__gradient_lut_index(double t,
+                                              iconvg_gradient_spread spread) {
+  switch (spread) {
+    case ICONVG_GRADIENT_SPREAD__NONE:
+      if ((t < 0.0) || (t > 1.0)) {
+        return -1;
       }
-      if (j < 63) {
-        fprintf(f, "...)\n");
-      } else {
-        fprintf(f, ")\n");
+      break;
+    case ICONVG_GRADIENT_SPREAD__REFLECT:
+      t = fabs(t);
+      t -= 2.0 * floor(t / 2.0);
+      if (t > 1.0) {
+        t = 2.0 - t;
       }
-    }
+      break;
+    case ICONVG_GRADIENT_SPREAD__REPEAT:
+      t -= floor(t);
+      break;
+    default:
+      break;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_unsupported_vtable;
+  // Clamping also implements ICONVG_GRADIENT_SPREAD__PAD and maps NaN (e.g.
+  // from infinite coordinates) to 0.
+  if (!(t > 0.0)) {
+    return 0;
+  } else if (t < 1.0) {
+    return (int32_t)((t * 255.0) + 0.5);
   }
-  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
-                                                           suggested_palette);
+  return 255;
 }
 
-static const iconvg_canvas_vtable  //
-    iconvg_private_debug_canvas_vtable = {
-        sizeof(iconvg_canvas_vtable),
-        &iconvg_private_debug_canvas__begin_decode,
-        &iconvg_private_debug_canvas__end_decode,
-        &iconvg_private_debug_canvas__begin_drawing,
-        &iconvg_private_debug_canvas__end_drawing,
-        &iconvg_private_debug_canvas__begin_path,
-        &iconvg_private_debug_canvas__end_path,
-        &iconvg_private_debug_canvas__path_line_to,
-        &iconvg_private_debug_canvas__path_quad_to,
-        &iconvg_private_debug_canvas__path_cube_to,
-        &iconvg_private_debug_canvas__on_metadata_viewbox,
-        &iconvg_private_debug_canvas__on_metadata_suggested_palette,
-};
+// ----
 
-iconvg_canvas  //
-iconvg_canvas__make_debug(FILE* f,
-                          const char* message_prefix,
-                          iconvg_canvas* wrapped) {
-  if (wrapped && !wrapped->vtable) {
-    wrapped = NULL;
+// The end_drawing inner loops are, per row of pixels, "accumulate" (convert
+// the accumulation buffer to 8-bit coverage) and "blend_flat" (composite a
+// flat color, weighted by that coverage, onto the pixels). Both have SIMD
+// implementations, chosen at run time (x86) or compile time (ARM). They all
+// produce the same results as the scalar implementations, other than rounding
+// differences (from re-ordered floating point additions) in accumulate.
+//
+// Compiling with ICONVG_CONFIG__DISABLE_SIMD uses the scalar implementations
+// on every CPU.
+
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__SCALAR 0
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__SSE41 1
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__AVX2 2
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__NEON 3
+
+#if !defined(ICONVG_CONFIG__DISABLE_SIMD)
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define ICONVG_PRIVATE_HAVE_X86_SIMD
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ICONVG_PRIVATE_HAVE_ARM_NEON
+#include <arm_neon.h>
+#endif
+#endif  // !defined(ICONVG_CONFIG__DISABLE_SIMD)
+
+typedef struct iconvg_private_rasterizer_kernels_struct {
+  // accumulate sets dst[i], for i in 0 .. n, to the 8-bit coverage for the
+  // prefix sum (accumulator + src[0] + src[1] + ... + src[i]).
+  void (*accumulate)(uint8_t* dst,
+                     const float* src,
+                     size_t n,
+                     float accumulator);
+  // blend_flat composites the premultiplied RGBA color src, with coverage
+  // cov[i], onto the i'th RGBA pixel of dst, for i in 0 .. n.
+  void (*blend_flat)(uint8_t* dst,
+                     const uint8_t* cov,
+                     size_t n,
+                     const uint8_t* src);
+} iconvg_private_rasterizer_kernels;
+
+// iconvg_private_rasterizer__blend_pixel composites src onto dst (both are 4
+// bytes of premultiplied RGBA) with the SRC_OVER operator and 8-bit coverage.
+static inline void  //
+iconvg_private_rasterizer__blend_pixel(uint8_t* dst,
+                                       uint32_t cov,
+                                       const uint8_t* src) {
+  uint32_t sa = iconvg_private_rasterizer__mul_u8(src[3], cov);
+  uint32_t inv_sa = 0xFF - sa;
+  for (int i = 0; i < 4; i++) {
+    uint32_t v = iconvg_private_rasterizer__mul_u8(src[i], cov) +
+                 iconvg_private_rasterizer__mul_u8(dst[i], inv_sa);
+    dst[i] = (uint8_t)((v < 0xFF) ? v : 0xFF);
   }
-  iconvg_canvas c;
-  c.vtable = &iconvg_private_debug_canvas_vtable;
-  memset(&c.context, 0, sizeof(c.context));
-  c.context.nonconst_ptr1 = wrapped;
-  c.context.nonconst_ptr2 = f;
-  c.context.const_ptr3 = message_prefix ? message_prefix : "";
-  return c;
 }
 
-// -------------------------------- #include "./decoder.c"
+static void  //
+iconvg_private_rasterizer__accumulate_scalar(uint8_t* dst,
+                                             const float* src,
+                                             size_t n,
+                                             float accumulator) {
+  for (size_t i = 0; i < n; i++) {
+    accumulator += src[i];
+    float coverage = fabsf(accumulator);
+    dst[i] = (coverage < 1.0f) ? ((uint8_t)((coverage * 255.0f) + 0.5f))
+                               : 0xFF;
+  }
+}
 
 static void  //
-iconvg_private_decoder__advance_to_ptr(iconvg_private_decoder* self,
-                                       const uint8_t* new_ptr) {
-  if (new_ptr >= self->ptr) {
-    size_t delta = ((size_t)(new_ptr - self->ptr));
-    if (delta <= self->len) {
-      self->ptr += delta;
-      self->len -= delta;
-      return;
+iconvg_private_rasterizer__blend_flat_scalar(uint8_t* dst,
+                                             const uint8_t* cov,
+                                             size_t n,
+                                             const uint8_t* src) {
+  for (size_t i = 0; i < n; i++, dst += 4) {
+    if (cov[i] == 0) {
+      continue;
+    } else if ((cov[i] == 0xFF) && (src[3] == 0xFF)) {
+      memcpy(dst, src, 4);
+      continue;
     }
+    iconvg_private_rasterizer__blend_pixel(dst, cov[i], src);
   }
-  self->ptr = NULL;
-  self->len = 0;
 }
 
-static iconvg_private_decoder  //
-iconvg_private_decoder__limit_u32(iconvg_private_decoder* self,
-                                  uint32_t limit) {
-  iconvg_private_decoder d;
-  d.ptr = self->ptr;
-  d.len = (limit < self->len) ? limit : self->len;
-  return d;
+#if defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+
+// The SSE4.1 accumulate kernel computes an in-register prefix sum of 4 floats
+// (with 2 shift-and-add steps) and carries the last lane to the next 4.
+__attribute__((target("sse4.1"))) static void  //
+iconvg_private_rasterizer__accumulate_sse41(uint8_t* dst,
+                                            const float* src,
+                                            size_t n,
+                                            float accumulator) {
+  const __m128 sign_bit = _mm_set1_ps(-0.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 k255 = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128i low_bytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,  //
+                                          -1, -1, -1, -1, -1, -1, -1, -1);
+  __m128 offset = _mm_set1_ps(accumulator);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(src + i);
+    x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+    x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+    x = _mm_add_ps(x, offset);
+    offset = _mm_shuffle_ps(x, x, 0xFF);
+    // _mm_min_ps returns its second argument (one) if x is NaN, matching the
+    // scalar code.
+    __m128 y = _mm_min_ps(_mm_andnot_ps(sign_bit, x), one);
+    y = _mm_add_ps(_mm_mul_ps(y, k255), half);
+    __m128i z = _mm_shuffle_epi8(_mm_cvttps_epi32(y), low_bytes);
+    uint32_t u = (uint32_t)_mm_cvtsi128_si32(z);
+    memcpy(dst + i, &u, 4);
+  }
+  iconvg_private_rasterizer__accumulate_scalar(dst + i, src + i, n - i,
+                                               _mm_cvtss_f32(offset));
 }
-
-static void  //
-iconvg_private_decoder__skip_to_the_end(iconvg_private_decoder* self) {
-  self->ptr += self->len;
-  self->len = 0;
+
+// iconvg_private_rasterizer__div255_epi16 returns ((x + 127) / 255) for each
+// uint16_t lane x, for x <= 0xFE01 (which is 0xFF * 0xFF).
+__attribute__((target("sse4.1"))) static inline __m128i  //
+iconvg_private_rasterizer__div255_epi16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(127));
+  x = _mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8));
+  return _mm_srli_epi16(x, 8);
 }
 
-// ----
+// iconvg_private_rasterizer__blend2_sse41 blends 2 pixels, as 8 uint16_t
+// lanes. s is the src color (repeated twice) and c is each pixel's coverage
+// (repeated 4 times).
+__attribute__((target("sse4.1"))) static inline __m128i  //
+iconvg_private_rasterizer__blend2_sse41(__m128i d, __m128i s, __m128i c) {
+  __m128i sc = iconvg_private_rasterizer__div255_epi16(_mm_mullo_epi16(s, c));
+  __m128i sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sc, 0xFF), 0xFF);
+  __m128i inv_sa = _mm_sub_epi16(_mm_set1_epi16(0xFF), sa);
+  __m128i dc =
+      iconvg_private_rasterizer__div255_epi16(_mm_mullo_epi16(d, inv_sa));
+  return _mm_add_epi16(sc, dc);
+}
 
-static bool  //
-iconvg_private_decoder__decode_coordinate_number(iconvg_private_decoder* self,
-                                                 float* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      int32_t i = (int32_t)(v >> 1);
-      *dst = ((float)(i - 64));
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
+__attribute__((target("sse4.1"))) static void  //
+iconvg_private_rasterizer__blend_flat_sse41(uint8_t* dst,
+                                            const uint8_t* cov,
+                                            size_t n,
+                                            const uint8_t* src) {
+  uint32_t src_u32;
+  memcpy(&src_u32, src, 4);
+  const bool opaque = src[3] == 0xFF;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i src4 = _mm_set1_epi32((int32_t)src_u32);
+  const __m128i s = _mm_unpacklo_epi8(src4, zero);
+  const __m128i cov01 = _mm_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1,  //
+                                      1, -1, 1, -1, 1, -1, 1, -1);
+  const __m128i cov23 = _mm_setr_epi8(2, -1, 2, -1, 2, -1, 2, -1,  //
+                                      3, -1, 3, -1, 3, -1, 3, -1);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4, dst += 16) {
+    uint32_t c4;
+    memcpy(&c4, cov + i, 4);
+    if (c4 == 0) {
+      continue;
+    } else if (opaque && (c4 == 0xFFFFFFFF)) {
+      _mm_storeu_si128((__m128i*)dst, src4);
+      continue;
+    }
+    __m128i c = _mm_cvtsi32_si128((int32_t)c4);
+    __m128i d = _mm_loadu_si128((const __m128i*)dst);
+    __m128i lo = iconvg_private_rasterizer__blend2_sse41(
+        _mm_unpacklo_epi8(d, zero), s, _mm_shuffle_epi8(c, cov01));
+    __m128i hi = iconvg_private_rasterizer__blend2_sse41(
+        _mm_unpackhi_epi8(d, zero), s, _mm_shuffle_epi8(c, cov23));
+    // _mm_packus_epi16 saturates, like the scalar code's "min(v, 0xFF)".
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+  }
+  iconvg_private_rasterizer__blend_flat_scalar(dst, cov + i, n - i, src);
+}
 
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
-        *dst = ((float)(i - (128 * 64))) / 64.0f;
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
+// iconvg_private_rasterizer__div255_epi16_avx2 is the 256-bit equivalent of
+// iconvg_private_rasterizer__div255_epi16.
+__attribute__((target("avx2"))) static inline __m256i  //
+iconvg_private_rasterizer__div255_epi16_avx2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(127));
+  x = _mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)),
+                       _mm256_srli_epi16(x, 8));
+  return _mm256_srli_epi16(x, 8);
+}
 
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        // TODO: reject NaNs?
-        *dst = iconvg_private_reinterpret_from_u32_to_f32(
-            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
+__attribute__((target("avx2"))) static inline __m256i  //
+iconvg_private_rasterizer__blend4_avx2(__m256i d, __m256i s, __m256i c) {
+  __m256i sc =
+      iconvg_private_rasterizer__div255_epi16_avx2(_mm256_mullo_epi16(s, c));
+  __m256i sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sc, 0xFF), 0xFF);
+  __m256i inv_sa = _mm256_sub_epi16(_mm256_set1_epi16(0xFF), sa);
+  __m256i dc = iconvg_private_rasterizer__div255_epi16_avx2(
+      _mm256_mullo_epi16(d, inv_sa));
+  return _mm256_add_epi16(sc, dc);
+}
+
+// The AVX2 blend_flat kernel handles 8 pixels per iteration. The 256-bit
+// unpack and pack instructions work within each 128-bit half, so the low half
+// of lo (and hi) holds pixels 0 and 1 (and 2 and 3) and the high half holds
+// pixels 4 and 5 (and 6 and 7), and _mm256_packus_epi16 restores their order.
+__attribute__((target("avx2"))) static void  //
+iconvg_private_rasterizer__blend_flat_avx2(uint8_t* dst,
+                                           const uint8_t* cov,
+                                           size_t n,
+                                           const uint8_t* src) {
+  uint32_t src_u32;
+  memcpy(&src_u32, src, 4);
+  const bool opaque = src[3] == 0xFF;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i src8 = _mm256_set1_epi32((int32_t)src_u32);
+  const __m256i s = _mm256_unpacklo_epi8(src8, zero);
+  const __m256i cov0145 = _mm256_setr_epi8(
+      0, -1, 0, -1, 0, -1, 0, -1, 1, -1, 1, -1, 1, -1, 1, -1,  //
+      4, -1, 4, -1, 4, -1, 4, -1, 5, -1, 5, -1, 5, -1, 5, -1);
+  const __m256i cov2367 = _mm256_setr_epi8(
+      2, -1, 2, -1, 2, -1, 2, -1, 3, -1, 3, -1, 3, -1, 3, -1,  //
+      6, -1, 6, -1, 6, -1, 6, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8, dst += 32) {
+    uint64_t c8;
+    memcpy(&c8, cov + i, 8);
+    if (c8 == 0) {
+      continue;
+    } else if (opaque && (c8 == 0xFFFFFFFFFFFFFFFFull)) {
+      _mm256_storeu_si256((__m256i*)dst, src8);
+      continue;
     }
+    __m256i c = _mm256_broadcastsi128_si256(
+        _mm_loadl_epi64((const __m128i*)(cov + i)));
+    __m256i d = _mm256_loadu_si256((const __m256i*)dst);
+    __m256i lo = iconvg_private_rasterizer__blend4_avx2(
+        _mm256_unpacklo_epi8(d, zero), s, _mm256_shuffle_epi8(c, cov0145));
+    __m256i hi = iconvg_private_rasterizer__blend4_avx2(
+        _mm256_unpackhi_epi8(d, zero), s, _mm256_shuffle_epi8(c, cov2367));
+    _mm256_storeu_si256((__m256i*)dst, _mm256_packus_epi16(lo, hi));
   }
-  return false;
+  iconvg_private_rasterizer__blend_flat_sse41(dst, cov + i, n - i, src);
 }
 
-static bool  //
-iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
-                                              uint32_t* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      *dst = v >> 1;
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
+#endif  // defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
 
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
+#if defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
 
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
-    }
+static void  //
+iconvg_private_rasterizer__accumulate_neon(uint8_t* dst,
+                                           const float* src,
+                                           size_t n,
+                                           float accumulator) {
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t k255 = vdupq_n_f32(255.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  float32x4_t offset = vdupq_n_f32(accumulator);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    float32x4_t x = vld1q_f32(src + i);
+    x = vaddq_f32(x, vextq_f32(zero, x, 3));
+    x = vaddq_f32(x, vextq_f32(zero, x, 2));
+    x = vaddq_f32(x, offset);
+    offset = vdupq_n_f32(vgetq_lane_f32(x, 3));
+    float32x4_t y = vminq_f32(vabsq_f32(x), one);
+    y = vaddq_f32(vmulq_f32(y, k255), half);
+    uint16x4_t z16 = vmovn_u32(vcvtq_u32_f32(y));
+    uint8x8_t z8 = vmovn_u16(vcombine_u16(z16, z16));
+    uint32_t u = vget_lane_u32(vreinterpret_u32_u8(z8), 0);
+    memcpy(dst + i, &u, 4);
   }
-  return false;
+  iconvg_private_rasterizer__accumulate_scalar(dst + i, src + i, n - i,
+                                               vgetq_lane_f32(offset, 3));
 }
 
-static bool  //
-iconvg_private_decoder__decode_real_number(iconvg_private_decoder* self,
-                                           float* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      *dst = (float)(v >> 1);
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
+// iconvg_private_rasterizer__div255_u16 returns ((x + 127) / 255) for each
+// uint16_t lane x, for x <= 0xFE01 (which is 0xFF * 0xFF).
+static inline uint16x8_t  //
+iconvg_private_rasterizer__div255_u16(uint16x8_t x) {
+  x = vaddq_u16(x, vdupq_n_u16(127));
+  x = vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8));
+  return vshrq_n_u16(x, 8);
+}
 
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        *dst = (float)(iconvg_private_peek_u16le(self->ptr) >> 2);
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
+// iconvg_private_rasterizer__blend2_neon blends 2 pixels. s is the src color
+// (repeated twice) and c is each pixel's coverage (repeated 4 times).
+static inline uint8x8_t  //
+iconvg_private_rasterizer__blend2_neon(uint8x8_t d, uint8x8_t s, uint8x8_t c) {
+  uint16x8_t sc = iconvg_private_rasterizer__div255_u16(vmull_u8(s, c));
+  uint16x8_t sa = vcombine_u16(vdup_lane_u16(vget_low_u16(sc), 3),
+                               vdup_lane_u16(vget_high_u16(sc), 3));
+  uint8x8_t inv_sa = vmovn_u16(vsubq_u16(vdupq_n_u16(0xFF), sa));
+  uint16x8_t dc = iconvg_private_rasterizer__div255_u16(vmull_u8(d, inv_sa));
+  return vqmovn_u16(vaddq_u16(sc, dc));
+}
 
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        // TODO: reject NaNs?
-        *dst = iconvg_private_reinterpret_from_u32_to_f32(
-            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
+static void  //
+iconvg_private_rasterizer__blend_flat_neon(uint8_t* dst,
+                                           const uint8_t* cov,
+                                           size_t n,
+                                           const uint8_t* src) {
+  uint32_t src_u32;
+  memcpy(&src_u32, src, 4);
+  const bool opaque = src[3] == 0xFF;
+  const uint8x16_t src4 = vreinterpretq_u8_u32(vdupq_n_u32(src_u32));
+  const uint8x8_t s = vget_low_u8(src4);
+  const uint8x8_t cov01 = vcreate_u8(0x0101010100000000ull);
+  const uint8x8_t cov23 = vcreate_u8(0x0303030302020202ull);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4, dst += 16) {
+    uint32_t c4;
+    memcpy(&c4, cov + i, 4);
+    if (c4 == 0) {
+      continue;
+    } else if (opaque && (c4 == 0xFFFFFFFF)) {
+      vst1q_u8(dst, src4);
+      continue;
     }
+    uint8x8_t c = vreinterpret_u8_u32(vdup_n_u32(c4));
+    uint8x16_t d = vld1q_u8(dst);
+    uint8x8_t lo = iconvg_private_rasterizer__blend2_neon(
+        vget_low_u8(d), s, vtbl1_u8(c, cov01));
+    uint8x8_t hi = iconvg_private_rasterizer__blend2_neon(
+        vget_high_u8(d), s, vtbl1_u8(c, cov23));
+    vst1q_u8(dst, vcombine_u8(lo, hi));
   }
-  return false;
+  iconvg_private_rasterizer__blend_flat_scalar(dst, cov + i, n - i, src);
 }
 
-static bool  //
-iconvg_private_decoder__decode_zero_to_one_number(iconvg_private_decoder* self,
-                                                  float* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      *dst = (float)(((double)(v >> 1)) / 120.0);
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
+#endif  // defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+
+// iconvg_private_rasterizer_kernels_table is indexed by
+// ICONVG_PRIVATE_RASTERIZER_KERNELS__ETC values. Entries for SIMD flavors
+// that aren't compiled in fall back to the scalar kernels.
+static const iconvg_private_rasterizer_kernels
+    iconvg_private_rasterizer_kernels_table[4] = {
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+#if defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+        {
+            &iconvg_private_rasterizer__accumulate_sse41,
+            &iconvg_private_rasterizer__blend_flat_sse41,
+        },
+        {
+            &iconvg_private_rasterizer__accumulate_sse41,
+            &iconvg_private_rasterizer__blend_flat_avx2,
+        },
+#else
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+#endif
+#if defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+        {
+            &iconvg_private_rasterizer__accumulate_neon,
+            &iconvg_private_rasterizer__blend_flat_neon,
+        },
+#else
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+#endif
+};
 
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        *dst = (float)(((double)(iconvg_private_peek_u16le(self->ptr) >> 2)) /
-                       15120.0);
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
+static int32_t  //
+iconvg_private_rasterizer__choose_kernels(void) {
+#if defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ICONVG_PRIVATE_RASTERIZER_KERNELS__AVX2;
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    return ICONVG_PRIVATE_RASTERIZER_KERNELS__SSE41;
+  }
+#elif defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+  return ICONVG_PRIVATE_RASTERIZER_KERNELS__NEON;
+#endif
+  return ICONVG_PRIVATE_RASTERIZER_KERNELS__SCALAR;
+}
 
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        // TODO: reject NaNs?
-        *dst = iconvg_private_reinterpret_from_u32_to_f32(
-            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
-    }
+static const char*  //
+iconvg_private_rasterizer_canvas__begin_decode(iconvg_canvas* c,
+                                               iconvg_rectangle_f32 dst_rect) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  float fwidth = (float)(c->context.extra6);
+  float fheight = (float)(c->context.extra7);
+  r->clip_min_x = (int32_t)floorf(
+      iconvg_private_rasterizer__clamp(dst_rect.min_x, fwidth));
+  r->clip_min_y = (int32_t)floorf(
+      iconvg_private_rasterizer__clamp(dst_rect.min_y, fheight));
+  r->clip_max_x =
+      (int32_t)ceilf(iconvg_private_rasterizer__clamp(dst_rect.max_x, fwidth));
+  r->clip_max_y = (int32_t)ceilf(
+      iconvg_private_rasterizer__clamp(dst_rect.max_y, fheight));
+  iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+
+  iconvg_coverage_masks* masks =
+      (iconvg_coverage_masks*)(c->context.const_ptr3);
+  if (masks) {
+    masks->private_impl.buf_used = 0;
+    masks->private_impl.num_masks = 0;
+    masks->private_impl.dst_rect[0] = dst_rect.min_x;
+    masks->private_impl.dst_rect[1] = dst_rect.min_y;
+    masks->private_impl.dst_rect[2] = dst_rect.max_x;
+    masks->private_impl.dst_rect[3] = dst_rect.max_y;
+    masks->private_impl.pixels_width = (uint32_t)(c->context.extra6);
+    masks->private_impl.pixels_height = (uint32_t)(c->context.extra7);
+    masks->private_impl.overflowed = false;
   }
-  return false;
+  return NULL;
 }
 
-// ----
+static const char*  //
+iconvg_private_rasterizer_canvas__end_decode(iconvg_canvas* c,
+                                             const char* err_msg,
+                                             size_t num_bytes_consumed,
+                                             size_t num_bytes_remaining) {
+  // A failed decode can leave a drawing unfinished.
+  iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+  return err_msg;
+}
 
-static bool  //
-iconvg_private_decoder__decode_magic_identifier(iconvg_private_decoder* self) {
-  if ((self->len < 4) ||         //
-      (self->ptr[0] != 0x89) ||  //
-      (self->ptr[1] != 0x49) ||  //
-      (self->ptr[2] != 0x56) ||  //
-      (self->ptr[3] != 0x47)) {
-    return false;
+static const char*  //
+iconvg_private_rasterizer_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  r->start_x = 0.0f;
+  r->start_y = 0.0f;
+  r->current_x = 0.0f;
+  r->current_y = 0.0f;
+  return NULL;
+}
+
+// ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN is the length, in bytes, of each
+// drawing's record header in an iconvg_coverage_masks buffer: four uint32
+// values (little-endian) for min_x, min_y, width and height, the rectangle
+// that bounds the drawing's coverage. The header is followed by height rows.
+#define ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN 16
+
+// ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN is the length, in bytes, of
+// each row's header: two uint32 values (little-endian) for the row's x offset
+// (relative to min_x) and length n. The row header is followed by n coverage
+// bytes, which start and end with non-zero coverage. A row whose coverage is
+// all zero has n = 0.
+#define ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN 8
+
+// iconvg_private_coverage_masks__reserve claims the next len bytes of the
+// buffer and returns where they start, or NULL if they do not fit. Either way,
+// buf_used grows by len (saturating at SIZE_MAX), so that it ends up as the
+// required length.
+static uint8_t*  //
+iconvg_private_coverage_masks__reserve(iconvg_coverage_masks* self,
+                                       size_t len) {
+  size_t used = self->private_impl.buf_used;
+  if (self->private_impl.overflowed ||
+      (len > (self->private_impl.buf_len - used))) {
+    self->private_impl.overflowed = true;
+    self->private_impl.buf_used = (len > (SIZE_MAX - used)) ? SIZE_MAX  //
+                                                            : (used + len);
+    return NULL;
   }
-  self->ptr += 4;
-  self->len -= 4;
-  return true;
+  self->private_impl.buf_used = used + len;
+  return self->private_impl.buf_ptr + used;
 }
 
-static bool  //
-iconvg_private_decoder__decode_metadata_viewbox(iconvg_private_decoder* self,
-                                                iconvg_rectangle_f32* dst) {
-  return iconvg_private_decoder__decode_coordinate_number(self, &dst->min_x) &&
-         iconvg_private_decoder__decode_coordinate_number(self, &dst->min_y) &&
-         iconvg_private_decoder__decode_coordinate_number(self, &dst->max_x) &&
-         iconvg_private_decoder__decode_coordinate_number(self, &dst->max_y) &&
-         (-INFINITY < dst->min_x) &&    //
-         (dst->min_x <= dst->max_x) &&  //
-         (dst->max_x < +INFINITY) &&    //
-         (-INFINITY < dst->min_y) &&    //
-         (dst->min_y <= dst->max_y) &&  //
-         (dst->max_y < +INFINITY);
+// iconvg_private_coverage_masks__append adds the header of a record for a
+// drawing whose coverage is bounded by the num_rows rows of n pixels each,
+// starting at (min_x, min_y). The caller then adds num_rows row records.
+static void  //
+iconvg_private_coverage_masks__append(iconvg_coverage_masks* self,
+                                      int32_t min_x,
+                                      int32_t min_y,
+                                      int32_t n,
+                                      int32_t num_rows) {
+  self->private_impl.num_masks++;
+  uint8_t* p = iconvg_private_coverage_masks__reserve(
+      self, ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN);
+  if (p) {
+    iconvg_private_poke_u32le(p + 0, (uint32_t)min_x);
+    iconvg_private_poke_u32le(p + 4, (uint32_t)min_y);
+    iconvg_private_poke_u32le(p + 8, (uint32_t)n);
+    iconvg_private_poke_u32le(p + 12, (uint32_t)num_rows);
+  }
+}
+
+// iconvg_private_coverage_masks__append_row adds a row record, for the n
+// coverage bytes that start x pixels to the right of the record's min_x.
+static void  //
+iconvg_private_coverage_masks__append_row(iconvg_coverage_masks* self,
+                                          int32_t x,
+                                          const uint8_t* coverage,
+                                          int32_t n) {
+  uint8_t* p = iconvg_private_coverage_masks__reserve(
+      self, ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN + ((size_t)n));
+  if (p) {
+    iconvg_private_poke_u32le(p + 0, (uint32_t)x);
+    iconvg_private_poke_u32le(p + 4, (uint32_t)n);
+    memcpy(p + ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN, coverage,
+           (size_t)n);
+  }
 }
 
+// iconvg_private_rasterizer_paint is a drawing's paint, prepared for
+// compositing rows of coverage.
+typedef struct iconvg_private_rasterizer_paint_struct {
+  iconvg_paint_type paint_type;
+  uint8_t flat[4];
+  iconvg_gradient_spread spread;
+  iconvg_matrix_2x3_f64 gtm;
+  // gradient_lut points to 256 premultiplied RGBA colors, as per
+  // iconvg_private_rasterizer's field of the same name.
+  const uint8_t* gradient_lut;
+} iconvg_private_rasterizer_paint;
+
+// iconvg_private_rasterizer_paint__initialize prepares p, filling
+// gradient_lut (256 * 4 bytes) if p is a gradient. It returns false if p's
+// paint type is invalid.
 static bool  //
-iconvg_private_decoder__decode_metadata_suggested_palette(
-    iconvg_private_decoder* self,
-    iconvg_palette* dst) {
-  if (self->len == 0) {
-    return false;
+iconvg_private_rasterizer_paint__initialize(
+    iconvg_private_rasterizer_paint* self,
+    uint8_t* gradient_lut,
+    const iconvg_paint* p) {
+  memset(self, 0, sizeof(*self));
+  self->paint_type = iconvg_paint__type(p);
+  self->gradient_lut = gradient_lut;
+  switch (self->paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+      memcpy(&self->flat[0], &k.rgba[0], 4);
+      return true;
+    }
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      self->spread = iconvg_paint__gradient_spread(p);
+      self->gtm = iconvg_paint__gradient_transformation_matrix(p);
+      iconvg_private_rasterizer__fill_gradient_lut(gradient_lut, p);
+      return true;
+    default:
+      break;
   }
-  uint8_t spec = self->ptr[0];
-  self->ptr += 1;
-  self->len -= 1;
+  return false;
+}
 
-  size_t n = 1 + (spec & 0x3F);
-  size_t bytes_per_elem = 1 + (spec >> 6);
-  if (self->len != (n * bytes_per_elem)) {
-    return false;
+// iconvg_private_rasterizer_paint__blend_row composites self, weighted by
+// coverage[0 .. n], onto the n pixels starting at pix, which is the pixel at
+// (x0, iy) of the pixel buffer.
+static void  //
+iconvg_private_rasterizer_paint__blend_row(
+    const iconvg_private_rasterizer_paint* self,
+    const iconvg_private_rasterizer_kernels* k,
+    uint8_t* pix,
+    const uint8_t* coverage,
+    int32_t n,
+    int32_t x0,
+    int32_t iy) {
+  if (self->paint_type == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    (*k->blend_flat)(pix, coverage, (size_t)n, &self->flat[0]);
+    return;
   }
-  const uint8_t* p = self->ptr;
-  self->ptr += self->len;
-  self->len = 0;
 
-  iconvg_premul_color* c = &dst->colors[0];
-  switch (bytes_per_elem) {
-    case 1:
-      for (; n > 0; n--) {
-        uint8_t u = *p++;
-        uint32_t rgba =
-            (u < 0x80) ? iconvg_private_peek_u32le(
-                             &iconvg_private_one_byte_colors[4 * ((size_t)u)])
-                       : 0xFF000000u;
-        iconvg_private_poke_u32le(&c->rgba[0], rgba);
-        c++;
-      }
-      break;
+  // For gradients, (gx, gy) is the pattern space position of the center of
+  // the pixel at (ix, iy). It advances by (gtm[0][0], gtm[1][0]) per pixel.
+  const iconvg_matrix_2x3_f64* gtm = &self->gtm;
+  double px = ((double)x0) + 0.5;
+  double py = ((double)iy) + 0.5;
+  double gx = (gtm->elems[0][0] * px) + (gtm->elems[0][1] * py) +  //
+              gtm->elems[0][2];
+  double gy = (gtm->elems[1][0] * px) + (gtm->elems[1][1] * py) +  //
+              gtm->elems[1][2];
+
+  for (int32_t i = 0; i < n;
+       i++, pix += 4, gx += gtm->elems[0][0], gy += gtm->elems[1][0]) {
+    if (coverage[i] == 0) {
+      continue;
+    }
+    int32_t j = iconvg_private_rasterizer__gradient_lut_index(
+        (self->paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT)
+            ? gx
+            : sqrt((gx * gx) + (gy * gy)),
+        self->spread);
+    if (j >= 0) {
+      iconvg_private_rasterizer__blend_pixel(pix, coverage[i],
+                                             &self->gradient_lut[4 * j]);
+    }
+  }
+}
 
-    case 2:
-      for (; n > 0; n--) {
-        uint8_t rg = *p++;
-        c->rgba[0] = 0x11 * (rg >> 4);
-        c->rgba[1] = 0x11 * (rg & 0x0F);
-        uint8_t ba = *p++;
-        c->rgba[2] = 0x11 * (ba >> 4);
-        c->rgba[3] = 0x11 * (ba & 0x0F);
-        c++;
-      }
-      break;
+static const char*  //
+iconvg_private_rasterizer_canvas__end_drawing(iconvg_canvas* c,
+                                              const iconvg_paint* p) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+
+  iconvg_private_rasterizer_paint rp;
+  if (!iconvg_private_rasterizer_paint__initialize(&rp, &r->gradient_lut[0],
+                                                   p)) {
+    iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+    return iconvg_error_invalid_paint_type;
+  }
 
-    case 3:
-      for (; n > 0; n--) {
-        c->rgba[0] = *p++;
-        c->rgba[1] = *p++;
-        c->rgba[2] = *p++;
-        c->rgba[3] = 0xFF;
-        c++;
-      }
-      break;
+  // Only the dirty rectangle (clipped) can have non-zero coverage. Elements
+  // to its right sum to zero, as every path is closed.
+  int32_t min_x = (r->dirty_min_x > r->clip_min_x) ? r->dirty_min_x  //
+                                                   : r->clip_min_x;
+  int32_t min_y = (r->dirty_min_y > r->clip_min_y) ? r->dirty_min_y  //
+                                                   : r->clip_min_y;
+  int32_t max_x = (r->dirty_max_x < r->clip_max_x) ? r->dirty_max_x  //
+                                                   : r->clip_max_x;
+  int32_t max_y = (r->dirty_max_y < r->clip_max_y) ? r->dirty_max_y  //
+                                                   : r->clip_max_y;
+  if ((min_x >= max_x) || (min_y >= max_y)) {
+    max_x = min_x;
+    max_y = min_y;
+  }
+  const int32_t n = max_x - min_x;
+  const size_t acc_stride =
+      ((size_t)(c->context.extra6)) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  const float* acc_row = iconvg_private_rasterizer_canvas__acc(c) +
+                         (((size_t)min_y) * acc_stride);
+  uint8_t* pix_row = ((uint8_t*)(c->context.nonconst_ptr1)) +
+                     (((size_t)min_y) * c->context.extra5);
+
+  uint8_t* coverage = iconvg_private_rasterizer_canvas__coverage(c);
+  const iconvg_private_rasterizer_kernels* k =
+      &iconvg_private_rasterizer_kernels_table[r->kernels];
+
+  // If recording, the drawing's coverage rows go to the masks too.
+  iconvg_coverage_masks* masks =
+      (iconvg_coverage_masks*)(c->context.const_ptr3);
+  if (masks) {
+    iconvg_private_coverage_masks__append(masks, min_x, min_y, n,
+                                          max_y - min_y);
+  }
 
-    case 4:
-      for (; n > 0; n--) {
-        c->rgba[0] = *p++;
-        c->rgba[1] = *p++;
-        c->rgba[2] = *p++;
-        c->rgba[3] = *p++;
-        c++;
-      }
-      break;
+  for (int32_t iy = min_y; iy < max_y;
+       iy++, acc_row += acc_stride, pix_row += c->context.extra5) {
+    float accumulator = 0.0f;
+    for (int32_t ix = r->dirty_min_x; ix < min_x; ix++) {
+      accumulator += acc_row[ix];
+    }
+    (*k->accumulate)(coverage, acc_row + min_x, (size_t)n, accumulator);
+
+    // Trim the row's zero coverage from both ends.
+    int32_t i0 = 0;
+    int32_t i1 = n;
+    while ((i0 < i1) && (coverage[i0] == 0)) {
+      i0++;
+    }
+    while ((i1 > i0) && (coverage[i1 - 1] == 0)) {
+      i1--;
+    }
+    if (masks) {
+      iconvg_private_coverage_masks__append_row(masks, i0, coverage + i0,
+                                                i1 - i0);
+    }
+    if (i0 < i1) {
+      uint8_t* pix = pix_row + (4 * ((size_t)(min_x + i0)));
+      iconvg_private_rasterizer_paint__blend_row(
+          &rp, k, pix, coverage + i0, i1 - i0, min_x + i0, iy);
+    }
   }
-  return true;
+
+  iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+  return NULL;
 }
 
-// ----
+static const char*  //
+iconvg_private_rasterizer_canvas__begin_path(iconvg_canvas* c,
+                                             float x0,
+                                             float y0) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  r->start_x = x0;
+  r->start_y = y0;
+  r->current_x = x0;
+  r->current_y = y0;
+  return NULL;
+}
 
 static const char*  //
-iconvg_private_execute_bytecode(iconvg_canvas* c_arg,
-                                iconvg_rectangle_f32 r,
-                                iconvg_private_decoder* d,
-                                iconvg_paint* state) {
-  // adjustments are the ADJ values from the IconVG spec.
-  static const uint32_t adjustments[8] = {0, 1, 2, 3, 4, 5, 6, 0};
+iconvg_private_rasterizer_canvas__end_path(iconvg_canvas* c) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  iconvg_private_rasterizer_canvas__line_to(c, r->start_x, r->start_y);
+  return NULL;
+}
 
-  iconvg_canvas no_op_canvas = iconvg_canvas__make_broken(NULL);
-  iconvg_canvas* c = &no_op_canvas;
+static const char*  //
+iconvg_private_rasterizer_canvas__path_line_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1) {
+  iconvg_private_rasterizer_canvas__line_to(c, x1, y1);
+  return NULL;
+}
 
-  // Drawing ops will typically set curr_x and curr_y. They also set x1 and y1
-  // in case the subsequent op is smooth and needs an implicit point.
-  float curr_x = +0.0f;
-  float curr_y = +0.0f;
-  float x1 = +0.0f;
-  float y1 = +0.0f;
-  float x2 = +0.0f;
-  float y2 = +0.0f;
-  float x3 = +0.0f;
-  float y3 = +0.0f;
-  uint32_t flags = 0;
+static const char*  //
+iconvg_private_rasterizer_canvas__path_quad_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2) {
+  iconvg_private_rasterizer_canvas__quad_to(c, x1, y1, x2, y2);
+  return NULL;
+}
 
-  double scale_x = +1.0;
-  double bias_x = +0.0;
-  double scale_y = +1.0;
-  double bias_y = +0.0;
-  {
-    double rw = iconvg_rectangle_f32__width_f64(&r);
-    double rh = iconvg_rectangle_f32__height_f64(&r);
-    double vw = iconvg_rectangle_f32__width_f64(&state->viewbox);
-    double vh = iconvg_rectangle_f32__height_f64(&state->viewbox);
-    if ((rw > 0) && (rh > 0) && (vw > 0) && (vh > 0)) {
-      scale_x = rw / vw;
-      scale_y = rh / vh;
-      bias_x = r.min_x - (state->viewbox.min_x * scale_x);
-      bias_y = r.min_y - (state->viewbox.min_y * scale_y);
-    }
-  }
-  state->s2d_scale_x = scale_x;
-  state->s2d_bias_x = bias_x;
-  state->s2d_scale_y = scale_y;
-  state->s2d_bias_y = bias_y;
-  state->d2s_scale_x = 1.0 / scale_x;
-  state->d2s_bias_x = -bias_x * state->d2s_scale_x;
-  state->d2s_scale_y = 1.0 / scale_y;
-  state->d2s_bias_y = -bias_y * state->d2s_scale_y;
+static const char*  //
+iconvg_private_rasterizer_canvas__path_cube_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2,
+                                               float x3,
+                                               float y3) {
+  iconvg_private_rasterizer_canvas__cube_to(c, x1, y1, x2, y2, x3, y3);
+  return NULL;
+}
 
-  // sel[0] and sel[1] are the CSEL and NSEL registers.
-  uint32_t sel[2] = {0};
-  double lod[2];
-  lod[0] = 0.0;
-  lod[1] = INFINITY;
+static const char*  //
+iconvg_private_rasterizer_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
 
-styling_mode:
-  while (true) {
-    if (d->len == 0) {
-      return NULL;
-    }
-    uint8_t opcode = d->ptr[0];
-    d->ptr += 1;
-    d->len -= 1;
+static const char*  //
+iconvg_private_rasterizer_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
 
-    if (opcode < 0x80) {
-      sel[opcode >> 6] = opcode & 0x3F;
-      continue;
+static const char*  //
+iconvg_private_rasterizer_canvas__path_segments(iconvg_canvas* c,
+                                                const uint8_t* verbs,
+                                                size_t num_verbs,
+                                                const float* points) {
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        iconvg_private_rasterizer_canvas__line_to(c, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        iconvg_private_rasterizer_canvas__quad_to(c, points[0], points[1],
+                                                  points[2], points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        iconvg_private_rasterizer_canvas__cube_to(c, points[0], points[1],
+                                                  points[2], points[3],
+                                                  points[4], points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
 
-    } else if (opcode < 0x88) {  // Set CREG[etc]; 1 byte color.
-      if (d->len < 1) {
-        return iconvg_error_bad_color;
-      }
-      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
-      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
-      iconvg_private_set_one_byte_color(rgba, &state->custom_palette,
-                                        &state->creg, d->ptr[0]);
-      d->ptr += 1;
-      d->len -= 1;
-      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+static const char*  //
+iconvg_private_rasterizer_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  // If recording, an empty record keeps the masks in step with the drawings,
+  // for a compositor (replaying a compiled form) that does not skip this one.
+  iconvg_coverage_masks* masks =
+      (iconvg_coverage_masks*)(c->context.const_ptr3);
+  if (masks) {
+    iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+    iconvg_private_coverage_masks__append(masks, r->clip_min_x, r->clip_min_y,
+                                          0, 0);
+  }
+  return NULL;
+}
 
-    } else if (opcode < 0x90) {  // Set CREG[etc]; 2 byte color.
-      if (d->len < 2) {
-        return iconvg_error_bad_color;
-      }
-      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
-      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
-      rgba[0] = 0x11 * (d->ptr[0] >> 4);
-      rgba[1] = 0x11 * (d->ptr[0] & 0x0F);
-      rgba[2] = 0x11 * (d->ptr[1] >> 4);
-      rgba[3] = 0x11 * (d->ptr[1] & 0x0F);
-      d->ptr += 2;
-      d->len -= 2;
-      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+static const iconvg_canvas_vtable  //
+    iconvg_private_rasterizer_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_rasterizer_canvas__begin_decode,
+        &iconvg_private_rasterizer_canvas__end_decode,
+        &iconvg_private_rasterizer_canvas__begin_drawing,
+        &iconvg_private_rasterizer_canvas__end_drawing,
+        &iconvg_private_rasterizer_canvas__begin_path,
+        &iconvg_private_rasterizer_canvas__end_path,
+        &iconvg_private_rasterizer_canvas__path_line_to,
+        &iconvg_private_rasterizer_canvas__path_quad_to,
+        &iconvg_private_rasterizer_canvas__path_cube_to,
+        &iconvg_private_rasterizer_canvas__on_metadata_viewbox,
+        &iconvg_private_rasterizer_canvas__on_metadata_suggested_palette,
+        &iconvg_private_rasterizer_canvas__path_segments,
+        &iconvg_private_rasterizer_canvas__on_skipped_drawing,
+};
 
-    } else if (opcode < 0x98) {  // Set CREG[etc]; 3 byte (direct) color.
-      if (d->len < 3) {
-        return iconvg_error_bad_color;
-      }
-      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
-      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
-      rgba[0] = d->ptr[0];
-      rgba[1] = d->ptr[1];
-      rgba[2] = d->ptr[2];
-      rgba[3] = 0xFF;
-      d->ptr += 3;
-      d->len -= 3;
-      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+size_t  //
+iconvg_rasterizer_scratch_len(uint32_t pixels_width, uint32_t pixels_height) {
+  if ((pixels_width == 0) || (pixels_width > 0x100000) ||
+      (pixels_height == 0) || (pixels_height > 0x100000)) {
+    return 0;
+  }
+  size_t acc_stride =
+      ((size_t)pixels_width) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  size_t coverage_len = (((size_t)pixels_width) + sizeof(float) - 1) /
+                        sizeof(float);
+  size_t max = ((size_t)(-1)) / sizeof(float);
+  if (acc_stride > ((max - ICONVG_PRIVATE_RASTERIZER_HEADER_LEN -
+                     coverage_len) /
+                    ((size_t)pixels_height))) {
+    return 0;
+  }
+  return ICONVG_PRIVATE_RASTERIZER_HEADER_LEN +
+         (acc_stride * ((size_t)pixels_height)) + coverage_len;
+}
 
-    } else if (opcode < 0xA0) {  // Set CREG[etc]; 4 byte color.
-      if (d->len < 4) {
-        return iconvg_error_bad_color;
-      }
-      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
-      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
-      rgba[0] = d->ptr[0];
-      rgba[1] = d->ptr[1];
-      rgba[2] = d->ptr[2];
-      rgba[3] = d->ptr[3];
-      d->ptr += 4;
-      d->len -= 4;
-      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+iconvg_canvas  //
+iconvg_canvas__make_rasterizer(uint8_t* pixels_ptr,
+                               size_t pixels_stride,
+                               uint32_t pixels_width,
+                               uint32_t pixels_height,
+                               float* scratch_ptr,
+                               size_t scratch_len) {
+  size_t min_scratch_len =
+      iconvg_rasterizer_scratch_len(pixels_width, pixels_height);
+  if (!pixels_ptr || !scratch_ptr || (min_scratch_len == 0) ||
+      (scratch_len < min_scratch_len) ||
+      ((pixels_stride / 4) < ((size_t)pixels_width))) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  memset(scratch_ptr, 0, min_scratch_len * sizeof(float));
 
-    } else if (opcode < 0xA8) {  // Set CREG[etc]; 3 byte (indirect) color.
-      if (d->len < 3) {
-        return iconvg_error_bad_color;
-      }
-      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
-      uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
-      uint8_t p[4] = {0};
-      uint8_t q[4] = {0};
-      iconvg_private_set_one_byte_color(&p[0], &state->custom_palette,
-                                        &state->creg, d->ptr[1]);
-      iconvg_private_set_one_byte_color(&q[0], &state->custom_palette,
-                                        &state->creg, d->ptr[2]);
-      uint32_t q_blend = d->ptr[0];
-      uint32_t p_blend = 255 - q_blend;
-      rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
-      rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
-      rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
-      rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
-      d->ptr += 3;
-      d->len -= 3;
-      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_rasterizer_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = pixels_ptr;
+  c.context.nonconst_ptr2 = scratch_ptr;
+  c.context.extra5 = pixels_stride;
+  c.context.extra6 = pixels_width;
+  c.context.extra7 = pixels_height;
+
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(&c);
+  r->clip_max_x = (int32_t)pixels_width;
+  r->clip_max_y = (int32_t)pixels_height;
+  r->dirty_min_x = (int32_t)pixels_width;
+  r->dirty_min_y = (int32_t)pixels_height;
+  r->dirty_max_x = 0;
+  r->dirty_max_y = 0;
+  r->kernels = iconvg_private_rasterizer__choose_kernels();
+  return c;
+}
 
-    } else if (opcode < 0xB0) {  // Set NREG[etc]; real number.
-      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
-      float* num = &state->nreg[nreg_index];
-      if (!iconvg_private_decoder__decode_real_number(d, num)) {
-        return iconvg_error_bad_number;
-      }
-      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+// ----
 
-    } else if (opcode < 0xB8) {  // Set NREG[etc]; coordinate number.
-      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
-      float* num = &state->nreg[nreg_index];
-      if (!iconvg_private_decoder__decode_coordinate_number(d, num)) {
-        return iconvg_error_bad_coordinate;
-      }
-      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+const char*  //
+iconvg_coverage_masks__initialize(iconvg_coverage_masks* self,
+                                  uint8_t* buf_ptr,
+                                  size_t buf_len) {
+  if (!self || !buf_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  self->private_impl.buf_ptr = buf_ptr;
+  self->private_impl.buf_len = buf_len;
+  return NULL;
+}
 
-    } else if (opcode < 0xC0) {  // Set NREG[etc]; zero-to-one number.
-      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
-      float* num = &state->nreg[nreg_index];
-      if (!iconvg_private_decoder__decode_zero_to_one_number(d, num)) {
-        return iconvg_error_bad_number;
-      }
-      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
-      continue;
+size_t  //
+iconvg_coverage_masks__required_len(const iconvg_coverage_masks* self) {
+  return self ? self->private_impl.buf_used : 0;
+}
 
-    } else if (opcode < 0xC7) {  // Switch to the drawing mode.
-      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
-      memcpy(&state->paint_rgba, &state->creg.colors[creg_index],
-             sizeof(state->paint_rgba));
-      if (iconvg_paint__type(state) == ICONVG_PAINT_TYPE__INVALID) {
-        return iconvg_error_invalid_paint_type;
-      }
-      if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
-          !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
-        return iconvg_error_bad_coordinate;
-      }
-      double h = (double)state->height_in_pixels;
-      c = ((lod[0] <= h) && (h < lod[1])) ? c_arg : &no_op_canvas;
-      ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
-      ICONVG_PRIVATE_TRY(
-          (*c->vtable->begin_path)(c,                            //
-                                   (curr_x * scale_x) + bias_x,  //
-                                   (curr_y * scale_y) + bias_y));
-      x1 = curr_x;
-      y1 = curr_y;
-      goto drawing_mode;
+iconvg_canvas  //
+iconvg_canvas__make_rasterizer_with_coverage_masks(
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len,
+    iconvg_coverage_masks* masks) {
+  if (!masks) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  iconvg_canvas c =
+      iconvg_canvas__make_rasterizer(pixels_ptr, pixels_stride, pixels_width,
+                                     pixels_height, scratch_ptr, scratch_len);
+  if (c.vtable == &iconvg_private_rasterizer_canvas_vtable) {
+    c.context.const_ptr3 = masks;
+  }
+  return c;
+}
 
-    } else if (opcode < 0xC8) {  // Set Level of Detail bounds.
-      float lod0;
-      float lod1;
-      if (!iconvg_private_decoder__decode_real_number(d, &lod0) ||
-          !iconvg_private_decoder__decode_real_number(d, &lod1)) {
-        return iconvg_error_bad_number;
-      }
-      lod[0] = (double)lod0;
-      lod[1] = (double)lod1;
-      continue;
-    }
+const char*  //
+iconvg_private_coverage_compositor__initialize(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_coverage_masks* masks,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect) {
+  if (!masks || !pixels_ptr || ((pixels_stride / 4) < pixels_width)) {
+    return iconvg_error_invalid_constructor_argument;
+  } else if (!masks->private_impl.buf_ptr || masks->private_impl.overflowed ||
+             (masks->private_impl.pixels_width != pixels_width) ||
+             (masks->private_impl.pixels_height != pixels_height) ||
+             (masks->private_impl.dst_rect[0] != dst_rect.min_x) ||
+             (masks->private_impl.dst_rect[1] != dst_rect.min_y) ||
+             (masks->private_impl.dst_rect[2] != dst_rect.max_x) ||
+             (masks->private_impl.dst_rect[3] != dst_rect.max_y)) {
+    return iconvg_error_invalid_coverage_masks;
+  }
+  self->masks = masks;
+  self->offset = 0;
+  self->pixels_ptr = pixels_ptr;
+  self->pixels_stride = pixels_stride;
+  self->kernels = iconvg_private_rasterizer__choose_kernels();
+  return NULL;
+}
 
-    return iconvg_error_bad_styling_opcode;
+const char*  //
+iconvg_private_coverage_compositor__composite(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_paint* p) {
+  const iconvg_coverage_masks* masks = self->masks;
+  size_t used = masks->private_impl.buf_used;
+  if ((used - self->offset) < ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN) {
+    return iconvg_error_invalid_coverage_masks;
+  }
+  const uint8_t* q = masks->private_impl.buf_ptr + self->offset;
+  uint32_t min_x = iconvg_private_peek_u32le(q + 0);
+  uint32_t min_y = iconvg_private_peek_u32le(q + 4);
+  uint32_t n = iconvg_private_peek_u32le(q + 8);
+  uint32_t num_rows = iconvg_private_peek_u32le(q + 12);
+  q += ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN;
+  self->offset += ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN;
+
+  // The recording canvas clipped each record to the pixel buffer, so these
+  // checks only fail for corrupted masks.
+  uint32_t w = masks->private_impl.pixels_width;
+  uint32_t h = masks->private_impl.pixels_height;
+  if ((min_x > w) || (n > (w - min_x)) || (min_y > h) ||
+      (num_rows > (h - min_y))) {
+    return iconvg_error_invalid_coverage_masks;
   }
 
-drawing_mode:
-  while (true) {
-    if (d->len == 0) {
-      return iconvg_error_bad_path_unfinished;
+  iconvg_private_rasterizer_paint rp;
+  if (p && !iconvg_private_rasterizer_paint__initialize(
+               &rp, &self->gradient_lut[0], p)) {
+    return iconvg_error_invalid_paint_type;
+  }
+  const iconvg_private_rasterizer_kernels* k =
+      &iconvg_private_rasterizer_kernels_table[self->kernels];
+  uint8_t* pix_row = self->pixels_ptr +
+                     (((size_t)min_y) * self->pixels_stride) +
+                     (4 * ((size_t)min_x));
+  for (uint32_t y = 0; y < num_rows; y++, pix_row += self->pixels_stride) {
+    if ((used - self->offset) < ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN) {
+      return iconvg_error_invalid_coverage_masks;
+    }
+    uint32_t x = iconvg_private_peek_u32le(q + 0);
+    uint32_t row_len = iconvg_private_peek_u32le(q + 4);
+    q += ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN;
+    self->offset += ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN;
+    if ((x > n) || (row_len > (n - x)) ||
+        (row_len > (used - self->offset))) {
+      return iconvg_error_invalid_coverage_masks;
+    }
+    if (p && (row_len > 0)) {
+      iconvg_private_rasterizer_paint__blend_row(
+          &rp, k, pix_row + (4 * ((size_t)x)), q, (int32_t)row_len,
+          (int32_t)(min_x + x), (int32_t)(min_y + y));
     }
-    uint8_t opcode = d->ptr[0];
-    d->ptr += 1;
-    d->len -= 1;
+    q += row_len;
+    self->offset += row_len;
+  }
+  return NULL;
+}
 
-    switch (opcode >> 4) {
-      case 0x00:
-      case 0x01: {  // 'L' mnemonic: absolute line_to.
-        for (int reps = opcode & 0x1F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_line_to)(c,                            //
-                                         (curr_x * scale_x) + bias_x,  //
-                                         (curr_y * scale_y) + bias_y));
-          x1 = curr_x;
-          y1 = curr_y;
-        }
-        continue;
-      }
+const char*  //
+iconvg_private_coverage_compositor__finish(
+    const iconvg_private_coverage_compositor* self) {
+  return (self->offset == self->masks->private_impl.buf_used)
+             ? NULL
+             : iconvg_error_invalid_coverage_masks;
+}
 
-      case 0x02:
-      case 0x03: {  // 'l' mnemonic: relative line_to.
-        for (int reps = opcode & 0x1F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
-            return iconvg_error_bad_coordinate;
-          }
-          curr_x += x1;
-          curr_y += y1;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_line_to)(c,                            //
-                                         (curr_x * scale_x) + bias_x,  //
-                                         (curr_y * scale_y) + bias_y));
-          x1 = curr_x;
-          y1 = curr_y;
-        }
-        continue;
-      }
+// -------------------------------- #include "./rectangle.c"
 
-      case 0x04: {  // 'T' mnemonic: absolute smooth quad_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
-          curr_x = x2;
-          curr_y = y2;
-          x1 = (2 * curr_x) - x1;
-          y1 = (2 * curr_y) - y1;
-        }
-        continue;
-      }
+// Note that iconvg_rectangle_f32 fields may be NaN, so that (min < max) is not
+// the same as !(min >= max).
 
-      case 0x05: {  // 't' mnemonic: relative smooth quad_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          x2 += curr_x;
-          y2 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
-          curr_x = x2;
-          curr_y = y2;
-          x1 = (2 * curr_x) - x1;
-          y1 = (2 * curr_y) - y1;
-        }
-        continue;
-      }
+bool  //
+iconvg_rectangle_f32__is_finite_and_not_empty(
+    const iconvg_rectangle_f32* self) {
+  return self &&                         //
+         (-INFINITY < self->min_x) &&    //
+         (self->min_x < self->max_x) &&  //
+         (self->max_x < +INFINITY) &&    //
+         (-INFINITY < self->min_y) &&    //
+         (self->min_y < self->max_y) &&  //
+         (self->max_y < +INFINITY);
+}
 
-      case 0x06: {  // 'Q' mnemonic: absolute quad_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
-          curr_x = x2;
-          curr_y = y2;
-          x1 = (2 * curr_x) - x1;
-          y1 = (2 * curr_y) - y1;
-        }
-        continue;
-      }
+double  //
+iconvg_rectangle_f32__width_f64(const iconvg_rectangle_f32* self) {
+  if (self && (self->max_x > self->min_x)) {
+    return ((double)self->max_x) - ((double)self->min_x);
+  }
+  return 0.0;
+}
 
-      case 0x07: {  // 'q' mnemonic: relative quad_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          x1 += curr_x;
-          y1 += curr_y;
-          x2 += curr_x;
-          y2 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
-          curr_x = x2;
-          curr_y = y2;
-          x1 = (2 * curr_x) - x1;
-          y1 = (2 * curr_y) - y1;
-        }
-        continue;
-      }
+double  //
+iconvg_rectangle_f32__height_f64(const iconvg_rectangle_f32* self) {
+  if (self && (self->max_y > self->min_y)) {
+    return ((double)self->max_y) - ((double)self->min_y);
+  }
+  return 0.0;
+}
 
-      case 0x08: {  // 'S' mnemonic: absolute smooth cube_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
-          curr_x = x3;
-          curr_y = y3;
-          x1 = (2 * curr_x) - x2;
-          y1 = (2 * curr_y) - y2;
-        }
-        continue;
-      }
+// -------------------------------- #include "./skia.c"
 
-      case 0x09: {  // 's' mnemonic: relative smooth cube_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
-            return iconvg_error_bad_coordinate;
-          }
-          x2 += curr_x;
-          y2 += curr_y;
-          x3 += curr_x;
-          y3 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
-          curr_x = x3;
-          curr_y = y3;
-          x1 = (2 * curr_x) - x2;
-          y1 = (2 * curr_y) - y2;
-        }
-        continue;
-      }
+#if !defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
 
-      case 0x0A: {  // 'C' mnemonic: absolute cube_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
-          curr_x = x3;
-          curr_y = y3;
-          x1 = (2 * curr_x) - x2;
-          y1 = (2 * curr_y) - y2;
-        }
-        continue;
-      }
+iconvg_canvas  //
+iconvg_canvas__make_skia(sk_canvas_t* sc) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
 
-      case 0x0B: {  // 'c' mnemonic: relative cube_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
-            return iconvg_error_bad_coordinate;
-          }
-          x1 += curr_x;
-          y1 += curr_y;
-          x2 += curr_x;
-          y2 += curr_y;
-          x3 += curr_x;
-          y3 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
-          curr_x = x3;
-          curr_y = y3;
-          x1 = (2 * curr_x) - x2;
-          y1 = (2 * curr_y) - y2;
-        }
-        continue;
-      }
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_gradient_cache(sk_canvas_t* sc,
+                                             iconvg_gradient_cache* gc) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
 
-      case 0x0C: {  // 'A' mnemonic: absolute arc_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          float x0 = curr_x;
-          float y0 = curr_y;
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
-              !iconvg_private_decoder__decode_zero_to_one_number(d, &x2) ||
-              !iconvg_private_decoder__decode_natural_number(d, &flags) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY(iconvg_private_path_arc_to(
-              c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
-              flags & 0x01, flags & 0x02, curr_x, curr_y));
-          x1 = curr_x;
-          y1 = curr_y;
-        }
-        continue;
-      }
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_arena(sk_canvas_t* sc,
+                                    iconvg_gradient_cache* gc,
+                                    iconvg_arena* arena) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
 
-      case 0x0D: {  // 'a' mnemonic: relative arc_to.
-        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          float x0 = curr_x;
-          float y0 = curr_y;
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
-              !iconvg_private_decoder__decode_zero_to_one_number(d, &x2) ||
-              !iconvg_private_decoder__decode_natural_number(d, &flags) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
-              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
-            return iconvg_error_bad_coordinate;
-          }
-          curr_x += x3;
-          curr_y += y3;
-          ICONVG_PRIVATE_TRY(iconvg_private_path_arc_to(
-              c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
-              flags & 0x01, flags & 0x02, curr_x, curr_y));
-          x1 = curr_x;
-          y1 = curr_y;
-        }
-        continue;
-      }
-    }
+#else  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
+
+#include <stdlib.h>
+
+#include "include/c/sk_canvas.h"
+#include "include/c/sk_matrix.h"
+#include "include/c/sk_paint.h"
+#include "include/c/sk_path.h"
+#include "include/c/sk_shader.h"
 
-    switch (opcode) {
-      case 0xE1: {  // 'z' mnemonic: close_path.
-        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-        ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, state));
-        goto styling_mode;
-      }
+static const sk_shader_tilemode_t
+    iconvg_private_gradient_spread_as_sk_shader_tilemode_t[4] = {
+        CLAMP_SK_SHADER_TILEMODE,   //
+        CLAMP_SK_SHADER_TILEMODE,   //
+        MIRROR_SK_SHADER_TILEMODE,  //
+        REPEAT_SK_SHADER_TILEMODE   //
+};
 
-      case 0xE2: {  // 'z; M' mnemonics: close_path; absolute move_to.
-        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-        if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
-            !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
-          return iconvg_error_bad_coordinate;
-        }
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->begin_path)(c,                            //
-                                     (curr_x * scale_x) + bias_x,  //
-                                     (curr_y * scale_y) + bias_y));
-        x1 = curr_x;
-        y1 = curr_y;
-        continue;
-      }
+// iconvg_private_skia_state is the Skia canvas' per-decode state, pointed to
+// by context.nonconst_ptr2 between begin_decode and end_decode.
+//
+// The path builder and paint are re-used by every drawing (the path builder
+// is reset by sk_pathbuilder_detach_path) instead of being created and
+// destroyed per drawing.
+//
+// Without a gradient cache (from iconvg_canvas__make_skia_with_gradient_cache)
+// the last gradient shader is kept, so that consecutive drawings with the
+// same gradient stops share one (pattern space) sk_shader_t.
+//
+// With an arena (from iconvg_canvas__make_skia_with_arena) the state itself
+// is carved from the arena, which the caller resets, instead of being
+// malloc'ed and free'd.
+typedef struct iconvg_private_skia_state_struct {
+  bool from_arena;
+  sk_pathbuilder_t* pathbuilder;
+  sk_paint_t* paint;
+  bool paint_has_shader;
+  iconvg_gradient_cache* gradient_cache;
+  sk_shader_t* last_shader;
+  iconvg_private_gradient_key last_key;
+} iconvg_private_skia_state;
 
-      case 0xE3: {  // 'z; m' mnemonics: close_path; relative move_to.
-        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-        if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
-            !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
-          return iconvg_error_bad_coordinate;
-        }
-        curr_x += x1;
-        curr_y += y1;
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->begin_path)(c,                            //
-                                     (curr_x * scale_x) + bias_x,  //
-                                     (curr_y * scale_y) + bias_y));
-        x1 = curr_x;
-        y1 = curr_y;
-        continue;
-      }
+static void  //
+iconvg_private_skia_release_shader(void* obj) {
+  sk_shader_unref((sk_shader_t*)obj);
+}
 
-      case 0xE6: {  // 'H' mnemonic: absolute horizontal line_to.
-        if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x)) {
-          return iconvg_error_bad_coordinate;
-        }
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
-        x1 = curr_x;
-        y1 = curr_y;
-        continue;
-      }
+static void  //
+iconvg_private_skia_state__delete(iconvg_private_skia_state* state) {
+  if (state->last_shader) {
+    sk_shader_unref(state->last_shader);
+  }
+  if (state->paint) {
+    sk_paint_delete(state->paint);
+  }
+  if (state->pathbuilder) {
+    sk_pathbuilder_delete(state->pathbuilder);
+  }
+  if (!state->from_arena) {
+    free(state);
+  }
+}
 
-      case 0xE7: {  // 'h' mnemonic: relative horizontal line_to.
-        if (!iconvg_private_decoder__decode_coordinate_number(d, &x1)) {
-          return iconvg_error_bad_coordinate;
-        }
-        curr_x += x1;
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
-        x1 = curr_x;
-        y1 = curr_y;
-        continue;
-      }
+// iconvg_private_skia_set_gradient_stops sets the Skia gradient stop colors
+// given the IconVG gradient stop colors.
+//
+// Like iconvg_private_cairo_set_gradient_stops, the complexity is due to
+// premultiplied versus non-premultiplied alpha.
+//
+// It returns the number of Skia stops added.
+static uint32_t  //
+iconvg_private_skia_set_gradient_stops(sk_color_t* gcol,
+                                       float* goff,
+                                       const iconvg_paint* p) {
+  uint32_t ret = 0;
 
-      case 0xE8: {  // 'V' mnemonic: absolute vertical line_to.
-        if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
-          return iconvg_error_bad_coordinate;
-        }
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
-        x1 = curr_x;
-        y1 = curr_y;
-        continue;
-      }
+  // foo0 and foo2 are the previous and current gradient stop. Sometimes we
+  // need to synthesize additional stops in between them, whose variables are
+  // named foo1.
+  double offset0 = 0.0;
+  uint8_t r0 = 0x00;
+  uint8_t g0 = 0x00;
+  uint8_t b0 = 0x00;
+  uint8_t a0 = 0x00;
 
-      case 0xE9: {  // 'v' mnemonic: relative vertical line_to.
-        if (!iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
-          return iconvg_error_bad_coordinate;
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    // Calculate offset and color for the current stop.
+    double offset2 = iconvg_paint__gradient_stop_offset(p, i);
+    iconvg_premul_color k =
+        iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+    uint8_t r2 = k.rgba[0];
+    uint8_t g2 = k.rgba[1];
+    uint8_t b2 = k.rgba[2];
+    uint8_t a2 = k.rgba[3];
+
+    if ((i == 0) ||                        //
+        ((a0 == 0xFF) && (a2 == 0xFF)) ||  //
+        ((a0 == 0x00) && (a2 == 0x00))) {
+      // If it's the first stop, or if we're interpolating from 100% to 100%
+      // opaque or from 0% to 0% opaque, we don't have to worry about
+      // premultiplied versus non-premultiplied alpha.
+      *gcol++ = sk_color_set_argb(a2, r2, g2, b2);
+      *goff++ = offset2;
+      ret++;
+
+    } else if (a0 == 0x00) {
+      // If we're blending e.g. from transparent black to (partially) opaque
+      // blue, insert "transparent blue" immediately after the previous
+      // "transparent black".
+      *gcol++ = sk_color_set_argb(0x00, r2, g2, b2);
+      *goff++ = offset0;
+      *gcol++ = sk_color_set_argb(a2, r2, g2, b2);
+      *goff++ = offset2;
+      ret += 2;
+
+    } else if (a2 == 0x00) {
+      // If we're blending e.g. from (partially) opaque blue to transparent
+      // black, insert "transparent blue" immediately before the current
+      // "transparent black".
+      *gcol++ = sk_color_set_argb(0x00, r0, g0, b0);
+      *goff++ = offset2;
+      *gcol++ = sk_color_set_argb(a2, r2, g2, b2);
+      *goff++ = offset2;
+      ret += 2;
+
+    } else {
+      // Otherwise, fake "interpolate with premultiplied alpha" like
+      // iconvg_private_cairo_set_gradient_stops does.
+      const int32_t n = 16;
+      for (int32_t i = (n - 1); i >= 0; i--) {
+        int32_t j = n - i;
+        double offset1 = ((i * offset0) + (j * offset2)) / n;
+        uint8_t r1 = ((i * r0) + (j * r2)) / n;
+        uint8_t g1 = ((i * g0) + (j * g2)) / n;
+        uint8_t b1 = ((i * b0) + (j * b2)) / n;
+        uint8_t a1 = ((i * a0) + (j * a2)) / n;
+        if (a1 == 0x00) {
+          *gcol++ = sk_color_set_argb(0x00, 0x00, 0x00, 0x00);
+          *goff++ = offset1;
+          ret++;
+        } else {
+          *gcol++ = sk_color_set_argb(a1,                 //
+                                      (0xFF * r1) / a1,   //
+                                      (0xFF * g1) / a1,   //
+                                      (0xFF * b1) / a1);  //
+          *goff++ = offset1;
+          ret++;
         }
-        curr_y += y1;
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
-        x1 = curr_x;
-        y1 = curr_y;
-        continue;
       }
     }
 
-    return iconvg_error_bad_drawing_opcode;
+    // Update offset and color for the previous stop.
+    offset0 = offset2;
+    r0 = r2;
+    g0 = g2;
+    b0 = b2;
+    a0 = a2;
   }
-  return iconvg_private_internal_error_unreachable;
+
+  return ret;
 }
 
-// ----
+// iconvg_private_skia_local_matrix returns the Skia local matrix for a
+// gradient whose transformation matrix (after any linear gradient override) is
+// gtm. The matrix in IconVG's API converts from dst coordinate space to
+// pattern coordinate space. Skia's API is the other way around (matrix
+// inversion).
+static sk_matrix_t  //
+iconvg_private_skia_local_matrix(const iconvg_matrix_2x3_f64* gtm) {
+  iconvg_matrix_2x3_f64 im = *gtm;
+  im = iconvg_matrix_2x3_f64__inverse(&im);
+  sk_matrix_t sm;
+  sm.mat[0] = im.elems[0][0];
+  sm.mat[1] = im.elems[0][1];
+  sm.mat[2] = im.elems[0][2];
+  sm.mat[3] = im.elems[1][0];
+  sm.mat[4] = im.elems[1][1];
+  sm.mat[5] = im.elems[1][2];
+  sm.mat[6] = 0.0f;
+  sm.mat[7] = 0.0f;
+  sm.mat[8] = 1.0f;
+  return sm;
+}
 
-const char*  //
-iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
-                      const uint8_t* src_ptr,
-                      size_t src_len) {
-  iconvg_private_decoder d;
-  d.ptr = src_ptr;
-  d.len = src_len;
+// iconvg_private_skia_make_shader returns a new Skia shader (or NULL) for the
+// gradient paint p, in pattern space: it has no local matrix, so that it does
+// not depend on the dst_rect. It also sets *backend_bytes to a rough estimate
+// of the shader's size.
+static sk_shader_t*  //
+iconvg_private_skia_make_shader(const iconvg_paint* p,
+                                iconvg_paint_type paint_type,
+                                size_t* backend_bytes) {
+  // The gradient is either:
+  //   - linear, from (0, 0) to (1, 0), or
+  //   - radial, centered at (0, 0).
+  sk_point_t gradient_points[2];
+  gradient_points[0].x = 0;
+  gradient_points[0].y = 0;
+  gradient_points[1].x = 1;
+  gradient_points[1].y = 0;
 
-  if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
-    return iconvg_error_bad_magic_identifier;
+  // Configure the gradient stops.
+  //
+  // Skia doesn't have NONE_SK_SHADER_TILEMODE. Use CLAMP_SK_SHADER_TILEMODE
+  // instead, for IconVG's ICONVG_GRADIENT_SPREAD__NONE, adding a transparent
+  // black gradient stop at both ends.
+  //
+  // 1010 equals ((63 * 16) + 2). 63 is the maximum (inclusive) number of
+  // gradient stops. iconvg_private_skia_set_gradient_stops can expand each
+  // IconVG stop to up to 16 Skia stops. There's also 2 extra stops if we
+  // use the ICONVG_GRADIENT_SPREAD__NONE workaround.
+  sk_color_t gradient_colors[1010];
+  float gradient_offsets[1010];
+  sk_color_t* gcol = &gradient_colors[0];
+  float* goff = &gradient_offsets[0];
+  iconvg_gradient_spread gradient_spread = iconvg_paint__gradient_spread(p);
+  uint32_t gradient_num_stops = 0;
+  if (gradient_spread == ICONVG_GRADIENT_SPREAD__NONE) {
+    *gcol++ = sk_color_set_argb(0x00, 0x00, 0x00, 0x00);
+    *goff++ = 0.0f;
+    gradient_num_stops++;
   }
-  uint32_t num_metadata_chunks;
-  if (!iconvg_private_decoder__decode_natural_number(&d,
-                                                     &num_metadata_chunks)) {
-    return iconvg_error_bad_metadata;
+  {
+    uint32_t additional_stops =
+        iconvg_private_skia_set_gradient_stops(gcol, goff, p);
+    gcol += additional_stops;
+    goff += additional_stops;
+    gradient_num_stops += additional_stops;
   }
-
-  bool use_default_viewbox = true;
-  int32_t previous_metadata_id = -1;
-  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
-    uint32_t chunk_length;
-    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
-        (chunk_length > d.len)) {
-      return iconvg_error_bad_metadata;
-    }
-    iconvg_private_decoder chunk =
-        iconvg_private_decoder__limit_u32(&d, chunk_length);
-    uint32_t metadata_id;
-    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
-      return iconvg_error_bad_metadata;
-    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
-      return iconvg_error_bad_metadata_id_order;
-    }
-
-    if (metadata_id == 0) {  // MID 0 (ViewBox).
-      use_default_viewbox = false;
-      iconvg_rectangle_f32 r;
-      if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk, &r) ||
-          (chunk.len != 0)) {
-        return iconvg_error_bad_metadata_viewbox;
-      } else if (dst_viewbox) {
-        *dst_viewbox = r;
-      }
-    }
-
-    iconvg_private_decoder__skip_to_the_end(&chunk);
-    iconvg_private_decoder__advance_to_ptr(&d, chunk.ptr);
-    previous_metadata_id = ((int32_t)metadata_id);
+  if (gradient_spread == ICONVG_GRADIENT_SPREAD__NONE) {
+    *gcol++ = sk_color_set_argb(0x00, 0x00, 0x00, 0x00);
+    *goff++ = 0.0f;
+    gradient_num_stops++;
   }
 
-  if (use_default_viewbox && dst_viewbox) {
-    *dst_viewbox = iconvg_private_default_viewbox();
+  // Make the Skia shader.
+  sk_shader_t* shader = NULL;
+  if (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) {
+    shader = sk_shader_new_linear_gradient(
+        gradient_points, gradient_colors, gradient_offsets, gradient_num_stops,
+        iconvg_private_gradient_spread_as_sk_shader_tilemode_t[gradient_spread],
+        NULL);
+  } else {
+    static const float radius = 1.0f;
+    shader = sk_shader_new_radial_gradient(
+        gradient_points, radius, gradient_colors, gradient_offsets,
+        gradient_num_stops,
+        iconvg_private_gradient_spread_as_sk_shader_tilemode_t[gradient_spread],
+        NULL);
   }
-  return NULL;
+
+  // Skia keeps each stop as a four-float color and a float offset.
+  *backend_bytes = 256 + (gradient_num_stops * 5 * sizeof(float));
+  return shader;
 }
 
 static const char*  //
-iconvg_private_decode(iconvg_canvas* c,
-                      iconvg_rectangle_f32 r,
-                      iconvg_private_decoder* d,
-                      const iconvg_decode_options* options) {
-  iconvg_paint state;
-  state.viewbox = iconvg_private_default_viewbox();
-  if (options && options->height_in_pixels.has_value) {
-    state.height_in_pixels = options->height_in_pixels.value;
-  } else {
-    double h = iconvg_rectangle_f32__height_f64(&r);
-    // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
-    // than MAX_INT32 and also ensures that conversion between integer and
-    // float or double is lossless.
-    if (h <= 0x100000) {
-      state.height_in_pixels = (int64_t)h;
-    } else {
-      state.height_in_pixels = 0x100000;
+iconvg_private_skia_canvas__begin_decode(iconvg_canvas* c,
+                                         iconvg_rectangle_f32 dst_rect) {
+  if (c->context.nonconst_ptr2) {
+    iconvg_private_skia_state__delete(
+        (iconvg_private_skia_state*)(c->context.nonconst_ptr2));
+    c->context.nonconst_ptr2 = NULL;
+  }
+  // The arena is mutable. Like the gradient cache, it is held in a const_ptr
+  // field because the context's two nonconst_ptr fields are already taken.
+  iconvg_arena* arena = (iconvg_arena*)(c->context.const_ptr4);
+  iconvg_private_skia_state* state = NULL;
+  if (arena) {
+    state = (iconvg_private_skia_state*)(iconvg_arena__alloc(
+        arena, sizeof(*state)));
+    if (state) {
+      memset(state, 0, sizeof(*state));
+      state->from_arena = true;
     }
+  } else {
+    state = (iconvg_private_skia_state*)(calloc(1, sizeof(*state)));
   }
-  memset(&state.paint_rgba, 0, sizeof(state.paint_rgba));
-  memcpy(&state.custom_palette, &iconvg_private_default_palette,
-         sizeof(state.custom_palette));
-
-  if (!iconvg_private_decoder__decode_magic_identifier(d)) {
-    return iconvg_error_bad_magic_identifier;
+  if (!state) {
+    return iconvg_error_system_failure_out_of_memory;
   }
-  uint32_t num_metadata_chunks;
-  if (!iconvg_private_decoder__decode_natural_number(d, &num_metadata_chunks)) {
-    return iconvg_error_bad_metadata;
+  state->pathbuilder = sk_pathbuilder_new();
+  state->paint = sk_paint_new();
+  if (!state->pathbuilder || !state->paint) {
+    iconvg_private_skia_state__delete(state);
+    return iconvg_error_system_failure_out_of_memory;
   }
+  sk_paint_set_antialias(state->paint, true);
+  // The gradient cache is mutable. It is only held in a const_ptr field
+  // because the context's two nonconst_ptr fields are already taken.
+  state->gradient_cache = (iconvg_gradient_cache*)(c->context.const_ptr3);
+  c->context.nonconst_ptr2 = state;
 
-  int32_t previous_metadata_id = -1;
-  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
-    uint32_t chunk_length;
-    if (!iconvg_private_decoder__decode_natural_number(d, &chunk_length) ||
-        (chunk_length > d->len)) {
-      return iconvg_error_bad_metadata;
-    }
-    iconvg_private_decoder chunk =
-        iconvg_private_decoder__limit_u32(d, chunk_length);
-    uint32_t metadata_id;
-    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
-      return iconvg_error_bad_metadata;
-    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
-      return iconvg_error_bad_metadata_id_order;
-    }
-
-    switch (metadata_id) {
-      case 0:  // MID 0 (ViewBox).
-        if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk,
-                                                             &state.viewbox) ||
-            (chunk.len != 0)) {
-          return iconvg_error_bad_metadata_viewbox;
-        }
-        break;
-
-      case 1:  // MID 1 (Suggested Palette).
-        if (!iconvg_private_decoder__decode_metadata_suggested_palette(
-                &chunk, &state.custom_palette) ||
-            (chunk.len != 0)) {
-          return iconvg_error_bad_metadata_suggested_palette;
-        }
-        break;
-
-      default:
-        return iconvg_error_bad_metadata;
-    }
+  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
+  sk_canvas_save(sc);
 
-    iconvg_private_decoder__skip_to_the_end(&chunk);
-    iconvg_private_decoder__advance_to_ptr(d, chunk.ptr);
-    previous_metadata_id = ((int32_t)metadata_id);
-  }
+  sk_rect_t rect;
+  rect.left = dst_rect.min_x;
+  rect.top = dst_rect.min_y;
+  rect.right = dst_rect.max_x;
+  rect.bottom = dst_rect.max_y;
+  sk_canvas_clip_rect(sc, &rect);
 
-  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, state.viewbox));
-  ICONVG_PRIVATE_TRY(
-      (*c->vtable->on_metadata_suggested_palette)(c, &state.custom_palette));
+  return NULL;
+}
 
-  if (options && options->palette) {
-    memcpy(&state.custom_palette, options->palette,
-           sizeof(state.custom_palette));
+static const char*  //
+iconvg_private_skia_canvas__end_decode(iconvg_canvas* c,
+                                       const char* err_msg,
+                                       size_t num_bytes_consumed,
+                                       size_t num_bytes_remaining) {
+  iconvg_private_skia_state* state =
+      (iconvg_private_skia_state*)(c->context.nonconst_ptr2);
+  if (!state) {
+    // begin_decode failed (and did not call sk_canvas_save).
+    return err_msg;
   }
+  iconvg_private_skia_state__delete(state);
+  c->context.nonconst_ptr2 = NULL;
+  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
+  sk_canvas_restore(sc);
+  return err_msg;
+}
 
-  memcpy(&state.creg, &state.custom_palette, sizeof(state.creg));
-  memset(&state.nreg[0], 0, sizeof(state.nreg));
-  state.s2d_scale_x = +1.0;
-  state.s2d_bias_x = +0.0;
-  state.s2d_scale_y = +1.0;
-  state.s2d_bias_y = +0.0;
-  state.d2s_scale_x = +1.0;
-  state.d2s_bias_x = +0.0;
-  state.d2s_scale_y = +1.0;
-  state.d2s_bias_y = +0.0;
-
-  return iconvg_private_execute_bytecode(c, r, d, &state);
+static const char*  //
+iconvg_private_skia_canvas__begin_drawing(iconvg_canvas* c) {
+  // The path builder was reset by the previous end_drawing's
+  // sk_pathbuilder_detach_path call (or is new).
+  return NULL;
 }
 
-const char*  //
-iconvg_decode(iconvg_canvas* dst_canvas,
-              iconvg_rectangle_f32 dst_rect,
-              const uint8_t* src_ptr,
-              size_t src_len,
-              const iconvg_decode_options* options) {
-  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
-  if (!dst_canvas || !dst_canvas->vtable) {
-    dst_canvas = &fallback_canvas;
-  }
+static const char*  //
+iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
+                                        const iconvg_paint* p) {
+  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
+  iconvg_private_skia_state* state =
+      (iconvg_private_skia_state*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_t* spb = state->pathbuilder;
+  sk_paint_t* paint = state->paint;
 
-  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
-      sizeof(iconvg_canvas_vtable)) {
-    // If we want to support multiple library versions (with dynamic linking),
-    // we could detect older versions here (with smaller vtable sizes) and
-    // substitute in an adapter implementation.
-    return iconvg_error_unsupported_vtable;
+  iconvg_paint_type paint_type = iconvg_paint__type(p);
+  switch (paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
+      if (state->paint_has_shader) {
+        sk_paint_set_shader(paint, NULL);
+        state->paint_has_shader = false;
+      }
+      sk_paint_set_color(
+          paint, sk_color_set_argb(k.rgba[3], k.rgba[0], k.rgba[1], k.rgba[2]));
+      sk_path_t* path = sk_pathbuilder_detach_path(spb);
+      sk_canvas_draw_path(sc, path, paint);
+      sk_path_delete(path);
+      return NULL;
+    }
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      break;
+    default:
+      return iconvg_error_invalid_paint_type;
   }
 
-  iconvg_private_decoder d;
-  d.ptr = src_ptr;
-  d.len = src_len;
-
-  const char* err_msg =
-      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
-  if (!err_msg) {
-    err_msg = iconvg_private_decode(dst_canvas, dst_rect, &d, options);
+  // Look for an existing shader for this gradient: in the gradient cache, if
+  // there is one, or else the previous drawing's shader.
+  iconvg_matrix_2x3_f64 gtm = iconvg_paint__gradient_transformation_matrix(p);
+  if (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) {
+    iconvg_matrix_2x3_f64__override_second_row(&gtm);
+  }
+  iconvg_private_gradient_key key;
+  iconvg_private_gradient_key__initialize(&key, p);
+  iconvg_gradient_cache* gc = state->gradient_cache;
+  sk_shader_t* shader = NULL;
+  bool unref_shader = false;
+  if (gc) {
+    shader = (sk_shader_t*)(iconvg_private_gradient_cache__lookup(
+        gc, &key, &iconvg_private_skia_release_shader));
+  } else if (state->last_shader &&
+             (memcmp(&key, &state->last_key, sizeof(key)) == 0)) {
+    shader = state->last_shader;
   }
-  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg, src_len - d.len,
-                                           d.len);
-}
-
-// -------------------------------- #include "./error.c"
-
-const char iconvg_error_bad_color[] =  //
-    "iconvg: bad color";
-const char iconvg_error_bad_coordinate[] =  //
-    "iconvg: bad coordinate";
-const char iconvg_error_bad_drawing_opcode[] =  //
-    "iconvg: bad drawing opcode";
-const char iconvg_error_bad_magic_identifier[] =  //
-    "iconvg: bad magic identifier";
-const char iconvg_error_bad_metadata[] =  //
-    "iconvg: bad metadata";
-const char iconvg_error_bad_metadata_id_order[] =  //
-    "iconvg: bad metadata ID order";
-const char iconvg_error_bad_metadata_suggested_palette[] =  //
-    "iconvg: bad metadata (suggested palette)";
-const char iconvg_error_bad_metadata_viewbox[] =  //
-    "iconvg: bad metadata (viewbox)";
-const char iconvg_error_bad_number[] =  //
-    "iconvg: bad number";
-const char iconvg_error_bad_path_unfinished[] =  //
-    "iconvg: bad path (unfinished)";
-const char iconvg_error_bad_styling_opcode[] =  //
-    "iconvg: bad styling opcode";
 
-const char iconvg_error_system_failure_out_of_memory[] =  //
-    "iconvg: system failure: out of memory";
+  if (!shader) {
+    size_t backend_bytes = 0;
+    shader = iconvg_private_skia_make_shader(p, paint_type, &backend_bytes);
+    if (!shader) {
+      sk_path_delete(sk_pathbuilder_detach_path(spb));
+      return NULL;
+    } else if (gc) {
+      unref_shader = !iconvg_private_gradient_cache__insert(
+          gc, &key, &iconvg_private_skia_release_shader, shader,
+          backend_bytes);
+    } else {
+      if (state->last_shader) {
+        sk_shader_unref(state->last_shader);
+      }
+      state->last_shader = shader;
+      state->last_key = key;
+    }
+  }
 
-const char iconvg_error_invalid_backend_not_enabled[] =  //
-    "iconvg: invalid backend (not enabled)";
-const char iconvg_error_invalid_constructor_argument[] =  //
-    "iconvg: invalid constructor argument";
-const char iconvg_error_invalid_paint_type[] =  //
-    "iconvg: invalid paint type";
-const char iconvg_error_unsupported_vtable[] =  //
-    "iconvg: unsupported vtable";
+  // The shader is in pattern space. Wrap it with this drawing's (dst_rect
+  // dependent) local matrix. The wrapper is cheap: it shares the gradient.
+  sk_matrix_t sm = iconvg_private_skia_local_matrix(&gtm);
+  sk_shader_t* local_shader = sk_shader_with_local_matrix(shader, &sm);
+  if (unref_shader) {
+    sk_shader_unref(shader);
+  }
+  if (!local_shader) {
+    sk_path_delete(sk_pathbuilder_detach_path(spb));
+    return NULL;
+  }
 
-const char iconvg_private_internal_error_unreachable[] =  //
-    "iconvg: internal error: unreachable";
+  // Use the Skia shader. The paint's color is reset to opaque black, as Skia
+  // modulates the shader by the paint's alpha. The paint takes its own
+  // reference to the shader.
+  sk_paint_set_color(paint, sk_color_set_argb(0xFF, 0x00, 0x00, 0x00));
+  sk_paint_set_shader(paint, local_shader);
+  sk_shader_unref(local_shader);
+  state->paint_has_shader = true;
+  sk_path_t* path = sk_pathbuilder_detach_path(spb);
+  sk_canvas_draw_path(sc, path, paint);
+  sk_path_delete(path);
+  return NULL;
+}
 
-// ----
+static const char*  //
+iconvg_private_skia_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  sk_pathbuilder_move_to(spb, x0, y0);
+  return NULL;
+}
 
-bool  //
-iconvg_error_is_file_format_error(const char* err_msg) {
-  return (err_msg == iconvg_error_bad_color) ||
-         (err_msg == iconvg_error_bad_coordinate) ||
-         (err_msg == iconvg_error_bad_drawing_opcode) ||
-         (err_msg == iconvg_error_bad_magic_identifier) ||
-         (err_msg == iconvg_error_bad_metadata) ||
-         (err_msg == iconvg_error_bad_metadata_id_order) ||
-         (err_msg == iconvg_error_bad_metadata_suggested_palette) ||
-         (err_msg == iconvg_error_bad_metadata_viewbox) ||
-         (err_msg == iconvg_error_bad_number) ||
-         (err_msg == iconvg_error_bad_path_unfinished) ||
-         (err_msg == iconvg_error_bad_styling_opcode);
+static const char*  //
+iconvg_private_skia_canvas__end_path(iconvg_canvas* c) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  sk_pathbuilder_close(spb);
+  return NULL;
 }
 
-// -------------------------------- #include "./matrix.c"
+static const char*  //
+iconvg_private_skia_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  sk_pathbuilder_line_to(spb, x1, y1);
+  return NULL;
+}
 
-iconvg_matrix_2x3_f64  //
-iconvg_matrix_2x3_f64__inverse(iconvg_matrix_2x3_f64* self) {
-  double inv = 1.0 / iconvg_matrix_2x3_f64__determinant(self);
-  if (isinf(inv) || isnan(inv)) {
-    return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
-  }
+static const char*  //
+iconvg_private_skia_canvas__path_quad_to(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  sk_pathbuilder_quad_to(spb, x1, y1, x2, y2);
+  return NULL;
+}
 
-  // https://ardoris.wordpress.com/2008/07/18/general-formula-for-the-inverse-of-a-3x3-matrix/
-  // recalling that self's implicit bottom row is [0, 0, 1].
-  double e02 = (self->elems[0][1] * self->elems[1][2]) -
-               (self->elems[0][2] * self->elems[1][1]);
-  double e12 = (self->elems[0][0] * self->elems[1][2]) -
-               (self->elems[0][2] * self->elems[1][0]);
-  return iconvg_matrix_2x3_f64__make(+inv * self->elems[1][1],  //
-                                     -inv * self->elems[0][1],  //
-                                     +inv * e02,                //
-                                     -inv * self->elems[1][0],  //
-                                     +inv * self->elems[0][0],  //
-                                     -inv * e12);               //
+static const char*  //
+iconvg_private_skia_canvas__path_cube_to(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2,
+                                         float x3,
+                                         float y3) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  sk_pathbuilder_cubic_to(spb, x1, y1, x2, y2, x3, y3);
+  return NULL;
 }
 
-void  //
-iconvg_matrix_2x3_f64__override_second_row(iconvg_matrix_2x3_f64* self) {
-  if (!self) {
-    return;
-  }
-  if (self->elems[0][0] != 0.0) {
-    self->elems[1][0] = 0.0;
-    self->elems[1][1] = 1.0;
-  } else if (self->elems[0][1] != 0.0) {
-    self->elems[1][0] = 1.0;
-    self->elems[1][1] = 0.0;
-  } else {
-    // 1e-10 is arbitrary but very small and squaring it still gives
-    // something larger than FLT_MIN, approximately 1.175494e-38.
-    self->elems[0][0] = 1e-10;
-    self->elems[0][1] = 0.0;
-    self->elems[1][0] = 0.0;
-    self->elems[1][1] = 1e-10;
-  }
+static const char*  //
+iconvg_private_skia_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                iconvg_rectangle_f32 viewbox) {
+  return NULL;
 }
 
-// -------------------------------- #include "./paint.c"
+static const char*  //
+iconvg_private_skia_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
 
-iconvg_paint_type  //
-iconvg_paint__type(const iconvg_paint* self) {
-  if (self) {
-    const uint8_t* rgba = &self->paint_rgba[0];
-    if ((rgba[0] <= rgba[3]) &&  //
-        (rgba[1] <= rgba[3]) &&  //
-        (rgba[2] <= rgba[3])) {
-      return ICONVG_PAINT_TYPE__FLAT_COLOR;
-    } else if ((rgba[3] == 0x00) && (rgba[2] >= 0x80)) {
-      return (rgba[2] & 0x40) ? ICONVG_PAINT_TYPE__RADIAL_GRADIENT
-                              : ICONVG_PAINT_TYPE__LINEAR_GRADIENT;
+static const char*  //
+iconvg_private_skia_canvas__path_segments(iconvg_canvas* c,
+                                          const uint8_t* verbs,
+                                          size_t num_verbs,
+                                          const float* points) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        sk_pathbuilder_line_to(spb, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        sk_pathbuilder_quad_to(spb, points[0], points[1], points[2],
+                               points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        sk_pathbuilder_cubic_to(spb, points[0], points[1], points[2],
+                                points[3], points[4], points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
     }
   }
-  return ICONVG_PAINT_TYPE__INVALID;
+  return NULL;
 }
 
-// ----
+static const iconvg_canvas_vtable  //
+    iconvg_private_skia_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_skia_canvas__begin_decode,
+        &iconvg_private_skia_canvas__end_decode,
+        &iconvg_private_skia_canvas__begin_drawing,
+        &iconvg_private_skia_canvas__end_drawing,
+        &iconvg_private_skia_canvas__begin_path,
+        &iconvg_private_skia_canvas__end_path,
+        &iconvg_private_skia_canvas__path_line_to,
+        &iconvg_private_skia_canvas__path_quad_to,
+        &iconvg_private_skia_canvas__path_cube_to,
+        &iconvg_private_skia_canvas__on_metadata_viewbox,
+        &iconvg_private_skia_canvas__on_metadata_suggested_palette,
+        &iconvg_private_skia_canvas__path_segments,
+        NULL,
+};
 
-static inline iconvg_nonpremul_color  //
-iconvg_private_flat_color_as_nonpremul_color(const uint8_t* rgba) {
-  iconvg_nonpremul_color k;
-  if (!rgba || (rgba[3] == 0x00)) {
-    memset(&k.rgba[0], 0, 4);
-  } else if (rgba[3] == 0xFF) {
-    memcpy(&k.rgba[0], rgba, 4);
-  } else {
-    uint32_t a = rgba[3];
-    k.rgba[0] = ((uint8_t)(((uint32_t)(rgba[0])) * 0xFF / a));
-    k.rgba[1] = ((uint8_t)(((uint32_t)(rgba[1])) * 0xFF / a));
-    k.rgba[2] = ((uint8_t)(((uint32_t)(rgba[2])) * 0xFF / a));
-    k.rgba[3] = ((uint8_t)a);
-  }
-  return k;
+iconvg_canvas  //
+iconvg_canvas__make_skia(sk_canvas_t* sc) {
+  return iconvg_canvas__make_skia_with_gradient_cache(sc, NULL);
 }
 
-static inline iconvg_premul_color  //
-iconvg_private_flat_color_as_premul_color(const uint8_t* rgba) {
-  iconvg_premul_color k;
-  if (!rgba) {
-    memset(&k.rgba[0], 0, 4);
-  } else {
-    memcpy(&k.rgba[0], rgba, 4);
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_gradient_cache(sk_canvas_t* sc,
+                                             iconvg_gradient_cache* gc) {
+  return iconvg_canvas__make_skia_with_arena(sc, gc, NULL);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_arena(sk_canvas_t* sc,
+                                    iconvg_gradient_cache* gc,
+                                    iconvg_arena* arena) {
+  if (!sc) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
   }
-  return k;
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_skia_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = sc;
+  c.context.const_ptr3 = gc;
+  c.context.const_ptr4 = arena;
+  return c;
 }
 
-// ----
+#endif  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
 
-iconvg_nonpremul_color  //
-iconvg_paint__flat_color_as_nonpremul_color(const iconvg_paint* self) {
-  return iconvg_private_flat_color_as_nonpremul_color(
-      self ? &self->paint_rgba[0] : NULL);
-}
+// -------------------------------- #include "./stats.c"
 
-iconvg_premul_color  //
-iconvg_paint__flat_color_as_premul_color(const iconvg_paint* self) {
-  return iconvg_private_flat_color_as_premul_color(self ? &self->paint_rgba[0]
-                                                        : NULL);
+// The stats canvas wraps another canvas, counting and timing the calls that
+// it forwards. Its context fields hold:
+//  - nonconst_ptr1: the wrapped iconvg_canvas, possibly NULL.
+//  - nonconst_ptr2: the iconvg_canvas_stats.
+//
+// decode_ticks is accumulated by subtracting the clock reading at
+// begin_decode and adding the reading at end_decode. With unsigned arithmetic,
+// this needs no per-canvas state and the total is correct once end_decode has
+// returned.
+//
+// Forwarded calls are timed individually, or 1 in every sample_interval calls
+// of each method, with the sampled durations scaled up by sample_interval. A
+// NULL clock_func means that nothing is timed and every ticks field stays
+// zero.
+
+static inline uint64_t  //
+iconvg_private_stats_canvas__now(const iconvg_canvas_stats* s) {
+  return s->clock_func ? (*s->clock_func)(s->clock_context) : 0;
 }
 
-// ----
-
-iconvg_gradient_spread  //
-iconvg_paint__gradient_spread(const iconvg_paint* self) {
-  if (!self) {
-    return ICONVG_GRADIENT_SPREAD__NONE;
+// iconvg_private_stats_canvas__start_timing returns whether to time this call
+// of method m and, if so, sets *t0 to the clock reading.
+static inline bool  //
+iconvg_private_stats_canvas__start_timing(iconvg_canvas_stats* s,
+                                          iconvg_canvas_method m,
+                                          uint64_t* t0) {
+  if (!s->clock_func) {
+    return false;
+  } else if (s->private_impl.countdown[m] > 0) {
+    s->private_impl.countdown[m]--;
+    return false;
   }
-  return (iconvg_gradient_spread)(self->paint_rgba[1] >> 6);
+  s->private_impl.countdown[m] =
+      (s->sample_interval > 1) ? (s->sample_interval - 1) : 0;
+  *t0 = (*s->clock_func)(s->clock_context);
+  return true;
 }
 
-uint32_t  //
-iconvg_paint__gradient_number_of_stops(const iconvg_paint* self) {
-  if (!self) {
-    return 0;
+// iconvg_private_stats_canvas__finish_timing adds the time since t0, scaled
+// up by the sample interval, to method m's and the backend's totals.
+static inline void  //
+iconvg_private_stats_canvas__finish_timing(iconvg_canvas_stats* s,
+                                           iconvg_canvas_method m,
+                                           uint64_t t0) {
+  uint64_t ticks = (*s->clock_func)(s->clock_context) - t0;
+  if (s->sample_interval > 1) {
+    ticks *= s->sample_interval;
   }
-  return 0x3F & self->paint_rgba[0];
+  s->method_ticks[m] += ticks;
+  s->backend_ticks += ticks;
 }
 
-iconvg_nonpremul_color  //
-iconvg_paint__gradient_stop_color_as_nonpremul_color(const iconvg_paint* self,
-                                                     uint32_t which_stop) {
-  const uint8_t* rgba = NULL;
-  if (self) {
-    uint32_t cbase = self->paint_rgba[1];
-    rgba = &self->creg.colors[0x3F & (cbase + which_stop)].rgba[0];
+static const char*  //
+iconvg_private_stats_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_decodes++;
+  s->decode_ticks -= iconvg_private_stats_canvas__now(s);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
   }
-  return iconvg_private_flat_color_as_nonpremul_color(rgba);
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__BEGIN_DECODE, &t0);
+  const char* err_msg = (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__BEGIN_DECODE, t0);
+  }
+  return err_msg;
 }
 
-iconvg_premul_color  //
-iconvg_paint__gradient_stop_color_as_premul_color(const iconvg_paint* self,
-                                                  uint32_t which_stop) {
-  const uint8_t* rgba = NULL;
-  if (self) {
-    uint32_t cbase = self->paint_rgba[1];
-    rgba = &self->creg.colors[0x3F & (cbase + which_stop)].rgba[0];
+static const char*  //
+iconvg_private_stats_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    // No-op.
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    err_msg = iconvg_error_unsupported_vtable;
+  } else {
+    uint64_t t0 = 0;
+    bool timed = iconvg_private_stats_canvas__start_timing(
+        s, ICONVG_CANVAS_METHOD__END_DECODE, &t0);
+    err_msg = (*wrapped->vtable->end_decode)(wrapped, err_msg,
+                                             num_bytes_consumed,
+                                             num_bytes_remaining);
+    if (timed) {
+      iconvg_private_stats_canvas__finish_timing(
+          s, ICONVG_CANVAS_METHOD__END_DECODE, t0);
+    }
   }
-  return iconvg_private_flat_color_as_premul_color(rgba);
+  s->decode_ticks += iconvg_private_stats_canvas__now(s);
+  if (err_msg) {
+    s->num_decode_errors++;
+  }
+  return err_msg;
 }
 
-float  //
-iconvg_paint__gradient_stop_offset(const iconvg_paint* self,
-                                   uint32_t which_stop) {
-  if (!self) {
-    return 0;
+static const char*  //
+iconvg_private_stats_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_drawings++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
   }
-  uint32_t nbase = self->paint_rgba[2];
-  return self->nreg[0x3F & (nbase + which_stop)];
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__BEGIN_DRAWING, &t0);
+  const char* err_msg = (*wrapped->vtable->begin_drawing)(wrapped);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__BEGIN_DRAWING, t0);
+  }
+  return err_msg;
 }
 
-iconvg_matrix_2x3_f64  //
-iconvg_paint__gradient_transformation_matrix(const iconvg_paint* self) {
-  if (!self) {
-    return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+static const char*  //
+iconvg_private_stats_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_paints[3 & iconvg_paint__type(p)]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__END_DRAWING, &t0);
+  const char* err_msg = (*wrapped->vtable->end_drawing)(wrapped, p);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__END_DRAWING, t0);
   }
+  return err_msg;
+}
 
-  uint32_t nbase = self->paint_rgba[2];
-  double s00 = self->nreg[0x3F & (nbase - 6)];
-  double s01 = self->nreg[0x3F & (nbase - 5)];
-  double s02 = self->nreg[0x3F & (nbase - 4)];
-  double s10 = self->nreg[0x3F & (nbase - 3)];
-  double s11 = self->nreg[0x3F & (nbase - 2)];
-  double s12 = self->nreg[0x3F & (nbase - 1)];
+static const char*  //
+iconvg_private_stats_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_paths++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__BEGIN_PATH, &t0);
+  const char* err_msg = (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__BEGIN_PATH, t0);
+  }
+  return err_msg;
+}
 
-  // The [s00, s01, s02; s10, s11, s12] matrix transforms from *src*
-  // coordinates to pattern coordinates.
-  //
-  //   pat_x = (src_x * s00) + (src_y * s01) + s02
-  //   pat_y = (src_x * s10) + (src_y * s11) + s12
-  //
-  // Pattern coordinate space (also known as paint or gradient coordinate
-  // space) is where linear gradients always range from x=0 to x=1 and radial
-  // gradients are always center=(0,0) and radius=1. We can't just return this
-  // matrix to the caller. We need to produce the equivalent [d00, d01, d02;
-  // d10, d11, d12] matrix that transforms from *dst* coordinates to pattern
-  // coordinates. Recall that:
-  //
-  //   src_x = (dst_x * d2s_scale_x) + d2s_bias_x
-  //   src_y = (dst_y * d2s_scale_y) + d2s_bias_y
-  //
-  // Combining the above, we can solve for d00, d01, etc such that:
-  //
-  //   pat_x = (dst_x * d00) + (dst_y * d01) + d02
-  //   pat_y = (dst_x * d10) + (dst_y * d11) + d12
-  double d00 = s00 * self->d2s_scale_x;
-  double d01 = s01 * self->d2s_scale_y;
-  double d02 = (s00 * self->d2s_bias_x) + (s01 * self->d2s_bias_y) + s02;
-  double d10 = s10 * self->d2s_scale_x;
-  double d11 = s11 * self->d2s_scale_y;
-  double d12 = (s10 * self->d2s_bias_x) + (s11 * self->d2s_bias_y) + s12;
+static const char*  //
+iconvg_private_stats_canvas__end_path(iconvg_canvas* c) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__END_PATH, &t0);
+  const char* err_msg = (*wrapped->vtable->end_path)(wrapped);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__END_PATH, t0);
+  }
+  return err_msg;
+}
 
-  return iconvg_matrix_2x3_f64__make(d00, d01, d02, d10, d11, d12);
+static const char*  //
+iconvg_private_stats_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_segments[ICONVG_PATH_VERB__LINE_TO]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_LINE_TO, &t0);
+  const char* err_msg = (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_LINE_TO, t0);
+  }
+  return err_msg;
 }
 
-// -------------------------------- #include "./rectangle.c"
+static const char*  //
+iconvg_private_stats_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_segments[ICONVG_PATH_VERB__QUAD_TO]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_QUAD_TO, &t0);
+  const char* err_msg =
+      (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_QUAD_TO, t0);
+  }
+  return err_msg;
+}
 
-// Note that iconvg_rectangle_f32 fields may be NaN, so that (min < max) is not
-// the same as !(min >= max).
+static const char*  //
+iconvg_private_stats_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_segments[ICONVG_PATH_VERB__CUBE_TO]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_CUBE_TO, &t0);
+  const char* err_msg =
+      (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_CUBE_TO, t0);
+  }
+  return err_msg;
+}
 
-bool  //
-iconvg_rectangle_f32__is_finite_and_not_empty(
-    const iconvg_rectangle_f32* self) {
-  return self &&                         //
-         (-INFINITY < self->min_x) &&    //
-         (self->min_x < self->max_x) &&  //
-         (self->max_x < +INFINITY) &&    //
-         (-INFINITY < self->min_y) &&    //
-         (self->min_y < self->max_y) &&  //
-         (self->max_y < +INFINITY);
+static const char*  //
+iconvg_private_stats_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX, &t0);
+  const char* err_msg =
+      (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX, t0);
+  }
+  return err_msg;
 }
 
-double  //
-iconvg_rectangle_f32__width_f64(const iconvg_rectangle_f32* self) {
-  if (self && (self->max_x > self->min_x)) {
-    return ((double)self->max_x) - ((double)self->min_x);
+static const char*  //
+iconvg_private_stats_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
   }
-  return 0.0;
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE, &t0);
+  const char* err_msg = (*wrapped->vtable->on_metadata_suggested_palette)(
+      wrapped, suggested_palette);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE, t0);
+  }
+  return err_msg;
 }
 
-double  //
-iconvg_rectangle_f32__height_f64(const iconvg_rectangle_f32* self) {
-  if (self && (self->max_y > self->min_y)) {
-    return ((double)self->max_y) - ((double)self->min_y);
+static const char*  //
+iconvg_private_stats_canvas__path_segments(iconvg_canvas* c,
+                                           const uint8_t* verbs,
+                                           size_t num_verbs,
+                                           const float* points) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_path_segments_calls++;
+  for (size_t i = 0; i < num_verbs; i++) {
+    s->num_segments[3 & verbs[i]]++;
   }
-  return 0.0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_SEGMENTS, &t0);
+  const char* err_msg =
+      iconvg_private_canvas__path_segments(wrapped, verbs, num_verbs, points);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_SEGMENTS, t0);
+  }
+  return err_msg;
 }
 
-// -------------------------------- #include "./skia.c"
+static const char*  //
+iconvg_private_stats_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_skipped_drawings++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING, &t0);
+  const char* err_msg = iconvg_private_canvas__on_skipped_drawing(wrapped);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING, t0);
+  }
+  return err_msg;
+}
 
-#if !defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+static const iconvg_canvas_vtable  //
+    iconvg_private_stats_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_stats_canvas__begin_decode,
+        &iconvg_private_stats_canvas__end_decode,
+        &iconvg_private_stats_canvas__begin_drawing,
+        &iconvg_private_stats_canvas__end_drawing,
+        &iconvg_private_stats_canvas__begin_path,
+        &iconvg_private_stats_canvas__end_path,
+        &iconvg_private_stats_canvas__path_line_to,
+        &iconvg_private_stats_canvas__path_quad_to,
+        &iconvg_private_stats_canvas__path_cube_to,
+        &iconvg_private_stats_canvas__on_metadata_viewbox,
+        &iconvg_private_stats_canvas__on_metadata_suggested_palette,
+        &iconvg_private_stats_canvas__path_segments,
+        &iconvg_private_stats_canvas__on_skipped_drawing,
+};
 
 iconvg_canvas  //
-iconvg_canvas__make_skia(sk_canvas_t* sc) {
-  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+iconvg_canvas__make_stats(iconvg_canvas_stats* stats, iconvg_canvas* wrapped) {
+  if (!stats) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  } else if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_stats_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = stats;
+  return c;
 }
 
-#else  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
-
-#include "include/c/sk_canvas.h"
-#include "include/c/sk_matrix.h"
-#include "include/c/sk_paint.h"
-#include "include/c/sk_path.h"
-#include "include/c/sk_shader.h"
-
-static const sk_shader_tilemode_t
-    iconvg_private_gradient_spread_as_sk_shader_tilemode_t[4] = {
-        CLAMP_SK_SHADER_TILEMODE,   //
-        CLAMP_SK_SHADER_TILEMODE,   //
-        MIRROR_SK_SHADER_TILEMODE,  //
-        REPEAT_SK_SHADER_TILEMODE   //
-};
+// -------------------------------- #include "./tessellator.c"
 
-// iconvg_private_skia_set_gradient_stops sets the Skia gradient stop colors
-// given the IconVG gradient stop colors.
-//
-// Like iconvg_private_cairo_set_gradient_stops, the complexity is due to
-// premultiplied versus non-premultiplied alpha.
+// The tessellator canvas turns each drawing into triangles for a GPU to fill
+// with the stencil-and-cover technique: every triangle of a drawing fans out
+// from one anchor vertex (the drawing's first point), so that the winding
+// number that a stencil buffer accumulates at each pixel is the path's (with
+// the non-zero fill rule). A second pass then paints the drawing's cover
+// rectangle where the stencil is non-zero.
 //
-// It returns the number of Skia stops added.
-static uint32_t  //
-iconvg_private_skia_set_gradient_stops(sk_color_t* gcol,
-                                       float* goff,
-                                       const iconvg_paint* p) {
-  uint32_t ret = 0;
-
-  // foo0 and foo2 are the previous and current gradient stop. Sometimes we
-  // need to synthesize additional stops in between them, whose variables are
-  // named foo1.
-  double offset0 = 0.0;
-  uint8_t r0 = 0x00;
-  uint8_t g0 = 0x00;
-  uint8_t b0 = 0x00;
-  uint8_t a0 = 0x00;
-
-  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
-  for (uint32_t i = 0; i < num_stops; i++) {
-    // Calculate offset and color for the current stop.
-    double offset2 = iconvg_paint__gradient_stop_offset(p, i);
-    iconvg_premul_color k =
-        iconvg_paint__gradient_stop_color_as_premul_color(p, i);
-    uint8_t r2 = k.rgba[0];
-    uint8_t g2 = k.rgba[1];
-    uint8_t b2 = k.rgba[2];
-    uint8_t a2 = k.rgba[3];
+// A path segment from P to Q adds the fan triangle (anchor, P, Q). Closing a
+// contour adds the segment back to its start. In ICONVG_TESSELLATION_MODE__
+// CURVES mode, a quadratic curve from P via C to Q also adds the curve
+// triangle (P, C, Q) with curve coordinates (0, 0), (0.5, 0) and (1, 1): the
+// fragments for which ((u * u) - v) is negative are exactly those between the
+// chord PQ and the curve, and the triangle's orientation gives the right sign
+// for the winding number.
+
+#define ICONVG_PRIVATE_TESSELLATOR_DEFAULT_TOLERANCE 0.1f
+#define ICONVG_PRIVATE_TESSELLATOR_MAX_SUBDIVISIONS 100
+
+static inline iconvg_tessellation*  //
+iconvg_private_tessellator_canvas__state(iconvg_canvas* c) {
+  return (iconvg_tessellation*)(c->context.nonconst_ptr1);
+}
 
-    if ((i == 0) ||                        //
-        ((a0 == 0xFF) && (a2 == 0xFF)) ||  //
-        ((a0 == 0x00) && (a2 == 0x00))) {
-      // If it's the first stop, or if we're interpolating from 100% to 100%
-      // opaque or from 0% to 0% opaque, we don't have to worry about
-      // premultiplied versus non-premultiplied alpha.
-      *gcol++ = sk_color_set_argb(a2, r2, g2, b2);
-      *goff++ = offset2;
-      ret++;
+static uint32_t  //
+iconvg_private_tessellation__vertex(iconvg_tessellation* t,
+                                    float x,
+                                    float y,
+                                    float u,
+                                    float v) {
+  size_t i = t->num_vertices++;
+  if (i < t->vertices_len) {
+    iconvg_tessellation_vertex* dst = &t->vertices_ptr[i];
+    dst->x = x;
+    dst->y = y;
+    dst->u = u;
+    dst->v = v;
+  }
+  float* b = &t->private_impl.bounds[0];
+  b[0] = (b[0] < x) ? b[0] : x;
+  b[1] = (b[1] < y) ? b[1] : y;
+  b[2] = (b[2] > x) ? b[2] : x;
+  b[3] = (b[3] > y) ? b[3] : y;
+  return (uint32_t)i;
+}
 
-    } else if (a0 == 0x00) {
-      // If we're blending e.g. from transparent black to (partially) opaque
-      // blue, insert "transparent blue" immediately after the previous
-      // "transparent black".
-      *gcol++ = sk_color_set_argb(0x00, r2, g2, b2);
-      *goff++ = offset0;
-      *gcol++ = sk_color_set_argb(a2, r2, g2, b2);
-      *goff++ = offset2;
-      ret += 2;
+static void  //
+iconvg_private_tessellation__triangle(iconvg_tessellation* t,
+                                      uint32_t a,
+                                      uint32_t b,
+                                      uint32_t c) {
+  size_t i = t->num_indices;
+  t->num_indices += 3;
+  if ((i < t->indices_len) && (3 <= (t->indices_len - i))) {
+    t->indices_ptr[i + 0] = a;
+    t->indices_ptr[i + 1] = b;
+    t->indices_ptr[i + 2] = c;
+  }
+}
 
-    } else if (a2 == 0x00) {
-      // If we're blending e.g. from (partially) opaque blue to transparent
-      // black, insert "transparent blue" immediately before the current
-      // "transparent black".
-      *gcol++ = sk_color_set_argb(0x00, r0, g0, b0);
-      *goff++ = offset2;
-      *gcol++ = sk_color_set_argb(a2, r2, g2, b2);
-      *goff++ = offset2;
-      ret += 2;
+// iconvg_private_tessellation__fan_to adds a fan vertex at (x, y) and the fan
+// triangle for the segment from the previous one.
+static void  //
+iconvg_private_tessellation__fan_to(iconvg_tessellation* t, float x, float y) {
+  uint32_t v = iconvg_private_tessellation__vertex(t, x, y, 0.0f, 1.0f);
+  if (t->private_impl.prev_vertex != t->private_impl.anchor_vertex) {
+    iconvg_private_tessellation__triangle(t, t->private_impl.anchor_vertex,
+                                          t->private_impl.prev_vertex, v);
+  }
+  t->private_impl.prev_vertex = v;
+  t->private_impl.prev_x = x;
+  t->private_impl.prev_y = y;
+}
 
-    } else {
-      // Otherwise, fake "interpolate with premultiplied alpha" like
-      // iconvg_private_cairo_set_gradient_stops does.
-      const int32_t n = 16;
-      for (int32_t i = (n - 1); i >= 0; i--) {
-        int32_t j = n - i;
-        double offset1 = ((i * offset0) + (j * offset2)) / n;
-        uint8_t r1 = ((i * r0) + (j * r2)) / n;
-        uint8_t g1 = ((i * g0) + (j * g2)) / n;
-        uint8_t b1 = ((i * b0) + (j * b2)) / n;
-        uint8_t a1 = ((i * a0) + (j * a2)) / n;
-        if (a1 == 0x00) {
-          *gcol++ = sk_color_set_argb(0x00, 0x00, 0x00, 0x00);
-          *goff++ = offset1;
-          ret++;
-        } else {
-          *gcol++ = sk_color_set_argb(a1,                 //
-                                      (0xFF * r1) / a1,   //
-                                      (0xFF * g1) / a1,   //
-                                      (0xFF * b1) / a1);  //
-          *goff++ = offset1;
-          ret++;
-        }
-      }
-    }
+// iconvg_private_tessellation__subdivisions returns the number of pieces
+// (line segments or quadratic curves) that approximate a curve to within
+// tolerance, if each piece, over a t interval of length h, deviates by at
+// most (k * (h ^ e)). e is 2 for lines and 3 for quadratic curves.
+static inline int32_t  //
+iconvg_private_tessellation__subdivisions(float k,
+                                          float tolerance,
+                                          bool cubic_root) {
+  float r = k / tolerance;
+  float n = cubic_root ? cbrtf(r) : sqrtf(r);
+  if (n < (ICONVG_PRIVATE_TESSELLATOR_MAX_SUBDIVISIONS - 1)) {
+    return 1 + (int32_t)n;
+  }
+  // This also catches NaN.
+  return ICONVG_PRIVATE_TESSELLATOR_MAX_SUBDIVISIONS;
+}
 
-    // Update offset and color for the previous stop.
-    offset0 = offset2;
-    r0 = r2;
-    g0 = g2;
-    b0 = b2;
-    a0 = a2;
+static void  //
+iconvg_private_tessellation__quad_to(iconvg_tessellation* t,
+                                     float x1,
+                                     float y1,
+                                     float x2,
+                                     float y2) {
+  float x0 = t->private_impl.prev_x;
+  float y0 = t->private_impl.prev_y;
+  if (t->mode == ICONVG_TESSELLATION_MODE__CURVES) {
+    uint32_t v0 = iconvg_private_tessellation__vertex(t, x0, y0, 0.0f, 0.0f);
+    uint32_t v1 = iconvg_private_tessellation__vertex(t, x1, y1, 0.5f, 0.0f);
+    uint32_t v2 = iconvg_private_tessellation__vertex(t, x2, y2, 1.0f, 1.0f);
+    iconvg_private_tessellation__triangle(t, v0, v1, v2);
+    iconvg_private_tessellation__fan_to(t, x2, y2);
+    return;
   }
 
-  return ret;
+  // A chord over a t interval of length h deviates from the curve by at most
+  // (2 * dd * h²) / 8, where dd is the second difference.
+  float ddx = x0 - (2.0f * x1) + x2;
+  float ddy = y0 - (2.0f * y1) + y2;
+  int32_t n = iconvg_private_tessellation__subdivisions(
+      0.25f * sqrtf((ddx * ddx) + (ddy * ddy)), t->private_impl.tolerance,
+      false);
+  float inv_n = 1.0f / ((float)n);
+  for (int32_t i = 1; i < n; i++) {
+    float s = ((float)i) * inv_n;
+    float u = 1.0f - s;
+    float b0 = u * u;
+    float b1 = 2.0f * u * s;
+    float b2 = s * s;
+    iconvg_private_tessellation__fan_to(t,
+                                        (b0 * x0) + (b1 * x1) + (b2 * x2),  //
+                                        (b0 * y0) + (b1 * y1) + (b2 * y2));
+  }
+  iconvg_private_tessellation__fan_to(t, x2, y2);
 }
 
-static const char*  //
-iconvg_private_skia_canvas__begin_decode(iconvg_canvas* c,
-                                         iconvg_rectangle_f32 dst_rect) {
-  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_canvas_save(sc);
+static void  //
+iconvg_private_tessellation__cube_to(iconvg_tessellation* t,
+                                     float x1,
+                                     float y1,
+                                     float x2,
+                                     float y2,
+                                     float x3,
+                                     float y3) {
+  float x0 = t->private_impl.prev_x;
+  float y0 = t->private_impl.prev_y;
+  int32_t n = 0;
+  if (t->mode == ICONVG_TESSELLATION_MODE__CURVES) {
+    // Approximating a cubic piece by the quadratic whose control point is
+    // (3 * (C1 + C2) - (P0 + P3)) / 4 has an error of at most (√3 / 36) * |P3
+    // - 3*C2 + 3*C1 - P0| * h³.
+    float dx = x3 - (3.0f * x2) + (3.0f * x1) - x0;
+    float dy = y3 - (3.0f * y2) + (3.0f * y1) - y0;
+    n = iconvg_private_tessellation__subdivisions(
+        0.0481125224f * sqrtf((dx * dx) + (dy * dy)),
+        t->private_impl.tolerance, true);
+  } else {
+    // A chord over a t interval of length h deviates from the curve by at
+    // most (6 * dd * h²) / 8, where dd is the maximum second difference.
+    float ddx0 = x0 - (2.0f * x1) + x2;
+    float ddy0 = y0 - (2.0f * y1) + y2;
+    float ddx1 = x1 - (2.0f * x2) + x3;
+    float ddy1 = y1 - (2.0f * y2) + y3;
+    float dd0 = (ddx0 * ddx0) + (ddy0 * ddy0);
+    float dd1 = (ddx1 * ddx1) + (ddy1 * ddy1);
+    n = iconvg_private_tessellation__subdivisions(
+        0.75f * sqrtf((dd0 > dd1) ? dd0 : dd1), t->private_impl.tolerance,
+        false);
+  }
 
-  sk_rect_t rect;
-  rect.left = dst_rect.min_x;
-  rect.top = dst_rect.min_y;
-  rect.right = dst_rect.max_x;
-  rect.bottom = dst_rect.max_y;
-  sk_canvas_clip_rect(sc, &rect);
+  float inv_n = 1.0f / ((float)n);
+  float prev_dx = 3.0f * (x1 - x0);
+  float prev_dy = 3.0f * (y1 - y0);
+  for (int32_t i = 1; i <= n; i++) {
+    float s = ((float)i) * inv_n;
+    float u = 1.0f - s;
+    float px = x3;
+    float py = y3;
+    if (i < n) {
+      float b0 = u * u * u;
+      float b1 = 3.0f * u * u * s;
+      float b2 = 3.0f * u * s * s;
+      float b3 = s * s * s;
+      px = (b0 * x0) + (b1 * x1) + (b2 * x2) + (b3 * x3);
+      py = (b0 * y0) + (b1 * y1) + (b2 * y2) + (b3 * y3);
+    }
+    if (t->mode != ICONVG_TESSELLATION_MODE__CURVES) {
+      iconvg_private_tessellation__fan_to(t, px, py);
+      continue;
+    }
+
+    // The piece's cubic control points are its end points plus or minus a
+    // third of the (scaled by inv_n) derivatives there.
+    float dx = 3.0f * (((x1 - x0) * u * u) + (2.0f * (x2 - x1) * u * s) +
+                       ((x3 - x2) * s * s));
+    float dy = 3.0f * (((y1 - y0) * u * u) + (2.0f * (y2 - y1) * u * s) +
+                       ((y3 - y2) * s * s));
+    float h = inv_n / 3.0f;
+    float qx0 = t->private_impl.prev_x;
+    float qy0 = t->private_impl.prev_y;
+    float c1x = qx0 + (h * prev_dx);
+    float c1y = qy0 + (h * prev_dy);
+    float c2x = px - (h * dx);
+    float c2y = py - (h * dy);
+    iconvg_private_tessellation__quad_to(
+        t, ((3.0f * (c1x + c2x)) - (qx0 + px)) / 4.0f,
+        ((3.0f * (c1y + c2y)) - (qy0 + py)) / 4.0f, px, py);
+    prev_dx = dx;
+    prev_dy = dy;
+  }
+}
 
+// ----
+
+static const char*  //
+iconvg_private_tessellator_canvas__begin_decode(iconvg_canvas* c,
+                                                iconvg_rectangle_f32 dst_rect) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  t->num_vertices = 0;
+  t->num_indices = 0;
+  t->num_draws = 0;
+  t->num_stops = 0;
+  memset(&t->private_impl, 0, sizeof(t->private_impl));
+  t->private_impl.dst_rect = dst_rect;
+  t->private_impl.tolerance =
+      (t->tolerance > 0) ? t->tolerance
+                         : ICONVG_PRIVATE_TESSELLATOR_DEFAULT_TOLERANCE;
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__end_decode(iconvg_canvas* c,
-                                       const char* err_msg,
-                                       size_t num_bytes_consumed,
-                                       size_t num_bytes_remaining) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
-  }
-  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_canvas_restore(sc);
+iconvg_private_tessellator_canvas__end_decode(iconvg_canvas* c,
+                                              const char* err_msg,
+                                              size_t num_bytes_consumed,
+                                              size_t num_bytes_remaining) {
   return err_msg;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__begin_drawing(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
-  }
-  spb = sk_pathbuilder_new();
-  if (!spb) {
-    return iconvg_error_system_failure_out_of_memory;
-  }
-  c->context_nonconst_ptr2 = spb;
+iconvg_private_tessellator_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  t->private_impl.bounds[0] = +INFINITY;
+  t->private_impl.bounds[1] = +INFINITY;
+  t->private_impl.bounds[2] = -INFINITY;
+  t->private_impl.bounds[3] = -INFINITY;
+  t->private_impl.first_index = (uint32_t)(t->num_indices);
+  t->private_impl.has_anchor = false;
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
-                                        const iconvg_paint* p) {
-  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+iconvg_private_tessellator_canvas__end_drawing(iconvg_canvas* c,
+                                               const iconvg_paint* p) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  uint32_t first_index = t->private_impl.first_index;
+  if (t->num_indices == first_index) {
+    return NULL;
+  }
 
-  iconvg_paint_type paint_type = iconvg_paint__type(p);
-  switch (paint_type) {
-    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
-      iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
-      sk_path_t* path = sk_pathbuilder_detach_path(spb);
-      sk_paint_t* paint = sk_paint_new();
-      sk_paint_set_antialias(paint, true);
-      sk_paint_set_color(
-          paint, sk_color_set_argb(k.rgba[3], k.rgba[0], k.rgba[1], k.rgba[2]));
-      sk_canvas_draw_path(sc, path, paint);
-      sk_paint_delete(paint);
-      sk_path_delete(path);
-      return NULL;
-    }
+  iconvg_tessellation_draw d;
+  memset(&d, 0, sizeof(d));
+  d.first_index = first_index;
+  d.num_indices = (uint32_t)(t->num_indices - first_index);
+  d.paint_type = iconvg_paint__type(p);
+  switch (d.paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR:
+      d.flat_color = iconvg_paint__flat_color_as_premul_color(p);
+      break;
     case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
     case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      d.gradient_spread = iconvg_paint__gradient_spread(p);
+      d.gradient_matrix = iconvg_paint__gradient_transformation_matrix(p);
+      d.first_stop = (uint32_t)(t->num_stops);
+      d.num_stops = iconvg_paint__gradient_number_of_stops(p);
+      for (uint32_t i = 0; i < d.num_stops; i++) {
+        size_t j = t->num_stops++;
+        if (j < t->stops_len) {
+          t->stops_ptr[j].offset = iconvg_paint__gradient_stop_offset(p, i);
+          t->stops_ptr[j].color =
+              iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+        }
+      }
       break;
     default:
       return iconvg_error_invalid_paint_type;
   }
 
-  // The matrix in IconVG's API converts from dst coordinate space to pattern
-  // coordinate space. Skia's API is the other way around (matrix inversion).
-  iconvg_matrix_2x3_f64 im = iconvg_paint__gradient_transformation_matrix(p);
-  if (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) {
-    iconvg_matrix_2x3_f64__override_second_row(&im);
-  }
-  im = iconvg_matrix_2x3_f64__inverse(&im);
-  sk_matrix_t sm;
-  sm.mat[0] = im.elems[0][0];
-  sm.mat[1] = im.elems[0][1];
-  sm.mat[2] = im.elems[0][2];
-  sm.mat[3] = im.elems[1][0];
-  sm.mat[4] = im.elems[1][1];
-  sm.mat[5] = im.elems[1][2];
-  sm.mat[6] = 0.0f;
-  sm.mat[7] = 0.0f;
-  sm.mat[8] = 1.0f;
-
-  // The gradient is either:
-  //   - linear, from (0, 0) to (1, 0), or
-  //   - radial, centered at (0, 0).
-  sk_point_t gradient_points[2];
-  gradient_points[0].x = 0;
-  gradient_points[0].y = 0;
-  gradient_points[1].x = 1;
-  gradient_points[1].y = 0;
-
-  // Configure the gradient stops.
-  //
-  // Skia doesn't have NONE_SK_SHADER_TILEMODE. Use CLAMP_SK_SHADER_TILEMODE
-  // instead, for IconVG's ICONVG_GRADIENT_SPREAD__NONE, adding a transparent
-  // black gradient stop at both ends.
-  //
-  // 1010 equals ((63 * 16) + 2). 63 is the maximum (inclusive) number of
-  // gradient stops. iconvg_private_skia_set_gradient_stops can expand each
-  // IconVG stop to up to 16 Skia stops. There's also 2 extra stops if we
-  // use the ICONVG_GRADIENT_SPREAD__NONE workaround.
-  sk_color_t gradient_colors[1010];
-  float gradient_offsets[1010];
-  sk_color_t* gcol = &gradient_colors[0];
-  float* goff = &gradient_offsets[0];
-  iconvg_gradient_spread gradient_spread = iconvg_paint__gradient_spread(p);
-  uint32_t gradient_num_stops = 0;
-  if (gradient_spread == ICONVG_GRADIENT_SPREAD__NONE) {
-    *gcol++ = sk_color_set_argb(0x00, 0x00, 0x00, 0x00);
-    *goff++ = 0.0f;
-    gradient_num_stops++;
-  }
-  {
-    uint32_t additional_stops =
-        iconvg_private_skia_set_gradient_stops(gcol, goff, p);
-    gcol += additional_stops;
-    goff += additional_stops;
-    gradient_num_stops += additional_stops;
-  }
-  if (gradient_spread == ICONVG_GRADIENT_SPREAD__NONE) {
-    *gcol++ = sk_color_set_argb(0x00, 0x00, 0x00, 0x00);
-    *goff++ = 0.0f;
-    gradient_num_stops++;
-  }
-
-  // Make the Skia shader.
-  sk_shader_t* shader = NULL;
-  if (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) {
-    shader = sk_shader_new_linear_gradient(
-        gradient_points, gradient_colors, gradient_offsets, gradient_num_stops,
-        iconvg_private_gradient_spread_as_sk_shader_tilemode_t[gradient_spread],
-        &sm);
-  } else {
-    static const float radius = 1.0f;
-    shader = sk_shader_new_radial_gradient(
-        gradient_points, radius, gradient_colors, gradient_offsets,
-        gradient_num_stops,
-        iconvg_private_gradient_spread_as_sk_shader_tilemode_t[gradient_spread],
-        &sm);
-  }
-
-  // Use the Skia shader.
-  if (shader) {
-    sk_path_t* path = sk_pathbuilder_detach_path(spb);
-    sk_paint_t* paint = sk_paint_new();
-    sk_paint_set_antialias(paint, true);
-    sk_paint_set_shader(paint, shader);
-    sk_shader_unref(shader);
-    sk_canvas_draw_path(sc, path, paint);
-    sk_paint_delete(paint);
-    sk_path_delete(path);
+  // The vertices (including curve control points) bound the triangles. The
+  // dst_rect clips the cover rectangle.
+  const float* b = &t->private_impl.bounds[0];
+  const iconvg_rectangle_f32* r = &t->private_impl.dst_rect;
+  d.cover_rect.min_x = (b[0] > r->min_x) ? b[0] : r->min_x;
+  d.cover_rect.min_y = (b[1] > r->min_y) ? b[1] : r->min_y;
+  d.cover_rect.max_x = (b[2] < r->max_x) ? b[2] : r->max_x;
+  d.cover_rect.max_y = (b[3] < r->max_y) ? b[3] : r->max_y;
+  if (!iconvg_rectangle_f32__is_finite_and_not_empty(&d.cover_rect)) {
+    d.cover_rect = iconvg_rectangle_f32__make(r->min_x, r->min_y, r->min_x,
+                                              r->min_y);
   }
 
-  // Clean up.
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+  size_t i = t->num_draws++;
+  if (i < t->draws_len) {
+    t->draws_ptr[i] = d;
   }
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_move_to(spb, x0, y0);
+iconvg_private_tessellator_canvas__begin_path(iconvg_canvas* c,
+                                              float x0,
+                                              float y0) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  uint32_t v = iconvg_private_tessellation__vertex(t, x0, y0, 0.0f, 1.0f);
+  if (!t->private_impl.has_anchor) {
+    t->private_impl.has_anchor = true;
+    t->private_impl.anchor_vertex = v;
+  }
+  t->private_impl.contour_start_vertex = v;
+  t->private_impl.prev_vertex = v;
+  t->private_impl.prev_x = x0;
+  t->private_impl.prev_y = y0;
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__end_path(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_close(spb);
+iconvg_private_tessellator_canvas__end_path(iconvg_canvas* c) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  uint32_t start = t->private_impl.contour_start_vertex;
+  uint32_t prev = t->private_impl.prev_vertex;
+  if ((start != t->private_impl.anchor_vertex) &&
+      (prev != t->private_impl.anchor_vertex) && (start != prev)) {
+    iconvg_private_tessellation__triangle(t, t->private_impl.anchor_vertex,
+                                          prev, start);
+  }
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_line_to(spb, x1, y1);
+iconvg_private_tessellator_canvas__path_line_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1) {
+  iconvg_private_tessellation__fan_to(
+      iconvg_private_tessellator_canvas__state(c), x1, y1);
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__path_quad_to(iconvg_canvas* c,
-                                         float x1,
-                                         float y1,
-                                         float x2,
-                                         float y2) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_quad_to(spb, x1, y1, x2, y2);
+iconvg_private_tessellator_canvas__path_quad_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2) {
+  iconvg_private_tessellation__quad_to(
+      iconvg_private_tessellator_canvas__state(c), x1, y1, x2, y2);
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__path_cube_to(iconvg_canvas* c,
-                                         float x1,
-                                         float y1,
-                                         float x2,
-                                         float y2,
-                                         float x3,
-                                         float y3) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_cubic_to(spb, x1, y1, x2, y2, x3, y3);
+iconvg_private_tessellator_canvas__path_cube_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2,
+                                                float x3,
+                                                float y3) {
+  iconvg_private_tessellation__cube_to(
+      iconvg_private_tessellator_canvas__state(c), x1, y1, x2, y2, x3, y3);
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__on_metadata_viewbox(iconvg_canvas* c,
-                                                iconvg_rectangle_f32 viewbox) {
+iconvg_private_tessellator_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
   return NULL;
 }
 
 static const char*  //
-iconvg_private_skia_canvas__on_metadata_suggested_palette(
+iconvg_private_tessellator_canvas__on_metadata_suggested_palette(
     iconvg_canvas* c,
     const iconvg_palette* suggested_palette) {
   return NULL;
 }
 
+static const char*  //
+iconvg_private_tessellator_canvas__path_segments(iconvg_canvas* c,
+                                                 const uint8_t* verbs,
+                                                 size_t num_verbs,
+                                                 const float* points) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        iconvg_private_tessellation__fan_to(t, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        iconvg_private_tessellation__quad_to(t, points[0], points[1],
+                                             points[2], points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        iconvg_private_tessellation__cube_to(t, points[0], points[1],
+                                             points[2], points[3], points[4],
+                                             points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
 static const iconvg_canvas_vtable  //
-    iconvg_private_skia_canvas_vtable = {
+    iconvg_private_tessellator_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
-        &iconvg_private_skia_canvas__begin_decode,
-        &iconvg_private_skia_canvas__end_decode,
-        &iconvg_private_skia_canvas__begin_drawing,
-        &iconvg_private_skia_canvas__end_drawing,
-        &iconvg_private_skia_canvas__begin_path,
-        &iconvg_private_skia_canvas__end_path,
-        &iconvg_private_skia_canvas__path_line_to,
-        &iconvg_private_skia_canvas__path_quad_to,
-        &iconvg_private_skia_canvas__path_cube_to,
-        &iconvg_private_skia_canvas__on_metadata_viewbox,
-        &iconvg_private_skia_canvas__on_metadata_suggested_palette,
+        &iconvg_private_tessellator_canvas__begin_decode,
+        &iconvg_private_tessellator_canvas__end_decode,
+        &iconvg_private_tessellator_canvas__begin_drawing,
+        &iconvg_private_tessellator_canvas__end_drawing,
+        &iconvg_private_tessellator_canvas__begin_path,
+        &iconvg_private_tessellator_canvas__end_path,
+        &iconvg_private_tessellator_canvas__path_line_to,
+        &iconvg_private_tessellator_canvas__path_quad_to,
+        &iconvg_private_tessellator_canvas__path_cube_to,
+        &iconvg_private_tessellator_canvas__on_metadata_viewbox,
+        &iconvg_private_tessellator_canvas__on_metadata_suggested_palette,
+        &iconvg_private_tessellator_canvas__path_segments,
+        NULL,
 };
 
 iconvg_canvas  //
-iconvg_canvas__make_skia(sk_canvas_t* sc) {
-  if (!sc) {
+iconvg_canvas__make_tessellator(iconvg_tessellation* t) {
+  if (!t) {
     return iconvg_canvas__make_broken(
         iconvg_error_invalid_constructor_argument);
   }
   iconvg_canvas c;
-  c.vtable = &iconvg_private_skia_canvas_vtable;
+  c.vtable = &iconvg_private_tessellator_canvas_vtable;
   memset(&c.context, 0, sizeof(c.context));
-  c.context.nonconst_ptr1 = sc;
+  c.context.nonconst_ptr1 = t;
   return c;
 }
 
-#endif  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
+bool  //
+iconvg_tessellation__is_complete(const iconvg_tessellation* self) {
+  return self && (self->num_vertices <= self->vertices_len) &&
+         (self->num_indices <= self->indices_len) &&
+         (self->num_draws <= self->draws_len) &&
+         (self->num_stops <= self->stops_len);
+}
+
+// -------------------------------- #include "./transform.c"
+
+// The transform canvas wraps another canvas, applying an
+// iconvg_decode_options' transform to every point (and to dst_rect) on the
+// way. Its context fields hold:
+//  - nonconst_ptr1: the wrapped iconvg_canvas, whose vtable the caller has
+//    already checked is supported.
+//  - const_ptr3: the iconvg_matrix_2x3_f64 transform.
+
+// iconvg_private_transform_points sets dst[.. 2 * num_points] to the
+// m-transformed src[.. 2 * num_points], (x, y) pairs in both cases. It is one
+// pass over the points, with the matrix held in local variables.
+static void  //
+iconvg_private_transform_points(const iconvg_matrix_2x3_f64* m,
+                                float* dst,
+                                const float* src,
+                                size_t num_points) {
+  double m00 = m->elems[0][0];
+  double m01 = m->elems[0][1];
+  double m02 = m->elems[0][2];
+  double m10 = m->elems[1][0];
+  double m11 = m->elems[1][1];
+  double m12 = m->elems[1][2];
+  for (; num_points > 0; num_points--, dst += 2, src += 2) {
+    double x = (double)(src[0]);
+    double y = (double)(src[1]);
+    dst[0] = (float)((x * m00) + (y * m01) + m02);
+    dst[1] = (float)((x * m10) + (y * m11) + m12);
+  }
+}
+
+static inline void  //
+iconvg_private_transform_canvas__points(iconvg_canvas* c,
+                                        float* dst,
+                                        const float* src,
+                                        size_t num_points) {
+  iconvg_private_transform_points(
+      (const iconvg_matrix_2x3_f64*)(c->context.const_ptr3), dst, src,
+      num_points);
+}
+
+iconvg_rectangle_f32  //
+iconvg_private_matrix_2x3_f64__transform_bounds(const iconvg_matrix_2x3_f64* m,
+                                                iconvg_rectangle_f32 r) {
+  float corners[8];
+  corners[0] = r.min_x;
+  corners[1] = r.min_y;
+  corners[2] = r.max_x;
+  corners[3] = r.min_y;
+  corners[4] = r.min_x;
+  corners[5] = r.max_y;
+  corners[6] = r.max_x;
+  corners[7] = r.max_y;
+  iconvg_private_transform_points(m, &corners[0], &corners[0], 4);
+  iconvg_rectangle_f32 b = iconvg_rectangle_f32__make(
+      corners[0], corners[1], corners[0], corners[1]);
+  for (int i = 2; i < 8; i += 2) {
+    b.min_x = (b.min_x < corners[i + 0]) ? b.min_x : corners[i + 0];
+    b.min_y = (b.min_y < corners[i + 1]) ? b.min_y : corners[i + 1];
+    b.max_x = (b.max_x > corners[i + 0]) ? b.max_x : corners[i + 0];
+    b.max_y = (b.max_y > corners[i + 1]) ? b.max_y : corners[i + 1];
+  }
+  return b;
+}
+
+static const char*  //
+iconvg_private_transform_canvas__begin_decode(iconvg_canvas* c,
+                                              iconvg_rectangle_f32 dst_rect) {
+  // The wrapped canvas sees the bounding box of the transformed dst_rect.
+  iconvg_rectangle_f32 r = iconvg_private_matrix_2x3_f64__transform_bounds(
+      (const iconvg_matrix_2x3_f64*)(c->context.const_ptr3), dst_rect);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->begin_decode)(wrapped, r);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__end_decode(iconvg_canvas* c,
+                                            const char* err_msg,
+                                            size_t num_bytes_consumed,
+                                            size_t num_bytes_remaining) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__end_drawing(iconvg_canvas* c,
+                                             const iconvg_paint* p) {
+  // The paint's gradient transformation matrix already accounts for the
+  // transform (see iconvg_private_paint__initialize).
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->end_drawing)(wrapped, p);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__begin_path(iconvg_canvas* c,
+                                            float x0,
+                                            float y0) {
+  float p[2] = {x0, y0};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 1);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->begin_path)(wrapped, p[0], p[1]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__end_path(iconvg_canvas* c) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->end_path)(wrapped);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_line_to(iconvg_canvas* c,
+                                              float x1,
+                                              float y1) {
+  float p[2] = {x1, y1};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 1);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->path_line_to)(wrapped, p[0], p[1]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_quad_to(iconvg_canvas* c,
+                                              float x1,
+                                              float y1,
+                                              float x2,
+                                              float y2) {
+  float p[4] = {x1, y1, x2, y2};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->path_quad_to)(wrapped, p[0], p[1], p[2], p[3]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_cube_to(iconvg_canvas* c,
+                                              float x1,
+                                              float y1,
+                                              float x2,
+                                              float y2,
+                                              float x3,
+                                              float y3) {
+  float p[6] = {x1, y1, x2, y2, x3, y3};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 3);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->path_cube_to)(wrapped, p[0], p[1], p[2], p[3],
+                                          p[4], p[5]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_segments(iconvg_canvas* c,
+                                               const uint8_t* verbs,
+                                               size_t num_verbs,
+                                               const float* points) {
+  // Transform the points in chunks: up to a batch's worth of verbs at a time.
+  float buf[6 * ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS];
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  while (num_verbs > 0) {
+    size_t n = (num_verbs < ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS)
+                   ? num_verbs
+                   : ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS;
+    size_t num_points = 0;
+    for (size_t i = 0; i < n; i++) {
+      if ((verbs[i] < ICONVG_PATH_VERB__LINE_TO) ||
+          (verbs[i] > ICONVG_PATH_VERB__CUBE_TO)) {
+        return iconvg_error_invalid_path_verb;
+      }
+      num_points += verbs[i];
+    }
+    iconvg_private_transform_canvas__points(c, &buf[0], points, num_points);
+    ICONVG_PRIVATE_TRY(
+        iconvg_private_canvas__path_segments(wrapped, verbs, n, &buf[0]));
+    verbs += n;
+    num_verbs -= n;
+    points += 2 * num_points;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_transform_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return iconvg_private_canvas__on_skipped_drawing(wrapped);
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_transform_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_transform_canvas__begin_decode,
+        &iconvg_private_transform_canvas__end_decode,
+        &iconvg_private_transform_canvas__begin_drawing,
+        &iconvg_private_transform_canvas__end_drawing,
+        &iconvg_private_transform_canvas__begin_path,
+        &iconvg_private_transform_canvas__end_path,
+        &iconvg_private_transform_canvas__path_line_to,
+        &iconvg_private_transform_canvas__path_quad_to,
+        &iconvg_private_transform_canvas__path_cube_to,
+        &iconvg_private_transform_canvas__on_metadata_viewbox,
+        &iconvg_private_transform_canvas__on_metadata_suggested_palette,
+        &iconvg_private_transform_canvas__path_segments,
+        &iconvg_private_transform_canvas__on_skipped_drawing,
+};
+
+iconvg_canvas  //
+iconvg_private_canvas__make_transform(iconvg_canvas* wrapped,
+                                      const iconvg_matrix_2x3_f64* m) {
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_transform_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.const_ptr3 = m;
+  return c;
+}
 
 #endif  // ICONVG_IMPLEMENTATION
 
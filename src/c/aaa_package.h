@@ -28,16 +28,28 @@
 #ifdef ICONVG_IMPLEMENTATION
 #include "./aaa_private.h"
 #include "./arc.c"
+#include "./arena.c"
+#include "./atlas.c"
+#include "./batch.c"
+#include "./bitmap_cache.c"
 #include "./broken.c"
 #include "./cairo.c"
 #include "./color.c"
+#include "./compiled.c"
 #include "./debug.c"
 #include "./decoder.c"
 #include "./error.c"
+#include "./gradient_cache.c"
+#include "./icon_pack.c"
 #include "./matrix.c"
 #include "./paint.c"
+#include "./player.c"
+#include "./rasterizer.c"
 #include "./rectangle.c"
 #include "./skia.c"
+#include "./stats.c"
+#include "./tessellator.c"
+#include "./transform.c"
 #endif  // ICONVG_IMPLEMENTATION
 
 #endif  // ICONVG_INCLUDE_GUARD
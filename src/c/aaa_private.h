@@ -28,6 +28,24 @@
     }                                                 \
   } while (false)
 
+// ICONVG_PRIVATE_ALWAYS_INLINE marks a function that must be inlined into its
+// callers for the compiler to specialize it, such as an opcode loop that is
+// instantiated once per value of a bool argument.
+#if defined(__GNUC__) || defined(__clang__)
+#define ICONVG_PRIVATE_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define ICONVG_PRIVATE_ALWAYS_INLINE inline
+#endif
+
+// ICONVG_PRIVATE_NOINLINE marks a function that should stay out of line, so
+// that its code does not add to the register pressure and size of a hot loop
+// that only sometimes calls it.
+#if defined(__GNUC__) || defined(__clang__)
+#define ICONVG_PRIVATE_NOINLINE __attribute__((noinline))
+#else
+#define ICONVG_PRIVATE_NOINLINE
+#endif
+
 // ----
 
 extern const char iconvg_private_internal_error_unreachable[];
@@ -62,6 +80,33 @@ iconvg_private_reinterpret_from_u32_to_f32(uint32_t u) {
   return f;
 }
 
+static inline uint32_t  //
+iconvg_private_reinterpret_from_f32_to_u32(float f) {
+  uint32_t u = 0;
+  if (sizeof(uint32_t) == sizeof(float)) {
+    memcpy(&u, &f, sizeof(uint32_t));
+  }
+  return u;
+}
+
+static inline double  //
+iconvg_private_reinterpret_from_u64_to_f64(uint64_t u) {
+  double f = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&f, &u, sizeof(uint64_t));
+  }
+  return f;
+}
+
+static inline uint64_t  //
+iconvg_private_reinterpret_from_f64_to_u64(double f) {
+  uint64_t u = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&u, &f, sizeof(uint64_t));
+  }
+  return u;
+}
+
 // ----
 
 static inline size_t  //
@@ -72,6 +117,313 @@ iconvg_private_canvas_sizeof_vtable(iconvg_canvas* c) {
   return 0;
 }
 
+// ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1 is the sizeof a ¶0.1
+// iconvg_canvas_vtable, before the path_segments field was appended.
+#define ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1 \
+  offsetof(iconvg_canvas_vtable, path_segments)
+
+// iconvg_private_canvas_vtable_is_supported returns whether iconvg_decode and
+// similar functions can call c's methods. Older (smaller) vtables are
+// supported, since fields are only ever appended and the fields appended after
+// ¶0.1 are all optional. If we want to support newer library versions (with
+// dynamic linking), we could also accept larger vtables here.
+static inline bool  //
+iconvg_private_canvas_vtable_is_supported(iconvg_canvas* c) {
+  size_t n = iconvg_private_canvas_sizeof_vtable(c);
+  return (ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1 <= n) &&
+         (n <= sizeof(iconvg_canvas_vtable));
+}
+
+static inline bool  //
+iconvg_private_canvas_has_path_segments(iconvg_canvas* c) {
+  return (iconvg_private_canvas_sizeof_vtable(c) >=
+          (offsetof(iconvg_canvas_vtable, path_segments) +
+           sizeof(c->vtable->path_segments))) &&
+         c->vtable->path_segments;
+}
+
+// iconvg_private_canvas__on_skipped_drawing calls c's on_skipped_drawing
+// method, if it has one.
+static inline const char*  //
+iconvg_private_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  if ((iconvg_private_canvas_sizeof_vtable(c) >=
+       (offsetof(iconvg_canvas_vtable, on_skipped_drawing) +
+        sizeof(c->vtable->on_skipped_drawing))) &&
+      c->vtable->on_skipped_drawing) {
+    return (*c->vtable->on_skipped_drawing)(c);
+  }
+  return NULL;
+}
+
+// ----
+
+// Single-backend builds can define one of these macros, so that the opcode
+// loops (of iconvg_decode, iconvg_decode_compiled and the stream decoder) call
+// that backend's canvas methods directly instead of through the vtable:
+//  - ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND
+//  - ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND
+//  - ICONVG_CONFIG__SPECIALIZE_RASTERIZER_BACKEND
+// The Cairo and Skia ones also need the matching ICONVG_CONFIG__ENABLE_ETC
+// macro. This only works with the single file (amalgamated) library, where the
+// backend's static functions are visible to the decoders.
+//
+// Each loop is then instantiated twice. The specialized copy is used when the
+// canvas is one of that backend's, not wrapped (e.g. by a transform), and lets
+// the compiler inline the backend's begin_drawing, begin_path etc methods and,
+// for backends without a path_segments method, its per-segment methods. Every
+// other canvas takes the generic (vtable) copy, as usual.
+//
+// ICONVG_PRIVATE_SPECIALIZED(method) names the chosen backend's function for
+// a canvas method.
+#if defined(ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND) +   \
+        defined(ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND) + \
+        defined(ICONVG_CONFIG__SPECIALIZE_RASTERIZER_BACKEND) > \
+    1
+#error "at most one ICONVG_CONFIG__SPECIALIZE_ETC macro can be defined"
+#elif defined(ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND)
+#if !defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+#error "ICONVG_CONFIG__SPECIALIZE_CAIRO_BACKEND needs ..._ENABLE_CAIRO_BACKEND"
+#endif
+#define ICONVG_PRIVATE_SPECIALIZED(method) iconvg_private_cairo_canvas__##method
+#elif defined(ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND)
+#if !defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+#error "ICONVG_CONFIG__SPECIALIZE_SKIA_BACKEND needs ..._ENABLE_SKIA_BACKEND"
+#endif
+#define ICONVG_PRIVATE_SPECIALIZED(method) iconvg_private_skia_canvas__##method
+#elif defined(ICONVG_CONFIG__SPECIALIZE_RASTERIZER_BACKEND)
+#define ICONVG_PRIVATE_SPECIALIZED(method) \
+  iconvg_private_rasterizer_canvas__##method
+#endif
+
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+
+// These are defined (as static functions) later in the single file library.
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(begin_drawing)(iconvg_canvas* c);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(end_drawing)(iconvg_canvas* c,
+                                        const iconvg_paint* p);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(begin_path)(iconvg_canvas* c, float x0, float y0);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(end_path)(iconvg_canvas* c);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(path_line_to)(iconvg_canvas* c, float x1, float y1);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(path_quad_to)(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2);
+static const char*  //
+ICONVG_PRIVATE_SPECIALIZED(path_cube_to)(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2,
+                                         float x3,
+                                         float y3);
+
+#define ICONVG_PRIVATE_IF_SPECIALIZED(specialized, method, ...) \
+  if (specialized) {                                            \
+    return ICONVG_PRIVATE_SPECIALIZED(method)(__VA_ARGS__);     \
+  }
+
+#else
+#define ICONVG_PRIVATE_IF_SPECIALIZED(specialized, method, ...)
+#endif  // defined(ICONVG_PRIVATE_SPECIALIZED)
+
+// iconvg_private_canvas_is_specialized returns whether c is a canvas of the
+// ICONVG_CONFIG__SPECIALIZE_ETC backend. All of a backend's canvases share
+// one vtable, so it suffices to check one of the vtable's methods.
+static inline bool  //
+iconvg_private_canvas_is_specialized(iconvg_canvas* c) {
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+  return c && c->vtable &&
+         (c->vtable->begin_path == &ICONVG_PRIVATE_SPECIALIZED(begin_path));
+#else
+  return false;
+#endif
+}
+
+// iconvg_private_canvas__begin_drawing etc call c's method, either directly
+// (if specialized, a compile time constant) or through c's vtable.
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__begin_drawing(iconvg_canvas* c, bool specialized) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, begin_drawing, c);
+  return (*c->vtable->begin_drawing)(c);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__end_drawing(iconvg_canvas* c,
+                                   bool specialized,
+                                   const iconvg_paint* p) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, end_drawing, c, p);
+  return (*c->vtable->end_drawing)(c, p);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__begin_path(iconvg_canvas* c,
+                                  bool specialized,
+                                  float x0,
+                                  float y0) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, begin_path, c, x0, y0);
+  return (*c->vtable->begin_path)(c, x0, y0);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_canvas__end_path(iconvg_canvas* c, bool specialized) {
+  ICONVG_PRIVATE_IF_SPECIALIZED(specialized, end_path, c);
+  return (*c->vtable->end_path)(c);
+}
+
+// ----
+
+#define ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS 32
+
+// iconvg_private_path_batch accumulates consecutive path segments for a
+// canvas' path_segments method. If the canvas doesn't have that method then
+// enabled is false and segments are passed straight through to the canvas'
+// per-segment methods (directly, not through the vtable, for a specialized
+// canvas; see ICONVG_PRIVATE_SPECIALIZED).
+typedef struct iconvg_private_path_batch_struct {
+  bool enabled;
+  size_t num_verbs;
+  size_t num_points;
+  uint8_t verbs[ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS];
+  float points[6 * ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS];
+} iconvg_private_path_batch;
+
+static inline void  //
+iconvg_private_path_batch__initialize(iconvg_private_path_batch* self,
+                                      iconvg_canvas* c) {
+  self->enabled = iconvg_private_canvas_has_path_segments(c);
+  self->num_verbs = 0;
+  self->num_points = 0;
+}
+
+// iconvg_private_path_batch__flush passes any accumulated segments to c. It
+// must be called before any other (non-segment) canvas method is called.
+static inline const char*  //
+iconvg_private_path_batch__flush(iconvg_private_path_batch* self,
+                                 iconvg_canvas* c) {
+  size_t n = self->num_verbs;
+  if (n == 0) {
+    return NULL;
+  }
+  self->num_verbs = 0;
+  self->num_points = 0;
+  return (*c->vtable->path_segments)(c, &self->verbs[0], n, &self->points[0]);
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_path_batch__line_to(iconvg_private_path_batch* self,
+                                   iconvg_canvas* c,
+                                   bool specialized,
+                                   float x1,
+                                   float y1) {
+  if (!self->enabled) {
+    ICONVG_PRIVATE_IF_SPECIALIZED(specialized, path_line_to, c, x1, y1);
+    return (*c->vtable->path_line_to)(c, x1, y1);
+  } else if (self->num_verbs == ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(self, c));
+  }
+  float* p = &self->points[self->num_points];
+  p[0] = x1;
+  p[1] = y1;
+  self->num_points += 2;
+  self->verbs[self->num_verbs++] = ICONVG_PATH_VERB__LINE_TO;
+  return NULL;
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_path_batch__quad_to(iconvg_private_path_batch* self,
+                                   iconvg_canvas* c,
+                                   bool specialized,
+                                   float x1,
+                                   float y1,
+                                   float x2,
+                                   float y2) {
+  if (!self->enabled) {
+    ICONVG_PRIVATE_IF_SPECIALIZED(specialized, path_quad_to, c, x1, y1, x2, y2);
+    return (*c->vtable->path_quad_to)(c, x1, y1, x2, y2);
+  } else if (self->num_verbs == ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(self, c));
+  }
+  float* p = &self->points[self->num_points];
+  p[0] = x1;
+  p[1] = y1;
+  p[2] = x2;
+  p[3] = y2;
+  self->num_points += 4;
+  self->verbs[self->num_verbs++] = ICONVG_PATH_VERB__QUAD_TO;
+  return NULL;
+}
+
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_path_batch__cube_to(iconvg_private_path_batch* self,
+                                   iconvg_canvas* c,
+                                   bool specialized,
+                                   float x1,
+                                   float y1,
+                                   float x2,
+                                   float y2,
+                                   float x3,
+                                   float y3) {
+  if (!self->enabled) {
+    ICONVG_PRIVATE_IF_SPECIALIZED(specialized, path_cube_to, c, x1, y1, x2, y2,
+                                  x3, y3);
+    return (*c->vtable->path_cube_to)(c, x1, y1, x2, y2, x3, y3);
+  } else if (self->num_verbs == ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(self, c));
+  }
+  float* p = &self->points[self->num_points];
+  p[0] = x1;
+  p[1] = y1;
+  p[2] = x2;
+  p[3] = y2;
+  p[4] = x3;
+  p[5] = y3;
+  self->num_points += 6;
+  self->verbs[self->num_verbs++] = ICONVG_PATH_VERB__CUBE_TO;
+  return NULL;
+}
+
+// iconvg_private_canvas__path_segments calls c's path_segments method, if it
+// has one, or otherwise calls its per-segment methods.
+static inline const char*  //
+iconvg_private_canvas__path_segments(iconvg_canvas* c,
+                                     const uint8_t* verbs,
+                                     size_t num_verbs,
+                                     const float* points) {
+  if (iconvg_private_canvas_has_path_segments(c)) {
+    return (*c->vtable->path_segments)(c, verbs, num_verbs, points);
+  }
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(c, points[0], points[1]));
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to)(c, points[0], points[1],
+                                                      points[2], points[3]));
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
+            c, points[0], points[1], points[2], points[3], points[4],
+            points[5]));
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
 // ----
 
 static inline iconvg_rectangle_f32  //
@@ -91,6 +443,271 @@ typedef struct iconvg_private_decoder_struct {
   size_t len;
 } iconvg_private_decoder;
 
+static inline bool  //
+iconvg_private_decoder__decode_coordinate_number(iconvg_private_decoder* self,
+                                                 float* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      int32_t i = (int32_t)(v >> 1);
+      *dst = ((float)(i - 64));
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
+        *dst = ((float)(i - (128 * 64))) / 64.0f;
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        // TODO: reject NaNs?
+        *dst = iconvg_private_reinterpret_from_u32_to_f32(
+            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// iconvg_private_decoder__decode_coordinate_numbers_in_bulk is the fast path
+// of iconvg_private_decoder__decode_coordinate_numbers, for when self holds at
+// least 4 * n bytes. Each number is 1, 2 or 4 bytes long, so the bounds are
+// checked once, up front, instead of once per number. Each number is then
+// read with one 4 byte load. It always decodes all n numbers.
+//
+// It is kept out of line so that the opcode loop's code for short ops, the
+// common case, stays as compact as when it decoded one number at a time.
+static ICONVG_PRIVATE_NOINLINE void  //
+iconvg_private_decoder__decode_coordinate_numbers_in_bulk(
+    iconvg_private_decoder* self,
+    float* dst,
+    size_t n) {
+  const uint8_t* p = self->ptr;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t u = iconvg_private_peek_u32le(p);
+    if ((u & 0x01) == 0) {  // 1-byte encoding.
+      dst[i] = ((float)(((int32_t)(0xFF & u) >> 1) - 64));
+      p += 1;
+    } else if ((u & 0x02) == 0) {  // 2-byte encoding.
+      dst[i] = ((float)(((int32_t)(0xFFFF & u) >> 2) - (128 * 64))) / 64.0f;
+      p += 2;
+    } else {  // 4-byte encoding.
+      dst[i] = iconvg_private_reinterpret_from_u32_to_f32(0xFFFFFFFCu & u);
+      p += 4;
+    }
+  }
+  self->len -= (size_t)(p - self->ptr);
+  self->ptr = p;
+}
+
+// ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN is the smallest n for which
+// iconvg_private_decoder__decode_coordinate_numbers takes the bulk path.
+// Shorter runs, such as a single line_to's 2 numbers, are cheaper to decode
+// inline, one at a time, than to call out of line for.
+#define ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN 8
+
+// iconvg_private_decoder__decode_coordinate_numbers decodes up to n
+// coordinate numbers into dst[.. n], stopping at the first one that is
+// truncated. It returns how many were decoded.
+//
+// Long runs, when self holds at least 4 * n bytes, take the out of line bulk
+// path. Short runs, and those near the end of the data, are decoded one
+// number at a time. Either way, the results are the same.
+static inline size_t  //
+iconvg_private_decoder__decode_coordinate_numbers(iconvg_private_decoder* self,
+                                                  float* dst,
+                                                  size_t n) {
+  if ((n >= ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN) &&
+      ((self->len / 4) >= n)) {
+    iconvg_private_decoder__decode_coordinate_numbers_in_bulk(self, dst, n);
+    return n;
+  }
+  size_t i = 0;
+  for (; i < n; i++) {
+    if (!iconvg_private_decoder__decode_coordinate_number(self, &dst[i])) {
+      break;
+    }
+  }
+  return i;
+}
+
+// iconvg_private_decoder__bulk_decode_coordinate_numbers decodes all n
+// coordinate numbers into dst[.. n] and returns dst, if n is at least
+// ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN and self holds at least 4 * n
+// bytes. Otherwise, it decodes nothing and returns NULL, and the caller should
+// decode one number at a time, as it would without a bulk path.
+static inline const float*  //
+iconvg_private_decoder__bulk_decode_coordinate_numbers(
+    iconvg_private_decoder* self,
+    float* dst,
+    size_t n) {
+  if ((n >= ICONVG_PRIVATE_BULK_COORDINATE_NUMBERS_MIN) &&
+      ((self->len / 4) >= n)) {
+    iconvg_private_decoder__decode_coordinate_numbers_in_bulk(self, dst, n);
+    return dst;
+  }
+  return NULL;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
+                                              uint32_t* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      *dst = v >> 1;
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_real_number(iconvg_private_decoder* self,
+                                           float* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      *dst = (float)(v >> 1);
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        *dst = (float)(iconvg_private_peek_u16le(self->ptr) >> 2);
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        // TODO: reject NaNs?
+        *dst = iconvg_private_reinterpret_from_u32_to_f32(
+            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_zero_to_one_number(iconvg_private_decoder* self,
+                                                  float* dst) {
+  if (self->len >= 1) {
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) == 0) {  // 1-byte encoding.
+      *dst = (float)(((double)(v >> 1)) / 120.0);
+      self->ptr += 1;
+      self->len -= 1;
+      return true;
+
+    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
+      if (self->len >= 2) {
+        *dst = (float)(((double)(iconvg_private_peek_u16le(self->ptr) >> 2)) /
+                       15120.0);
+        self->ptr += 2;
+        self->len -= 2;
+        return true;
+      }
+
+    } else {  // 4-byte encoding.
+      if (self->len >= 4) {
+        // TODO: reject NaNs?
+        *dst = iconvg_private_reinterpret_from_u32_to_f32(
+            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
+        self->ptr += 4;
+        self->len -= 4;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// iconvg_private_decoder__decode_metadata decodes the magic identifier and
+// metadata chunks, leaving self positioned at the start of the bytecode.
+//
+// If dst_suggested_palette is NULL then only the ViewBox is decoded (and
+// validated). Other chunks, including ones with unknown metadata IDs, are
+// skipped over, as iconvg_decode_viewbox has always done.
+const char*  //
+iconvg_private_decoder__decode_metadata(iconvg_private_decoder* self,
+                                        iconvg_rectangle_f32* dst_viewbox,
+                                        iconvg_palette* dst_suggested_palette);
+
+// iconvg_private_decoder__drawing_bounds sets dst[.. 4] to the bounding box
+// (min_x, min_y, max_x, max_y), in src coordinates, of a drawing's points:
+// its initial point (x0, y0) and every point, on or off the path, of the
+// drawing mode ops that follow at self's position, up to and including the
+// next 'z' (close_path) op. Arcs contribute the control points of their cubic
+// Bézier approximation.
+//
+// It does not advance self. It returns false if those ops are invalid or
+// incomplete, in which case the caller should decode the drawing as usual,
+// which will report any error.
+bool  //
+iconvg_private_decoder__drawing_bounds(const iconvg_private_decoder* self,
+                                       float* dst,
+                                       float x0,
+                                       float y0);
+
+// ICONVG_PRIVATE_BYTECODE_MODE__ETC are iconvg_private_execute_bytecode's
+// modes. SKIPPING means skipping a drawing that is outside the Level of Detail
+// bounds or the clip rectangle.
+#define ICONVG_PRIVATE_BYTECODE_MODE__STYLING 0
+#define ICONVG_PRIVATE_BYTECODE_MODE__DRAWING 1
+#define ICONVG_PRIVATE_BYTECODE_MODE__SKIPPING 2
+
+// iconvg_private_bytecode_registers holds the iconvg_private_execute_bytecode
+// state, other than the CREG and NREG registers (held in an iconvg_paint),
+// that carries over from one op to the next. It lets decoding suspend and
+// resume at op boundaries.
+typedef struct iconvg_private_bytecode_registers_struct {
+  uint32_t mode;
+  uint32_t sel[2];
+  double lod[2];
+  float curr_x;
+  float curr_y;
+  float x1;
+  float y1;
+} iconvg_private_bytecode_registers;
+
+void  //
+iconvg_private_bytecode_registers__initialize(
+    iconvg_private_bytecode_registers* self);
+
 // ----
 
 extern const uint8_t iconvg_private_one_byte_colors[512];
@@ -138,6 +755,10 @@ struct iconvg_paint_struct {
   iconvg_palette custom_palette;
   iconvg_palette creg;
   float nreg[64];
+  // creg_palette_deps' i'th bit is whether CREG[i] derives from the custom
+  // palette. Paints that don't can be culled, when transparent, without
+  // changing what re-coloring coverage masks (with another palette) gives.
+  uint64_t creg_palette_deps;
 
   // Scale and bias convert between dst coordinates (what this library calls
   // user or canvas coordinate space) and src coordinates (what this library
@@ -163,12 +784,248 @@ struct iconvg_paint_struct {
   double d2s_bias_x;
   double d2s_scale_y;
   double d2s_bias_y;
+
+  // When the iconvg_decode_options has a transform, has_transform is true
+  // and d2s_matrix is its inverse followed by the d2s scale and bias above,
+  // converting from canvas coordinates to src coordinates.
+  bool has_transform;
+  iconvg_matrix_2x3_f64 d2s_matrix;
+
+  // src_clip is the rectangle (min_x, min_y, max_x, max_y), in src
+  // coordinates, outside of which drawings are culled, so that their bounds
+  // can be tested without converting them to dst coordinates. It is the
+  // iconvg_decode_options' clip_rect (if any) intersected with dst_rect (if
+  // there is no transform), or infinite if neither applies. has_clip is
+  // whether there is a clip_rect, which is when decoding IconVG-formatted
+  // data (instead of a compiled form) computes drawings' bounds.
+  bool has_clip;
+  double src_clip[4];
+
+  // cancel and cancel_context are the iconvg_decode_options' fields of the
+  // same name, or NULL.
+  bool (*cancel)(void* cancel_context);
+  void* cancel_context;
 };
 
+// iconvg_private_decode_options__transform returns options' transform, or
+// NULL if options is NULL, predates that field or has it NULL.
+static inline const iconvg_matrix_2x3_f64*  //
+iconvg_private_decode_options__transform(const iconvg_decode_options* options) {
+  if (!options || (options->sizeof__iconvg_decode_options <
+                   (offsetof(iconvg_decode_options, transform) +
+                    sizeof(options->transform)))) {
+    return NULL;
+  }
+  return options->transform;
+}
+
+// iconvg_private_decode_options__clip_rect returns options' clip_rect, or
+// NULL if options is NULL, predates that field or has it NULL.
+static inline const iconvg_rectangle_f32*  //
+iconvg_private_decode_options__clip_rect(const iconvg_decode_options* options) {
+  if (!options || (options->sizeof__iconvg_decode_options <
+                   (offsetof(iconvg_decode_options, clip_rect) +
+                    sizeof(options->clip_rect)))) {
+    return NULL;
+  }
+  return options->clip_rect;
+}
+
+// iconvg_private_paint__is_cancelled returns whether the iconvg_decode_options'
+// cancel callback (if any) asks to stop decoding before the next drawing.
+static inline bool  //
+iconvg_private_paint__is_cancelled(const iconvg_paint* self) {
+  return self->cancel && (*self->cancel)(self->cancel_context);
+}
+
+// iconvg_private_paint__culls returns whether a drawing whose src coordinate
+// bounds (min_x, min_y, max_x, max_y) are b lies entirely outside of self's
+// src_clip rectangle, and so need not be emitted.
+static inline bool  //
+iconvg_private_paint__culls(const iconvg_paint* self, const float* b) {
+  return (((double)b[2]) < self->src_clip[0]) ||
+         (((double)b[3]) < self->src_clip[1]) ||
+         (((double)b[0]) > self->src_clip[2]) ||
+         (((double)b[1]) > self->src_clip[3]);
+}
+
+// iconvg_private_paint__is_transparent returns whether self's (valid)
+// paint_rgba, with CREG as its gradient stops, is a flat color with zero alpha
+// or a gradient whose stops all have zero alpha. Drawing with it changes no
+// pixels.
+bool  //
+iconvg_private_paint__is_transparent(const iconvg_paint* self);
+
+// iconvg_private_canvas__make_transform returns a canvas that applies m to
+// every point, and to the dst_rect passed to begin_decode, before forwarding
+// each call to wrapped. iconvg_decode and similar functions wrap their canvas
+// in one when the options have a transform.
+iconvg_canvas  //
+iconvg_private_canvas__make_transform(iconvg_canvas* wrapped,
+                                      const iconvg_matrix_2x3_f64* m);
+
+// iconvg_private_matrix_2x3_f64__transform_bounds returns the bounding box of
+// r's m-transformed corners: the dst_rect that a transform canvas passes on to
+// the canvas that it wraps.
+iconvg_rectangle_f32  //
+iconvg_private_matrix_2x3_f64__transform_bounds(const iconvg_matrix_2x3_f64* m,
+                                                iconvg_rectangle_f32 r);
+
+// iconvg_private_cairo_canvas__push_transform, if c is a Cairo canvas (not
+// wrapped by another one), saves its cairo_t's state and then pre-multiplies
+// the cairo_t's current transformation matrix by m, returning true. Decoding
+// to c without an iconvg_decode_options transform is then equivalent to
+// decoding with one, but Cairo transforms the points instead of IconVG. The
+// caller should then call iconvg_private_cairo_canvas__pop_transform.
+//
+// It returns false, doing nothing, for any other canvas, for a non-invertible
+// m or if the Cairo backend is not enabled.
+bool  //
+iconvg_private_cairo_canvas__push_transform(iconvg_canvas* c,
+                                            const iconvg_matrix_2x3_f64* m);
+
+// iconvg_private_cairo_canvas__pop_transform undoes a successful
+// iconvg_private_cairo_canvas__push_transform.
+void  //
+iconvg_private_cairo_canvas__pop_transform(iconvg_canvas* c);
+
+// iconvg_private_paint__initialize sets self's fields, other than the viewbox
+// and custom_palette (which the caller should already have set to the
+// suggested palette), to their initial values for decoding to dst_rect.
+void  //
+iconvg_private_paint__initialize(iconvg_paint* self,
+                                 iconvg_rectangle_f32 dst_rect,
+                                 const iconvg_decode_options* options);
+
+// ----
+
+// iconvg_private_decode_compiled_header validates the header of a compiled
+// form (as produced by iconvg_compile) and sets *dst_suggested_palette and
+// *dst_palette_mask from it. Either pointer may be NULL.
+const char*  //
+iconvg_private_decode_compiled_header(iconvg_palette* dst_suggested_palette,
+                                      uint64_t* dst_palette_mask,
+                                      const uint8_t* compiled_ptr,
+                                      size_t compiled_len);
+
+// ----
+
+// iconvg_private_coverage_compositor is the state for
+// iconvg_coverage_masks__composite: the masks, the read offset of the next
+// drawing's record and the destination pixel buffer.
+typedef struct iconvg_private_coverage_compositor_struct {
+  const iconvg_coverage_masks* masks;
+  size_t offset;
+  uint8_t* pixels_ptr;
+  size_t pixels_stride;
+  int32_t kernels;
+  uint8_t gradient_lut[256 * 4];
+} iconvg_private_coverage_compositor;
+
+// iconvg_private_coverage_compositor__initialize sets up self to read masks
+// (which it validates) from the start.
+const char*  //
+iconvg_private_coverage_compositor__initialize(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_coverage_masks* masks,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect);
+
+// iconvg_private_coverage_compositor__composite composites the next drawing's
+// mask, with the paint p, onto the pixel buffer. If p is NULL then the mask is
+// skipped over instead, for a drawing that replay culled.
+const char*  //
+iconvg_private_coverage_compositor__composite(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_paint* p);
+
+// iconvg_private_coverage_compositor__finish checks that every mask was used.
+const char*  //
+iconvg_private_coverage_compositor__finish(
+    const iconvg_private_coverage_compositor* self);
+
 // ----
 
+// iconvg_private_gradient_key holds everything that determines a backend
+// gradient object, in pattern space. It excludes the gradient transformation
+// matrix, which depends on the dst_rect (and transform), so that one object
+// serves every size and position. Backends apply the matrix per drawing.
+//
+// Keys are zero-initialized (including any padding and unused stops) by
+// iconvg_private_gradient_key__initialize so that they can be compared with
+// memcmp.
+typedef struct iconvg_private_gradient_key_struct {
+  uint32_t paint_type;
+  uint32_t spread;
+  uint32_t num_stops;
+  float offsets[64];
+  iconvg_premul_color colors[64];
+} iconvg_private_gradient_key;
+
+// iconvg_private_gradient_key__initialize sets self from a gradient paint p.
+void  //
+iconvg_private_gradient_key__initialize(iconvg_private_gradient_key* self,
+                                        const iconvg_paint* p);
+
+// iconvg_private_gradient_cache_release_func releases a backend object, e.g.
+// by calling cairo_pattern_destroy or sk_shader_unref. Each backend has its
+// own function, which also distinguishes the backends' cache entries.
+typedef void (*iconvg_private_gradient_cache_release_func)(void* obj);
+
+// iconvg_private_gradient_cache__lookup returns the backend object (borrowed,
+// not an additional reference) for key and release_func, or NULL if absent.
+void*  //
+iconvg_private_gradient_cache__lookup(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func);
+
+// iconvg_private_gradient_cache__insert adds obj, taking over one of the
+// caller's references to it, and returns true. It returns false, leaving the
+// reference with the caller, if obj would not fit even in an empty cache.
+bool  //
+iconvg_private_gradient_cache__insert(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func,
+    void* obj,
+    size_t backend_bytes);
+
+// ----
+
+// ICONVG_PRIVATE_ARC_MAX_CUBICS is the maximum number of cubic Bézier
+// segments that an elliptical arc is approximated by: one per quarter turn.
+#define ICONVG_PRIVATE_ARC_MAX_CUBICS 4
+
+// iconvg_private_arc_to_cubics approximates an elliptical arc by cubic Bézier
+// segments, in the same coordinate space as its arguments. It writes 6
+// elements (x1, y1, x2, y2, x3, y3) per segment to dst, which must have room
+// for (6 * ICONVG_PRIVATE_ARC_MAX_CUBICS) elements, and returns the number of
+// segments. That number can be zero, e.g. when the arc's two end points
+// coincide, in which case nothing should be drawn. If the arc has a zero
+// radius, it also returns zero but sets *dst_is_line, meaning that the arc
+// should be drawn as a straight line to the final point.
+size_t  //
+iconvg_private_arc_to_cubics(double* dst,
+                             bool* dst_is_line,
+                             float initial_x,
+                             float initial_y,
+                             float radius_x,
+                             float radius_y,
+                             float x_axis_rotation,
+                             bool large_arc,
+                             bool sweep,
+                             float final_x,
+                             float final_y);
+
+// iconvg_private_path_arc_to converts an elliptical arc (in ViewBox space) to
+// cubic Bézier segments and adds them, in dst space, to the batch.
 const char*  //
-iconvg_private_path_arc_to(iconvg_canvas* c,
+iconvg_private_path_arc_to(iconvg_private_path_batch* batch,
+                           iconvg_canvas* c,
                            double scale_x,
                            double bias_x,
                            double scale_y,
@@ -85,8 +85,10 @@
 // instead of file format errors.
 
 extern const char iconvg_error_bad_color[];                       // ¶0.1
+extern const char iconvg_error_bad_compiled_form[];               // ¶0.2
 extern const char iconvg_error_bad_coordinate[];                  // ¶0.1
 extern const char iconvg_error_bad_drawing_opcode[];              // ¶0.1
+extern const char iconvg_error_bad_icon_pack[];                   // ¶0.2
 extern const char iconvg_error_bad_magic_identifier[];            // ¶0.1
 extern const char iconvg_error_bad_metadata[];                    // ¶0.1
 extern const char iconvg_error_bad_metadata_id_order[];           // ¶0.1
@@ -96,13 +98,23 @@ extern const char iconvg_error_bad_number[];                      // ¶0.1
 extern const char iconvg_error_bad_path_unfinished[];             // ¶0.1
 extern const char iconvg_error_bad_styling_opcode[];              // ¶0.1
 
-extern const char iconvg_error_system_failure_out_of_memory[];  // ¶0.1
+extern const char iconvg_error_system_failure_atlas_too_small[];      // ¶0.2
+extern const char iconvg_error_system_failure_dst_buffer_too_short[];  // ¶0.2
+extern const char iconvg_error_system_failure_out_of_memory[];         // ¶0.1
 
 extern const char iconvg_error_invalid_backend_not_enabled[];   // ¶0.1
 extern const char iconvg_error_invalid_constructor_argument[];  // ¶0.1
+extern const char iconvg_error_invalid_coverage_masks[];        // ¶0.2
 extern const char iconvg_error_invalid_paint_type[];            // ¶0.1
+extern const char iconvg_error_invalid_path_verb[];             // ¶0.2
 extern const char iconvg_error_unsupported_vtable[];            // ¶0.1
 
+// iconvg_note_etc constants are non-NULL but are not errors. They are status
+// messages, such as iconvg_stream_decoder__write asking for more source bytes.
+
+extern const char iconvg_note_cancelled[];        // ¶0.2
+extern const char iconvg_note_need_more_input[];  // ¶0.2
+
 // ----
 
 // iconvg_rectangle_f32 is an axis-aligned rectangle with float32 coordinates.
@@ -286,6 +298,52 @@ typedef struct iconvg_decode_options_struct {
   iconvg_palette* palette;
 
   // The fields above are ¶0.1
+
+  // transform, if non-NULL, maps dst coordinates (as placed by the dst_rect
+  // argument to iconvg_decode) to the canvas' coordinates, e.g. to rotate the
+  // graphic about dst_rect's center. It applies to every path point and to
+  // gradients. The canvas' begin_decode sees (and so, for clipping canvases,
+  // clips to) the bounding box of the transformed dst_rect.
+  //
+  // The transform should be invertible. If NULL, it is the identity. The
+  // matrix must remain valid while decoding.
+  const iconvg_matrix_2x3_f64* transform;
+
+  // clip_rect, if non-NULL, is a rectangle in dst coordinates (the same space
+  // as the dst_rect argument to iconvg_decode, before any transform) outside
+  // of which the caller does not need any output, e.g. one tile of a larger
+  // rendering. Drawings whose control points' bounding box lies entirely
+  // outside of clip_rect are not emitted to the canvas at all. Other drawings
+  // are emitted in full: clip_rect only culls, and the canvas should still do
+  // its own clipping.
+  //
+  // The bounds are of the drawing's path's points, including curves' off-path
+  // control points, so they are conservative but cheap to compute. The
+  // compiled form (see iconvg_compile) stores them, so replaying it computes
+  // nothing. An iconvg_stream_decoder only culls drawings whose bytes have all
+  // been written by the time they begin. The rectangle must remain valid
+  // while decoding.
+  //
+  // Canvases clip to dst_rect, so when clip_rect is non-NULL and there is no
+  // transform, drawings outside of dst_rect are culled too. With a NULL
+  // clip_rect, nothing is culled by its bounds, whether decoding or replaying
+  // a compiled form, so that both make the same canvas calls. Setting
+  // clip_rect to point to the dst_rect therefore culls everything offscreen.
+  const iconvg_rectangle_f32* clip_rect;
+
+  // cancel, if non-NULL, is called (with cancel_context as its argument)
+  // before each drawing. If it returns true then decoding stops early with
+  // iconvg_note_cancelled. The canvas still sees end_decode (with that note)
+  // and whatever it drew so far. This lets a background thread abandon a
+  // stale render, e.g. when a viewer moves on to the next file, without
+  // finishing the whole graphic.
+  //
+  // It is called on the decoding thread, about once per drawing, so it should
+  // be cheap, e.g. comparing a mutex-guarded generation counter.
+  bool (*cancel)(void* cancel_context);
+  void* cancel_context;
+
+  // The fields above are ¶0.2
 } iconvg_decode_options;  // ¶0.1
 
 // ----
@@ -301,6 +359,14 @@ typedef struct iconvg_decode_options_struct {
 // iconvg_canvas_vtable types. Only that iconvg_canvas__make_etc creates a
 // canvas and the iconvg_canvas__etc methods take a canvas as an argument.
 
+// iconvg_path_verb is the type of one segment in a path_segments call. Each
+// verb's numerical value is also the number of (x, y) points it consumes.
+typedef enum iconvg_path_verb_enum {
+  ICONVG_PATH_VERB__LINE_TO = 1,  // ¶0.2
+  ICONVG_PATH_VERB__QUAD_TO = 2,  // ¶0.2
+  ICONVG_PATH_VERB__CUBE_TO = 3,  // ¶0.2
+} iconvg_path_verb;               // ¶0.2
+
 struct iconvg_canvas_struct;
 
 typedef struct iconvg_canvas_vtable_struct {
@@ -338,6 +404,28 @@ typedef struct iconvg_canvas_vtable_struct {
       const iconvg_palette* suggested_palette);
 
   // The fields above are ¶0.1
+
+  // path_segments may be NULL. If non-NULL, it is equivalent to calling
+  // path_line_to, path_quad_to or path_cube_to once per element of verbs (an
+  // array of num_verbs iconvg_path_verb values), in order. The points array
+  // holds those calls' float arguments, concatenated.
+  //
+  // Decoders call it, when available, for runs of consecutive segments,
+  // instead of making one call per segment.
+  const char* (*path_segments)(struct iconvg_canvas_struct* c,
+                               const uint8_t* verbs,
+                               size_t num_verbs,
+                               const float* points);
+
+  // on_skipped_drawing may be NULL. If non-NULL, decoders call it in place of
+  // a whole begin_drawing .. end_drawing sequence for each drawing that they
+  // cull because it would not change any pixels: its paint is transparent
+  // (regardless of the palette) or its bounds lie outside of dst_rect or the
+  // iconvg_decode_options' clip_rect. Drawings outside the Level of Detail
+  // bounds are not part of the graphic at that height and are not reported.
+  const char* (*on_skipped_drawing)(struct iconvg_canvas_struct* c);
+
+  // The fields above are ¶0.2
 } iconvg_canvas_vtable;  // ¶0.1
 
 typedef struct iconvg_canvas_struct {
@@ -365,6 +453,479 @@ typedef struct iconvg_canvas_struct {
 
 // ----
 
+// iconvg_decode_job is one element of the jobs array passed to
+// iconvg_decode_batch. The first five fields are the arguments to an
+// iconvg_decode call and the last field is set to that call's result.
+typedef struct iconvg_decode_job_struct {
+  iconvg_canvas* dst_canvas;
+  iconvg_rectangle_f32 dst_rect;
+  const uint8_t* src_ptr;
+  size_t src_len;
+  const iconvg_decode_options* options;
+
+  const char* err_msg;
+} iconvg_decode_job;  // ¶0.2
+
+// ----
+
+// iconvg_gradient_cache is an opt-in, bounded, least recently used cache of
+// backend gradient objects (Cairo patterns or Skia shaders). Re-rendering the
+// same gradients, e.g. the same icon at many sizes, can then re-use those
+// objects instead of rebuilding their gradient stops on every drawing.
+//
+// Entries are keyed on the paint type, spread and stop colors and offsets.
+// The gradient transformation matrix, which depends on the dst_rect, is not
+// part of the key: the backend applies it to the cached object per drawing.
+// The cache does not depend on the IconVG source bytes or palette per se,
+// only on the resolved paint.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_gradient_cache__initialize. The cache holds references to
+// backend objects, so call iconvg_gradient_cache__invalidate before releasing
+// the entries memory or the backend's own state (e.g. a Skia GPU context).
+//
+// A cache is not safe for concurrent use, including by canvases in different
+// iconvg_decode_batch jobs.
+typedef struct iconvg_gradient_cache_struct {
+  struct {
+    void* entries_ptr;
+    size_t entries_cap;
+    size_t max_backend_bytes;
+    size_t total_backend_bytes;
+    uint64_t clock;
+  } private_impl;
+} iconvg_gradient_cache;  // ¶0.2
+
+// ----
+
+// iconvg_arena is a bump allocator over caller-provided memory. Allocations
+// are carved, in order, from the front of that memory and are all released
+// at once by iconvg_arena__reset. A server can then give each worker thread
+// one arena, reset per render, for the library's working memory (rasterizer
+// scratch, compiled forms, stream decoder workbufs and the Skia canvas'
+// per-decode state) with no malloc calls or lock contention.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_arena__initialize.
+//
+// An arena is not safe for concurrent use.
+typedef struct iconvg_arena_struct {
+  struct {
+    uint8_t* ptr;
+    size_t len;
+    size_t used;
+    size_t high_water_mark;
+  } private_impl;
+} iconvg_arena;  // ¶0.2
+
+// ----
+
+// iconvg_bitmap_cache_key identifies one rendering of an IconVG graphic: a
+// hash of its source bytes, the pixel dimensions and dst_rect, and the
+// effective height_in_pixels, palette, transform and clip_rect (as per
+// iconvg_decode_options). When the options' palette is NULL, the effective
+// palette is the source's suggested palette, which the source hash already
+// covers.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_bitmap_cache_key__make.
+typedef struct iconvg_bitmap_cache_key_struct {
+  struct {
+    uint64_t src_hash;
+    uint64_t src_len;
+    uint64_t palette_hash;
+    uint64_t transform_hash;
+    uint64_t clip_rect_hash;
+    int64_t height_in_pixels;
+    float dst_rect[4];
+    uint32_t pixels_width;
+    uint32_t pixels_height;
+    uint32_t has_palette;
+    uint32_t from_compiled;
+  } private_impl;
+} iconvg_bitmap_cache_key;  // ¶0.2
+
+// iconvg_bitmap_cache is an opt-in, bounded, least recently used cache of
+// rendered pixel buffers. Serving the same icon at the same handful of sizes
+// and palettes can then copy out previously rendered pixels, skipping both
+// decoding and rasterization.
+//
+// The cache stores 4 bytes per pixel, as given to iconvg_bitmap_cache__insert
+// (e.g. alpha-premultiplied BGRA from Cairo's CAIRO_FORMAT_ARGB32 or RGBA from
+// iconvg_canvas__make_rasterizer). It does not interpret them, so callers
+// should not mix pixel formats within one cache.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_bitmap_cache__initialize.
+//
+// If the library was built with the ICONVG_CONFIG__ENABLE_PTHREADS macro
+// defined then a cache is safe for concurrent use, e.g. by different
+// iconvg_decode_batch jobs' callers. Otherwise, it is not.
+typedef struct iconvg_bitmap_cache_struct {
+  struct {
+    void* workbuf_ptr;
+  } private_impl;
+} iconvg_bitmap_cache;  // ¶0.2
+
+// ----
+
+// iconvg_coverage_masks records, per drawing, the 8-bit coverage (alpha mask)
+// that a rasterizer canvas computed for that drawing's geometry. Re-coloring
+// an icon (a different palette) can then composite each mask with its new
+// paint, via iconvg_coverage_masks__composite, without re-rasterizing paths.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_coverage_masks__initialize.
+typedef struct iconvg_coverage_masks_struct {
+  struct {
+    uint8_t* buf_ptr;
+    size_t buf_len;
+    size_t buf_used;
+    size_t num_masks;
+    float dst_rect[4];
+    uint32_t pixels_width;
+    uint32_t pixels_height;
+    bool overflowed;
+  } private_impl;
+} iconvg_coverage_masks;  // ¶0.2
+
+// ----
+
+// iconvg_player_frame is one frame of an animation played by an
+// iconvg_player. Set it up with iconvg_player_frame__make and then change
+// whichever fields animate:
+//  - transform is applied (in dst space) after mapping the graphic's ViewBox
+//    to the dst_rect, like the iconvg_decode_options field of the same name.
+//    It should be invertible.
+//  - palette, if non-NULL, replaces the player's palette for this frame.
+//  - alpha, from 0 to 1, scales every (alpha-premultiplied) palette color, to
+//    fade or pulse the graphic's tint. Colors that the graphic does not take
+//    from the palette are unaffected.
+typedef struct iconvg_player_frame_struct {
+  iconvg_matrix_2x3_f64 transform;
+  const iconvg_palette* palette;
+  float alpha;
+} iconvg_player_frame;  // ¶0.2
+
+// iconvg_player renders the frames of an animation (e.g. a pulsing tint or a
+// scale-in transition) of one compiled graphic (see iconvg_compile). Each
+// frame replays the compiled form's pre-decoded paths, without re-parsing
+// IconVG bytecode. When rendering to a pixel buffer with coverage masks, a
+// frame that only changes color also skips rasterizing those paths.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_player__initialize. A player is not safe for concurrent use.
+typedef struct iconvg_player_struct {
+  struct {
+    const uint8_t* compiled_ptr;
+    size_t compiled_len;
+    uint64_t palette_mask;
+    iconvg_palette palette;
+    iconvg_coverage_masks* masks;
+    bool masks_are_valid;
+    uint32_t masks_pixels_width;
+    uint32_t masks_pixels_height;
+    iconvg_rectangle_f32 masks_dst_rect;
+    iconvg_matrix_2x3_f64 masks_transform;
+  } private_impl;
+} iconvg_player;  // ¶0.2
+
+// ----
+
+// iconvg_stream_decoder is like iconvg_decode but takes its source bytes
+// incrementally, in chunks of any size, e.g. as they arrive over the network.
+// Paths are emitted to the canvas as soon as all of their ops' bytes have been
+// written, without buffering the whole source.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_stream_decoder__initialize.
+typedef struct iconvg_stream_decoder_struct {
+  struct {
+    void* workbuf_ptr;
+  } private_impl;
+} iconvg_stream_decoder;  // ¶0.2
+
+// ----
+
+// ICONVG_PROBE_MAX_LOD_RANGES is the maximum number of distinct Level of
+// Detail ranges that an iconvg_probe_results records.
+#define ICONVG_PROBE_MAX_LOD_RANGES 8
+
+// iconvg_probe_results is what iconvg_probe finds out about an IconVG graphic
+// without rendering it, e.g. for a layout engine or render scheduler.
+typedef struct iconvg_probe_results_struct {
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+
+  // bytecode_offset is the length of the magic identifier and metadata
+  // chunks: the offset in the source bytes where the bytecode starts.
+  size_t bytecode_offset;
+
+  // The fields below are only set when iconvg_probe scans the bytecode.
+  // Otherwise, they are zero.
+
+  // num_drawings counts every drawing, whatever its Level of Detail range.
+  uint32_t num_drawings;
+
+  // num_gradient_drawings counts the drawings whose paint is a gradient.
+  // Paints that depend on the custom palette are always flat colors.
+  uint32_t num_gradient_drawings;
+
+  // num_path_segments counts line, quadratic and cubic segments. An arc
+  // counts as the (up to 4) cubic segments that it is drawn as.
+  uint64_t num_path_segments;
+
+  // lod_ranges[.. num_lod_ranges] are the distinct Level of Detail ranges
+  // that the drawings are in, in order of first use, each with its share of
+  // num_drawings and num_path_segments. The default range is 0 ..
+  // +infinity. If there are more than ICONVG_PROBE_MAX_LOD_RANGES ranges then
+  // lod_ranges_overflowed is set and the excess drawings are only counted in
+  // the totals above.
+  struct {
+    float lod0;
+    float lod1;
+    uint32_t num_drawings;
+    uint64_t num_path_segments;
+  } lod_ranges[ICONVG_PROBE_MAX_LOD_RANGES];
+  uint32_t num_lod_ranges;
+  bool lod_ranges_overflowed;
+} iconvg_probe_results;  // ¶0.2
+
+// ----
+
+// iconvg_icon_pack is a read-only view of an icon pack: many named IconVG
+// graphics (and optionally their compiled forms) in a single file, typically
+// memory-mapped. Looking up a name gives pointers into the pack's bytes, which
+// can be passed straight to iconvg_decode (or iconvg_decode_compiled), with no
+// per-icon file open or copy.
+//
+// Its fields should be considered private implementation details. Set them
+// up with iconvg_icon_pack__initialize. A pack is safe for concurrent use, as
+// its methods do not modify it.
+typedef struct iconvg_icon_pack_struct {
+  struct {
+    const uint8_t* ptr;
+    size_t len;
+    const uint8_t* entries;
+    uint32_t num_entries;
+    uint32_t num_slots;
+  } private_impl;
+} iconvg_icon_pack;  // ¶0.2
+
+// iconvg_icon_pack_entry is one named graphic in an iconvg_icon_pack. Its
+// pointers point into the pack's bytes. compiled_ptr is NULL (and compiled_len
+// is zero) if the pack has no compiled form for the graphic.
+typedef struct iconvg_icon_pack_entry_struct {
+  const uint8_t* name_ptr;
+  size_t name_len;
+  const uint8_t* src_ptr;
+  size_t src_len;
+  const uint8_t* compiled_ptr;
+  size_t compiled_len;
+} iconvg_icon_pack_entry;  // ¶0.2
+
+// ----
+
+// ICONVG_ATLAS_MAX_NUM_ENTRIES is the maximum num_entries argument to
+// iconvg_atlas_pack.
+#define ICONVG_ATLAS_MAX_NUM_ENTRIES 0x3FFFFFFF
+
+// iconvg_atlas_entry is one sub-rectangle of a texture atlas (or sprite
+// sheet): many graphics, typically many icons at several sizes, rendered into
+// one shared surface. The caller sets width and height (e.g. with
+// iconvg_atlas_entry__make) and iconvg_atlas_pack sets x and y, the top-left
+// corner. All four are in pixels.
+//
+// An entry with a zero width or height is not packed and gets a zero x and y.
+typedef struct iconvg_atlas_entry_struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t x;
+  uint32_t y;
+} iconvg_atlas_entry;  // ¶0.2
+
+// ----
+
+// iconvg_canvas_method is one of the iconvg_canvas_vtable methods, numbered
+// in vtable order. It indexes iconvg_canvas_stats' method_ticks.
+typedef enum iconvg_canvas_method_enum {
+  ICONVG_CANVAS_METHOD__BEGIN_DECODE = 0,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__END_DECODE = 1,                      // ¶0.2
+  ICONVG_CANVAS_METHOD__BEGIN_DRAWING = 2,                   // ¶0.2
+  ICONVG_CANVAS_METHOD__END_DRAWING = 3,                     // ¶0.2
+  ICONVG_CANVAS_METHOD__BEGIN_PATH = 4,                      // ¶0.2
+  ICONVG_CANVAS_METHOD__END_PATH = 5,                        // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_LINE_TO = 6,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_QUAD_TO = 7,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_CUBE_TO = 8,                    // ¶0.2
+  ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX = 9,             // ¶0.2
+  ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE = 10,  // ¶0.2
+  ICONVG_CANVAS_METHOD__PATH_SEGMENTS = 11,                  // ¶0.2
+  ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING = 12,             // ¶0.2
+} iconvg_canvas_method;                                      // ¶0.2
+
+// ICONVG_CANVAS_NUM_METHODS is the number of iconvg_canvas_method values.
+#define ICONVG_CANVAS_NUM_METHODS 13
+
+// iconvg_canvas_stats holds what a stats canvas (see
+// iconvg_canvas__make_stats) counts and times. The caller sets the clock
+// fields and sample_interval and zeroes the rest. The canvas only ever adds to
+// the counters, so they accumulate over multiple decodes until the caller
+// re-zeroes them.
+typedef struct iconvg_canvas_stats_struct {
+  // clock_func, if non-NULL, returns a monotonically increasing timestamp in
+  // any unit (e.g. nanoseconds from clock_gettime or cycles from a time stamp
+  // counter). It is passed clock_context. If clock_func is NULL then the
+  // ticks fields below stay zero and only the counters are updated.
+  uint64_t (*clock_func)(void* clock_context);
+  void* clock_context;
+
+  // sample_interval, if greater than 1, means that only 1 in every
+  // sample_interval calls of each method is timed, reading the clock twice,
+  // and that call's ticks count sample_interval times. This cuts the
+  // overhead, for cheap and frequent methods like path_line_to, at the cost
+  // of estimating method_ticks and backend_ticks instead of measuring them.
+  // Zero or 1 means that every call is timed.
+  uint32_t sample_interval;
+
+  uint64_t num_decodes;
+  uint64_t num_decode_errors;
+  uint64_t num_drawings;
+  // num_skipped_drawings counts on_skipped_drawing calls: drawings that the
+  // decoder culled instead of emitting.
+  uint64_t num_skipped_drawings;
+  uint64_t num_paths;
+  // num_path_segments_calls counts path_segments calls, each of which carries
+  // a batch of one or more segments.
+  uint64_t num_path_segments_calls;
+  // num_segments and num_paints are indexed by iconvg_path_verb and
+  // iconvg_paint_type. Segments are counted the same way whether they arrive
+  // one per call or batched in path_segments.
+  uint64_t num_segments[4];
+  uint64_t num_paints[4];
+
+  // decode_ticks is the total time spent between begin_decode and end_decode,
+  // inclusive. backend_ticks is how much of that was spent inside the wrapped
+  // canvas' methods. The difference is the decoder's (and this canvas' own)
+  // share. method_ticks, indexed by iconvg_canvas_method, breaks
+  // backend_ticks down per method. decode_ticks is always measured, but the
+  // others are estimates if sample_interval is greater than 1.
+  uint64_t decode_ticks;
+  uint64_t backend_ticks;
+  uint64_t method_ticks[ICONVG_CANVAS_NUM_METHODS];
+
+  struct {
+    // countdown, indexed by iconvg_canvas_method, is how many calls of that
+    // method to skip before timing the next one.
+    uint32_t countdown[ICONVG_CANVAS_NUM_METHODS];
+  } private_impl;
+} iconvg_canvas_stats;  // ¶0.2
+
+// ----
+
+typedef enum iconvg_tessellation_mode_enum {
+  ICONVG_TESSELLATION_MODE__STENCIL_FANS = 0,  // ¶0.2
+  ICONVG_TESSELLATION_MODE__CURVES = 1,        // ¶0.2
+} iconvg_tessellation_mode;                    // ¶0.2
+
+// iconvg_tessellation_vertex is a point, in dst coordinate space, and its
+// curve coordinates. A fragment shader should discard fragments whose
+// interpolated ((u * u) - v) is positive. u and v are 0 and 1 for the
+// vertices of triangles that are not curve triangles, so that no fragments
+// are discarded.
+typedef struct iconvg_tessellation_vertex_struct {
+  float x;
+  float y;
+  float u;
+  float v;
+} iconvg_tessellation_vertex;  // ¶0.2
+
+// iconvg_tessellation_stop is a gradient stop.
+typedef struct iconvg_tessellation_stop_struct {
+  float offset;
+  iconvg_premul_color color;
+} iconvg_tessellation_stop;  // ¶0.2
+
+// iconvg_tessellation_draw is one drawing (one GPU draw call): the triangles
+// at indices[first_index .. first_index + num_indices] and a paint record.
+//
+// To fill it, first draw the triangles into the stencil buffer (and not the
+// color buffer), incrementing for front faces and decrementing for back faces
+// (both wrapping), then draw a quad over cover_rect, where the stencil is
+// non-zero, with the paint, clearing the stencil.
+//
+// For a flat color, only flat_color is meaningful. For a gradient,
+// gradient_matrix transforms from dst coordinate space to pattern coordinate
+// space (see iconvg_paint__gradient_transformation_matrix), and the stops are
+// at stops[first_stop .. first_stop + num_stops].
+typedef struct iconvg_tessellation_draw_struct {
+  uint32_t first_index;
+  uint32_t num_indices;
+  iconvg_rectangle_f32 cover_rect;
+  iconvg_paint_type paint_type;
+  iconvg_gradient_spread gradient_spread;
+  iconvg_premul_color flat_color;
+  iconvg_matrix_2x3_f64 gradient_matrix;
+  uint32_t first_stop;
+  uint32_t num_stops;
+} iconvg_tessellation_draw;  // ¶0.2
+
+// iconvg_tessellation holds the output of a tessellator canvas (see
+// iconvg_canvas__make_tessellator): vertex and index buffers of triangles, for
+// a GPU to fill (with stencil-and-cover), plus the draw calls and their
+// paints. The caller sets the etc_ptr and etc_len buffer fields, as this
+// library never allocates memory itself, and the mode and tolerance fields.
+//
+// In ICONVG_TESSELLATION_MODE__STENCIL_FANS mode, each drawing is a fan of
+// triangles, with quadratic and cubic Bézier curves flattened to line
+// segments. In ICONVG_TESSELLATION_MODE__CURVES mode, each quadratic curve
+// is instead a fan triangle plus one curve triangle (Loop-Blinn style) that
+// the fragment shader trims to the curve, so that curves stay smooth at any
+// scale. Cubic curves are first approximated by quadratic curves.
+//
+// tolerance is the maximum distance, in dst coordinate space (e.g. pixels),
+// of flattened lines (or approximating quadratic curves) to the true curve.
+// Non-positive or NaN values mean a default of 0.1.
+//
+// The canvas resets and sets the num_etc fields at the start of and during
+// each decode. They count what the decode produced, even if it did not fit.
+// If any num_etc field ends up greater than its etc_len field then only a
+// prefix was written and the decode should be retried with longer buffers
+// (see iconvg_tessellation__is_complete).
+typedef struct iconvg_tessellation_struct {
+  iconvg_tessellation_vertex* vertices_ptr;
+  size_t vertices_len;
+  uint32_t* indices_ptr;
+  size_t indices_len;
+  iconvg_tessellation_draw* draws_ptr;
+  size_t draws_len;
+  iconvg_tessellation_stop* stops_ptr;
+  size_t stops_len;
+
+  iconvg_tessellation_mode mode;
+  float tolerance;
+
+  size_t num_vertices;
+  size_t num_indices;
+  size_t num_draws;
+  size_t num_stops;
+
+  struct {
+    iconvg_rectangle_f32 dst_rect;
+    float tolerance;
+    float bounds[4];
+    float prev_x;
+    float prev_y;
+    uint32_t anchor_vertex;
+    uint32_t contour_start_vertex;
+    uint32_t prev_vertex;
+    uint32_t first_index;
+    bool has_anchor;
+  } private_impl;
+} iconvg_tessellation;  // ¶0.2
+
+// ----
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -410,6 +971,24 @@ iconvg_canvas__make_debug(  // ¶0.1
     const char* message_prefix,
     iconvg_canvas* wrapped);
 
+// iconvg_canvas__make_stats returns an iconvg_canvas that updates stats'
+// counters (and, if stats has a clock_func, its timings) before forwarding
+// each vtable call on to the wrapped iconvg_canvas. Unlike a debug canvas, it
+// does no formatting or I/O, so it is cheap enough for profiling hot paths.
+//
+// wrapped may be NULL, with the same meaning as for iconvg_canvas__make_debug.
+//
+// If stats is NULL then the returned value will be broken (with
+// iconvg_error_invalid_constructor_argument).
+//
+// The caller of this function is responsible for ensuring that the pointers
+// remain valid while the returned iconvg_canvas is in use. A stats canvas is
+// not safe for concurrent use, even by separate iconvg_decode calls.
+iconvg_canvas               //
+iconvg_canvas__make_stats(  // ¶0.2
+    iconvg_canvas_stats* stats,
+    iconvg_canvas* wrapped);
+
 // iconvg_canvas__does_nothing returns whether self is NULL or *self is
 // zero-valued or broken. Other canvas values are presumed to do something.
 // Zero-valued means the result of "iconvg_canvas c = {0}". Broken means the
@@ -445,6 +1024,17 @@ iconvg_canvas               //
 iconvg_canvas__make_cairo(  // ¶0.1
     cairo_t* cr);
 
+// iconvg_canvas__make_cairo_with_gradient_cache is like
+// iconvg_canvas__make_cairo but looks up and stores gradient patterns in gc,
+// which may be NULL (equivalent to iconvg_canvas__make_cairo).
+//
+// The caller is responsible for ensuring that gc remains valid while the
+// returned iconvg_canvas is in use.
+iconvg_canvas                                   //
+iconvg_canvas__make_cairo_with_gradient_cache(  // ¶0.2
+    cairo_t* cr,
+    iconvg_gradient_cache* gc);
+
 // ----
 
 typedef struct sk_canvas_t sk_canvas_t;
@@ -462,6 +1052,311 @@ iconvg_canvas              //
 iconvg_canvas__make_skia(  // ¶0.1
     sk_canvas_t* sc);
 
+// iconvg_canvas__make_skia_with_gradient_cache is like
+// iconvg_canvas__make_skia but looks up and stores gradient shaders in gc,
+// which may be NULL (equivalent to iconvg_canvas__make_skia).
+//
+// The caller is responsible for ensuring that gc remains valid while the
+// returned iconvg_canvas is in use.
+iconvg_canvas                                  //
+iconvg_canvas__make_skia_with_gradient_cache(  // ¶0.2
+    sk_canvas_t* sc,
+    iconvg_gradient_cache* gc);
+
+// iconvg_canvas__make_skia_with_arena is like
+// iconvg_canvas__make_skia_with_gradient_cache but carves its per-decode state
+// from arena instead of calling malloc. gc and arena may each be NULL. If the
+// arena is too full then decoding fails with
+// iconvg_error_system_failure_out_of_memory.
+//
+// Skia's own objects (its path builder, paint, paths and shaders) are still
+// allocated by Skia. A gradient cache avoids re-creating shaders.
+//
+// The caller is responsible for ensuring that gc and arena remain valid while
+// the returned iconvg_canvas is in use, and should only reset the arena
+// between (not during) decodes.
+iconvg_canvas                         //
+iconvg_canvas__make_skia_with_arena(  // ¶0.2
+    sk_canvas_t* sc,
+    iconvg_gradient_cache* gc,
+    iconvg_arena* arena);
+
+// ----
+
+// iconvg_arena__initialize sets up self to allocate from ptr[.. len], which
+// must be 8-byte aligned (as memory returned by malloc is). This library never
+// allocates memory itself.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or ptr is NULL
+// or if ptr is misaligned.
+const char*                //
+iconvg_arena__initialize(  // ¶0.2
+    iconvg_arena* self,
+    void* ptr,
+    size_t len);
+
+// iconvg_arena__alloc returns len bytes of self's memory, 8-byte aligned, or
+// NULL if self is NULL or does not have len bytes left. The memory is not
+// zeroed. It remains valid until the next iconvg_arena__reset or
+// iconvg_arena__initialize.
+void*                 //
+iconvg_arena__alloc(  // ¶0.2
+    iconvg_arena* self,
+    size_t len);
+
+// iconvg_arena__reset releases all of self's allocations. self may be NULL, in
+// which case this is a no-op.
+void                  //
+iconvg_arena__reset(  // ¶0.2
+    iconvg_arena* self);
+
+// iconvg_arena__high_water_mark returns the most bytes (including alignment
+// padding) that self has been asked to hold at once since it was initialized,
+// counting allocations that failed for lack of room. An arena initialized
+// with at least that many bytes would have satisfied every request.
+size_t                          //
+iconvg_arena__high_water_mark(  // ¶0.2
+    const iconvg_arena* self);
+
+// ----
+
+// iconvg_gradient_cache_entries_len returns the minimum entries_len argument
+// (a number of bytes) that iconvg_gradient_cache__initialize accepts for the
+// given number of entries. It returns zero if num_entries is zero or too
+// large.
+size_t                              //
+iconvg_gradient_cache_entries_len(  // ¶0.2
+    size_t num_entries);
+
+// iconvg_gradient_cache__initialize sets up self to hold as many entries as
+// fit in entries_ptr[.. entries_len], which must be 8-byte aligned (as memory
+// returned by malloc is). This library never allocates memory itself.
+//
+// max_backend_bytes, if non-zero, also bounds the estimated total size of the
+// cached backend objects. The least recently used entries are evicted when
+// either limit would otherwise be exceeded.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or entries_ptr
+// is NULL, if entries_ptr is misaligned or if entries_len is too short for
+// even one entry.
+const char*                         //
+iconvg_gradient_cache__initialize(  // ¶0.2
+    iconvg_gradient_cache* self,
+    void* entries_ptr,
+    size_t entries_len,
+    size_t max_backend_bytes);
+
+// iconvg_gradient_cache__invalidate releases every cached backend object,
+// leaving self empty but still usable. self may be NULL, in which case this
+// function does nothing.
+void                                //
+iconvg_gradient_cache__invalidate(  // ¶0.2
+    iconvg_gradient_cache* self);
+
+// ----
+
+// iconvg_bitmap_cache_key__make returns the key for rendering the src
+// IconVG-formatted data to a pixels_width × pixels_height buffer, like
+// iconvg_decode with the same dst_rect and options (which may be NULL). It
+// hashes, but does not validate, src.
+iconvg_bitmap_cache_key         //
+iconvg_bitmap_cache_key__make(  // ¶0.2
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// iconvg_bitmap_cache_key__make_compiled is like iconvg_bitmap_cache_key__make
+// but for rendering with iconvg_decode_compiled. Its palette component only
+// covers the palette entries that the compiled form depends on (see
+// iconvg_compiled_palette_dependencies), so that palettes which agree on those
+// entries, including the suggested palette, share one cache entry. It does
+// not validate the compiled form beyond its header.
+iconvg_bitmap_cache_key                  //
+iconvg_bitmap_cache_key__make_compiled(  // ¶0.2
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_decode_options* options);
+
+// iconvg_bitmap_cache_workbuf_len returns the minimum workbuf_len argument (a
+// number of bytes) that iconvg_bitmap_cache__initialize accepts for the given
+// number of entries and total size (in bytes) of the cached pixels. It returns
+// zero if num_entries is zero or more than 0x40000000, or if the result would
+// overflow.
+//
+// Besides the pixels, the workbuf holds a fixed-size record per entry and a
+// hash table (of at most 16 bytes per entry) that indexes them by key.
+// Lookups, inserts and evictions take O(1) expected time, not O(num_entries),
+// so num_entries can be large. They do hold the cache's mutex, though, which
+// lookups also hold while copying out the cached pixels.
+size_t                            //
+iconvg_bitmap_cache_workbuf_len(  // ¶0.2
+    size_t num_entries,
+    size_t max_pixel_bytes);
+
+// iconvg_bitmap_cache__initialize sets up self to hold up to num_entries
+// pixel buffers in workbuf_ptr[.. workbuf_len], which must be 8-byte aligned
+// (as memory returned by malloc is). This library never allocates memory
+// itself. Whatever is left of workbuf_len after the num_entries bookkeeping
+// (see iconvg_bitmap_cache_workbuf_len) is the byte budget for pixels. The
+// least recently used entries are evicted when either limit would otherwise
+// be exceeded.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or workbuf_ptr
+// is NULL, if workbuf_ptr is misaligned or if workbuf_len is too short. It
+// returns iconvg_error_system_failure_out_of_memory if it could not create a
+// mutex. Otherwise, it returns NULL and the caller should call
+// iconvg_bitmap_cache__finalize when done.
+const char*                       //
+iconvg_bitmap_cache__initialize(  // ¶0.2
+    iconvg_bitmap_cache* self,
+    void* workbuf_ptr,
+    size_t workbuf_len,
+    size_t num_entries);
+
+// iconvg_bitmap_cache__finalize releases any resources (other than the
+// workbuf memory, which the caller owns) held by self. self may be NULL, in
+// which case this function does nothing.
+void                            //
+iconvg_bitmap_cache__finalize(  // ¶0.2
+    iconvg_bitmap_cache* self);
+
+// iconvg_bitmap_cache__lookup returns whether self holds the pixels for key.
+// If so, it copies them to dst_ptr, whose consecutive rows start dst_stride
+// bytes apart, and marks the entry as most recently used.
+//
+// It returns false if self or key is NULL. dst_ptr may be NULL, in which case
+// this function merely checks for the key.
+bool                          //
+iconvg_bitmap_cache__lookup(  // ¶0.2
+    iconvg_bitmap_cache* self,
+    const iconvg_bitmap_cache_key* key,
+    uint8_t* dst_ptr,
+    size_t dst_stride);
+
+// iconvg_bitmap_cache__insert copies the pixels for key (with key's pixel
+// dimensions) from src_ptr, whose consecutive rows start src_stride bytes
+// apart, into self, evicting other entries as necessary.
+//
+// Pixel buffers larger than self's whole byte budget are not stored, but that
+// is not an error. Callers using Cairo should call cairo_surface_flush before
+// passing a surface's data.
+//
+// It returns iconvg_error_invalid_constructor_argument if self, key or src_ptr
+// is NULL or if src_stride is less than 4 times the key's pixel width.
+// Otherwise, it returns NULL.
+const char*                   //
+iconvg_bitmap_cache__insert(  // ¶0.2
+    iconvg_bitmap_cache* self,
+    const iconvg_bitmap_cache_key* key,
+    const uint8_t* src_ptr,
+    size_t src_stride);
+
+// ----
+
+// iconvg_rasterizer_scratch_len returns the minimum scratch_len argument (a
+// number of floats, not bytes) that iconvg_canvas__make_rasterizer accepts for
+// the given pixel dimensions. It returns zero if either dimension is zero or
+// larger than 0x100000.
+size_t                          //
+iconvg_rasterizer_scratch_len(  // ¶0.2
+    uint32_t pixels_width,
+    uint32_t pixels_height);
+
+// iconvg_canvas__make_rasterizer returns an iconvg_canvas that fills paths
+// directly into a pixel buffer, without using a third party graphics library.
+// It is always available, regardless of ICONVG_CONFIG__ENABLE_ETC macros.
+//
+// The pixel buffer has pixels_width × pixels_height pixels, 4 bytes each:
+// alpha-premultiplied R, G, B and A, in that order. Consecutive rows start
+// pixels_stride bytes apart. Each drawing is composited (with the SRC_OVER
+// Porter-Duff operator) onto the buffer's existing contents, so callers will
+// typically clear it to transparent black beforehand.
+//
+// scratch_ptr[.. scratch_len] is working memory, of at least
+// iconvg_rasterizer_scratch_len(pixels_width, pixels_height) floats. This
+// library never allocates memory itself. The scratch memory is initialized by
+// this function and is not safe to share between concurrently used canvases.
+//
+// If pixels_ptr or scratch_ptr is NULL, if pixels_stride is less than 4 *
+// pixels_width or if scratch_len is too short then the returned value will be
+// broken (with iconvg_error_invalid_constructor_argument).
+//
+// The caller is responsible for ensuring that both pointers remain valid while
+// the returned iconvg_canvas is in use.
+iconvg_canvas                    //
+iconvg_canvas__make_rasterizer(  // ¶0.2
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len);
+
+// iconvg_coverage_masks__initialize sets up self to record into buf_ptr[..
+// buf_len]. This library never allocates memory itself. Each drawing needs 16
+// bytes plus, for each row that the drawing touches, 8 bytes and one byte per
+// pixel from that row's first to last pixel of non-zero coverage. That is at
+// most one byte per pixel of dst_rect (clipped to the pixel buffer).
+//
+// It returns iconvg_error_invalid_constructor_argument if self or buf_ptr is
+// NULL.
+const char*                         //
+iconvg_coverage_masks__initialize(  // ¶0.2
+    iconvg_coverage_masks* self,
+    uint8_t* buf_ptr,
+    size_t buf_len);
+
+// iconvg_coverage_masks__required_len returns the number of buffer bytes that
+// the last recording needed, whether or not they fit. If they did not fit
+// then iconvg_coverage_masks__composite will fail until the masks are
+// re-recorded with a longer buffer.
+size_t                                //
+iconvg_coverage_masks__required_len(  // ¶0.2
+    const iconvg_coverage_masks* self);
+
+// iconvg_canvas__make_rasterizer_with_coverage_masks is like
+// iconvg_canvas__make_rasterizer but also records each drawing's coverage
+// into masks, which are reset at the start of each decode. The caller is
+// responsible for ensuring that masks remains valid while the returned
+// iconvg_canvas is in use.
+//
+// If masks is NULL then the returned value will be broken (with
+// iconvg_error_invalid_constructor_argument).
+iconvg_canvas                                        //
+iconvg_canvas__make_rasterizer_with_coverage_masks(  // ¶0.2
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len,
+    iconvg_coverage_masks* masks);
+
+// ----
+
+// iconvg_canvas__make_tessellator returns an iconvg_canvas that tessellates
+// paths into t's vertex, index, draw and stop buffers instead of rasterizing
+// them. It does not allocate memory. The caller is responsible for ensuring
+// that t remains valid while the returned iconvg_canvas is in use.
+//
+// If t is NULL then the returned value will be broken (with
+// iconvg_error_invalid_constructor_argument).
+iconvg_canvas                     //
+iconvg_canvas__make_tessellator(  // ¶0.2
+    iconvg_tessellation* t);
+
+// iconvg_tessellation__is_complete returns whether all of the last decode's
+// output fit in self's buffers.
+bool                               //
+iconvg_tessellation__is_complete(  // ¶0.2
+    const iconvg_tessellation* self);
+
 // ----
 
 // iconvg_decode decodes the src IconVG-formatted data, calling dst_canvas's
@@ -484,6 +1379,80 @@ iconvg_decode(  // ¶0.1
     size_t src_len,
     const iconvg_decode_options* options);
 
+// iconvg_decode_batch runs iconvg_decode once per element of jobs (an array of
+// num_jobs iconvg_decode_job values), setting each job's err_msg field to the
+// result of the corresponding iconvg_decode call.
+//
+// If the library was built with the ICONVG_CONFIG__ENABLE_PTHREADS macro
+// defined then the jobs are spread over up to num_threads threads (including
+// the calling thread), each thread repeatedly taking the next not-yet-started
+// job. Otherwise, or if num_threads <= 1, all jobs run on the calling thread.
+// Either way, all jobs are complete when this function returns.
+//
+// The jobs may run concurrently, so no two jobs should share a dst_canvas (or
+// anything else that is not safe to use from multiple threads at once, such
+// as a cairo_t). Sharing src bytes or options is fine.
+//
+// It returns NULL if every job succeeded, or else the err_msg of the first (in
+// array order, not in time order) job that failed.
+const char*           //
+iconvg_decode_batch(  // ¶0.2
+    iconvg_decode_job* jobs,
+    size_t num_jobs,
+    uint32_t num_threads);
+
+// iconvg_stream_decoder_workbuf_len returns the minimum workbuf_len argument
+// (a number of bytes) that iconvg_stream_decoder__initialize accepts.
+size_t                              //
+iconvg_stream_decoder_workbuf_len(  // ¶0.2
+    void);
+
+// iconvg_stream_decoder__initialize sets up self to decode to dst_canvas, like
+// iconvg_decode with the same dst_canvas, dst_rect and options arguments.
+//
+// workbuf_ptr[.. workbuf_len] is working memory, of at least
+// iconvg_stream_decoder_workbuf_len() bytes and 8-byte aligned (as memory
+// returned by malloc is). This library never allocates memory itself. The
+// caller is responsible for ensuring that workbuf_ptr, dst_canvas and options
+// remain valid until iconvg_stream_decoder__close returns.
+//
+// It returns iconvg_error_invalid_constructor_argument if self or workbuf_ptr
+// is NULL or if workbuf_ptr is misaligned or too short. It returns
+// iconvg_error_unsupported_vtable if dst_canvas' vtable is unsupported. Either
+// way, no canvas methods are called and self should not be used further.
+// Otherwise, it returns NULL and the caller should call
+// iconvg_stream_decoder__close exactly once when done.
+const char*                         //
+iconvg_stream_decoder__initialize(  // ¶0.2
+    iconvg_stream_decoder* self,
+    void* workbuf_ptr,
+    size_t workbuf_len,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_decode_options* options);
+
+// iconvg_stream_decoder__write passes the next src_len source bytes to the
+// decoder, which executes every complete op so far. Any trailing partial op
+// is kept (in the workbuf) until the next write or close.
+//
+// It returns iconvg_note_need_more_input if there were no errors (IconVG data
+// has no end marker, so only close can tell that the source is complete).
+// Otherwise, it returns the same error that iconvg_decode would and any
+// subsequent writes return it too. The canvas' begin_decode method is called
+// during the first write (or close).
+const char*                    //
+iconvg_stream_decoder__write(  // ¶0.2
+    iconvg_stream_decoder* self,
+    const uint8_t* src_ptr,
+    size_t src_len);
+
+// iconvg_stream_decoder__close marks the end of the source bytes, executes any
+// remaining ops and calls the canvas' end_decode method. It returns
+// whatever end_decode returns, just like iconvg_decode does.
+const char*                    //
+iconvg_stream_decoder__close(  // ¶0.2
+    iconvg_stream_decoder* self);
+
 // iconvg_decode_viewbox sets *dst_viewbox to the ViewBox Metadata from the src
 // IconVG-formatted data.
 //
@@ -498,6 +1467,283 @@ iconvg_decode_viewbox(  // ¶0.1
     const uint8_t* src_ptr,
     size_t src_len);
 
+// iconvg_validate returns whether the src IconVG-formatted data is well
+// formed: NULL if it is, otherwise the same iconvg_error_bad_etc error that
+// iconvg_decode would return. It is a single linear pass that checks the
+// magic identifier, the metadata and that every bytecode op is valid and
+// complete, but skips over numbers without decoding their values, so it is
+// cheaper than decoding (even to a no-op canvas) or than iconvg_probe.
+//
+// It is meant for checking untrusted data once, e.g. when it is uploaded,
+// instead of finding out at render time. Even when it returns NULL,
+// iconvg_decode can still fail with iconvg_error_invalid_paint_type, as
+// whether a color register holds a valid paint can depend on the
+// iconvg_decode_options palette, or with an error from the canvas.
+const char*       //
+iconvg_validate(  // ¶0.2
+    const uint8_t* src_ptr,
+    size_t src_len);
+
+// iconvg_probe sets *dst to the src IconVG-formatted data's ViewBox,
+// suggested palette and bytecode offset, without executing the bytecode. If
+// scan_bytecode is true, it also walks the bytecode once, without making any
+// canvas calls, to count the drawings, gradients and path segments that a
+// render would involve.
+//
+// On error, the fields that were probed before the error was found (e.g. the
+// metadata, for a bytecode error) are still set.
+const char*    //
+iconvg_probe(  // ¶0.2
+    iconvg_probe_results* dst,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    bool scan_bytecode);
+
+// iconvg_compile decodes the src IconVG-formatted data once, writing a
+// compiled form to dst that iconvg_decode_compiled can replay more cheaply
+// than iconvg_decode can decode src. The compiled form holds absolute
+// ViewBox-space paths and pre-decoded registers, but does not depend on the
+// dst_rect, palette or height_in_pixels later passed to iconvg_decode_compiled.
+//
+// On success or on iconvg_error_system_failure_dst_buffer_too_short,
+// *dst_compiled_len is set to the compiled form's length in bytes. Passing a
+// NULL dst_ptr and zero dst_len therefore queries the required dst_len. On
+// other errors, *dst_compiled_len is set to zero. dst_compiled_len may be
+// NULL.
+//
+// The compiled form is not a stable file format. It should only be replayed
+// by the same library version that produced it. It has no alignment
+// requirements.
+const char*      //
+iconvg_compile(  // ¶0.2
+    uint8_t* dst_ptr,
+    size_t dst_len,
+    size_t* dst_compiled_len,
+    const uint8_t* src_ptr,
+    size_t src_len);
+
+// iconvg_decode_compiled is like iconvg_decode except that its source is the
+// compiled form produced by iconvg_compile instead of IconVG-formatted data.
+// The callbacks to dst_canvas are the same as what iconvg_decode would make.
+//
+// File format errors are reported by iconvg_compile, not by this function.
+// The exception is iconvg_error_invalid_paint_type, since whether a paint is
+// valid can depend on the options' palette.
+//
+// The num_bytes_consumed and num_bytes_remaining arguments to end_decode count
+// bytes of the compiled form.
+const char*              //
+iconvg_decode_compiled(  // ¶0.2
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_decode_options* options);
+
+// iconvg_compiled_palette_dependencies sets *dst_mask to the set of custom
+// palette entries that the compiled form's drawings depend on: bit i is set
+// if changing the i'th color of the iconvg_decode_options palette could change
+// the rendering. A zero mask means that the rendering does not depend on the
+// palette at all, so one rendering can be reused for every palette.
+//
+// The mask assumes that the palette's colors are valid premultiplied colors
+// (as required by the IconVG specification). It is also conservative: it can
+// include entries that, e.g. due to Level of Detail, make no visible
+// difference.
+//
+// dst_mask may be NULL, in which case the function merely validates the
+// compiled form's header.
+const char*                            //
+iconvg_compiled_palette_dependencies(  // ¶0.2
+    uint64_t* dst_mask,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len);
+
+// iconvg_coverage_masks__composite is like iconvg_decode_compiled to a
+// rasterizer canvas, with the same pixel buffer arguments, except that each
+// drawing's coverage comes from masks instead of from rasterizing its paths.
+// Only the paints (which can depend on the options' palette) are evaluated.
+//
+// The masks must have been recorded by iconvg_decode_compiled, with the same
+// compiled form, pixel dimensions, dst_rect and options' height_in_pixels,
+// transform and clip_rect, to a canvas made by
+// iconvg_canvas__make_rasterizer_with_coverage_masks. The options' palette
+// may differ. The result is then the same as decoding
+// directly. Mismatches that can be detected, including masks that did not
+// fit their buffer, return iconvg_error_invalid_coverage_masks.
+const char*                        //
+iconvg_coverage_masks__composite(  // ¶0.2
+    const iconvg_coverage_masks* self,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_decode_options* options);
+
+// ----
+
+// iconvg_player_frame__make returns a frame with the identity transform, a
+// NULL palette and an alpha of 1: the graphic as iconvg_decode_compiled would
+// render it.
+iconvg_player_frame         //
+iconvg_player_frame__make(  // ¶0.2
+    void);
+
+// iconvg_player__initialize sets up self to play the compiled form in
+// compiled_ptr[.. compiled_len], which must outlive self. A NULL palette means
+// the graphic's suggested palette. Otherwise, *palette is copied.
+//
+// masks, if non-NULL, must outlive self and is then owned by the player,
+// which records into and composites from it in iconvg_player__render_pixels.
+//
+// It returns iconvg_error_invalid_constructor_argument if self is NULL, or an
+// error if the compiled form's header is invalid.
+const char*                 //
+iconvg_player__initialize(  // ¶0.2
+    iconvg_player* self,
+    const uint8_t* compiled_ptr,
+    size_t compiled_len,
+    const iconvg_palette* palette,
+    iconvg_coverage_masks* masks);
+
+// iconvg_player__render draws one frame to dst_canvas. A NULL frame is
+// equivalent to iconvg_player_frame__make().
+//
+// Level of Detail uses the height of dst_rect, before the frame's transform,
+// so that a scaling animation does not switch between detail levels midway.
+//
+// For a Cairo canvas, the frame's transform is applied to the cairo_t's
+// current transformation matrix (and restored afterwards), so that Cairo
+// transforms the points. Other canvases get already transformed points. Cairo
+// also clips to the transformed dst_rect itself, instead of to its bounding
+// box, which only differs for rotations and skews.
+const char*             //
+iconvg_player__render(  // ¶0.2
+    iconvg_player* self,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_player_frame* frame);
+
+// iconvg_player__render_pixels is like iconvg_player__render to a canvas made
+// by iconvg_canvas__make_rasterizer (with the same arguments), drawing over
+// the pixel buffer's existing contents.
+//
+// If the player has coverage masks, recorded by an earlier call with the same
+// pixel dimensions, dst_rect and frame transform, then only the frame's
+// palette or alpha can have changed. The masks are then composited (see
+// iconvg_coverage_masks__composite) instead of rasterizing the paths again,
+// and scratch_ptr may be NULL. Otherwise, the frame is rasterized and, if they
+// fit, the masks are re-recorded.
+const char*                    //
+iconvg_player__render_pixels(  // ¶0.2
+    iconvg_player* self,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_player_frame* frame);
+
+// ----
+
+// iconvg_icon_pack__initialize sets up self to read the icon pack in
+// ptr[.. len], which must outlive self. It validates the pack's header and
+// index (but not the IconVG data) up front, so that later lookups are O(1)
+// and do not touch the data pages.
+//
+// It returns iconvg_error_invalid_constructor_argument if self is NULL,
+// iconvg_error_bad_magic_identifier if ptr[.. len] does not start with an
+// icon pack header and iconvg_error_bad_icon_pack if the index is malformed.
+const char*                    //
+iconvg_icon_pack__initialize(  // ¶0.2
+    iconvg_icon_pack* self,
+    const uint8_t* ptr,
+    size_t len);
+
+// iconvg_icon_pack__number_of_entries returns the number of graphics in self.
+uint32_t                              //
+iconvg_icon_pack__number_of_entries(  // ¶0.2
+    const iconvg_icon_pack* self);
+
+// iconvg_icon_pack__entry sets *dst to the index'th graphic in self, in
+// ascending name order. It returns false, leaving *dst unchanged, if index is
+// out of range.
+bool                      //
+iconvg_icon_pack__entry(  // ¶0.2
+    const iconvg_icon_pack* self,
+    iconvg_icon_pack_entry* dst,
+    uint32_t index);
+
+// iconvg_icon_pack__lookup sets *dst to the graphic with the given name (a
+// byte string, not necessarily NUL-terminated), using the pack's hash index.
+// It returns false, leaving *dst unchanged, if there is no such graphic.
+bool                       //
+iconvg_icon_pack__lookup(  // ¶0.2
+    const iconvg_icon_pack* self,
+    iconvg_icon_pack_entry* dst,
+    const char* name_ptr,
+    size_t name_len);
+
+// ----
+
+// iconvg_atlas_entry__make returns an entry whose larger side is max_side
+// pixels and whose aspect ratio matches viewbox (e.g. from
+// iconvg_decode_viewbox), with a zero x and y. Its width and height are zero
+// if the viewbox is empty.
+iconvg_atlas_entry         //
+iconvg_atlas_entry__make(  // ¶0.2
+    const iconvg_rectangle_f32* viewbox,
+    uint32_t max_side);
+
+// iconvg_atlas_entry__dst_rect returns the dst_rect argument for decoding a
+// graphic into self's sub-rectangle of the atlas' canvas. Every backend clips
+// to the dst_rect, so neighboring entries do not bleed into each other.
+iconvg_rectangle_f32           //
+iconvg_atlas_entry__dst_rect(  // ¶0.2
+    const iconvg_atlas_entry* self);
+
+// iconvg_atlas_scratch_len returns the minimum scratch_len argument (a number
+// of uint32_t elements, not bytes) that iconvg_atlas_pack accepts for
+// num_entries entries. It returns zero if num_entries exceeds
+// ICONVG_ATLAS_MAX_NUM_ENTRIES.
+size_t                     //
+iconvg_atlas_scratch_len(  // ¶0.2
+    size_t num_entries);
+
+// iconvg_atlas_pack packs the entries into an atlas no larger than max_width
+// by max_height pixels, setting each entry's x and y. There are at least
+// padding pixels between any two entries (but not around the atlas' edges),
+// so that texture filtering does not sample a neighbor.
+//
+// It uses a skyline (bottom-left) packer, placing taller entries first. The
+// packing is deterministic: it depends only on the entries' sizes, their
+// order and the other arguments.
+//
+// On success, it sets *dst_width and *dst_height (if non-NULL) to the size
+// of the bounding box of the packed entries, which is often smaller than the
+// maximum. It returns iconvg_error_system_failure_atlas_too_small if the
+// entries do not fit, in which case the entries' x and y are unspecified.
+//
+// scratch_ptr[.. scratch_len] is working memory, whose contents do not need
+// to be preserved between calls. See iconvg_atlas_scratch_len. The function
+// does not allocate memory.
+const char*         //
+iconvg_atlas_pack(  // ¶0.2
+    iconvg_atlas_entry* entries,
+    size_t num_entries,
+    uint32_t max_width,
+    uint32_t max_height,
+    uint32_t padding,
+    uint32_t* scratch_ptr,
+    size_t scratch_len,
+    uint32_t* dst_width,
+    uint32_t* dst_height);
+
 // ----
 
 // iconvg_paint__type returns what type of paint self is.
@@ -37,66 +37,18 @@ iconvg_private_angle(double ux, double uy, double vx, double vy) {
   return +ret;
 }
 
-static inline const char*  //
-iconvg_private_path_arc_segment_to(iconvg_canvas* c,
-                                   double scale_x,
-                                   double bias_x,
-                                   double scale_y,
-                                   double bias_y,
-                                   double cx,
-                                   double cy,
-                                   double theta1,
-                                   double theta2,
-                                   double rx,
-                                   double ry,
-                                   double cos_phi,
-                                   double sin_phi) {
-  double half_delta_theta = (theta2 - theta1) * 0.5;
-  double q = sin(half_delta_theta * 0.5);
-  double t = (8 * q * q) / (3 * sin(half_delta_theta));
-  double cos1 = cos(theta1);
-  double sin1 = sin(theta1);
-  double cos2 = cos(theta2);
-  double sin2 = sin(theta2);
-
-  double ix1 = rx * (+cos1 - (t * sin1));
-  double iy1 = ry * (+sin1 + (t * cos1));
-  double ix2 = rx * (+cos2 + (t * sin2));
-  double iy2 = ry * (+sin2 - (t * cos2));
-  double ix3 = rx * (+cos2);
-  double iy3 = ry * (+sin2);
-
-  double jx1 = cx + (cos_phi * ix1) - (sin_phi * iy1);
-  double jy1 = cy + (sin_phi * ix1) + (cos_phi * iy1);
-  double jx2 = cx + (cos_phi * ix2) - (sin_phi * iy2);
-  double jy2 = cy + (sin_phi * ix2) + (cos_phi * iy2);
-  double jx3 = cx + (cos_phi * ix3) - (sin_phi * iy3);
-  double jy3 = cy + (sin_phi * ix3) + (cos_phi * iy3);
-
-  return (*c->vtable->path_cube_to)(c,                         //
-                                    (jx1 * scale_x) + bias_x,  //
-                                    (jy1 * scale_y) + bias_y,  //
-                                    (jx2 * scale_x) + bias_x,  //
-                                    (jy2 * scale_y) + bias_y,  //
-                                    (jx3 * scale_x) + bias_x,  //
-                                    (jy3 * scale_y) + bias_y);
-}
-
-const char*  //
-iconvg_private_path_arc_to(iconvg_canvas* c,
-                           double scale_x,
-                           double bias_x,
-                           double scale_y,
-                           double bias_y,
-                           float initial_x,
-                           float initial_y,
-                           float radius_x,
-                           float radius_y,
-                           float x_axis_rotation,
-                           bool large_arc,
-                           bool sweep,
-                           float final_x,
-                           float final_y) {
+size_t  //
+iconvg_private_arc_to_cubics(double* dst,
+                             bool* dst_is_line,
+                             float initial_x,
+                             float initial_y,
+                             float radius_x,
+                             float radius_y,
+                             float x_axis_rotation,
+                             bool large_arc,
+                             bool sweep,
+                             float final_x,
+                             float final_y) {
   const double pi = 3.1415926535897932384626433832795028841972;   // π = τ/2
   const double tau = 6.2831853071795864769252867665590057683943;  // τ = 2*π
 
@@ -119,10 +71,9 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
   // non-zero (and non-NaN).
   double rx = fabs((double)radius_x);
   double ry = fabs((double)radius_y);
-  if (!(rx > 0) || !(ry > 0)) {
-    return (*c->vtable->path_line_to)(c,                             //
-                                      (final_x * scale_x) + bias_x,  //
-                                      (final_y * scale_y) + bias_y);
+  *dst_is_line = !(rx > 0) || !(ry > 0);
+  if (*dst_is_line) {
+    return 0;
   }
 
   double x1 = (double)initial_x;
@@ -174,13 +125,13 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
   double cx = +(cos_phi * cx_prime) - (sin_phi * cy_prime) + ((x1 + x2) / 2);
   double cy = +(sin_phi * cx_prime) + (cos_phi * cy_prime) + ((y1 + y2) / 2);
 
-  // Step 4: Compute θ1 and Δθ
+  // Step 4: Compute θ1 and Δθ. Only Δθ is needed as an angle. θ1 is the
+  // direction of (ax, ay), used as a unit vector below.
 
   double ax = (+x1_prime - cx_prime) / rx;
   double ay = (+y1_prime - cy_prime) / ry;
   double bx = (-x1_prime - cx_prime) / rx;
   double by = (-y1_prime - cy_prime) / ry;
-  double theta1 = iconvg_private_angle(1.0, 0.0, ax, ay);
   double delta_theta = iconvg_private_angle(ax, ay, bx, by);
   if (sweep) {
     if (delta_theta < 0.0) {
@@ -196,15 +147,92 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
   // https://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
   // algorithm. What follows below is specific to this implementation.
 
-  // We approximate an arc by one or more cubic Bézier curves.
-  int n = (int)(ceil(fabs(delta_theta) / ((pi / 2) + 0.001)));
-  double inv_n = 1.0 / ((double)n);
-  for (int i = 0; i < n; i++) {
-    ICONVG_PRIVATE_TRY(iconvg_private_path_arc_segment_to(
-        c, scale_x, bias_x, scale_y, bias_y, cx, cy,         //
-        theta1 + (delta_theta * ((double)(i + 0)) * inv_n),  //
-        theta1 + (delta_theta * ((double)(i + 1)) * inv_n),  //
-        rx, ry, cos_phi, sin_phi));
+  // We approximate an arc by one or more cubic Bézier curves, each spanning
+  // an equal step (at most a quarter turn) of the angle θ. Rather than
+  // calling cos and sin for every segment's end points, (cos θ, sin θ) starts
+  // at the unit vector (ax, ay) and is rotated by a fixed step each segment.
+  // With at most 4 steps, the accumulated error is a few ulps of a float64,
+  // many orders of magnitude below the float32 precision of the canvas
+  // method arguments.
+  double num_segments = ceil(fabs(delta_theta) / ((pi / 2) + 0.001));
+  if (!(num_segments >= 1) ||
+      !(num_segments <= ICONVG_PRIVATE_ARC_MAX_CUBICS)) {
+    // This includes coincident end points, where delta_theta is NaN. Per the
+    // SVG spec, such an arc is omitted entirely.
+    return 0;
+  }
+  size_t n = (size_t)num_segments;
+  double step = delta_theta / num_segments;
+  double half_step = step * 0.5;
+  double q = sin(half_step * 0.5);
+  double t = (8 * q * q) / (3 * sin(half_step));
+  double cos_step = cos(step);
+  double sin_step = sin(step);
+  double a_norm = sqrt((ax * ax) + (ay * ay));
+  double cos1 = ax / a_norm;
+  double sin1 = ay / a_norm;
+
+  for (size_t i = 0; i < n; i++) {
+    double cos2 = (cos1 * cos_step) - (sin1 * sin_step);
+    double sin2 = (sin1 * cos_step) + (cos1 * sin_step);
+
+    double ix1 = rx * (+cos1 - (t * sin1));
+    double iy1 = ry * (+sin1 + (t * cos1));
+    double ix2 = rx * (+cos2 + (t * sin2));
+    double iy2 = ry * (+sin2 - (t * cos2));
+    double ix3 = rx * (+cos2);
+    double iy3 = ry * (+sin2);
+
+    dst[0] = cx + (cos_phi * ix1) - (sin_phi * iy1);
+    dst[1] = cy + (sin_phi * ix1) + (cos_phi * iy1);
+    dst[2] = cx + (cos_phi * ix2) - (sin_phi * iy2);
+    dst[3] = cy + (sin_phi * ix2) + (cos_phi * iy2);
+    dst[4] = cx + (cos_phi * ix3) - (sin_phi * iy3);
+    dst[5] = cy + (sin_phi * ix3) + (cos_phi * iy3);
+    dst += 6;
+
+    cos1 = cos2;
+    sin1 = sin2;
+  }
+  return n;
+}
+
+const char*  //
+iconvg_private_path_arc_to(iconvg_private_path_batch* batch,
+                           iconvg_canvas* c,
+                           double scale_x,
+                           double bias_x,
+                           double scale_y,
+                           double bias_y,
+                           float initial_x,
+                           float initial_y,
+                           float radius_x,
+                           float radius_y,
+                           float x_axis_rotation,
+                           bool large_arc,
+                           bool sweep,
+                           float final_x,
+                           float final_y) {
+  double cubics[6 * ICONVG_PRIVATE_ARC_MAX_CUBICS];
+  bool is_line = false;
+  size_t n = iconvg_private_arc_to_cubics(
+      &cubics[0], &is_line, initial_x, initial_y, radius_x, radius_y,
+      x_axis_rotation, large_arc, sweep, final_x, final_y);
+  if (is_line) {
+    return iconvg_private_path_batch__line_to(
+        batch, c, false,               //
+        (final_x * scale_x) + bias_x,  //
+        (final_y * scale_y) + bias_y);
+  }
+  for (const double* p = &cubics[0]; n > 0; n--, p += 6) {
+    ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+        batch, c, false,            //
+        (p[0] * scale_x) + bias_x,  //
+        (p[1] * scale_y) + bias_y,  //
+        (p[2] * scale_x) + bias_x,  //
+        (p[3] * scale_y) + bias_y,  //
+        (p[4] * scale_x) + bias_x,  //
+        (p[5] * scale_y) + bias_y));
   }
   return NULL;
 }
@@ -0,0 +1,59 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+const char*  //
+iconvg_arena__initialize(iconvg_arena* self, void* ptr, size_t len) {
+  if (!self || !ptr || (((uintptr_t)ptr) & 7)) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  self->private_impl.ptr = (uint8_t*)ptr;
+  self->private_impl.len = len;
+  self->private_impl.used = 0;
+  self->private_impl.high_water_mark = 0;
+  return NULL;
+}
+
+void*  //
+iconvg_arena__alloc(iconvg_arena* self, size_t len) {
+  if (!self) {
+    return NULL;
+  }
+  // used is always a multiple of 8, so rounding len up keeps every
+  // allocation 8-byte aligned.
+  size_t n = (len <= (SIZE_MAX - 7)) ? ((len + 7) & ~((size_t)7)) : SIZE_MAX;
+  size_t used = self->private_impl.used;
+  size_t wanted = (n <= (SIZE_MAX - used)) ? (used + n) : SIZE_MAX;
+  if (self->private_impl.high_water_mark < wanted) {
+    self->private_impl.high_water_mark = wanted;
+  }
+  if (wanted > self->private_impl.len) {
+    return NULL;
+  }
+  self->private_impl.used = wanted;
+  return self->private_impl.ptr + used;
+}
+
+void  //
+iconvg_arena__reset(iconvg_arena* self) {
+  if (self) {
+    self->private_impl.used = 0;
+  }
+}
+
+size_t  //
+iconvg_arena__high_water_mark(const iconvg_arena* self) {
+  return self ? self->private_impl.high_water_mark : 0;
+}
@@ -0,0 +1,252 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// iconvg_atlas_pack is a skyline packer. The skyline is the top edge of the
+// packed boxes so far: a sequence of nodes, left to right, each a horizontal
+// segment from its x up to the next node's x (or the atlas' width) at height
+// y. Each box is placed, bottom-left style, where its top edge would be
+// lowest, breaking ties by the leftmost x. Boxes are placed tallest first,
+// which keeps the skyline flat.
+//
+// Placing a box replaces the nodes under it by one node (and shortens the
+// node that it partially covers, if any), so there are at most (1 + N) nodes
+// for N boxes. The scratch buffer holds the placement order (N words) and the
+// nodes' x and y (two words per node).
+
+// iconvg_private_atlas__less returns whether the a'th entry should be placed
+// before the b'th entry: taller first, then wider first, then in input order,
+// so that the packing does not depend on the sorting algorithm.
+static inline bool  //
+iconvg_private_atlas__less(const iconvg_atlas_entry* entries,
+                           uint32_t a,
+                           uint32_t b) {
+  if (entries[a].height != entries[b].height) {
+    return entries[a].height > entries[b].height;
+  } else if (entries[a].width != entries[b].width) {
+    return entries[a].width > entries[b].width;
+  }
+  return a < b;
+}
+
+static void  //
+iconvg_private_atlas__sift_down(const iconvg_atlas_entry* entries,
+                                uint32_t* order,
+                                size_t i,
+                                size_t n) {
+  while (true) {
+    size_t child = (2 * i) + 1;
+    if (child >= n) {
+      return;
+    } else if (((child + 1) < n) &&
+               iconvg_private_atlas__less(entries, order[child],
+                                          order[child + 1])) {
+      child++;
+    }
+    if (!iconvg_private_atlas__less(entries, order[i], order[child])) {
+      return;
+    }
+    uint32_t t = order[i];
+    order[i] = order[child];
+    order[child] = t;
+    i = child;
+  }
+}
+
+// iconvg_private_atlas__sort heap-sorts order[.. n] so that, on return,
+// iconvg_private_atlas__less is ascending. It needs no memory other than
+// order itself.
+static void  //
+iconvg_private_atlas__sort(const iconvg_atlas_entry* entries,
+                           uint32_t* order,
+                           size_t n) {
+  for (size_t i = n / 2; i > 0; i--) {
+    iconvg_private_atlas__sift_down(entries, order, i - 1, n);
+  }
+  for (size_t i = n; i > 1; i--) {
+    uint32_t t = order[0];
+    order[0] = order[i - 1];
+    order[i - 1] = t;
+    iconvg_private_atlas__sift_down(entries, order, 0, i - 1);
+  }
+}
+
+// ----
+
+iconvg_atlas_entry  //
+iconvg_atlas_entry__make(const iconvg_rectangle_f32* viewbox,
+                         uint32_t max_side) {
+  iconvg_atlas_entry e = {0};
+  double w = viewbox ? iconvg_rectangle_f32__width_f64(viewbox) : 0.0;
+  double h = viewbox ? iconvg_rectangle_f32__height_f64(viewbox) : 0.0;
+  if ((w <= 0) || (h <= 0) || (max_side == 0)) {
+    return e;
+  } else if (w >= h) {
+    e.width = max_side;
+    e.height = (uint32_t)(((max_side * h) / w) + 0.5);
+  } else {
+    e.width = (uint32_t)(((max_side * w) / h) + 0.5);
+    e.height = max_side;
+  }
+  // Keep a sliver of a graphic as at least one pixel, so that it is visible.
+  e.width = (e.width > 0) ? e.width : 1;
+  e.height = (e.height > 0) ? e.height : 1;
+  return e;
+}
+
+iconvg_rectangle_f32  //
+iconvg_atlas_entry__dst_rect(const iconvg_atlas_entry* self) {
+  if (!self) {
+    return iconvg_rectangle_f32__make(0, 0, 0, 0);
+  }
+  return iconvg_rectangle_f32__make(
+      (float)self->x, (float)self->y,
+      (float)((uint64_t)self->x + (uint64_t)self->width),
+      (float)((uint64_t)self->y + (uint64_t)self->height));
+}
+
+size_t  //
+iconvg_atlas_scratch_len(size_t num_entries) {
+  if (num_entries > ICONVG_ATLAS_MAX_NUM_ENTRIES) {
+    return 0;
+  }
+  return (3 * num_entries) + 2;
+}
+
+const char*  //
+iconvg_atlas_pack(iconvg_atlas_entry* entries,
+                  size_t num_entries,
+                  uint32_t max_width,
+                  uint32_t max_height,
+                  uint32_t padding,
+                  uint32_t* scratch_ptr,
+                  size_t scratch_len,
+                  uint32_t* dst_width,
+                  uint32_t* dst_height) {
+  if ((!entries && (num_entries > 0)) ||
+      (num_entries > ICONVG_ATLAS_MAX_NUM_ENTRIES) || !scratch_ptr ||
+      (scratch_len < iconvg_atlas_scratch_len(num_entries))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  // Each entry occupies a box that is padding pixels wider and taller than
+  // it. The boxes are packed into an area that is padding pixels wider and
+  // taller than the atlas, so that boxes along the right and bottom edges
+  // have their (unnecessary) padding outside of the atlas.
+  uint64_t limit_x = (uint64_t)max_width + padding;
+  uint64_t limit_y = (uint64_t)max_height + padding;
+  if ((limit_x > UINT32_MAX) || (limit_y > UINT32_MAX)) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  uint32_t* order = scratch_ptr;
+  size_t num_order = 0;
+  for (size_t i = 0; i < num_entries; i++) {
+    entries[i].x = 0;
+    entries[i].y = 0;
+    if ((entries[i].width > 0) && (entries[i].height > 0)) {
+      order[num_order++] = (uint32_t)i;
+    }
+  }
+  iconvg_private_atlas__sort(entries, order, num_order);
+
+  uint32_t* node_x = scratch_ptr + num_entries;
+  uint32_t* node_y = node_x + num_entries + 1;
+  size_t num_nodes = 1;
+  node_x[0] = 0;
+  node_y[0] = 0;
+  uint64_t used_w = 0;
+  uint64_t used_h = 0;
+
+  for (size_t k = 0; k < num_order; k++) {
+    iconvg_atlas_entry* e = &entries[order[k]];
+    uint64_t box_w = (uint64_t)e->width + padding;
+    uint64_t box_h = (uint64_t)e->height + padding;
+
+    // Find the best node i to start the box at.
+    size_t best_i = num_nodes;
+    uint64_t best_top = UINT64_MAX;
+    for (size_t i = 0; i < num_nodes; i++) {
+      uint64_t x0 = node_x[i];
+      uint64_t x1 = x0 + box_w;
+      if (x1 > limit_x) {
+        break;
+      }
+      uint64_t y = 0;
+      for (size_t j = i; (j < num_nodes) && (node_x[j] < x1); j++) {
+        y = (y > node_y[j]) ? y : node_y[j];
+      }
+      uint64_t top = y + box_h;
+      if ((top <= limit_y) && (top < best_top)) {
+        best_i = i;
+        best_top = top;
+      }
+    }
+    if (best_i == num_nodes) {
+      return iconvg_error_system_failure_atlas_too_small;
+    }
+
+    // Place the box and update the skyline. The nodes from best_i up to (but
+    // excluding) j end at or before x1, so the box fully covers them and they
+    // are replaced by one node. Node j, if it exists, ends after x1 and now
+    // starts at x1.
+    uint32_t x0 = node_x[best_i];
+    uint64_t x1 = x0 + box_w;
+    e->x = x0;
+    e->y = (uint32_t)(best_top - box_h);
+    size_t j = best_i;
+    for (; j < num_nodes; j++) {
+      uint64_t end = ((j + 1) < num_nodes) ? node_x[j + 1] : limit_x;
+      if (end > x1) {
+        break;
+      }
+    }
+    size_t num_removed = j - best_i;
+    if (j < num_nodes) {
+      node_x[j] = (uint32_t)x1;
+    }
+    if (num_removed == 0) {
+      // Insert a new node before best_i.
+      memmove(&node_x[best_i + 1], &node_x[best_i],
+              (num_nodes - best_i) * sizeof(uint32_t));
+      memmove(&node_y[best_i + 1], &node_y[best_i],
+              (num_nodes - best_i) * sizeof(uint32_t));
+      num_nodes++;
+    } else if (num_removed > 1) {
+      memmove(&node_x[best_i + 1], &node_x[j],
+              (num_nodes - j) * sizeof(uint32_t));
+      memmove(&node_y[best_i + 1], &node_y[j],
+              (num_nodes - j) * sizeof(uint32_t));
+      num_nodes -= num_removed - 1;
+    }
+    node_x[best_i] = x0;
+    node_y[best_i] = (uint32_t)best_top;
+
+    used_w = (used_w > (x0 + (uint64_t)e->width))
+                 ? used_w
+                 : (x0 + (uint64_t)e->width);
+    used_h = (used_h > (e->y + (uint64_t)e->height))
+                 ? used_h
+                 : (e->y + (uint64_t)e->height);
+  }
+
+  if (dst_width) {
+    *dst_width = (uint32_t)used_w;
+  }
+  if (dst_height) {
+    *dst_height = (uint32_t)used_h;
+  }
+  return NULL;
+}
@@ -0,0 +1,129 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+#include <pthread.h>
+#endif
+
+// iconvg_private_batch is the state shared by all of an iconvg_decode_batch
+// call's worker threads. Each worker repeatedly claims the next unclaimed job,
+// so that a worker that finishes a cheap icon early moves on to the
+// remaining jobs instead of idling while others work through expensive ones.
+typedef struct iconvg_private_batch_struct {
+  iconvg_decode_job* jobs;
+  size_t num_jobs;
+  size_t next_job;
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  bool locking;
+  pthread_mutex_t mutex;
+#endif
+} iconvg_private_batch;
+
+static void  //
+iconvg_private_batch__run(iconvg_private_batch* self) {
+  while (true) {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+    if (self->locking) {
+      pthread_mutex_lock(&self->mutex);
+    }
+#endif
+    size_t i = self->next_job;
+    if (i < self->num_jobs) {
+      self->next_job++;
+    }
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+    if (self->locking) {
+      pthread_mutex_unlock(&self->mutex);
+    }
+#endif
+    if (i >= self->num_jobs) {
+      return;
+    }
+
+    iconvg_decode_job* j = &self->jobs[i];
+    j->err_msg = iconvg_decode(j->dst_canvas, j->dst_rect, j->src_ptr,
+                               j->src_len, j->options);
+  }
+}
+
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+
+// ICONVG_PRIVATE_BATCH_MAX_THREADS bounds the number of threads (including
+// the calling thread) per iconvg_decode_batch call.
+#define ICONVG_PRIVATE_BATCH_MAX_THREADS 256
+
+static void*  //
+iconvg_private_batch__thread_main(void* arg) {
+  iconvg_private_batch__run((iconvg_private_batch*)arg);
+  return NULL;
+}
+
+#endif  // defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+
+const char*  //
+iconvg_decode_batch(iconvg_decode_job* jobs,
+                    size_t num_jobs,
+                    uint32_t num_threads) {
+  if (!jobs || (num_jobs == 0)) {
+    return NULL;
+  }
+
+  iconvg_private_batch b;
+  b.jobs = jobs;
+  b.num_jobs = num_jobs;
+  b.next_job = 0;
+
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  b.locking = false;
+  if (num_threads > ICONVG_PRIVATE_BATCH_MAX_THREADS) {
+    num_threads = ICONVG_PRIVATE_BATCH_MAX_THREADS;
+  }
+  if (num_threads > num_jobs) {
+    num_threads = (uint32_t)num_jobs;
+  }
+  if ((num_threads > 1) && (pthread_mutex_init(&b.mutex, NULL) == 0)) {
+    b.locking = true;
+    // The calling thread is one of the workers. If creating a thread fails,
+    // we carry on with the threads that we have.
+    pthread_t threads[ICONVG_PRIVATE_BATCH_MAX_THREADS - 1];
+    uint32_t num_spawned = 0;
+    for (; (num_spawned + 1) < num_threads; num_spawned++) {
+      if (pthread_create(&threads[num_spawned], NULL,
+                         &iconvg_private_batch__thread_main, &b) != 0) {
+        break;
+      }
+    }
+    iconvg_private_batch__run(&b);
+    for (uint32_t i = 0; i < num_spawned; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&b.mutex);
+  } else {
+    // pthread_mutex_init can only fail (on some platforms) for lack of
+    // resources. The single-threaded path doesn't need the mutex.
+    iconvg_private_batch__run(&b);
+  }
+#else
+  iconvg_private_batch__run(&b);
+#endif
+
+  for (size_t i = 0; i < num_jobs; i++) {
+    if (jobs[i].err_msg) {
+      return jobs[i].err_msg;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,560 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+#include <pthread.h>
+#endif
+
+// ICONVG_PRIVATE_BITMAP_CACHE_NONE is a null entry index, ending a list.
+#define ICONVG_PRIVATE_BITMAP_CACHE_NONE 0xFFFFFFFFu
+
+// ICONVG_PRIVATE_BITMAP_CACHE_MAX_ENTRIES bounds num_entries, so that entry
+// indexes (plus one) and the hash table's size fit in a uint32_t.
+#define ICONVG_PRIVATE_BITMAP_CACHE_MAX_ENTRIES 0x40000000
+
+// iconvg_private_bitmap_cache_entry is one slot of an iconvg_bitmap_cache.
+// Its pixels are at pixels_ptr[offset .. offset + len] in the state's pixel
+// arena.
+//
+// Each live entry is on two doubly linked lists (of entry indexes): the LRU
+// list, from least to most recently used, and the arena list, in pixel arena
+// (offset) order. Free entries are on a singly linked free list, via
+// lru_next.
+typedef struct iconvg_private_bitmap_cache_entry_struct {
+  uint64_t key_hash;
+  size_t offset;
+  size_t len;
+  uint32_t lru_prev;
+  uint32_t lru_next;
+  uint32_t arena_prev;
+  uint32_t arena_next;
+  iconvg_bitmap_cache_key key;
+} iconvg_private_bitmap_cache_entry;
+
+// iconvg_private_bitmap_cache_state is at the start of an iconvg_bitmap_cache
+// workbuf, followed by entries_cap entries, then the hash table's slots and
+// then the pixel arena.
+//
+// The hash table uses open addressing with linear probing. Each slot holds an
+// entry index plus one, or zero for an empty slot. It has at least twice as
+// many slots as entries, so that probe sequences stay short, and lookups,
+// inserts and evictions take O(1) expected time.
+//
+// The arena is a bump allocator: new pixels go at pixels_used, after every
+// live entry's, so the arena list is also the insertion order. When that runs
+// out but live_bytes (the sum of the live entries' len) leaves enough room,
+// the live entries are compacted towards the start of the arena.
+typedef struct iconvg_private_bitmap_cache_state_struct {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  pthread_mutex_t mutex;
+#endif
+  iconvg_private_bitmap_cache_entry* entries_ptr;
+  size_t entries_cap;
+  uint32_t* slots_ptr;
+  size_t slots_mask;
+  uint8_t* pixels_ptr;
+  size_t pixels_cap;
+  size_t pixels_used;
+  size_t live_bytes;
+  uint32_t lru_head;
+  uint32_t lru_tail;
+  uint32_t arena_head;
+  uint32_t arena_tail;
+  uint32_t free_head;
+} iconvg_private_bitmap_cache_state;
+
+// iconvg_private_hash_fnv1a64 returns the 64-bit FNV-1a hash of
+// ptr[.. len], continuing from h.
+static uint64_t  //
+iconvg_private_hash_fnv1a64(uint64_t h, const uint8_t* ptr, size_t len) {
+  for (; len > 0; ptr++, len--) {
+    h ^= *ptr;
+    h *= 0x00000100000001B3ull;
+  }
+  return h;
+}
+
+// iconvg_private_bitmap_cache__num_slots returns the hash table size for
+// num_entries: the smallest power of 2 that is at least 2 * num_entries.
+static size_t  //
+iconvg_private_bitmap_cache__num_slots(size_t num_entries) {
+  size_t n = 1;
+  while (n < (2 * num_entries)) {
+    n <<= 1;
+  }
+  return n;
+}
+
+// iconvg_private_bitmap_cache_key__hash mixes the key's 64-bit words, most of
+// which are already hashes. Keys are zeroed before their fields are set, so
+// they have no uninitialized padding.
+static uint64_t  //
+iconvg_private_bitmap_cache_key__hash(const iconvg_bitmap_cache_key* key) {
+  uint64_t words[sizeof(*key) / 8];
+  memcpy(&words[0], key, sizeof(words));
+  uint64_t h = 0;
+  for (size_t i = 0; i < (sizeof(words) / 8); i++) {
+    h = (h ^ words[i]) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+static inline void  //
+iconvg_private_bitmap_cache_state__lock(
+    iconvg_private_bitmap_cache_state* self) {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  pthread_mutex_lock(&self->mutex);
+#endif
+}
+
+static inline void  //
+iconvg_private_bitmap_cache_state__unlock(
+    iconvg_private_bitmap_cache_state* self) {
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  pthread_mutex_unlock(&self->mutex);
+#endif
+}
+
+static iconvg_private_bitmap_cache_entry*  //
+iconvg_private_bitmap_cache_state__find(
+    iconvg_private_bitmap_cache_state* self,
+    const iconvg_bitmap_cache_key* key,
+    uint64_t key_hash) {
+  for (size_t i = key_hash & self->slots_mask; self->slots_ptr[i] != 0;
+       i = (i + 1) & self->slots_mask) {
+    iconvg_private_bitmap_cache_entry* e =
+        &self->entries_ptr[self->slots_ptr[i] - 1];
+    if ((e->key_hash == key_hash) &&
+        (memcmp(&e->key, key, sizeof(*key)) == 0)) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+// iconvg_private_bitmap_cache_state__unindex removes the idx'th entry from
+// the hash table. Later slots in the same probe sequence are shifted back, so
+// that the table needs no tombstones.
+static void  //
+iconvg_private_bitmap_cache_state__unindex(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  size_t mask = self->slots_mask;
+  size_t i = self->entries_ptr[idx].key_hash & mask;
+  while (self->slots_ptr[i] != (idx + 1)) {
+    i = (i + 1) & mask;
+  }
+  self->slots_ptr[i] = 0;
+  for (size_t j = (i + 1) & mask; self->slots_ptr[j] != 0;
+       j = (j + 1) & mask) {
+    // The entry at j can move to i unless its home slot, k, is cyclically in
+    // (i, j], where a lookup for it would stop before reaching i.
+    size_t k = self->entries_ptr[self->slots_ptr[j] - 1].key_hash & mask;
+    if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+      continue;
+    }
+    self->slots_ptr[i] = self->slots_ptr[j];
+    self->slots_ptr[j] = 0;
+    i = j;
+  }
+}
+
+static void  //
+iconvg_private_bitmap_cache_state__lru_unlink(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  if (e->lru_prev != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->lru_prev].lru_next = e->lru_next;
+  } else {
+    self->lru_head = e->lru_next;
+  }
+  if (e->lru_next != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->lru_next].lru_prev = e->lru_prev;
+  } else {
+    self->lru_tail = e->lru_prev;
+  }
+}
+
+// iconvg_private_bitmap_cache_state__lru_push makes the idx'th entry the most
+// recently used.
+static void  //
+iconvg_private_bitmap_cache_state__lru_push(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  e->lru_prev = self->lru_tail;
+  e->lru_next = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  if (self->lru_tail != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[self->lru_tail].lru_next = idx;
+  } else {
+    self->lru_head = idx;
+  }
+  self->lru_tail = idx;
+}
+
+static void  //
+iconvg_private_bitmap_cache_state__arena_unlink(
+    iconvg_private_bitmap_cache_state* self,
+    uint32_t idx) {
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  if (e->arena_prev != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->arena_prev].arena_next = e->arena_next;
+  } else {
+    self->arena_head = e->arena_next;
+  }
+  if (e->arena_next != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    self->entries_ptr[e->arena_next].arena_prev = e->arena_prev;
+  } else {
+    self->arena_tail = e->arena_prev;
+  }
+}
+
+// iconvg_private_bitmap_cache_state__evict_oldest evicts the least recently
+// used entry, moving it to the free list. It returns false if there are no
+// live entries.
+static bool  //
+iconvg_private_bitmap_cache_state__evict_oldest(
+    iconvg_private_bitmap_cache_state* self) {
+  uint32_t idx = self->lru_head;
+  if (idx == ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    return false;
+  }
+  iconvg_private_bitmap_cache_state__unindex(self, idx);
+  iconvg_private_bitmap_cache_state__lru_unlink(self, idx);
+  iconvg_private_bitmap_cache_state__arena_unlink(self, idx);
+  iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+  self->live_bytes -= e->len;
+  e->lru_next = self->free_head;
+  self->free_head = idx;
+  return true;
+}
+
+// iconvg_private_bitmap_cache_state__compact moves the live entries' pixels,
+// in arena order, to be contiguous from the start of the arena.
+static void  //
+iconvg_private_bitmap_cache_state__compact(
+    iconvg_private_bitmap_cache_state* self) {
+  size_t cursor = 0;
+  for (uint32_t idx = self->arena_head; idx != ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+       idx = self->entries_ptr[idx].arena_next) {
+    iconvg_private_bitmap_cache_entry* e = &self->entries_ptr[idx];
+    if (e->offset != cursor) {
+      memmove(self->pixels_ptr + cursor, self->pixels_ptr + e->offset, e->len);
+      e->offset = cursor;
+    }
+    cursor += e->len;
+  }
+  self->pixels_used = cursor;
+}
+
+// ----
+
+// The FNV-1a 64-bit offset basis.
+#define ICONVG_PRIVATE_FNV1A64_BASIS 0xCBF29CE484222325ull
+
+// iconvg_private_bitmap_cache_key__make sets everything but the palette
+// fields, which the caller is responsible for.
+static iconvg_bitmap_cache_key  //
+iconvg_private_bitmap_cache_key__make(uint32_t pixels_width,
+                                      uint32_t pixels_height,
+                                      iconvg_rectangle_f32 dst_rect,
+                                      const uint8_t* src_ptr,
+                                      size_t src_len,
+                                      const iconvg_decode_options* options) {
+  iconvg_bitmap_cache_key k;
+  memset(&k, 0, sizeof(k));
+  k.private_impl.src_hash = iconvg_private_hash_fnv1a64(
+      ICONVG_PRIVATE_FNV1A64_BASIS, src_ptr, src_ptr ? src_len : 0);
+  k.private_impl.src_len = src_ptr ? src_len : 0;
+
+  // Key on the effective height_in_pixels, computed the same way as
+  // iconvg_private_paint__initialize does, so that an implicit and an
+  // equivalent explicit height share an entry.
+  if (options && options->height_in_pixels.has_value) {
+    k.private_impl.height_in_pixels = options->height_in_pixels.value;
+  } else {
+    double h = iconvg_rectangle_f32__height_f64(&dst_rect);
+    k.private_impl.height_in_pixels = (h <= 0x100000) ? (int64_t)h : 0x100000;
+  }
+
+  // transform_hash is zero (and the hash of the matrix otherwise, which is
+  // zero with negligible probability) when there is no transform.
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    k.private_impl.transform_hash = iconvg_private_hash_fnv1a64(
+        ICONVG_PRIVATE_FNV1A64_BASIS,
+        (const uint8_t*)(&transform->elems[0][0]), sizeof(transform->elems));
+  }
+  // Likewise for clip_rect_hash, as a culled rendering differs from a full
+  // one.
+  const iconvg_rectangle_f32* clip_rect =
+      iconvg_private_decode_options__clip_rect(options);
+  if (clip_rect) {
+    k.private_impl.clip_rect_hash = iconvg_private_hash_fnv1a64(
+        ICONVG_PRIVATE_FNV1A64_BASIS, (const uint8_t*)(clip_rect),
+        sizeof(*clip_rect));
+  }
+
+  k.private_impl.dst_rect[0] = dst_rect.min_x;
+  k.private_impl.dst_rect[1] = dst_rect.min_y;
+  k.private_impl.dst_rect[2] = dst_rect.max_x;
+  k.private_impl.dst_rect[3] = dst_rect.max_y;
+  k.private_impl.pixels_width = pixels_width;
+  k.private_impl.pixels_height = pixels_height;
+  return k;
+}
+
+iconvg_bitmap_cache_key  //
+iconvg_bitmap_cache_key__make(uint32_t pixels_width,
+                              uint32_t pixels_height,
+                              iconvg_rectangle_f32 dst_rect,
+                              const uint8_t* src_ptr,
+                              size_t src_len,
+                              const iconvg_decode_options* options) {
+  iconvg_bitmap_cache_key k = iconvg_private_bitmap_cache_key__make(
+      pixels_width, pixels_height, dst_rect, src_ptr, src_len, options);
+  if (options && options->palette) {
+    k.private_impl.has_palette = 1;
+    k.private_impl.palette_hash = iconvg_private_hash_fnv1a64(
+        ICONVG_PRIVATE_FNV1A64_BASIS, &options->palette->colors[0].rgba[0],
+        sizeof(options->palette->colors));
+  }
+  return k;
+}
+
+iconvg_bitmap_cache_key  //
+iconvg_bitmap_cache_key__make_compiled(uint32_t pixels_width,
+                                       uint32_t pixels_height,
+                                       iconvg_rectangle_f32 dst_rect,
+                                       const uint8_t* compiled_ptr,
+                                       size_t compiled_len,
+                                       const iconvg_decode_options* options) {
+  iconvg_bitmap_cache_key k = iconvg_private_bitmap_cache_key__make(
+      pixels_width, pixels_height, dst_rect, compiled_ptr, compiled_len,
+      options);
+  k.private_impl.from_compiled = 1;
+
+  iconvg_palette suggested;
+  uint64_t mask = 0;
+  if (iconvg_private_decode_compiled_header(&suggested, &mask, compiled_ptr,
+                                            compiled_len) ||
+      (mask == 0)) {
+    return k;
+  }
+  // Hash only the entries in mask, of the effective palette.
+  const iconvg_palette* palette =
+      (options && options->palette) ? options->palette : &suggested;
+  uint64_t h = ICONVG_PRIVATE_FNV1A64_BASIS;
+  for (int i = 0; i < 64; i++) {
+    if (mask & (((uint64_t)1) << i)) {
+      h = iconvg_private_hash_fnv1a64(h, &palette->colors[i].rgba[0], 4);
+    }
+  }
+  k.private_impl.has_palette = 1;
+  k.private_impl.palette_hash = h;
+  return k;
+}
+
+size_t  //
+iconvg_bitmap_cache_workbuf_len(size_t num_entries, size_t max_pixel_bytes) {
+  const size_t entry_len = sizeof(iconvg_private_bitmap_cache_entry);
+  const size_t state_len = sizeof(iconvg_private_bitmap_cache_state);
+  if ((num_entries == 0) ||
+      (num_entries > ICONVG_PRIVATE_BITMAP_CACHE_MAX_ENTRIES) ||
+      (num_entries > ((SIZE_MAX - state_len) / (entry_len + 8)))) {
+    return 0;
+  }
+  // The hash table has fewer than 4 * num_entries slots of 4 bytes each.
+  size_t n = state_len + (num_entries * entry_len) +
+             (iconvg_private_bitmap_cache__num_slots(num_entries) *
+              sizeof(uint32_t));
+  if (max_pixel_bytes > (SIZE_MAX - n)) {
+    return 0;
+  }
+  return n + max_pixel_bytes;
+}
+
+const char*  //
+iconvg_bitmap_cache__initialize(iconvg_bitmap_cache* self,
+                                void* workbuf_ptr,
+                                size_t workbuf_len,
+                                size_t num_entries) {
+  size_t min_len = iconvg_bitmap_cache_workbuf_len(num_entries, 0);
+  if (!self || !workbuf_ptr || (((uintptr_t)workbuf_ptr) & 7) ||
+      (min_len == 0) || (workbuf_len < min_len)) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(workbuf_ptr);
+  memset(state, 0, min_len);
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  if (pthread_mutex_init(&state->mutex, NULL) != 0) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+#endif
+  uint8_t* p = (uint8_t*)(workbuf_ptr);
+  state->entries_ptr = (iconvg_private_bitmap_cache_entry*)(
+      p + sizeof(iconvg_private_bitmap_cache_state));
+  state->entries_cap = num_entries;
+  state->slots_ptr = (uint32_t*)(state->entries_ptr + num_entries);
+  state->slots_mask = iconvg_private_bitmap_cache__num_slots(num_entries) - 1;
+  state->pixels_ptr = p + min_len;
+  state->pixels_cap = workbuf_len - min_len;
+  state->lru_head = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->lru_tail = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->arena_head = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->arena_tail = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  state->free_head = 0;
+  for (size_t i = 0; i < num_entries; i++) {
+    state->entries_ptr[i].lru_next = ((i + 1) < num_entries)
+                                         ? ((uint32_t)(i + 1))
+                                         : ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  }
+  self->private_impl.workbuf_ptr = workbuf_ptr;
+  return NULL;
+}
+
+void  //
+iconvg_bitmap_cache__finalize(iconvg_bitmap_cache* self) {
+  if (!self || !self->private_impl.workbuf_ptr) {
+    return;
+  }
+#if defined(ICONVG_CONFIG__ENABLE_PTHREADS)
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(self->private_impl.workbuf_ptr);
+  pthread_mutex_destroy(&state->mutex);
+#endif
+  self->private_impl.workbuf_ptr = NULL;
+}
+
+bool  //
+iconvg_bitmap_cache__lookup(iconvg_bitmap_cache* self,
+                            const iconvg_bitmap_cache_key* key,
+                            uint8_t* dst_ptr,
+                            size_t dst_stride) {
+  if (!self || !self->private_impl.workbuf_ptr || !key) {
+    return false;
+  }
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(self->private_impl.workbuf_ptr);
+  uint64_t key_hash = iconvg_private_bitmap_cache_key__hash(key);
+  iconvg_private_bitmap_cache_state__lock(state);
+
+  iconvg_private_bitmap_cache_entry* e =
+      iconvg_private_bitmap_cache_state__find(state, key, key_hash);
+  if (e) {
+    uint32_t idx = (uint32_t)(e - state->entries_ptr);
+    iconvg_private_bitmap_cache_state__lru_unlink(state, idx);
+    iconvg_private_bitmap_cache_state__lru_push(state, idx);
+    if (dst_ptr) {
+      size_t row_len = 4 * ((size_t)(key->private_impl.pixels_width));
+      const uint8_t* src = state->pixels_ptr + e->offset;
+      for (uint32_t y = 0; y < key->private_impl.pixels_height; y++) {
+        memcpy(dst_ptr, src, row_len);
+        dst_ptr += dst_stride;
+        src += row_len;
+      }
+    }
+  }
+
+  iconvg_private_bitmap_cache_state__unlock(state);
+  return e != NULL;
+}
+
+const char*  //
+iconvg_bitmap_cache__insert(iconvg_bitmap_cache* self,
+                            const iconvg_bitmap_cache_key* key,
+                            const uint8_t* src_ptr,
+                            size_t src_stride) {
+  if (!self || !self->private_impl.workbuf_ptr || !key || !src_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  size_t width = key->private_impl.pixels_width;
+  size_t height = key->private_impl.pixels_height;
+  if ((width > (SIZE_MAX / 4)) || (src_stride < (4 * width))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  size_t row_len = 4 * width;
+  iconvg_private_bitmap_cache_state* state =
+      (iconvg_private_bitmap_cache_state*)(self->private_impl.workbuf_ptr);
+  if ((row_len == 0) || (height == 0) ||
+      (height > (state->pixels_cap / row_len))) {
+    return NULL;
+  }
+  size_t len = row_len * height;
+  uint64_t key_hash = iconvg_private_bitmap_cache_key__hash(key);
+
+  iconvg_private_bitmap_cache_state__lock(state);
+
+  iconvg_private_bitmap_cache_entry* e =
+      iconvg_private_bitmap_cache_state__find(state, key, key_hash);
+  if (e) {
+    // Another caller (e.g. on another thread) got here first.
+    uint32_t idx = (uint32_t)(e - state->entries_ptr);
+    iconvg_private_bitmap_cache_state__lru_unlink(state, idx);
+    iconvg_private_bitmap_cache_state__lru_push(state, idx);
+    iconvg_private_bitmap_cache_state__unlock(state);
+    return NULL;
+  }
+
+  if (state->free_head == ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    iconvg_private_bitmap_cache_state__evict_oldest(state);
+  }
+  while (len > (state->pixels_cap - state->live_bytes)) {
+    iconvg_private_bitmap_cache_state__evict_oldest(state);
+  }
+  if (len > (state->pixels_cap - state->pixels_used)) {
+    iconvg_private_bitmap_cache_state__compact(state);
+  }
+
+  uint32_t idx = state->free_head;
+  e = &state->entries_ptr[idx];
+  state->free_head = e->lru_next;
+  e->key_hash = key_hash;
+  e->offset = state->pixels_used;
+  e->len = len;
+  e->key = *key;
+  state->pixels_used += len;
+  state->live_bytes += len;
+
+  size_t i = key_hash & state->slots_mask;
+  while (state->slots_ptr[i] != 0) {
+    i = (i + 1) & state->slots_mask;
+  }
+  state->slots_ptr[i] = idx + 1;
+  iconvg_private_bitmap_cache_state__lru_push(state, idx);
+  e->arena_prev = state->arena_tail;
+  e->arena_next = ICONVG_PRIVATE_BITMAP_CACHE_NONE;
+  if (state->arena_tail != ICONVG_PRIVATE_BITMAP_CACHE_NONE) {
+    state->entries_ptr[state->arena_tail].arena_next = idx;
+  } else {
+    state->arena_head = idx;
+  }
+  state->arena_tail = idx;
+
+  uint8_t* dst = state->pixels_ptr + e->offset;
+  for (size_t y = 0; y < height; y++) {
+    memcpy(dst, src_ptr, row_len);
+    dst += row_len;
+    src_ptr += src_stride;
+  }
+
+  iconvg_private_bitmap_cache_state__unlock(state);
+  return NULL;
+}
@@ -90,6 +90,19 @@ iconvg_private_broken_canvas__on_metadata_suggested_palette(
   return ((const char*)(c->context.const_ptr3));
 }
 
+static const char*  //
+iconvg_private_broken_canvas__path_segments(iconvg_canvas* c,
+                                            const uint8_t* verbs,
+                                            size_t num_verbs,
+                                            const float* points) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
+static const char*  //
+iconvg_private_broken_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  return ((const char*)(c->context.const_ptr3));
+}
+
 static const iconvg_canvas_vtable  //
     iconvg_private_broken_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
@@ -104,6 +117,8 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_broken_canvas__path_cube_to,
         &iconvg_private_broken_canvas__on_metadata_viewbox,
         &iconvg_private_broken_canvas__on_metadata_suggested_palette,
+        &iconvg_private_broken_canvas__path_segments,
+        &iconvg_private_broken_canvas__on_skipped_drawing,
 };
 
 iconvg_canvas  //
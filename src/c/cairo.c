@@ -21,6 +21,21 @@ iconvg_canvas__make_cairo(cairo_t* cr) {
   return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
 }
 
+iconvg_canvas  //
+iconvg_canvas__make_cairo_with_gradient_cache(cairo_t* cr,
+                                              iconvg_gradient_cache* gc) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
+
+bool  //
+iconvg_private_cairo_canvas__push_transform(iconvg_canvas* c,
+                                            const iconvg_matrix_2x3_f64* m) {
+  return false;
+}
+
+void  //
+iconvg_private_cairo_canvas__pop_transform(iconvg_canvas* c) {}
+
 #else  // ICONVG_CONFIG__ENABLE_CAIRO_BACKEND
 
 #include <cairo/cairo.h>
@@ -45,6 +60,11 @@ iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(iconvg_matrix_2x3_f64 i) {
   return c;
 }
 
+static void  //
+iconvg_private_cairo_release_pattern(void* obj) {
+  cairo_pattern_destroy((cairo_pattern_t*)obj);
+}
+
 // iconvg_private_cairo_set_gradient_stops sets the Cairo gradient stop colors
 // given the IconVG gradient stop colors.
 //
@@ -178,10 +198,12 @@ static const char*  //
 iconvg_private_cairo_canvas__end_drawing(iconvg_canvas* c,
                                          const iconvg_paint* p) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
-  cairo_pattern_t* cp = NULL;
-  cairo_matrix_t cm = {0};
+  iconvg_gradient_cache* gc =
+      (iconvg_gradient_cache*)(c->context.nonconst_ptr2);
+  iconvg_paint_type paint_type = iconvg_paint__type(p);
+  iconvg_matrix_2x3_f64 gtm;
 
-  switch (iconvg_paint__type(p)) {
+  switch (paint_type) {
     case ICONVG_PAINT_TYPE__FLAT_COLOR: {
       iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
       cairo_set_source_rgba(cr, k.rgba[0] / 255.0, k.rgba[1] / 255.0,
@@ -190,32 +212,47 @@ iconvg_private_cairo_canvas__end_drawing(iconvg_canvas* c,
       return NULL;
     }
 
-    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT: {
-      iconvg_matrix_2x3_f64 gtm =
-          iconvg_paint__gradient_transformation_matrix(p);
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+      gtm = iconvg_paint__gradient_transformation_matrix(p);
       iconvg_matrix_2x3_f64__override_second_row(&gtm);
-      cp = cairo_pattern_create_linear(0, 0, 1, 0);
-      cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(gtm);
       break;
-    }
 
-    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
-      iconvg_matrix_2x3_f64 gtm =
-          iconvg_paint__gradient_transformation_matrix(p);
-      cp = cairo_pattern_create_radial(0, 0, 0, 0, 0, 1);
-      cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(gtm);
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      gtm = iconvg_paint__gradient_transformation_matrix(p);
       break;
-    }
 
     default:
       return iconvg_error_invalid_paint_type;
   }
 
+  // Re-use a cached pattern, if there is one. The cache key excludes the
+  // matrix, which depends on the dst_rect, so set this drawing's matrix
+  // before filling. cairo_fill is done with the pattern once it returns.
+  cairo_matrix_t cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(gtm);
+  iconvg_private_gradient_key key;
+  if (gc) {
+    iconvg_private_gradient_key__initialize(&key, p);
+    cairo_pattern_t* cached =
+        (cairo_pattern_t*)(iconvg_private_gradient_cache__lookup(
+            gc, &key, &iconvg_private_cairo_release_pattern));
+    if (cached) {
+      cairo_pattern_set_matrix(cached, &cm);
+      cairo_set_source(cr, cached);
+      cairo_fill(cr);
+      return NULL;
+    }
+  }
+
+  cairo_pattern_t* cp =
+      (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT)
+          ? cairo_pattern_create_linear(0, 0, 1, 0)
+          : cairo_pattern_create_radial(0, 0, 0, 0, 0, 1);
   cairo_pattern_set_matrix(cp, &cm);
   cairo_pattern_set_extend(cp, iconvg_private_gradient_spread_as_cairo_extend_t
                                    [iconvg_paint__gradient_spread(p)]);
   iconvg_private_cairo_set_gradient_stops(cp, p);
-  if (cairo_pattern_status(cp) == CAIRO_STATUS_SUCCESS) {
+  bool ok = cairo_pattern_status(cp) == CAIRO_STATUS_SUCCESS;
+  if (ok) {
     cairo_set_source(cr, cp);
   } else {
     // Substitute in a 50% transparent grayish purple so that "something is
@@ -225,7 +262,18 @@ iconvg_private_cairo_canvas__end_drawing(iconvg_canvas* c,
   }
 
   cairo_fill(cr);
-  cairo_pattern_destroy(cp);
+
+  // Hand our reference over to the cache (the cairo_t holds its own), or drop
+  // it. Cairo keeps each stop as a five-double color and offset plus four
+  // uint16_t color components.
+  int num_cairo_stops = 0;
+  cairo_pattern_get_color_stop_count(cp, &num_cairo_stops);
+  size_t backend_bytes = 256 + (((size_t)num_cairo_stops) * 48);
+  if (!ok || !gc ||
+      !iconvg_private_gradient_cache__insert(
+          gc, &key, &iconvg_private_cairo_release_pattern, cp, backend_bytes)) {
+    cairo_pattern_destroy(cp);
+  }
   return NULL;
 }
 
@@ -308,6 +356,35 @@ iconvg_private_cairo_canvas__on_metadata_suggested_palette(
   return NULL;
 }
 
+static const char*  //
+iconvg_private_cairo_canvas__path_segments(iconvg_canvas* c,
+                                           const uint8_t* verbs,
+                                           size_t num_verbs,
+                                           const float* points) {
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        cairo_line_to(cr, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        iconvg_private_cairo_canvas__path_quad_to(c, points[0], points[1],
+                                                  points[2], points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        cairo_curve_to(cr, points[0], points[1], points[2], points[3],
+                       points[4], points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
 static const iconvg_canvas_vtable  //
     iconvg_private_cairo_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
@@ -322,10 +399,18 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_cairo_canvas__path_cube_to,
         &iconvg_private_cairo_canvas__on_metadata_viewbox,
         &iconvg_private_cairo_canvas__on_metadata_suggested_palette,
+        &iconvg_private_cairo_canvas__path_segments,
+        NULL,
 };
 
 iconvg_canvas  //
 iconvg_canvas__make_cairo(cairo_t* cr) {
+  return iconvg_canvas__make_cairo_with_gradient_cache(cr, NULL);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_cairo_with_gradient_cache(cairo_t* cr,
+                                              iconvg_gradient_cache* gc) {
   if (!cr) {
     return iconvg_canvas__make_broken(
         iconvg_error_invalid_constructor_argument);
@@ -334,7 +419,34 @@ iconvg_canvas__make_cairo(cairo_t* cr) {
   c.vtable = &iconvg_private_cairo_canvas_vtable;
   memset(&c.context, 0, sizeof(c.context));
   c.context.nonconst_ptr1 = cr;
+  c.context.nonconst_ptr2 = gc;
   return c;
 }
 
+bool  //
+iconvg_private_cairo_canvas__push_transform(iconvg_canvas* c,
+                                            const iconvg_matrix_2x3_f64* m) {
+  if (!c || (c->vtable != &iconvg_private_cairo_canvas_vtable)) {
+    return false;
+  }
+  // A non-invertible matrix would put the cairo_t into an error state, so
+  // leave those to the transform canvas.
+  cairo_matrix_t cm = iconvg_private_matrix_2x3_f64_as_cairo_matrix_t(*m);
+  cairo_matrix_t inverse = cm;
+  if (cairo_matrix_invert(&inverse) != CAIRO_STATUS_SUCCESS) {
+    return false;
+  }
+  // cairo_transform, unlike cairo_set_matrix, keeps whatever matrix (e.g. a
+  // HiDPI device scale) the caller already set on the cairo_t.
+  cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
+  cairo_save(cr);
+  cairo_transform(cr, &cm);
+  return true;
+}
+
+void  //
+iconvg_private_cairo_canvas__pop_transform(iconvg_canvas* c) {
+  cairo_restore((cairo_t*)(c->context.nonconst_ptr1));
+}
+
 #endif  // ICONVG_CONFIG__ENABLE_CAIRO_BACKEND
@@ -0,0 +1,1299 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// The compiled form is a sequence of little-endian uint32_t words. It starts
+// with a header:
+//  - 1 word: the magic identifier "\x89IVC".
+//  - 4 words: the ViewBox (min_x, min_y, max_x, max_y) as float32 bits.
+//  - 64 words: the suggested palette, as premultiplied RGBA.
+//  - 2 words: the palette mask (low word first). Bit i is set if any drawing
+//    depends on the i'th custom palette entry.
+//
+// The header is followed by zero or more ops. Each op is one word (whose low
+// byte is the opcode and whose upper three bytes are the a, b and c
+// arguments) followed by zero or more argument words. Coordinates are always
+// absolute and in ViewBox space, so that replaying an op only needs to apply
+// the same s2d (src to dst) transform that iconvg_private_execute_bytecode
+// applies, producing exactly the same canvas method arguments.
+//
+// Color register values that depend on the custom palette are not resolved
+// until replay time, since each iconvg_decode_compiled call can pass its own
+// iconvg_decode_options palette. The compiler tracks which palette entries
+// each CREG value derives from, so that it can mark the drawings (and the
+// palette mask) whose paint depends on them.
+//
+// The compiled form is not a stable file format. It should only be replayed
+// by the same library version that produced it.
+
+#define ICONVG_PRIVATE_COMPILED_MAGIC 0x43564989u
+#define ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS 71
+
+// SET_CREG_RGBA sets CREG[a] to the next word's RGBA.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA 0x01
+// SET_CREG_ONE_BYTE sets CREG[a] to the one byte color b, which refers to the
+// custom palette or to CREG.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_ONE_BYTE 0x02
+// SET_CREG_BLEND sets CREG[a] to blending the one byte colors b and c, with
+// the next word holding the blend weight of c.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND 0x03
+// SET_NREG sets NREG[a] to the next word's float32.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG 0x04
+// SET_LOD sets the Level of Detail bounds to the next two float32 words.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD 0x05
+// BEGIN_DRAWING sets the paint to CREG[a] and begins a drawing and path. b is
+// 1 if the paint (including any gradient stops) depends on the custom palette
+// and 0 otherwise. It is followed by 7 words: a skip count, the path's initial
+// x and y and the drawing's bounds (min_x, min_y, max_x, max_y, as per
+// iconvg_private_decoder__drawing_bounds), all but the first as float32. The
+// skip count is the number of words, after those 7, up to and including the
+// matching END_DRAWING op. Replay can use it to jump over a drawing that is
+// outside the Level of Detail bounds or the clip rectangle, or that has a
+// palette-independent transparent paint, or whose coverage comes from an
+// iconvg_coverage_masks.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING 0x06
+// MOVE_TO ends the path and begins a new one at the next two float32 words.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO 0x07
+// LINE_TO, QUAD_TO and CUBE_TO are followed by a segments, each of 2, 4 or 6
+// float32 words.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO 0x08
+#define ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO 0x09
+#define ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO 0x0A
+// CUBE_TO_F64 is like CUBE_TO except that each of its 6 coordinates is a
+// float64 (low word first), 12 words per segment. The compiler converts arcs
+// to these, so that replay does no trigonometry. Keeping the conversion's
+// float64 precision (instead of rounding to float32 before the s2d transform)
+// means that replay still produces exactly the same canvas method arguments.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64 0x0B
+// END_DRAWING ends the path and the drawing.
+#define ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING 0x0C
+
+typedef struct iconvg_private_compiler_struct {
+  uint8_t* ptr;
+  size_t len;
+  // n is the number of bytes emitted so far, which can exceed len when the
+  // dst buffer is too short.
+  size_t n;
+  // skip_count_n is the value of n just after the current drawing's
+  // BEGIN_DRAWING skip count was emitted.
+  size_t skip_count_n;
+  // creg_deps[i] is the set (a bitmask) of custom palette entries that
+  // CREG[i] derives from. When it is zero, creg_values[i] is CREG[i]'s value,
+  // independent of the palette.
+  uint64_t creg_deps[64];
+  iconvg_palette creg_values;
+  // palette_mask is the union of every drawing's palette dependencies.
+  uint64_t palette_mask;
+  // lod is the Level of Detail range set by the most recent SET_LOD.
+  float lod[2];
+  // probe, if non-NULL, gathers iconvg_probe's bytecode statistics.
+  // probe_lod_segments is where the current drawing's segments are counted,
+  // other than in the total, or NULL if its LOD range overflowed.
+  iconvg_probe_results* probe;
+  uint64_t* probe_lod_segments;
+} iconvg_private_compiler;
+
+static inline void  //
+iconvg_private_compiler__emit_u32(iconvg_private_compiler* self, uint32_t u) {
+  if ((self->n <= self->len) && ((self->len - self->n) >= 4)) {
+    iconvg_private_poke_u32le(self->ptr + self->n, u);
+  }
+  self->n += 4;
+}
+
+static inline void  //
+iconvg_private_compiler__patch_u32(iconvg_private_compiler* self,
+                                   size_t offset,
+                                   uint32_t u) {
+  if ((offset <= self->len) && ((self->len - offset) >= 4)) {
+    iconvg_private_poke_u32le(self->ptr + offset, u);
+  }
+}
+
+static inline void  //
+iconvg_private_compiler__emit_f32(iconvg_private_compiler* self, float f) {
+  iconvg_private_compiler__emit_u32(
+      self, iconvg_private_reinterpret_from_f32_to_u32(f));
+}
+
+static inline void  //
+iconvg_private_compiler__emit_f64(iconvg_private_compiler* self, double f) {
+  uint64_t u = iconvg_private_reinterpret_from_f64_to_u64(f);
+  iconvg_private_compiler__emit_u32(self, (uint32_t)(u >> 0));
+  iconvg_private_compiler__emit_u32(self, (uint32_t)(u >> 32));
+}
+
+static void  //
+iconvg_private_compiler__probe_op(iconvg_private_compiler* self,
+                                  uint32_t opcode,
+                                  uint32_t a);
+
+static inline void  //
+iconvg_private_compiler__emit_op(iconvg_private_compiler* self,
+                                 uint32_t opcode,
+                                 uint32_t a,
+                                 uint32_t b,
+                                 uint32_t c) {
+  iconvg_private_compiler__emit_u32(
+      self, opcode | ((a & 0xFF) << 8) | ((b & 0xFF) << 16) | (c << 24));
+  if (self->probe) {
+    iconvg_private_compiler__probe_op(self, opcode, a);
+  }
+}
+
+static inline void  //
+iconvg_private_compiler__emit_set_creg_rgba(iconvg_private_compiler* self,
+                                            uint32_t creg_index,
+                                            const uint8_t* rgba) {
+  iconvg_private_compiler__emit_op(
+      self, ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA, creg_index, 0, 0);
+  iconvg_private_compiler__emit_u32(self, iconvg_private_peek_u32le(rgba));
+  self->creg_deps[creg_index] = 0;
+  memcpy(&self->creg_values.colors[creg_index].rgba[0], rgba, 4);
+}
+
+// iconvg_private_compiler__one_byte_color sets *dst_rgba to the one byte
+// color u (meaningful only if the result is zero) and returns the set of
+// custom palette entries that it derives from.
+static inline uint64_t  //
+iconvg_private_compiler__one_byte_color(iconvg_private_compiler* self,
+                                        uint8_t* dst_rgba,
+                                        uint8_t u) {
+  static const iconvg_palette placeholder_palette = {{{{0}}}};
+  iconvg_private_set_one_byte_color(dst_rgba, &placeholder_palette,
+                                    &self->creg_values, u);
+  if (u < 0x80) {
+    return 0;
+  } else if (u < 0xC0) {
+    return ((uint64_t)1) << (u & 0x3F);
+  }
+  return self->creg_deps[u & 0x3F];
+}
+
+// iconvg_private_compiler__paint_deps returns the set of custom palette
+// entries that a drawing with CREG[creg_index] as its paint depends on.
+static uint64_t  //
+iconvg_private_compiler__paint_deps(iconvg_private_compiler* self,
+                                    uint32_t creg_index) {
+  uint64_t deps = self->creg_deps[creg_index];
+  if (deps != 0) {
+    // Custom palette entries are valid premultiplied colors, and so is any
+    // blend of them. A palette-dependent paint is therefore a flat color.
+    return deps;
+  }
+  iconvg_paint p;
+  memcpy(&p.paint_rgba[0], &self->creg_values.colors[creg_index].rgba[0], 4);
+  if (iconvg_paint__type(&p) == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    return 0;
+  }
+  uint32_t cbase = p.paint_rgba[1];
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(&p);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    deps |= self->creg_deps[0x3F & (cbase + i)];
+  }
+  return deps;
+}
+
+// iconvg_private_compiler__probe_op updates self->probe's statistics for an
+// op that is being emitted. For BEGIN_DRAWING, a is the CREG index.
+static void  //
+iconvg_private_compiler__probe_op(iconvg_private_compiler* self,
+                                  uint32_t opcode,
+                                  uint32_t a) {
+  iconvg_probe_results* probe = self->probe;
+  switch (opcode) {
+    case ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING: {
+      probe->num_drawings++;
+      if (self->creg_deps[a] == 0) {
+        iconvg_paint p;
+        memcpy(&p.paint_rgba[0], &self->creg_values.colors[a].rgba[0], 4);
+        iconvg_paint_type t = iconvg_paint__type(&p);
+        if ((t == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) ||
+            (t == ICONVG_PAINT_TYPE__RADIAL_GRADIENT)) {
+          probe->num_gradient_drawings++;
+        }
+      }
+
+      uint32_t i = 0;
+      for (; i < probe->num_lod_ranges; i++) {
+        if ((probe->lod_ranges[i].lod0 == self->lod[0]) &&
+            (probe->lod_ranges[i].lod1 == self->lod[1])) {
+          break;
+        }
+      }
+      if (i == probe->num_lod_ranges) {
+        if (i == ICONVG_PROBE_MAX_LOD_RANGES) {
+          probe->lod_ranges_overflowed = true;
+          self->probe_lod_segments = NULL;
+          return;
+        }
+        probe->lod_ranges[i].lod0 = self->lod[0];
+        probe->lod_ranges[i].lod1 = self->lod[1];
+        probe->num_lod_ranges++;
+      }
+      probe->lod_ranges[i].num_drawings++;
+      self->probe_lod_segments = &probe->lod_ranges[i].num_path_segments;
+      return;
+    }
+
+    case ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO:
+    case ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO:
+    case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO:
+    case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64:
+      probe->num_path_segments += a;
+      if (self->probe_lod_segments) {
+        *self->probe_lod_segments += a;
+      }
+      return;
+  }
+}
+
+// ----
+
+// iconvg_private_compile_bytecode is like iconvg_private_execute_bytecode
+// except that it emits compiled ops instead of calling canvas methods. The two
+// functions should be kept in sync.
+static const char*  //
+iconvg_private_compile_bytecode(iconvg_private_compiler* e,
+                                iconvg_private_decoder* d) {
+  // adjustments are the ADJ values from the IconVG spec.
+  static const uint32_t adjustments[8] = {0, 1, 2, 3, 4, 5, 6, 0};
+
+  float curr_x = +0.0f;
+  float curr_y = +0.0f;
+  float x1 = +0.0f;
+  float y1 = +0.0f;
+  float x2 = +0.0f;
+  float y2 = +0.0f;
+  float x3 = +0.0f;
+  float y3 = +0.0f;
+  uint32_t flags = 0;
+
+  // sel[0] and sel[1] are the CSEL and NSEL registers.
+  uint32_t sel[2] = {0};
+
+styling_mode:
+  while (true) {
+    if (d->len == 0) {
+      return NULL;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    if (opcode < 0x80) {
+      sel[opcode >> 6] = opcode & 0x3F;
+      continue;
+
+    } else if (opcode < 0x88) {  // Set CREG[etc]; 1 byte color.
+      if (d->len < 1) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t u = d->ptr[0];
+      if (u < 0x80) {
+        iconvg_private_compiler__emit_set_creg_rgba(
+            e, creg_index, &iconvg_private_one_byte_colors[4 * ((size_t)u)]);
+      } else {
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_ONE_BYTE, creg_index,
+            u, 0);
+        uint8_t rgba[4];
+        e->creg_deps[creg_index] =
+            iconvg_private_compiler__one_byte_color(e, &rgba[0], u);
+        memcpy(&e->creg_values.colors[creg_index].rgba[0], &rgba[0], 4);
+      }
+      d->ptr += 1;
+      d->len -= 1;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0x90) {  // Set CREG[etc]; 2 byte color.
+      if (d->len < 2) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t rgba[4];
+      rgba[0] = 0x11 * (d->ptr[0] >> 4);
+      rgba[1] = 0x11 * (d->ptr[0] & 0x0F);
+      rgba[2] = 0x11 * (d->ptr[1] >> 4);
+      rgba[3] = 0x11 * (d->ptr[1] & 0x0F);
+      iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, &rgba[0]);
+      d->ptr += 2;
+      d->len -= 2;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0x98) {  // Set CREG[etc]; 3 byte (direct) color.
+      if (d->len < 3) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint8_t rgba[4];
+      rgba[0] = d->ptr[0];
+      rgba[1] = d->ptr[1];
+      rgba[2] = d->ptr[2];
+      rgba[3] = 0xFF;
+      iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, &rgba[0]);
+      d->ptr += 3;
+      d->len -= 3;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xA0) {  // Set CREG[etc]; 4 byte color.
+      if (d->len < 4) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, d->ptr);
+      d->ptr += 4;
+      d->len -= 4;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xA8) {  // Set CREG[etc]; 3 byte (indirect) color.
+      if (d->len < 3) {
+        return iconvg_error_bad_color;
+      }
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      uint32_t q_blend = d->ptr[0];
+      uint8_t p_u = d->ptr[1];
+      uint8_t q_u = d->ptr[2];
+      if ((p_u < 0x80) && (q_u < 0x80)) {
+        const uint8_t* p = &iconvg_private_one_byte_colors[4 * ((size_t)p_u)];
+        const uint8_t* q = &iconvg_private_one_byte_colors[4 * ((size_t)q_u)];
+        uint32_t p_blend = 255 - q_blend;
+        uint8_t rgba[4];
+        rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+        rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+        rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+        rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+        iconvg_private_compiler__emit_set_creg_rgba(e, creg_index, &rgba[0]);
+      } else {
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND, creg_index, p_u,
+            q_u);
+        iconvg_private_compiler__emit_u32(e, q_blend);
+        uint8_t p[4];
+        uint8_t q[4];
+        uint64_t deps = iconvg_private_compiler__one_byte_color(e, &p[0], p_u) |
+                        iconvg_private_compiler__one_byte_color(e, &q[0], q_u);
+        uint32_t p_blend = 255 - q_blend;
+        uint8_t* rgba = &e->creg_values.colors[creg_index].rgba[0];
+        rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+        rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+        rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+        rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+        e->creg_deps[creg_index] = deps;
+      }
+      d->ptr += 3;
+      d->len -= 3;
+      sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xC0) {  // Set NREG[etc]; real, coordinate or 0-to-1.
+      uint8_t nreg_index = (sel[1] - adjustments[opcode & 0x07]) & 0x3F;
+      float num;
+      if (opcode < 0xB0) {
+        if (!iconvg_private_decoder__decode_real_number(d, &num)) {
+          return iconvg_error_bad_number;
+        }
+      } else if (opcode < 0xB8) {
+        if (!iconvg_private_decoder__decode_coordinate_number(d, &num)) {
+          return iconvg_error_bad_coordinate;
+        }
+      } else {
+        if (!iconvg_private_decoder__decode_zero_to_one_number(d, &num)) {
+          return iconvg_error_bad_number;
+        }
+      }
+      iconvg_private_compiler__emit_op(
+          e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG, nreg_index, 0, 0);
+      iconvg_private_compiler__emit_f32(e, num);
+      sel[1] += ((opcode & 0x07) == 0x07) ? 1 : 0;
+      continue;
+
+    } else if (opcode < 0xC7) {  // Switch to the drawing mode.
+      uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
+      if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+          !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
+        return iconvg_error_bad_coordinate;
+      }
+      uint64_t deps = iconvg_private_compiler__paint_deps(e, creg_index);
+      e->palette_mask |= deps;
+      iconvg_private_compiler__emit_op(
+          e, ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING, creg_index,
+          (deps != 0) ? 1 : 0, 0);
+      iconvg_private_compiler__emit_u32(e, 0);  // Patched by END_DRAWING.
+      e->skip_count_n = e->n;
+      iconvg_private_compiler__emit_f32(e, curr_x);
+      iconvg_private_compiler__emit_f32(e, curr_y);
+      // If the bounds are unknown, the drawing is invalid and compiling it
+      // will fail further on.
+      float bounds[4] = {-INFINITY, -INFINITY, +INFINITY, +INFINITY};
+      iconvg_private_decoder__drawing_bounds(d, &bounds[0], curr_x, curr_y);
+      for (int i = 0; i < 4; i++) {
+        iconvg_private_compiler__emit_f32(e, bounds[i]);
+      }
+      x1 = curr_x;
+      y1 = curr_y;
+      goto drawing_mode;
+
+    } else if (opcode < 0xC8) {  // Set Level of Detail bounds.
+      float lod0;
+      float lod1;
+      if (!iconvg_private_decoder__decode_real_number(d, &lod0) ||
+          !iconvg_private_decoder__decode_real_number(d, &lod1)) {
+        return iconvg_error_bad_number;
+      }
+      iconvg_private_compiler__emit_op(
+          e, ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD, 0, 0, 0);
+      iconvg_private_compiler__emit_f32(e, lod0);
+      iconvg_private_compiler__emit_f32(e, lod1);
+      e->lod[0] = lod0;
+      e->lod[1] = lod1;
+      continue;
+    }
+
+    return iconvg_error_bad_styling_opcode;
+  }
+
+drawing_mode:
+  while (true) {
+    if (d->len == 0) {
+      return iconvg_error_bad_path_unfinished;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    switch (opcode >> 4) {
+      case 0x00:
+      case 0x01:    // 'L' mnemonic: absolute line_to.
+      case 0x02:
+      case 0x03: {  // 'l' mnemonic: relative line_to.
+        bool relative = opcode >= 0x20;
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO, (opcode & 0x1F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x1F; reps >= 0; reps--) {
+          if (relative) {
+            if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+                !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+              return iconvg_error_bad_coordinate;
+            }
+            curr_x += x1;
+            curr_y += y1;
+          } else if (!iconvg_private_decoder__decode_coordinate_number(
+                         d, &curr_x) ||
+                     !iconvg_private_decoder__decode_coordinate_number(
+                         d, &curr_y)) {
+            return iconvg_error_bad_coordinate;
+          }
+          iconvg_private_compiler__emit_f32(e, curr_x);
+          iconvg_private_compiler__emit_f32(e, curr_y);
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+
+      case 0x04:    // 'T' mnemonic: absolute smooth quad_to.
+      case 0x05: {  // 't' mnemonic: relative smooth quad_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0x50) {
+            x2 += curr_x;
+            y2 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x06:    // 'Q' mnemonic: absolute quad_to.
+      case 0x07: {  // 'q' mnemonic: relative quad_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0x70) {
+            x1 += curr_x;
+            y1 += curr_y;
+            x2 += curr_x;
+            y2 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          curr_x = x2;
+          curr_y = y2;
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        }
+        continue;
+      }
+
+      case 0x08:    // 'S' mnemonic: absolute smooth cube_to.
+      case 0x09: {  // 's' mnemonic: relative smooth cube_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0x90) {
+            x2 += curr_x;
+            y2 += curr_y;
+            x3 += curr_x;
+            y3 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          iconvg_private_compiler__emit_f32(e, x3);
+          iconvg_private_compiler__emit_f32(e, y3);
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0A:    // 'C' mnemonic: absolute cube_to.
+      case 0x0B: {  // 'c' mnemonic: relative cube_to.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO, (opcode & 0x0F) + 1, 0,
+            0);
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0xB0) {
+            x1 += curr_x;
+            y1 += curr_y;
+            x2 += curr_x;
+            y2 += curr_y;
+            x3 += curr_x;
+            y3 += curr_y;
+          }
+          iconvg_private_compiler__emit_f32(e, x1);
+          iconvg_private_compiler__emit_f32(e, y1);
+          iconvg_private_compiler__emit_f32(e, x2);
+          iconvg_private_compiler__emit_f32(e, y2);
+          iconvg_private_compiler__emit_f32(e, x3);
+          iconvg_private_compiler__emit_f32(e, y3);
+          curr_x = x3;
+          curr_y = y3;
+          x1 = (2 * curr_x) - x2;
+          y1 = (2 * curr_y) - y2;
+        }
+        continue;
+      }
+
+      case 0x0C:    // 'A' mnemonic: absolute arc_to.
+      case 0x0D: {  // 'a' mnemonic: relative arc_to.
+        for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+          float x0 = curr_x;
+          float y0 = curr_y;
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
+              !iconvg_private_decoder__decode_zero_to_one_number(d, &x2) ||
+              !iconvg_private_decoder__decode_natural_number(d, &flags) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
+            return iconvg_error_bad_coordinate;
+          }
+          if (opcode >= 0xD0) {
+            curr_x += x3;
+            curr_y += y3;
+          } else {
+            curr_x = x3;
+            curr_y = y3;
+          }
+          double cubics[6 * ICONVG_PRIVATE_ARC_MAX_CUBICS];
+          bool is_line = false;
+          size_t n = iconvg_private_arc_to_cubics(
+              &cubics[0], &is_line, x0, y0, x1, y1, x2, flags & 0x01,
+              flags & 0x02, curr_x, curr_y);
+          if (is_line) {
+            iconvg_private_compiler__emit_op(
+                e, ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO, 1, 0, 0);
+            iconvg_private_compiler__emit_f32(e, curr_x);
+            iconvg_private_compiler__emit_f32(e, curr_y);
+          } else if (n > 0) {
+            iconvg_private_compiler__emit_op(
+                e, ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64, (uint32_t)n,
+                0, 0);
+            for (size_t i = 0; i < (6 * n); i++) {
+              iconvg_private_compiler__emit_f64(e, cubics[i]);
+            }
+          }
+          x1 = curr_x;
+          y1 = curr_y;
+        }
+        continue;
+      }
+    }
+
+    switch (opcode) {
+      case 0xE1: {  // 'z' mnemonic: close_path.
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING, 0, 0, 0);
+        iconvg_private_compiler__patch_u32(
+            e, e->skip_count_n - 4,
+            (uint32_t)((e->n - e->skip_count_n) / 4) - 6);
+        goto styling_mode;
+      }
+
+      case 0xE2:    // 'z; M' mnemonics: close_path; absolute move_to.
+      case 0xE3: {  // 'z; m' mnemonics: close_path; relative move_to.
+        if (opcode == 0xE3) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+              !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
+            return iconvg_error_bad_coordinate;
+          }
+          curr_x += x1;
+          curr_y += y1;
+        } else if (!iconvg_private_decoder__decode_coordinate_number(
+                       d, &curr_x) ||
+                   !iconvg_private_decoder__decode_coordinate_number(
+                       d, &curr_y)) {
+          return iconvg_error_bad_coordinate;
+        }
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO, 0, 0, 0);
+        iconvg_private_compiler__emit_f32(e, curr_x);
+        iconvg_private_compiler__emit_f32(e, curr_y);
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+
+      case 0xE6:    // 'H' mnemonic: absolute horizontal line_to.
+      case 0xE7:    // 'h' mnemonic: relative horizontal line_to.
+      case 0xE8:    // 'V' mnemonic: absolute vertical line_to.
+      case 0xE9: {  // 'v' mnemonic: relative vertical line_to.
+        float* dst = (opcode < 0xE8) ? &curr_x : &curr_y;
+        float* rel = (opcode < 0xE8) ? &x1 : &y1;
+        if (opcode & 0x01) {
+          if (!iconvg_private_decoder__decode_coordinate_number(d, rel)) {
+            return iconvg_error_bad_coordinate;
+          }
+          *dst += *rel;
+        } else if (!iconvg_private_decoder__decode_coordinate_number(d, dst)) {
+          return iconvg_error_bad_coordinate;
+        }
+        iconvg_private_compiler__emit_op(
+            e, ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO, 1, 0, 0);
+        iconvg_private_compiler__emit_f32(e, curr_x);
+        iconvg_private_compiler__emit_f32(e, curr_y);
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      }
+    }
+
+    return iconvg_error_bad_drawing_opcode;
+  }
+  return iconvg_private_internal_error_unreachable;
+}
+
+// iconvg_private_compiler__initialize sets up self to emit to dst_ptr[..
+// dst_len], which may be empty (e.g. when probing).
+static void  //
+iconvg_private_compiler__initialize(iconvg_private_compiler* self,
+                                    uint8_t* dst_ptr,
+                                    size_t dst_len,
+                                    iconvg_probe_results* probe) {
+  self->ptr = dst_ptr;
+  self->len = dst_ptr ? dst_len : 0;
+  self->n = 0;
+  self->skip_count_n = 0;
+  // CREG starts as a copy of the custom palette.
+  for (int i = 0; i < 64; i++) {
+    self->creg_deps[i] = ((uint64_t)1) << i;
+  }
+  memset(&self->creg_values, 0, sizeof(self->creg_values));
+  self->palette_mask = 0;
+  self->lod[0] = 0.0f;
+  self->lod[1] = INFINITY;
+  self->probe = probe;
+  self->probe_lod_segments = NULL;
+}
+
+const char*  //
+iconvg_compile(uint8_t* dst_ptr,
+               size_t dst_len,
+               size_t* dst_compiled_len,
+               const uint8_t* src_ptr,
+               size_t src_len) {
+  if (dst_compiled_len) {
+    *dst_compiled_len = 0;
+  }
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      &d, &viewbox, &suggested_palette));
+
+  iconvg_private_compiler e;
+  iconvg_private_compiler__initialize(&e, dst_ptr, dst_len, NULL);
+  iconvg_private_compiler__emit_u32(&e, ICONVG_PRIVATE_COMPILED_MAGIC);
+  iconvg_private_compiler__emit_f32(&e, viewbox.min_x);
+  iconvg_private_compiler__emit_f32(&e, viewbox.min_y);
+  iconvg_private_compiler__emit_f32(&e, viewbox.max_x);
+  iconvg_private_compiler__emit_f32(&e, viewbox.max_y);
+  for (int i = 0; i < 64; i++) {
+    iconvg_private_compiler__emit_u32(
+        &e, iconvg_private_peek_u32le(&suggested_palette.colors[i].rgba[0]));
+  }
+  iconvg_private_compiler__emit_u32(&e, 0);  // Patched below.
+  iconvg_private_compiler__emit_u32(&e, 0);  // Patched below.
+  ICONVG_PRIVATE_TRY(iconvg_private_compile_bytecode(&e, &d));
+  iconvg_private_compiler__patch_u32(&e, 4 * 69, (uint32_t)(e.palette_mask));
+  iconvg_private_compiler__patch_u32(&e, 4 * 70,
+                                     (uint32_t)(e.palette_mask >> 32));
+
+  if (dst_compiled_len) {
+    *dst_compiled_len = e.n;
+  }
+  if (e.n > e.len) {
+    return iconvg_error_system_failure_dst_buffer_too_short;
+  }
+  return NULL;
+}
+
+// ----
+
+static inline float  //
+iconvg_private_compiled_f32(const uint8_t* p, size_t i) {
+  return iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(p + (4 * i)));
+}
+
+// iconvg_private_compiled_f64 returns the i'th float64 (two words, low word
+// first) starting at p.
+static inline double  //
+iconvg_private_compiled_f64(const uint8_t* p, size_t i) {
+  uint64_t lo = iconvg_private_peek_u32le(p + (8 * i) + 0);
+  uint64_t hi = iconvg_private_peek_u32le(p + (8 * i) + 4);
+  return iconvg_private_reinterpret_from_u64_to_f64(lo | (hi << 32));
+}
+
+// iconvg_private_skip_compiled_drawing advances d past the rest of the
+// drawing whose BEGIN_DRAWING op's arguments are args.
+static const char*  //
+iconvg_private_skip_compiled_drawing(iconvg_private_decoder* d,
+                                     const uint8_t* args) {
+  size_t skip_count = iconvg_private_peek_u32le(args);
+  if ((skip_count == 0) || (skip_count > (d->len / 4)) ||
+      (iconvg_private_peek_u32le(d->ptr + (4 * (skip_count - 1))) !=
+       ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING)) {
+    return iconvg_error_bad_compiled_form;
+  }
+  d->ptr += 4 * skip_count;
+  d->len -= 4 * skip_count;
+  return NULL;
+}
+
+// iconvg_private_execute_compiled_template replays the compiled form to c.
+// If compositor is non-NULL then each drawing's geometry is skipped and its
+// paint is instead composited with the compositor's next coverage mask.
+//
+// Like iconvg_private_execute_bytecode_template, it is inlined into its
+// dispatcher once per value of specialized (see ICONVG_PRIVATE_SPECIALIZED).
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_execute_compiled_template(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 r,
+    iconvg_private_decoder* d,
+    const iconvg_decode_options* options,
+    iconvg_private_path_batch* batch,
+    iconvg_private_coverage_compositor* compositor,
+    bool specialized) {
+  if ((d->len < (4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS)) ||
+      ((d->len & 3) != 0) ||
+      (iconvg_private_peek_u32le(d->ptr) != ICONVG_PRIVATE_COMPILED_MAGIC)) {
+    return iconvg_error_bad_compiled_form;
+  }
+
+  iconvg_paint state;
+  state.viewbox.min_x = iconvg_private_compiled_f32(d->ptr, 1);
+  state.viewbox.min_y = iconvg_private_compiled_f32(d->ptr, 2);
+  state.viewbox.max_x = iconvg_private_compiled_f32(d->ptr, 3);
+  state.viewbox.max_y = iconvg_private_compiled_f32(d->ptr, 4);
+  memcpy(&state.custom_palette, d->ptr + (4 * 5),
+         sizeof(state.custom_palette));
+  d->ptr += 4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS;
+  d->len -= 4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS;
+
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, state.viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, &state.custom_palette));
+  iconvg_private_paint__initialize(&state, r, options);
+
+  bool drawing = false;
+
+  double scale_x = state.s2d_scale_x;
+  double bias_x = state.s2d_bias_x;
+  double scale_y = state.s2d_scale_y;
+  double bias_y = state.s2d_bias_y;
+
+  double lod[2];
+  lod[0] = 0.0;
+  lod[1] = INFINITY;
+
+  while (d->len > 0) {
+    uint32_t op = iconvg_private_peek_u32le(d->ptr);
+    uint32_t a = 0xFF & (op >> 8);
+    uint32_t b = 0xFF & (op >> 16);
+    uint32_t c3 = 0xFF & (op >> 24);
+    const uint8_t* args = d->ptr + 4;
+    size_t num_words = (d->len / 4) - 1;
+
+    size_t n = 0;
+    switch (op & 0xFF) {
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA:
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND:
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG:
+        n = 1;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD:
+      case ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO:
+        n = 2;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING:
+        n = 7;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO:
+        n = 2 * a;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO:
+        n = 4 * a;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO:
+        n = 6 * a;
+        break;
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64:
+        n = 12 * a;
+        break;
+    }
+    if (num_words < n) {
+      return iconvg_error_bad_compiled_form;
+    }
+    d->ptr += 4 * (1 + n);
+    d->len -= 4 * (1 + n);
+
+    switch (op & 0xFF) {
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_RGBA: {
+        memcpy(&state.creg.colors[a & 0x3F].rgba[0], args, 4);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_ONE_BYTE: {
+        iconvg_private_set_one_byte_color(&state.creg.colors[a & 0x3F].rgba[0],
+                                          &state.custom_palette, &state.creg,
+                                          (uint8_t)b);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_CREG_BLEND: {
+        uint8_t* rgba = &state.creg.colors[a & 0x3F].rgba[0];
+        uint8_t p[4] = {0};
+        uint8_t q[4] = {0};
+        iconvg_private_set_one_byte_color(&p[0], &state.custom_palette,
+                                          &state.creg, (uint8_t)b);
+        iconvg_private_set_one_byte_color(&q[0], &state.custom_palette,
+                                          &state.creg, (uint8_t)c3);
+        uint32_t q_blend = 0xFF & iconvg_private_peek_u32le(args);
+        uint32_t p_blend = 255 - q_blend;
+        rgba[0] = (uint8_t)(((p_blend * p[0]) + (q_blend * q[0]) + 128) / 255);
+        rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
+        rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
+        rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_NREG: {
+        state.nreg[a & 0x3F] = iconvg_private_compiled_f32(args, 0);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__SET_LOD: {
+        lod[0] = (double)iconvg_private_compiled_f32(args, 0);
+        lod[1] = (double)iconvg_private_compiled_f32(args, 1);
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__BEGIN_DRAWING: {
+        if (drawing) {
+          break;
+        } else if (iconvg_private_paint__is_cancelled(&state)) {
+          return iconvg_note_cancelled;
+        }
+        memcpy(&state.paint_rgba, &state.creg.colors[a & 0x3F],
+               sizeof(state.paint_rgba));
+        if (iconvg_paint__type(&state) == ICONVG_PAINT_TYPE__INVALID) {
+          return iconvg_error_invalid_paint_type;
+        }
+        double h = (double)state.height_in_pixels;
+        if (!((lod[0] <= h) && (h < lod[1]))) {
+          // Skip this drawing, which is outside the Level of Detail bounds.
+          ICONVG_PRIVATE_TRY(iconvg_private_skip_compiled_drawing(d, args));
+          continue;
+        }
+
+        // Cull this drawing if it would not change any pixels: it is outside
+        // of the clip rectangle or its paint is transparent for every
+        // palette. Like iconvg_decode, only cull by bounds when the options
+        // have a clip_rect, so that both make the same canvas calls. A
+        // recording (mask producing) canvas sees on_skipped_drawing
+        // and a compositor skips the corresponding mask, so that either side
+        // can cull what the other did not.
+        float bounds[4];
+        for (int i = 0; i < 4; i++) {
+          bounds[i] = iconvg_private_compiled_f32(args, 3 + i);
+        }
+        bool culled =
+            (state.has_clip &&
+             iconvg_private_paint__culls(&state, &bounds[0])) ||
+            ((b == 0) && iconvg_private_paint__is_transparent(&state));
+        if (compositor) {
+          ICONVG_PRIVATE_TRY(iconvg_private_coverage_compositor__composite(
+              compositor, culled ? NULL : &state));
+          ICONVG_PRIVATE_TRY(iconvg_private_skip_compiled_drawing(d, args));
+          continue;
+        } else if (culled) {
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__on_skipped_drawing(c));
+          ICONVG_PRIVATE_TRY(iconvg_private_skip_compiled_drawing(d, args));
+          continue;
+        }
+        drawing = true;
+        float x0 = iconvg_private_compiled_f32(args, 1);
+        float y0 = iconvg_private_compiled_f32(args, 2);
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_canvas__begin_drawing(c, specialized));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,           //
+            (x0 * scale_x) + bias_x,  //
+            (y0 * scale_y) + bias_y));
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__MOVE_TO: {
+        if (!drawing) {
+          break;
+        }
+        float x0 = iconvg_private_compiled_f32(args, 0);
+        float y0 = iconvg_private_compiled_f32(args, 1);
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,           //
+            (x0 * scale_x) + bias_x,  //
+            (y0 * scale_y) + bias_y));
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__LINE_TO: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 4 * 2) {
+          float x1 = iconvg_private_compiled_f32(args, 0);
+          float y1 = iconvg_private_compiled_f32(args, 1);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__QUAD_TO: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 4 * 4) {
+          float x1 = iconvg_private_compiled_f32(args, 0);
+          float y1 = iconvg_private_compiled_f32(args, 1);
+          float x2 = iconvg_private_compiled_f32(args, 2);
+          float y2 = iconvg_private_compiled_f32(args, 3);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 4 * 6) {
+          float x1 = iconvg_private_compiled_f32(args, 0);
+          float y1 = iconvg_private_compiled_f32(args, 1);
+          float x2 = iconvg_private_compiled_f32(args, 2);
+          float y2 = iconvg_private_compiled_f32(args, 3);
+          float x3 = iconvg_private_compiled_f32(args, 4);
+          float y3 = iconvg_private_compiled_f32(args, 5);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__CUBE_TO_F64: {
+        if (!drawing) {
+          break;
+        }
+        for (; a > 0; a--, args += 8 * 6) {
+          double x1 = iconvg_private_compiled_f64(args, 0);
+          double y1 = iconvg_private_compiled_f64(args, 1);
+          double x2 = iconvg_private_compiled_f64(args, 2);
+          double y2 = iconvg_private_compiled_f64(args, 3);
+          double x3 = iconvg_private_compiled_f64(args, 4);
+          double y3 = iconvg_private_compiled_f64(args, 5);
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
+        }
+        continue;
+      }
+
+      case ICONVG_PRIVATE_COMPILED_OPCODE__END_DRAWING: {
+        if (!drawing) {
+          break;
+        }
+        drawing = false;
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_canvas__end_drawing(c, specialized, &state));
+        continue;
+      }
+    }
+
+    return iconvg_error_bad_compiled_form;
+  }
+
+  return drawing ? iconvg_error_bad_compiled_form : NULL;
+}
+
+static const char*  //
+iconvg_private_execute_compiled(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 r,
+    iconvg_private_decoder* d,
+    const iconvg_decode_options* options,
+    iconvg_private_path_batch* batch,
+    iconvg_private_coverage_compositor* compositor) {
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+  if (!compositor && iconvg_private_canvas_is_specialized(c)) {
+    return iconvg_private_execute_compiled_template(c, r, d, options, batch,
+                                                    NULL, true);
+  }
+#endif
+  return iconvg_private_execute_compiled_template(c, r, d, options, batch,
+                                                  compositor, false);
+}
+
+const char*  //
+iconvg_probe(iconvg_probe_results* dst,
+             const uint8_t* src_ptr,
+             size_t src_len,
+             bool scan_bytecode) {
+  if (!dst) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(dst, 0, sizeof(*dst));
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      &d, &dst->viewbox, &dst->suggested_palette));
+  dst->bytecode_offset = src_len - d.len;
+  if (!scan_bytecode) {
+    return NULL;
+  }
+
+  // Compiling to an empty buffer emits nothing but still walks every op.
+  iconvg_private_compiler e;
+  iconvg_private_compiler__initialize(&e, NULL, 0, dst);
+  return iconvg_private_compile_bytecode(&e, &d);
+}
+
+const char*  //
+iconvg_decode_compiled(iconvg_canvas* dst_canvas,
+                       iconvg_rectangle_f32 dst_rect,
+                       const uint8_t* compiled_ptr,
+                       size_t compiled_len,
+                       const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+
+  if (!iconvg_private_canvas_vtable_is_supported(dst_canvas)) {
+    return iconvg_error_unsupported_vtable;
+  }
+  iconvg_canvas transform_canvas;
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    transform_canvas =
+        iconvg_private_canvas__make_transform(dst_canvas, transform);
+    dst_canvas = &transform_canvas;
+  }
+
+  iconvg_private_decoder d;
+  d.ptr = compiled_ptr;
+  d.len = compiled_len;
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    iconvg_private_path_batch batch;
+    iconvg_private_path_batch__initialize(&batch, dst_canvas);
+    err_msg = iconvg_private_execute_compiled(dst_canvas, dst_rect, &d,
+                                              options, &batch, NULL);
+    const char* flush_err_msg =
+        iconvg_private_path_batch__flush(&batch, dst_canvas);
+    if (flush_err_msg) {
+      err_msg = flush_err_msg;
+    }
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg,
+                                           compiled_len - d.len, d.len);
+}
+
+const char*  //
+iconvg_private_decode_compiled_header(iconvg_palette* dst_suggested_palette,
+                                      uint64_t* dst_palette_mask,
+                                      const uint8_t* compiled_ptr,
+                                      size_t compiled_len) {
+  if (!compiled_ptr ||
+      (compiled_len < (4 * ICONVG_PRIVATE_COMPILED_HEADER_NUM_WORDS)) ||
+      ((compiled_len & 3) != 0) ||
+      (iconvg_private_peek_u32le(compiled_ptr) !=
+       ICONVG_PRIVATE_COMPILED_MAGIC)) {
+    return iconvg_error_bad_compiled_form;
+  }
+  if (dst_suggested_palette) {
+    memcpy(dst_suggested_palette, compiled_ptr + (4 * 5),
+           sizeof(*dst_suggested_palette));
+  }
+  if (dst_palette_mask) {
+    uint64_t lo = iconvg_private_peek_u32le(compiled_ptr + (4 * 69));
+    uint64_t hi = iconvg_private_peek_u32le(compiled_ptr + (4 * 70));
+    *dst_palette_mask = lo | (hi << 32);
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_compiled_palette_dependencies(uint64_t* dst_mask,
+                                     const uint8_t* compiled_ptr,
+                                     size_t compiled_len) {
+  if (dst_mask) {
+    *dst_mask = 0;
+  }
+  return iconvg_private_decode_compiled_header(NULL, dst_mask, compiled_ptr,
+                                               compiled_len);
+}
+
+const char*  //
+iconvg_coverage_masks__composite(const iconvg_coverage_masks* self,
+                                 uint8_t* pixels_ptr,
+                                 size_t pixels_stride,
+                                 uint32_t pixels_width,
+                                 uint32_t pixels_height,
+                                 iconvg_rectangle_f32 dst_rect,
+                                 const uint8_t* compiled_ptr,
+                                 size_t compiled_len,
+                                 const iconvg_decode_options* options) {
+  // With a transform, the masks were recorded by a rasterizer canvas wrapped
+  // in a transform canvas, which saw the transformed dst_rect's bounds.
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  iconvg_private_coverage_compositor compositor;
+  ICONVG_PRIVATE_TRY(iconvg_private_coverage_compositor__initialize(
+      &compositor, self, pixels_ptr, pixels_stride, pixels_width,
+      pixels_height,
+      transform ? iconvg_private_matrix_2x3_f64__transform_bounds(transform,
+                                                                  dst_rect)
+                : dst_rect));
+
+  // No geometry reaches the canvas, so a broken (no-op) one will do.
+  iconvg_canvas c = iconvg_canvas__make_broken(NULL);
+  iconvg_private_decoder d;
+  d.ptr = compiled_ptr;
+  d.len = compiled_len;
+  iconvg_private_path_batch batch;
+  iconvg_private_path_batch__initialize(&batch, &c);
+  ICONVG_PRIVATE_TRY(iconvg_private_execute_compiled(
+      &c, dst_rect, &d, options, &batch, &compositor));
+  return iconvg_private_coverage_compositor__finish(&compositor);
+}
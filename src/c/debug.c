@@ -27,7 +27,7 @@ iconvg_private_debug_canvas__begin_decode(iconvg_canvas* c,
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
@@ -50,7 +50,7 @@ iconvg_private_debug_canvas__end_decode(iconvg_canvas* c,
   if (!wrapped) {
     return err_msg;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
@@ -67,7 +67,7 @@ iconvg_private_debug_canvas__begin_drawing(iconvg_canvas* c) {
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->begin_drawing)(wrapped);
@@ -117,7 +117,7 @@ iconvg_private_debug_canvas__end_drawing(iconvg_canvas* c,
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->end_drawing)(wrapped, p);
@@ -134,7 +134,7 @@ iconvg_private_debug_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
@@ -150,7 +150,7 @@ iconvg_private_debug_canvas__end_path(iconvg_canvas* c) {
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->end_path)(wrapped);
@@ -169,7 +169,7 @@ iconvg_private_debug_canvas__path_line_to(iconvg_canvas* c,
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
@@ -190,7 +190,7 @@ iconvg_private_debug_canvas__path_quad_to(iconvg_canvas* c,
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
@@ -213,7 +213,7 @@ iconvg_private_debug_canvas__path_cube_to(iconvg_canvas* c,
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
@@ -232,7 +232,7 @@ iconvg_private_debug_canvas__on_metadata_viewbox(iconvg_canvas* c,
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
@@ -270,13 +270,73 @@ iconvg_private_debug_canvas__on_metadata_suggested_palette(
   if (!wrapped) {
     return NULL;
   } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
     return iconvg_error_unsupported_vtable;
   }
   return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
                                                            suggested_palette);
 }
 
+static const char*  //
+iconvg_private_debug_canvas__path_segments(iconvg_canvas* c,
+                                           const uint8_t* verbs,
+                                           size_t num_verbs,
+                                           const float* points) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    // Log each segment the same way as the per-segment methods do, so that
+    // the log doesn't depend on whether the decoder batched its calls.
+    const char* prefix = (const char*)(c->context.const_ptr3);
+    const float* p = points;
+    for (size_t i = 0; i < num_verbs; i++) {
+      switch (verbs[i]) {
+        case ICONVG_PATH_VERB__LINE_TO:
+          fprintf(f, "%spath_line_to(%g, %g)\n", prefix, p[0], p[1]);
+          p += 2;
+          break;
+        case ICONVG_PATH_VERB__QUAD_TO:
+          fprintf(f, "%spath_quad_to(%g, %g, %g, %g)\n", prefix, p[0], p[1],
+                  p[2], p[3]);
+          p += 4;
+          break;
+        case ICONVG_PATH_VERB__CUBE_TO:
+          fprintf(f, "%spath_cube_to(%g, %g, %g, %g, %g, %g)\n", prefix, p[0],
+                  p[1], p[2], p[3], p[4], p[5]);
+          p += 6;
+          break;
+        default:
+          return iconvg_error_invalid_path_verb;
+      }
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return iconvg_private_canvas__path_segments(wrapped, verbs, num_verbs,
+                                              points);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%son_skipped_drawing()\n",
+            ((const char*)(c->context.const_ptr3)));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  return iconvg_private_canvas__on_skipped_drawing(wrapped);
+}
+
 static const iconvg_canvas_vtable  //
     iconvg_private_debug_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
@@ -291,6 +351,8 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_debug_canvas__path_cube_to,
         &iconvg_private_debug_canvas__on_metadata_viewbox,
         &iconvg_private_debug_canvas__on_metadata_suggested_palette,
+        &iconvg_private_debug_canvas__path_segments,
+        &iconvg_private_debug_canvas__on_skipped_drawing,
 };
 
 iconvg_canvas  //
@@ -46,141 +46,6 @@ iconvg_private_decoder__skip_to_the_end(iconvg_private_decoder* self) {
 
 // ----
 
-static bool  //
-iconvg_private_decoder__decode_coordinate_number(iconvg_private_decoder* self,
-                                                 float* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      int32_t i = (int32_t)(v >> 1);
-      *dst = ((float)(i - 64));
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
-
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
-        *dst = ((float)(i - (128 * 64))) / 64.0f;
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
-
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        // TODO: reject NaNs?
-        *dst = iconvg_private_reinterpret_from_u32_to_f32(
-            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
-static bool  //
-iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
-                                              uint32_t* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      *dst = v >> 1;
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
-
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
-
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
-static bool  //
-iconvg_private_decoder__decode_real_number(iconvg_private_decoder* self,
-                                           float* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      *dst = (float)(v >> 1);
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
-
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        *dst = (float)(iconvg_private_peek_u16le(self->ptr) >> 2);
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
-
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        // TODO: reject NaNs?
-        *dst = iconvg_private_reinterpret_from_u32_to_f32(
-            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
-static bool  //
-iconvg_private_decoder__decode_zero_to_one_number(iconvg_private_decoder* self,
-                                                  float* dst) {
-  if (self->len >= 1) {
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) == 0) {  // 1-byte encoding.
-      *dst = (float)(((double)(v >> 1)) / 120.0);
-      self->ptr += 1;
-      self->len -= 1;
-      return true;
-
-    } else if ((v & 0x02) == 0) {  // 2-byte encoding.
-      if (self->len >= 2) {
-        *dst = (float)(((double)(iconvg_private_peek_u16le(self->ptr) >> 2)) /
-                       15120.0);
-        self->ptr += 2;
-        self->len -= 2;
-        return true;
-      }
-
-    } else {  // 4-byte encoding.
-      if (self->len >= 4) {
-        // TODO: reject NaNs?
-        *dst = iconvg_private_reinterpret_from_u32_to_f32(
-            0xFFFFFFFCu & iconvg_private_peek_u32le(self->ptr));
-        self->ptr += 4;
-        self->len -= 4;
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
-// ----
-
 static bool  //
 iconvg_private_decoder__decode_magic_identifier(iconvg_private_decoder* self) {
   if ((self->len < 4) ||         //
@@ -281,64 +146,474 @@ iconvg_private_decoder__decode_metadata_suggested_palette(
 
 // ----
 
+// iconvg_private_decoder__skip_numbers skips over n numbers. All of the IconVG
+// number encodings (natural, real, coordinate and zero-to-one) use the low two
+// bits of the first byte to give the encoded length, so skipping does not
+// depend on what kind of number is skipped.
+//
+// Like iconvg_private_decoder__decode_coordinate_numbers, when self holds at
+// least 4 * n bytes the bounds are checked once, up front. Each length is then
+// computed without branches or a table load, as the loop is one long chain of
+// dependent loads: 1, 2, 1 or 4 bytes when the low 2 bits are 0, 1, 2 or 3.
+static inline bool  //
+iconvg_private_decoder__skip_numbers(iconvg_private_decoder* self, int n) {
+  if ((self->len / 4) >= (size_t)n) {
+    const uint8_t* p = self->ptr;
+    for (; n > 0; n--) {
+      uint8_t v = p[0];
+      if ((v & 0x01) == 0) {
+        p += 1;
+      } else if ((v & 0x02) == 0) {
+        p += 2;
+      } else {
+        p += 4;
+      }
+    }
+    self->len -= (size_t)(p - self->ptr);
+    self->ptr = p;
+    return true;
+  }
+
+  for (; n > 0; n--) {
+    if (self->len < 1) {
+      return false;
+    }
+    uint8_t v = self->ptr[0];
+    size_t num_bytes = ((v & 0x01) == 0) ? 1 : ((v & 0x02) == 0) ? 2 : 4;
+    if (self->len < num_bytes) {
+      return false;
+    }
+    self->ptr += num_bytes;
+    self->len -= num_bytes;
+  }
+  return true;
+}
+
+// iconvg_private_drawing_numbers_per_rep is the number of numbers per
+// repetition, indexed by the high nibble of a 0x00 ..= 0xDF drawing opcode.
+static const uint8_t iconvg_private_drawing_numbers_per_rep[14] = {
+    2, 2, 2, 2,  // 'L', 'l'.
+    2, 2,        // 'T', 't'.
+    4, 4,        // 'Q', 'q'.
+    4, 4,        // 'S', 's'.
+    6, 6,        // 'C', 'c'.
+    6, 6,        // 'A', 'a'.
+};
+
+// iconvg_private_decoder__skip_drawing skips over the drawing mode opcodes up
+// to and including the next 'z' (close_path) opcode, without decoding their
+// numbers' values. It returns the same errors (and leaves self at the same
+// position on error) as iconvg_private_execute_bytecode would for a drawing
+// that is painted to a no-op canvas.
 static const char*  //
-iconvg_private_execute_bytecode(iconvg_canvas* c_arg,
-                                iconvg_rectangle_f32 r,
-                                iconvg_private_decoder* d,
-                                iconvg_paint* state) {
+iconvg_private_decoder__skip_drawing(iconvg_private_decoder* self) {
+  while (true) {
+    if (self->len == 0) {
+      return iconvg_error_bad_path_unfinished;
+    }
+    uint8_t opcode = self->ptr[0];
+    self->ptr += 1;
+    self->len -= 1;
+
+    int n = 0;
+    if (opcode < 0x40) {
+      n = 2 * (1 + (opcode & 0x1F));
+    } else if (opcode < 0xE0) {
+      n = iconvg_private_drawing_numbers_per_rep[opcode >> 4] *
+          (1 + (opcode & 0x0F));
+    } else if (opcode == 0xE1) {
+      return NULL;
+    } else if ((opcode == 0xE2) || (opcode == 0xE3)) {
+      n = 2;
+    } else if ((0xE6 <= opcode) && (opcode <= 0xE9)) {
+      n = 1;
+    } else {
+      return iconvg_error_bad_drawing_opcode;
+    }
+
+    if (!iconvg_private_decoder__skip_numbers(self, n)) {
+      return iconvg_error_bad_coordinate;
+    }
+  }
+}
+
+static inline void  //
+iconvg_private_bounds__extend(float* b, float x, float y) {
+  b[0] = (b[0] < x) ? b[0] : x;
+  b[1] = (b[1] < y) ? b[1] : y;
+  b[2] = (b[2] > x) ? b[2] : x;
+  b[3] = (b[3] > y) ? b[3] : y;
+}
+
+bool  //
+iconvg_private_decoder__drawing_bounds(const iconvg_private_decoder* self,
+                                       float* dst,
+                                       float x0,
+                                       float y0) {
+  iconvg_private_decoder d = *self;
+  float b[4] = {x0, y0, x0, y0};
+  float curr_x = x0;
+  float curr_y = y0;
+  // (x1, y1) is the implicit control point of a subsequent smooth op, as
+  // tracked by iconvg_private_execute_bytecode.
+  float x1 = x0;
+  float y1 = y0;
+  float coords[96];
+
+  while (true) {
+    if (d.len == 0) {
+      return false;
+    }
+    uint8_t opcode = d.ptr[0];
+    d.ptr += 1;
+    d.len -= 1;
+
+    if (opcode < 0xC0) {  // 'L', 'l', 'T', 't', 'Q', 'q', 'S', 's', 'C', 'c'.
+      size_t num_reps = (opcode < 0x40) ? (1 + (size_t)(opcode & 0x1F))
+                                        : (1 + (size_t)(opcode & 0x0F));
+      size_t num_coords =
+          iconvg_private_drawing_numbers_per_rep[opcode >> 4] * num_reps;
+      size_t num_points = num_coords / num_reps / 2;
+      bool relative = (opcode < 0x40) ? (opcode & 0x20) : (opcode & 0x10);
+      bool smooth = ((opcode >> 5) == 2) || ((opcode >> 5) == 4);
+      if (iconvg_private_decoder__decode_coordinate_numbers(
+              &d, &coords[0], num_coords) < num_coords) {
+        return false;
+      }
+      float* p = &coords[0];
+      for (size_t i = 0; i < num_reps; i++, p += 2 * num_points) {
+        if (relative) {
+          for (size_t j = 0; j < num_points; j++) {
+            p[(2 * j) + 0] += curr_x;
+            p[(2 * j) + 1] += curr_y;
+          }
+        }
+        if (smooth) {
+          iconvg_private_bounds__extend(b, x1, y1);
+        }
+        for (size_t j = 0; j < num_points; j++) {
+          iconvg_private_bounds__extend(b, p[(2 * j) + 0], p[(2 * j) + 1]);
+        }
+        curr_x = p[(2 * num_points) - 2];
+        curr_y = p[(2 * num_points) - 1];
+        if (opcode < 0x40) {
+          x1 = curr_x;
+          y1 = curr_y;
+        } else if (num_points == 1) {
+          x1 = (2 * curr_x) - x1;
+          y1 = (2 * curr_y) - y1;
+        } else {
+          x1 = (2 * curr_x) - p[(2 * num_points) - 4];
+          y1 = (2 * curr_y) - p[(2 * num_points) - 3];
+        }
+      }
+      continue;
+
+    } else if (opcode < 0xE0) {  // 'A', 'a'.
+      for (int reps = opcode & 0x0F; reps >= 0; reps--) {
+        float rx;
+        float ry;
+        float rotation;
+        uint32_t flags;
+        float x;
+        float y;
+        if (!iconvg_private_decoder__decode_coordinate_number(&d, &rx) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &ry) ||
+            !iconvg_private_decoder__decode_zero_to_one_number(&d, &rotation) ||
+            !iconvg_private_decoder__decode_natural_number(&d, &flags) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &x) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &y)) {
+          return false;
+        }
+        if (opcode >= 0xD0) {
+          x += curr_x;
+          y += curr_y;
+        }
+        double cubics[6 * ICONVG_PRIVATE_ARC_MAX_CUBICS];
+        bool is_line = false;
+        size_t n = iconvg_private_arc_to_cubics(&cubics[0], &is_line, curr_x,
+                                                curr_y, rx, ry, rotation,
+                                                flags & 0x01, flags & 0x02, x,
+                                                y);
+        for (size_t i = 0; i < (6 * n); i += 2) {
+          iconvg_private_bounds__extend(b, (float)cubics[i + 0],
+                                        (float)cubics[i + 1]);
+        }
+        iconvg_private_bounds__extend(b, x, y);
+        curr_x = x;
+        curr_y = y;
+        x1 = curr_x;
+        y1 = curr_y;
+      }
+      continue;
+    }
+
+    float* dst_coord = NULL;
+    bool relative = false;
+    switch (opcode) {
+      case 0xE1:  // 'z' mnemonic: close_path.
+        memcpy(dst, &b[0], sizeof(b));
+        return true;
+      case 0xE2:  // 'z; M' mnemonics: close_path; absolute move_to.
+      case 0xE3:  // 'z; m' mnemonics: close_path; relative move_to.
+        if (!iconvg_private_decoder__decode_coordinate_number(&d, &x1) ||
+            !iconvg_private_decoder__decode_coordinate_number(&d, &y1)) {
+          return false;
+        }
+        curr_x = (opcode == 0xE3) ? (curr_x + x1) : x1;
+        curr_y = (opcode == 0xE3) ? (curr_y + y1) : y1;
+        iconvg_private_bounds__extend(b, curr_x, curr_y);
+        x1 = curr_x;
+        y1 = curr_y;
+        continue;
+      case 0xE6:  // 'H' mnemonic: absolute horizontal line_to.
+      case 0xE7:  // 'h' mnemonic: relative horizontal line_to.
+        dst_coord = &curr_x;
+        relative = opcode == 0xE7;
+        break;
+      case 0xE8:  // 'V' mnemonic: absolute vertical line_to.
+      case 0xE9:  // 'v' mnemonic: relative vertical line_to.
+        dst_coord = &curr_y;
+        relative = opcode == 0xE9;
+        break;
+      default:
+        return false;
+    }
+    float v;
+    if (!iconvg_private_decoder__decode_coordinate_number(&d, &v)) {
+      return false;
+    }
+    *dst_coord = relative ? (*dst_coord + v) : v;
+    iconvg_private_bounds__extend(b, curr_x, curr_y);
+    x1 = curr_x;
+    y1 = curr_y;
+  }
+}
+
+// iconvg_private_decoder__complete_ops_len returns the length of the longest
+// prefix of self's bytes that holds only complete ops (opcodes and all of
+// their arguments), starting in the drawing mode if drawing is true. Invalid
+// opcodes count as complete, one byte ops: executing them fails no matter
+// what bytes follow.
+static size_t  //
+iconvg_private_decoder__complete_ops_len(const iconvg_private_decoder* self,
+                                         bool drawing) {
+  // color_lens is the number of bytes after a 0x80 ..= 0xA7 styling opcode,
+  // indexed by ((opcode - 0x80) >> 3).
+  static const uint8_t color_lens[5] = {1, 2, 3, 4, 3};
+
+  iconvg_private_decoder d = *self;
+  const uint8_t* end_of_complete_ops = d.ptr;
+  while (d.len > 0) {
+    uint8_t opcode = d.ptr[0];
+    d.ptr += 1;
+    d.len -= 1;
+
+    size_t num_bytes = 0;
+    int num_numbers = 0;
+    if (!drawing) {
+      if (opcode < 0x80) {
+        // No-op.
+      } else if (opcode < 0xA8) {
+        num_bytes = color_lens[(opcode - 0x80) >> 3];
+      } else if (opcode < 0xC0) {
+        num_numbers = 1;
+      } else if (opcode < 0xC7) {
+        num_numbers = 2;
+        drawing = true;
+      } else if (opcode == 0xC7) {
+        num_numbers = 2;
+      }
+    } else if (opcode < 0x40) {
+      num_numbers = 2 * (1 + (opcode & 0x1F));
+    } else if (opcode < 0xE0) {
+      num_numbers = iconvg_private_drawing_numbers_per_rep[opcode >> 4] *
+                    (1 + (opcode & 0x0F));
+    } else if (opcode == 0xE1) {
+      drawing = false;
+    } else if ((opcode == 0xE2) || (opcode == 0xE3)) {
+      num_numbers = 2;
+    } else if ((0xE6 <= opcode) && (opcode <= 0xE9)) {
+      num_numbers = 1;
+    }
+
+    if (d.len < num_bytes) {
+      break;
+    }
+    d.ptr += num_bytes;
+    d.len -= num_bytes;
+    if (!iconvg_private_decoder__skip_numbers(&d, num_numbers)) {
+      break;
+    }
+    end_of_complete_ops = d.ptr;
+  }
+  return (size_t)(end_of_complete_ops - self->ptr);
+}
+
+// iconvg_private_decoder__complete_metadata_len returns the length of the
+// magic identifier and metadata at the start of self's bytes, or zero if they
+// are incomplete. If the available bytes are already invalid, it returns
+// self->len, so that decoding them reports the error.
+static size_t  //
+iconvg_private_decoder__complete_metadata_len(
+    const iconvg_private_decoder* self) {
+  static const uint8_t magic[4] = {0x89, 0x49, 0x56, 0x47};
+  size_t n = (self->len < 4) ? self->len : 4;
+  if (n == 0) {
+    return 0;
+  } else if (memcmp(self->ptr, magic, n) != 0) {
+    return self->len;
+  } else if (n < 4) {
+    return 0;
+  }
+
+  iconvg_private_decoder d = *self;
+  d.ptr += 4;
+  d.len -= 4;
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                     &num_metadata_chunks)) {
+    return 0;
+  }
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
+        (chunk_length > d.len)) {
+      return 0;
+    }
+    d.ptr += chunk_length;
+    d.len -= chunk_length;
+  }
+  return (size_t)(d.ptr - self->ptr);
+}
+
+// ----
+
+void  //
+iconvg_private_bytecode_registers__initialize(
+    iconvg_private_bytecode_registers* self) {
+  self->mode = ICONVG_PRIVATE_BYTECODE_MODE__STYLING;
+  self->sel[0] = 0;
+  self->sel[1] = 0;
+  self->lod[0] = 0.0;
+  self->lod[1] = INFINITY;
+  self->curr_x = +0.0f;
+  self->curr_y = +0.0f;
+  self->x1 = +0.0f;
+  self->y1 = +0.0f;
+}
+
+// iconvg_private_one_byte_color_palette_dep returns 1 if the one byte color u
+// derives from the custom palette and 0 otherwise.
+static inline uint64_t  //
+iconvg_private_one_byte_color_palette_dep(const iconvg_paint* state,
+                                          uint8_t u) {
+  if (u < 0x80) {
+    return 0;
+  } else if (u < 0xC0) {
+    return 1;
+  }
+  return 1 & (state->creg_palette_deps >> (u & 0x3F));
+}
+
+static inline void  //
+iconvg_private_paint__set_creg_palette_dep(iconvg_paint* self,
+                                           uint32_t creg_index,
+                                           uint64_t dep) {
+  self->creg_palette_deps =
+      (self->creg_palette_deps & ~(((uint64_t)1) << creg_index)) |
+      (dep << creg_index);
+}
+
+// iconvg_private_paint__is_always_transparent returns whether self's paint,
+// copied from CREG[creg_index], is transparent whatever the custom palette.
+static bool  //
+iconvg_private_paint__is_always_transparent(const iconvg_paint* self,
+                                            uint32_t creg_index) {
+  uint64_t deps = self->creg_palette_deps;
+  if ((self->paint_rgba[3] != 0x00) || (1 & (deps >> creg_index)) ||
+      !iconvg_private_paint__is_transparent(self)) {
+    return false;
+  } else if (iconvg_paint__type(self) == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    return true;
+  }
+  uint32_t cbase = self->paint_rgba[1];
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(self);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    if (1 & (deps >> (0x3F & (cbase + i)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// iconvg_private_execute_bytecode_template executes the ops in d, starting
+// from (and, when it returns NULL, updating) the regs state.
+//
+// If final is true then d holds the rest of the IconVG data, so running out
+// of ops in the middle of a drawing is an error. Otherwise, d must end at an
+// op boundary and running out of ops is a suspension (returning NULL), to be
+// resumed by another call with the same regs.
+//
+// It is inlined into iconvg_private_execute_bytecode, below, once per value
+// of specialized (see ICONVG_PRIVATE_SPECIALIZED).
+static ICONVG_PRIVATE_ALWAYS_INLINE const char*  //
+iconvg_private_execute_bytecode_template(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 r,
+    iconvg_private_decoder* d,
+    iconvg_paint* state,
+    iconvg_private_path_batch* batch,
+    iconvg_private_bytecode_registers* regs,
+    bool final,
+    bool specialized) {
   // adjustments are the ADJ values from the IconVG spec.
   static const uint32_t adjustments[8] = {0, 1, 2, 3, 4, 5, 6, 0};
 
-  iconvg_canvas no_op_canvas = iconvg_canvas__make_broken(NULL);
-  iconvg_canvas* c = &no_op_canvas;
-
   // Drawing ops will typically set curr_x and curr_y. They also set x1 and y1
   // in case the subsequent op is smooth and needs an implicit point.
-  float curr_x = +0.0f;
-  float curr_y = +0.0f;
-  float x1 = +0.0f;
-  float y1 = +0.0f;
+  //
+  // The registers are copied to and from regs only on entry and suspension,
+  // so that the compiler can keep them in local variables.
+  float curr_x = regs->curr_x;
+  float curr_y = regs->curr_y;
+  float x1 = regs->x1;
+  float y1 = regs->y1;
   float x2 = +0.0f;
   float y2 = +0.0f;
   float x3 = +0.0f;
   float y3 = +0.0f;
   uint32_t flags = 0;
+  const char* skip_err_msg = NULL;
 
-  double scale_x = +1.0;
-  double bias_x = +0.0;
-  double scale_y = +1.0;
-  double bias_y = +0.0;
-  {
-    double rw = iconvg_rectangle_f32__width_f64(&r);
-    double rh = iconvg_rectangle_f32__height_f64(&r);
-    double vw = iconvg_rectangle_f32__width_f64(&state->viewbox);
-    double vh = iconvg_rectangle_f32__height_f64(&state->viewbox);
-    if ((rw > 0) && (rh > 0) && (vw > 0) && (vh > 0)) {
-      scale_x = rw / vw;
-      scale_y = rh / vh;
-      bias_x = r.min_x - (state->viewbox.min_x * scale_x);
-      bias_y = r.min_y - (state->viewbox.min_y * scale_y);
-    }
-  }
-  state->s2d_scale_x = scale_x;
-  state->s2d_bias_x = bias_x;
-  state->s2d_scale_y = scale_y;
-  state->s2d_bias_y = bias_y;
-  state->d2s_scale_x = 1.0 / scale_x;
-  state->d2s_bias_x = -bias_x * state->d2s_scale_x;
-  state->d2s_scale_y = 1.0 / scale_y;
-  state->d2s_bias_y = -bias_y * state->d2s_scale_y;
+  // coords holds one drawing op's coordinate numbers, decoded in bulk. The
+  // most that an op can have is 16 cube_to segments of 6 coordinates each.
+  float coords[96];
+
+  double scale_x = state->s2d_scale_x;
+  double bias_x = state->s2d_bias_x;
+  double scale_y = state->s2d_scale_y;
+  double bias_y = state->s2d_bias_y;
 
   // sel[0] and sel[1] are the CSEL and NSEL registers.
-  uint32_t sel[2] = {0};
+  uint32_t sel[2];
+  sel[0] = regs->sel[0];
+  sel[1] = regs->sel[1];
   double lod[2];
-  lod[0] = 0.0;
-  lod[1] = INFINITY;
+  lod[0] = regs->lod[0];
+  lod[1] = regs->lod[1];
+
+  if (regs->mode == ICONVG_PRIVATE_BYTECODE_MODE__DRAWING) {
+    goto drawing_mode;
+  } else if (regs->mode == ICONVG_PRIVATE_BYTECODE_MODE__SKIPPING) {
+    goto skipping_mode;
+  }
 
 styling_mode:
   while (true) {
     if (d->len == 0) {
-      return NULL;
+      regs->mode = ICONVG_PRIVATE_BYTECODE_MODE__STYLING;
+      goto suspend;
     }
     uint8_t opcode = d->ptr[0];
     d->ptr += 1;
@@ -356,6 +631,9 @@ styling_mode:
       uint8_t* rgba = &state->creg.colors[creg_index].rgba[0];
       iconvg_private_set_one_byte_color(rgba, &state->custom_palette,
                                         &state->creg, d->ptr[0]);
+      iconvg_private_paint__set_creg_palette_dep(
+          state, creg_index,
+          iconvg_private_one_byte_color_palette_dep(state, d->ptr[0]));
       d->ptr += 1;
       d->len -= 1;
       sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
@@ -371,6 +649,7 @@ styling_mode:
       rgba[1] = 0x11 * (d->ptr[0] & 0x0F);
       rgba[2] = 0x11 * (d->ptr[1] >> 4);
       rgba[3] = 0x11 * (d->ptr[1] & 0x0F);
+      iconvg_private_paint__set_creg_palette_dep(state, creg_index, 0);
       d->ptr += 2;
       d->len -= 2;
       sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
@@ -386,6 +665,7 @@ styling_mode:
       rgba[1] = d->ptr[1];
       rgba[2] = d->ptr[2];
       rgba[3] = 0xFF;
+      iconvg_private_paint__set_creg_palette_dep(state, creg_index, 0);
       d->ptr += 3;
       d->len -= 3;
       sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
@@ -401,6 +681,7 @@ styling_mode:
       rgba[1] = d->ptr[1];
       rgba[2] = d->ptr[2];
       rgba[3] = d->ptr[3];
+      iconvg_private_paint__set_creg_palette_dep(state, creg_index, 0);
       d->ptr += 4;
       d->len -= 4;
       sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
@@ -424,6 +705,10 @@ styling_mode:
       rgba[1] = (uint8_t)(((p_blend * p[1]) + (q_blend * q[1]) + 128) / 255);
       rgba[2] = (uint8_t)(((p_blend * p[2]) + (q_blend * q[2]) + 128) / 255);
       rgba[3] = (uint8_t)(((p_blend * p[3]) + (q_blend * q[3]) + 128) / 255);
+      iconvg_private_paint__set_creg_palette_dep(
+          state, creg_index,
+          iconvg_private_one_byte_color_palette_dep(state, d->ptr[1]) |
+              iconvg_private_one_byte_color_palette_dep(state, d->ptr[2]));
       d->ptr += 3;
       d->len -= 3;
       sel[0] += ((opcode & 0x07) == 0x07) ? 1 : 0;
@@ -457,6 +742,9 @@ styling_mode:
       continue;
 
     } else if (opcode < 0xC7) {  // Switch to the drawing mode.
+      if (iconvg_private_paint__is_cancelled(state)) {
+        return iconvg_note_cancelled;
+      }
       uint8_t creg_index = (sel[0] - adjustments[opcode & 0x07]) & 0x3F;
       memcpy(&state->paint_rgba, &state->creg.colors[creg_index],
              sizeof(state->paint_rgba));
@@ -468,12 +756,29 @@ styling_mode:
         return iconvg_error_bad_coordinate;
       }
       double h = (double)state->height_in_pixels;
-      c = ((lod[0] <= h) && (h < lod[1])) ? c_arg : &no_op_canvas;
-      ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
-      ICONVG_PRIVATE_TRY(
-          (*c->vtable->begin_path)(c,                            //
-                                   (curr_x * scale_x) + bias_x,  //
-                                   (curr_y * scale_y) + bias_y));
+      if (!((lod[0] <= h) && (h < lod[1]))) {
+        // Skip this drawing, which is outside the Level of Detail bounds.
+        goto skipping_mode;
+      } else if (iconvg_private_paint__is_always_transparent(state,
+                                                             creg_index)) {
+        // Skip this drawing, which would not change any pixels.
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__on_skipped_drawing(c));
+        goto skipping_mode;
+      } else if (state->has_clip) {
+        float bounds[4];
+        if (iconvg_private_decoder__drawing_bounds(d, &bounds[0], curr_x,
+                                                   curr_y) &&
+            iconvg_private_paint__culls(state, &bounds[0])) {
+          // Skip this drawing, which is outside the clip rectangle.
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__on_skipped_drawing(c));
+          goto skipping_mode;
+        }
+      }
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_drawing(c, specialized));
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+          c, specialized,               //
+          (curr_x * scale_x) + bias_x,  //
+          (curr_y * scale_y) + bias_y));
       x1 = curr_x;
       y1 = curr_y;
       goto drawing_mode;
@@ -496,7 +801,11 @@ styling_mode:
 drawing_mode:
   while (true) {
     if (d->len == 0) {
-      return iconvg_error_bad_path_unfinished;
+      if (final) {
+        return iconvg_error_bad_path_unfinished;
+      }
+      regs->mode = ICONVG_PRIVATE_BYTECODE_MODE__DRAWING;
+      goto suspend;
     }
     uint8_t opcode = d->ptr[0];
     d->ptr += 1;
@@ -505,15 +814,23 @@ drawing_mode:
     switch (opcode >> 4) {
       case 0x00:
       case 0x01: {  // 'L' mnemonic: absolute line_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x1F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x1F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
+          if (q) {
+            curr_x = q[0];
+            curr_y = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
             return iconvg_error_bad_coordinate;
           }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_line_to)(c,                            //
-                                         (curr_x * scale_x) + bias_x,  //
-                                         (curr_y * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+              batch, c, specialized,        //
+              (curr_x * scale_x) + bias_x,  //
+              (curr_y * scale_y) + bias_y));
           x1 = curr_x;
           y1 = curr_y;
         }
@@ -522,17 +839,25 @@ drawing_mode:
 
       case 0x02:
       case 0x03: {  // 'l' mnemonic: relative line_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x1F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x1F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
             return iconvg_error_bad_coordinate;
           }
           curr_x += x1;
           curr_y += y1;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_line_to)(c,                            //
-                                         (curr_x * scale_x) + bias_x,  //
-                                         (curr_y * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+              batch, c, specialized,        //
+              (curr_x * scale_x) + bias_x,  //
+              (curr_y * scale_y) + bias_y));
           x1 = curr_x;
           y1 = curr_y;
         }
@@ -540,17 +865,25 @@ drawing_mode:
       }
 
       case 0x04: {  // 'T' mnemonic: absolute smooth quad_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
             return iconvg_error_bad_coordinate;
           }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
           curr_x = x2;
           curr_y = y2;
           x1 = (2 * curr_x) - x1;
@@ -560,19 +893,27 @@ drawing_mode:
       }
 
       case 0x05: {  // 't' mnemonic: relative smooth quad_to.
+        size_t num_coords = 2 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            q += 2;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
             return iconvg_error_bad_coordinate;
           }
           x2 += curr_x;
           y2 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
           curr_x = x2;
           curr_y = y2;
           x1 = (2 * curr_x) - x1;
@@ -582,19 +923,29 @@ drawing_mode:
       }
 
       case 0x06: {  // 'Q' mnemonic: absolute quad_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
             return iconvg_error_bad_coordinate;
           }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
           curr_x = x2;
           curr_y = y2;
           x1 = (2 * curr_x) - x1;
@@ -604,8 +955,18 @@ drawing_mode:
       }
 
       case 0x07: {  // 'q' mnemonic: relative quad_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2)) {
@@ -615,12 +976,12 @@ drawing_mode:
           y1 += curr_y;
           x2 += curr_x;
           y2 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_quad_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__quad_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y));
           curr_x = x2;
           curr_y = y2;
           x1 = (2 * curr_x) - x1;
@@ -630,21 +991,31 @@ drawing_mode:
       }
 
       case 0x08: {  // 'S' mnemonic: absolute smooth cube_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            x3 = q[2];
+            y3 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
             return iconvg_error_bad_coordinate;
           }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
           curr_x = x3;
           curr_y = y3;
           x1 = (2 * curr_x) - x2;
@@ -654,8 +1025,18 @@ drawing_mode:
       }
 
       case 0x09: {  // 's' mnemonic: relative smooth cube_to.
+        size_t num_coords = 4 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
+          if (q) {
+            x2 = q[0];
+            y2 = q[1];
+            x3 = q[2];
+            y3 = q[3];
+            q += 4;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &x3) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
@@ -665,14 +1046,14 @@ drawing_mode:
           y2 += curr_y;
           x3 += curr_x;
           y3 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
           curr_x = x3;
           curr_y = y3;
           x1 = (2 * curr_x) - x2;
@@ -682,8 +1063,20 @@ drawing_mode:
       }
 
       case 0x0A: {  // 'C' mnemonic: absolute cube_to.
+        size_t num_coords = 6 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            x3 = q[4];
+            y3 = q[5];
+            q += 6;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
@@ -691,14 +1084,14 @@ drawing_mode:
               !iconvg_private_decoder__decode_coordinate_number(d, &y3)) {
             return iconvg_error_bad_coordinate;
           }
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
           curr_x = x3;
           curr_y = y3;
           x1 = (2 * curr_x) - x2;
@@ -708,8 +1101,20 @@ drawing_mode:
       }
 
       case 0x0B: {  // 'c' mnemonic: relative cube_to.
+        size_t num_coords = 6 * (1 + (size_t)(opcode & 0x0F));
+        const float* q = iconvg_private_decoder__bulk_decode_coordinate_numbers(
+            d, &coords[0], num_coords);
         for (int reps = opcode & 0x0F; reps >= 0; reps--) {
-          if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
+          if (q) {
+            x1 = q[0];
+            y1 = q[1];
+            x2 = q[2];
+            y2 = q[3];
+            x3 = q[4];
+            y3 = q[5];
+            q += 6;
+          } else if (
+              !iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y1) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &x2) ||
               !iconvg_private_decoder__decode_coordinate_number(d, &y2) ||
@@ -723,14 +1128,14 @@ drawing_mode:
           y2 += curr_y;
           x3 += curr_x;
           y3 += curr_y;
-          ICONVG_PRIVATE_TRY(
-              (*c->vtable->path_cube_to)(c,                        //
-                                         (x1 * scale_x) + bias_x,  //
-                                         (y1 * scale_y) + bias_y,  //
-                                         (x2 * scale_x) + bias_x,  //
-                                         (y2 * scale_y) + bias_y,  //
-                                         (x3 * scale_x) + bias_x,  //
-                                         (y3 * scale_y) + bias_y));
+          ICONVG_PRIVATE_TRY(iconvg_private_path_batch__cube_to(
+              batch, c, specialized,    //
+              (x1 * scale_x) + bias_x,  //
+              (y1 * scale_y) + bias_y,  //
+              (x2 * scale_x) + bias_x,  //
+              (y2 * scale_y) + bias_y,  //
+              (x3 * scale_x) + bias_x,  //
+              (y3 * scale_y) + bias_y));
           curr_x = x3;
           curr_y = y3;
           x1 = (2 * curr_x) - x2;
@@ -752,7 +1157,7 @@ drawing_mode:
             return iconvg_error_bad_coordinate;
           }
           ICONVG_PRIVATE_TRY(iconvg_private_path_arc_to(
-              c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
+              batch, c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
               flags & 0x01, flags & 0x02, curr_x, curr_y));
           x1 = curr_x;
           y1 = curr_y;
@@ -775,7 +1180,7 @@ drawing_mode:
           curr_x += x3;
           curr_y += y3;
           ICONVG_PRIVATE_TRY(iconvg_private_path_arc_to(
-              c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
+              batch, c, scale_x, bias_x, scale_y, bias_y, x0, y0, x1, y1, x2,
               flags & 0x01, flags & 0x02, curr_x, curr_y));
           x1 = curr_x;
           y1 = curr_y;
@@ -786,38 +1191,42 @@ drawing_mode:
 
     switch (opcode) {
       case 0xE1: {  // 'z' mnemonic: close_path.
-        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-        ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, state));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_canvas__end_drawing(c, specialized, state));
         goto styling_mode;
       }
 
       case 0xE2: {  // 'z; M' mnemonics: close_path; absolute move_to.
-        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
         if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x) ||
             !iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
           return iconvg_error_bad_coordinate;
         }
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->begin_path)(c,                            //
-                                     (curr_x * scale_x) + bias_x,  //
-                                     (curr_y * scale_y) + bias_y));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,               //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
         x1 = curr_x;
         y1 = curr_y;
         continue;
       }
 
       case 0xE3: {  // 'z; m' mnemonics: close_path; relative move_to.
-        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__flush(batch, c));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__end_path(c, specialized));
         if (!iconvg_private_decoder__decode_coordinate_number(d, &x1) ||
             !iconvg_private_decoder__decode_coordinate_number(d, &y1)) {
           return iconvg_error_bad_coordinate;
         }
         curr_x += x1;
         curr_y += y1;
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->begin_path)(c,                            //
-                                     (curr_x * scale_x) + bias_x,  //
-                                     (curr_y * scale_y) + bias_y));
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+            c, specialized,               //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
         x1 = curr_x;
         y1 = curr_y;
         continue;
@@ -827,10 +1236,10 @@ drawing_mode:
         if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_x)) {
           return iconvg_error_bad_coordinate;
         }
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
         x1 = curr_x;
         y1 = curr_y;
         continue;
@@ -841,10 +1250,10 @@ drawing_mode:
           return iconvg_error_bad_coordinate;
         }
         curr_x += x1;
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
         x1 = curr_x;
         y1 = curr_y;
         continue;
@@ -854,10 +1263,10 @@ drawing_mode:
         if (!iconvg_private_decoder__decode_coordinate_number(d, &curr_y)) {
           return iconvg_error_bad_coordinate;
         }
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
         x1 = curr_x;
         y1 = curr_y;
         continue;
@@ -868,10 +1277,10 @@ drawing_mode:
           return iconvg_error_bad_coordinate;
         }
         curr_y += y1;
-        ICONVG_PRIVATE_TRY(
-            (*c->vtable->path_line_to)(c,                            //
-                                       (curr_x * scale_x) + bias_x,  //
-                                       (curr_y * scale_y) + bias_y));
+        ICONVG_PRIVATE_TRY(iconvg_private_path_batch__line_to(
+            batch, c, specialized,        //
+            (curr_x * scale_x) + bias_x,  //
+            (curr_y * scale_y) + bias_y));
         x1 = curr_x;
         y1 = curr_y;
         continue;
@@ -881,6 +1290,44 @@ drawing_mode:
     return iconvg_error_bad_drawing_opcode;
   }
   return iconvg_private_internal_error_unreachable;
+
+skipping_mode:
+  skip_err_msg = iconvg_private_decoder__skip_drawing(d);
+  if ((skip_err_msg == iconvg_error_bad_path_unfinished) && !final) {
+    regs->mode = ICONVG_PRIVATE_BYTECODE_MODE__SKIPPING;
+    goto suspend;
+  }
+  ICONVG_PRIVATE_TRY(skip_err_msg);
+  goto styling_mode;
+
+suspend:
+  regs->sel[0] = sel[0];
+  regs->sel[1] = sel[1];
+  regs->lod[0] = lod[0];
+  regs->lod[1] = lod[1];
+  regs->curr_x = curr_x;
+  regs->curr_y = curr_y;
+  regs->x1 = x1;
+  regs->y1 = y1;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_execute_bytecode(iconvg_canvas* c,
+                                iconvg_rectangle_f32 r,
+                                iconvg_private_decoder* d,
+                                iconvg_paint* state,
+                                iconvg_private_path_batch* batch,
+                                iconvg_private_bytecode_registers* regs,
+                                bool final) {
+#if defined(ICONVG_PRIVATE_SPECIALIZED)
+  if (iconvg_private_canvas_is_specialized(c)) {
+    return iconvg_private_execute_bytecode_template(c, r, d, state, batch,
+                                                    regs, final, true);
+  }
+#endif
+  return iconvg_private_execute_bytecode_template(c, r, d, state, batch, regs,
+                                                  final, false);
 }
 
 // ----
@@ -892,96 +1339,106 @@ iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
   iconvg_private_decoder d;
   d.ptr = src_ptr;
   d.len = src_len;
-
-  if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
-    return iconvg_error_bad_magic_identifier;
-  }
-  uint32_t num_metadata_chunks;
-  if (!iconvg_private_decoder__decode_natural_number(&d,
-                                                     &num_metadata_chunks)) {
-    return iconvg_error_bad_metadata;
+  iconvg_rectangle_f32 viewbox;
+  ICONVG_PRIVATE_TRY(
+      iconvg_private_decoder__decode_metadata(&d, &viewbox, NULL));
+  if (dst_viewbox) {
+    *dst_viewbox = viewbox;
   }
+  return NULL;
+}
 
-  bool use_default_viewbox = true;
-  int32_t previous_metadata_id = -1;
-  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
-    uint32_t chunk_length;
-    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
-        (chunk_length > d.len)) {
-      return iconvg_error_bad_metadata;
-    }
-    iconvg_private_decoder chunk =
-        iconvg_private_decoder__limit_u32(&d, chunk_length);
-    uint32_t metadata_id;
-    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
-      return iconvg_error_bad_metadata;
-    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
-      return iconvg_error_bad_metadata_id_order;
-    }
+// iconvg_private_decoder__validate_bytecode walks the bytecode, skipping over
+// each op's numbers without decoding their values. It returns the same
+// errors as iconvg_private_execute_bytecode would (with final true) for a
+// no-op canvas, other than iconvg_error_invalid_paint_type.
+static const char*  //
+iconvg_private_decoder__validate_bytecode(iconvg_private_decoder* self) {
+  // color_lens is the number of bytes after a 0x80 ..= 0xA7 styling opcode,
+  // indexed by ((opcode - 0x80) >> 3).
+  static const uint8_t color_lens[5] = {1, 2, 3, 4, 3};
 
-    if (metadata_id == 0) {  // MID 0 (ViewBox).
-      use_default_viewbox = false;
-      iconvg_rectangle_f32 r;
-      if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk, &r) ||
-          (chunk.len != 0)) {
-        return iconvg_error_bad_metadata_viewbox;
-      } else if (dst_viewbox) {
-        *dst_viewbox = r;
+  while (self->len > 0) {
+    uint8_t opcode = self->ptr[0];
+    self->ptr += 1;
+    self->len -= 1;
+
+    if (opcode < 0x80) {  // Set CSEL or NSEL.
+      continue;
+
+    } else if (opcode < 0xA8) {  // Set CREG[etc].
+      size_t n = color_lens[(opcode - 0x80) >> 3];
+      if (self->len < n) {
+        return iconvg_error_bad_color;
+      }
+      self->ptr += n;
+      self->len -= n;
+
+    } else if (opcode < 0xC0) {  // Set NREG[etc].
+      if (!iconvg_private_decoder__skip_numbers(self, 1)) {
+        return ((0xB0 <= opcode) && (opcode < 0xB8))
+                   ? iconvg_error_bad_coordinate
+                   : iconvg_error_bad_number;
       }
-    }
 
-    iconvg_private_decoder__skip_to_the_end(&chunk);
-    iconvg_private_decoder__advance_to_ptr(&d, chunk.ptr);
-    previous_metadata_id = ((int32_t)metadata_id);
-  }
+    } else if (opcode < 0xC7) {  // Switch to the drawing mode.
+      if (!iconvg_private_decoder__skip_numbers(self, 2)) {
+        return iconvg_error_bad_coordinate;
+      }
+      ICONVG_PRIVATE_TRY(iconvg_private_decoder__skip_drawing(self));
+
+    } else if (opcode < 0xC8) {  // Set Level of Detail bounds.
+      if (!iconvg_private_decoder__skip_numbers(self, 2)) {
+        return iconvg_error_bad_number;
+      }
 
-  if (use_default_viewbox && dst_viewbox) {
-    *dst_viewbox = iconvg_private_default_viewbox();
+    } else {
+      return iconvg_error_bad_styling_opcode;
+    }
   }
   return NULL;
 }
 
-static const char*  //
-iconvg_private_decode(iconvg_canvas* c,
-                      iconvg_rectangle_f32 r,
-                      iconvg_private_decoder* d,
-                      const iconvg_decode_options* options) {
-  iconvg_paint state;
-  state.viewbox = iconvg_private_default_viewbox();
-  if (options && options->height_in_pixels.has_value) {
-    state.height_in_pixels = options->height_in_pixels.value;
-  } else {
-    double h = iconvg_rectangle_f32__height_f64(&r);
-    // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
-    // than MAX_INT32 and also ensures that conversion between integer and
-    // float or double is lossless.
-    if (h <= 0x100000) {
-      state.height_in_pixels = (int64_t)h;
-    } else {
-      state.height_in_pixels = 0x100000;
-    }
+const char*  //
+iconvg_validate(const uint8_t* src_ptr, size_t src_len) {
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      &d, &viewbox, &suggested_palette));
+  return iconvg_private_decoder__validate_bytecode(&d);
+}
+
+const char*  //
+iconvg_private_decoder__decode_metadata(iconvg_private_decoder* self,
+                                        iconvg_rectangle_f32* dst_viewbox,
+                                        iconvg_palette* dst_suggested_palette) {
+  *dst_viewbox = iconvg_private_default_viewbox();
+  if (dst_suggested_palette) {
+    memcpy(dst_suggested_palette, &iconvg_private_default_palette,
+           sizeof(*dst_suggested_palette));
   }
-  memset(&state.paint_rgba, 0, sizeof(state.paint_rgba));
-  memcpy(&state.custom_palette, &iconvg_private_default_palette,
-         sizeof(state.custom_palette));
 
-  if (!iconvg_private_decoder__decode_magic_identifier(d)) {
+  if (!iconvg_private_decoder__decode_magic_identifier(self)) {
     return iconvg_error_bad_magic_identifier;
   }
   uint32_t num_metadata_chunks;
-  if (!iconvg_private_decoder__decode_natural_number(d, &num_metadata_chunks)) {
+  if (!iconvg_private_decoder__decode_natural_number(self,
+                                                     &num_metadata_chunks)) {
     return iconvg_error_bad_metadata;
   }
 
   int32_t previous_metadata_id = -1;
   for (; num_metadata_chunks > 0; num_metadata_chunks--) {
     uint32_t chunk_length;
-    if (!iconvg_private_decoder__decode_natural_number(d, &chunk_length) ||
-        (chunk_length > d->len)) {
+    if (!iconvg_private_decoder__decode_natural_number(self, &chunk_length) ||
+        (chunk_length > self->len)) {
       return iconvg_error_bad_metadata;
     }
     iconvg_private_decoder chunk =
-        iconvg_private_decoder__limit_u32(d, chunk_length);
+        iconvg_private_decoder__limit_u32(self, chunk_length);
     uint32_t metadata_id;
     if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
       return iconvg_error_bad_metadata;
@@ -992,50 +1449,61 @@ iconvg_private_decode(iconvg_canvas* c,
     switch (metadata_id) {
       case 0:  // MID 0 (ViewBox).
         if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk,
-                                                             &state.viewbox) ||
+                                                             dst_viewbox) ||
             (chunk.len != 0)) {
           return iconvg_error_bad_metadata_viewbox;
         }
         break;
 
       case 1:  // MID 1 (Suggested Palette).
-        if (!iconvg_private_decoder__decode_metadata_suggested_palette(
-                &chunk, &state.custom_palette) ||
-            (chunk.len != 0)) {
+        if (!dst_suggested_palette) {
+          break;
+        } else if (!iconvg_private_decoder__decode_metadata_suggested_palette(
+                       &chunk, dst_suggested_palette) ||
+                   (chunk.len != 0)) {
           return iconvg_error_bad_metadata_suggested_palette;
         }
         break;
 
       default:
-        return iconvg_error_bad_metadata;
+        if (dst_suggested_palette) {
+          return iconvg_error_bad_metadata;
+        }
+        break;
     }
 
     iconvg_private_decoder__skip_to_the_end(&chunk);
-    iconvg_private_decoder__advance_to_ptr(d, chunk.ptr);
+    iconvg_private_decoder__advance_to_ptr(self, chunk.ptr);
     previous_metadata_id = ((int32_t)metadata_id);
   }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_decode(iconvg_canvas* c,
+                      iconvg_rectangle_f32 r,
+                      iconvg_private_decoder* d,
+                      const iconvg_decode_options* options) {
+  iconvg_paint state;
+  ICONVG_PRIVATE_TRY(iconvg_private_decoder__decode_metadata(
+      d, &state.viewbox, &state.custom_palette));
 
   ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, state.viewbox));
   ICONVG_PRIVATE_TRY(
       (*c->vtable->on_metadata_suggested_palette)(c, &state.custom_palette));
 
-  if (options && options->palette) {
-    memcpy(&state.custom_palette, options->palette,
-           sizeof(state.custom_palette));
-  }
+  iconvg_private_paint__initialize(&state, r, options);
 
-  memcpy(&state.creg, &state.custom_palette, sizeof(state.creg));
-  memset(&state.nreg[0], 0, sizeof(state.nreg));
-  state.s2d_scale_x = +1.0;
-  state.s2d_bias_x = +0.0;
-  state.s2d_scale_y = +1.0;
-  state.s2d_bias_y = +0.0;
-  state.d2s_scale_x = +1.0;
-  state.d2s_bias_x = +0.0;
-  state.d2s_scale_y = +1.0;
-  state.d2s_bias_y = +0.0;
-
-  return iconvg_private_execute_bytecode(c, r, d, &state);
+  iconvg_private_path_batch batch;
+  iconvg_private_path_batch__initialize(&batch, c);
+  iconvg_private_bytecode_registers regs;
+  iconvg_private_bytecode_registers__initialize(&regs);
+  const char* err_msg =
+      iconvg_private_execute_bytecode(c, r, d, &state, &batch, &regs, true);
+  // On error, pass on any segments that were decoded before the error, as the
+  // per-segment canvas methods would have seen them.
+  const char* flush_err_msg = iconvg_private_path_batch__flush(&batch, c);
+  return flush_err_msg ? flush_err_msg : err_msg;
 }
 
 const char*  //
@@ -1049,13 +1517,17 @@ iconvg_decode(iconvg_canvas* dst_canvas,
     dst_canvas = &fallback_canvas;
   }
 
-  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
-      sizeof(iconvg_canvas_vtable)) {
-    // If we want to support multiple library versions (with dynamic linking),
-    // we could detect older versions here (with smaller vtable sizes) and
-    // substitute in an adapter implementation.
+  if (!iconvg_private_canvas_vtable_is_supported(dst_canvas)) {
     return iconvg_error_unsupported_vtable;
   }
+  iconvg_canvas transform_canvas;
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    transform_canvas =
+        iconvg_private_canvas__make_transform(dst_canvas, transform);
+    dst_canvas = &transform_canvas;
+  }
 
   iconvg_private_decoder d;
   d.ptr = src_ptr;
@@ -1069,3 +1541,236 @@ iconvg_decode(iconvg_canvas* dst_canvas,
   return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg, src_len - d.len,
                                            d.len);
 }
+
+// ----
+
+// ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN bounds the partial op (or partial
+// metadata) that an iconvg_stream_decoder holds between writes. The longest
+// op, a 16-repetition 'A' or 'C' with 4-byte numbers, is 385 bytes. The
+// longest valid metadata (ViewBox plus a 64-color Suggested Palette) is just
+// under 300 bytes.
+#define ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN 1024
+
+typedef struct iconvg_private_stream_decoder_state_struct {
+  iconvg_canvas* canvas;
+  iconvg_canvas fallback_canvas;
+  iconvg_canvas transform_canvas;
+  iconvg_rectangle_f32 dst_rect;
+  const iconvg_decode_options* options;
+  const char* err_msg;
+  bool began_decode;
+  bool decoded_metadata;
+  size_t num_bytes_written;
+  size_t num_bytes_consumed;
+  iconvg_paint paint;
+  iconvg_private_bytecode_registers regs;
+  iconvg_private_path_batch batch;
+  size_t buf_len;
+  uint8_t buf[ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN];
+} iconvg_private_stream_decoder_state;
+
+// iconvg_private_stream_decoder_state__process decodes as much of src_ptr[..
+// src_len] as possible, setting self->err_msg on failure. Unless final is
+// true, it stops before any trailing partial op. It returns the number of
+// bytes consumed.
+static size_t  //
+iconvg_private_stream_decoder_state__process(
+    iconvg_private_stream_decoder_state* self,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    bool final) {
+  iconvg_canvas* c = self->canvas;
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+
+  if (!self->decoded_metadata) {
+    size_t n = d.len;
+    if (!final) {
+      n = iconvg_private_decoder__complete_metadata_len(&d);
+      if (n == 0) {
+        return 0;
+      }
+    }
+    iconvg_private_decoder m;
+    m.ptr = d.ptr;
+    m.len = n;
+    self->err_msg = iconvg_private_decoder__decode_metadata(
+        &m, &self->paint.viewbox, &self->paint.custom_palette);
+    iconvg_private_decoder__advance_to_ptr(&d, m.ptr);
+    if (!self->err_msg) {
+      self->err_msg =
+          (*c->vtable->on_metadata_viewbox)(c, self->paint.viewbox);
+    }
+    if (!self->err_msg) {
+      self->err_msg = (*c->vtable->on_metadata_suggested_palette)(
+          c, &self->paint.custom_palette);
+    }
+    if (self->err_msg) {
+      return src_len - d.len;
+    }
+    iconvg_private_paint__initialize(&self->paint, self->dst_rect,
+                                     self->options);
+    iconvg_private_path_batch__initialize(&self->batch, c);
+    iconvg_private_bytecode_registers__initialize(&self->regs);
+    self->decoded_metadata = true;
+  }
+
+  const uint8_t* original_end = d.ptr + d.len;
+  if (!final) {
+    d.len = iconvg_private_decoder__complete_ops_len(
+        &d, self->regs.mode != ICONVG_PRIVATE_BYTECODE_MODE__STYLING);
+  }
+  const char* err_msg = iconvg_private_execute_bytecode(
+      c, self->dst_rect, &d, &self->paint, &self->batch, &self->regs, final);
+  // Flush even on suspension, so that the canvas sees every complete op.
+  const char* flush_err_msg = iconvg_private_path_batch__flush(&self->batch, c);
+  self->err_msg = flush_err_msg ? flush_err_msg : err_msg;
+  return src_len - ((size_t)(original_end - d.ptr));
+}
+
+static void  //
+iconvg_private_stream_decoder_state__begin(
+    iconvg_private_stream_decoder_state* self) {
+  if (!self->began_decode) {
+    self->began_decode = true;
+    self->err_msg =
+        (*self->canvas->vtable->begin_decode)(self->canvas, self->dst_rect);
+  }
+}
+
+size_t  //
+iconvg_stream_decoder_workbuf_len(void) {
+  return sizeof(iconvg_private_stream_decoder_state);
+}
+
+const char*  //
+iconvg_stream_decoder__initialize(iconvg_stream_decoder* self,
+                                  void* workbuf_ptr,
+                                  size_t workbuf_len,
+                                  iconvg_canvas* dst_canvas,
+                                  iconvg_rectangle_f32 dst_rect,
+                                  const iconvg_decode_options* options) {
+  if (!self || !workbuf_ptr || (((uintptr_t)workbuf_ptr) & 7) ||
+      (workbuf_len < sizeof(iconvg_private_stream_decoder_state))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_stream_decoder_state* st =
+      (iconvg_private_stream_decoder_state*)workbuf_ptr;
+  memset(st, 0, sizeof(*st));
+  st->fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &st->fallback_canvas;
+  }
+  if (!iconvg_private_canvas_vtable_is_supported(dst_canvas)) {
+    return iconvg_error_unsupported_vtable;
+  }
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  if (transform) {
+    st->transform_canvas =
+        iconvg_private_canvas__make_transform(dst_canvas, transform);
+    dst_canvas = &st->transform_canvas;
+  }
+  st->canvas = dst_canvas;
+  st->dst_rect = dst_rect;
+  st->options = options;
+  self->private_impl.workbuf_ptr = st;
+  return NULL;
+}
+
+const char*  //
+iconvg_stream_decoder__write(iconvg_stream_decoder* self,
+                             const uint8_t* src_ptr,
+                             size_t src_len) {
+  if (!self || !self->private_impl.workbuf_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_stream_decoder_state* st =
+      (iconvg_private_stream_decoder_state*)(self->private_impl.workbuf_ptr);
+  iconvg_private_stream_decoder_state__begin(st);
+  if (st->err_msg) {
+    return st->err_msg;
+  }
+  st->num_bytes_written += src_len;
+
+  while (true) {
+    if (st->buf_len == 0) {
+      // Decode straight from src, keeping any trailing partial op.
+      size_t n = iconvg_private_stream_decoder_state__process(st, src_ptr,
+                                                              src_len, false);
+      st->num_bytes_consumed += n;
+      src_ptr += n;
+      src_len -= n;
+      if (st->err_msg) {
+        return st->err_msg;
+      } else if (src_len > ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN) {
+        // Only over-long metadata can get here.
+        st->err_msg = iconvg_error_bad_metadata;
+        return st->err_msg;
+      }
+      if (src_len > 0) {
+        memcpy(st->buf, src_ptr, src_len);
+      }
+      st->buf_len = src_len;
+      break;
+    }
+
+    // Top up the partial op held in buf and decode from there.
+    size_t old_buf_len = st->buf_len;
+    size_t n = ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN - old_buf_len;
+    if (n > src_len) {
+      n = src_len;
+    }
+    memcpy(st->buf + old_buf_len, src_ptr, n);
+    src_ptr += n;
+    src_len -= n;
+    st->buf_len += n;
+    size_t consumed = iconvg_private_stream_decoder_state__process(
+        st, st->buf, st->buf_len, false);
+    st->num_bytes_consumed += consumed;
+    if (st->err_msg) {
+      return st->err_msg;
+    } else if (consumed >= old_buf_len) {
+      // The partial op was completed. Whatever remains in buf came from src,
+      // so give it back and continue without buf.
+      size_t remaining = st->buf_len - consumed;
+      src_ptr -= remaining;
+      src_len += remaining;
+      st->buf_len = 0;
+      if (src_len == 0) {
+        break;
+      }
+      continue;
+    } else if (st->buf_len == ICONVG_PRIVATE_STREAM_DECODER_BUFFER_LEN) {
+      st->err_msg = st->decoded_metadata
+                        ? iconvg_private_internal_error_unreachable
+                        : iconvg_error_bad_metadata;
+      return st->err_msg;
+    }
+    memmove(st->buf, st->buf + consumed, st->buf_len - consumed);
+    st->buf_len -= consumed;
+    if (src_len == 0) {
+      break;
+    }
+  }
+  return iconvg_note_need_more_input;
+}
+
+const char*  //
+iconvg_stream_decoder__close(iconvg_stream_decoder* self) {
+  if (!self || !self->private_impl.workbuf_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_private_stream_decoder_state* st =
+      (iconvg_private_stream_decoder_state*)(self->private_impl.workbuf_ptr);
+  self->private_impl.workbuf_ptr = NULL;
+  iconvg_private_stream_decoder_state__begin(st);
+  if (!st->err_msg) {
+    st->num_bytes_consumed += iconvg_private_stream_decoder_state__process(
+        st, st->buf, st->buf_len, true);
+  }
+  return (*st->canvas->vtable->end_decode)(
+      st->canvas, st->err_msg, st->num_bytes_consumed,
+      st->num_bytes_written - st->num_bytes_consumed);
+}
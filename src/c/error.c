@@ -16,10 +16,14 @@
 
 const char iconvg_error_bad_color[] =  //
     "iconvg: bad color";
+const char iconvg_error_bad_compiled_form[] =  //
+    "iconvg: bad compiled form";
 const char iconvg_error_bad_coordinate[] =  //
     "iconvg: bad coordinate";
 const char iconvg_error_bad_drawing_opcode[] =  //
     "iconvg: bad drawing opcode";
+const char iconvg_error_bad_icon_pack[] =  //
+    "iconvg: bad icon pack";
 const char iconvg_error_bad_magic_identifier[] =  //
     "iconvg: bad magic identifier";
 const char iconvg_error_bad_metadata[] =  //
@@ -37,6 +41,10 @@ const char iconvg_error_bad_path_unfinished[] =  //
 const char iconvg_error_bad_styling_opcode[] =  //
     "iconvg: bad styling opcode";
 
+const char iconvg_error_system_failure_atlas_too_small[] =  //
+    "iconvg: system failure: atlas too small";
+const char iconvg_error_system_failure_dst_buffer_too_short[] =  //
+    "iconvg: system failure: dst buffer too short";
 const char iconvg_error_system_failure_out_of_memory[] =  //
     "iconvg: system failure: out of memory";
 
@@ -44,11 +52,20 @@ const char iconvg_error_invalid_backend_not_enabled[] =  //
     "iconvg: invalid backend (not enabled)";
 const char iconvg_error_invalid_constructor_argument[] =  //
     "iconvg: invalid constructor argument";
+const char iconvg_error_invalid_coverage_masks[] =  //
+    "iconvg: invalid coverage masks";
 const char iconvg_error_invalid_paint_type[] =  //
     "iconvg: invalid paint type";
+const char iconvg_error_invalid_path_verb[] =  //
+    "iconvg: invalid path verb";
 const char iconvg_error_unsupported_vtable[] =  //
     "iconvg: unsupported vtable";
 
+const char iconvg_note_cancelled[] =  //
+    "iconvg: note: cancelled";
+const char iconvg_note_need_more_input[] =  //
+    "iconvg: note: need more input";
+
 const char iconvg_private_internal_error_unreachable[] =  //
     "iconvg: internal error: unreachable";
 
@@ -57,8 +74,10 @@ const char iconvg_private_internal_error_unreachable[] =  //
 bool  //
 iconvg_error_is_file_format_error(const char* err_msg) {
   return (err_msg == iconvg_error_bad_color) ||
+         (err_msg == iconvg_error_bad_compiled_form) ||
          (err_msg == iconvg_error_bad_coordinate) ||
          (err_msg == iconvg_error_bad_drawing_opcode) ||
+         (err_msg == iconvg_error_bad_icon_pack) ||
          (err_msg == iconvg_error_bad_magic_identifier) ||
          (err_msg == iconvg_error_bad_metadata) ||
          (err_msg == iconvg_error_bad_metadata_id_order) ||
@@ -0,0 +1,165 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// iconvg_private_gradient_cache_entry is one slot of an iconvg_gradient_cache.
+// A zero last_used value marks an empty slot.
+typedef struct iconvg_private_gradient_cache_entry_struct {
+  uint64_t last_used;
+  iconvg_private_gradient_cache_release_func release_func;
+  void* backend_object;
+  size_t backend_bytes;
+  iconvg_private_gradient_key key;
+} iconvg_private_gradient_cache_entry;
+
+void  //
+iconvg_private_gradient_key__initialize(iconvg_private_gradient_key* self,
+                                        const iconvg_paint* p) {
+  memset(self, 0, sizeof(*self));
+  self->paint_type = (uint32_t)iconvg_paint__type(p);
+  self->spread = (uint32_t)iconvg_paint__gradient_spread(p);
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
+  if (num_stops > 64) {
+    num_stops = 64;
+  }
+  self->num_stops = num_stops;
+  for (uint32_t i = 0; i < num_stops; i++) {
+    self->offsets[i] = iconvg_paint__gradient_stop_offset(p, i);
+    self->colors[i] = iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+  }
+}
+
+static void  //
+iconvg_private_gradient_cache__evict(
+    iconvg_gradient_cache* self,
+    iconvg_private_gradient_cache_entry* entry) {
+  (*entry->release_func)(entry->backend_object);
+  self->private_impl.total_backend_bytes -= entry->backend_bytes;
+  memset(entry, 0, sizeof(*entry));
+}
+
+void*  //
+iconvg_private_gradient_cache__lookup(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func) {
+  iconvg_private_gradient_cache_entry* entries =
+      (iconvg_private_gradient_cache_entry*)(self->private_impl.entries_ptr);
+  size_t n = self->private_impl.entries_cap;
+  for (size_t i = 0; i < n; i++) {
+    iconvg_private_gradient_cache_entry* e = &entries[i];
+    if ((e->last_used != 0) && (e->release_func == release_func) &&
+        (memcmp(&e->key, key, sizeof(*key)) == 0)) {
+      e->last_used = ++self->private_impl.clock;
+      return e->backend_object;
+    }
+  }
+  return NULL;
+}
+
+bool  //
+iconvg_private_gradient_cache__insert(
+    iconvg_gradient_cache* self,
+    const iconvg_private_gradient_key* key,
+    iconvg_private_gradient_cache_release_func release_func,
+    void* obj,
+    size_t backend_bytes) {
+  size_t max_bytes = self->private_impl.max_backend_bytes;
+  if ((max_bytes != 0) && (backend_bytes > max_bytes)) {
+    return false;
+  }
+  iconvg_private_gradient_cache_entry* entries =
+      (iconvg_private_gradient_cache_entry*)(self->private_impl.entries_ptr);
+  size_t n = self->private_impl.entries_cap;
+
+  // Evict least recently used entries until the byte limit is met and there
+  // is an empty slot.
+  while (true) {
+    iconvg_private_gradient_cache_entry* empty = NULL;
+    iconvg_private_gradient_cache_entry* oldest = NULL;
+    for (size_t i = 0; i < n; i++) {
+      iconvg_private_gradient_cache_entry* e = &entries[i];
+      if (e->last_used == 0) {
+        if (!empty) {
+          empty = e;
+        }
+      } else if (!oldest || (oldest->last_used > e->last_used)) {
+        oldest = e;
+      }
+    }
+
+    bool fits = (max_bytes == 0) ||
+                (backend_bytes <=
+                 (max_bytes - self->private_impl.total_backend_bytes));
+    if (empty && fits) {
+      empty->last_used = ++self->private_impl.clock;
+      empty->release_func = release_func;
+      empty->backend_object = obj;
+      empty->backend_bytes = backend_bytes;
+      empty->key = *key;
+      self->private_impl.total_backend_bytes += backend_bytes;
+      return true;
+    } else if (!oldest) {
+      return false;
+    }
+    iconvg_private_gradient_cache__evict(self, oldest);
+  }
+}
+
+// ----
+
+size_t  //
+iconvg_gradient_cache_entries_len(size_t num_entries) {
+  const size_t entry_len = sizeof(iconvg_private_gradient_cache_entry);
+  if ((num_entries == 0) || (num_entries > (SIZE_MAX / entry_len))) {
+    return 0;
+  }
+  return num_entries * entry_len;
+}
+
+const char*  //
+iconvg_gradient_cache__initialize(iconvg_gradient_cache* self,
+                                  void* entries_ptr,
+                                  size_t entries_len,
+                                  size_t max_backend_bytes) {
+  if (!self || !entries_ptr || (((uintptr_t)entries_ptr) & 7) ||
+      (entries_len < sizeof(iconvg_private_gradient_cache_entry))) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(entries_ptr, 0, entries_len);
+  self->private_impl.entries_ptr = entries_ptr;
+  self->private_impl.entries_cap =
+      entries_len / sizeof(iconvg_private_gradient_cache_entry);
+  self->private_impl.max_backend_bytes = max_backend_bytes;
+  self->private_impl.total_backend_bytes = 0;
+  self->private_impl.clock = 0;
+  return NULL;
+}
+
+void  //
+iconvg_gradient_cache__invalidate(iconvg_gradient_cache* self) {
+  if (!self) {
+    return;
+  }
+  iconvg_private_gradient_cache_entry* entries =
+      (iconvg_private_gradient_cache_entry*)(self->private_impl.entries_ptr);
+  size_t n = self->private_impl.entries_cap;
+  for (size_t i = 0; i < n; i++) {
+    if (entries[i].last_used != 0) {
+      iconvg_private_gradient_cache__evict(self, &entries[i]);
+    }
+  }
+  self->private_impl.clock = 0;
+}
@@ -0,0 +1,183 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// An icon pack holds many named IconVG graphics in one file, laid out so that
+// it can be memory-mapped (read-only) and used in place. All integers are
+// little-endian uint32 words. It consists of:
+//  - A 4 word header: the magic "\x89IVP", the number of entries N, the
+//    number of hash slots S (a power of 2 greater than N) and a zero word.
+//  - S words of hash slots. Each is zero (empty) or one plus an entry index.
+//    A name's probe sequence starts at its hash modulo S and is linear.
+//  - N entries of 7 words, sorted by name: the name's 32-bit FNV-1a hash,
+//    then the offset and length of the name, the IconVG-formatted data and
+//    the compiled form (both zero if absent). Offsets are from the start of
+//    the pack.
+//  - The names and data, each starting at a 4-byte aligned offset.
+//
+// The src/go/iconpack package writes icon packs. A compiled form (see
+// iconvg_compile) is not a stable format, so a pack should only hold compiled
+// forms produced by the same library version that reads the pack.
+
+#define ICONVG_PRIVATE_ICON_PACK_MAGIC 0x50564989u
+#define ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS 4
+#define ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS 7
+
+static inline uint32_t  //
+iconvg_private_icon_pack_hash(const uint8_t* p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (; n > 0; n--) {
+    h ^= *p++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// iconvg_private_icon_pack_range_is_valid returns whether the offset and
+// length words at p describe a range within a pack of the given length.
+static inline bool  //
+iconvg_private_icon_pack_range_is_valid(const uint8_t* p, size_t pack_len) {
+  size_t offset = iconvg_private_peek_u32le(p + 0);
+  size_t length = iconvg_private_peek_u32le(p + 4);
+  return (offset <= pack_len) && (length <= (pack_len - offset));
+}
+
+static void  //
+iconvg_private_icon_pack__make_entry(const iconvg_icon_pack* self,
+                                     iconvg_icon_pack_entry* dst,
+                                     const uint8_t* e) {
+  const uint8_t* ptr = self->private_impl.ptr;
+  dst->name_ptr = ptr + iconvg_private_peek_u32le(e + 4);
+  dst->name_len = iconvg_private_peek_u32le(e + 8);
+  dst->src_ptr = ptr + iconvg_private_peek_u32le(e + 12);
+  dst->src_len = iconvg_private_peek_u32le(e + 16);
+  dst->compiled_len = iconvg_private_peek_u32le(e + 24);
+  dst->compiled_ptr = dst->compiled_len
+                          ? (ptr + iconvg_private_peek_u32le(e + 20))
+                          : NULL;
+}
+
+// ----
+
+const char*  //
+iconvg_icon_pack__initialize(iconvg_icon_pack* self,
+                             const uint8_t* ptr,
+                             size_t len) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!ptr || (len < (4 * ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS)) ||
+      (iconvg_private_peek_u32le(ptr) != ICONVG_PRIVATE_ICON_PACK_MAGIC)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  size_t num_entries = iconvg_private_peek_u32le(ptr + 4);
+  size_t num_slots = iconvg_private_peek_u32le(ptr + 8);
+  if ((num_slots <= num_entries) || (num_slots & (num_slots - 1)) ||
+      (iconvg_private_peek_u32le(ptr + 12) != 0)) {
+    return iconvg_error_bad_icon_pack;
+  }
+
+  // The header and slot words come first, then the entries. Each count is
+  // less than 1<<32, so the byte counts below cannot overflow a uint64_t.
+  uint64_t entries_offset =
+      4 * ((uint64_t)ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS + num_slots);
+  uint64_t entries_end =
+      entries_offset +
+      (4 * (uint64_t)ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS * num_entries);
+  if (entries_end > len) {
+    return iconvg_error_bad_icon_pack;
+  }
+
+  // Validate every entry's ranges once, so that lookups need not. This reads
+  // the entry table but none of the (possibly paged out) names or data.
+  const uint8_t* e = ptr + entries_offset;
+  for (size_t i = 0; i < num_entries; i++) {
+    if (!iconvg_private_icon_pack_range_is_valid(e + 4, len) ||
+        !iconvg_private_icon_pack_range_is_valid(e + 12, len) ||
+        !iconvg_private_icon_pack_range_is_valid(e + 20, len)) {
+      return iconvg_error_bad_icon_pack;
+    }
+    e += 4 * ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS;
+  }
+
+  self->private_impl.ptr = ptr;
+  self->private_impl.len = len;
+  self->private_impl.entries = ptr + entries_offset;
+  self->private_impl.num_entries = (uint32_t)num_entries;
+  self->private_impl.num_slots = (uint32_t)num_slots;
+  return NULL;
+}
+
+uint32_t  //
+iconvg_icon_pack__number_of_entries(const iconvg_icon_pack* self) {
+  return self ? self->private_impl.num_entries : 0;
+}
+
+bool  //
+iconvg_icon_pack__entry(const iconvg_icon_pack* self,
+                        iconvg_icon_pack_entry* dst,
+                        uint32_t index) {
+  if (!self || !dst || (index >= self->private_impl.num_entries)) {
+    return false;
+  }
+  iconvg_private_icon_pack__make_entry(
+      self, dst,
+      self->private_impl.entries +
+          (4 * ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS * (size_t)index));
+  return true;
+}
+
+bool  //
+iconvg_icon_pack__lookup(const iconvg_icon_pack* self,
+                         iconvg_icon_pack_entry* dst,
+                         const char* name_ptr,
+                         size_t name_len) {
+  if (!self || !dst || (!name_ptr && (name_len > 0))) {
+    return false;
+  }
+  const uint8_t* name = (const uint8_t*)name_ptr;
+  const uint8_t* slots =
+      self->private_impl.ptr + (4 * ICONVG_PRIVATE_ICON_PACK_HEADER_NUM_WORDS);
+  uint32_t num_entries = self->private_impl.num_entries;
+  uint32_t mask = self->private_impl.num_slots - 1;
+  uint32_t hash = iconvg_private_icon_pack_hash(name, name_len);
+
+  // There is always at least one empty slot, but a malformed pack might not
+  // have one, so bound the probe sequence.
+  uint32_t s = hash & mask;
+  for (uint32_t n = 0; n <= mask; n++, s = (s + 1) & mask) {
+    uint32_t slot = iconvg_private_peek_u32le(slots + (4 * (size_t)s));
+    if (slot == 0) {
+      break;
+    } else if (slot > num_entries) {
+      continue;
+    }
+    const uint8_t* e =
+        self->private_impl.entries +
+        (4 * ICONVG_PRIVATE_ICON_PACK_ENTRY_NUM_WORDS * (size_t)(slot - 1));
+    if ((iconvg_private_peek_u32le(e + 0) != hash) ||
+        (iconvg_private_peek_u32le(e + 8) != name_len)) {
+      continue;
+    }
+    const uint8_t* entry_name =
+        self->private_impl.ptr + iconvg_private_peek_u32le(e + 4);
+    if ((name_len == 0) || (memcmp(entry_name, name, name_len) == 0)) {
+      iconvg_private_icon_pack__make_entry(self, dst, e);
+      return true;
+    }
+  }
+  return false;
+}
@@ -14,6 +14,137 @@
 
 #include "./aaa_private.h"
 
+void  //
+iconvg_private_paint__initialize(iconvg_paint* self,
+                                 iconvg_rectangle_f32 dst_rect,
+                                 const iconvg_decode_options* options) {
+  if (options && options->height_in_pixels.has_value) {
+    self->height_in_pixels = options->height_in_pixels.value;
+  } else {
+    double h = iconvg_rectangle_f32__height_f64(&dst_rect);
+    // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
+    // than MAX_INT32 and also ensures that conversion between integer and
+    // float or double is lossless.
+    if (h <= 0x100000) {
+      self->height_in_pixels = (int64_t)h;
+    } else {
+      self->height_in_pixels = 0x100000;
+    }
+  }
+  memset(&self->paint_rgba, 0, sizeof(self->paint_rgba));
+
+  if (options && options->palette) {
+    memcpy(&self->custom_palette, options->palette,
+           sizeof(self->custom_palette));
+  }
+  memcpy(&self->creg, &self->custom_palette, sizeof(self->creg));
+  self->creg_palette_deps = ~((uint64_t)0);
+  memset(&self->nreg[0], 0, sizeof(self->nreg));
+
+  double scale_x = +1.0;
+  double bias_x = +0.0;
+  double scale_y = +1.0;
+  double bias_y = +0.0;
+  {
+    double rw = iconvg_rectangle_f32__width_f64(&dst_rect);
+    double rh = iconvg_rectangle_f32__height_f64(&dst_rect);
+    double vw = iconvg_rectangle_f32__width_f64(&self->viewbox);
+    double vh = iconvg_rectangle_f32__height_f64(&self->viewbox);
+    if ((rw > 0) && (rh > 0) && (vw > 0) && (vh > 0)) {
+      scale_x = rw / vw;
+      scale_y = rh / vh;
+      bias_x = dst_rect.min_x - (self->viewbox.min_x * scale_x);
+      bias_y = dst_rect.min_y - (self->viewbox.min_y * scale_y);
+    }
+  }
+  self->s2d_scale_x = scale_x;
+  self->s2d_bias_x = bias_x;
+  self->s2d_scale_y = scale_y;
+  self->s2d_bias_y = bias_y;
+  self->d2s_scale_x = 1.0 / scale_x;
+  self->d2s_bias_x = -bias_x * self->d2s_scale_x;
+  self->d2s_scale_y = 1.0 / scale_y;
+  self->d2s_bias_y = -bias_y * self->d2s_scale_y;
+
+  const iconvg_matrix_2x3_f64* transform =
+      iconvg_private_decode_options__transform(options);
+  self->has_transform = transform != NULL;
+  if (transform) {
+    iconvg_matrix_2x3_f64 m = *transform;
+    iconvg_matrix_2x3_f64 inv = iconvg_matrix_2x3_f64__inverse(&m);
+    self->d2s_matrix = iconvg_matrix_2x3_f64__make(
+        inv.elems[0][0] * self->d2s_scale_x,
+        inv.elems[0][1] * self->d2s_scale_x,
+        (inv.elems[0][2] * self->d2s_scale_x) + self->d2s_bias_x,
+        inv.elems[1][0] * self->d2s_scale_y,
+        inv.elems[1][1] * self->d2s_scale_y,
+        (inv.elems[1][2] * self->d2s_scale_y) + self->d2s_bias_y);
+  } else {
+    self->d2s_matrix = iconvg_matrix_2x3_f64__make(
+        self->d2s_scale_x, 0.0, self->d2s_bias_x,  //
+        0.0, self->d2s_scale_y, self->d2s_bias_y);
+  }
+
+  // The s2d scales are positive, so the d2s conversion keeps min below max.
+  // Canvases clip to dst_rect, whose src coordinates are therefore the
+  // default src_clip, but a transform can move other parts of the graphic
+  // into (the bounding box of) the transformed dst_rect.
+  self->src_clip[0] = -INFINITY;
+  self->src_clip[1] = -INFINITY;
+  self->src_clip[2] = +INFINITY;
+  self->src_clip[3] = +INFINITY;
+  if (!transform) {
+    self->src_clip[0] = (dst_rect.min_x * self->d2s_scale_x) + self->d2s_bias_x;
+    self->src_clip[1] = (dst_rect.min_y * self->d2s_scale_y) + self->d2s_bias_y;
+    self->src_clip[2] = (dst_rect.max_x * self->d2s_scale_x) + self->d2s_bias_x;
+    self->src_clip[3] = (dst_rect.max_y * self->d2s_scale_y) + self->d2s_bias_y;
+  }
+  const iconvg_rectangle_f32* clip_rect =
+      iconvg_private_decode_options__clip_rect(options);
+  self->has_clip = clip_rect != NULL;
+  if (clip_rect) {
+    double c[4];
+    c[0] = (clip_rect->min_x * self->d2s_scale_x) + self->d2s_bias_x;
+    c[1] = (clip_rect->min_y * self->d2s_scale_y) + self->d2s_bias_y;
+    c[2] = (clip_rect->max_x * self->d2s_scale_x) + self->d2s_bias_x;
+    c[3] = (clip_rect->max_y * self->d2s_scale_y) + self->d2s_bias_y;
+    self->src_clip[0] = (self->src_clip[0] > c[0]) ? self->src_clip[0] : c[0];
+    self->src_clip[1] = (self->src_clip[1] > c[1]) ? self->src_clip[1] : c[1];
+    self->src_clip[2] = (self->src_clip[2] < c[2]) ? self->src_clip[2] : c[2];
+    self->src_clip[3] = (self->src_clip[3] < c[3]) ? self->src_clip[3] : c[3];
+  }
+
+  self->cancel = NULL;
+  self->cancel_context = NULL;
+  if (options && (options->sizeof__iconvg_decode_options >=
+                  (offsetof(iconvg_decode_options, cancel_context) +
+                   sizeof(options->cancel_context)))) {
+    self->cancel = options->cancel;
+    self->cancel_context = options->cancel_context;
+  }
+}
+
+bool  //
+iconvg_private_paint__is_transparent(const iconvg_paint* self) {
+  // Flat colors are premultiplied, so zero alpha means all zero. Gradients
+  // always have zero paint_rgba[3].
+  if (self->paint_rgba[3] != 0x00) {
+    return false;
+  } else if (iconvg_paint__type(self) == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    return true;
+  }
+  uint32_t cbase = self->paint_rgba[1];
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(self);
+  for (uint32_t i = 0; i < num_stops; i++) {
+    if (self->creg.colors[0x3F & (cbase + i)].rgba[3] != 0x00) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----
+
 iconvg_paint_type  //
 iconvg_paint__type(const iconvg_paint* self) {
   if (self) {
@@ -158,6 +289,19 @@ iconvg_paint__gradient_transformation_matrix(const iconvg_paint* self) {
   //
   //   pat_x = (dst_x * d00) + (dst_y * d01) + d02
   //   pat_y = (dst_x * d10) + (dst_y * d11) + d12
+  //
+  // With an iconvg_decode_options transform, src_x and src_y are instead a
+  // full affine function (d2s_matrix) of dst_x and dst_y.
+  if (self->has_transform) {
+    const iconvg_matrix_2x3_f64* a = &self->d2s_matrix;
+    return iconvg_matrix_2x3_f64__make(
+        (s00 * a->elems[0][0]) + (s01 * a->elems[1][0]),
+        (s00 * a->elems[0][1]) + (s01 * a->elems[1][1]),
+        (s00 * a->elems[0][2]) + (s01 * a->elems[1][2]) + s02,
+        (s10 * a->elems[0][0]) + (s11 * a->elems[1][0]),
+        (s10 * a->elems[0][1]) + (s11 * a->elems[1][1]),
+        (s10 * a->elems[0][2]) + (s11 * a->elems[1][2]) + s12);
+  }
   double d00 = s00 * self->d2s_scale_x;
   double d01 = s01 * self->d2s_scale_y;
   double d02 = (s00 * self->d2s_bias_x) + (s01 * self->d2s_bias_y) + s02;
@@ -0,0 +1,203 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// iconvg_private_player__is_identity returns whether m is exactly the
+// identity, in which case decoding needs no transform canvas at all.
+static inline bool  //
+iconvg_private_player__is_identity(const iconvg_matrix_2x3_f64* m) {
+  return (m->elems[0][0] == 1.0) && (m->elems[0][1] == 0.0) &&
+         (m->elems[0][2] == 0.0) && (m->elems[1][0] == 0.0) &&
+         (m->elems[1][1] == 1.0) && (m->elems[1][2] == 0.0);
+}
+
+// iconvg_private_player__palette returns the palette for decoding frame. It
+// is either a borrowed one or, when the frame's alpha applies, buf filled in
+// with a copy whose entries that the graphic uses are alpha-scaled.
+static const iconvg_palette*  //
+iconvg_private_player__palette(const iconvg_player* self,
+                               const iconvg_player_frame* frame,
+                               iconvg_palette* buf) {
+  const iconvg_palette* src =
+      frame->palette ? frame->palette : &self->private_impl.palette;
+  uint64_t mask = self->private_impl.palette_mask;
+  // "!(x < 1)" is also true for NaN.
+  if (!(frame->alpha < 1.0f) || !mask) {
+    return src;
+  }
+  float alpha = (frame->alpha > 0.0f) ? frame->alpha : 0.0f;
+  *buf = *src;
+  for (int i = 0; mask; i++, mask >>= 1) {
+    if (mask & 1) {
+      const uint8_t* s = &src->colors[i].rgba[0];
+      uint8_t* d = &buf->colors[i].rgba[0];
+      d[0] = (uint8_t)((((float)s[0]) * alpha) + 0.5f);
+      d[1] = (uint8_t)((((float)s[1]) * alpha) + 0.5f);
+      d[2] = (uint8_t)((((float)s[2]) * alpha) + 0.5f);
+      d[3] = (uint8_t)((((float)s[3]) * alpha) + 0.5f);
+    }
+  }
+  return buf;
+}
+
+// iconvg_private_player__options sets *options for decoding frame to
+// *dst_rect, with buf as per iconvg_private_player__palette. use_transform is
+// whether to set the options' transform: false if the caller applies it some
+// other way.
+static void  //
+iconvg_private_player__options(const iconvg_player* self,
+                               const iconvg_player_frame* frame,
+                               const iconvg_rectangle_f32* dst_rect,
+                               bool use_transform,
+                               iconvg_decode_options* options,
+                               iconvg_palette* buf) {
+  memset(options, 0, sizeof(*options));
+  options->sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+  // The decoders only read the options' palette, despite its non-const type.
+  options->palette =
+      (iconvg_palette*)(iconvg_private_player__palette(self, frame, buf));
+  if (iconvg_private_player__is_identity(&frame->transform)) {
+    // The compiled form stores each drawing's bounds, so culling those
+    // outside of dst_rect is free. With a transform (whether in the options
+    // or the cairo_t's matrix), dst_rect is not what the canvas clips to.
+    options->clip_rect = dst_rect;
+  } else if (use_transform) {
+    options->transform = &frame->transform;
+  }
+}
+
+// ----
+
+iconvg_player_frame  //
+iconvg_player_frame__make(void) {
+  iconvg_player_frame f;
+  f.transform = iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+  f.palette = NULL;
+  f.alpha = 1.0f;
+  return f;
+}
+
+const char*  //
+iconvg_player__initialize(iconvg_player* self,
+                          const uint8_t* compiled_ptr,
+                          size_t compiled_len,
+                          const iconvg_palette* palette,
+                          iconvg_coverage_masks* masks) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  ICONVG_PRIVATE_TRY(iconvg_private_decode_compiled_header(
+      &self->private_impl.palette, &self->private_impl.palette_mask,
+      compiled_ptr, compiled_len));
+  if (palette) {
+    self->private_impl.palette = *palette;
+  }
+  self->private_impl.compiled_ptr = compiled_ptr;
+  self->private_impl.compiled_len = compiled_len;
+  self->private_impl.masks = masks;
+  return NULL;
+}
+
+const char*  //
+iconvg_player__render(iconvg_player* self,
+                      iconvg_canvas* dst_canvas,
+                      iconvg_rectangle_f32 dst_rect,
+                      const iconvg_player_frame* frame) {
+  if (!self || !self->private_impl.compiled_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_player_frame default_frame;
+  if (!frame) {
+    default_frame = iconvg_player_frame__make();
+    frame = &default_frame;
+  }
+
+  bool pushed =
+      !iconvg_private_player__is_identity(&frame->transform) &&
+      iconvg_private_cairo_canvas__push_transform(dst_canvas,
+                                                  &frame->transform);
+  iconvg_decode_options options;
+  iconvg_palette buf;
+  iconvg_private_player__options(self, frame, &dst_rect, !pushed, &options,
+                                 &buf);
+  const char* err_msg = iconvg_decode_compiled(
+      dst_canvas, dst_rect, self->private_impl.compiled_ptr,
+      self->private_impl.compiled_len, &options);
+  if (pushed) {
+    iconvg_private_cairo_canvas__pop_transform(dst_canvas);
+  }
+  return err_msg;
+}
+
+const char*  //
+iconvg_player__render_pixels(iconvg_player* self,
+                             uint8_t* pixels_ptr,
+                             size_t pixels_stride,
+                             uint32_t pixels_width,
+                             uint32_t pixels_height,
+                             float* scratch_ptr,
+                             size_t scratch_len,
+                             iconvg_rectangle_f32 dst_rect,
+                             const iconvg_player_frame* frame) {
+  if (!self || !self->private_impl.compiled_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_player_frame default_frame;
+  if (!frame) {
+    default_frame = iconvg_player_frame__make();
+    frame = &default_frame;
+  }
+  iconvg_decode_options options;
+  iconvg_palette buf;
+  iconvg_private_player__options(self, frame, &dst_rect, true, &options,
+                                 &buf);
+
+  iconvg_coverage_masks* masks = self->private_impl.masks;
+  if (masks && self->private_impl.masks_are_valid &&
+      (self->private_impl.masks_pixels_width == pixels_width) &&
+      (self->private_impl.masks_pixels_height == pixels_height) &&
+      !memcmp(&self->private_impl.masks_dst_rect, &dst_rect,
+              sizeof(dst_rect)) &&
+      !memcmp(&self->private_impl.masks_transform, &frame->transform,
+              sizeof(frame->transform))) {
+    return iconvg_coverage_masks__composite(
+        masks, pixels_ptr, pixels_stride, pixels_width, pixels_height,
+        dst_rect, self->private_impl.compiled_ptr,
+        self->private_impl.compiled_len, &options);
+  }
+
+  // Re-record the masks (if any) while rasterizing. They are only valid again
+  // if the whole frame was recorded.
+  self->private_impl.masks_are_valid = false;
+  iconvg_canvas c =
+      masks ? iconvg_canvas__make_rasterizer_with_coverage_masks(
+                  pixels_ptr, pixels_stride, pixels_width, pixels_height,
+                  scratch_ptr, scratch_len, masks)
+            : iconvg_canvas__make_rasterizer(pixels_ptr, pixels_stride,
+                                             pixels_width, pixels_height,
+                                             scratch_ptr, scratch_len);
+  ICONVG_PRIVATE_TRY(iconvg_decode_compiled(
+      &c, dst_rect, self->private_impl.compiled_ptr,
+      self->private_impl.compiled_len, &options));
+  if (masks && !masks->private_impl.overflowed) {
+    self->private_impl.masks_are_valid = true;
+    self->private_impl.masks_pixels_width = pixels_width;
+    self->private_impl.masks_pixels_height = pixels_height;
+    self->private_impl.masks_dst_rect = dst_rect;
+    self->private_impl.masks_transform = frame->transform;
+  }
+  return NULL;
+}
@@ -0,0 +1,1429 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// The rasterizer canvas is a signed-area coverage accumulation rasterizer, in
+// the style of font-rs (https://github.com/raphlinus/font-rs) and libart.
+//
+// Each path segment (with curves flattened to lines) adds its signed area
+// contribution to an accumulation buffer, one float per pixel. At the end of
+// each drawing, a running (prefix) sum along each row gives that pixel's
+// winding-weighted coverage, which is clamped to 1 (a non-zero fill rule) and
+// used to composite the drawing's paint onto the pixel buffer.
+//
+// The iconvg_canvas' context fields hold:
+//  - nonconst_ptr1: the pixel buffer.
+//  - nonconst_ptr2: the scratch buffer, starting with an
+//    iconvg_private_rasterizer header followed by the accumulation buffer and
+//    then one row of 8-bit coverage values.
+//  - extra5: the pixel buffer's stride, in bytes.
+//  - extra6: the pixel buffer's width.
+//  - extra7: the pixel buffer's height.
+//  - const_ptr3: the iconvg_coverage_masks to record into, or NULL. It is
+//    only const because the context field is.
+
+// iconvg_private_rasterizer only holds fields with at most float's alignment,
+// as it lives at the start of a caller-supplied float array.
+typedef struct iconvg_private_rasterizer_struct {
+  // The clip rectangle and the accumulation buffer's dirty rectangle are
+  // half-open ranges: min inclusive, max exclusive. Every accumulation buffer
+  // element outside of the dirty rectangle is zero. It can extend past the
+  // pixel width, into the ICONVG_PRIVATE_RASTERIZER_ACC_SLACK columns.
+  int32_t clip_min_x;
+  int32_t clip_min_y;
+  int32_t clip_max_x;
+  int32_t clip_max_y;
+  int32_t dirty_min_x;
+  int32_t dirty_min_y;
+  int32_t dirty_max_x;
+  int32_t dirty_max_y;
+
+  // kernels is an ICONVG_PRIVATE_RASTERIZER_KERNELS__ETC value, chosen (based
+  // on the CPU's capabilities) when the canvas is made.
+  int32_t kernels;
+
+  // The current path's start point and current point.
+  float start_x;
+  float start_y;
+  float current_x;
+  float current_y;
+
+  // gradient_lut holds 256 premultiplied RGBA colors, for evenly spaced
+  // gradient offsets from 0.0 to 1.0 inclusive.
+  uint8_t gradient_lut[256 * 4];
+} iconvg_private_rasterizer;
+
+// ICONVG_PRIVATE_RASTERIZER_HEADER_LEN is the number of floats, at the start
+// of the scratch buffer, spanned by the iconvg_private_rasterizer.
+#define ICONVG_PRIVATE_RASTERIZER_HEADER_LEN \
+  ((sizeof(iconvg_private_rasterizer) + sizeof(float) - 1) / sizeof(float))
+
+// Each accumulation buffer row has 2 more floats than the pixel width. A line
+// segment touching the right edge can write up to 2 elements past the last
+// pixel and those elements are never summed into a pixel's coverage.
+#define ICONVG_PRIVATE_RASTERIZER_ACC_SLACK 2
+
+// ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN is the maximum number of line
+// segments that flatten one quadratic or cubic Bézier curve.
+#define ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN 256
+
+static inline iconvg_private_rasterizer*  //
+iconvg_private_rasterizer_canvas__state(iconvg_canvas* c) {
+  return (iconvg_private_rasterizer*)(c->context.nonconst_ptr2);
+}
+
+static inline float*  //
+iconvg_private_rasterizer_canvas__acc(iconvg_canvas* c) {
+  return ((float*)(c->context.nonconst_ptr2)) +
+         ICONVG_PRIVATE_RASTERIZER_HEADER_LEN;
+}
+
+static inline uint8_t*  //
+iconvg_private_rasterizer_canvas__coverage(iconvg_canvas* c) {
+  size_t acc_stride =
+      ((size_t)(c->context.extra6)) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  return (uint8_t*)(iconvg_private_rasterizer_canvas__acc(c) +
+                    (acc_stride * ((size_t)(c->context.extra7))));
+}
+
+// iconvg_private_rasterizer__clamp clamps x to the range [0, max]. NaN maps
+// to 0.
+static inline float  //
+iconvg_private_rasterizer__clamp(float x, float max) {
+  if (!(x > 0.0f)) {
+    return 0.0f;
+  } else if (x > max) {
+    return max;
+  }
+  return x;
+}
+
+static inline uint32_t  //
+iconvg_private_rasterizer__mul_u8(uint32_t a, uint32_t b) {
+  return ((a * b) + 127) / 255;
+}
+
+// iconvg_private_rasterizer_canvas__clear_dirty_rows zeroes the accumulation
+// buffer's dirty rectangle, the elements touched since the last clear.
+static void  //
+iconvg_private_rasterizer_canvas__clear_dirty_rows(iconvg_canvas* c) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  if ((r->dirty_min_y < r->dirty_max_y) && (r->dirty_min_x < r->dirty_max_x)) {
+    size_t acc_stride =
+        ((size_t)(c->context.extra6)) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+    size_t n = (size_t)(r->dirty_max_x - r->dirty_min_x);
+    float* row = iconvg_private_rasterizer_canvas__acc(c) +
+                 (((size_t)(r->dirty_min_y)) * acc_stride) +
+                 ((size_t)(r->dirty_min_x));
+    if (n == acc_stride) {
+      memset(row, 0,
+             ((size_t)(r->dirty_max_y - r->dirty_min_y)) * acc_stride *
+                 sizeof(float));
+    } else {
+      for (int32_t iy = r->dirty_min_y; iy < r->dirty_max_y;
+           iy++, row += acc_stride) {
+        memset(row, 0, n * sizeof(float));
+      }
+    }
+  }
+  r->dirty_min_x = (int32_t)(c->context.extra6);
+  r->dirty_min_y = (int32_t)(c->context.extra7);
+  r->dirty_max_x = 0;
+  r->dirty_max_y = 0;
+}
+
+// iconvg_private_rasterizer_canvas__accumulate_line adds the signed area
+// contribution of the line segment from (x0, y0) to (x1, y1) to the
+// accumulation buffer. Parts of the line outside of the pixel buffer's rows
+// are dropped. Parts to the left or right of the pixel buffer are clamped to
+// its left or right edge, which preserves the coverage of every pixel inside.
+static void  //
+iconvg_private_rasterizer_canvas__accumulate_line(iconvg_canvas* c,
+                                                  float x0,
+                                                  float y0,
+                                                  float x1,
+                                                  float y1) {
+  float dir = +1.0f;
+  if (y0 > y1) {
+    float t = x0;
+    x0 = x1;
+    x1 = t;
+    t = y0;
+    y0 = y1;
+    y1 = t;
+    dir = -1.0f;
+  } else if (!(y0 < y1)) {
+    // Horizontal lines (and NaN coordinates) contribute no area.
+    return;
+  }
+
+  const int32_t width = (int32_t)(c->context.extra6);
+  const int32_t height = (int32_t)(c->context.extra7);
+  if ((y0 >= ((float)height)) || (y1 <= 0.0f)) {
+    return;
+  }
+
+  const float dxdy = (x1 - x0) / (y1 - y0);
+  float x = x0;
+  int32_t iy0 = 0;
+  if (y0 < 0.0f) {
+    x -= y0 * dxdy;
+    y0 = 0.0f;
+  } else {
+    iy0 = (int32_t)y0;
+  }
+  int32_t iy1 = (y1 < ((float)height)) ? ((int32_t)(ceilf(y1))) : height;
+
+  // Within each row, the elements written are from floor(xa) to ceil(xb) + 1
+  // inclusive, for the row's clamped x range [xa, xb]. The whole line's
+  // clamped x range bounds every row's, give or take the rounding error of
+  // stepping x from row to row, so the dirty columns get a 1 element margin.
+  const float fwidth = (float)width;
+  float xlo = iconvg_private_rasterizer__clamp(x0, fwidth);
+  float xhi = iconvg_private_rasterizer__clamp(x1, fwidth);
+  if (xlo > xhi) {
+    float t = xlo;
+    xlo = xhi;
+    xhi = t;
+  }
+  int32_t ix0 = ((int32_t)floorf(xlo)) - 1;
+  ix0 = (ix0 > 0) ? ix0 : 0;
+  int32_t ix1 = ((int32_t)ceilf(xhi)) + 3;
+  ix1 = (ix1 < (width + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK))
+            ? ix1
+            : (width + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK);
+
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  if (r->dirty_min_x > ix0) {
+    r->dirty_min_x = ix0;
+  }
+  if (r->dirty_min_y > iy0) {
+    r->dirty_min_y = iy0;
+  }
+  if (r->dirty_max_x < ix1) {
+    r->dirty_max_x = ix1;
+  }
+  if (r->dirty_max_y < iy1) {
+    r->dirty_max_y = iy1;
+  }
+
+  const size_t acc_stride =
+      ((size_t)width) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  float* row = iconvg_private_rasterizer_canvas__acc(c) +
+               (((size_t)iy0) * acc_stride);
+  for (int32_t iy = iy0; iy < iy1; iy++, row += acc_stride) {
+    float fy = (float)iy;
+    float dy = (((fy + 1.0f) < y1) ? (fy + 1.0f) : y1) - ((fy > y0) ? fy : y0);
+    float x_next = x + (dxdy * dy);
+    float d = dy * dir;
+
+    float xa = iconvg_private_rasterizer__clamp(x, fwidth);
+    float xb = iconvg_private_rasterizer__clamp(x_next, fwidth);
+    x = x_next;
+    if (xa > xb) {
+      float t = xa;
+      xa = xb;
+      xb = t;
+    }
+
+    float xa_floor = floorf(xa);
+    int32_t ia = (int32_t)xa_floor;
+    float xb_ceil = ceilf(xb);
+    int32_t ib = (int32_t)xb_ceil;
+
+    if (ib <= (ia + 1)) {
+      // The line (within this row) touches only one pixel column.
+      float xm = (0.5f * (xa + xb)) - xa_floor;
+      row[ia] += d - (d * xm);
+      row[ia + 1] += d * xm;
+      continue;
+    }
+
+    // The line spans multiple pixel columns. Its area contribution is a
+    // triangle in the first column, a triangle in the last column and a
+    // linear ramp in between.
+    float s = 1.0f / (xb - xa);
+    float xa_frac = xa - xa_floor;
+    float a0 = 0.5f * s * (1.0f - xa_frac) * (1.0f - xa_frac);
+    float xb_frac = xb - xb_ceil + 1.0f;
+    float am = 0.5f * s * xb_frac * xb_frac;
+    row[ia] += d * a0;
+    if (ib == (ia + 2)) {
+      row[ia + 1] += d * (1.0f - a0 - am);
+    } else {
+      float a1 = s * (1.5f - xa_frac);
+      row[ia + 1] += d * (a1 - a0);
+      float ds = d * s;
+      for (int32_t ix = ia + 2; ix < (ib - 1); ix++) {
+        row[ix] += ds;
+      }
+      float a2 = a1 + (((float)(ib - ia - 3)) * s);
+      row[ib - 1] += d * (1.0f - a2 - am);
+    }
+    row[ib] += d * am;
+  }
+}
+
+static void  //
+iconvg_private_rasterizer_canvas__line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  iconvg_private_rasterizer_canvas__accumulate_line(c, r->current_x,
+                                                    r->current_y, x1, y1);
+  r->current_x = x1;
+  r->current_y = y1;
+}
+
+// iconvg_private_rasterizer__flatten_count returns the number of line
+// segments that approximate a Bézier curve to within 0.1 pixels, given the
+// curve's maximum second difference dd. The second derivative is at most k *
+// dd, with k = 2 for quadratics and k = 6 for cubics, and a chord over a t
+// interval of length h deviates from the curve by at most (k * dd * h²) / 8.
+static inline int32_t  //
+iconvg_private_rasterizer__flatten_count(float k_times_dd) {
+  float n = sqrtf(k_times_dd * (10.0f / 8.0f));
+  if (n < (ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN - 1)) {
+    return 1 + (int32_t)n;
+  }
+  // This also catches NaN.
+  return ICONVG_PRIVATE_RASTERIZER_MAX_FLATTEN;
+}
+
+static void  //
+iconvg_private_rasterizer_canvas__quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  float x0 = r->current_x;
+  float y0 = r->current_y;
+  float ddx = x0 - (2.0f * x1) + x2;
+  float ddy = y0 - (2.0f * y1) + y2;
+  int32_t n = iconvg_private_rasterizer__flatten_count(
+      2.0f * sqrtf((ddx * ddx) + (ddy * ddy)));
+  float inv_n = 1.0f / ((float)n);
+  for (int32_t i = 1; i < n; i++) {
+    float t = ((float)i) * inv_n;
+    float u = 1.0f - t;
+    float b0 = u * u;
+    float b1 = 2.0f * u * t;
+    float b2 = t * t;
+    iconvg_private_rasterizer_canvas__line_to(
+        c, (b0 * x0) + (b1 * x1) + (b2 * x2),  //
+        (b0 * y0) + (b1 * y1) + (b2 * y2));
+  }
+  iconvg_private_rasterizer_canvas__line_to(c, x2, y2);
+}
+
+static void  //
+iconvg_private_rasterizer_canvas__cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  float x0 = r->current_x;
+  float y0 = r->current_y;
+  float ddx0 = x0 - (2.0f * x1) + x2;
+  float ddy0 = y0 - (2.0f * y1) + y2;
+  float ddx1 = x1 - (2.0f * x2) + x3;
+  float ddy1 = y1 - (2.0f * y2) + y3;
+  float dd0 = (ddx0 * ddx0) + (ddy0 * ddy0);
+  float dd1 = (ddx1 * ddx1) + (ddy1 * ddy1);
+  int32_t n = iconvg_private_rasterizer__flatten_count(
+      6.0f * sqrtf((dd0 > dd1) ? dd0 : dd1));
+  float inv_n = 1.0f / ((float)n);
+  for (int32_t i = 1; i < n; i++) {
+    float t = ((float)i) * inv_n;
+    float u = 1.0f - t;
+    float b0 = u * u * u;
+    float b1 = 3.0f * u * u * t;
+    float b2 = 3.0f * u * t * t;
+    float b3 = t * t * t;
+    iconvg_private_rasterizer_canvas__line_to(
+        c, (b0 * x0) + (b1 * x1) + (b2 * x2) + (b3 * x3),
+        (b0 * y0) + (b1 * y1) + (b2 * y2) + (b3 * y3));
+  }
+  iconvg_private_rasterizer_canvas__line_to(c, x3, y3);
+}
+
+// iconvg_private_rasterizer_canvas__fill_gradient_lut sets r->gradient_lut
+// from p's gradient stops, interpolating in premultiplied alpha space.
+static void  //
+iconvg_private_rasterizer__fill_gradient_lut(uint8_t* lut,
+                                             const iconvg_paint* p) {
+  uint32_t num_stops = iconvg_paint__gradient_number_of_stops(p);
+  if (num_stops == 0) {
+    memset(lut, 0, 256 * 4);
+    return;
+  }
+
+  uint32_t j = 0;
+  for (uint32_t i = 0; i < 256; i++) {
+    float t = ((float)i) / 255.0f;
+    while (((j + 1) < num_stops) &&
+           (iconvg_paint__gradient_stop_offset(p, j + 1) <= t)) {
+      j++;
+    }
+    uint8_t* dst = &lut[4 * i];
+
+    float offset0 = iconvg_paint__gradient_stop_offset(p, j);
+    iconvg_premul_color k0 =
+        iconvg_paint__gradient_stop_color_as_premul_color(p, j);
+    if ((t <= offset0) || ((j + 1) >= num_stops)) {
+      memcpy(dst, &k0.rgba[0], 4);
+      continue;
+    }
+
+    float offset1 = iconvg_paint__gradient_stop_offset(p, j + 1);
+    iconvg_premul_color k1 =
+        iconvg_paint__gradient_stop_color_as_premul_color(p, j + 1);
+    float w1 = (t - offset0) / (offset1 - offset0);
+    float w0 = 1.0f - w1;
+    for (int ch = 0; ch < 4; ch++) {
+      dst[ch] = (uint8_t)((w0 * k0.rgba[ch]) + (w1 * k1.rgba[ch]) + 0.5f);
+    }
+  }
+}
+
+// iconvg_private_rasterizer__gradient_lut_index applies the spread to a
+// gradient offset t and returns the gradient_lut index, or -1 for transparent
+// (which only happens with ICONVG_GRADIENT_SPREAD__NONE).
+static inline int32_t  //
+iconvg_private_rasterizer__gradient_lut_index(double t,
+                                              iconvg_gradient_spread spread) {
+  switch (spread) {
+    case ICONVG_GRADIENT_SPREAD__NONE:
+      if ((t < 0.0) || (t > 1.0)) {
+        return -1;
+      }
+      break;
+    case ICONVG_GRADIENT_SPREAD__REFLECT:
+      t = fabs(t);
+      t -= 2.0 * floor(t / 2.0);
+      if (t > 1.0) {
+        t = 2.0 - t;
+      }
+      break;
+    case ICONVG_GRADIENT_SPREAD__REPEAT:
+      t -= floor(t);
+      break;
+    default:
+      break;
+  }
+  // Clamping also implements ICONVG_GRADIENT_SPREAD__PAD and maps NaN (e.g.
+  // from infinite coordinates) to 0.
+  if (!(t > 0.0)) {
+    return 0;
+  } else if (t < 1.0) {
+    return (int32_t)((t * 255.0) + 0.5);
+  }
+  return 255;
+}
+
+// ----
+
+// The end_drawing inner loops are, per row of pixels, "accumulate" (convert
+// the accumulation buffer to 8-bit coverage) and "blend_flat" (composite a
+// flat color, weighted by that coverage, onto the pixels). Both have SIMD
+// implementations, chosen at run time (x86) or compile time (ARM). They all
+// produce the same results as the scalar implementations, other than rounding
+// differences (from re-ordered floating point additions) in accumulate.
+//
+// Compiling with ICONVG_CONFIG__DISABLE_SIMD uses the scalar implementations
+// on every CPU.
+
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__SCALAR 0
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__SSE41 1
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__AVX2 2
+#define ICONVG_PRIVATE_RASTERIZER_KERNELS__NEON 3
+
+#if !defined(ICONVG_CONFIG__DISABLE_SIMD)
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define ICONVG_PRIVATE_HAVE_X86_SIMD
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ICONVG_PRIVATE_HAVE_ARM_NEON
+#include <arm_neon.h>
+#endif
+#endif  // !defined(ICONVG_CONFIG__DISABLE_SIMD)
+
+typedef struct iconvg_private_rasterizer_kernels_struct {
+  // accumulate sets dst[i], for i in 0 .. n, to the 8-bit coverage for the
+  // prefix sum (accumulator + src[0] + src[1] + ... + src[i]).
+  void (*accumulate)(uint8_t* dst,
+                     const float* src,
+                     size_t n,
+                     float accumulator);
+  // blend_flat composites the premultiplied RGBA color src, with coverage
+  // cov[i], onto the i'th RGBA pixel of dst, for i in 0 .. n.
+  void (*blend_flat)(uint8_t* dst,
+                     const uint8_t* cov,
+                     size_t n,
+                     const uint8_t* src);
+} iconvg_private_rasterizer_kernels;
+
+// iconvg_private_rasterizer__blend_pixel composites src onto dst (both are 4
+// bytes of premultiplied RGBA) with the SRC_OVER operator and 8-bit coverage.
+static inline void  //
+iconvg_private_rasterizer__blend_pixel(uint8_t* dst,
+                                       uint32_t cov,
+                                       const uint8_t* src) {
+  uint32_t sa = iconvg_private_rasterizer__mul_u8(src[3], cov);
+  uint32_t inv_sa = 0xFF - sa;
+  for (int i = 0; i < 4; i++) {
+    uint32_t v = iconvg_private_rasterizer__mul_u8(src[i], cov) +
+                 iconvg_private_rasterizer__mul_u8(dst[i], inv_sa);
+    dst[i] = (uint8_t)((v < 0xFF) ? v : 0xFF);
+  }
+}
+
+static void  //
+iconvg_private_rasterizer__accumulate_scalar(uint8_t* dst,
+                                             const float* src,
+                                             size_t n,
+                                             float accumulator) {
+  for (size_t i = 0; i < n; i++) {
+    accumulator += src[i];
+    float coverage = fabsf(accumulator);
+    dst[i] = (coverage < 1.0f) ? ((uint8_t)((coverage * 255.0f) + 0.5f))
+                               : 0xFF;
+  }
+}
+
+static void  //
+iconvg_private_rasterizer__blend_flat_scalar(uint8_t* dst,
+                                             const uint8_t* cov,
+                                             size_t n,
+                                             const uint8_t* src) {
+  for (size_t i = 0; i < n; i++, dst += 4) {
+    if (cov[i] == 0) {
+      continue;
+    } else if ((cov[i] == 0xFF) && (src[3] == 0xFF)) {
+      memcpy(dst, src, 4);
+      continue;
+    }
+    iconvg_private_rasterizer__blend_pixel(dst, cov[i], src);
+  }
+}
+
+#if defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+
+// The SSE4.1 accumulate kernel computes an in-register prefix sum of 4 floats
+// (with 2 shift-and-add steps) and carries the last lane to the next 4.
+__attribute__((target("sse4.1"))) static void  //
+iconvg_private_rasterizer__accumulate_sse41(uint8_t* dst,
+                                            const float* src,
+                                            size_t n,
+                                            float accumulator) {
+  const __m128 sign_bit = _mm_set1_ps(-0.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 k255 = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128i low_bytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,  //
+                                          -1, -1, -1, -1, -1, -1, -1, -1);
+  __m128 offset = _mm_set1_ps(accumulator);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(src + i);
+    x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+    x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+    x = _mm_add_ps(x, offset);
+    offset = _mm_shuffle_ps(x, x, 0xFF);
+    // _mm_min_ps returns its second argument (one) if x is NaN, matching the
+    // scalar code.
+    __m128 y = _mm_min_ps(_mm_andnot_ps(sign_bit, x), one);
+    y = _mm_add_ps(_mm_mul_ps(y, k255), half);
+    __m128i z = _mm_shuffle_epi8(_mm_cvttps_epi32(y), low_bytes);
+    uint32_t u = (uint32_t)_mm_cvtsi128_si32(z);
+    memcpy(dst + i, &u, 4);
+  }
+  iconvg_private_rasterizer__accumulate_scalar(dst + i, src + i, n - i,
+                                               _mm_cvtss_f32(offset));
+}
+
+// iconvg_private_rasterizer__div255_epi16 returns ((x + 127) / 255) for each
+// uint16_t lane x, for x <= 0xFE01 (which is 0xFF * 0xFF).
+__attribute__((target("sse4.1"))) static inline __m128i  //
+iconvg_private_rasterizer__div255_epi16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(127));
+  x = _mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8));
+  return _mm_srli_epi16(x, 8);
+}
+
+// iconvg_private_rasterizer__blend2_sse41 blends 2 pixels, as 8 uint16_t
+// lanes. s is the src color (repeated twice) and c is each pixel's coverage
+// (repeated 4 times).
+__attribute__((target("sse4.1"))) static inline __m128i  //
+iconvg_private_rasterizer__blend2_sse41(__m128i d, __m128i s, __m128i c) {
+  __m128i sc = iconvg_private_rasterizer__div255_epi16(_mm_mullo_epi16(s, c));
+  __m128i sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sc, 0xFF), 0xFF);
+  __m128i inv_sa = _mm_sub_epi16(_mm_set1_epi16(0xFF), sa);
+  __m128i dc =
+      iconvg_private_rasterizer__div255_epi16(_mm_mullo_epi16(d, inv_sa));
+  return _mm_add_epi16(sc, dc);
+}
+
+__attribute__((target("sse4.1"))) static void  //
+iconvg_private_rasterizer__blend_flat_sse41(uint8_t* dst,
+                                            const uint8_t* cov,
+                                            size_t n,
+                                            const uint8_t* src) {
+  uint32_t src_u32;
+  memcpy(&src_u32, src, 4);
+  const bool opaque = src[3] == 0xFF;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i src4 = _mm_set1_epi32((int32_t)src_u32);
+  const __m128i s = _mm_unpacklo_epi8(src4, zero);
+  const __m128i cov01 = _mm_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1,  //
+                                      1, -1, 1, -1, 1, -1, 1, -1);
+  const __m128i cov23 = _mm_setr_epi8(2, -1, 2, -1, 2, -1, 2, -1,  //
+                                      3, -1, 3, -1, 3, -1, 3, -1);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4, dst += 16) {
+    uint32_t c4;
+    memcpy(&c4, cov + i, 4);
+    if (c4 == 0) {
+      continue;
+    } else if (opaque && (c4 == 0xFFFFFFFF)) {
+      _mm_storeu_si128((__m128i*)dst, src4);
+      continue;
+    }
+    __m128i c = _mm_cvtsi32_si128((int32_t)c4);
+    __m128i d = _mm_loadu_si128((const __m128i*)dst);
+    __m128i lo = iconvg_private_rasterizer__blend2_sse41(
+        _mm_unpacklo_epi8(d, zero), s, _mm_shuffle_epi8(c, cov01));
+    __m128i hi = iconvg_private_rasterizer__blend2_sse41(
+        _mm_unpackhi_epi8(d, zero), s, _mm_shuffle_epi8(c, cov23));
+    // _mm_packus_epi16 saturates, like the scalar code's "min(v, 0xFF)".
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+  }
+  iconvg_private_rasterizer__blend_flat_scalar(dst, cov + i, n - i, src);
+}
+
+// iconvg_private_rasterizer__div255_epi16_avx2 is the 256-bit equivalent of
+// iconvg_private_rasterizer__div255_epi16.
+__attribute__((target("avx2"))) static inline __m256i  //
+iconvg_private_rasterizer__div255_epi16_avx2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(127));
+  x = _mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)),
+                       _mm256_srli_epi16(x, 8));
+  return _mm256_srli_epi16(x, 8);
+}
+
+__attribute__((target("avx2"))) static inline __m256i  //
+iconvg_private_rasterizer__blend4_avx2(__m256i d, __m256i s, __m256i c) {
+  __m256i sc =
+      iconvg_private_rasterizer__div255_epi16_avx2(_mm256_mullo_epi16(s, c));
+  __m256i sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sc, 0xFF), 0xFF);
+  __m256i inv_sa = _mm256_sub_epi16(_mm256_set1_epi16(0xFF), sa);
+  __m256i dc = iconvg_private_rasterizer__div255_epi16_avx2(
+      _mm256_mullo_epi16(d, inv_sa));
+  return _mm256_add_epi16(sc, dc);
+}
+
+// The AVX2 blend_flat kernel handles 8 pixels per iteration. The 256-bit
+// unpack and pack instructions work within each 128-bit half, so the low half
+// of lo (and hi) holds pixels 0 and 1 (and 2 and 3) and the high half holds
+// pixels 4 and 5 (and 6 and 7), and _mm256_packus_epi16 restores their order.
+__attribute__((target("avx2"))) static void  //
+iconvg_private_rasterizer__blend_flat_avx2(uint8_t* dst,
+                                           const uint8_t* cov,
+                                           size_t n,
+                                           const uint8_t* src) {
+  uint32_t src_u32;
+  memcpy(&src_u32, src, 4);
+  const bool opaque = src[3] == 0xFF;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i src8 = _mm256_set1_epi32((int32_t)src_u32);
+  const __m256i s = _mm256_unpacklo_epi8(src8, zero);
+  const __m256i cov0145 = _mm256_setr_epi8(
+      0, -1, 0, -1, 0, -1, 0, -1, 1, -1, 1, -1, 1, -1, 1, -1,  //
+      4, -1, 4, -1, 4, -1, 4, -1, 5, -1, 5, -1, 5, -1, 5, -1);
+  const __m256i cov2367 = _mm256_setr_epi8(
+      2, -1, 2, -1, 2, -1, 2, -1, 3, -1, 3, -1, 3, -1, 3, -1,  //
+      6, -1, 6, -1, 6, -1, 6, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8, dst += 32) {
+    uint64_t c8;
+    memcpy(&c8, cov + i, 8);
+    if (c8 == 0) {
+      continue;
+    } else if (opaque && (c8 == 0xFFFFFFFFFFFFFFFFull)) {
+      _mm256_storeu_si256((__m256i*)dst, src8);
+      continue;
+    }
+    __m256i c = _mm256_broadcastsi128_si256(
+        _mm_loadl_epi64((const __m128i*)(cov + i)));
+    __m256i d = _mm256_loadu_si256((const __m256i*)dst);
+    __m256i lo = iconvg_private_rasterizer__blend4_avx2(
+        _mm256_unpacklo_epi8(d, zero), s, _mm256_shuffle_epi8(c, cov0145));
+    __m256i hi = iconvg_private_rasterizer__blend4_avx2(
+        _mm256_unpackhi_epi8(d, zero), s, _mm256_shuffle_epi8(c, cov2367));
+    _mm256_storeu_si256((__m256i*)dst, _mm256_packus_epi16(lo, hi));
+  }
+  iconvg_private_rasterizer__blend_flat_sse41(dst, cov + i, n - i, src);
+}
+
+#endif  // defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+
+#if defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+
+static void  //
+iconvg_private_rasterizer__accumulate_neon(uint8_t* dst,
+                                           const float* src,
+                                           size_t n,
+                                           float accumulator) {
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t k255 = vdupq_n_f32(255.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  float32x4_t offset = vdupq_n_f32(accumulator);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    float32x4_t x = vld1q_f32(src + i);
+    x = vaddq_f32(x, vextq_f32(zero, x, 3));
+    x = vaddq_f32(x, vextq_f32(zero, x, 2));
+    x = vaddq_f32(x, offset);
+    offset = vdupq_n_f32(vgetq_lane_f32(x, 3));
+    float32x4_t y = vminq_f32(vabsq_f32(x), one);
+    y = vaddq_f32(vmulq_f32(y, k255), half);
+    uint16x4_t z16 = vmovn_u32(vcvtq_u32_f32(y));
+    uint8x8_t z8 = vmovn_u16(vcombine_u16(z16, z16));
+    uint32_t u = vget_lane_u32(vreinterpret_u32_u8(z8), 0);
+    memcpy(dst + i, &u, 4);
+  }
+  iconvg_private_rasterizer__accumulate_scalar(dst + i, src + i, n - i,
+                                               vgetq_lane_f32(offset, 3));
+}
+
+// iconvg_private_rasterizer__div255_u16 returns ((x + 127) / 255) for each
+// uint16_t lane x, for x <= 0xFE01 (which is 0xFF * 0xFF).
+static inline uint16x8_t  //
+iconvg_private_rasterizer__div255_u16(uint16x8_t x) {
+  x = vaddq_u16(x, vdupq_n_u16(127));
+  x = vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8));
+  return vshrq_n_u16(x, 8);
+}
+
+// iconvg_private_rasterizer__blend2_neon blends 2 pixels. s is the src color
+// (repeated twice) and c is each pixel's coverage (repeated 4 times).
+static inline uint8x8_t  //
+iconvg_private_rasterizer__blend2_neon(uint8x8_t d, uint8x8_t s, uint8x8_t c) {
+  uint16x8_t sc = iconvg_private_rasterizer__div255_u16(vmull_u8(s, c));
+  uint16x8_t sa = vcombine_u16(vdup_lane_u16(vget_low_u16(sc), 3),
+                               vdup_lane_u16(vget_high_u16(sc), 3));
+  uint8x8_t inv_sa = vmovn_u16(vsubq_u16(vdupq_n_u16(0xFF), sa));
+  uint16x8_t dc = iconvg_private_rasterizer__div255_u16(vmull_u8(d, inv_sa));
+  return vqmovn_u16(vaddq_u16(sc, dc));
+}
+
+static void  //
+iconvg_private_rasterizer__blend_flat_neon(uint8_t* dst,
+                                           const uint8_t* cov,
+                                           size_t n,
+                                           const uint8_t* src) {
+  uint32_t src_u32;
+  memcpy(&src_u32, src, 4);
+  const bool opaque = src[3] == 0xFF;
+  const uint8x16_t src4 = vreinterpretq_u8_u32(vdupq_n_u32(src_u32));
+  const uint8x8_t s = vget_low_u8(src4);
+  const uint8x8_t cov01 = vcreate_u8(0x0101010100000000ull);
+  const uint8x8_t cov23 = vcreate_u8(0x0303030302020202ull);
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4, dst += 16) {
+    uint32_t c4;
+    memcpy(&c4, cov + i, 4);
+    if (c4 == 0) {
+      continue;
+    } else if (opaque && (c4 == 0xFFFFFFFF)) {
+      vst1q_u8(dst, src4);
+      continue;
+    }
+    uint8x8_t c = vreinterpret_u8_u32(vdup_n_u32(c4));
+    uint8x16_t d = vld1q_u8(dst);
+    uint8x8_t lo = iconvg_private_rasterizer__blend2_neon(
+        vget_low_u8(d), s, vtbl1_u8(c, cov01));
+    uint8x8_t hi = iconvg_private_rasterizer__blend2_neon(
+        vget_high_u8(d), s, vtbl1_u8(c, cov23));
+    vst1q_u8(dst, vcombine_u8(lo, hi));
+  }
+  iconvg_private_rasterizer__blend_flat_scalar(dst, cov + i, n - i, src);
+}
+
+#endif  // defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+
+// iconvg_private_rasterizer_kernels_table is indexed by
+// ICONVG_PRIVATE_RASTERIZER_KERNELS__ETC values. Entries for SIMD flavors
+// that aren't compiled in fall back to the scalar kernels.
+static const iconvg_private_rasterizer_kernels
+    iconvg_private_rasterizer_kernels_table[4] = {
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+#if defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+        {
+            &iconvg_private_rasterizer__accumulate_sse41,
+            &iconvg_private_rasterizer__blend_flat_sse41,
+        },
+        {
+            &iconvg_private_rasterizer__accumulate_sse41,
+            &iconvg_private_rasterizer__blend_flat_avx2,
+        },
+#else
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+#endif
+#if defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+        {
+            &iconvg_private_rasterizer__accumulate_neon,
+            &iconvg_private_rasterizer__blend_flat_neon,
+        },
+#else
+        {
+            &iconvg_private_rasterizer__accumulate_scalar,
+            &iconvg_private_rasterizer__blend_flat_scalar,
+        },
+#endif
+};
+
+static int32_t  //
+iconvg_private_rasterizer__choose_kernels(void) {
+#if defined(ICONVG_PRIVATE_HAVE_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ICONVG_PRIVATE_RASTERIZER_KERNELS__AVX2;
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    return ICONVG_PRIVATE_RASTERIZER_KERNELS__SSE41;
+  }
+#elif defined(ICONVG_PRIVATE_HAVE_ARM_NEON)
+  return ICONVG_PRIVATE_RASTERIZER_KERNELS__NEON;
+#endif
+  return ICONVG_PRIVATE_RASTERIZER_KERNELS__SCALAR;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__begin_decode(iconvg_canvas* c,
+                                               iconvg_rectangle_f32 dst_rect) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  float fwidth = (float)(c->context.extra6);
+  float fheight = (float)(c->context.extra7);
+  r->clip_min_x = (int32_t)floorf(
+      iconvg_private_rasterizer__clamp(dst_rect.min_x, fwidth));
+  r->clip_min_y = (int32_t)floorf(
+      iconvg_private_rasterizer__clamp(dst_rect.min_y, fheight));
+  r->clip_max_x =
+      (int32_t)ceilf(iconvg_private_rasterizer__clamp(dst_rect.max_x, fwidth));
+  r->clip_max_y = (int32_t)ceilf(
+      iconvg_private_rasterizer__clamp(dst_rect.max_y, fheight));
+  iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+
+  iconvg_coverage_masks* masks =
+      (iconvg_coverage_masks*)(c->context.const_ptr3);
+  if (masks) {
+    masks->private_impl.buf_used = 0;
+    masks->private_impl.num_masks = 0;
+    masks->private_impl.dst_rect[0] = dst_rect.min_x;
+    masks->private_impl.dst_rect[1] = dst_rect.min_y;
+    masks->private_impl.dst_rect[2] = dst_rect.max_x;
+    masks->private_impl.dst_rect[3] = dst_rect.max_y;
+    masks->private_impl.pixels_width = (uint32_t)(c->context.extra6);
+    masks->private_impl.pixels_height = (uint32_t)(c->context.extra7);
+    masks->private_impl.overflowed = false;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__end_decode(iconvg_canvas* c,
+                                             const char* err_msg,
+                                             size_t num_bytes_consumed,
+                                             size_t num_bytes_remaining) {
+  // A failed decode can leave a drawing unfinished.
+  iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  r->start_x = 0.0f;
+  r->start_y = 0.0f;
+  r->current_x = 0.0f;
+  r->current_y = 0.0f;
+  return NULL;
+}
+
+// ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN is the length, in bytes, of each
+// drawing's record header in an iconvg_coverage_masks buffer: four uint32
+// values (little-endian) for min_x, min_y, width and height, the rectangle
+// that bounds the drawing's coverage. The header is followed by height rows.
+#define ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN 16
+
+// ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN is the length, in bytes, of
+// each row's header: two uint32 values (little-endian) for the row's x offset
+// (relative to min_x) and length n. The row header is followed by n coverage
+// bytes, which start and end with non-zero coverage. A row whose coverage is
+// all zero has n = 0.
+#define ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN 8
+
+// iconvg_private_coverage_masks__reserve claims the next len bytes of the
+// buffer and returns where they start, or NULL if they do not fit. Either way,
+// buf_used grows by len (saturating at SIZE_MAX), so that it ends up as the
+// required length.
+static uint8_t*  //
+iconvg_private_coverage_masks__reserve(iconvg_coverage_masks* self,
+                                       size_t len) {
+  size_t used = self->private_impl.buf_used;
+  if (self->private_impl.overflowed ||
+      (len > (self->private_impl.buf_len - used))) {
+    self->private_impl.overflowed = true;
+    self->private_impl.buf_used = (len > (SIZE_MAX - used)) ? SIZE_MAX  //
+                                                            : (used + len);
+    return NULL;
+  }
+  self->private_impl.buf_used = used + len;
+  return self->private_impl.buf_ptr + used;
+}
+
+// iconvg_private_coverage_masks__append adds the header of a record for a
+// drawing whose coverage is bounded by the num_rows rows of n pixels each,
+// starting at (min_x, min_y). The caller then adds num_rows row records.
+static void  //
+iconvg_private_coverage_masks__append(iconvg_coverage_masks* self,
+                                      int32_t min_x,
+                                      int32_t min_y,
+                                      int32_t n,
+                                      int32_t num_rows) {
+  self->private_impl.num_masks++;
+  uint8_t* p = iconvg_private_coverage_masks__reserve(
+      self, ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN);
+  if (p) {
+    iconvg_private_poke_u32le(p + 0, (uint32_t)min_x);
+    iconvg_private_poke_u32le(p + 4, (uint32_t)min_y);
+    iconvg_private_poke_u32le(p + 8, (uint32_t)n);
+    iconvg_private_poke_u32le(p + 12, (uint32_t)num_rows);
+  }
+}
+
+// iconvg_private_coverage_masks__append_row adds a row record, for the n
+// coverage bytes that start x pixels to the right of the record's min_x.
+static void  //
+iconvg_private_coverage_masks__append_row(iconvg_coverage_masks* self,
+                                          int32_t x,
+                                          const uint8_t* coverage,
+                                          int32_t n) {
+  uint8_t* p = iconvg_private_coverage_masks__reserve(
+      self, ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN + ((size_t)n));
+  if (p) {
+    iconvg_private_poke_u32le(p + 0, (uint32_t)x);
+    iconvg_private_poke_u32le(p + 4, (uint32_t)n);
+    memcpy(p + ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN, coverage,
+           (size_t)n);
+  }
+}
+
+// iconvg_private_rasterizer_paint is a drawing's paint, prepared for
+// compositing rows of coverage.
+typedef struct iconvg_private_rasterizer_paint_struct {
+  iconvg_paint_type paint_type;
+  uint8_t flat[4];
+  iconvg_gradient_spread spread;
+  iconvg_matrix_2x3_f64 gtm;
+  // gradient_lut points to 256 premultiplied RGBA colors, as per
+  // iconvg_private_rasterizer's field of the same name.
+  const uint8_t* gradient_lut;
+} iconvg_private_rasterizer_paint;
+
+// iconvg_private_rasterizer_paint__initialize prepares p, filling
+// gradient_lut (256 * 4 bytes) if p is a gradient. It returns false if p's
+// paint type is invalid.
+static bool  //
+iconvg_private_rasterizer_paint__initialize(
+    iconvg_private_rasterizer_paint* self,
+    uint8_t* gradient_lut,
+    const iconvg_paint* p) {
+  memset(self, 0, sizeof(*self));
+  self->paint_type = iconvg_paint__type(p);
+  self->gradient_lut = gradient_lut;
+  switch (self->paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+      memcpy(&self->flat[0], &k.rgba[0], 4);
+      return true;
+    }
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      self->spread = iconvg_paint__gradient_spread(p);
+      self->gtm = iconvg_paint__gradient_transformation_matrix(p);
+      iconvg_private_rasterizer__fill_gradient_lut(gradient_lut, p);
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+// iconvg_private_rasterizer_paint__blend_row composites self, weighted by
+// coverage[0 .. n], onto the n pixels starting at pix, which is the pixel at
+// (x0, iy) of the pixel buffer.
+static void  //
+iconvg_private_rasterizer_paint__blend_row(
+    const iconvg_private_rasterizer_paint* self,
+    const iconvg_private_rasterizer_kernels* k,
+    uint8_t* pix,
+    const uint8_t* coverage,
+    int32_t n,
+    int32_t x0,
+    int32_t iy) {
+  if (self->paint_type == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    (*k->blend_flat)(pix, coverage, (size_t)n, &self->flat[0]);
+    return;
+  }
+
+  // For gradients, (gx, gy) is the pattern space position of the center of
+  // the pixel at (ix, iy). It advances by (gtm[0][0], gtm[1][0]) per pixel.
+  const iconvg_matrix_2x3_f64* gtm = &self->gtm;
+  double px = ((double)x0) + 0.5;
+  double py = ((double)iy) + 0.5;
+  double gx = (gtm->elems[0][0] * px) + (gtm->elems[0][1] * py) +  //
+              gtm->elems[0][2];
+  double gy = (gtm->elems[1][0] * px) + (gtm->elems[1][1] * py) +  //
+              gtm->elems[1][2];
+
+  for (int32_t i = 0; i < n;
+       i++, pix += 4, gx += gtm->elems[0][0], gy += gtm->elems[1][0]) {
+    if (coverage[i] == 0) {
+      continue;
+    }
+    int32_t j = iconvg_private_rasterizer__gradient_lut_index(
+        (self->paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT)
+            ? gx
+            : sqrt((gx * gx) + (gy * gy)),
+        self->spread);
+    if (j >= 0) {
+      iconvg_private_rasterizer__blend_pixel(pix, coverage[i],
+                                             &self->gradient_lut[4 * j]);
+    }
+  }
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__end_drawing(iconvg_canvas* c,
+                                              const iconvg_paint* p) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+
+  iconvg_private_rasterizer_paint rp;
+  if (!iconvg_private_rasterizer_paint__initialize(&rp, &r->gradient_lut[0],
+                                                   p)) {
+    iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+    return iconvg_error_invalid_paint_type;
+  }
+
+  // Only the dirty rectangle (clipped) can have non-zero coverage. Elements
+  // to its right sum to zero, as every path is closed.
+  int32_t min_x = (r->dirty_min_x > r->clip_min_x) ? r->dirty_min_x  //
+                                                   : r->clip_min_x;
+  int32_t min_y = (r->dirty_min_y > r->clip_min_y) ? r->dirty_min_y  //
+                                                   : r->clip_min_y;
+  int32_t max_x = (r->dirty_max_x < r->clip_max_x) ? r->dirty_max_x  //
+                                                   : r->clip_max_x;
+  int32_t max_y = (r->dirty_max_y < r->clip_max_y) ? r->dirty_max_y  //
+                                                   : r->clip_max_y;
+  if ((min_x >= max_x) || (min_y >= max_y)) {
+    max_x = min_x;
+    max_y = min_y;
+  }
+  const int32_t n = max_x - min_x;
+  const size_t acc_stride =
+      ((size_t)(c->context.extra6)) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  const float* acc_row = iconvg_private_rasterizer_canvas__acc(c) +
+                         (((size_t)min_y) * acc_stride);
+  uint8_t* pix_row = ((uint8_t*)(c->context.nonconst_ptr1)) +
+                     (((size_t)min_y) * c->context.extra5);
+
+  uint8_t* coverage = iconvg_private_rasterizer_canvas__coverage(c);
+  const iconvg_private_rasterizer_kernels* k =
+      &iconvg_private_rasterizer_kernels_table[r->kernels];
+
+  // If recording, the drawing's coverage rows go to the masks too.
+  iconvg_coverage_masks* masks =
+      (iconvg_coverage_masks*)(c->context.const_ptr3);
+  if (masks) {
+    iconvg_private_coverage_masks__append(masks, min_x, min_y, n,
+                                          max_y - min_y);
+  }
+
+  for (int32_t iy = min_y; iy < max_y;
+       iy++, acc_row += acc_stride, pix_row += c->context.extra5) {
+    float accumulator = 0.0f;
+    for (int32_t ix = r->dirty_min_x; ix < min_x; ix++) {
+      accumulator += acc_row[ix];
+    }
+    (*k->accumulate)(coverage, acc_row + min_x, (size_t)n, accumulator);
+
+    // Trim the row's zero coverage from both ends.
+    int32_t i0 = 0;
+    int32_t i1 = n;
+    while ((i0 < i1) && (coverage[i0] == 0)) {
+      i0++;
+    }
+    while ((i1 > i0) && (coverage[i1 - 1] == 0)) {
+      i1--;
+    }
+    if (masks) {
+      iconvg_private_coverage_masks__append_row(masks, i0, coverage + i0,
+                                                i1 - i0);
+    }
+    if (i0 < i1) {
+      uint8_t* pix = pix_row + (4 * ((size_t)(min_x + i0)));
+      iconvg_private_rasterizer_paint__blend_row(
+          &rp, k, pix, coverage + i0, i1 - i0, min_x + i0, iy);
+    }
+  }
+
+  iconvg_private_rasterizer_canvas__clear_dirty_rows(c);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__begin_path(iconvg_canvas* c,
+                                             float x0,
+                                             float y0) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  r->start_x = x0;
+  r->start_y = y0;
+  r->current_x = x0;
+  r->current_y = y0;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__end_path(iconvg_canvas* c) {
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+  iconvg_private_rasterizer_canvas__line_to(c, r->start_x, r->start_y);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__path_line_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1) {
+  iconvg_private_rasterizer_canvas__line_to(c, x1, y1);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__path_quad_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2) {
+  iconvg_private_rasterizer_canvas__quad_to(c, x1, y1, x2, y2);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__path_cube_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2,
+                                               float x3,
+                                               float y3) {
+  iconvg_private_rasterizer_canvas__cube_to(c, x1, y1, x2, y2, x3, y3);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__path_segments(iconvg_canvas* c,
+                                                const uint8_t* verbs,
+                                                size_t num_verbs,
+                                                const float* points) {
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        iconvg_private_rasterizer_canvas__line_to(c, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        iconvg_private_rasterizer_canvas__quad_to(c, points[0], points[1],
+                                                  points[2], points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        iconvg_private_rasterizer_canvas__cube_to(c, points[0], points[1],
+                                                  points[2], points[3],
+                                                  points[4], points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_rasterizer_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  // If recording, an empty record keeps the masks in step with the drawings,
+  // for a compositor (replaying a compiled form) that does not skip this one.
+  iconvg_coverage_masks* masks =
+      (iconvg_coverage_masks*)(c->context.const_ptr3);
+  if (masks) {
+    iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(c);
+    iconvg_private_coverage_masks__append(masks, r->clip_min_x, r->clip_min_y,
+                                          0, 0);
+  }
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_rasterizer_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_rasterizer_canvas__begin_decode,
+        &iconvg_private_rasterizer_canvas__end_decode,
+        &iconvg_private_rasterizer_canvas__begin_drawing,
+        &iconvg_private_rasterizer_canvas__end_drawing,
+        &iconvg_private_rasterizer_canvas__begin_path,
+        &iconvg_private_rasterizer_canvas__end_path,
+        &iconvg_private_rasterizer_canvas__path_line_to,
+        &iconvg_private_rasterizer_canvas__path_quad_to,
+        &iconvg_private_rasterizer_canvas__path_cube_to,
+        &iconvg_private_rasterizer_canvas__on_metadata_viewbox,
+        &iconvg_private_rasterizer_canvas__on_metadata_suggested_palette,
+        &iconvg_private_rasterizer_canvas__path_segments,
+        &iconvg_private_rasterizer_canvas__on_skipped_drawing,
+};
+
+size_t  //
+iconvg_rasterizer_scratch_len(uint32_t pixels_width, uint32_t pixels_height) {
+  if ((pixels_width == 0) || (pixels_width > 0x100000) ||
+      (pixels_height == 0) || (pixels_height > 0x100000)) {
+    return 0;
+  }
+  size_t acc_stride =
+      ((size_t)pixels_width) + ICONVG_PRIVATE_RASTERIZER_ACC_SLACK;
+  size_t coverage_len = (((size_t)pixels_width) + sizeof(float) - 1) /
+                        sizeof(float);
+  size_t max = ((size_t)(-1)) / sizeof(float);
+  if (acc_stride > ((max - ICONVG_PRIVATE_RASTERIZER_HEADER_LEN -
+                     coverage_len) /
+                    ((size_t)pixels_height))) {
+    return 0;
+  }
+  return ICONVG_PRIVATE_RASTERIZER_HEADER_LEN +
+         (acc_stride * ((size_t)pixels_height)) + coverage_len;
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_rasterizer(uint8_t* pixels_ptr,
+                               size_t pixels_stride,
+                               uint32_t pixels_width,
+                               uint32_t pixels_height,
+                               float* scratch_ptr,
+                               size_t scratch_len) {
+  size_t min_scratch_len =
+      iconvg_rasterizer_scratch_len(pixels_width, pixels_height);
+  if (!pixels_ptr || !scratch_ptr || (min_scratch_len == 0) ||
+      (scratch_len < min_scratch_len) ||
+      ((pixels_stride / 4) < ((size_t)pixels_width))) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  memset(scratch_ptr, 0, min_scratch_len * sizeof(float));
+
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_rasterizer_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = pixels_ptr;
+  c.context.nonconst_ptr2 = scratch_ptr;
+  c.context.extra5 = pixels_stride;
+  c.context.extra6 = pixels_width;
+  c.context.extra7 = pixels_height;
+
+  iconvg_private_rasterizer* r = iconvg_private_rasterizer_canvas__state(&c);
+  r->clip_max_x = (int32_t)pixels_width;
+  r->clip_max_y = (int32_t)pixels_height;
+  r->dirty_min_x = (int32_t)pixels_width;
+  r->dirty_min_y = (int32_t)pixels_height;
+  r->dirty_max_x = 0;
+  r->dirty_max_y = 0;
+  r->kernels = iconvg_private_rasterizer__choose_kernels();
+  return c;
+}
+
+// ----
+
+const char*  //
+iconvg_coverage_masks__initialize(iconvg_coverage_masks* self,
+                                  uint8_t* buf_ptr,
+                                  size_t buf_len) {
+  if (!self || !buf_ptr) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  self->private_impl.buf_ptr = buf_ptr;
+  self->private_impl.buf_len = buf_len;
+  return NULL;
+}
+
+size_t  //
+iconvg_coverage_masks__required_len(const iconvg_coverage_masks* self) {
+  return self ? self->private_impl.buf_used : 0;
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_rasterizer_with_coverage_masks(
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    float* scratch_ptr,
+    size_t scratch_len,
+    iconvg_coverage_masks* masks) {
+  if (!masks) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  iconvg_canvas c =
+      iconvg_canvas__make_rasterizer(pixels_ptr, pixels_stride, pixels_width,
+                                     pixels_height, scratch_ptr, scratch_len);
+  if (c.vtable == &iconvg_private_rasterizer_canvas_vtable) {
+    c.context.const_ptr3 = masks;
+  }
+  return c;
+}
+
+const char*  //
+iconvg_private_coverage_compositor__initialize(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_coverage_masks* masks,
+    uint8_t* pixels_ptr,
+    size_t pixels_stride,
+    uint32_t pixels_width,
+    uint32_t pixels_height,
+    iconvg_rectangle_f32 dst_rect) {
+  if (!masks || !pixels_ptr || ((pixels_stride / 4) < pixels_width)) {
+    return iconvg_error_invalid_constructor_argument;
+  } else if (!masks->private_impl.buf_ptr || masks->private_impl.overflowed ||
+             (masks->private_impl.pixels_width != pixels_width) ||
+             (masks->private_impl.pixels_height != pixels_height) ||
+             (masks->private_impl.dst_rect[0] != dst_rect.min_x) ||
+             (masks->private_impl.dst_rect[1] != dst_rect.min_y) ||
+             (masks->private_impl.dst_rect[2] != dst_rect.max_x) ||
+             (masks->private_impl.dst_rect[3] != dst_rect.max_y)) {
+    return iconvg_error_invalid_coverage_masks;
+  }
+  self->masks = masks;
+  self->offset = 0;
+  self->pixels_ptr = pixels_ptr;
+  self->pixels_stride = pixels_stride;
+  self->kernels = iconvg_private_rasterizer__choose_kernels();
+  return NULL;
+}
+
+const char*  //
+iconvg_private_coverage_compositor__composite(
+    iconvg_private_coverage_compositor* self,
+    const iconvg_paint* p) {
+  const iconvg_coverage_masks* masks = self->masks;
+  size_t used = masks->private_impl.buf_used;
+  if ((used - self->offset) < ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN) {
+    return iconvg_error_invalid_coverage_masks;
+  }
+  const uint8_t* q = masks->private_impl.buf_ptr + self->offset;
+  uint32_t min_x = iconvg_private_peek_u32le(q + 0);
+  uint32_t min_y = iconvg_private_peek_u32le(q + 4);
+  uint32_t n = iconvg_private_peek_u32le(q + 8);
+  uint32_t num_rows = iconvg_private_peek_u32le(q + 12);
+  q += ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN;
+  self->offset += ICONVG_PRIVATE_COVERAGE_MASK_HEADER_LEN;
+
+  // The recording canvas clipped each record to the pixel buffer, so these
+  // checks only fail for corrupted masks.
+  uint32_t w = masks->private_impl.pixels_width;
+  uint32_t h = masks->private_impl.pixels_height;
+  if ((min_x > w) || (n > (w - min_x)) || (min_y > h) ||
+      (num_rows > (h - min_y))) {
+    return iconvg_error_invalid_coverage_masks;
+  }
+
+  iconvg_private_rasterizer_paint rp;
+  if (p && !iconvg_private_rasterizer_paint__initialize(
+               &rp, &self->gradient_lut[0], p)) {
+    return iconvg_error_invalid_paint_type;
+  }
+  const iconvg_private_rasterizer_kernels* k =
+      &iconvg_private_rasterizer_kernels_table[self->kernels];
+  uint8_t* pix_row = self->pixels_ptr +
+                     (((size_t)min_y) * self->pixels_stride) +
+                     (4 * ((size_t)min_x));
+  for (uint32_t y = 0; y < num_rows; y++, pix_row += self->pixels_stride) {
+    if ((used - self->offset) < ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN) {
+      return iconvg_error_invalid_coverage_masks;
+    }
+    uint32_t x = iconvg_private_peek_u32le(q + 0);
+    uint32_t row_len = iconvg_private_peek_u32le(q + 4);
+    q += ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN;
+    self->offset += ICONVG_PRIVATE_COVERAGE_MASK_ROW_HEADER_LEN;
+    if ((x > n) || (row_len > (n - x)) ||
+        (row_len > (used - self->offset))) {
+      return iconvg_error_invalid_coverage_masks;
+    }
+    if (p && (row_len > 0)) {
+      iconvg_private_rasterizer_paint__blend_row(
+          &rp, k, pix_row + (4 * ((size_t)x)), q, (int32_t)row_len,
+          (int32_t)(min_x + x), (int32_t)(min_y + y));
+    }
+    q += row_len;
+    self->offset += row_len;
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_private_coverage_compositor__finish(
+    const iconvg_private_coverage_compositor* self) {
+  return (self->offset == self->masks->private_impl.buf_used)
+             ? NULL
+             : iconvg_error_invalid_coverage_masks;
+}
@@ -21,8 +21,23 @@ iconvg_canvas__make_skia(sk_canvas_t* sc) {
   return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
 }
 
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_gradient_cache(sk_canvas_t* sc,
+                                             iconvg_gradient_cache* gc) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_arena(sk_canvas_t* sc,
+                                    iconvg_gradient_cache* gc,
+                                    iconvg_arena* arena) {
+  return iconvg_canvas__make_broken(iconvg_error_invalid_backend_not_enabled);
+}
+
 #else  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
 
+#include <stdlib.h>
+
 #include "include/c/sk_canvas.h"
 #include "include/c/sk_matrix.h"
 #include "include/c/sk_paint.h"
@@ -37,6 +52,51 @@ static const sk_shader_tilemode_t
         REPEAT_SK_SHADER_TILEMODE   //
 };
 
+// iconvg_private_skia_state is the Skia canvas' per-decode state, pointed to
+// by context.nonconst_ptr2 between begin_decode and end_decode.
+//
+// The path builder and paint are re-used by every drawing (the path builder
+// is reset by sk_pathbuilder_detach_path) instead of being created and
+// destroyed per drawing.
+//
+// Without a gradient cache (from iconvg_canvas__make_skia_with_gradient_cache)
+// the last gradient shader is kept, so that consecutive drawings with the
+// same gradient stops share one (pattern space) sk_shader_t.
+//
+// With an arena (from iconvg_canvas__make_skia_with_arena) the state itself
+// is carved from the arena, which the caller resets, instead of being
+// malloc'ed and free'd.
+typedef struct iconvg_private_skia_state_struct {
+  bool from_arena;
+  sk_pathbuilder_t* pathbuilder;
+  sk_paint_t* paint;
+  bool paint_has_shader;
+  iconvg_gradient_cache* gradient_cache;
+  sk_shader_t* last_shader;
+  iconvg_private_gradient_key last_key;
+} iconvg_private_skia_state;
+
+static void  //
+iconvg_private_skia_release_shader(void* obj) {
+  sk_shader_unref((sk_shader_t*)obj);
+}
+
+static void  //
+iconvg_private_skia_state__delete(iconvg_private_skia_state* state) {
+  if (state->last_shader) {
+    sk_shader_unref(state->last_shader);
+  }
+  if (state->paint) {
+    sk_paint_delete(state->paint);
+  }
+  if (state->pathbuilder) {
+    sk_pathbuilder_delete(state->pathbuilder);
+  }
+  if (!state->from_arena) {
+    free(state);
+  }
+}
+
 // iconvg_private_skia_set_gradient_stops sets the Skia gradient stop colors
 // given the IconVG gradient stop colors.
 //
@@ -137,85 +197,14 @@ iconvg_private_skia_set_gradient_stops(sk_color_t* gcol,
   return ret;
 }
 
-static const char*  //
-iconvg_private_skia_canvas__begin_decode(iconvg_canvas* c,
-                                         iconvg_rectangle_f32 dst_rect) {
-  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_canvas_save(sc);
-
-  sk_rect_t rect;
-  rect.left = dst_rect.min_x;
-  rect.top = dst_rect.min_y;
-  rect.right = dst_rect.max_x;
-  rect.bottom = dst_rect.max_y;
-  sk_canvas_clip_rect(sc, &rect);
-
-  return NULL;
-}
-
-static const char*  //
-iconvg_private_skia_canvas__end_decode(iconvg_canvas* c,
-                                       const char* err_msg,
-                                       size_t num_bytes_consumed,
-                                       size_t num_bytes_remaining) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
-  }
-  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_canvas_restore(sc);
-  return err_msg;
-}
-
-static const char*  //
-iconvg_private_skia_canvas__begin_drawing(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
-  }
-  spb = sk_pathbuilder_new();
-  if (!spb) {
-    return iconvg_error_system_failure_out_of_memory;
-  }
-  c->context_nonconst_ptr2 = spb;
-  return NULL;
-}
-
-static const char*  //
-iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
-                                        const iconvg_paint* p) {
-  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-
-  iconvg_paint_type paint_type = iconvg_paint__type(p);
-  switch (paint_type) {
-    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
-      iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
-      sk_path_t* path = sk_pathbuilder_detach_path(spb);
-      sk_paint_t* paint = sk_paint_new();
-      sk_paint_set_antialias(paint, true);
-      sk_paint_set_color(
-          paint, sk_color_set_argb(k.rgba[3], k.rgba[0], k.rgba[1], k.rgba[2]));
-      sk_canvas_draw_path(sc, path, paint);
-      sk_paint_delete(paint);
-      sk_path_delete(path);
-      return NULL;
-    }
-    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
-    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
-      break;
-    default:
-      return iconvg_error_invalid_paint_type;
-  }
-
-  // The matrix in IconVG's API converts from dst coordinate space to pattern
-  // coordinate space. Skia's API is the other way around (matrix inversion).
-  iconvg_matrix_2x3_f64 im = iconvg_paint__gradient_transformation_matrix(p);
-  if (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) {
-    iconvg_matrix_2x3_f64__override_second_row(&im);
-  }
+// iconvg_private_skia_local_matrix returns the Skia local matrix for a
+// gradient whose transformation matrix (after any linear gradient override) is
+// gtm. The matrix in IconVG's API converts from dst coordinate space to
+// pattern coordinate space. Skia's API is the other way around (matrix
+// inversion).
+static sk_matrix_t  //
+iconvg_private_skia_local_matrix(const iconvg_matrix_2x3_f64* gtm) {
+  iconvg_matrix_2x3_f64 im = *gtm;
   im = iconvg_matrix_2x3_f64__inverse(&im);
   sk_matrix_t sm;
   sm.mat[0] = im.elems[0][0];
@@ -227,7 +216,17 @@ iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
   sm.mat[6] = 0.0f;
   sm.mat[7] = 0.0f;
   sm.mat[8] = 1.0f;
+  return sm;
+}
 
+// iconvg_private_skia_make_shader returns a new Skia shader (or NULL) for the
+// gradient paint p, in pattern space: it has no local matrix, so that it does
+// not depend on the dst_rect. It also sets *backend_bytes to a rough estimate
+// of the shader's size.
+static sk_shader_t*  //
+iconvg_private_skia_make_shader(const iconvg_paint* p,
+                                iconvg_paint_type paint_type,
+                                size_t* backend_bytes) {
   // The gradient is either:
   //   - linear, from (0, 0) to (1, 0), or
   //   - radial, centered at (0, 0).
@@ -277,53 +276,210 @@ iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
     shader = sk_shader_new_linear_gradient(
         gradient_points, gradient_colors, gradient_offsets, gradient_num_stops,
         iconvg_private_gradient_spread_as_sk_shader_tilemode_t[gradient_spread],
-        &sm);
+        NULL);
   } else {
     static const float radius = 1.0f;
     shader = sk_shader_new_radial_gradient(
         gradient_points, radius, gradient_colors, gradient_offsets,
         gradient_num_stops,
         iconvg_private_gradient_spread_as_sk_shader_tilemode_t[gradient_spread],
-        &sm);
+        NULL);
   }
 
-  // Use the Skia shader.
-  if (shader) {
-    sk_path_t* path = sk_pathbuilder_detach_path(spb);
-    sk_paint_t* paint = sk_paint_new();
-    sk_paint_set_antialias(paint, true);
-    sk_paint_set_shader(paint, shader);
-    sk_shader_unref(shader);
-    sk_canvas_draw_path(sc, path, paint);
-    sk_paint_delete(paint);
-    sk_path_delete(path);
+  // Skia keeps each stop as a four-float color and a float offset.
+  *backend_bytes = 256 + (gradient_num_stops * 5 * sizeof(float));
+  return shader;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__begin_decode(iconvg_canvas* c,
+                                         iconvg_rectangle_f32 dst_rect) {
+  if (c->context.nonconst_ptr2) {
+    iconvg_private_skia_state__delete(
+        (iconvg_private_skia_state*)(c->context.nonconst_ptr2));
+    c->context.nonconst_ptr2 = NULL;
+  }
+  // The arena is mutable. Like the gradient cache, it is held in a const_ptr
+  // field because the context's two nonconst_ptr fields are already taken.
+  iconvg_arena* arena = (iconvg_arena*)(c->context.const_ptr4);
+  iconvg_private_skia_state* state = NULL;
+  if (arena) {
+    state = (iconvg_private_skia_state*)(iconvg_arena__alloc(
+        arena, sizeof(*state)));
+    if (state) {
+      memset(state, 0, sizeof(*state));
+      state->from_arena = true;
+    }
+  } else {
+    state = (iconvg_private_skia_state*)(calloc(1, sizeof(*state)));
+  }
+  if (!state) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  state->pathbuilder = sk_pathbuilder_new();
+  state->paint = sk_paint_new();
+  if (!state->pathbuilder || !state->paint) {
+    iconvg_private_skia_state__delete(state);
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  sk_paint_set_antialias(state->paint, true);
+  // The gradient cache is mutable. It is only held in a const_ptr field
+  // because the context's two nonconst_ptr fields are already taken.
+  state->gradient_cache = (iconvg_gradient_cache*)(c->context.const_ptr3);
+  c->context.nonconst_ptr2 = state;
+
+  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
+  sk_canvas_save(sc);
+
+  sk_rect_t rect;
+  rect.left = dst_rect.min_x;
+  rect.top = dst_rect.min_y;
+  rect.right = dst_rect.max_x;
+  rect.bottom = dst_rect.max_y;
+  sk_canvas_clip_rect(sc, &rect);
+
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__end_decode(iconvg_canvas* c,
+                                       const char* err_msg,
+                                       size_t num_bytes_consumed,
+                                       size_t num_bytes_remaining) {
+  iconvg_private_skia_state* state =
+      (iconvg_private_skia_state*)(c->context.nonconst_ptr2);
+  if (!state) {
+    // begin_decode failed (and did not call sk_canvas_save).
+    return err_msg;
+  }
+  iconvg_private_skia_state__delete(state);
+  c->context.nonconst_ptr2 = NULL;
+  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
+  sk_canvas_restore(sc);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__begin_drawing(iconvg_canvas* c) {
+  // The path builder was reset by the previous end_drawing's
+  // sk_pathbuilder_detach_path call (or is new).
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
+                                        const iconvg_paint* p) {
+  sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
+  iconvg_private_skia_state* state =
+      (iconvg_private_skia_state*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_t* spb = state->pathbuilder;
+  sk_paint_t* paint = state->paint;
+
+  iconvg_paint_type paint_type = iconvg_paint__type(p);
+  switch (paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_nonpremul_color k = iconvg_paint__flat_color_as_nonpremul_color(p);
+      if (state->paint_has_shader) {
+        sk_paint_set_shader(paint, NULL);
+        state->paint_has_shader = false;
+      }
+      sk_paint_set_color(
+          paint, sk_color_set_argb(k.rgba[3], k.rgba[0], k.rgba[1], k.rgba[2]));
+      sk_path_t* path = sk_pathbuilder_detach_path(spb);
+      sk_canvas_draw_path(sc, path, paint);
+      sk_path_delete(path);
+      return NULL;
+    }
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      break;
+    default:
+      return iconvg_error_invalid_paint_type;
   }
 
-  // Clean up.
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+  // Look for an existing shader for this gradient: in the gradient cache, if
+  // there is one, or else the previous drawing's shader.
+  iconvg_matrix_2x3_f64 gtm = iconvg_paint__gradient_transformation_matrix(p);
+  if (paint_type == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) {
+    iconvg_matrix_2x3_f64__override_second_row(&gtm);
+  }
+  iconvg_private_gradient_key key;
+  iconvg_private_gradient_key__initialize(&key, p);
+  iconvg_gradient_cache* gc = state->gradient_cache;
+  sk_shader_t* shader = NULL;
+  bool unref_shader = false;
+  if (gc) {
+    shader = (sk_shader_t*)(iconvg_private_gradient_cache__lookup(
+        gc, &key, &iconvg_private_skia_release_shader));
+  } else if (state->last_shader &&
+             (memcmp(&key, &state->last_key, sizeof(key)) == 0)) {
+    shader = state->last_shader;
   }
+
+  if (!shader) {
+    size_t backend_bytes = 0;
+    shader = iconvg_private_skia_make_shader(p, paint_type, &backend_bytes);
+    if (!shader) {
+      sk_path_delete(sk_pathbuilder_detach_path(spb));
+      return NULL;
+    } else if (gc) {
+      unref_shader = !iconvg_private_gradient_cache__insert(
+          gc, &key, &iconvg_private_skia_release_shader, shader,
+          backend_bytes);
+    } else {
+      if (state->last_shader) {
+        sk_shader_unref(state->last_shader);
+      }
+      state->last_shader = shader;
+      state->last_key = key;
+    }
+  }
+
+  // The shader is in pattern space. Wrap it with this drawing's (dst_rect
+  // dependent) local matrix. The wrapper is cheap: it shares the gradient.
+  sk_matrix_t sm = iconvg_private_skia_local_matrix(&gtm);
+  sk_shader_t* local_shader = sk_shader_with_local_matrix(shader, &sm);
+  if (unref_shader) {
+    sk_shader_unref(shader);
+  }
+  if (!local_shader) {
+    sk_path_delete(sk_pathbuilder_detach_path(spb));
+    return NULL;
+  }
+
+  // Use the Skia shader. The paint's color is reset to opaque black, as Skia
+  // modulates the shader by the paint's alpha. The paint takes its own
+  // reference to the shader.
+  sk_paint_set_color(paint, sk_color_set_argb(0xFF, 0x00, 0x00, 0x00));
+  sk_paint_set_shader(paint, local_shader);
+  sk_shader_unref(local_shader);
+  state->paint_has_shader = true;
+  sk_path_t* path = sk_pathbuilder_detach_path(spb);
+  sk_canvas_draw_path(sc, path, paint);
+  sk_path_delete(path);
   return NULL;
 }
 
 static const char*  //
 iconvg_private_skia_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
   sk_pathbuilder_move_to(spb, x0, y0);
   return NULL;
 }
 
 static const char*  //
 iconvg_private_skia_canvas__end_path(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
   sk_pathbuilder_close(spb);
   return NULL;
 }
 
 static const char*  //
 iconvg_private_skia_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
   sk_pathbuilder_line_to(spb, x1, y1);
   return NULL;
 }
@@ -334,7 +490,8 @@ iconvg_private_skia_canvas__path_quad_to(iconvg_canvas* c,
                                          float y1,
                                          float x2,
                                          float y2) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
   sk_pathbuilder_quad_to(spb, x1, y1, x2, y2);
   return NULL;
 }
@@ -347,7 +504,8 @@ iconvg_private_skia_canvas__path_cube_to(iconvg_canvas* c,
                                          float y2,
                                          float x3,
                                          float y3) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
   sk_pathbuilder_cubic_to(spb, x1, y1, x2, y2, x3, y3);
   return NULL;
 }
@@ -365,6 +523,36 @@ iconvg_private_skia_canvas__on_metadata_suggested_palette(
   return NULL;
 }
 
+static const char*  //
+iconvg_private_skia_canvas__path_segments(iconvg_canvas* c,
+                                          const uint8_t* verbs,
+                                          size_t num_verbs,
+                                          const float* points) {
+  sk_pathbuilder_t* spb =
+      ((iconvg_private_skia_state*)(c->context.nonconst_ptr2))->pathbuilder;
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        sk_pathbuilder_line_to(spb, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        sk_pathbuilder_quad_to(spb, points[0], points[1], points[2],
+                               points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        sk_pathbuilder_cubic_to(spb, points[0], points[1], points[2],
+                                points[3], points[4], points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
 static const iconvg_canvas_vtable  //
     iconvg_private_skia_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
@@ -379,10 +567,25 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_skia_canvas__path_cube_to,
         &iconvg_private_skia_canvas__on_metadata_viewbox,
         &iconvg_private_skia_canvas__on_metadata_suggested_palette,
+        &iconvg_private_skia_canvas__path_segments,
+        NULL,
 };
 
 iconvg_canvas  //
 iconvg_canvas__make_skia(sk_canvas_t* sc) {
+  return iconvg_canvas__make_skia_with_gradient_cache(sc, NULL);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_gradient_cache(sk_canvas_t* sc,
+                                             iconvg_gradient_cache* gc) {
+  return iconvg_canvas__make_skia_with_arena(sc, gc, NULL);
+}
+
+iconvg_canvas  //
+iconvg_canvas__make_skia_with_arena(sk_canvas_t* sc,
+                                    iconvg_gradient_cache* gc,
+                                    iconvg_arena* arena) {
   if (!sc) {
     return iconvg_canvas__make_broken(
         iconvg_error_invalid_constructor_argument);
@@ -391,6 +594,8 @@ iconvg_canvas__make_skia(sk_canvas_t* sc) {
   c.vtable = &iconvg_private_skia_canvas_vtable;
   memset(&c.context, 0, sizeof(c.context));
   c.context.nonconst_ptr1 = sc;
+  c.context.const_ptr3 = gc;
+  c.context.const_ptr4 = arena;
   return c;
 }
 
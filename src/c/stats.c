@@ -0,0 +1,422 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// The stats canvas wraps another canvas, counting and timing the calls that
+// it forwards. Its context fields hold:
+//  - nonconst_ptr1: the wrapped iconvg_canvas, possibly NULL.
+//  - nonconst_ptr2: the iconvg_canvas_stats.
+//
+// decode_ticks is accumulated by subtracting the clock reading at
+// begin_decode and adding the reading at end_decode. With unsigned arithmetic,
+// this needs no per-canvas state and the total is correct once end_decode has
+// returned.
+//
+// Forwarded calls are timed individually, or 1 in every sample_interval calls
+// of each method, with the sampled durations scaled up by sample_interval. A
+// NULL clock_func means that nothing is timed and every ticks field stays
+// zero.
+
+static inline uint64_t  //
+iconvg_private_stats_canvas__now(const iconvg_canvas_stats* s) {
+  return s->clock_func ? (*s->clock_func)(s->clock_context) : 0;
+}
+
+// iconvg_private_stats_canvas__start_timing returns whether to time this call
+// of method m and, if so, sets *t0 to the clock reading.
+static inline bool  //
+iconvg_private_stats_canvas__start_timing(iconvg_canvas_stats* s,
+                                          iconvg_canvas_method m,
+                                          uint64_t* t0) {
+  if (!s->clock_func) {
+    return false;
+  } else if (s->private_impl.countdown[m] > 0) {
+    s->private_impl.countdown[m]--;
+    return false;
+  }
+  s->private_impl.countdown[m] =
+      (s->sample_interval > 1) ? (s->sample_interval - 1) : 0;
+  *t0 = (*s->clock_func)(s->clock_context);
+  return true;
+}
+
+// iconvg_private_stats_canvas__finish_timing adds the time since t0, scaled
+// up by the sample interval, to method m's and the backend's totals.
+static inline void  //
+iconvg_private_stats_canvas__finish_timing(iconvg_canvas_stats* s,
+                                           iconvg_canvas_method m,
+                                           uint64_t t0) {
+  uint64_t ticks = (*s->clock_func)(s->clock_context) - t0;
+  if (s->sample_interval > 1) {
+    ticks *= s->sample_interval;
+  }
+  s->method_ticks[m] += ticks;
+  s->backend_ticks += ticks;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_decodes++;
+  s->decode_ticks -= iconvg_private_stats_canvas__now(s);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__BEGIN_DECODE, &t0);
+  const char* err_msg = (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__BEGIN_DECODE, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    // No-op.
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    err_msg = iconvg_error_unsupported_vtable;
+  } else {
+    uint64_t t0 = 0;
+    bool timed = iconvg_private_stats_canvas__start_timing(
+        s, ICONVG_CANVAS_METHOD__END_DECODE, &t0);
+    err_msg = (*wrapped->vtable->end_decode)(wrapped, err_msg,
+                                             num_bytes_consumed,
+                                             num_bytes_remaining);
+    if (timed) {
+      iconvg_private_stats_canvas__finish_timing(
+          s, ICONVG_CANVAS_METHOD__END_DECODE, t0);
+    }
+  }
+  s->decode_ticks += iconvg_private_stats_canvas__now(s);
+  if (err_msg) {
+    s->num_decode_errors++;
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_drawings++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__BEGIN_DRAWING, &t0);
+  const char* err_msg = (*wrapped->vtable->begin_drawing)(wrapped);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__BEGIN_DRAWING, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_paints[3 & iconvg_paint__type(p)]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__END_DRAWING, &t0);
+  const char* err_msg = (*wrapped->vtable->end_drawing)(wrapped, p);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__END_DRAWING, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_paths++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__BEGIN_PATH, &t0);
+  const char* err_msg = (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__BEGIN_PATH, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__end_path(iconvg_canvas* c) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__END_PATH, &t0);
+  const char* err_msg = (*wrapped->vtable->end_path)(wrapped);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__END_PATH, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_segments[ICONVG_PATH_VERB__LINE_TO]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_LINE_TO, &t0);
+  const char* err_msg = (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_LINE_TO, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_segments[ICONVG_PATH_VERB__QUAD_TO]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_QUAD_TO, &t0);
+  const char* err_msg =
+      (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_QUAD_TO, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_segments[ICONVG_PATH_VERB__CUBE_TO]++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_CUBE_TO, &t0);
+  const char* err_msg =
+      (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_CUBE_TO, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX, &t0);
+  const char* err_msg =
+      (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__ON_METADATA_VIEWBOX, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE, &t0);
+  const char* err_msg = (*wrapped->vtable->on_metadata_suggested_palette)(
+      wrapped, suggested_palette);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__ON_METADATA_SUGGESTED_PALETTE, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__path_segments(iconvg_canvas* c,
+                                           const uint8_t* verbs,
+                                           size_t num_verbs,
+                                           const float* points) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_path_segments_calls++;
+  for (size_t i = 0; i < num_verbs; i++) {
+    s->num_segments[3 & verbs[i]]++;
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__PATH_SEGMENTS, &t0);
+  const char* err_msg =
+      iconvg_private_canvas__path_segments(wrapped, verbs, num_verbs, points);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__PATH_SEGMENTS, t0);
+  }
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_stats_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  iconvg_canvas_stats* s = (iconvg_canvas_stats*)(c->context.nonconst_ptr2);
+  s->num_skipped_drawings++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             ICONVG_PRIVATE_SIZEOF_CANVAS_VTABLE_0_1) {
+    return iconvg_error_unsupported_vtable;
+  }
+  uint64_t t0 = 0;
+  bool timed = iconvg_private_stats_canvas__start_timing(
+      s, ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING, &t0);
+  const char* err_msg = iconvg_private_canvas__on_skipped_drawing(wrapped);
+  if (timed) {
+    iconvg_private_stats_canvas__finish_timing(
+        s, ICONVG_CANVAS_METHOD__ON_SKIPPED_DRAWING, t0);
+  }
+  return err_msg;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_stats_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_stats_canvas__begin_decode,
+        &iconvg_private_stats_canvas__end_decode,
+        &iconvg_private_stats_canvas__begin_drawing,
+        &iconvg_private_stats_canvas__end_drawing,
+        &iconvg_private_stats_canvas__begin_path,
+        &iconvg_private_stats_canvas__end_path,
+        &iconvg_private_stats_canvas__path_line_to,
+        &iconvg_private_stats_canvas__path_quad_to,
+        &iconvg_private_stats_canvas__path_cube_to,
+        &iconvg_private_stats_canvas__on_metadata_viewbox,
+        &iconvg_private_stats_canvas__on_metadata_suggested_palette,
+        &iconvg_private_stats_canvas__path_segments,
+        &iconvg_private_stats_canvas__on_skipped_drawing,
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_stats(iconvg_canvas_stats* stats, iconvg_canvas* wrapped) {
+  if (!stats) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  } else if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_stats_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = stats;
+  return c;
+}
@@ -0,0 +1,460 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// The tessellator canvas turns each drawing into triangles for a GPU to fill
+// with the stencil-and-cover technique: every triangle of a drawing fans out
+// from one anchor vertex (the drawing's first point), so that the winding
+// number that a stencil buffer accumulates at each pixel is the path's (with
+// the non-zero fill rule). A second pass then paints the drawing's cover
+// rectangle where the stencil is non-zero.
+//
+// A path segment from P to Q adds the fan triangle (anchor, P, Q). Closing a
+// contour adds the segment back to its start. In ICONVG_TESSELLATION_MODE__
+// CURVES mode, a quadratic curve from P via C to Q also adds the curve
+// triangle (P, C, Q) with curve coordinates (0, 0), (0.5, 0) and (1, 1): the
+// fragments for which ((u * u) - v) is negative are exactly those between the
+// chord PQ and the curve, and the triangle's orientation gives the right sign
+// for the winding number.
+
+#define ICONVG_PRIVATE_TESSELLATOR_DEFAULT_TOLERANCE 0.1f
+#define ICONVG_PRIVATE_TESSELLATOR_MAX_SUBDIVISIONS 100
+
+static inline iconvg_tessellation*  //
+iconvg_private_tessellator_canvas__state(iconvg_canvas* c) {
+  return (iconvg_tessellation*)(c->context.nonconst_ptr1);
+}
+
+static uint32_t  //
+iconvg_private_tessellation__vertex(iconvg_tessellation* t,
+                                    float x,
+                                    float y,
+                                    float u,
+                                    float v) {
+  size_t i = t->num_vertices++;
+  if (i < t->vertices_len) {
+    iconvg_tessellation_vertex* dst = &t->vertices_ptr[i];
+    dst->x = x;
+    dst->y = y;
+    dst->u = u;
+    dst->v = v;
+  }
+  float* b = &t->private_impl.bounds[0];
+  b[0] = (b[0] < x) ? b[0] : x;
+  b[1] = (b[1] < y) ? b[1] : y;
+  b[2] = (b[2] > x) ? b[2] : x;
+  b[3] = (b[3] > y) ? b[3] : y;
+  return (uint32_t)i;
+}
+
+static void  //
+iconvg_private_tessellation__triangle(iconvg_tessellation* t,
+                                      uint32_t a,
+                                      uint32_t b,
+                                      uint32_t c) {
+  size_t i = t->num_indices;
+  t->num_indices += 3;
+  if ((i < t->indices_len) && (3 <= (t->indices_len - i))) {
+    t->indices_ptr[i + 0] = a;
+    t->indices_ptr[i + 1] = b;
+    t->indices_ptr[i + 2] = c;
+  }
+}
+
+// iconvg_private_tessellation__fan_to adds a fan vertex at (x, y) and the fan
+// triangle for the segment from the previous one.
+static void  //
+iconvg_private_tessellation__fan_to(iconvg_tessellation* t, float x, float y) {
+  uint32_t v = iconvg_private_tessellation__vertex(t, x, y, 0.0f, 1.0f);
+  if (t->private_impl.prev_vertex != t->private_impl.anchor_vertex) {
+    iconvg_private_tessellation__triangle(t, t->private_impl.anchor_vertex,
+                                          t->private_impl.prev_vertex, v);
+  }
+  t->private_impl.prev_vertex = v;
+  t->private_impl.prev_x = x;
+  t->private_impl.prev_y = y;
+}
+
+// iconvg_private_tessellation__subdivisions returns the number of pieces
+// (line segments or quadratic curves) that approximate a curve to within
+// tolerance, if each piece, over a t interval of length h, deviates by at
+// most (k * (h ^ e)). e is 2 for lines and 3 for quadratic curves.
+static inline int32_t  //
+iconvg_private_tessellation__subdivisions(float k,
+                                          float tolerance,
+                                          bool cubic_root) {
+  float r = k / tolerance;
+  float n = cubic_root ? cbrtf(r) : sqrtf(r);
+  if (n < (ICONVG_PRIVATE_TESSELLATOR_MAX_SUBDIVISIONS - 1)) {
+    return 1 + (int32_t)n;
+  }
+  // This also catches NaN.
+  return ICONVG_PRIVATE_TESSELLATOR_MAX_SUBDIVISIONS;
+}
+
+static void  //
+iconvg_private_tessellation__quad_to(iconvg_tessellation* t,
+                                     float x1,
+                                     float y1,
+                                     float x2,
+                                     float y2) {
+  float x0 = t->private_impl.prev_x;
+  float y0 = t->private_impl.prev_y;
+  if (t->mode == ICONVG_TESSELLATION_MODE__CURVES) {
+    uint32_t v0 = iconvg_private_tessellation__vertex(t, x0, y0, 0.0f, 0.0f);
+    uint32_t v1 = iconvg_private_tessellation__vertex(t, x1, y1, 0.5f, 0.0f);
+    uint32_t v2 = iconvg_private_tessellation__vertex(t, x2, y2, 1.0f, 1.0f);
+    iconvg_private_tessellation__triangle(t, v0, v1, v2);
+    iconvg_private_tessellation__fan_to(t, x2, y2);
+    return;
+  }
+
+  // A chord over a t interval of length h deviates from the curve by at most
+  // (2 * dd * h²) / 8, where dd is the second difference.
+  float ddx = x0 - (2.0f * x1) + x2;
+  float ddy = y0 - (2.0f * y1) + y2;
+  int32_t n = iconvg_private_tessellation__subdivisions(
+      0.25f * sqrtf((ddx * ddx) + (ddy * ddy)), t->private_impl.tolerance,
+      false);
+  float inv_n = 1.0f / ((float)n);
+  for (int32_t i = 1; i < n; i++) {
+    float s = ((float)i) * inv_n;
+    float u = 1.0f - s;
+    float b0 = u * u;
+    float b1 = 2.0f * u * s;
+    float b2 = s * s;
+    iconvg_private_tessellation__fan_to(t,
+                                        (b0 * x0) + (b1 * x1) + (b2 * x2),  //
+                                        (b0 * y0) + (b1 * y1) + (b2 * y2));
+  }
+  iconvg_private_tessellation__fan_to(t, x2, y2);
+}
+
+static void  //
+iconvg_private_tessellation__cube_to(iconvg_tessellation* t,
+                                     float x1,
+                                     float y1,
+                                     float x2,
+                                     float y2,
+                                     float x3,
+                                     float y3) {
+  float x0 = t->private_impl.prev_x;
+  float y0 = t->private_impl.prev_y;
+  int32_t n = 0;
+  if (t->mode == ICONVG_TESSELLATION_MODE__CURVES) {
+    // Approximating a cubic piece by the quadratic whose control point is
+    // (3 * (C1 + C2) - (P0 + P3)) / 4 has an error of at most (√3 / 36) * |P3
+    // - 3*C2 + 3*C1 - P0| * h³.
+    float dx = x3 - (3.0f * x2) + (3.0f * x1) - x0;
+    float dy = y3 - (3.0f * y2) + (3.0f * y1) - y0;
+    n = iconvg_private_tessellation__subdivisions(
+        0.0481125224f * sqrtf((dx * dx) + (dy * dy)),
+        t->private_impl.tolerance, true);
+  } else {
+    // A chord over a t interval of length h deviates from the curve by at
+    // most (6 * dd * h²) / 8, where dd is the maximum second difference.
+    float ddx0 = x0 - (2.0f * x1) + x2;
+    float ddy0 = y0 - (2.0f * y1) + y2;
+    float ddx1 = x1 - (2.0f * x2) + x3;
+    float ddy1 = y1 - (2.0f * y2) + y3;
+    float dd0 = (ddx0 * ddx0) + (ddy0 * ddy0);
+    float dd1 = (ddx1 * ddx1) + (ddy1 * ddy1);
+    n = iconvg_private_tessellation__subdivisions(
+        0.75f * sqrtf((dd0 > dd1) ? dd0 : dd1), t->private_impl.tolerance,
+        false);
+  }
+
+  float inv_n = 1.0f / ((float)n);
+  float prev_dx = 3.0f * (x1 - x0);
+  float prev_dy = 3.0f * (y1 - y0);
+  for (int32_t i = 1; i <= n; i++) {
+    float s = ((float)i) * inv_n;
+    float u = 1.0f - s;
+    float px = x3;
+    float py = y3;
+    if (i < n) {
+      float b0 = u * u * u;
+      float b1 = 3.0f * u * u * s;
+      float b2 = 3.0f * u * s * s;
+      float b3 = s * s * s;
+      px = (b0 * x0) + (b1 * x1) + (b2 * x2) + (b3 * x3);
+      py = (b0 * y0) + (b1 * y1) + (b2 * y2) + (b3 * y3);
+    }
+    if (t->mode != ICONVG_TESSELLATION_MODE__CURVES) {
+      iconvg_private_tessellation__fan_to(t, px, py);
+      continue;
+    }
+
+    // The piece's cubic control points are its end points plus or minus a
+    // third of the (scaled by inv_n) derivatives there.
+    float dx = 3.0f * (((x1 - x0) * u * u) + (2.0f * (x2 - x1) * u * s) +
+                       ((x3 - x2) * s * s));
+    float dy = 3.0f * (((y1 - y0) * u * u) + (2.0f * (y2 - y1) * u * s) +
+                       ((y3 - y2) * s * s));
+    float h = inv_n / 3.0f;
+    float qx0 = t->private_impl.prev_x;
+    float qy0 = t->private_impl.prev_y;
+    float c1x = qx0 + (h * prev_dx);
+    float c1y = qy0 + (h * prev_dy);
+    float c2x = px - (h * dx);
+    float c2y = py - (h * dy);
+    iconvg_private_tessellation__quad_to(
+        t, ((3.0f * (c1x + c2x)) - (qx0 + px)) / 4.0f,
+        ((3.0f * (c1y + c2y)) - (qy0 + py)) / 4.0f, px, py);
+    prev_dx = dx;
+    prev_dy = dy;
+  }
+}
+
+// ----
+
+static const char*  //
+iconvg_private_tessellator_canvas__begin_decode(iconvg_canvas* c,
+                                                iconvg_rectangle_f32 dst_rect) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  t->num_vertices = 0;
+  t->num_indices = 0;
+  t->num_draws = 0;
+  t->num_stops = 0;
+  memset(&t->private_impl, 0, sizeof(t->private_impl));
+  t->private_impl.dst_rect = dst_rect;
+  t->private_impl.tolerance =
+      (t->tolerance > 0) ? t->tolerance
+                         : ICONVG_PRIVATE_TESSELLATOR_DEFAULT_TOLERANCE;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__end_decode(iconvg_canvas* c,
+                                              const char* err_msg,
+                                              size_t num_bytes_consumed,
+                                              size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  t->private_impl.bounds[0] = +INFINITY;
+  t->private_impl.bounds[1] = +INFINITY;
+  t->private_impl.bounds[2] = -INFINITY;
+  t->private_impl.bounds[3] = -INFINITY;
+  t->private_impl.first_index = (uint32_t)(t->num_indices);
+  t->private_impl.has_anchor = false;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__end_drawing(iconvg_canvas* c,
+                                               const iconvg_paint* p) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  uint32_t first_index = t->private_impl.first_index;
+  if (t->num_indices == first_index) {
+    return NULL;
+  }
+
+  iconvg_tessellation_draw d;
+  memset(&d, 0, sizeof(d));
+  d.first_index = first_index;
+  d.num_indices = (uint32_t)(t->num_indices - first_index);
+  d.paint_type = iconvg_paint__type(p);
+  switch (d.paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR:
+      d.flat_color = iconvg_paint__flat_color_as_premul_color(p);
+      break;
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      d.gradient_spread = iconvg_paint__gradient_spread(p);
+      d.gradient_matrix = iconvg_paint__gradient_transformation_matrix(p);
+      d.first_stop = (uint32_t)(t->num_stops);
+      d.num_stops = iconvg_paint__gradient_number_of_stops(p);
+      for (uint32_t i = 0; i < d.num_stops; i++) {
+        size_t j = t->num_stops++;
+        if (j < t->stops_len) {
+          t->stops_ptr[j].offset = iconvg_paint__gradient_stop_offset(p, i);
+          t->stops_ptr[j].color =
+              iconvg_paint__gradient_stop_color_as_premul_color(p, i);
+        }
+      }
+      break;
+    default:
+      return iconvg_error_invalid_paint_type;
+  }
+
+  // The vertices (including curve control points) bound the triangles. The
+  // dst_rect clips the cover rectangle.
+  const float* b = &t->private_impl.bounds[0];
+  const iconvg_rectangle_f32* r = &t->private_impl.dst_rect;
+  d.cover_rect.min_x = (b[0] > r->min_x) ? b[0] : r->min_x;
+  d.cover_rect.min_y = (b[1] > r->min_y) ? b[1] : r->min_y;
+  d.cover_rect.max_x = (b[2] < r->max_x) ? b[2] : r->max_x;
+  d.cover_rect.max_y = (b[3] < r->max_y) ? b[3] : r->max_y;
+  if (!iconvg_rectangle_f32__is_finite_and_not_empty(&d.cover_rect)) {
+    d.cover_rect = iconvg_rectangle_f32__make(r->min_x, r->min_y, r->min_x,
+                                              r->min_y);
+  }
+
+  size_t i = t->num_draws++;
+  if (i < t->draws_len) {
+    t->draws_ptr[i] = d;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__begin_path(iconvg_canvas* c,
+                                              float x0,
+                                              float y0) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  uint32_t v = iconvg_private_tessellation__vertex(t, x0, y0, 0.0f, 1.0f);
+  if (!t->private_impl.has_anchor) {
+    t->private_impl.has_anchor = true;
+    t->private_impl.anchor_vertex = v;
+  }
+  t->private_impl.contour_start_vertex = v;
+  t->private_impl.prev_vertex = v;
+  t->private_impl.prev_x = x0;
+  t->private_impl.prev_y = y0;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__end_path(iconvg_canvas* c) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  uint32_t start = t->private_impl.contour_start_vertex;
+  uint32_t prev = t->private_impl.prev_vertex;
+  if ((start != t->private_impl.anchor_vertex) &&
+      (prev != t->private_impl.anchor_vertex) && (start != prev)) {
+    iconvg_private_tessellation__triangle(t, t->private_impl.anchor_vertex,
+                                          prev, start);
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__path_line_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1) {
+  iconvg_private_tessellation__fan_to(
+      iconvg_private_tessellator_canvas__state(c), x1, y1);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__path_quad_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2) {
+  iconvg_private_tessellation__quad_to(
+      iconvg_private_tessellator_canvas__state(c), x1, y1, x2, y2);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__path_cube_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2,
+                                                float x3,
+                                                float y3) {
+  iconvg_private_tessellation__cube_to(
+      iconvg_private_tessellator_canvas__state(c), x1, y1, x2, y2, x3, y3);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_tessellator_canvas__path_segments(iconvg_canvas* c,
+                                                 const uint8_t* verbs,
+                                                 size_t num_verbs,
+                                                 const float* points) {
+  iconvg_tessellation* t = iconvg_private_tessellator_canvas__state(c);
+  for (; num_verbs > 0; num_verbs--) {
+    switch (*verbs++) {
+      case ICONVG_PATH_VERB__LINE_TO:
+        iconvg_private_tessellation__fan_to(t, points[0], points[1]);
+        points += 2;
+        break;
+      case ICONVG_PATH_VERB__QUAD_TO:
+        iconvg_private_tessellation__quad_to(t, points[0], points[1],
+                                             points[2], points[3]);
+        points += 4;
+        break;
+      case ICONVG_PATH_VERB__CUBE_TO:
+        iconvg_private_tessellation__cube_to(t, points[0], points[1],
+                                             points[2], points[3], points[4],
+                                             points[5]);
+        points += 6;
+        break;
+      default:
+        return iconvg_error_invalid_path_verb;
+    }
+  }
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_tessellator_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_tessellator_canvas__begin_decode,
+        &iconvg_private_tessellator_canvas__end_decode,
+        &iconvg_private_tessellator_canvas__begin_drawing,
+        &iconvg_private_tessellator_canvas__end_drawing,
+        &iconvg_private_tessellator_canvas__begin_path,
+        &iconvg_private_tessellator_canvas__end_path,
+        &iconvg_private_tessellator_canvas__path_line_to,
+        &iconvg_private_tessellator_canvas__path_quad_to,
+        &iconvg_private_tessellator_canvas__path_cube_to,
+        &iconvg_private_tessellator_canvas__on_metadata_viewbox,
+        &iconvg_private_tessellator_canvas__on_metadata_suggested_palette,
+        &iconvg_private_tessellator_canvas__path_segments,
+        NULL,
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_tessellator(iconvg_tessellation* t) {
+  if (!t) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_tessellator_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = t;
+  return c;
+}
+
+bool  //
+iconvg_tessellation__is_complete(const iconvg_tessellation* self) {
+  return self && (self->num_vertices <= self->vertices_len) &&
+         (self->num_indices <= self->indices_len) &&
+         (self->num_draws <= self->draws_len) &&
+         (self->num_stops <= self->stops_len);
+}
@@ -0,0 +1,248 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// The transform canvas wraps another canvas, applying an
+// iconvg_decode_options' transform to every point (and to dst_rect) on the
+// way. Its context fields hold:
+//  - nonconst_ptr1: the wrapped iconvg_canvas, whose vtable the caller has
+//    already checked is supported.
+//  - const_ptr3: the iconvg_matrix_2x3_f64 transform.
+
+// iconvg_private_transform_points sets dst[.. 2 * num_points] to the
+// m-transformed src[.. 2 * num_points], (x, y) pairs in both cases. It is one
+// pass over the points, with the matrix held in local variables.
+static void  //
+iconvg_private_transform_points(const iconvg_matrix_2x3_f64* m,
+                                float* dst,
+                                const float* src,
+                                size_t num_points) {
+  double m00 = m->elems[0][0];
+  double m01 = m->elems[0][1];
+  double m02 = m->elems[0][2];
+  double m10 = m->elems[1][0];
+  double m11 = m->elems[1][1];
+  double m12 = m->elems[1][2];
+  for (; num_points > 0; num_points--, dst += 2, src += 2) {
+    double x = (double)(src[0]);
+    double y = (double)(src[1]);
+    dst[0] = (float)((x * m00) + (y * m01) + m02);
+    dst[1] = (float)((x * m10) + (y * m11) + m12);
+  }
+}
+
+static inline void  //
+iconvg_private_transform_canvas__points(iconvg_canvas* c,
+                                        float* dst,
+                                        const float* src,
+                                        size_t num_points) {
+  iconvg_private_transform_points(
+      (const iconvg_matrix_2x3_f64*)(c->context.const_ptr3), dst, src,
+      num_points);
+}
+
+iconvg_rectangle_f32  //
+iconvg_private_matrix_2x3_f64__transform_bounds(const iconvg_matrix_2x3_f64* m,
+                                                iconvg_rectangle_f32 r) {
+  float corners[8];
+  corners[0] = r.min_x;
+  corners[1] = r.min_y;
+  corners[2] = r.max_x;
+  corners[3] = r.min_y;
+  corners[4] = r.min_x;
+  corners[5] = r.max_y;
+  corners[6] = r.max_x;
+  corners[7] = r.max_y;
+  iconvg_private_transform_points(m, &corners[0], &corners[0], 4);
+  iconvg_rectangle_f32 b = iconvg_rectangle_f32__make(
+      corners[0], corners[1], corners[0], corners[1]);
+  for (int i = 2; i < 8; i += 2) {
+    b.min_x = (b.min_x < corners[i + 0]) ? b.min_x : corners[i + 0];
+    b.min_y = (b.min_y < corners[i + 1]) ? b.min_y : corners[i + 1];
+    b.max_x = (b.max_x > corners[i + 0]) ? b.max_x : corners[i + 0];
+    b.max_y = (b.max_y > corners[i + 1]) ? b.max_y : corners[i + 1];
+  }
+  return b;
+}
+
+static const char*  //
+iconvg_private_transform_canvas__begin_decode(iconvg_canvas* c,
+                                              iconvg_rectangle_f32 dst_rect) {
+  // The wrapped canvas sees the bounding box of the transformed dst_rect.
+  iconvg_rectangle_f32 r = iconvg_private_matrix_2x3_f64__transform_bounds(
+      (const iconvg_matrix_2x3_f64*)(c->context.const_ptr3), dst_rect);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->begin_decode)(wrapped, r);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__end_decode(iconvg_canvas* c,
+                                            const char* err_msg,
+                                            size_t num_bytes_consumed,
+                                            size_t num_bytes_remaining) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__end_drawing(iconvg_canvas* c,
+                                             const iconvg_paint* p) {
+  // The paint's gradient transformation matrix already accounts for the
+  // transform (see iconvg_private_paint__initialize).
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->end_drawing)(wrapped, p);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__begin_path(iconvg_canvas* c,
+                                            float x0,
+                                            float y0) {
+  float p[2] = {x0, y0};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 1);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->begin_path)(wrapped, p[0], p[1]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__end_path(iconvg_canvas* c) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->end_path)(wrapped);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_line_to(iconvg_canvas* c,
+                                              float x1,
+                                              float y1) {
+  float p[2] = {x1, y1};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 1);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->path_line_to)(wrapped, p[0], p[1]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_quad_to(iconvg_canvas* c,
+                                              float x1,
+                                              float y1,
+                                              float x2,
+                                              float y2) {
+  float p[4] = {x1, y1, x2, y2};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 2);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->path_quad_to)(wrapped, p[0], p[1], p[2], p[3]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_cube_to(iconvg_canvas* c,
+                                              float x1,
+                                              float y1,
+                                              float x2,
+                                              float y2,
+                                              float x3,
+                                              float y3) {
+  float p[6] = {x1, y1, x2, y2, x3, y3};
+  iconvg_private_transform_canvas__points(c, &p[0], &p[0], 3);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->path_cube_to)(wrapped, p[0], p[1], p[2], p[3],
+                                          p[4], p[5]);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
+
+static const char*  //
+iconvg_private_transform_canvas__path_segments(iconvg_canvas* c,
+                                               const uint8_t* verbs,
+                                               size_t num_verbs,
+                                               const float* points) {
+  // Transform the points in chunks: up to a batch's worth of verbs at a time.
+  float buf[6 * ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS];
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  while (num_verbs > 0) {
+    size_t n = (num_verbs < ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS)
+                   ? num_verbs
+                   : ICONVG_PRIVATE_PATH_BATCH_MAX_VERBS;
+    size_t num_points = 0;
+    for (size_t i = 0; i < n; i++) {
+      if ((verbs[i] < ICONVG_PATH_VERB__LINE_TO) ||
+          (verbs[i] > ICONVG_PATH_VERB__CUBE_TO)) {
+        return iconvg_error_invalid_path_verb;
+      }
+      num_points += verbs[i];
+    }
+    iconvg_private_transform_canvas__points(c, &buf[0], points, num_points);
+    ICONVG_PRIVATE_TRY(
+        iconvg_private_canvas__path_segments(wrapped, verbs, n, &buf[0]));
+    verbs += n;
+    num_verbs -= n;
+    points += 2 * num_points;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_transform_canvas__on_skipped_drawing(iconvg_canvas* c) {
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return iconvg_private_canvas__on_skipped_drawing(wrapped);
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_transform_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_transform_canvas__begin_decode,
+        &iconvg_private_transform_canvas__end_decode,
+        &iconvg_private_transform_canvas__begin_drawing,
+        &iconvg_private_transform_canvas__end_drawing,
+        &iconvg_private_transform_canvas__begin_path,
+        &iconvg_private_transform_canvas__end_path,
+        &iconvg_private_transform_canvas__path_line_to,
+        &iconvg_private_transform_canvas__path_quad_to,
+        &iconvg_private_transform_canvas__path_cube_to,
+        &iconvg_private_transform_canvas__on_metadata_viewbox,
+        &iconvg_private_transform_canvas__on_metadata_suggested_palette,
+        &iconvg_private_transform_canvas__path_segments,
+        &iconvg_private_transform_canvas__on_skipped_drawing,
+};
+
+iconvg_canvas  //
+iconvg_private_canvas__make_transform(iconvg_canvas* wrapped,
+                                      const iconvg_matrix_2x3_f64* m) {
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_transform_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.const_ptr3 = m;
+  return c;
+}
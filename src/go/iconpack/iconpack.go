@@ -0,0 +1,177 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package iconpack writes icon packs: many named IconVG graphics in a single
+// file, with a name index, that the C library's iconvg_icon_pack can
+// memory-map and look up by name without copying.
+//
+// The file format is described in the C library's src/c/icon_pack.c.
+package iconpack
+
+import (
+	"errors"
+	"io"
+	"math"
+	"sort"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	errDuplicateName = errors.New("iconpack: duplicate name")
+	errTooLarge      = errors.New("iconpack: too large")
+)
+
+const (
+	magic          = "\x89IVP"
+	headerNumWords = 4
+	entryNumWords  = 7
+	maxNumEntries  = 1 << 30
+	alignMask      = 3
+)
+
+type entry struct {
+	name     string
+	src      []byte
+	compiled []byte
+}
+
+// Writer accumulates named graphics and then writes them as an icon pack. The
+// zero value is an empty Writer, ready to use.
+type Writer struct {
+	entries []entry
+	names   map[string]struct{}
+}
+
+// Add adds a graphic to the pack. src is IconVG-formatted data, whose header
+// and metadata are checked. compiled is optional (it may be nil) and, if
+// present, should be what the C library's iconvg_compile produces from src.
+// That compiled form is copied verbatim and is only readable by the same C
+// library version that produced it.
+//
+// The slices' contents are not copied, and should not be modified until after
+// WriteTo returns.
+func (w *Writer) Add(name string, src []byte, compiled []byte) error {
+	if _, ok := w.names[name]; ok {
+		return errDuplicateName
+	} else if len(w.entries) >= maxNumEntries {
+		return errTooLarge
+	} else if _, err := lowlevel.DecodeMetadata(src); err != nil {
+		return err
+	}
+	if w.names == nil {
+		w.names = map[string]struct{}{}
+	}
+	w.names[name] = struct{}{}
+	w.entries = append(w.entries, entry{name, src, compiled})
+	return nil
+}
+
+// WriteTo writes the icon pack to dst. The entries are sorted by name, so
+// that the output does not depend on the order of the Add calls.
+func (w *Writer) WriteTo(dst io.Writer) (int64, error) {
+	buf, err := w.encode()
+	if err != nil {
+		return 0, err
+	}
+	n, err := dst.Write(buf)
+	return int64(n), err
+}
+
+func (w *Writer) encode() ([]byte, error) {
+	entries := append([]entry(nil), w.entries...)
+	sort.Slice(entries, func(i, j int) bool {
+		return entries[i].name < entries[j].name
+	})
+
+	// Use at least twice as many hash slots as entries, keeping the probe
+	// sequences short.
+	numSlots := 1
+	for numSlots < (2*len(entries) + 1) {
+		numSlots *= 2
+	}
+
+	dataOffset := 4 * (headerNumWords + numSlots + entryNumWords*len(entries))
+	n := dataOffset
+	for _, e := range entries {
+		n += align(len(e.name)) + align(len(e.src)) + align(len(e.compiled))
+	}
+	if uint64(n) > math.MaxUint32 {
+		return nil, errTooLarge
+	}
+
+	// buf's capacity is exactly what is needed, so appending to it never
+	// re-allocates and the slots and table slices keep aliasing it.
+	buf := make([]byte, dataOffset, n)
+	copy(buf, magic)
+	putU32(buf[4:], uint32(len(entries)))
+	putU32(buf[8:], uint32(numSlots))
+
+	slots := buf[4*headerNumWords:]
+	table := buf[4*(headerNumWords+numSlots):]
+	for i, e := range entries {
+		h := hash(e.name)
+		s := h & uint32(numSlots-1)
+		for getU32(slots[4*s:]) != 0 {
+			s = (s + 1) & uint32(numSlots-1)
+		}
+		putU32(slots[4*s:], uint32(i+1))
+
+		t := table[4*entryNumWords*i:]
+		putU32(t[0:], h)
+		buf = appendBlob(buf, t[4:], []byte(e.name))
+		buf = appendBlob(buf, t[12:], e.src)
+		if len(e.compiled) > 0 {
+			buf = appendBlob(buf, t[20:], e.compiled)
+		}
+	}
+	return buf, nil
+}
+
+// appendBlob appends b, padded to a 4-byte boundary, to buf and writes its
+// offset and length to the two words at ptr.
+func appendBlob(buf []byte, ptr []byte, b []byte) []byte {
+	putU32(ptr[0:], uint32(len(buf)))
+	putU32(ptr[4:], uint32(len(b)))
+	buf = append(buf, b...)
+	for len(buf)&alignMask != 0 {
+		buf = append(buf, 0)
+	}
+	return buf
+}
+
+func align(n int) int {
+	return (n + alignMask) &^ alignMask
+}
+
+// hash is the 32-bit FNV-1a hash.
+func hash(s string) uint32 {
+	h := uint32(2166136261)
+	for i := 0; i < len(s); i++ {
+		h ^= uint32(s[i])
+		h *= 16777619
+	}
+	return h
+}
+
+func getU32(b []byte) uint32 {
+	return uint32(b[0]) | uint32(b[1])<<8 | uint32(b[2])<<16 | uint32(b[3])<<24
+}
+
+func putU32(b []byte, u uint32) {
+	b[0] = uint8(u >> 0)
+	b[1] = uint8(u >> 8)
+	b[2] = uint8(u >> 16)
+	b[3] = uint8(u >> 24)
+}
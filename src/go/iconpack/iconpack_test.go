@@ -0,0 +1,105 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package iconpack
+
+import (
+	"bytes"
+	"os"
+	"path/filepath"
+	"testing"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+// lookup is a Go version of the C library's iconvg_icon_pack__lookup. It
+// returns the graphic's IconVG-formatted data, or nil if not found.
+func lookup(t *testing.T, pack []byte, name string) []byte {
+	numEntries := getU32(pack[4:])
+	numSlots := getU32(pack[8:])
+	slots := pack[4*headerNumWords:]
+	table := pack[4*(headerNumWords+numSlots):]
+	h := hash(name)
+	for s := h & (numSlots - 1); ; s = (s + 1) & (numSlots - 1) {
+		slot := getU32(slots[4*s:])
+		if slot == 0 {
+			return nil
+		} else if slot > numEntries {
+			t.Fatalf("lookup(%q): bad slot %d", name, slot)
+		}
+		e := table[4*entryNumWords*(slot-1):]
+		n := pack[getU32(e[4:]):][:getU32(e[8:])]
+		if (getU32(e[0:]) == h) && (string(n) == name) {
+			return pack[getU32(e[12:]):][:getU32(e[16:])]
+		}
+	}
+}
+
+func TestWriteTo(t *testing.T) {
+	filenames, err := filepath.Glob("../../../test/data/*.ivg")
+	if err != nil {
+		t.Fatal(err)
+	} else if len(filenames) == 0 {
+		t.Skip("no test/data/*.ivg files found")
+	}
+
+	w := &Writer{}
+	srcs := map[string][]byte{}
+	for _, filename := range filenames {
+		src, err := os.ReadFile(filename)
+		if err != nil {
+			t.Fatal(err)
+		}
+		name := filepath.Base(filename)
+		if _, err := lowlevel.DecodeMetadata(src); err != nil {
+			if w.Add(name, src, nil) == nil {
+				t.Fatalf("%s: Add: got nil error, want non-nil", name)
+			}
+			continue
+		}
+		if err := w.Add(name, src, nil); err != nil {
+			t.Fatalf("%s: Add: %v", name, err)
+		}
+		srcs[name] = src
+	}
+	if err := w.Add("cowbell.ivg", srcs["cowbell.ivg"], nil); err == nil {
+		t.Fatalf("duplicate Add: got nil error, want non-nil")
+	}
+
+	buf := &bytes.Buffer{}
+	if _, err := w.WriteTo(buf); err != nil {
+		t.Fatalf("WriteTo: %v", err)
+	}
+	pack := buf.Bytes()
+	if string(pack[:4]) != magic {
+		t.Fatalf("magic: got %q, want %q", pack[:4], magic)
+	} else if got, want := int(getU32(pack[4:])), len(srcs); got != want {
+		t.Fatalf("number of entries: got %d, want %d", got, want)
+	} else if len(pack)&alignMask != 0 {
+		t.Fatalf("length: got %d, want a multiple of 4", len(pack))
+	}
+
+	for name, src := range srcs {
+		got := lookup(t, pack, name)
+		if !bytes.Equal(got, src) {
+			t.Errorf("%s: lookup: got %d bytes, want %d", name, len(got), len(src))
+		}
+		if offset := cap(pack) - cap(got); offset&alignMask != 0 {
+			t.Errorf("%s: offset: got %d, want a multiple of 4", name, offset)
+		}
+	}
+	if got := lookup(t, pack, "no-such-name.ivg"); got != nil {
+		t.Errorf("no-such-name.ivg: lookup: got %d bytes, want nil", len(got))
+	}
+}
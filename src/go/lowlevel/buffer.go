@@ -223,6 +223,85 @@ func (b *buffer) encodeZeroToOne(f float32) int {
 	return 4
 }
 
+// numberEncoding is how the 1 and 2 byte encodings of real, coordinate or
+// zero-to-one numbers map a natural number u to the number ((u - bias) /
+// scale). The 4 byte encodings are all the same.
+type numberEncoding struct {
+	decode decodeNumberFunc
+	bias   [2]float64
+	scale  [2]float64
+}
+
+var (
+	realEncoding       = numberEncoding{buffer.decodeReal, [2]float64{0, 0}, [2]float64{1, 1}}
+	coordinateEncoding = numberEncoding{buffer.decodeCoordinate, [2]float64{64, 128 * 64}, [2]float64{1, 64}}
+	zeroToOneEncoding  = numberEncoding{buffer.decodeZeroToOne, [2]float64{0, 0}, [2]float64{120, 15120}}
+)
+
+// nRegEncodings are indexed by the "Set NREG" opcodes' bits 3 and 4.
+var nRegEncodings = [3]*numberEncoding{
+	&realEncoding,
+	&coordinateEncoding,
+	&zeroToOneEncoding,
+}
+
+// encodeLossless is like encodeReal, encodeCoordinate and encodeZeroToOne,
+// but an n byte encoding is only used if it decodes to exactly f (including
+// the sign of zero). Unlike encode4ByteReal, f is not rounded, so f should
+// have been decoded from IconVG byte code (or otherwise have its two lowest
+// mantissa bits zeroed).
+func (b *buffer) encodeLossless(f float32, e *numberEncoding) int {
+	for i, limit := range [2]float64{1 << 7, 1 << 14} {
+		u := math.Floor((float64(f) * e.scale[i]) + e.bias[i] + 0.5)
+		if !(0 <= u && u < limit) {
+			continue
+		}
+		n0 := len(*b)
+		if v := uint32(u); i == 0 {
+			*b = append(*b, uint8(v<<1))
+		} else {
+			v = (v << 2) | 1
+			*b = append(*b, uint8(v), uint8(v>>8))
+		}
+		if g, n := e.decode((*b)[n0:]); n == i+1 && math.Float32bits(g) == math.Float32bits(f) {
+			return n
+		}
+		*b = (*b)[:n0]
+	}
+	u := math.Float32bits(f) | 0x03
+	*b = append(*b, uint8(u), uint8(u>>8), uint8(u>>16), uint8(u>>24))
+	return 4
+}
+
+// encodeColor appends c in the 1, 2, 3 (direct) or 4 byte encoding, for a
+// format of 0, 1, 2 or 3. It returns false, appending nothing, if c cannot be
+// encoded that way.
+func (b *buffer) encodeColor(c Color, format byte) bool {
+	switch format {
+	case 0:
+		if x, ok := encodeColor1(c); ok {
+			*b = append(*b, x)
+			return true
+		}
+	case 1:
+		if x, ok := encodeColor2(c); ok {
+			*b = append(*b, x[:]...)
+			return true
+		}
+	case 2:
+		if x, ok := encodeColor3Direct(c); ok {
+			*b = append(*b, x[:]...)
+			return true
+		}
+	case 3:
+		if x, ok := encodeColor4(c); ok {
+			*b = append(*b, x[:]...)
+			return true
+		}
+	}
+	return false
+}
+
 func (b *buffer) encodeColor1(c Color) {
 	if x, ok := encodeColor1(c); ok {
 		*b = append(*b, x)
@@ -17,6 +17,7 @@ package lowlevel
 import (
 	"bytes"
 	"image/color"
+	"io"
 )
 
 var midDescriptions = [...]string{
@@ -61,11 +62,6 @@ type Destination interface {
 	RelArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32)
 }
 
-// printer prints debug information (the disassembly) during the decode. b
-// holds the byte code of a single IconVG operation. format and args contain
-// human-readable commentary in fmt.Printf style.
-type printer func(b []byte, format string, args ...interface{})
-
 // DecodeOptions are the optional parameters to the Decode function.
 type DecodeOptions struct {
 	// Palette is an optional 64 color palette. If one isn't provided, the
@@ -76,10 +72,53 @@ type DecodeOptions struct {
 // Decode decodes an IconVG graphic.
 //
 // opts may be nil, which means to use the default options.
+//
+// Decode does not allocate heap memory (other than what dst's methods do) and
+// does not retain src, so src can be e.g. a memory-mapped file or a buffer
+// that is re-used for the next graphic. Passing the same dst to every call
+// avoids re-allocating it.
 func Decode(dst Destination, src []byte, opts *DecodeOptions) error {
 	return decode(dst, nil, nil, false, src, opts)
 }
 
+// Decoder holds working memory that is re-used across its methods' calls, so
+// that decoding or disassembling many IconVG graphics, such as a whole corpus,
+// does not heap-allocate per graphic.
+//
+// The zero value is ready to use. A Decoder is not safe for concurrent use,
+// but each goroutine can have its own.
+type Decoder struct {
+	src []byte
+	p   printer
+}
+
+// DecodeReaderAt is like Decode but its source is the first size bytes of r,
+// read into d's re-used buffer.
+func (d *Decoder) DecodeReaderAt(dst Destination, r io.ReaderAt, size int64, opts *DecodeOptions) error {
+	src, err := d.readAt(r, size)
+	if err != nil {
+		return err
+	}
+	return decode(dst, nil, nil, false, src, opts)
+}
+
+func (d *Decoder) readAt(r io.ReaderAt, size int64) ([]byte, error) {
+	if size < 0 || size > maxSourceSize {
+		return nil, errInvalidSourceSize
+	}
+	if int64(cap(d.src)) < size {
+		d.src = make([]byte, size)
+	}
+	d.src = d.src[:size]
+	if n, err := r.ReadAt(d.src, 0); n < len(d.src) {
+		if err == nil || err == io.EOF {
+			err = io.ErrUnexpectedEOF
+		}
+		return nil, err
+	}
+	return d.src, nil
+}
+
 // DecodeMetadata decodes only the metadata in an IconVG graphic.
 func DecodeMetadata(src []byte) (m Metadata, retErr error) {
 	m.ViewBox = DefaultViewBox
@@ -90,12 +129,12 @@ func DecodeMetadata(src []byte) (m Metadata, retErr error) {
 	return m, nil
 }
 
-func decode(dst Destination, p printer, m *Metadata, metadataOnly bool, src buffer, opts *DecodeOptions) error {
+func decode(dst Destination, p *printer, m *Metadata, metadataOnly bool, src buffer, opts *DecodeOptions) error {
 	if !bytes.HasPrefix(src, magicBytes) {
 		return errInvalidMagicIdentifier
 	}
 	if p != nil {
-		p(src[:len(magic)], "IconVG Magic identifier\n")
+		p.printf(src[:len(magic)], "IconVG Magic identifier\n")
 	}
 	src = src[len(magic):]
 
@@ -104,7 +143,7 @@ func decode(dst Destination, p printer, m *Metadata, metadataOnly bool, src buff
 		return errInvalidNumberOfMetadataChunks
 	}
 	if p != nil {
-		p(src[:n], "Number of metadata chunks: %d\n", nMetadataChunks)
+		p.printf(src[:n], "Number of metadata chunks: %d\n", nMetadataChunks)
 	}
 	src = src[n:]
 
@@ -136,13 +175,13 @@ func decode(dst Destination, p printer, m *Metadata, metadataOnly bool, src buff
 	return nil
 }
 
-func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions) (src1 buffer, retErr error) {
+func decodeMetadataChunk(p *printer, m *Metadata, src buffer, opts *DecodeOptions) (src1 buffer, retErr error) {
 	length, n := src.decodeNatural()
 	if n == 0 {
 		return nil, errInvalidMetadataChunkLength
 	}
 	if p != nil {
-		p(src[:n], "Metadata chunk length: %d\n", length)
+		p.printf(src[:n], "Metadata chunk length: %d\n", length)
 	}
 	src = src[n:]
 	lenSrcWant := int64(len(src)) - int64(length)
@@ -155,7 +194,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 		return nil, errUnsupportedMetadataIdentifier
 	}
 	if p != nil {
-		p(src[:n], "Metadata Identifier: %d (%s)\n", mid, midDescriptions[mid])
+		p.printf(src[:n], "Metadata Identifier: %d (%s)\n", mid, midDescriptions[mid])
 	}
 	src = src[n:]
 
@@ -195,7 +234,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 			decode = buffer.decodeColor3Direct
 		}
 		if p != nil {
-			p(src[:1], "    %d palette colors, %d bytes per color\n", length, 1+format)
+			p.printf(src[:1], "    %d palette colors, %d bytes per color\n", length, 1+format)
 		}
 		src = src[1:]
 
@@ -209,7 +248,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 				rgba = color.RGBA{0x00, 0x00, 0x00, 0xff}
 			}
 			if p != nil {
-				p(src[:n], "    RGBA %02x%02x%02x%02x\n", rgba.R, rgba.G, rgba.B, rgba.A)
+				p.printf(src[:n], "    RGBA %02x%02x%02x%02x\n", rgba.R, rgba.G, rgba.B, rgba.A)
 			}
 			src = src[n:]
 			if opts == nil || opts.Palette == nil {
@@ -233,15 +272,15 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 // It is a function type. The decoding loop calls this function to decode and
 // execute the next opcode from the src buffer, returning the subsequent mode
 // and the remaining source bytes.
-type modeFunc func(dst Destination, p printer, src buffer) (modeFunc, buffer, error)
+type modeFunc func(dst Destination, p *printer, src buffer) (modeFunc, buffer, error)
 
-func decodeStyling(dst Destination, p printer, src buffer) (modeFunc, buffer, error) {
+func decodeStyling(dst Destination, p *printer, src buffer) (modeFunc, buffer, error) {
 	switch opcode := src[0]; {
 	case opcode < 0x80:
 		if opcode < 0x40 {
 			opcode &= 0x3f
 			if p != nil {
-				p(src[:1], "Set CSEL = %d\n", opcode)
+				p.printf(src[:1], "Set CSEL = %d\n", opcode)
 			}
 			src = src[1:]
 			if dst != nil {
@@ -250,7 +289,7 @@ func decodeStyling(dst Destination, p printer, src buffer) (modeFunc, buffer, er
 		} else {
 			opcode &= 0x3f
 			if p != nil {
-				p(src[:1], "Set NSEL = %d\n", opcode)
+				p.printf(src[:1], "Set NSEL = %d\n", opcode)
 			}
 			src = src[1:]
 			if dst != nil {
@@ -270,7 +309,7 @@ func decodeStyling(dst Destination, p printer, src buffer) (modeFunc, buffer, er
 	return nil, nil, errUnsupportedStylingOpcode
 }
 
-func decodeSetCReg(dst Destination, p printer, src buffer, opcode byte) (modeFunc, buffer, error) {
+func decodeSetCReg(dst Destination, p *printer, src buffer, opcode byte) (modeFunc, buffer, error) {
 	nBytes, directness, adj := 0, "", opcode&0x07
 	var decode func(buffer) (Color, int)
 	incr := adj == 7
@@ -292,9 +331,9 @@ func decodeSetCReg(dst Destination, p printer, src buffer, opcode byte) (modeFun
 	}
 	if p != nil {
 		if incr {
-			p(src[:1], "Set CREG[CSEL-0] to a %d byte%s color; CSEL++\n", nBytes, directness)
+			p.printf(src[:1], "Set CREG[CSEL-0] to a %d byte%s color; CSEL++\n", nBytes, directness)
 		} else {
-			p(src[:1], "Set CREG[CSEL-%d] to a %d byte%s color\n", adj, nBytes, directness)
+			p.printf(src[:1], "Set CREG[CSEL-%d] to a %d byte%s color\n", adj, nBytes, directness)
 		}
 	}
 	src = src[1:]
@@ -316,13 +355,13 @@ func decodeSetCReg(dst Destination, p printer, src buffer, opcode byte) (modeFun
 	return decodeStyling, src, nil
 }
 
-func printColor(src []byte, p printer, c Color, prefix string) {
+func printColor(src []byte, p *printer, c Color, prefix string) {
 	switch c.typ {
 	case colorTypeRGBA:
 		if rgba := c.rgba(); validAlphaPremulColor(rgba) {
-			p(src, "    %sRGBA %02x%02x%02x%02x\n", prefix, rgba.R, rgba.G, rgba.B, rgba.A)
+			p.printf(src, "    %sRGBA %02x%02x%02x%02x\n", prefix, rgba.R, rgba.G, rgba.B, rgba.A)
 		} else if rgba.A == 0 && rgba.B&0x80 != 0 {
-			p(src, "    %sgradient (NSTOPS=%d, CBASE=%d, NBASE=%d, %s, %s)\n",
+			p.printf(src, "    %sgradient (NSTOPS=%d, CBASE=%d, NBASE=%d, %s, %s)\n",
 				prefix,
 				rgba.R&0x3f,
 				rgba.G&0x3f,
@@ -331,21 +370,21 @@ func printColor(src []byte, p printer, c Color, prefix string) {
 				gradientSpreadNames[rgba.G>>6],
 			)
 		} else {
-			p(src, "    %snonsensical color\n", prefix)
+			p.printf(src, "    %snonsensical color\n", prefix)
 		}
 	case colorTypePaletteIndex:
-		p(src, "    %scustomPalette[%d]\n", prefix, c.paletteIndex())
+		p.printf(src, "    %scustomPalette[%d]\n", prefix, c.paletteIndex())
 	case colorTypeCReg:
-		p(src, "    %sCREG[%d]\n", prefix, c.cReg())
+		p.printf(src, "    %sCREG[%d]\n", prefix, c.cReg())
 	case colorTypeBlend:
 		t, c0, c1 := c.blend()
-		p(src[:1], "    blend %d:%d c0:c1\n", 0xff-t, t)
+		p.printf(src[:1], "    blend %d:%d c0:c1\n", 0xff-t, t)
 		printColor(src[1:2], p, decodeColor1(c0), "    c0: ")
 		printColor(src[2:3], p, decodeColor1(c1), "    c1: ")
 	}
 }
 
-func decodeSetNReg(dst Destination, p printer, src buffer, opcode byte) (modeFunc, buffer, error) {
+func decodeSetNReg(dst Destination, p *printer, src buffer, opcode byte) (modeFunc, buffer, error) {
 	decode, typ, adj := buffer.decodeZeroToOne, "zero-to-one", opcode&0x07
 	incr := adj == 7
 	if incr {
@@ -360,9 +399,9 @@ func decodeSetNReg(dst Destination, p printer, src buffer, opcode byte) (modeFun
 	}
 	if p != nil {
 		if incr {
-			p(src[:1], "Set NREG[NSEL-0] to a %s number; NSEL++\n", typ)
+			p.printf(src[:1], "Set NREG[NSEL-0] to a %s number; NSEL++\n", typ)
 		} else {
-			p(src[:1], "Set NREG[NSEL-%d] to a %s number\n", adj, typ)
+			p.printf(src[:1], "Set NREG[NSEL-%d] to a %s number\n", adj, typ)
 		}
 	}
 	src = src[1:]
@@ -372,7 +411,7 @@ func decodeSetNReg(dst Destination, p printer, src buffer, opcode byte) (modeFun
 		return nil, nil, errInvalidNumber
 	}
 	if p != nil {
-		p(src[:n], "    %g\n", f)
+		p.printf(src[:n], "    %g\n", f)
 	}
 	src = src[n:]
 
@@ -383,10 +422,10 @@ func decodeSetNReg(dst Destination, p printer, src buffer, opcode byte) (modeFun
 	return decodeStyling, src, nil
 }
 
-func decodeStartPath(dst Destination, p printer, src buffer, opcode byte) (modeFunc, buffer, error) {
+func decodeStartPath(dst Destination, p *printer, src buffer, opcode byte) (modeFunc, buffer, error) {
 	adj := opcode & 0x07
 	if p != nil {
-		p(src[:1], "Start path, filled with CREG[CSEL-%d]; M (absolute moveTo)\n", adj)
+		p.printf(src[:1], "Start path, filled with CREG[CSEL-%d]; M (absolute moveTo)\n", adj)
 	}
 	src = src[1:]
 
@@ -406,9 +445,9 @@ func decodeStartPath(dst Destination, p printer, src buffer, opcode byte) (modeF
 	return decodeDrawing, src, nil
 }
 
-func decodeSetLOD(dst Destination, p printer, src buffer) (modeFunc, buffer, error) {
+func decodeSetLOD(dst Destination, p *printer, src buffer) (modeFunc, buffer, error) {
 	if p != nil {
-		p(src[:1], "Set LOD\n")
+		p.printf(src[:1], "Set LOD\n")
 	}
 	src = src[1:]
 
@@ -427,7 +466,7 @@ func decodeSetLOD(dst Destination, p printer, src buffer) (modeFunc, buffer, err
 	return decodeStyling, src, nil
 }
 
-func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 buffer, retErr error) {
+func decodeDrawing(dst Destination, p *printer, src buffer) (mf modeFunc, src1 buffer, retErr error) {
 	var coords [6]float32
 
 	switch opcode := src[0]; {
@@ -475,13 +514,13 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 		}
 
 		if p != nil {
-			p(src[:1], "%s, %d reps\n", op, nReps)
+			p.printf(src[:1], "%s, %d reps\n", op, nReps)
 		}
 		src = src[1:]
 
 		for i := 0; i < nReps; i++ {
 			if p != nil && i != 0 {
-				p(nil, "%s, implicit\n", op)
+				p.printf(nil, "%s, implicit\n", op)
 			}
 			var largeArc, sweep bool
 			if op[0] != 'A' && op[0] != 'a' {
@@ -544,7 +583,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe1:
 		if p != nil {
-			p(src[:1], "z (closePath); end path\n")
+			p.printf(src[:1], "z (closePath); end path\n")
 		}
 		src = src[1:]
 		if dst != nil {
@@ -554,7 +593,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe2:
 		if p != nil {
-			p(src[:1], "z (closePath); M (absolute moveTo)\n")
+			p.printf(src[:1], "z (closePath); M (absolute moveTo)\n")
 		}
 		src = src[1:]
 		err := error(nil)
@@ -568,7 +607,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe3:
 		if p != nil {
-			p(src[:1], "z (closePath); m (relative moveTo)\n")
+			p.printf(src[:1], "z (closePath); m (relative moveTo)\n")
 		}
 		src = src[1:]
 		err := error(nil)
@@ -582,7 +621,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe6:
 		if p != nil {
-			p(src[:1], "H (absolute horizontal lineTo)\n")
+			p.printf(src[:1], "H (absolute horizontal lineTo)\n")
 		}
 		src = src[1:]
 		err := error(nil)
@@ -596,7 +635,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe7:
 		if p != nil {
-			p(src[:1], "h (relative horizontal lineTo)\n")
+			p.printf(src[:1], "h (relative horizontal lineTo)\n")
 		}
 		src = src[1:]
 		err := error(nil)
@@ -610,7 +649,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe8:
 		if p != nil {
-			p(src[:1], "V (absolute vertical lineTo)\n")
+			p.printf(src[:1], "V (absolute vertical lineTo)\n")
 		}
 		src = src[1:]
 		err := error(nil)
@@ -624,7 +663,7 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 	case opcode == 0xe9:
 		if p != nil {
-			p(src[:1], "v (relative vertical lineTo)\n")
+			p.printf(src[:1], "v (relative vertical lineTo)\n")
 		}
 		src = src[1:]
 		err := error(nil)
@@ -644,18 +683,18 @@ func decodeDrawing(dst Destination, p printer, src buffer) (mf modeFunc, src1 bu
 
 type decodeNumberFunc func(buffer) (float32, int)
 
-func decodeNumber(p printer, src buffer, dnf decodeNumberFunc) (float32, buffer, error) {
+func decodeNumber(p *printer, src buffer, dnf decodeNumberFunc) (float32, buffer, error) {
 	x, n := dnf(src)
 	if n == 0 {
 		return 0, nil, errInvalidNumber
 	}
 	if p != nil {
-		p(src[:n], "    %+g\n", x)
+		p.printf(src[:n], "    %+g\n", x)
 	}
 	return x, src[n:], nil
 }
 
-func decodeCoordinates(coords []float32, p printer, src buffer) (src1 buffer, retErr error) {
+func decodeCoordinates(coords []float32, p *printer, src buffer) (src1 buffer, retErr error) {
 	for i := range coords {
 		err := error(nil)
 		coords[i], src, err = decodeNumber(p, src, buffer.decodeCoordinate)
@@ -666,24 +705,24 @@ func decodeCoordinates(coords []float32, p printer, src buffer) (src1 buffer, re
 	return src, nil
 }
 
-func decodeAngle(p printer, src buffer) (float32, buffer, error) {
+func decodeAngle(p *printer, src buffer) (float32, buffer, error) {
 	x, n := src.decodeZeroToOne()
 	if n == 0 {
 		return 0, nil, errInvalidNumber
 	}
 	if p != nil {
-		p(src[:n], "    %v × 360 degrees (%v degrees)\n", x, x*360)
+		p.printf(src[:n], "    %v × 360 degrees (%v degrees)\n", x, x*360)
 	}
 	return x, src[n:], nil
 }
 
-func decodeArcToFlags(p printer, src buffer) (bool, bool, buffer, error) {
+func decodeArcToFlags(p *printer, src buffer) (bool, bool, buffer, error) {
 	x, n := src.decodeNatural()
 	if n == 0 {
 		return false, false, nil, errInvalidNumber
 	}
 	if p != nil {
-		p(src[:n], "    %#x (largeArc=%d, sweep=%d)\n", x, (x>>0)&0x01, (x>>1)&0x01)
+		p.printf(src[:n], "    %#x (largeArc=%d, sweep=%d)\n", x, (x>>0)&0x01, (x>>1)&0x01)
 	}
 	return (x>>0)&0x01 != 0, (x>>1)&0x01 != 0, src[n:], nil
 }
@@ -0,0 +1,237 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// These benchmarks are the Go counterpart to example/iconvg-bench. Like that
+// program, they report source (IconVG) bytes and paths per second for each
+// test/data/*.ivg file. This package has no rasterizer, so there are no
+// rendering benchmarks, but the "go test -bench" output is in the same format
+// and can be compared (e.g. with benchstat) against the C library's decode
+// benchmarks.
+
+// countingDestination is a Destination that does nothing other than count the
+// number of paths started.
+type countingDestination struct {
+	numPaths int
+}
+
+func (d *countingDestination) Reset(m Metadata) {}
+
+func (d *countingDestination) SetCSel(cSel uint8)                      {}
+func (d *countingDestination) SetNSel(nSel uint8)                      {}
+func (d *countingDestination) SetCReg(adj uint8, incr bool, c Color)   {}
+func (d *countingDestination) SetNReg(adj uint8, incr bool, f float32) {}
+func (d *countingDestination) SetLOD(lod0, lod1 float32)               {}
+
+func (d *countingDestination) StartPath(adj uint8, x, y float32) { d.numPaths++ }
+func (d *countingDestination) ClosePathEndPath()                 {}
+func (d *countingDestination) ClosePathAbsMoveTo(x, y float32)   { d.numPaths++ }
+func (d *countingDestination) ClosePathRelMoveTo(x, y float32)   { d.numPaths++ }
+
+func (d *countingDestination) AbsHLineTo(x float32)                   {}
+func (d *countingDestination) RelHLineTo(x float32)                   {}
+func (d *countingDestination) AbsVLineTo(y float32)                   {}
+func (d *countingDestination) RelVLineTo(y float32)                   {}
+func (d *countingDestination) AbsLineTo(x, y float32)                 {}
+func (d *countingDestination) RelLineTo(x, y float32)                 {}
+func (d *countingDestination) AbsSmoothQuadTo(x, y float32)           {}
+func (d *countingDestination) RelSmoothQuadTo(x, y float32)           {}
+func (d *countingDestination) AbsQuadTo(x1, y1, x, y float32)         {}
+func (d *countingDestination) RelQuadTo(x1, y1, x, y float32)         {}
+func (d *countingDestination) AbsSmoothCubeTo(x2, y2, x, y float32)   {}
+func (d *countingDestination) RelSmoothCubeTo(x2, y2, x, y float32)   {}
+func (d *countingDestination) AbsCubeTo(x1, y1, x2, y2, x, y float32) {}
+func (d *countingDestination) RelCubeTo(x1, y1, x2, y2, x, y float32) {}
+
+func (d *countingDestination) AbsArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+}
+func (d *countingDestination) RelArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+}
+
+type benchmarkInput struct {
+	name     string
+	src      []byte
+	numPaths int
+}
+
+// loadBenchmarkInputs returns the test/data/*.ivg files that decode without
+// error, along with their path counts.
+func loadBenchmarkInputs(b *testing.B) []benchmarkInput {
+	filenames, err := filepath.Glob("../../../test/data/*.ivg")
+	if err != nil {
+		b.Fatal(err)
+	} else if len(filenames) == 0 {
+		b.Skip("no test/data/*.ivg files found")
+	}
+	inputs := []benchmarkInput(nil)
+	for _, filename := range filenames {
+		src, err := os.ReadFile(filename)
+		if err != nil {
+			b.Fatal(err)
+		}
+		d := &countingDestination{}
+		if err := Decode(d, src, nil); err != nil {
+			continue
+		}
+		inputs = append(inputs, benchmarkInput{
+			name:     filepath.Base(filename),
+			src:      src,
+			numPaths: d.numPaths,
+		})
+	}
+	return inputs
+}
+
+func benchmark(b *testing.B, f func(src []byte) error) {
+	for _, in := range loadBenchmarkInputs(b) {
+		in := in
+		b.Run(in.name, func(b *testing.B) {
+			b.SetBytes(int64(len(in.src)))
+			b.ReportAllocs()
+			b.ResetTimer()
+			start := time.Now()
+			for i := 0; i < b.N; i++ {
+				if err := f(in.src); err != nil {
+					b.Fatal(err)
+				}
+			}
+			elapsed := time.Since(start)
+			b.StopTimer()
+			b.ReportMetric(float64(in.numPaths), "paths/op")
+			if s := elapsed.Seconds(); s > 0 {
+				b.ReportMetric(float64(in.numPaths*b.N)/s, "paths/s")
+			}
+		})
+	}
+}
+
+// BenchmarkDecode is the counterpart to iconvg-bench's DecodeBroken: decoding
+// into a Destination that does (almost) nothing.
+func BenchmarkDecode(b *testing.B) {
+	d := &countingDestination{}
+	benchmark(b, func(src []byte) error {
+		return Decode(d, src, nil)
+	})
+}
+
+// BenchmarkDisassemble is the counterpart to iconvg-bench's DecodeDebug:
+// decoding while printing a human-readable trace to a discarding io.Writer.
+func BenchmarkDisassemble(b *testing.B) {
+	benchmark(b, func(src []byte) error {
+		return Disassemble(io.Discard, src)
+	})
+}
+
+func TestDisassemble(t *testing.T) {
+	filenames, err := filepath.Glob("../../../test/data/*.ivg")
+	if err != nil {
+		t.Fatal(err)
+	} else if len(filenames) == 0 {
+		t.Skip("no test/data/*.ivg files found")
+	}
+	d := &Decoder{}
+	for _, filename := range filenames {
+		src, err := os.ReadFile(filename)
+		if err != nil {
+			t.Fatal(err)
+		}
+		want, err := os.ReadFile(filename + ".disassembly")
+		if err != nil {
+			t.Fatal(err)
+		}
+
+		got := &bytes.Buffer{}
+		if err := d.Disassemble(got, src); err != nil {
+			t.Errorf("%s: Disassemble: %v", filename, err)
+			continue
+		} else if !bytes.Equal(got.Bytes(), want) {
+			t.Errorf("%s: Disassemble: output differs from %s.disassembly", filename, filename)
+			continue
+		}
+
+		f, err := os.Open(filename)
+		if err != nil {
+			t.Fatal(err)
+		}
+		got.Reset()
+		err = d.DisassembleReaderAt(got, f, int64(len(src)))
+		f.Close()
+		if err != nil {
+			t.Errorf("%s: DisassembleReaderAt: %v", filename, err)
+		} else if !bytes.Equal(got.Bytes(), want) {
+			t.Errorf("%s: DisassembleReaderAt: output differs from Disassemble", filename)
+		}
+	}
+}
+
+func TestAppendf(t *testing.T) {
+	f32s := []float32{0, 1, -1, 0.5, 1e-7, 123456789, -3.25e21, float32(math.Inf(+1)), float32(math.NaN())}
+	for _, f := range f32s {
+		for _, format := range []string{"%g", "%+g", "%v", " %+g\n"} {
+			if got, want := string(appendf(nil, format, []interface{}{f})), fmt.Sprintf(format, f); got != want {
+				t.Errorf("appendf(%q, %v): got %q, want %q", format, f, got, want)
+			}
+		}
+	}
+	ints := []interface{}{uint8(0), uint8(0x0a), uint8(0xff), uint32(3), uint32(0), int(-42), 7}
+	for _, x := range ints {
+		for _, format := range []string{"%d", "%02x", "%#x", "[%3d]"} {
+			if got, want := string(appendf(nil, format, []interface{}{x})), fmt.Sprintf(format, x); got != want {
+				t.Errorf("appendf(%q, %v): got %q, want %q", format, x, got, want)
+			}
+		}
+	}
+	if got, want := string(appendf(nil, "%d byte%s color", []interface{}{2, "s"})), "2 bytes color"; got != want {
+		t.Errorf("appendf: got %q, want %q", got, want)
+	}
+}
+
+func TestDecoderDoesNotAllocate(t *testing.T) {
+	src, err := os.ReadFile("../../../test/data/favicon.ivg")
+	if err != nil {
+		t.Skip("test/data/favicon.ivg not found")
+	}
+	d, dst := &Decoder{}, &countingDestination{}
+	if n := testing.AllocsPerRun(10, func() { Decode(dst, src, nil) }); n != 0 {
+		t.Errorf("Decode: got %v allocations, want 0", n)
+	}
+	r := bytes.NewReader(src)
+	if n := testing.AllocsPerRun(10, func() { d.DecodeReaderAt(dst, r, int64(len(src)), nil) }); n != 0 {
+		t.Errorf("Decoder.DecodeReaderAt: got %v allocations, want 0", n)
+	}
+	if n := testing.AllocsPerRun(10, func() { d.Disassemble(io.Discard, src) }); n != 0 {
+		t.Errorf("Decoder.Disassemble: got %v allocations, want 0", n)
+	}
+}
+
+// BenchmarkDecoderDisassemble is like BenchmarkDisassemble but re-uses a
+// Decoder, as a tool that disassembles a whole corpus would.
+func BenchmarkDecoderDisassemble(b *testing.B) {
+	d := &Decoder{}
+	benchmark(b, func(src []byte) error {
+		return d.Disassemble(io.Discard, src)
+	})
+}
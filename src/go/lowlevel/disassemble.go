@@ -15,9 +15,8 @@
 package lowlevel
 
 import (
-	"bufio"
-	"fmt"
 	"io"
+	"strconv"
 )
 
 // Disassemble writes src's disassembly to w.
@@ -25,35 +24,229 @@ import (
 // See https://github.com/google/iconvg/blob/main/spec/iconvg-spec.md#example
 // (look for the text "annotated disassembly") or test/data/*.ivg.disassembly
 // for example output.
+//
+// Output is buffered, so w need not be. Disassembling many graphics should
+// re-use a Decoder instead, which re-uses that buffer.
 func Disassemble(w io.Writer, src []byte) error {
-	// Calling disassemble will make lots of small writes. If w is an
-	// io.ByteWriter then assume that it is already buffered. Otherwise, wrap w
-	// with our own buffering.
-	if _, ok := w.(io.ByteWriter); ok {
-		return disassemble(w, src)
-	}
-	bw := bufio.NewWriter(w)
-	err0 := disassemble(bw, src)
-	err1 := bw.Flush()
+	d := Decoder{}
+	return d.Disassemble(w, src)
+}
+
+// Disassemble is like the Disassemble function but re-uses d's buffer.
+func (d *Decoder) Disassemble(w io.Writer, src []byte) error {
+	d.p.w = w
+	d.p.buf = d.p.buf[:0]
+	d.p.err = nil
+	err0 := decode(nil, &d.p, nil, false, src, nil)
+	err1 := d.p.flush()
+	d.p.w = nil
 	if err0 != nil {
 		return err0
 	}
 	return err1
 }
 
-func disassemble(w io.Writer, src []byte) error {
-	p := func(b []byte, format string, args ...interface{}) {
-		const hex = "0123456789abcdef"
-		var buf [14]byte
-		for i := range buf {
-			buf[i] = ' '
+// DisassembleReaderAt is like Disassemble but its source is the first size
+// bytes of r, read into d's re-used buffer.
+func (d *Decoder) DisassembleReaderAt(w io.Writer, r io.ReaderAt, size int64) error {
+	src, err := d.readAt(r, size)
+	if err != nil {
+		return err
+	}
+	return d.Disassemble(w, src)
+}
+
+// printerFlushLen is the number of buffered bytes at which a printer writes
+// to its io.Writer.
+const printerFlushLen = 4096
+
+// printer prints debug information (the disassembly) during the decode. It is
+// nil when not disassembling.
+//
+// Its printf method supports only the fmt verbs (and flags) that the decoder
+// uses. Unlike fmt.Fprintf, it does not let its arguments escape to the heap,
+// so printing a line does not allocate.
+type printer struct {
+	w   io.Writer
+	buf []byte
+	err error
+}
+
+func (p *printer) flush() error {
+	if len(p.buf) > 0 && p.err == nil {
+		_, p.err = p.w.Write(p.buf)
+	}
+	p.buf = p.buf[:0]
+	return p.err
+}
+
+// printf prints one line (or part of a line) of disassembly. b holds the byte
+// code of a single IconVG operation. format and args contain human-readable
+// commentary in fmt.Printf style.
+func (p *printer) printf(b []byte, format string, args ...interface{}) {
+	const hex = "0123456789abcdef"
+	const spaces = "              "
+	i := len(p.buf)
+	p.buf = append(p.buf, spaces...)
+	for j, x := range b {
+		p.buf[i+3*j+0] = hex[x>>4]
+		p.buf[i+3*j+1] = hex[x&0x0f]
+	}
+	p.buf = appendf(p.buf, format, args)
+	if len(p.buf) >= printerFlushLen {
+		p.flush()
+	}
+}
+
+// appendf appends format, with its verbs replaced by args, to dst. Like fmt,
+// it supports the '+', '#' and '0' flags and a width, but only with the 'd',
+// 's', 'x', 'g' and 'v' verbs applied to integers, strings or float32s.
+func appendf(dst []byte, format string, args []interface{}) []byte {
+	for len(format) > 0 {
+		i := 0
+		for i < len(format) && format[i] != '%' {
+			i++
 		}
-		for i, x := range b {
-			buf[3*i+0] = hex[x>>4]
-			buf[3*i+1] = hex[x&0x0f]
+		dst = append(dst, format[:i]...)
+		if i+1 >= len(format) {
+			break
 		}
-		w.Write(buf[:])
-		fmt.Fprintf(w, format, args...)
+		format = format[i+1:]
+
+		plus, sharp, zero, width := false, false, false, 0
+		for ; len(format) > 0; format = format[1:] {
+			if c := format[0]; c == '+' {
+				plus = true
+			} else if c == '#' {
+				sharp = true
+			} else if c == '0' {
+				zero = true
+			} else {
+				break
+			}
+		}
+		for ; len(format) > 0 && '0' <= format[0] && format[0] <= '9'; format = format[1:] {
+			width = 10*width + int(format[0]-'0')
+		}
+		if len(format) == 0 {
+			break
+		}
+		verb := format[0]
+		format = format[1:]
+		if verb == '%' {
+			dst = append(dst, '%')
+			continue
+		} else if len(args) == 0 {
+			dst = append(dst, "%!"...)
+			dst = append(dst, verb)
+			dst = append(dst, "(MISSING)"...)
+			continue
+		}
+		arg := args[0]
+		args = args[1:]
+
+		start := len(dst)
+		switch verb {
+		case 'd', 'x':
+			u, neg, ok := asInteger(arg)
+			if !ok {
+				dst = appendBadVerb(dst, verb)
+				continue
+			}
+			if neg {
+				dst = append(dst, '-')
+			} else if plus {
+				dst = append(dst, '+')
+			}
+			if verb == 'x' && sharp {
+				dst = append(dst, "0x"...)
+			}
+			digits := len(dst)
+			if verb == 'x' {
+				dst = strconv.AppendUint(dst, u, 16)
+			} else {
+				dst = strconv.AppendUint(dst, u, 10)
+			}
+			if n := width - (len(dst) - start); zero && n > 0 {
+				dst = insertZeroes(dst, digits, n)
+			}
+		case 'g', 'v':
+			f, ok := arg.(float32)
+			if !ok {
+				dst = appendBadVerb(dst, verb)
+				continue
+			}
+			dst = strconv.AppendFloat(dst, float64(f), 'g', -1, 32)
+			if plus && (dst[start] != '-') && (dst[start] != '+') {
+				dst = append(dst, 0)
+				copy(dst[start+1:], dst[start:])
+				dst[start] = '+'
+			}
+		case 's':
+			str, ok := arg.(string)
+			if !ok {
+				dst = appendBadVerb(dst, verb)
+				continue
+			}
+			dst = append(dst, str...)
+		default:
+			dst = appendBadVerb(dst, verb)
+			continue
+		}
+		for n := width - (len(dst) - start); n > 0; n-- {
+			dst = append(dst, ' ')
+			copy(dst[start+1:], dst[start:])
+			dst[start] = ' '
+		}
+	}
+	return dst
+}
+
+func appendBadVerb(dst []byte, verb byte) []byte {
+	dst = append(dst, "%!"...)
+	dst = append(dst, verb)
+	return append(dst, "(unsupported)"...)
+}
+
+// insertZeroes inserts n '0' bytes at dst[i:].
+func insertZeroes(dst []byte, i int, n int) []byte {
+	for ; n > 0; n-- {
+		dst = append(dst, '0')
+		copy(dst[i+1:], dst[i:])
+		dst[i] = '0'
+	}
+	return dst
+}
+
+// asInteger returns x's absolute value and sign, if x is an integer.
+func asInteger(x interface{}) (u uint64, neg bool, ok bool) {
+	i := int64(0)
+	switch x := x.(type) {
+	case uint8:
+		return uint64(x), false, true
+	case uint16:
+		return uint64(x), false, true
+	case uint32:
+		return uint64(x), false, true
+	case uint64:
+		return x, false, true
+	case uint:
+		return uint64(x), false, true
+	case int8:
+		i = int64(x)
+	case int16:
+		i = int64(x)
+	case int32:
+		i = int64(x)
+	case int64:
+		i = x
+	case int:
+		i = int64(x)
+	default:
+		return 0, false, false
+	}
+	if i < 0 {
+		return uint64(-i), true, true
 	}
-	return decode(nil, p, nil, false, src, nil)
+	return uint64(i), false, true
 }
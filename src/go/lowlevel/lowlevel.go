@@ -28,12 +28,14 @@ import (
 
 var (
 	errInconsistentMetadataChunkLength = errors.New("iconvg: inconsistent metadata chunk length")
+	errInternalError                   = errors.New("iconvg: internal error")
 	errInvalidColor                    = errors.New("iconvg: invalid color")
 	errInvalidMagicIdentifier          = errors.New("iconvg: invalid magic identifier")
 	errInvalidMetadataChunkLength      = errors.New("iconvg: invalid metadata chunk length")
 	errInvalidMetadataIdentifier       = errors.New("iconvg: invalid metadata identifier")
 	errInvalidNumber                   = errors.New("iconvg: invalid number")
 	errInvalidNumberOfMetadataChunks   = errors.New("iconvg: invalid number of metadata chunks")
+	errInvalidSourceSize               = errors.New("iconvg: invalid source size")
 	errInvalidSuggestedPalette         = errors.New("iconvg: invalid suggested palette")
 	errInvalidViewBox                  = errors.New("iconvg: invalid view box")
 	errUnsupportedDrawingOpcode        = errors.New("iconvg: unsupported drawing opcode")
@@ -53,6 +55,11 @@ var gradientSpreadNames = [4]string{
 	"repeat",
 }
 
+// maxSourceSize is the largest source, in bytes, that a Decoder reads from an
+// io.ReaderAt. It is somewhat arbitrary but is far larger than any reasonable
+// icon and fits in an int on 32-bit systems.
+const maxSourceSize = 1 << 30
+
 const magic = "\x89IVG"
 
 var magicBytes = []byte(magic)
@@ -0,0 +1,481 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"math"
+)
+
+// OptimizeOptions are the optional parameters to the Optimize function.
+type OptimizeOptions struct {
+	// MergePaths is whether to merge consecutive paths that are filled with
+	// the same paint into a single path, replacing each "z; end path" and
+	// "start path" pair by one "z; M" op. This saves a byte and, more
+	// importantly, a fill per merged path.
+	//
+	// A single path is filled with the non-zero winding rule, so this is not
+	// lossless when the merged paths overlap (or, for anti-aliasing, abut) or
+	// when the paint is translucent. Callers should compare the rendered
+	// output before and after, as cmd/iconvg-optimize's -verify flag does.
+	MergePaths bool
+}
+
+// Optimize re-encodes an IconVG graphic so that it is smaller and faster to
+// decode, appending the result to dst and returning the extended slice.
+//
+// opts may be nil, which means to use the default options.
+//
+// Unless opts.MergePaths is set, the result renders identically to src, for
+// any custom palette. Optimize:
+//   - uses each drawing opcode's longest repeat count, so that e.g. 40
+//     consecutive "L" ops take two opcodes instead of up to 40,
+//   - uses each number's shortest lossless encoding, including choosing
+//     between NREG's real, coordinate and zero-to-one forms,
+//   - uses each color's shortest encoding, including the suggested palette's,
+//     and drops metadata that only repeats the default,
+//   - drops CREG and NREG writes that do not change the register's value,
+//     and sets CSEL, NSEL and the LOD only when and where an op needs them,
+//   - drops paths whose LOD bounds no rasterization height can satisfy.
+//
+// The Level of Detail tests are kept (other than for those unreachable
+// paths), so a graphic continues to render differently at different sizes.
+func Optimize(dst []byte, src []byte, opts *OptimizeOptions) ([]byte, error) {
+	o := &optimizer{buf: dst}
+	if opts != nil {
+		o.opts = *opts
+	}
+	m := Metadata{
+		ViewBox: DefaultViewBox,
+		Palette: DefaultPalette,
+	}
+	if err := decode(o, nil, &m, false, src, nil); err != nil {
+		return dst, err
+	} else if o.err != nil {
+		return dst, o.err
+	}
+	o.flush()
+	return o.buf, nil
+}
+
+// cRegValue is what Optimize knows about a CREG register's value. If known,
+// the register holds the (direct or custom palette) Color c.
+type cRegValue struct {
+	known bool
+	c     Color
+}
+
+// drawingRun is a sequence of identical drawing ops, such as "L (absolute
+// lineTo)", that are yet to be written. They share one opcode (whose low bits
+// are the repeat count) followed by each op's arguments.
+type drawingRun struct {
+	opcode  byte
+	maxReps int
+	nReps   int
+	args    buffer
+}
+
+// optimizer is the Destination that implements Optimize. It tracks two sets
+// of registers: those of the original byte code (cSel, nSel, lod0 and lod1)
+// and those of the optimized byte code written so far (the outXxx fields).
+// The CREG and NREG values are the same in both, as the only register writes
+// that are dropped are those that do not change a value.
+type optimizer struct {
+	buf  buffer
+	opts OptimizeOptions
+
+	cSel uint8
+	nSel uint8
+	lod0 float32
+	lod1 float32
+
+	outCSel uint8
+	outNSel uint8
+	outLOD0 float32
+	outLOD1 float32
+
+	cReg [64]cRegValue
+	nReg [64]float32
+
+	// skipping is whether the current path is unreachable and being dropped.
+	skipping bool
+
+	// pendingEndPath is whether a "z; end path" is yet to be written, in case
+	// MergePaths replaces it (and the next "start path") with a "z; M".
+	// pendingPaint is that path's CREG index.
+	pendingEndPath bool
+	pendingPaint   uint8
+
+	run     drawingRun
+	scratch buffer
+
+	// err is the first error, if any, that the optimizer itself hit. The
+	// Destination methods do not return errors, so Optimize checks it after
+	// decoding.
+	err error
+}
+
+// setErr records err, unless an earlier error was already recorded.
+func (o *optimizer) setErr(err error) {
+	if o.err == nil {
+		o.err = err
+	}
+}
+
+func sameFloat32(a, b float32) bool {
+	return math.Float32bits(a) == math.Float32bits(b)
+}
+
+// lodIsReachable returns whether some rasterization height H satisfies
+// (lod0 <= H) and (H < lod1). H is never negative.
+func lodIsReachable(lod0, lod1 float32) bool {
+	return lod0 < lod1 && lod1 > 0
+}
+
+// flush writes any pending drawing ops.
+func (o *optimizer) flush() {
+	o.flushRun()
+	if o.pendingEndPath {
+		o.pendingEndPath = false
+		o.buf = append(o.buf, 0xe1)
+	}
+}
+
+func (o *optimizer) flushRun() {
+	if o.run.nReps == 0 {
+		return
+	}
+	o.buf = append(o.buf, o.run.opcode+byte(o.run.nReps-1))
+	o.buf = append(o.buf, o.run.args...)
+	o.run.nReps = 0
+	o.run.args = o.run.args[:0]
+}
+
+// startRep starts one more rep of the drawing op with the given base opcode,
+// flushing the current run first if it is a different op or is full. The
+// caller then appends that rep's arguments to o.run.args.
+func (o *optimizer) startRep(opcode byte, maxReps int) {
+	if o.run.nReps > 0 && (o.run.opcode != opcode || o.run.nReps == maxReps) {
+		o.flushRun()
+	}
+	o.run.opcode = opcode
+	o.run.maxReps = maxReps
+	o.run.nReps++
+}
+
+// selectReg returns the ADJ value that refers to register r, given the
+// current selector register *outSel, first writing a "Set CSEL" or "Set NSEL"
+// opcode (the selOpcode base plus the new selector value) if r is out of ADJ
+// range. That new selector value is sel, the original byte code's, as the
+// original's subsequent ADJ values are relative to it.
+func (o *optimizer) selectReg(outSel *uint8, sel uint8, selOpcode byte, r uint8) (adj uint8) {
+	if adj := (*outSel - r) & 0x3f; adj < 7 {
+		return adj
+	}
+	o.buf = append(o.buf, selOpcode|sel)
+	*outSel = sel
+	return (sel - r) & 0x3f
+}
+
+func (o *optimizer) Reset(m Metadata) {
+	o.buf = append(o.buf, magic...)
+
+	hasViewBox := m.ViewBox != DefaultViewBox
+	paletteLen := 0
+	for i := len(m.Palette) - 1; i >= 0; i-- {
+		if m.Palette[i] != DefaultPalette[i] {
+			paletteLen = i + 1
+			break
+		}
+	}
+
+	nChunks := uint32(0)
+	if hasViewBox {
+		nChunks++
+	}
+	if paletteLen > 0 {
+		nChunks++
+	}
+	o.buf.encodeNatural(nChunks)
+
+	if hasViewBox {
+		o.scratch = o.scratch[:0]
+		o.scratch.encodeNatural(midViewBox)
+		o.scratch.encodeLossless(m.ViewBox.Min[0], &coordinateEncoding)
+		o.scratch.encodeLossless(m.ViewBox.Min[1], &coordinateEncoding)
+		o.scratch.encodeLossless(m.ViewBox.Max[0], &coordinateEncoding)
+		o.scratch.encodeLossless(m.ViewBox.Max[1], &coordinateEncoding)
+		o.buf.encodeNatural(uint32(len(o.scratch)))
+		o.buf = append(o.buf, o.scratch...)
+	}
+
+	if paletteLen > 0 {
+		// Use the shortest of the 1, 2, 3 (direct) and 4 byte encodings that
+		// can represent every color. The 1 and 2 byte encodings each have
+		// colors that the other lacks, so each format is checked against the
+		// whole palette.
+		format := byte(0)
+		for ; format < 4; format++ {
+			o.scratch = o.scratch[:0]
+			ok := true
+			for _, rgba := range m.Palette[:paletteLen] {
+				if ok = o.scratch.encodeColor(RGBAColor(rgba), format); !ok {
+					break
+				}
+			}
+			if ok {
+				break
+			}
+		}
+		if format == 4 {
+			o.setErr(errInternalError)
+			return
+		}
+
+		o.scratch = o.scratch[:0]
+		o.scratch.encodeNatural(midSuggestedPalette)
+		o.scratch = append(o.scratch, format<<6|byte(paletteLen-1))
+		for _, rgba := range m.Palette[:paletteLen] {
+			if !o.scratch.encodeColor(RGBAColor(rgba), format) {
+				o.setErr(errInternalError)
+				return
+			}
+		}
+		o.buf.encodeNatural(uint32(len(o.scratch)))
+		o.buf = append(o.buf, o.scratch...)
+	}
+
+	for i := range o.cReg {
+		o.cReg[i] = cRegValue{known: true, c: PaletteIndexColor(uint8(i))}
+	}
+	o.nReg = [64]float32{}
+	o.lod0, o.lod1 = 0, float32(math.Inf(+1))
+	o.outLOD0, o.outLOD1 = o.lod0, o.lod1
+}
+
+func (o *optimizer) SetCSel(cSel uint8) { o.cSel = cSel & 0x3f }
+func (o *optimizer) SetNSel(nSel uint8) { o.nSel = nSel & 0x3f }
+
+// cRegValueOf returns what is known about the value that c resolves to.
+// Colors that refer to CREG registers may change when those registers do, so
+// they are resolved now. Blends of CREG registers are treated as unknown.
+func (o *optimizer) cRegValueOf(c Color) cRegValue {
+	switch c.typ {
+	case colorTypeCReg:
+		return o.cReg[c.cReg()&0x3f]
+	case colorTypeBlend:
+		if _, c0, c1 := c.blend(); c0 >= 0xc0 || c1 >= 0xc0 {
+			return cRegValue{}
+		}
+	}
+	return cRegValue{known: true, c: c}
+}
+
+func (o *optimizer) SetCReg(adj uint8, incr bool, c Color) {
+	sel := o.cSel
+	r := (sel - adj) & 0x3f
+	if incr {
+		o.cSel = (o.cSel + 1) & 0x3f
+	}
+	v := o.cRegValueOf(c)
+	if v.known && o.cReg[r] == v {
+		return
+	}
+	o.cReg[r] = v
+	o.flush()
+
+	format := byte(4)
+	for f := byte(0); f < 4; f++ {
+		if o.scratch = o.scratch[:0]; o.scratch.encodeColor(c, f) {
+			format = f
+			break
+		}
+	}
+	if format == 4 {
+		o.scratch = o.scratch[:0]
+		o.scratch.encodeColor3Indirect(c)
+	}
+
+	outAdj := uint8(7)
+	if !incr || o.outCSel != r {
+		if outAdj = o.selectReg(&o.outCSel, sel, 0x00, r); incr && outAdj == 0 {
+			outAdj = 7
+		}
+	}
+	if outAdj == 7 {
+		o.outCSel = (o.outCSel + 1) & 0x3f
+	}
+	o.buf = append(o.buf, 0x80+format<<3+outAdj)
+	o.buf = append(o.buf, o.scratch...)
+}
+
+func (o *optimizer) SetNReg(adj uint8, incr bool, f float32) {
+	sel := o.nSel
+	r := (sel - adj) & 0x3f
+	if incr {
+		o.nSel = (o.nSel + 1) & 0x3f
+	}
+	if sameFloat32(o.nReg[r], f) {
+		return
+	}
+	o.nReg[r] = f
+	o.flush()
+
+	// Use the shortest of the real, coordinate and zero-to-one encodings.
+	opcode, n := byte(0), 5
+	for i, e := range nRegEncodings {
+		o.scratch = o.scratch[:0]
+		if m := o.scratch.encodeLossless(f, e); m < n {
+			opcode, n = 0xa8+8*byte(i), m
+		}
+	}
+	o.scratch = o.scratch[:0]
+	o.scratch.encodeLossless(f, nRegEncodings[(opcode-0xa8)>>3])
+
+	outAdj := uint8(7)
+	if !incr || o.outNSel != r {
+		if outAdj = o.selectReg(&o.outNSel, sel, 0x40, r); incr && outAdj == 0 {
+			outAdj = 7
+		}
+	}
+	if outAdj == 7 {
+		o.outNSel = (o.outNSel + 1) & 0x3f
+	}
+	o.buf = append(o.buf, opcode+outAdj)
+	o.buf = append(o.buf, o.scratch...)
+}
+
+func (o *optimizer) SetLOD(lod0, lod1 float32) {
+	o.lod0, o.lod1 = lod0, lod1
+}
+
+func (o *optimizer) StartPath(adj uint8, x, y float32) {
+	if !lodIsReachable(o.lod0, o.lod1) {
+		o.skipping = true
+		return
+	}
+	r := (o.cSel - adj) & 0x3f
+	sameLOD := sameFloat32(o.lod0, o.outLOD0) && sameFloat32(o.lod1, o.outLOD1)
+
+	if o.pendingEndPath && o.opts.MergePaths && sameLOD && o.pendingPaint == r {
+		o.flushRun()
+		o.pendingEndPath = false
+		o.buf = append(o.buf, 0xe2)
+		o.buf.encodeLossless(x, &coordinateEncoding)
+		o.buf.encodeLossless(y, &coordinateEncoding)
+		return
+	}
+	o.flush()
+
+	if !sameLOD {
+		o.buf = append(o.buf, 0xc7)
+		o.buf.encodeLossless(o.lod0, &realEncoding)
+		o.buf.encodeLossless(o.lod1, &realEncoding)
+		o.outLOD0, o.outLOD1 = o.lod0, o.lod1
+	}
+	outAdj := o.selectReg(&o.outCSel, o.cSel, 0x00, r)
+	o.buf = append(o.buf, 0xc0+outAdj)
+	o.buf.encodeLossless(x, &coordinateEncoding)
+	o.buf.encodeLossless(y, &coordinateEncoding)
+	o.pendingPaint = r
+}
+
+func (o *optimizer) ClosePathEndPath() {
+	if o.skipping {
+		o.skipping = false
+		return
+	}
+	o.flushRun()
+	o.pendingEndPath = true
+}
+
+func (o *optimizer) ClosePathAbsMoveTo(x, y float32) { o.op1or2(0xe2, x, y, 2) }
+func (o *optimizer) ClosePathRelMoveTo(x, y float32) { o.op1or2(0xe3, x, y, 2) }
+
+func (o *optimizer) AbsHLineTo(x float32) { o.op1or2(0xe6, x, 0, 1) }
+func (o *optimizer) RelHLineTo(x float32) { o.op1or2(0xe7, x, 0, 1) }
+func (o *optimizer) AbsVLineTo(y float32) { o.op1or2(0xe8, y, 0, 1) }
+func (o *optimizer) RelVLineTo(y float32) { o.op1or2(0xe9, y, 0, 1) }
+
+// op1or2 writes a drawing op that has no repeat count and either one or two
+// coordinates.
+func (o *optimizer) op1or2(opcode byte, a, b float32, nCoords int) {
+	if o.skipping {
+		return
+	}
+	o.flushRun()
+	o.buf = append(o.buf, opcode)
+	o.buf.encodeLossless(a, &coordinateEncoding)
+	if nCoords == 2 {
+		o.buf.encodeLossless(b, &coordinateEncoding)
+	}
+}
+
+// repOp adds one rep of a drawing op that has a repeat count.
+func (o *optimizer) repOp(opcode byte, maxReps int, coords ...float32) {
+	if o.skipping {
+		return
+	}
+	o.startRep(opcode, maxReps)
+	for _, c := range coords {
+		o.run.args.encodeLossless(c, &coordinateEncoding)
+	}
+}
+
+func (o *optimizer) AbsLineTo(x, y float32)       { o.repOp(0x00, 32, x, y) }
+func (o *optimizer) RelLineTo(x, y float32)       { o.repOp(0x20, 32, x, y) }
+func (o *optimizer) AbsSmoothQuadTo(x, y float32) { o.repOp(0x40, 16, x, y) }
+func (o *optimizer) RelSmoothQuadTo(x, y float32) { o.repOp(0x50, 16, x, y) }
+
+func (o *optimizer) AbsQuadTo(x1, y1, x, y float32) { o.repOp(0x60, 16, x1, y1, x, y) }
+func (o *optimizer) RelQuadTo(x1, y1, x, y float32) { o.repOp(0x70, 16, x1, y1, x, y) }
+
+func (o *optimizer) AbsSmoothCubeTo(x2, y2, x, y float32) { o.repOp(0x80, 16, x2, y2, x, y) }
+func (o *optimizer) RelSmoothCubeTo(x2, y2, x, y float32) { o.repOp(0x90, 16, x2, y2, x, y) }
+
+func (o *optimizer) AbsCubeTo(x1, y1, x2, y2, x, y float32) {
+	o.repOp(0xa0, 16, x1, y1, x2, y2, x, y)
+}
+
+func (o *optimizer) RelCubeTo(x1, y1, x2, y2, x, y float32) {
+	o.repOp(0xb0, 16, x1, y1, x2, y2, x, y)
+}
+
+func (o *optimizer) AbsArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+	o.arcTo(0xc0, rx, ry, xAxisRotation, largeArc, sweep, x, y)
+}
+
+func (o *optimizer) RelArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+	o.arcTo(0xd0, rx, ry, xAxisRotation, largeArc, sweep, x, y)
+}
+
+func (o *optimizer) arcTo(opcode byte, rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+	if o.skipping {
+		return
+	}
+	o.startRep(opcode, 16)
+	o.run.args.encodeLossless(rx, &coordinateEncoding)
+	o.run.args.encodeLossless(ry, &coordinateEncoding)
+	o.run.args.encodeLossless(xAxisRotation, &zeroToOneEncoding)
+	flags := uint32(0)
+	if largeArc {
+		flags |= 0x01
+	}
+	if sweep {
+		flags |= 0x02
+	}
+	o.run.args.encodeNatural(flags)
+	o.run.args.encodeLossless(x, &coordinateEncoding)
+	o.run.args.encodeLossless(y, &coordinateEncoding)
+}
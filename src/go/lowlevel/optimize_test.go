@@ -0,0 +1,314 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"fmt"
+	"image/color"
+	"math"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+// renderingDestination is a Destination that executes the decoder virtual
+// machine, recording (as text) what each reachable path is filled with and
+// its drawing ops. Two graphics with the same recording render identically.
+type renderingDestination struct {
+	pal        Palette
+	cSel, nSel uint8
+	cReg       [64]color.RGBA
+	nReg       [64]float32
+	lod0, lod1 float32
+	skipping   bool
+	b          strings.Builder
+}
+
+func (d *renderingDestination) Reset(m Metadata) {
+	fmt.Fprintf(&d.b, "viewBox %v\n", m.ViewBox)
+	d.pal = m.Palette
+	d.cSel, d.nSel = 0, 0
+	for i := range d.cReg {
+		d.cReg[i] = d.pal[i]
+	}
+	d.nReg = [64]float32{}
+	d.lod0, d.lod1 = 0, float32(math.Inf(+1))
+}
+
+func (d *renderingDestination) SetCSel(cSel uint8) { d.cSel = cSel & 0x3f }
+func (d *renderingDestination) SetNSel(nSel uint8) { d.nSel = nSel & 0x3f }
+
+func (d *renderingDestination) SetCReg(adj uint8, incr bool, c Color) {
+	d.cReg[(d.cSel-adj)&0x3f] = c.Resolve(&d.pal, &d.cReg)
+	if incr {
+		d.cSel++
+	}
+}
+
+func (d *renderingDestination) SetNReg(adj uint8, incr bool, f float32) {
+	d.nReg[(d.nSel-adj)&0x3f] = f
+	if incr {
+		d.nSel++
+	}
+}
+
+func (d *renderingDestination) SetLOD(lod0, lod1 float32) { d.lod0, d.lod1 = lod0, lod1 }
+
+func (d *renderingDestination) StartPath(adj uint8, x, y float32) {
+	if d.skipping = !lodIsReachable(d.lod0, d.lod1); d.skipping {
+		return
+	}
+	// A gradient's paint depends on the CREG and NREG registers (at CBASE and
+	// NBASE), so record them all.
+	fmt.Fprintf(&d.b, "path LOD=[%v, %v) paint=%v\n    CREG=%v\n    NREG=%v\nM %v %v\n",
+		d.lod0, d.lod1, d.cReg[(d.cSel-adj)&0x3f], d.cReg, d.nReg, x, y)
+}
+
+func (d *renderingDestination) op(format string, args ...interface{}) {
+	if !d.skipping {
+		fmt.Fprintf(&d.b, format, args...)
+	}
+}
+
+func (d *renderingDestination) ClosePathEndPath() {
+	d.op("z; end path\n")
+	d.skipping = false
+}
+
+func (d *renderingDestination) ClosePathAbsMoveTo(x, y float32) { d.op("z; M %v %v\n", x, y) }
+func (d *renderingDestination) ClosePathRelMoveTo(x, y float32) { d.op("z; m %v %v\n", x, y) }
+
+func (d *renderingDestination) AbsHLineTo(x float32)         { d.op("H %v\n", x) }
+func (d *renderingDestination) RelHLineTo(x float32)         { d.op("h %v\n", x) }
+func (d *renderingDestination) AbsVLineTo(y float32)         { d.op("V %v\n", y) }
+func (d *renderingDestination) RelVLineTo(y float32)         { d.op("v %v\n", y) }
+func (d *renderingDestination) AbsLineTo(x, y float32)       { d.op("L %v %v\n", x, y) }
+func (d *renderingDestination) RelLineTo(x, y float32)       { d.op("l %v %v\n", x, y) }
+func (d *renderingDestination) AbsSmoothQuadTo(x, y float32) { d.op("T %v %v\n", x, y) }
+func (d *renderingDestination) RelSmoothQuadTo(x, y float32) { d.op("t %v %v\n", x, y) }
+
+func (d *renderingDestination) AbsQuadTo(x1, y1, x, y float32) {
+	d.op("Q %v %v %v %v\n", x1, y1, x, y)
+}
+func (d *renderingDestination) RelQuadTo(x1, y1, x, y float32) {
+	d.op("q %v %v %v %v\n", x1, y1, x, y)
+}
+func (d *renderingDestination) AbsSmoothCubeTo(x2, y2, x, y float32) {
+	d.op("S %v %v %v %v\n", x2, y2, x, y)
+}
+func (d *renderingDestination) RelSmoothCubeTo(x2, y2, x, y float32) {
+	d.op("s %v %v %v %v\n", x2, y2, x, y)
+}
+func (d *renderingDestination) AbsCubeTo(x1, y1, x2, y2, x, y float32) {
+	d.op("C %v %v %v %v %v %v\n", x1, y1, x2, y2, x, y)
+}
+func (d *renderingDestination) RelCubeTo(x1, y1, x2, y2, x, y float32) {
+	d.op("c %v %v %v %v %v %v\n", x1, y1, x2, y2, x, y)
+}
+func (d *renderingDestination) AbsArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+	d.op("A %v %v %v %v %v %v %v\n", rx, ry, xAxisRotation, largeArc, sweep, x, y)
+}
+func (d *renderingDestination) RelArcTo(rx, ry, xAxisRotation float32, largeArc, sweep bool, x, y float32) {
+	d.op("a %v %v %v %v %v %v %v\n", rx, ry, xAxisRotation, largeArc, sweep, x, y)
+}
+
+func render(src []byte, opts *DecodeOptions) (string, error) {
+	d := &renderingDestination{}
+	m := Metadata{ViewBox: DefaultViewBox, Palette: DefaultPalette}
+	if err := decode(d, nil, &m, false, src, opts); err != nil {
+		return "", err
+	}
+	return d.b.String(), nil
+}
+
+func TestOptimize(t *testing.T) {
+	filenames, err := filepath.Glob("../../../test/data/*.ivg")
+	if err != nil {
+		t.Fatal(err)
+	} else if len(filenames) == 0 {
+		t.Skip("no test/data/*.ivg files found")
+	}
+
+	// A custom palette of distinct colors checks that CREG values derived from
+	// the palette are not resolved (against the suggested palette) too early.
+	customPalette := &Palette{}
+	for i := range customPalette {
+		customPalette[i] = color.RGBA{uint8(4 * i), 0x40, 0x80, 0xff}
+	}
+
+	for _, filename := range filenames {
+		src, err := os.ReadFile(filename)
+		if err != nil {
+			t.Fatal(err)
+		}
+		dst, err := Optimize(nil, src, nil)
+		if err != nil {
+			t.Errorf("%s: Optimize: %v", filename, err)
+			continue
+		} else if len(dst) > len(src) {
+			t.Errorf("%s: Optimize: got %d bytes, want at most %d", filename, len(dst), len(src))
+		}
+
+		for _, opts := range []*DecodeOptions{nil, {Palette: customPalette}} {
+			want, err := render(src, opts)
+			if err != nil {
+				t.Errorf("%s: render(src): %v", filename, err)
+				continue
+			}
+			got, err := render(dst, opts)
+			if err != nil {
+				t.Errorf("%s: render(dst): %v", filename, err)
+				continue
+			}
+			if got != want {
+				t.Errorf("%s: optimized rendering differs (custom palette: %t)", filename, opts != nil)
+			}
+		}
+
+		// Optimizing is idempotent.
+		if again, err := Optimize(nil, dst, nil); err != nil {
+			t.Errorf("%s: Optimize again: %v", filename, err)
+		} else if string(again) != string(dst) {
+			t.Errorf("%s: Optimize again: got %d bytes, want %d", filename, len(again), len(dst))
+		}
+	}
+}
+
+func TestOptimizeDropsUnreachablePaths(t *testing.T) {
+	src := []byte{
+		// Magic identifier; zero metadata chunks.
+		0x89, 0x49, 0x56, 0x47, 0x00,
+		// Set LOD to [20, 10), which is empty.
+		0xc7, 0x28, 0x14,
+		// Set CREG[0] to 10:20:30:40.
+		0x98, 0x10, 0x20, 0x30, 0x40,
+		// Start path at (0, 0); L (absolute lineTo) (8, 0); z; end path.
+		0xc0, 0x80, 0x80, 0x00, 0x90, 0x80, 0xe1,
+		// Set LOD to [0, +infinity).
+		0xc7, 0x00, 0x03, 0x00, 0x80, 0x7f,
+		// Set NSEL = 0; set NREG[0] to 0, which it already was.
+		0x40, 0xa8, 0x00,
+		// Start path at (0, 0); L (0, 8); L (8, 8); z; end path.
+		0xc0, 0x80, 0x80, 0x00, 0x80, 0x90, 0x00, 0x90, 0x90, 0xe1,
+	}
+	want := []byte{
+		0x89, 0x49, 0x56, 0x47, 0x00,
+		0x98, 0x10, 0x20, 0x30, 0x40,
+		// The two L ops share one opcode, with a repeat count of 2.
+		0xc0, 0x80, 0x80, 0x01, 0x80, 0x90, 0x90, 0x90, 0xe1,
+	}
+	got, err := Optimize(nil, src, nil)
+	if err != nil {
+		t.Fatalf("Optimize: %v", err)
+	} else if string(got) != string(want) {
+		t.Fatalf("Optimize:\ngot  % 02x\nwant % 02x", got, want)
+	}
+}
+
+func TestOptimizeMixedSuggestedPalette(t *testing.T) {
+	src := []byte{
+		// Magic identifier; one metadata chunk.
+		0x89, 0x49, 0x56, 0x47, 0x02,
+		// A 10 byte suggested palette chunk of two colors, in the 4 byte
+		// format. 40:40:40:ff has only a 1 byte encoding and 11:22:33:ff has
+		// only a 2 byte one, so the smallest common format is the 3 byte one.
+		0x14, 0x02, 0xc1, 0x40, 0x40, 0x40, 0xff, 0x11, 0x22, 0x33, 0xff,
+	}
+	want := []byte{
+		0x89, 0x49, 0x56, 0x47, 0x02,
+		0x10, 0x02, 0x81, 0x40, 0x40, 0x40, 0x11, 0x22, 0x33,
+	}
+	got, err := Optimize(nil, src, nil)
+	if err != nil {
+		t.Fatalf("Optimize: %v", err)
+	} else if string(got) != string(want) {
+		t.Fatalf("Optimize:\ngot  % 02x\nwant % 02x", got, want)
+	}
+
+	m0, err := DecodeMetadata(src)
+	if err != nil {
+		t.Fatalf("DecodeMetadata(src): %v", err)
+	}
+	m1, err := DecodeMetadata(got)
+	if err != nil {
+		t.Fatalf("DecodeMetadata(got): %v", err)
+	}
+	if m0 != m1 {
+		t.Fatalf("DecodeMetadata: got %v, want %v", m1, m0)
+	}
+}
+
+func TestOptimizeMergePaths(t *testing.T) {
+	src, err := os.ReadFile("../../../test/data/video-005.primitive.ivg")
+	if err != nil {
+		t.Skip("test/data/video-005.primitive.ivg not found")
+	}
+	d0, d1 := &countingDestination{}, &countingDestination{}
+	unmerged, err := Optimize(nil, src, nil)
+	if err != nil {
+		t.Fatalf("Optimize: %v", err)
+	}
+	merged, err := Optimize(nil, src, &OptimizeOptions{MergePaths: true})
+	if err != nil {
+		t.Fatalf("Optimize(MergePaths): %v", err)
+	}
+	if err := Decode(d0, unmerged, nil); err != nil {
+		t.Fatalf("Decode(unmerged): %v", err)
+	}
+	if err := Decode(d1, merged, nil); err != nil {
+		t.Fatalf("Decode(merged): %v", err)
+	}
+	if len(merged) > len(unmerged) {
+		t.Errorf("merged: got %d bytes, want at most %d", len(merged), len(unmerged))
+	}
+	// countingDestination counts each subpath, merged or not.
+	if d0.numPaths != d1.numPaths {
+		t.Errorf("numPaths: got %d, want %d", d1.numPaths, d0.numPaths)
+	}
+}
+
+func TestEncodeLossless(t *testing.T) {
+	testCases := []struct {
+		f    float32
+		e    *numberEncoding
+		want int
+	}{
+		{0, &coordinateEncoding, 1},
+		{-64, &coordinateEncoding, 1},
+		{64, &coordinateEncoding, 2},
+		{1.5, &coordinateEncoding, 2},
+		{-128, &coordinateEncoding, 2},
+		{128, &coordinateEncoding, 4},
+		{1.0 / 128, &coordinateEncoding, 4},
+		{float32(math.Copysign(0, -1)), &coordinateEncoding, 4},
+		{127, &realEncoding, 1},
+		{128, &realEncoding, 2},
+		{-1, &realEncoding, 4},
+		{0.5, &zeroToOneEncoding, 1},
+		{float32(1) / 15120, &zeroToOneEncoding, 2},
+		{float32(12345) / 15120, &zeroToOneEncoding, 2},
+	}
+	for _, tc := range testCases {
+		b := buffer(nil)
+		if got := b.encodeLossless(tc.f, tc.e); got != tc.want {
+			t.Errorf("encodeLossless(%v): got %d bytes, want %d", tc.f, got, tc.want)
+			continue
+		}
+		if g, n := tc.e.decode(b); n != len(b) || math.Float32bits(g) != math.Float32bits(tc.f) {
+			t.Errorf("encodeLossless(%v): decoded %v (%d bytes)", tc.f, g, n)
+		}
+	}
+}